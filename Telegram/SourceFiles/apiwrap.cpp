@@ -68,9 +68,14 @@ constexpr auto kSharedMediaLimit = 100;
 constexpr auto kFeedMessagesLimit = 50;
 constexpr auto kReadFeaturedSetsTimeout = TimeMs(1000);
 constexpr auto kFileLoaderQueueStopTimeout = TimeMs(5000);
+constexpr auto kPeerRequestsDelay = TimeMs(50);
+constexpr auto kPeerRequestsLimit = 100;
+constexpr auto kDialogRequestsLimit = 100;
+constexpr auto kFileLoaderMaxWorkers = 4; // each holds a full image in memory
 constexpr auto kFeedReadTimeout = TimeMs(1000);
 constexpr auto kStickersByEmojiInvalidateTimeout = TimeMs(60 * 60 * 1000);
 constexpr auto kNotifySettingSaveTimeout = TimeMs(1000);
+constexpr auto kReadRequestsDelay = TimeMs(500);
 
 using SimpleFileLocationId = Data::SimpleFileLocationId;
 using DocumentFileLocationId = Data::DocumentFileLocationId;
@@ -164,10 +169,14 @@ MTPInputPrivacyKey ApiWrap::Privacy::Input(Key key) {
 ApiWrap::ApiWrap(not_null<AuthSession*> session)
 : _session(session)
 , _messageDataResolveDelayed([=] { resolveMessageDatas(); })
+, _peerRequestsTimer([=] { sendPeerRequests(); })
 , _webPagesTimer([=] { resolveWebPages(); })
 , _draftsSaveTimer([=] { saveDraftsToCloud(); })
 , _featuredSetsReadTimer([=] { readFeaturedSets(); })
-, _fileLoader(std::make_unique<TaskQueue>(kFileLoaderQueueStopTimeout))
+, _readRequestsTimer([=] { sendPendingReads(); })
+, _fileLoader(std::make_unique<TaskQueue>(
+	kFileLoaderQueueStopTimeout,
+	snap(QThread::idealThreadCount(), 1, kFileLoaderMaxWorkers)))
 , _feedReadTimer([=] { readFeeds(); })
 , _proxyPromotionTimer([=] { refreshProxyPromotion(); })
 , _updateNotifySettingsTimer([=] { sendNotifySettingsUpdates(); }) {
@@ -621,25 +630,10 @@ void ApiWrap::requestDialogEntry(
 	if (!ok) {
 		return;
 	}
-	const auto finalize = [=] {
-		if (const auto callbacks = _dialogRequests.take(history)) {
-			for (const auto callback : *callbacks) {
-				callback();
-			}
-		}
-	};
-	auto peers = QVector<MTPInputDialogPeer>(
-		1,
-		MTP_inputDialogPeer(history->peer->input));
-	request(MTPmessages_GetPeerDialogs(
-		MTP_vector(std::move(peers))
-	)).done([=](const MTPmessages_PeerDialogs &result) {
-		applyPeerDialogs(result);
-		historyDialogEntryApplied(history);
-		finalize();
-	}).fail([=](const RPCError &error) {
-		finalize();
-	}).send();
+	_dialogRequestsPending.push_back(history);
+	if (!_peerRequestsTimer.isActive()) {
+		_peerRequestsTimer.callOnce(kPeerRequestsDelay);
+	}
 }
 
 void ApiWrap::requestDialogEntries(
@@ -649,14 +643,10 @@ void ApiWrap::requestDialogEntries(
 		return !ok;
 	};
 	histories.erase(ranges::remove_if(histories, already), end(histories));
-	if (histories.empty()) {
-		return;
-	}
-	auto peers = QVector<MTPInputDialogPeer>();
-	peers.reserve(histories.size());
-	for (const auto history : histories) {
-		peers.push_back(MTP_inputDialogPeer(history->peer->input));
-	}
+	sendDialogRequests(std::move(histories));
+}
+
+void ApiWrap::sendDialogRequests(std::vector<not_null<History*>> histories) {
 	const auto finalize = [=](std::vector<not_null<History*>> histories) {
 		for (const auto history : histories) {
 			if (const auto callbacks = _dialogRequests.take(history)) {
@@ -666,17 +656,29 @@ void ApiWrap::requestDialogEntries(
 			}
 		}
 	};
-	request(MTPmessages_GetPeerDialogs(
-		MTP_vector(std::move(peers))
-	)).done([=](const MTPmessages_PeerDialogs &result) {
-		applyPeerDialogs(result);
-		for (const auto history : histories) {
-			historyDialogEntryApplied(history);
+	for (auto from = begin(histories); from != end(histories);) {
+		const auto till = from
+			+ std::min(int(end(histories) - from), kDialogRequestsLimit);
+		auto chunk = std::vector<not_null<History*>>(from, till);
+		from = till;
+
+		auto peers = QVector<MTPInputDialogPeer>();
+		peers.reserve(chunk.size());
+		for (const auto history : chunk) {
+			peers.push_back(MTP_inputDialogPeer(history->peer->input));
 		}
-		finalize(histories);
-	}).fail([=](const RPCError &error) {
-		finalize(histories);
-	}).send();
+		request(MTPmessages_GetPeerDialogs(
+			MTP_vector(std::move(peers))
+		)).done([=](const MTPmessages_PeerDialogs &result) {
+			applyPeerDialogs(result);
+			for (const auto history : chunk) {
+				historyDialogEntryApplied(history);
+			}
+			finalize(chunk);
+		}).fail([=](const RPCError &error) {
+			finalize(chunk);
+		}).send();
+	}
 }
 
 void ApiWrap::applyPeerDialogs(const MTPmessages_PeerDialogs &dialogs) {
@@ -1037,52 +1039,149 @@ void ApiWrap::gotUserFull(UserData *user, const MTPUserFull &result, mtpRequestI
 void ApiWrap::requestPeer(PeerData *peer) {
 	if (!peer || _fullPeerRequests.contains(peer) || _peerRequests.contains(peer)) return;
 
-	auto sendRequest = [this, peer] {
-		auto failHandler = [this, peer](const RPCError &error) {
-			_peerRequests.remove(peer);
+	_peerRequests.insert(peer, 0);
+	if (!_peerRequestsTimer.isActive()) {
+		_peerRequestsTimer.callOnce(kPeerRequestsDelay);
+	}
+}
+
+void ApiWrap::sendPeerRequests() {
+	auto users = std::vector<not_null<PeerData*>>();
+	auto chats = std::vector<not_null<PeerData*>>();
+	auto channels = std::vector<not_null<PeerData*>>();
+	for (auto i = _peerRequests.cbegin(); i != _peerRequests.cend(); ++i) {
+		if (i.value()) {
+			continue;
+		}
+		const auto peer = i.key();
+		if (peer->isUser()) {
+			users.push_back(peer);
+		} else if (peer->isChat()) {
+			chats.push_back(peer);
+		} else if (peer->isChannel()) {
+			channels.push_back(peer);
+		}
+	}
+	const auto sendChunks = [&](
+			const std::vector<not_null<PeerData*>> &list,
+			auto send) {
+		for (auto from = begin(list); from != end(list);) {
+			const auto till = from
+				+ std::min(int(end(list) - from), kPeerRequestsLimit);
+			auto chunk = std::vector<not_null<PeerData*>>(from, till);
+			from = till;
+
+			const auto requestId = send(chunk);
+			for (const auto peer : chunk) {
+				_peerRequests.insert(peer, requestId);
+			}
+		}
+	};
+	const auto fail = [=](
+			const std::vector<not_null<PeerData*>> &peers) {
+		return [=](const RPCError &error, mtpRequestId requestId) {
+			peerRequestsDone(peers, requestId);
 		};
-		auto chatHandler = [this, peer](const MTPmessages_Chats &result) {
-			_peerRequests.remove(peer);
-
-			if (auto chats = Api::getChatsFromMessagesChats(result)) {
-				auto &v = chats->v;
-				bool badVersion = false;
-				if (const auto chat = peer->asChat()) {
-					badVersion = !v.isEmpty()
-						&& (v[0].type() == mtpc_chat)
-						&& (v[0].c_chat().vversion.v < chat->version);
-				} else if (const auto channel = peer->asChannel()) {
-					badVersion = !v.isEmpty()
-						&& (v[0].type() == mtpc_channel)
-						&& (v[0].c_channel().vversion.v < channel->version);
+	};
+	sendChunks(users, [&](const std::vector<not_null<PeerData*>> &peers) {
+		auto inputs = QVector<MTPInputUser>();
+		inputs.reserve(peers.size());
+		for (const auto peer : peers) {
+			inputs.push_back(peer->asUser()->inputUser);
+		}
+		return request(MTPusers_GetUsers(
+			MTP_vector<MTPInputUser>(std::move(inputs))
+		)).done([=](
+				const MTPVector<MTPUser> &result,
+				mtpRequestId requestId) {
+			peerRequestsDone(peers, requestId);
+			App::feedUsers(result);
+		}).fail(fail(peers)).send();
+	});
+	sendChunks(chats, [&](const std::vector<not_null<PeerData*>> &peers) {
+		auto inputs = QVector<MTPint>();
+		inputs.reserve(peers.size());
+		for (const auto peer : peers) {
+			inputs.push_back(peer->asChat()->inputChat);
+		}
+		return request(MTPmessages_GetChats(
+			MTP_vector<MTPint>(std::move(inputs))
+		)).done([=](
+				const MTPmessages_Chats &result,
+				mtpRequestId requestId) {
+			peerRequestsDone(peers, requestId);
+			gotPeerChats(result);
+		}).fail(fail(peers)).send();
+	});
+	sendChunks(channels, [&](const std::vector<not_null<PeerData*>> &peers) {
+		auto inputs = QVector<MTPInputChannel>();
+		inputs.reserve(peers.size());
+		for (const auto peer : peers) {
+			inputs.push_back(peer->asChannel()->inputChannel);
+		}
+		return request(MTPchannels_GetChannels(
+			MTP_vector<MTPInputChannel>(std::move(inputs))
+		)).done([=](
+				const MTPmessages_Chats &result,
+				mtpRequestId requestId) {
+			peerRequestsDone(peers, requestId);
+			gotPeerChats(result);
+		}).fail(fail(peers)).send();
+	});
+
+	sendDialogRequests(base::take(_dialogRequestsPending));
+}
+
+void ApiWrap::peerRequestsDone(
+		const std::vector<not_null<PeerData*>> &peers,
+		mtpRequestId requestId) {
+	for (const auto peer : peers) {
+		const auto i = _peerRequests.find(peer);
+		if (i != _peerRequests.end() && i.value() == requestId) {
+			_peerRequests.erase(i);
+		}
+	}
+}
+
+void ApiWrap::gotPeerChats(const MTPmessages_Chats &result) {
+	const auto chats = Api::getChatsFromMessagesChats(result);
+	if (!chats) {
+		return;
+	}
+
+	// If the server returned an older version than we know about, accept
+	// its version and request the peer once again.
+	auto outdatedChats = std::vector<std::pair<not_null<ChatData*>, int>>();
+	auto outdatedChannels = std::vector<
+		std::pair<not_null<ChannelData*>, int>>();
+	for (const auto &chat : chats->v) {
+		switch (chat.type()) {
+		case mtpc_chat: {
+			const auto &data = chat.c_chat();
+			if (const auto peer = App::chatLoaded(data.vid.v)) {
+				if (data.vversion.v < peer->version) {
+					outdatedChats.emplace_back(peer, data.vversion.v);
 				}
-				auto chat = App::feedChats(*chats);
-				if (chat == peer) {
-					if (badVersion) {
-						if (auto chat = peer->asChat()) {
-							chat->version = v[0].c_chat().vversion.v;
-						} else if (auto channel = peer->asChannel()) {
-							channel->version = v[0].c_channel().vversion.v;
-						}
-						requestPeer(peer);
-					}
+			}
+		} break;
+		case mtpc_channel: {
+			const auto &data = chat.c_channel();
+			if (const auto peer = App::channelLoaded(data.vid.v)) {
+				if (data.vversion.v < peer->version) {
+					outdatedChannels.emplace_back(peer, data.vversion.v);
 				}
 			}
-		};
-		if (auto user = peer->asUser()) {
-			return request(MTPusers_GetUsers(MTP_vector<MTPInputUser>(1, user->inputUser))).done([this, user](const MTPVector<MTPUser> &result) {
-				_peerRequests.remove(user);
-				App::feedUsers(result);
-			}).fail(failHandler).send();
-		} else if (auto chat = peer->asChat()) {
-			return request(MTPmessages_GetChats(MTP_vector<MTPint>(1, chat->inputChat))).done(chatHandler).fail(failHandler).send();
-		} else if (auto channel = peer->asChannel()) {
-			return request(MTPchannels_GetChannels(MTP_vector<MTPInputChannel>(1, channel->inputChannel))).done(chatHandler).fail(failHandler).send();
+		} break;
 		}
-		return 0;
-	};
-	if (auto requestId = sendRequest()) {
-		_peerRequests.insert(peer, requestId);
+	}
+	App::feedChats(*chats);
+	for (const auto [chat, version] : outdatedChats) {
+		chat->version = version;
+		requestPeer(chat);
+	}
+	for (const auto [channel, version] : outdatedChannels) {
+		channel->version = version;
+		requestPeer(channel);
 	}
 }
 
@@ -1092,33 +1191,8 @@ void ApiWrap::markMediaRead(
 	auto channelMarkedIds = base::flat_map<
 		not_null<ChannelData*>,
 		QVector<MTPint>>();
-	markedIds.reserve(items.size());
 	for (const auto item : items) {
-		if (!item->isMediaUnread() || (item->out() && !item->mentionsMe())) {
-			continue;
-		}
-		item->markMediaRead();
-		if (!IsServerMsgId(item->id)) {
-			continue;
-		}
-		if (const auto channel = item->history()->peer->asChannel()) {
-			channelMarkedIds[channel].push_back(MTP_int(item->id));
-		} else {
-			markedIds.push_back(MTP_int(item->id));
-		}
-	}
-	if (!markedIds.isEmpty()) {
-		request(MTPmessages_ReadMessageContents(
-			MTP_vector<MTPint>(markedIds)
-		)).done([=](const MTPmessages_AffectedMessages &result) {
-			applyAffectedMessages(result);
-		}).send();
-	}
-	for (const auto &channelIds : channelMarkedIds) {
-		request(MTPchannels_ReadMessageContents(
-			channelIds.first->inputChannel,
-			MTP_vector<MTPint>(channelIds.second)
-		)).send();
+		markMediaRead(item);
 	}
 }
 
@@ -1130,53 +1204,35 @@ void ApiWrap::markMediaRead(not_null<HistoryItem*> item) {
 	if (!IsServerMsgId(item->id)) {
 		return;
 	}
-	const auto ids = MTP_vector<MTPint>(1, MTP_int(item->id));
 	if (const auto channel = item->history()->peer->asChannel()) {
-		request(MTPchannels_ReadMessageContents(
-			channel->inputChannel,
-			ids
-		)).send();
+		_mediaReadChannelIds[channel].push_back(MTP_int(item->id));
 	} else {
+		_mediaReadIds.push_back(MTP_int(item->id));
+	}
+	if (!_readRequestsTimer.isActive()) {
+		_readRequestsTimer.callOnce(kReadRequestsDelay);
+	}
+}
+
+void ApiWrap::sendMediaReadRequests() {
+	if (!_mediaReadIds.isEmpty()) {
 		request(MTPmessages_ReadMessageContents(
-			ids
+			MTP_vector<MTPint>(base::take(_mediaReadIds))
 		)).done([=](const MTPmessages_AffectedMessages &result) {
 			applyAffectedMessages(result);
 		}).send();
 	}
+	for (const auto &[channel, ids] : base::take(_mediaReadChannelIds)) {
+		request(MTPchannels_ReadMessageContents(
+			channel->inputChannel,
+			MTP_vector<MTPint>(ids)
+		)).send();
+	}
 }
 
 void ApiWrap::requestPeers(const QList<PeerData*> &peers) {
-	QVector<MTPint> chats;
-	QVector<MTPInputChannel> channels;
-	QVector<MTPInputUser> users;
-	chats.reserve(peers.size());
-	channels.reserve(peers.size());
-	users.reserve(peers.size());
-	for (QList<PeerData*>::const_iterator i = peers.cbegin(), e = peers.cend(); i != e; ++i) {
-		if (!*i || _fullPeerRequests.contains(*i) || _peerRequests.contains(*i)) continue;
-		if ((*i)->isUser()) {
-			users.push_back((*i)->asUser()->inputUser);
-		} else if ((*i)->isChat()) {
-			chats.push_back((*i)->asChat()->inputChat);
-		} else if ((*i)->isChannel()) {
-			channels.push_back((*i)->asChannel()->inputChannel);
-		}
-	}
-	auto handleChats = [=](const MTPmessages_Chats &result) {
-		if (auto chats = Api::getChatsFromMessagesChats(result)) {
-			App::feedChats(*chats);
-		}
-	};
-	if (!chats.isEmpty()) {
-		request(MTPmessages_GetChats(MTP_vector<MTPint>(chats))).done(handleChats).send();
-	}
-	if (!channels.isEmpty()) {
-		request(MTPchannels_GetChannels(MTP_vector<MTPInputChannel>(channels))).done(handleChats).send();
-	}
-	if (!users.isEmpty()) {
-		request(MTPusers_GetUsers(MTP_vector<MTPInputUser>(users))).done([=](const MTPVector<MTPUser> &result) {
-			App::feedUsers(result);
-		}).send();
+	for (const auto peer : peers) {
+		requestPeer(peer);
 	}
 }
 
@@ -4189,7 +4245,8 @@ void ApiWrap::sendVoiceMessage(
 		QByteArray result,
 		VoiceWaveform waveform,
 		int duration,
-		const SendOptions &options) {
+		const SendOptions &options,
+		uint64 uploadAheadId) {
 	const auto caption = TextWithTags();
 	const auto to = fileLoadTaskOptions(options);
 	_fileLoader->addTask(std::make_unique<FileLoadTask>(
@@ -4197,7 +4254,8 @@ void ApiWrap::sendVoiceMessage(
 		duration,
 		waveform,
 		to,
-		caption));
+		caption,
+		uploadAheadId));
 }
 
 void ApiWrap::sendFiles(
@@ -4233,14 +4291,18 @@ void ApiWrap::sendFiles(
 			default: Unexpected("AlbumType in uploadFilesAfterConfirmation");
 			}
 		}
-		tasks.push_back(std::make_unique<FileLoadTask>(
+		auto task = std::make_unique<FileLoadTask>(
 			file.path,
 			file.content,
 			std::move(file.information),
 			type,
 			to,
 			caption,
-			album));
+			album);
+		if (type == SendMediaType::File && file.content.isEmpty()) {
+			_session->uploader().uploadAhead(task->fileid(), file.path);
+		}
+		tasks.push_back(std::move(task));
 	}
 	if (album) {
 		_sendingAlbums.emplace(album->groupId, album);
@@ -5231,16 +5293,30 @@ void ApiWrap::readServerHistoryForce(not_null<History*> history) {
 		}
 	}
 
-	if (_readRequests.contains(peer)) {
-		const auto i = _readRequestsPending.find(peer);
-		if (i == _readRequestsPending.cend()) {
-			_readRequestsPending.emplace(peer, upTo);
-		} else if (i->second < upTo) {
-			i->second = upTo;
+	// Reads of a quickly scrolled history are collapsed into one request.
+	const auto i = _readRequestsPending.find(peer);
+	if (i == _readRequestsPending.cend()) {
+		_readRequestsPending.emplace(peer, upTo);
+	} else if (i->second < upTo) {
+		i->second = upTo;
+	}
+	if (!_readRequestsTimer.isActive()) {
+		_readRequestsTimer.callOnce(kReadRequestsDelay);
+	}
+}
+
+void ApiWrap::sendPendingReads() {
+	auto &pending = _readRequestsPending;
+	for (auto i = begin(pending); i != end(pending);) {
+		// The rest will be sent when the current requests finish.
+		if (_readRequests.contains(i->first)) {
+			++i;
+		} else {
+			sendReadRequest(i->first, i->second);
+			i = pending.erase(i);
 		}
-	} else {
-		sendReadRequest(peer, upTo);
 	}
+	sendMediaReadRequests();
 }
 
 void ApiWrap::readFeed(
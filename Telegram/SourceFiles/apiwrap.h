@@ -289,7 +289,8 @@ public:
 		QByteArray result,
 		VoiceWaveform waveform,
 		int duration,
-		const SendOptions &options);
+		const SendOptions &options,
+		uint64 uploadAheadId = 0);
 	void sendFiles(
 		Storage::PreparedList &&list,
 		SendMediaType type,
@@ -405,6 +406,12 @@ private:
 	MessageDataRequests *messageDataRequests(ChannelData *channel, bool onlyExisting = false);
 	void applyPeerDialogs(const MTPmessages_PeerDialogs &dialogs);
 	void historyDialogEntryApplied(not_null<History*> history);
+	void sendDialogRequests(std::vector<not_null<History*>> histories);
+	void sendPeerRequests();
+	void peerRequestsDone(
+		const std::vector<not_null<PeerData*>> &peers,
+		mtpRequestId requestId);
+	void gotPeerChats(const MTPmessages_Chats &result);
 	void applyFeedDialogs(
 		not_null<Data::Feed*> feed,
 		const MTPmessages_Dialogs &dialogs);
@@ -501,6 +508,8 @@ private:
 		const SendOptions &options);
 
 	void sendReadRequest(not_null<PeerData*> peer, MsgId upTo);
+	void sendPendingReads();
+	void sendMediaReadRequests();
 	int applyAffectedHistory(
 		not_null<PeerData*> peer,
 		const MTPmessages_AffectedHistory &result);
@@ -570,6 +579,11 @@ private:
 	PeerRequests _fullPeerRequests;
 	PeerRequests _peerRequests;
 
+	// Peers and dialog entries requested within a short window are sent
+	// in batches, the waiting peers have zero in _peerRequests.
+	std::vector<not_null<History*>> _dialogRequestsPending;
+	base::Timer _peerRequestsTimer;
+
 	PeerRequests _participantsRequests;
 	PeerRequests _botsRequests;
 	PeerRequests _adminsRequests;
@@ -678,6 +692,11 @@ private:
 	};
 	base::flat_map<not_null<PeerData*>, ReadRequest> _readRequests;
 	base::flat_map<not_null<PeerData*>, MsgId> _readRequestsPending;
+	QVector<MTPint> _mediaReadIds;
+	base::flat_map<
+		not_null<ChannelData*>,
+		QVector<MTPint>> _mediaReadChannelIds;
+	base::Timer _readRequestsTimer;
 
 	std::unique_ptr<TaskQueue> _fileLoader;
 	base::flat_map<uint64, std::shared_ptr<SendingAlbum>> _sendingAlbums;
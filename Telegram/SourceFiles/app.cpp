@@ -58,11 +58,6 @@ namespace {
 
 	Histories histories;
 
-	using MsgsData = QHash<MsgId, HistoryItem*>;
-	MsgsData msgsData;
-	using ChannelMsgsData = QMap<ChannelId, MsgsData>;
-	ChannelMsgsData channelMsgsData;
-
 	using RandomData = QMap<uint64, FullMsgId>;
 	RandomData randomData;
 
@@ -79,6 +74,7 @@ namespace {
 
 	struct CornersPixmaps {
 		QPixmap p[4];
+		bool ready = false; // Palette corners are prepared on first use.
 	};
 	QVector<CornersPixmaps> corners;
 	using CornersMap = QMap<uint32, CornersPixmaps>;
@@ -920,7 +916,10 @@ namespace App {
 	}
 
 	void feedMsgs(const QVector<MTPMessage> &msgs, NewMessageType type) {
-		auto indices = base::flat_map<uint64, int>();
+		// Inserting into a flat_map one by one is quadratic for the
+		// thousands of unordered messages of a difference, sort once.
+		auto indices = std::vector<std::pair<uint64, int>>();
+		indices.reserve(msgs.size());
 		for (int i = 0, l = msgs.size(); i != l; ++i) {
 			const auto &msg = msgs[i];
 			if (msg.type() == mtpc_message) {
@@ -933,8 +932,9 @@ namespace App {
 				}
 			}
 			const auto msgId = idFromMessage(msg);
-			indices.emplace((uint64(uint32(msgId)) << 32) | uint64(i), i);
+			indices.emplace_back((uint64(uint32(msgId)) << 32) | uint64(i), i);
 		}
+		ranges::sort(indices);
 		for (const auto [position, index] : indices) {
 			histories().addNewMessage(msgs[index], type);
 		}
@@ -1010,35 +1010,19 @@ namespace App {
 		}
 	}
 
-	inline MsgsData *fetchMsgsData(ChannelId channelId, bool insert = true) {
-		if (channelId == NoChannel) return &msgsData;
-		ChannelMsgsData::iterator i = channelMsgsData.find(channelId);
-		if (i == channelMsgsData.cend()) {
-			if (insert) {
-				i = channelMsgsData.insert(channelId, MsgsData());
-			} else {
-				return 0;
-			}
-		}
-		return &(*i);
-	}
-
 	void feedWereDeleted(
 			ChannelId channelId,
 			const QVector<MTPint> &msgsIds) {
-		const auto data = fetchMsgsData(channelId, false);
-		if (!data) return;
-
+		const auto &messages = Auth().data().messages();
 		const auto affectedHistory = (channelId != NoChannel)
 			? App::history(peerFromChannel(channelId)).get()
 			: nullptr;
 
 		auto historiesToCheck = base::flat_set<not_null<History*>>();
 		for (const auto msgId : msgsIds) {
-			auto j = data->constFind(msgId.v);
-			if (j != data->cend()) {
-				const auto history = (*j)->history();
-				(*j)->destroy();
+			if (const auto item = messages.find({ channelId, msgId.v })) {
+				const auto history = item->history();
+				item->destroy();
 				if (!history->lastMessageKnown()) {
 					historiesToCheck.emplace(history);
 				}
@@ -1173,40 +1157,22 @@ namespace App {
 	}
 
 	HistoryItem *histItemById(ChannelId channelId, MsgId itemId) {
-		if (!itemId) return nullptr;
-
-		auto data = fetchMsgsData(channelId, false);
-		if (!data) return nullptr;
-
-		auto i = data->constFind(itemId);
-		if (i != data->cend()) {
-			return i.value();
+		if (!itemId || !AuthSession::Exists()) {
+			return nullptr;
 		}
-		return nullptr;
+		return Auth().data().messages().find({ channelId, itemId });
 	}
 
 	void historyRegItem(not_null<HistoryItem*> item) {
-		const auto data = fetchMsgsData(item->channelId());
-		const auto i = data->constFind(item->id);
-		if (i == data->cend()) {
-			data->insert(item->id, item);
-		} else if (i.value() != item) {
+		const auto was = Auth().data().messages().insert(item);
+		if (was && was != item) {
 			LOG(("App Error: trying to historyRegItem() an already registered item"));
-			i.value()->destroy();
-			data->insert(item->id, item);
+			was->destroy();
 		}
 	}
 
 	void historyUnregItem(not_null<HistoryItem*> item) {
-		const auto data = fetchMsgsData(item->channelId(), false);
-		if (!data) return;
-
-		const auto i = data->find(item->id);
-		if (i != data->cend()) {
-			if (i.value() == item) {
-				data->erase(i);
-			}
-		}
+		Auth().data().messages().remove(item);
 		const auto j = ::dependentItems.find(item);
 		if (j != ::dependentItems.cend()) {
 			DependentItemsSet items;
@@ -1234,13 +1200,8 @@ namespace App {
 
 	void historyClearMsgs() {
 		::dependentItems.clear();
-		const auto oldData = base::take(msgsData);
-		const auto oldChannelData = base::take(channelMsgsData);
-		for (const auto item : oldData) {
-			delete item;
-		}
-		for (const auto &data : oldChannelData) {
-			for (const auto item : data) {
+		if (AuthSession::Exists()) {
+			for (const auto item : Auth().data().messages().takeAll()) {
 				delete item;
 			}
 		}
@@ -1365,40 +1326,107 @@ namespace App {
 		}
 	}
 
-	void createPaletteCorners() {
-		prepareCorners(MenuCorners, st::buttonRadius, st::menuBg);
-		prepareCorners(BoxCorners, st::boxRadius, st::boxBg);
-		prepareCorners(BotKbOverCorners, st::dateRadius, st::msgBotKbOverBgAdd);
-		prepareCorners(StickerCorners, st::dateRadius, st::msgServiceBg);
-		prepareCorners(StickerSelectedCorners, st::dateRadius, st::msgServiceBgSelected);
-		prepareCorners(SelectedOverlaySmallCorners, st::buttonRadius, st::msgSelectOverlay);
-		prepareCorners(SelectedOverlayLargeCorners, st::historyMessageRadius, st::msgSelectOverlay);
-		prepareCorners(DateCorners, st::dateRadius, st::msgDateImgBg);
-		prepareCorners(DateSelectedCorners, st::dateRadius, st::msgDateImgBgSelected);
-		prepareCorners(InShadowCorners, st::historyMessageRadius, st::msgInShadow);
-		prepareCorners(InSelectedShadowCorners, st::historyMessageRadius, st::msgInShadowSelected);
-		prepareCorners(ForwardCorners, st::historyMessageRadius, st::historyForwardChooseBg);
-		prepareCorners(MediaviewSaveCorners, st::mediaviewControllerRadius, st::mediaviewSaveMsgBg);
-		prepareCorners(EmojiHoverCorners, st::buttonRadius, st::emojiPanHover);
-		prepareCorners(StickerHoverCorners, st::buttonRadius, st::emojiPanHover);
-		prepareCorners(BotKeyboardCorners, st::buttonRadius, st::botKbBg);
-		prepareCorners(PhotoSelectOverlayCorners, st::buttonRadius, st::overviewPhotoSelectOverlay);
-
-		prepareCorners(Doc1Corners, st::buttonRadius, st::msgFile1Bg);
-		prepareCorners(Doc2Corners, st::buttonRadius, st::msgFile2Bg);
-		prepareCorners(Doc3Corners, st::buttonRadius, st::msgFile3Bg);
-		prepareCorners(Doc4Corners, st::buttonRadius, st::msgFile4Bg);
-
-		prepareCorners(MessageInCorners, st::historyMessageRadius, st::msgInBg, &st::msgInShadow);
-		prepareCorners(MessageInSelectedCorners, st::historyMessageRadius, st::msgInBgSelected, &st::msgInShadowSelected);
-		prepareCorners(MessageOutCorners, st::historyMessageRadius, st::msgOutBg, &st::msgOutShadow);
-		prepareCorners(MessageOutSelectedCorners, st::historyMessageRadius, st::msgOutBgSelected, &st::msgOutShadowSelected);
+	void preparePaletteCorners(RoundCorners index) {
+		switch (index) {
+		case MenuCorners:
+			prepareCorners(MenuCorners, st::buttonRadius, st::menuBg);
+			break;
+		case BoxCorners:
+			prepareCorners(BoxCorners, st::boxRadius, st::boxBg);
+			break;
+		case BotKbOverCorners:
+			prepareCorners(BotKbOverCorners, st::dateRadius, st::msgBotKbOverBgAdd);
+			break;
+		case StickerCorners:
+			prepareCorners(StickerCorners, st::dateRadius, st::msgServiceBg);
+			break;
+		case StickerSelectedCorners:
+			prepareCorners(StickerSelectedCorners, st::dateRadius, st::msgServiceBgSelected);
+			break;
+		case SelectedOverlaySmallCorners:
+			prepareCorners(SelectedOverlaySmallCorners, st::buttonRadius, st::msgSelectOverlay);
+			break;
+		case SelectedOverlayLargeCorners:
+			prepareCorners(SelectedOverlayLargeCorners, st::historyMessageRadius, st::msgSelectOverlay);
+			break;
+		case DateCorners:
+			prepareCorners(DateCorners, st::dateRadius, st::msgDateImgBg);
+			break;
+		case DateSelectedCorners:
+			prepareCorners(DateSelectedCorners, st::dateRadius, st::msgDateImgBgSelected);
+			break;
+		case InShadowCorners:
+			prepareCorners(InShadowCorners, st::historyMessageRadius, st::msgInShadow);
+			break;
+		case InSelectedShadowCorners:
+			prepareCorners(InSelectedShadowCorners, st::historyMessageRadius, st::msgInShadowSelected);
+			break;
+		case ForwardCorners:
+			prepareCorners(ForwardCorners, st::historyMessageRadius, st::historyForwardChooseBg);
+			break;
+		case MediaviewSaveCorners:
+			prepareCorners(MediaviewSaveCorners, st::mediaviewControllerRadius, st::mediaviewSaveMsgBg);
+			break;
+		case EmojiHoverCorners:
+			prepareCorners(EmojiHoverCorners, st::buttonRadius, st::emojiPanHover);
+			break;
+		case StickerHoverCorners:
+			prepareCorners(StickerHoverCorners, st::buttonRadius, st::emojiPanHover);
+			break;
+		case BotKeyboardCorners:
+			prepareCorners(BotKeyboardCorners, st::buttonRadius, st::botKbBg);
+			break;
+		case PhotoSelectOverlayCorners:
+			prepareCorners(PhotoSelectOverlayCorners, st::buttonRadius, st::overviewPhotoSelectOverlay);
+			break;
+		case Doc1Corners:
+			prepareCorners(Doc1Corners, st::buttonRadius, st::msgFile1Bg);
+			break;
+		case Doc2Corners:
+			prepareCorners(Doc2Corners, st::buttonRadius, st::msgFile2Bg);
+			break;
+		case Doc3Corners:
+			prepareCorners(Doc3Corners, st::buttonRadius, st::msgFile3Bg);
+			break;
+		case Doc4Corners:
+			prepareCorners(Doc4Corners, st::buttonRadius, st::msgFile4Bg);
+			break;
+		case MessageInCorners:
+			prepareCorners(MessageInCorners, st::historyMessageRadius, st::msgInBg, &st::msgInShadow);
+			break;
+		case MessageInSelectedCorners:
+			prepareCorners(MessageInSelectedCorners, st::historyMessageRadius, st::msgInBgSelected, &st::msgInShadowSelected);
+			break;
+		case MessageOutCorners:
+			prepareCorners(MessageOutCorners, st::historyMessageRadius, st::msgOutBg, &st::msgOutShadow);
+			break;
+		case MessageOutSelectedCorners:
+			prepareCorners(MessageOutSelectedCorners, st::historyMessageRadius, st::msgOutBgSelected, &st::msgOutShadowSelected);
+			break;
+		default: Unexpected("Index in App::preparePaletteCorners.");
+		}
+	}
+
+	void invalidatePaletteCorners() {
+		for (auto &corners : ::corners) {
+			corners.ready = false;
+		}
+	}
+
+	const CornersPixmaps &paletteCorners(RoundCorners index) {
+		Expects(::corners.size() > index);
+
+		auto &result = ::corners[index];
+		if (!result.ready) {
+			preparePaletteCorners(index);
+			result.ready = true;
+		}
+		return result;
 	}
 
 	void createCorners() {
 		::corners.resize(RoundCornersCount);
 		createMaskCorners();
-		createPaletteCorners();
 	}
 
 	void clearCorners() {
@@ -1422,15 +1450,15 @@ namespace App {
 		using Update = Window::Theme::BackgroundUpdate;
 		static auto subscription = Window::Theme::Background()->add_subscription([](const Update &update) {
 			if (update.paletteChanged()) {
-				createPaletteCorners();
+				invalidatePaletteCorners();
 
 				if (App::main()) {
 					App::main()->updateScrollColors();
 				}
 				HistoryView::serviceColorsUpdated();
 			} else if (update.type == Update::Type::New) {
-				prepareCorners(StickerCorners, st::dateRadius, st::msgServiceBg);
-				prepareCorners(StickerSelectedCorners, st::dateRadius, st::msgServiceBgSelected);
+				::corners[StickerCorners].ready = false;
+				::corners[StickerSelectedCorners].ready = false;
 
 				if (App::main()) {
 					App::main()->updateScrollColors();
@@ -1638,7 +1666,7 @@ namespace App {
 			| corners;
 		roundRect(p, rect, bg, index, nullptr, parts);
 		if ((corners & RectPart::AllCorners) != RectPart::AllCorners) {
-			const auto size = ::corners[index].p[0].width() / cIntRetinaFactor();
+			const auto size = paletteCorners(index).p[0].width() / cIntRetinaFactor();
 			if (!(corners & RectPart::TopLeft)) {
 				p.fillRect(rect.x(), rect.y(), size, size, bg);
 			}
@@ -1727,11 +1755,11 @@ namespace App {
 	}
 
 	void roundRect(Painter &p, int32 x, int32 y, int32 w, int32 h, style::color bg, RoundCorners index, const style::color *shadow, RectParts parts) {
-		roundRect(p, x, y, w, h, bg, ::corners[index], shadow, parts);
+		roundRect(p, x, y, w, h, bg, paletteCorners(index), shadow, parts);
 	}
 
 	void roundShadow(Painter &p, int32 x, int32 y, int32 w, int32 h, style::color shadow, RoundCorners index, RectParts parts) {
-		auto &corner = ::corners[index];
+		auto &corner = paletteCorners(index);
 		auto cornerWidth = corner.p[0].width() / cIntRetinaFactor();
 		auto cornerHeight = corner.p[0].height() / cIntRetinaFactor();
 		if (parts & RectPart::Bottom) {
@@ -19,6 +19,9 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 #include "base/qthelp_url.h"
 #include "base/qthelp_regex.h"
 #include "core/update_checker.h"
+#include "core/startup_trace.h"
+#include "core/stall_detector.h"
+#include "core/paint_profiler.h"
 #include "core/crash_report_window.h"
 
 namespace {
@@ -144,6 +147,12 @@ bool Application::event(QEvent *e) {
 	return QApplication::event(e);
 }
 
+bool Application::notify(QObject *receiver, QEvent *e) {
+	const auto scope = Core::StallDetector::EventScope(receiver, e);
+	const auto paint = Core::PaintProfiler::EventScope(receiver, e);
+	return QApplication::notify(receiver, e);
+}
+
 void Application::socketConnected() {
 	LOG(("Socket connected, this is not the first application instance, sending show command..."));
 	_secondInstance = true;
@@ -355,6 +364,8 @@ void Application::startApplication() {
 void Application::createMessenger() {
 	Expects(!App::quitting());
 
+	const auto trace = Core::StartupTrace::Scope("Messenger");
+	_stallDetector = std::make_unique<Core::StallDetector>();
 	_messengerInstance = std::make_unique<Messenger>(_launcher);
 }
 
@@ -385,6 +396,7 @@ void Application::closeApplication() {
 	if (App::launchState() == App::QuitProcessed) return;
 	App::setLaunchState(App::QuitProcessed);
 
+	_stallDetector = nullptr;
 	_messengerInstance.reset();
 
 	Sandbox::finish();
@@ -10,6 +10,7 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 namespace Core {
 class Launcher;
 class UpdateChecker;
+class StallDetector;
 } // namespace Core
 
 bool InternalPassportLink(const QString &url);
@@ -22,6 +23,7 @@ public:
 	Application(not_null<Core::Launcher*> launcher, int &argc, char **argv);
 
 	bool event(QEvent *e) override;
+	bool notify(QObject *receiver, QEvent *e) override;
 
 	void createMessenger();
 	void refreshGlobalProxy();
@@ -51,6 +53,7 @@ private:
 	typedef QList<LocalClient> LocalClients;
 
 	not_null<Core::Launcher*> _launcher;
+	std::unique_ptr<Core::StallDetector> _stallDetector;
 	std::unique_ptr<Messenger> _messengerInstance;
 
 	QString _localServerName, _localSocketReadData;
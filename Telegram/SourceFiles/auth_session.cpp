@@ -10,6 +10,7 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 #include "apiwrap.h"
 #include "messenger.h"
 #include "core/changelogs.h"
+#include "core/memory_stats.h"
 #include "storage/file_download.h"
 #include "storage/file_upload.h"
 #include "storage/localstorage.h"
@@ -347,6 +348,7 @@ AuthSession::AuthSession(const MTPUser &user)
 , _storage(std::make_unique<Storage::Facade>())
 , _notifications(std::make_unique<Window::Notifications::System>(this))
 , _data(std::make_unique<Data::Session>(this))
+, _memoryStats(std::make_unique<Core::MemoryStats>(this))
 , _changelogs(Core::Changelogs::Create(this))
 , _supportTemplates(
 	(Support::ValidateAccount(user)
@@ -55,6 +55,7 @@ enum class SelectorTab;
 
 namespace Core {
 class Changelogs;
+class MemoryStats;
 } // namespace Core
 
 class AuthSessionSettings final {
@@ -287,6 +288,9 @@ public:
 	Data::Session &data() {
 		return *_data;
 	}
+	Core::MemoryStats &memoryStats() {
+		return *_memoryStats;
+	}
 	AuthSessionSettings &settings() {
 		return _settings;
 	}
@@ -335,6 +339,9 @@ private:
 	// _data depends on _downloader / _uploader, including destructor.
 	const std::unique_ptr<Data::Session> _data;
 
+	// _memoryStats depends on _data, subscribes on the cache stats.
+	const std::unique_ptr<Core::MemoryStats> _memoryStats;
+
 	// _changelogs depends on _data, subscribes on chats loading event.
 	const std::unique_ptr<Core::Changelogs> _changelogs;
 
@@ -0,0 +1,50 @@
+/*
+This file is part of Telegram Desktop,
+the official desktop application for the Telegram messaging service.
+
+For license and copyright information please follow this link:
+https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
+*/
+#pragma once
+
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace base {
+namespace benchmark {
+
+struct record {
+	std::string name;
+	double value = 0.;
+	std::string unit;
+};
+
+// Reported by the "[benchmark]" test cases, written out by tests_main.cpp.
+inline std::vector<record> &records() {
+	static auto result = std::vector<record>();
+	return result;
+}
+
+inline void report(
+		const std::string &name,
+		double value,
+		const std::string &unit) {
+	std::cout << name << ": " << value << ' ' << unit << std::endl;
+	records().push_back({ name, value, unit });
+}
+
+// Reports the time the action took in milliseconds.
+template <typename Action>
+void measure(const std::string &name, Action &&action) {
+	using clock = std::chrono::steady_clock;
+	const auto start = clock::now();
+	action();
+	const auto elapsed = std::chrono::duration<double, std::milli>(
+		clock::now() - start).count();
+	report(name, elapsed, "ms");
+}
+
+} // namespace benchmark
+} // namespace base
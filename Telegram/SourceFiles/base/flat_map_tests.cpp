@@ -8,7 +8,10 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 #include "catch.hpp"
 
 #include "base/flat_map.h"
+#include "base/benchmark.h"
 #include <string>
+#include <vector>
+#include <cstdint>
 
 struct int_wrap {
 	int value;
@@ -91,3 +94,42 @@ TEST_CASE("flat_maps custom comparator", "[flat_map]") {
 		checkSorted();
 	}
 }
+
+// Hidden, run by the tests_benchmarks target.
+TEST_CASE("flat_map benchmarks", "[.][benchmark]") {
+	constexpr auto kCount = 100000;
+
+	// Random order keys, like peer ids coming from the server.
+	auto keys = std::vector<int>(kCount);
+	auto seed = uint32_t(0);
+	for (auto &key : keys) {
+		seed = seed * 1103515245U + 12345U;
+		key = int(seed >> 1);
+	}
+	auto v = base::flat_map<int, int>();
+	base::benchmark::measure("flat_map: 100K random emplaces", [&] {
+		for (auto i = 0; i != kCount; ++i) {
+			v.emplace(keys[i], i);
+		}
+	});
+	auto found = 0;
+	base::benchmark::measure("flat_map: 1M finds", [&] {
+		for (auto i = 0; i != 10 * kCount; ++i) {
+			found += (v.find(keys[i % kCount]) != v.end()) ? 1 : 0;
+		}
+	});
+	REQUIRE(found == 10 * kCount);
+
+	auto sorted = base::flat_map<int, int>();
+	base::benchmark::measure("flat_map: 100K ascending emplaces", [&] {
+		for (auto i = 0; i != kCount; ++i) {
+			sorted.emplace(i, i);
+		}
+	});
+	base::benchmark::measure("flat_map: 100K random removes", [&] {
+		for (auto i = 0; i != kCount; ++i) {
+			v.remove(keys[i]);
+		}
+	});
+	REQUIRE(v.empty());
+}
@@ -396,8 +396,7 @@ public:
 		typename Iterator,
 		typename = typename std::iterator_traits<Iterator>::iterator_category>
 	void merge(Iterator first, Iterator last) {
-		impl().insert(impl().end(), first, last);
-		std::sort(std::begin(impl()), std::end(impl()), compare());
+		mergeAndGetFirstChanged(first, last);
 	}
 
 	void merge(const flat_multi_set<Type, Compare> &other) {
@@ -411,6 +410,29 @@ public:
 private:
 	friend class flat_set<Type, Compare>;
 
+	// Returns the index of the first element that could have been moved,
+	// all the elements before it stayed untouched.
+	template <typename Iterator>
+	size_type mergeAndGetFirstChanged(Iterator first, Iterator last) {
+		// Usually a sorted range is merged, so only the added part is
+		// sorted (if needed) and then merged with the existing elements.
+		const auto initial = impl().size();
+		impl().insert(impl().end(), first, last);
+		const auto from = std::begin(impl());
+		const auto middle = from + initial;
+		const auto till = std::end(impl());
+		if (!std::is_sorted(middle, till, compare())) {
+			std::sort(middle, till, compare());
+		}
+		if (middle != from
+			&& middle != till
+			&& compare()(*middle, *(middle - 1))) {
+			std::inplace_merge(from, middle, till, compare());
+			return 0;
+		}
+		return initial;
+	}
+
 	struct transparent_compare : Compare {
 		inline constexpr const Compare &initial() const noexcept {
 			return *this;
@@ -688,8 +710,10 @@ public:
 		typename Iterator,
 		typename = typename std::iterator_traits<Iterator>::iterator_category>
 	void merge(Iterator first, Iterator last) {
-		parent::merge(first, last);
-		finalize();
+		const auto changed = parent::mergeAndGetFirstChanged(first, last);
+
+		// The element before the appended ones may be equal to the first.
+		finalize(changed ? (changed - 1) : 0);
 	}
 
 	void merge(const flat_multi_set<Type, Compare> &other) {
@@ -701,10 +725,10 @@ public:
 	}
 
 private:
-	void finalize() {
+	void finalize(size_type from = 0) {
 		this->impl().erase(
 			std::unique(
-				std::begin(this->impl()),
+				std::begin(this->impl()) + from,
 				std::end(this->impl()),
 				[&](auto &&a, auto &&b) {
 					return !this->compare()(a, b);
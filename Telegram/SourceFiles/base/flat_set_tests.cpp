@@ -8,6 +8,9 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 #include "catch.hpp"
 
 #include "base/flat_set.h"
+#include "base/benchmark.h"
+
+#include <vector>
 
 struct int_wrap {
 	int value;
@@ -82,3 +85,59 @@ TEST_CASE("flat_sets with custom comparators", "[flat_set]") {
 		checkSorted();
 	}
 }
+
+TEST_CASE("flat_set merge", "[flat_set]") {
+	base::flat_set<int> v{ 1, 3, 5, 7 };
+
+	auto checkSorted = [&] {
+		auto prev = v.begin();
+		REQUIRE(prev != v.end());
+		for (auto i = prev + 1; i != v.end(); prev = i, ++i) {
+			REQUIRE(*prev < *i);
+		}
+	};
+
+	SECTION("merging a sorted range skips duplicates") {
+		const auto other = std::vector<int>{ 0, 3, 4, 7, 8 };
+		v.merge(other.begin(), other.end());
+		REQUIRE(v.size() == 7);
+		checkSorted();
+	}
+	SECTION("merging an unsorted range") {
+		const auto other = std::vector<int>{ 8, 2, 5, 2, 0 };
+		v.merge(other.begin(), other.end());
+		REQUIRE(v.size() == 7);
+		checkSorted();
+	}
+	SECTION("merging a range after the last element") {
+		v.merge({ 8, 9 });
+		REQUIRE(v.size() == 6);
+		REQUIRE(v.back() == 9);
+		checkSorted();
+	}
+	SECTION("merging a range starting with the last element") {
+		v.merge({ 7, 7, 8 });
+		REQUIRE(v.size() == 5);
+		REQUIRE(v.back() == 8);
+		checkSorted();
+	}
+}
+
+// Hidden, run by the tests_benchmarks target.
+TEST_CASE("flat_set benchmarks", "[.][benchmark]") {
+	SECTION("merge sorted slices") {
+		auto v = base::flat_set<int>();
+		auto slice = std::vector<int>(100);
+		base::benchmark::measure("flat_set: 1000 sorted merges", [&] {
+			for (auto i = 0; i != 1000; ++i) {
+				// Slices of message ids loaded around the existing ones.
+				const auto from = (i % 2) ? (i * 50) : (100000 - i * 50);
+				for (auto j = 0; j != 100; ++j) {
+					slice[j] = from + j;
+				}
+				v.merge(slice.begin(), slice.end());
+			}
+		});
+		REQUIRE(v.size() > 1000);
+	}
+}
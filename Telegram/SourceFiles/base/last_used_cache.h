@@ -7,62 +7,116 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 */
 #pragma once
 
-#include <list>
-#include <unordered_map>
-
 namespace base {
 
+template <typename Entry>
+class last_used_cache;
+
+// Embedded in the entries of a last_used_cache, so that the cache doesn't
+// allocate nodes or look the entries up in a map. An entry is accessible
+// through entry->lastUsedHook(), one hook can be in one cache at a time.
+template <typename Entry>
+class last_used_hook {
+public:
+	last_used_hook() = default;
+	last_used_hook(const last_used_hook &other) = delete;
+	last_used_hook &operator=(const last_used_hook &other) = delete;
+	~last_used_hook() {
+		unlink();
+	}
+
+	bool linked() const {
+		return (_next != nullptr);
+	}
+
+private:
+	friend class last_used_cache<Entry>;
+
+	void link_before(last_used_hook *next, Entry *entry) {
+		_entry = entry;
+		_prev = next->_prev;
+		_next = next;
+		_prev->_next = this;
+		_next->_prev = this;
+	}
+	void unlink() {
+		if (linked()) {
+			_prev->_next = _next;
+			_next->_prev = _prev;
+			_prev = _next = nullptr;
+			_entry = nullptr;
+		}
+	}
+
+	Entry *_entry = nullptr;
+	last_used_hook *_prev = nullptr;
+	last_used_hook *_next = nullptr;
+
+};
+
 template <typename Entry>
 class last_used_cache {
 public:
-	void up(Entry entry);
-	void remove(Entry entry);
+	last_used_cache();
+	last_used_cache(const last_used_cache &other) = delete;
+	last_used_cache &operator=(const last_used_cache &other) = delete;
+	~last_used_cache();
+
+	void up(Entry *entry);
+	void remove(Entry *entry);
 	void clear();
 
-	Entry take_lowest();
+	Entry *take_lowest();
 
 private:
-	std::list<Entry> _queue;
-	std::unordered_map<Entry, typename std::list<Entry>::iterator> _map;
+	using hook = last_used_hook<Entry>;
+
+	// The list is circular, the lowest entry follows the head.
+	hook _head;
 
 };
 
 template <typename Entry>
-void last_used_cache<Entry>::up(Entry entry) {
-	if (!_queue.empty() && _queue.back() == entry) {
+last_used_cache<Entry>::last_used_cache() {
+	_head._prev = _head._next = &_head;
+}
+
+template <typename Entry>
+last_used_cache<Entry>::~last_used_cache() {
+	clear();
+	_head._prev = _head._next = nullptr;
+}
+
+template <typename Entry>
+void last_used_cache<Entry>::up(Entry *entry) {
+	auto &hook = entry->lastUsedHook();
+	if (_head._prev == &hook) {
 		return;
 	}
-	const auto i = _map.find(entry);
-	if (i != end(_map)) {
-		_queue.splice(end(_queue), _queue, i->second);
-	} else {
-		_map.emplace(entry, _queue.insert(end(_queue), entry));
-	}
+	hook.unlink();
+	hook.link_before(&_head, entry);
 }
 
 template <typename Entry>
-void last_used_cache<Entry>::remove(Entry entry) {
-	const auto i = _map.find(entry);
-	if (i != end(_map)) {
-		_queue.erase(i->second);
-		_map.erase(i);
-	}
+void last_used_cache<Entry>::remove(Entry *entry) {
+	entry->lastUsedHook().unlink();
 }
 
 template <typename Entry>
 void last_used_cache<Entry>::clear() {
-	_queue.clear();
-	_map.clear();
+	while (_head._next != &_head) {
+		_head._next->unlink();
+	}
 }
 
 template <typename Entry>
-Entry last_used_cache<Entry>::take_lowest() {
-	if (_queue.empty()) {
-		return Entry();
+Entry *last_used_cache<Entry>::take_lowest() {
+	if (_head._next == &_head) {
+		return nullptr;
 	}
-	auto result = std::move(_queue.front());
-	_queue.erase(begin(_queue));
-	_map.erase(result);
+	const auto lowest = _head._next;
+	const auto result = lowest->_entry;
+	lowest->unlink();
 	return result;
 }
 
@@ -0,0 +1,105 @@
+/*
+This file is part of Telegram Desktop,
+the official desktop application for the Telegram messaging service.
+
+For license and copyright information please follow this link:
+https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
+*/
+#include "catch.hpp"
+
+#include "base/last_used_cache.h"
+#include "base/benchmark.h"
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+struct entry {
+	int value = 0;
+	base::last_used_hook<entry> hook;
+
+	base::last_used_hook<entry> &lastUsedHook() {
+		return hook;
+	}
+};
+
+TEST_CASE("last_used_cache should return entries in least recently used order", "[last_used_cache]") {
+	auto entries = std::vector<entry>(4);
+	for (auto i = 0; i != 4; ++i) {
+		entries[i].value = i;
+	}
+	base::last_used_cache<entry> cache;
+	REQUIRE(cache.take_lowest() == nullptr);
+
+	for (auto &e : entries) {
+		cache.up(&e);
+	}
+	SECTION("repeating up keeps the order") {
+		cache.up(&entries[3]);
+		REQUIRE(cache.take_lowest() == &entries[0]);
+		REQUIRE(cache.take_lowest() == &entries[1]);
+		REQUIRE(cache.take_lowest() == &entries[2]);
+		REQUIRE(cache.take_lowest() == &entries[3]);
+		REQUIRE(cache.take_lowest() == nullptr);
+	}
+	SECTION("up moves an entry to the top") {
+		cache.up(&entries[0]);
+		cache.up(&entries[2]);
+		REQUIRE(cache.take_lowest() == &entries[1]);
+		REQUIRE(cache.take_lowest() == &entries[3]);
+		REQUIRE(cache.take_lowest() == &entries[0]);
+		REQUIRE(cache.take_lowest() == &entries[2]);
+		REQUIRE(cache.take_lowest() == nullptr);
+	}
+	SECTION("removed entries are skipped") {
+		cache.remove(&entries[1]);
+		cache.remove(&entries[1]);
+		REQUIRE(!entries[1].hook.linked());
+		REQUIRE(cache.take_lowest() == &entries[0]);
+		REQUIRE(cache.take_lowest() == &entries[2]);
+		REQUIRE(cache.take_lowest() == &entries[3]);
+		REQUIRE(cache.take_lowest() == nullptr);
+	}
+	SECTION("clear unlinks all the entries") {
+		cache.clear();
+		REQUIRE(cache.take_lowest() == nullptr);
+		for (auto &e : entries) {
+			REQUIRE(!e.hook.linked());
+		}
+		cache.up(&entries[2]);
+		REQUIRE(cache.take_lowest() == &entries[2]);
+	}
+}
+
+TEST_CASE("last_used_cache entries unlink themselves when destroyed", "[last_used_cache]") {
+	base::last_used_cache<entry> cache;
+	auto first = std::make_unique<entry>();
+	auto second = std::make_unique<entry>();
+	cache.up(first.get());
+	cache.up(second.get());
+	first = nullptr;
+	REQUIRE(cache.take_lowest() == second.get());
+	REQUIRE(cache.take_lowest() == nullptr);
+}
+
+// Hidden, run by the tests_benchmarks target.
+TEST_CASE("last_used_cache up benchmark", "[.][benchmark]") {
+	constexpr auto kEntries = 10000;
+	constexpr auto kUps = 10000000;
+
+	auto entries = std::vector<entry>(kEntries);
+	base::last_used_cache<entry> cache;
+
+	base::benchmark::measure("last_used_cache: 10M ups over 10K", [&] {
+		auto index = uint32_t(0);
+		for (auto i = 0; i != kUps; ++i) {
+			index = index * 1103515245U + 12345U;
+			cache.up(&entries[index % kEntries]);
+		}
+	});
+
+	auto count = 0;
+	while (cache.take_lowest()) {
+		++count;
+	}
+	REQUIRE(count == kEntries);
+}
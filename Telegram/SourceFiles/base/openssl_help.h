@@ -10,6 +10,7 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 #include "base/bytes.h"
 #include "base/algorithm.h"
 #include "base/basic_types.h"
+#include "base/assertion.h"
 
 extern "C" {
 #include <openssl/bn.h>
@@ -441,6 +442,94 @@ inline bytes::vector Pbkdf2Sha512(
 		EVP_sha512());
 }
 
+constexpr auto kAesBlockSize = size_type(AES_BLOCK_SIZE);
+constexpr auto kAesIgeKeySize = size_type(32);
+constexpr auto kAesIgeIvSize = size_type(2 * AES_BLOCK_SIZE);
+
+namespace details {
+
+// AES_ige_encrypt() uses the plain software AES implementation, while
+// the EVP one picks AES-NI / ARMv8 crypto instructions when available.
+// Each block depends on the previous one in both directions, so we run
+// single block ECB steps and do the chaining here.
+inline void AesIge(
+		bytes::const_span from,
+		bytes::span to,
+		bytes::const_span key,
+		bytes::const_span iv,
+		bool encrypt) {
+	Expects(to.size() == from.size());
+	Expects((from.size() % kAesBlockSize) == 0);
+	Expects(key.size() == kAesIgeKeySize);
+	Expects(iv.size() == kAesIgeIvSize);
+
+	const auto context = EVP_CIPHER_CTX_new();
+	Assert(context != nullptr);
+	const auto guard = gsl::finally([&] { EVP_CIPHER_CTX_free(context); });
+
+	EVP_CipherInit_ex(
+		context,
+		EVP_aes_256_ecb(),
+		nullptr,
+		reinterpret_cast<const uchar*>(key.data()),
+		nullptr,
+		encrypt ? 1 : 0);
+	EVP_CIPHER_CTX_set_padding(context, 0);
+
+	// For encryption xor input with the previous output before the step
+	// and the result with the previous input after it, and vice versa.
+	auto before = bytes::array<kAesBlockSize>();
+	auto after = bytes::array<kAesBlockSize>();
+	bytes::copy(
+		before,
+		iv.subspan(encrypt ? 0 : kAesBlockSize, kAesBlockSize));
+	bytes::copy(
+		after,
+		iv.subspan(encrypt ? kAesBlockSize : 0, kAesBlockSize));
+	auto input = bytes::array<kAesBlockSize>();
+	auto output = bytes::array<kAesBlockSize>();
+	for (auto i = size_type(0); i != from.size(); i += kAesBlockSize) {
+		const auto block = from.subspan(i, kAesBlockSize);
+		for (auto j = size_type(0); j != kAesBlockSize; ++j) {
+			input[j] = block[j] ^ before[j];
+		}
+		auto written = 0;
+		EVP_CipherUpdate(
+			context,
+			reinterpret_cast<uchar*>(output.data()),
+			&written,
+			reinterpret_cast<const uchar*>(input.data()),
+			int(kAesBlockSize));
+		Assert(written == int(kAesBlockSize));
+		for (auto j = size_type(0); j != kAesBlockSize; ++j) {
+			output[j] ^= after[j];
+		}
+
+		// The block may be the same memory as the output.
+		bytes::copy(after, block);
+		bytes::copy(before, output);
+		bytes::copy(to.subspan(i, kAesBlockSize), output);
+	}
+}
+
+} // namespace details
+
+inline void AesIgeEncrypt(
+		bytes::const_span from,
+		bytes::span to,
+		bytes::const_span key,
+		bytes::const_span iv) {
+	details::AesIge(from, to, key, iv, true);
+}
+
+inline void AesIgeDecrypt(
+		bytes::const_span from,
+		bytes::span to,
+		bytes::const_span key,
+		bytes::const_span iv) {
+	details::AesIge(from, to, key, iv, false);
+}
+
 } // namespace openssl
 
 namespace bytes {
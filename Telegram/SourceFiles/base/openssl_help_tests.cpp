@@ -0,0 +1,100 @@
+/*
+This file is part of Telegram Desktop,
+the official desktop application for the Telegram messaging service.
+
+For license and copyright information please follow this link:
+https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
+*/
+#include "catch.hpp"
+
+#include "base/openssl_help.h"
+#include "base/benchmark.h"
+
+namespace {
+
+constexpr auto kPartSize = 512 * 1024;
+
+bytes::vector Filled(size_type size, int seed) {
+	auto result = bytes::vector(size);
+	for (auto i = size_type(0); i != size; ++i) {
+		result[i] = bytes::type(uchar(i * 7 + seed));
+	}
+	return result;
+}
+
+bytes::vector ReferenceIge(
+		const bytes::vector &data,
+		const bytes::vector &key,
+		const bytes::vector &iv,
+		bool encrypt) {
+	auto result = bytes::vector(data.size());
+	auto aes = AES_KEY();
+	const auto raw = reinterpret_cast<const uchar*>(key.data());
+	if (encrypt) {
+		AES_set_encrypt_key(raw, 256, &aes);
+	} else {
+		AES_set_decrypt_key(raw, 256, &aes);
+	}
+	auto ivCopy = iv;
+	AES_ige_encrypt(
+		reinterpret_cast<const uchar*>(data.data()),
+		reinterpret_cast<uchar*>(result.data()),
+		data.size(),
+		&aes,
+		reinterpret_cast<uchar*>(ivCopy.data()),
+		encrypt ? AES_ENCRYPT : AES_DECRYPT);
+	return result;
+}
+
+} // namespace
+
+TEST_CASE("aes ige matches the openssl implementation", "[openssl_help]") {
+	const auto key = Filled(openssl::kAesIgeKeySize, 1);
+	const auto iv = Filled(openssl::kAesIgeIvSize, 2);
+	const auto data = Filled(4096, 3);
+
+	SECTION("encrypting") {
+		auto result = bytes::vector(data.size());
+		openssl::AesIgeEncrypt(data, result, key, iv);
+		REQUIRE(result == ReferenceIge(data, key, iv, true));
+	}
+	SECTION("decrypting") {
+		auto result = bytes::vector(data.size());
+		openssl::AesIgeDecrypt(data, result, key, iv);
+		REQUIRE(result == ReferenceIge(data, key, iv, false));
+	}
+	SECTION("in place round trip") {
+		auto result = data;
+		openssl::AesIgeEncrypt(result, result, key, iv);
+		REQUIRE(result != data);
+		openssl::AesIgeDecrypt(result, result, key, iv);
+		REQUIRE(result == data);
+	}
+}
+
+// Hidden, run by the tests_benchmarks target.
+TEST_CASE("aes ige benchmark", "[.][benchmark]") {
+	constexpr auto kParts = 64;
+
+	const auto key = Filled(openssl::kAesIgeKeySize, 1);
+	const auto iv = Filled(openssl::kAesIgeIvSize, 2);
+	const auto data = Filled(kPartSize, 3);
+	auto result = bytes::vector(data.size());
+
+	base::benchmark::measure("aes ige: openssl decrypt 64 x 512 KB", [&] {
+		for (auto i = 0; i != kParts; ++i) {
+			result = ReferenceIge(data, key, iv, false);
+		}
+	});
+	base::benchmark::measure("aes ige: evp decrypt 64 x 512 KB", [&] {
+		for (auto i = 0; i != kParts; ++i) {
+			openssl::AesIgeDecrypt(data, result, key, iv);
+		}
+	});
+	base::benchmark::measure("aes ige: evp encrypt 64 x 512 KB", [&] {
+		for (auto i = 0; i != kParts; ++i) {
+			openssl::AesIgeEncrypt(data, result, key, iv);
+		}
+	});
+	REQUIRE(result.size() == data.size());
+}
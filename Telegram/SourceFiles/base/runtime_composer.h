@@ -7,6 +7,8 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 */
 #pragma once
 
+#include "base/slab_allocator.h"
+
 template <typename Base>
 class RuntimeComposer;
 
@@ -145,7 +147,9 @@ public:
 		if (mask) {
 			auto meta = GetRuntimeComposerMetadata(mask);
 
-			auto data = operator new(meta->size);
+			// Composers live in the main thread, components are allocated
+			// from the same slabs as the objects themselves.
+			auto data = base::main_slab_allocator().allocate(meta->size);
 			Assert(data != nullptr);
 
 			_data = data;
@@ -185,7 +189,7 @@ public:
 					RuntimeComponentWraps[i].Destruct(_dataptrunsafe(offset));
 				}
 			}
-			operator delete(_data);
+			base::slab_allocator::deallocate(_data);
 		}
 	}
 
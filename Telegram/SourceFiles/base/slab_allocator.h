@@ -0,0 +1,185 @@
+/*
+This file is part of Telegram Desktop,
+the official desktop application for the Telegram messaging service.
+
+For license and copyright information please follow this link:
+https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
+*/
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <new>
+
+namespace base {
+
+// Allocates small objects from chunks holding many blocks of one size, so
+// objects created one after another lie next to each other in memory and
+// the heap is asked once per chunk instead of once per object. A chunk is
+// returned to the heap when all of its blocks are freed.
+//
+// Not thread safe, each allocator should be used from a single thread.
+class slab_allocator {
+public:
+	static constexpr auto kSizeStep = std::size_t(16);
+	static constexpr auto kMaxBlockSize = std::size_t(1024);
+	static constexpr auto kChunkSize = std::size_t(16 * 1024);
+
+	slab_allocator() = default;
+	slab_allocator(const slab_allocator &other) = delete;
+	slab_allocator &operator=(const slab_allocator &other) = delete;
+	~slab_allocator();
+
+	void *allocate(std::size_t size);
+	static void deallocate(void *data) noexcept;
+
+	int chunks_count() const {
+		return _chunksCount;
+	}
+
+private:
+	struct chunk;
+	struct header {
+		chunk *owner = nullptr;
+	};
+	struct chunk {
+		slab_allocator *allocator = nullptr;
+		chunk *prev = nullptr;
+		chunk *next = nullptr;
+		header *free = nullptr;
+		std::size_t index = 0;
+		std::size_t block_size = 0;
+		int used = 0;
+		int capacity = 0;
+		int untouched = 0;
+	};
+
+	// The object follows the header with the strictest fundamental alignment.
+	static constexpr auto kAlign = alignof(std::max_align_t);
+	static constexpr auto kHeaderSize = (sizeof(header) > kAlign)
+		? sizeof(header)
+		: kAlign;
+	static constexpr auto kChunkHeaderSize
+		= ((sizeof(chunk) + kHeaderSize - 1) / kHeaderSize) * kHeaderSize;
+	static constexpr auto kClassesCount = kMaxBlockSize / kSizeStep;
+
+	chunk *create_chunk(std::size_t index);
+	void link(chunk *which);
+	void unlink(chunk *which);
+	void release(chunk *which, header *block) noexcept;
+
+	std::array<chunk*, kClassesCount> _available = { { nullptr } };
+	int _chunksCount = 0;
+
+};
+
+inline slab_allocator::~slab_allocator() {
+	// Chunks with live objects can't be freed, they are left to the heap.
+	for (auto &list : _available) {
+		while (const auto which = list) {
+			list = which->next;
+			if (!which->used) {
+				::operator delete(which);
+			}
+		}
+	}
+}
+
+inline void *slab_allocator::allocate(std::size_t size) {
+	if (size > kMaxBlockSize) {
+		const auto result = new (::operator new(kHeaderSize + size)) header();
+		return reinterpret_cast<char*>(result) + kHeaderSize;
+	}
+	const auto index = size ? ((size - 1) / kSizeStep) : 0;
+	auto which = _available[index];
+	if (!which) {
+		which = create_chunk(index);
+	}
+	auto result = which->free;
+	if (result) {
+		which->free = *reinterpret_cast<header**>(result);
+	} else {
+		const auto number = which->capacity - (which->untouched--);
+		result = reinterpret_cast<header*>(reinterpret_cast<char*>(which)
+			+ kChunkHeaderSize
+			+ number * which->block_size);
+	}
+	new (result) header{ which };
+	if (++which->used == which->capacity) {
+		unlink(which);
+	}
+	return reinterpret_cast<char*>(result) + kHeaderSize;
+}
+
+inline void slab_allocator::deallocate(void *data) noexcept {
+	if (!data) {
+		return;
+	}
+	const auto block = reinterpret_cast<header*>(
+		static_cast<char*>(data) - kHeaderSize);
+	if (const auto which = block->owner) {
+		which->allocator->release(which, block);
+	} else {
+		::operator delete(block);
+	}
+}
+
+inline auto slab_allocator::create_chunk(std::size_t index) -> chunk* {
+	const auto block_size = kHeaderSize + (index + 1) * kSizeStep;
+	const auto capacity = int((kChunkSize - kChunkHeaderSize) / block_size);
+	const auto result = new (::operator new(kChunkSize)) chunk();
+	result->allocator = this;
+	result->index = index;
+	result->block_size = block_size;
+	result->capacity = result->untouched = capacity;
+	link(result);
+	++_chunksCount;
+	return result;
+}
+
+inline void slab_allocator::link(chunk *which) {
+	auto &list = _available[which->index];
+	which->prev = nullptr;
+	which->next = list;
+	if (list) {
+		list->prev = which;
+	}
+	list = which;
+}
+
+inline void slab_allocator::unlink(chunk *which) {
+	auto &list = _available[which->index];
+	if (which->prev) {
+		which->prev->next = which->next;
+	} else {
+		list = which->next;
+	}
+	if (which->next) {
+		which->next->prev = which->prev;
+	}
+	which->prev = which->next = nullptr;
+}
+
+inline void slab_allocator::release(chunk *which, header *block) noexcept {
+	*reinterpret_cast<header**>(block) = which->free;
+	which->free = block;
+	if (which->used-- == which->capacity) {
+		link(which);
+	}
+	if (!which->used && which->next) {
+		// Keep one empty chunk, so that a single object created and
+		// destroyed in a loop doesn't go to the heap each time.
+		unlink(which);
+		::operator delete(which);
+		--_chunksCount;
+	}
+}
+
+// The allocator for objects created and destroyed in the main thread.
+inline slab_allocator &main_slab_allocator() {
+	// Never destroyed, some objects may be destroyed on exit after it.
+	static const auto result = new slab_allocator();
+	return *result;
+}
+
+} // namespace base
@@ -0,0 +1,66 @@
+/*
+This file is part of Telegram Desktop,
+the official desktop application for the Telegram messaging service.
+
+For license and copyright information please follow this link:
+https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
+*/
+#include "catch.hpp"
+
+#include "base/slab_allocator.h"
+
+#include <cstdint>
+#include <cstring>
+#include <set>
+#include <vector>
+
+TEST_CASE("slab_allocator should place blocks in chunks", "[slab_allocator]") {
+	base::slab_allocator allocator;
+	auto blocks = std::vector<void*>();
+	for (auto i = 0; i != 1000; ++i) {
+		const auto block = allocator.allocate(100);
+		REQUIRE(block != nullptr);
+		REQUIRE(reinterpret_cast<std::uintptr_t>(block)
+			% alignof(std::max_align_t) == 0);
+		std::memset(block, i & 0xFF, 100);
+		blocks.push_back(block);
+	}
+	REQUIRE(std::set<void*>(blocks.begin(), blocks.end()).size() == 1000);
+	REQUIRE(allocator.chunks_count() > 1);
+	REQUIRE(allocator.chunks_count() < 20);
+
+	SECTION("freed blocks are reused") {
+		const auto block = blocks.back();
+		base::slab_allocator::deallocate(block);
+		REQUIRE(allocator.allocate(100) == block);
+		for (const auto block : blocks) {
+			base::slab_allocator::deallocate(block);
+		}
+	}
+	SECTION("empty chunks are freed except one") {
+		for (const auto block : blocks) {
+			base::slab_allocator::deallocate(block);
+		}
+		REQUIRE(allocator.chunks_count() == 1);
+	}
+}
+
+TEST_CASE("slab_allocator should separate sizes", "[slab_allocator]") {
+	base::slab_allocator allocator;
+	const auto small = allocator.allocate(1);
+	const auto zero = allocator.allocate(0);
+	const auto medium = allocator.allocate(300);
+	REQUIRE(allocator.chunks_count() == 2);
+
+	const auto large = allocator.allocate(
+		base::slab_allocator::kMaxBlockSize + 1);
+	REQUIRE(large != nullptr);
+	REQUIRE(allocator.chunks_count() == 2);
+
+	base::slab_allocator::deallocate(large);
+	base::slab_allocator::deallocate(medium);
+	base::slab_allocator::deallocate(zero);
+	base::slab_allocator::deallocate(small);
+	base::slab_allocator::deallocate(nullptr);
+	REQUIRE(allocator.chunks_count() == 2);
+}
@@ -8,7 +8,13 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 #define CATCH_CONFIG_RUNNER
 #include "catch.hpp"
 #include "reporters/catch_reporter_compact.hpp"
+#include "base/benchmark.h"
 #include <QFile>
+#include <QFileInfo>
+#include <QDir>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonArray>
 
 int (*TestForkedMethod)()/* = nullptr*/;
 
@@ -81,15 +87,54 @@ namespace Catch {
 
 } // end namespace Catch
 
+bool WriteBenchmarkResults(const QString &path) {
+	auto list = QJsonArray();
+	for (const auto &record : base::benchmark::records()) {
+		auto object = QJsonObject();
+		object.insert("name", QString::fromStdString(record.name));
+		object.insert("value", record.value);
+		object.insert("unit", QString::fromStdString(record.unit));
+		list.append(object);
+	}
+	auto result = QJsonObject();
+	result.insert("benchmarks", list);
+
+	QDir().mkpath(QFileInfo(path).absolutePath());
+	QFile f(path);
+	if (!f.open(QIODevice::WriteOnly)) {
+		return false;
+	}
+	const auto bytes = QJsonDocument(result).toJson();
+	return (f.write(bytes) == bytes.size());
+}
+
 int main(int argc, const char *argv[]) {
 	auto touchFile = QString();
+	auto benchmarkFile = QString();
 	for (auto i = 0; i != argc; ++i) {
 		if (argv[i] == QString("--touch") && i + 1 != argc) {
 			touchFile = QFile::decodeName(argv[++i]);
+		} else if (argv[i] == QString("--benchmark") && i + 1 != argc) {
+			benchmarkFile = QFile::decodeName(argv[++i]);
 		} else if (argv[i] == QString("--forked") && TestForkedMethod) {
 			return TestForkedMethod();
 		}
 	}
+	if (!benchmarkFile.isEmpty()) {
+		// Run only the benchmarks and write their results as JSON.
+		const char *catch_argv[] = {
+			argv[0],
+			"-r",
+			"minimal",
+			"[benchmark]" };
+		constexpr auto catch_argc = sizeof(catch_argv)
+			/ sizeof(catch_argv[0]);
+		auto result = Catch::Session().run(catch_argc, catch_argv);
+		if (result == 0 && !WriteBenchmarkResults(benchmarkFile)) {
+			result = 1;
+		}
+		return (result < 0xff ? result : 0xff);
+	}
 	const char *catch_argv[] = {
 		argv[0],
 		touchFile.isEmpty() ? "-b" : "-r",
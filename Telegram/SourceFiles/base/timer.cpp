@@ -8,6 +8,9 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 #include "base/timer.h"
 
 #include <QtCore/QTimerEvent>
+#include <QtCore/QCoreApplication>
+
+#include <map>
 
 namespace base {
 namespace {
@@ -17,6 +20,124 @@ QObject *TimersAdjuster() {
 	return &adjuster;
 }
 
+// All the timers of the main thread share a single native timer, so that
+// Qt doesn't walk the list of thousands of them on each event loop pass.
+class TimersQueue final : private QObject {
+public:
+	TimersQueue();
+
+	static TimersQueue &Instance();
+
+	// Only the objects living in the main thread use the queue.
+	static bool Serves(not_null<const QObject*> context);
+
+	uint64 add(TimeMs when, FnMut<void()> callback);
+	void remove(TimeMs when, uint64 id);
+
+protected:
+	void timerEvent(QTimerEvent *e) override;
+
+private:
+	using Key = std::pair<TimeMs, uint64>;
+
+	void schedule();
+	void adjust();
+	void process();
+
+	std::map<Key, FnMut<void()>> _entries;
+	uint64 _lastId = 0;
+	TimeMs _timerNext = 0;
+	int _timerId = 0;
+
+};
+
+TimersQueue::TimersQueue() {
+	connect(
+		TimersAdjuster(),
+		&QObject::destroyed,
+		this,
+		[=] { adjust(); },
+		Qt::QueuedConnection);
+}
+
+TimersQueue &TimersQueue::Instance() {
+	// Never destroyed, because timers may outlive any static object.
+	static const auto result = new TimersQueue();
+	return *result;
+}
+
+bool TimersQueue::Serves(not_null<const QObject*> context) {
+	const auto application = QCoreApplication::instance();
+	return application && (context->thread() == application->thread());
+}
+
+uint64 TimersQueue::add(TimeMs when, FnMut<void()> callback) {
+	const auto id = ++_lastId;
+	const auto i = _entries.emplace(Key(when, id), std::move(callback));
+	if (i.first == begin(_entries)) {
+		schedule();
+	}
+	return id;
+}
+
+void TimersQueue::remove(TimeMs when, uint64 id) {
+	// If the first entry is removed the native timer fires in vain once.
+	_entries.erase(Key(when, id));
+}
+
+void TimersQueue::schedule() {
+	if (_entries.empty()) {
+		if (_timerId) {
+			killTimer(base::take(_timerId));
+		}
+		return;
+	}
+	const auto next = begin(_entries)->first.first;
+	if (_timerId && _timerNext == next) {
+		return;
+	} else if (_timerId) {
+		killTimer(base::take(_timerId));
+	}
+	const auto timeout = std::max(next - crl::time(), TimeMs(0));
+	_timerNext = next;
+	_timerId = startTimer(
+		static_cast<int>(std::min(
+			timeout,
+			TimeMs(std::numeric_limits<int>::max()))),
+		Timer::DefaultType(timeout));
+}
+
+void TimersQueue::adjust() {
+	if (_timerId) {
+		killTimer(base::take(_timerId));
+	}
+	schedule();
+}
+
+void TimersQueue::process() {
+	// Entries added by the callbacks are not called in the same pass,
+	// so that a timer restarted with zero timeout doesn't lock us here.
+	const auto now = crl::time();
+	const auto last = _lastId;
+	while (!_entries.empty()) {
+		const auto i = begin(_entries);
+		if (i->first.first > now || i->first.second > last) {
+			break;
+		}
+		auto callback = std::move(i->second);
+		_entries.erase(i);
+		callback();
+	}
+	schedule();
+}
+
+void TimersQueue::timerEvent(QTimerEvent *e) {
+	if (e->timerId() == _timerId) {
+		killTimer(base::take(_timerId));
+		process();
+	}
+}
+
 } // namespace
 
 Timer::Timer(
@@ -40,6 +161,10 @@ Timer::Timer(Fn<void()> callback)
 		Qt::QueuedConnection);
 }
 
+Timer::~Timer() {
+	cancel();
+}
+
 void Timer::start(TimeMs timeout, Qt::TimerType type, Repeat repeat) {
 	cancel();
 
@@ -47,6 +172,10 @@ void Timer::start(TimeMs timeout, Qt::TimerType type, Repeat repeat) {
 	setRepeat(repeat);
 	_adjusted = false;
 	setTimeout(timeout);
+	if (TimersQueue::Serves(this)) {
+		enqueue();
+		return;
+	}
 	_timerId = startTimer(_timeout, _type);
 	if (_timerId) {
 		_next = crl::time() + _timeout;
@@ -55,8 +184,17 @@ void Timer::start(TimeMs timeout, Qt::TimerType type, Repeat repeat) {
 	}
 }
 
+void Timer::enqueue() {
+	_next = crl::time() + _timeout;
+	_queued = TimersQueue::Instance().add(_next, [=] {
+		queuedTimeout();
+	});
+}
+
 void Timer::cancel() {
-	if (isActive()) {
+	if (_queued) {
+		TimersQueue::Instance().remove(_next, base::take(_queued));
+	} else if (_timerId) {
 		killTimer(base::take(_timerId));
 	}
 }
@@ -80,7 +218,7 @@ void Timer::Adjust() {
 
 void Timer::adjust() {
 	auto remaining = remainingTime();
-	if (remaining >= 0) {
+	if (_timerId && remaining >= 0) {
 		cancel();
 		_timerId = startTimer(remaining, _type);
 		_adjusted = true;
@@ -113,6 +251,16 @@ void Timer::timerEvent(QTimerEvent *e) {
 	}
 }
 
+void Timer::queuedTimeout() {
+	_queued = 0;
+	if (repeat() == Repeat::Interval) {
+		enqueue();
+	}
+	if (_callback) {
+		_callback();
+	}
+}
+
 int DelayedCallTimer::call(
 		TimeMs timeout,
 		FnMut<void()> callback,
@@ -122,6 +270,19 @@ int DelayedCallTimer::call(
 	if (!callback) {
 		return 0;
 	}
+	if (TimersQueue::Serves(this)) {
+		const auto callId = ++_lastQueuedId;
+		const auto when = crl::time() + timeout;
+		const auto id = TimersQueue::Instance().add(when, [
+			=,
+			callback = std::move(callback)
+		]() mutable {
+			_queued.remove(callId);
+			callback();
+		});
+		_queued.emplace(callId, Queued{ when, id });
+		return callId;
+	}
 	auto timerId = startTimer(static_cast<int>(timeout), type);
 	if (timerId) {
 		_callbacks.emplace(timerId, std::move(callback));
@@ -129,8 +290,22 @@ int DelayedCallTimer::call(
 	return timerId;
 }
 
+DelayedCallTimer::~DelayedCallTimer() {
+	if (_queued.empty()) {
+		return;
+	}
+	auto &queue = TimersQueue::Instance();
+	for (const auto &[callId, queued] : _queued) {
+		queue.remove(queued.when, queued.id);
+	}
+}
+
 void DelayedCallTimer::cancel(int callId) {
-	if (callId) {
+	const auto i = _queued.find(callId);
+	if (i != _queued.end()) {
+		TimersQueue::Instance().remove(i->second.when, i->second.id);
+		_queued.erase(i);
+	} else if (callId) {
 		killTimer(callId);
 		_callbacks.remove(callId);
 	}
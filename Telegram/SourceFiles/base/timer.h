@@ -20,6 +20,7 @@ public:
 		not_null<QThread*> thread,
 		Fn<void()> callback = nullptr);
 	explicit Timer(Fn<void()> callback = nullptr);
+	~Timer();
 
 	static Qt::TimerType DefaultType(TimeMs timeout) {
 		constexpr auto kThreshold = TimeMs(1000);
@@ -47,7 +48,7 @@ public:
 	}
 
 	bool isActive() const {
-		return (_timerId != 0);
+		return (_timerId != 0) || (_queued != 0);
 	}
 
 	void cancel();
@@ -64,6 +65,8 @@ private:
 		SingleShot = 1,
 	};
 	void start(TimeMs timeout, Qt::TimerType type, Repeat repeat);
+	void enqueue();
+	void queuedTimeout();
 	void adjust();
 
 	void setTimeout(TimeMs timeout);
@@ -78,6 +81,7 @@ private:
 
 	Fn<void()> _callback;
 	TimeMs _next = 0;
+	uint64 _queued = 0;
 	int _timeout = 0;
 	int _timerId = 0;
 
@@ -89,6 +93,8 @@ private:
 
 class DelayedCallTimer final : private QObject {
 public:
+	~DelayedCallTimer();
+
 	int call(TimeMs timeout, FnMut<void()> callback) {
 		return call(
 			timeout,
@@ -106,7 +112,14 @@ protected:
 	void timerEvent(QTimerEvent *e) override;
 
 private:
+	struct Queued {
+		TimeMs when = 0;
+		uint64 id = 0;
+	};
+
 	base::flat_map<int, FnMut<void()>> _callbacks;
+	base::flat_map<int, Queued> _queued;
+	int _lastQueuedId = 0;
 
 };
 
@@ -7,62 +7,86 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 */
 #pragma once
 
-#include <functional>
-
-#ifndef Unexpected
-#define Unexpected(message) std::abort()
-#define UniqueFunctionUnexpected
-#endif // Unexpected
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
 
 namespace base {
 namespace details {
 
+// Callables up to this size are stored without a heap allocation.
+// It fits a lambda capturing a few pointers along with a weak_ptr or
+// a QString, which is larger than the inline buffer of std::function.
+constexpr auto kUniqueFunctionInlineSize = std::size_t(48);
+constexpr auto kUniqueFunctionInlineAlign = alignof(std::max_align_t);
+
 template <typename Callable>
-class moveable_callable_wrap {
-public:
-	static_assert(
-		std::is_move_constructible_v<Callable>,
-		"Should be at least moveable.");
+constexpr bool unique_function_inline_v
+	= (sizeof(Callable) <= kUniqueFunctionInlineSize)
+	&& (alignof(Callable) <= kUniqueFunctionInlineAlign)
+	&& std::is_nothrow_move_constructible_v<Callable>;
 
-	moveable_callable_wrap(Callable &&other)
-	: _value(std::move(other)) {
-	}
-	moveable_callable_wrap &operator=(Callable &&other) {
-		_value = std::move(other);
-		return *this;
-	}
-	moveable_callable_wrap(moveable_callable_wrap &&other)
-	: _value(std::move(other._value)) {
+template <typename Return, typename ...Args>
+struct unique_function_vtable {
+	Return (*call)(void *storage, Args &&...args);
+
+	// Move constructs the callable in 'to' and destroys it in 'from'.
+	void (*move)(void *to, void *from) noexcept;
+	void (*destroy)(void *storage) noexcept;
+};
+
+template <typename Callable, typename Return, typename ...Args>
+struct unique_function_inline {
+	static Callable &get(void *storage) {
+		return *std::launder(reinterpret_cast<Callable*>(storage));
 	}
-	moveable_callable_wrap(
-			const moveable_callable_wrap &other)
-	: _value(fail_construct()) {
+	static Return call(void *storage, Args &&...args) {
+		if constexpr (std::is_void_v<Return>) {
+			get(storage)(std::forward<Args>(args)...);
+		} else {
+			return get(storage)(std::forward<Args>(args)...);
+		}
 	}
-	moveable_callable_wrap &operator=(
-			moveable_callable_wrap &&other) {
-		_value = std::move(other._value);
-		return *this;
+	static void move(void *to, void *from) noexcept {
+		new (to) Callable(std::move(get(from)));
+		get(from).~Callable();
 	}
-	moveable_callable_wrap &operator=(
-			const moveable_callable_wrap &other) {
-		return fail_assign();
+	static void destroy(void *storage) noexcept {
+		get(storage).~Callable();
 	}
 
-	template <typename ...Args>
-	decltype(auto) operator()(Args &&...args) {
-		return _value(std::forward<Args>(args)...);
-	}
+	static constexpr auto vtable = unique_function_vtable<Return, Args...>{
+		&call,
+		&move,
+		&destroy,
+	};
+};
 
-private:
-	[[noreturn]] Callable fail_construct() {
-		Unexpected("Attempt to copy-construct a move-only type.");
+template <typename Callable, typename Return, typename ...Args>
+struct unique_function_allocated {
+	static Callable *&get(void *storage) {
+		return *std::launder(reinterpret_cast<Callable**>(storage));
 	}
-	[[noreturn]] moveable_callable_wrap &fail_assign() {
-		Unexpected("Attempt to copy-assign a move-only type.");
+	static Return call(void *storage, Args &&...args) {
+		if constexpr (std::is_void_v<Return>) {
+			(*get(storage))(std::forward<Args>(args)...);
+		} else {
+			return (*get(storage))(std::forward<Args>(args)...);
+		}
+	}
+	static void move(void *to, void *from) noexcept {
+		new (to) Callable*(get(from));
+	}
+	static void destroy(void *storage) noexcept {
+		delete get(storage);
 	}
 
-	Callable _value;
-
+	static constexpr auto vtable = unique_function_vtable<Return, Args...>{
+		&call,
+		&move,
+		&destroy,
+	};
 };
 
 } // namespace details
@@ -70,6 +94,7 @@ private:
 template <typename Function>
 class unique_function;
 
+// Move-only std::function replacement that keeps small callables inline.
 template <typename Return, typename ...Args>
 class unique_function<Return(Args...)> final {
 public:
@@ -79,11 +104,14 @@ public:
 	unique_function &operator=(const unique_function &other) = delete;
 
 	// Move construct / assign from the same type.
-	unique_function(unique_function &&other)
-	: _impl(std::move(other._impl)) {
+	unique_function(unique_function &&other) noexcept {
+		take(other);
 	}
-	unique_function &operator=(unique_function &&other) {
-		_impl = std::move(other._impl);
+	unique_function &operator=(unique_function &&other) noexcept {
+		if (this != &other) {
+			reset();
+			take(other);
+		}
 		return *this;
 	}
 
@@ -94,10 +122,8 @@ public:
 				decltype(std::declval<Callable>()(
 					std::declval<Args>()...)),
 				Return>>>
-	unique_function(Callable &&other)
-	: unique_function(
-		std::forward<Callable>(other),
-		std::is_copy_constructible<std::decay_t<Callable>>{}) {
+	unique_function(Callable &&other) {
+		assign(std::forward<Callable>(other));
 	}
 
 	template <
@@ -108,71 +134,100 @@ public:
 					std::declval<Args>()...)),
 				Return>>>
 	unique_function &operator=(Callable &&other) {
-		using Decayed = std::decay_t<Callable>;
-		if constexpr (std::is_copy_constructible_v<Decayed>) {
-			_impl = std::forward<Callable>(other);
-		} else if constexpr (std::is_move_constructible_v<Decayed>) {
-			_impl = details::moveable_callable_wrap<Decayed>(
-				std::forward<Callable>(other));
-		} else {
-			static_assert(false_t(other), "Should be moveable.");
-		}
+		reset();
+		assign(std::forward<Callable>(other));
 		return *this;
 	}
 
-	void swap(unique_function &other) {
-		_impl.swap(other._impl);
+	void swap(unique_function &other) noexcept {
+		auto temp = std::move(other);
+		other = std::move(*this);
+		*this = std::move(temp);
 	}
 
 	Return operator()(Args ...args) {
-		return _impl(std::forward<Args>(args)...);
+		return _vtable->call(&_storage, std::forward<Args>(args)...);
 	}
 
 	explicit operator bool() const {
-		return _impl.operator bool();
+		return (_vtable != nullptr);
 	}
 
 	friend inline bool operator==(
 			const unique_function &value,
 			std::nullptr_t) noexcept {
-		return value._impl == nullptr;
+		return !value;
 	}
 	friend inline bool operator==(
 			std::nullptr_t,
 			const unique_function &value) noexcept {
-		return value._impl == nullptr;
+		return !value;
 	}
 	friend inline bool operator!=(
 			const unique_function &value,
 			std::nullptr_t) noexcept {
-		return value._impl != nullptr;
+		return static_cast<bool>(value);
 	}
 	friend inline bool operator!=(
 			std::nullptr_t,
 			const unique_function &value) noexcept {
-		return value._impl != nullptr;
+		return static_cast<bool>(value);
 	}
 
-private:
-	template <typename Callable>
-	unique_function(Callable &&other, std::true_type)
-	: _impl(std::forward<Callable>(other)) {
+	~unique_function() {
+		reset();
 	}
 
+private:
+	using vtable_type = details::unique_function_vtable<Return, Args...>;
+
 	template <typename Callable>
-	unique_function(Callable &&other, std::false_type)
-	: _impl(details::moveable_callable_wrap<std::decay_t<Callable>>(
-		std::forward<Callable>(other))) {
+	void assign(Callable &&other) {
+		using Decayed = std::decay_t<Callable>;
+		static_assert(
+			std::is_move_constructible_v<Decayed>,
+			"Should be at least moveable.");
+
+		// Empty std::function or null function pointer gives empty result.
+		if constexpr (std::is_constructible_v<bool, const Decayed&>) {
+			if (!static_cast<bool>(other)) {
+				return;
+			}
+		}
+		if constexpr (details::unique_function_inline_v<Decayed>) {
+			using Implementation = details::unique_function_inline<
+				Decayed,
+				Return,
+				Args...>;
+			new (&_storage) Decayed(std::forward<Callable>(other));
+			_vtable = &Implementation::vtable;
+		} else {
+			using Implementation = details::unique_function_allocated<
+				Decayed,
+				Return,
+				Args...>;
+			new (&_storage) Decayed*(
+				new Decayed(std::forward<Callable>(other)));
+			_vtable = &Implementation::vtable;
+		}
+	}
+	void take(unique_function &other) noexcept {
+		if (other._vtable) {
+			other._vtable->move(&_storage, &other._storage);
+			_vtable = std::exchange(other._vtable, nullptr);
+		}
+	}
+	void reset() noexcept {
+		if (const auto vtable = std::exchange(_vtable, nullptr)) {
+			vtable->destroy(&_storage);
+		}
 	}
 
-	std::function<Return(Args...)> _impl;
+	const vtable_type *_vtable = nullptr;
+	std::aligned_storage_t<
+		details::kUniqueFunctionInlineSize,
+		details::kUniqueFunctionInlineAlign> _storage;
 
 };
 
 } // namespace base
-
-#ifdef UniqueFunctionUnexpected
-#undef UniqueFunctionUnexpected
-#undef Unexpected
-#endif // UniqueFunctionUnexpectedb
-
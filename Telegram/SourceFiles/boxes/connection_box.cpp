@@ -42,6 +42,7 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 namespace {
 
 constexpr auto kSaveSettingsDelayedTimeout = TimeMs(1000);
+constexpr auto kRecheckProxiesTimeout = TimeMs(30 * 1000);
 
 class ProxyRow : public Ui::RippleButton {
 public:
@@ -106,6 +107,7 @@ private:
 	void applyView(View &&view);
 	void setupButtons(int id, not_null<ProxyRow*> button);
 	int rowHeight() const;
+	QString aboutText() const;
 	void refreshProxyForCalls();
 
 	not_null<ProxiesBoxController*> _controller;
@@ -551,7 +553,7 @@ void ProxiesBox::setupContent() {
 			inner,
 			object_ptr<Ui::FlatLabel>(
 				inner,
-				lang(lng_proxy_about),
+				aboutText(),
 				Ui::FlatLabel::InitType::Simple,
 				st::boxDividerLabel),
 			st::proxyAboutPadding),
@@ -602,6 +604,24 @@ void ProxiesBox::setupContent() {
 	}, inner->lifetime());
 }
 
+QString ProxiesBox::aboutText() const {
+	const auto pings = Messenger::Instance().dcOptions()->fastestEndpoints();
+	if (pings.empty()) {
+		return lang(lng_proxy_about);
+	}
+	auto list = QStringList();
+	for (const auto &ping : pings) {
+		list.push_back(lng_proxy_latency_dc(
+			lt_dc,
+			QString::number(ping.id),
+			lt_ping,
+			QString::number(ping.ping)));
+	}
+	return lang(lng_proxy_about)
+		+ "\n\n"
+		+ lng_proxy_latency(lt_list, list.join(", "));
+}
+
 void ProxiesBox::refreshProxyForCalls() {
 	if (!_proxyForCalls) {
 		return;
@@ -1044,7 +1064,8 @@ void AutoDownloadBox::setupContent() {
 }
 
 ProxiesBoxController::ProxiesBoxController()
-: _saveTimer([] { Local::writeSettings(); }) {
+: _saveTimer([] { Local::writeSettings(); })
+, _recheckTimer([=] { recheckItems(); }) {
 	_list = ranges::view::all(
 		Global::ProxiesList()
 	) | ranges::view::transform([&](const ProxyData &proxy) {
@@ -1062,6 +1083,7 @@ ProxiesBoxController::ProxiesBoxController()
 	for (auto &item : _list) {
 		refreshChecker(item);
 	}
+	_recheckTimer.callEach(kRecheckProxiesTimeout);
 }
 
 void ProxiesBoxController::ShowApplyConfirmation(
@@ -1172,6 +1194,17 @@ void ProxiesBoxController::refreshChecker(Item &item) {
 	}
 }
 
+void ProxiesBoxController::recheckItems() {
+	// Keep the pings up to date while the box is open. The views are
+	// not switched to the checking state, they get the new results.
+	for (auto &item : _list) {
+		if (item.deleted || item.checker || item.checkerv6) {
+			continue;
+		}
+		refreshChecker(item);
+	}
+}
+
 void ProxiesBoxController::setupChecker(int id, const Checker &checker) {
 	using Connection = MTP::internal::AbstractConnection;
 	const auto pointer = checker.get();
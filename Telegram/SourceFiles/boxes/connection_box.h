@@ -103,6 +103,7 @@ private:
 	void share(const ProxyData &proxy);
 	void saveDelayed();
 	void refreshChecker(Item &item);
+	void recheckItems();
 	void setupChecker(int id, const Checker &checker);
 
 	void replaceItemWith(
@@ -117,6 +118,7 @@ private:
 	std::vector<Item> _list;
 	rpl::event_stream<ItemView> _views;
 	base::Timer _saveTimer;
+	base::Timer _recheckTimer;
 	rpl::event_stream<ProxyData::Settings> _proxySettingsChanges;
 
 	ProxyData _lastSelectedProxy;
@@ -378,6 +378,7 @@ void LocalStorageBox::setupControls() {
 	createTagRow(Data::kVoiceMessageCacheTag, lng_local_storage_voice);
 	createTagRow(Data::kVideoMessageCacheTag, lng_local_storage_round);
 	createTagRow(Data::kAnimationCacheTag, lng_local_storage_animation);
+	createTagRow(Data::kPreparedImageCacheTag, lng_local_storage_preview);
 	shadow->toggleOn(
 		std::move(tracker).atLeastOneShownValue()
 	);
@@ -641,27 +641,47 @@ void PeerListContent::addToSearchIndex(not_null<PeerListRow*> row) {
 	}
 
 	removeFromSearchIndex(row);
-	row->setNameFirstLetters(row->peer()->nameFirstLetters());
-	for (auto ch : row->nameFirstLetters()) {
-		_searchIndex[ch].push_back(row);
+	row->setIndexedNameWords(row->peer()->nameWords());
+	for (const auto &word : row->indexedNameWords()) {
+		_searchIndex[word].emplace(row);
 	}
+
+	// The new row could match the last query as well.
+	_localSearchWords.clear();
+	_localSearchResults.clear();
 }
 
 void PeerListContent::removeFromSearchIndex(not_null<PeerListRow*> row) {
-	const auto &nameFirstLetters = row->nameFirstLetters();
-	if (!nameFirstLetters.empty()) {
-		for (auto ch : row->nameFirstLetters()) {
-			auto it = _searchIndex.find(ch);
+	const auto &words = row->indexedNameWords();
+	if (!words.empty()) {
+		for (const auto &word : words) {
+			auto it = _searchIndex.find(word);
 			if (it != _searchIndex.cend()) {
-				auto &entry = it->second;
-				entry.erase(ranges::remove(entry, row), end(entry));
-				if (entry.empty()) {
+				it->second.remove(row);
+				if (it->second.empty()) {
 					_searchIndex.erase(it);
 				}
 			}
 		}
-		row->setNameFirstLetters({});
+		row->setIndexedNameWords({});
+	}
+}
+
+std::vector<not_null<PeerListRow*>> PeerListContent::searchIndexRows(
+		const QString &prefix) const {
+	auto result = std::vector<not_null<PeerListRow*>>();
+	for (auto i = _searchIndex.lower_bound(prefix)
+		; (i != _searchIndex.end()) && i->first.startsWith(prefix)
+		; ++i) {
+		result.insert(end(result), i->second.begin(), i->second.end());
 	}
+
+	// Keep the rows order, a row can be found by several of its words.
+	ranges::sort(result, std::less<>(), [](not_null<PeerListRow*> row) {
+		return row->absoluteIndex();
+	});
+	result.erase(ranges::unique(result), end(result));
+	return result;
 }
 
 void PeerListContent::prependRow(std::unique_ptr<PeerListRow> row) {
@@ -735,6 +755,9 @@ void PeerListContent::removeRow(not_null<PeerListRow*> row) {
 	_filterResults.erase(
 		ranges::remove(_filterResults, row),
 		end(_filterResults));
+	_localSearchResults.erase(
+		ranges::remove(_localSearchResults, row),
+		end(_localSearchResults));
 	removeRowAtIndex(eraseFrom, index);
 
 	restoreSelection();
@@ -750,6 +773,8 @@ void PeerListContent::clearAllContent() {
 	_rowsByPeer.clear();
 	_filterResults.clear();
 	_searchIndex.clear();
+	_localSearchWords.clear();
+	_localSearchResults.clear();
 	_rows.clear();
 	_searchRows.clear();
 	_searchQuery
@@ -1233,6 +1258,7 @@ void PeerListContent::loadProfilePhotos() {
 	if (yTo < 0) return;
 	if (yFrom < 0) yFrom = 0;
 
+	auto loading = std::vector<not_null<PeerData*>>();
 	auto rowsCount = shownRowsCount();
 	if (rowsCount > 0) {
 		auto from = yFrom / _rowHeight;
@@ -1240,12 +1266,33 @@ void PeerListContent::loadProfilePhotos() {
 		if (from < rowsCount) {
 			auto to = (yTo / _rowHeight) + 1;
 			if (to > rowsCount) to = rowsCount;
+			auto visibleTill = (_visibleBottom / _rowHeight) + 1;
+			if (visibleTill > to) visibleTill = to;
 
+			loading.reserve(to - from);
 			for (auto index = from; index != to; ++index) {
-				getRow(RowIndex(index))->peer()->loadUserpic();
+				loading.push_back(getRow(RowIndex(index))->peer());
+			}
+
+			// Visible rows are put in front of the download queues,
+			// from the bottom one, so that the top row is loaded first.
+			for (auto index = visibleTill; index != from;) {
+				loading[--index - from]->loadUserpic(true);
+			}
+			for (auto index = visibleTill; index < to; ++index) {
+				loading[index - from]->loadUserpic();
 			}
 		}
 	}
+
+	// Userpics of rows scrolled far away wait until they are shown again.
+	std::sort(begin(loading), end(loading));
+	for (const auto peer : _userpicsLoading) {
+		if (!std::binary_search(begin(loading), end(loading), peer)) {
+			peer->pauseUserpicLoading();
+		}
+	}
+	_userpicsLoading = std::move(loading);
 }
 
 void PeerListContent::checkScrollForPreload() {
@@ -1260,46 +1307,50 @@ void PeerListContent::searchQueryChanged(QString query) {
 	if (_normalizedSearchQuery != normalizedQuery) {
 		setSearchQuery(query, normalizedQuery);
 		if (_controller->searchInLocal() && !searchWordsList.isEmpty()) {
-			auto minimalList = (const std::vector<not_null<PeerListRow*>>*)nullptr;
-			for_const (auto &searchWord, searchWordsList) {
-				auto searchWordStart = searchWord[0].toLower();
-				auto it = _searchIndex.find(searchWordStart);
-				if (it == _searchIndex.cend()) {
-					// Some word can't be found in any row.
-					minimalList = nullptr;
-					break;
-				} else if (!minimalList || minimalList->size() > it->second.size()) {
-					minimalList = &it->second;
+			auto candidates = std::vector<not_null<PeerListRow*>>();
+			if (extendsLocalSearch(searchWordsList)) {
+				candidates = base::take(_localSearchResults);
+			} else {
+				// The longest word is usually the most selective one.
+				auto longest = searchWordsList.front();
+				for_const (auto &searchWord, searchWordsList) {
+					if (searchWord.size() > longest.size()) {
+						longest = searchWord;
+					}
 				}
+				candidates = searchIndexRows(longest);
 			}
-			if (minimalList) {
-				auto searchWordInNames = [](
-						not_null<PeerData*> peer,
-						const QString &searchWord) {
-					for (auto &nameWord : peer->nameWords()) {
-						if (nameWord.startsWith(searchWord)) {
-							return true;
-						}
+			auto searchWordInNames = [](
+					not_null<PeerData*> peer,
+					const QString &searchWord) {
+				for (auto &nameWord : peer->nameWords()) {
+					if (nameWord.startsWith(searchWord)) {
+						return true;
 					}
-					return false;
-				};
-				auto allSearchWordsInNames = [&](
-						not_null<PeerData*> peer) {
-					for_const (auto &searchWord, searchWordsList) {
-						if (!searchWordInNames(peer, searchWord)) {
-							return false;
-						}
+				}
+				return false;
+			};
+			auto allSearchWordsInNames = [&](
+					not_null<PeerData*> peer) {
+				for_const (auto &searchWord, searchWordsList) {
+					if (!searchWordInNames(peer, searchWord)) {
+						return false;
 					}
-					return true;
-				};
+				}
+				return true;
+			};
 
-				_filterResults.reserve(minimalList->size());
-				for_const (auto row, *minimalList) {
-					if (allSearchWordsInNames(row->peer())) {
-						_filterResults.push_back(row);
-					}
+			_filterResults.reserve(candidates.size());
+			for_const (auto row, candidates) {
+				if (allSearchWordsInNames(row->peer())) {
+					_filterResults.push_back(row);
 				}
 			}
+			_localSearchWords = searchWordsList;
+			_localSearchResults = _filterResults;
+		} else {
+			_localSearchWords.clear();
+			_localSearchResults.clear();
 		}
 		if (_controller->hasComplexSearch()) {
 			_controller->search(_searchQuery);
@@ -1309,6 +1360,26 @@ void PeerListContent::searchQueryChanged(QString query) {
 	}
 }
 
+bool PeerListContent::extendsLocalSearch(
+		const QStringList &searchWordsList) const {
+	if (_localSearchWords.isEmpty()) {
+		return false;
+	}
+
+	// Each row matching the new words matches the previous words as well
+	// if each previous word is a prefix of some new word.
+	for_const (auto &was, _localSearchWords) {
+		const auto extended = ranges::find_if(searchWordsList, [&](
+				const QString &word) {
+			return word.startsWith(was);
+		});
+		if (extended == searchWordsList.end()) {
+			return false;
+		}
+	}
+	return true;
+}
+
 std::unique_ptr<PeerListState> PeerListContent::saveState() const {
 	auto result = std::make_unique<PeerListState>();
 	result->controllerState
@@ -177,11 +177,11 @@ public:
 		int outerWidth);
 	float64 checkedRatio();
 
-	void setNameFirstLetters(const base::flat_set<QChar> &firstLetters) {
-		_nameFirstLetters = firstLetters;
+	void setIndexedNameWords(const base::flat_set<QString> &words) {
+		_indexedNameWords = words;
 	}
-	const base::flat_set<QChar> &nameFirstLetters() const {
-		return _nameFirstLetters;
+	const base::flat_set<QString> &indexedNameWords() const {
+		return _indexedNameWords;
 	}
 
 	virtual void lazyInitialize(const style::PeerListItem &st);
@@ -218,7 +218,7 @@ private:
 	Text _status;
 	StatusType _statusType = StatusType::Online;
 	TimeMs _statusValidTill = 0;
-	base::flat_set<QChar> _nameFirstLetters;
+	base::flat_set<QString> _indexedNameWords;
 	int _absoluteIndex = -1;
 	State _disabledState = State::Active;
 	bool _initialized : 1;
@@ -471,10 +471,9 @@ public:
 	template <typename ReorderCallback>
 	void reorderRows(ReorderCallback &&callback) {
 		callback(_rows.begin(), _rows.end());
-		for (auto &searchEntity : _searchIndex) {
-			callback(searchEntity.second.begin(), searchEntity.second.end());
-		}
 		refreshIndices();
+		_localSearchWords.clear();
+		_localSearchResults.clear();
 		update();
 	}
 
@@ -570,6 +569,9 @@ private:
 	void addToSearchIndex(not_null<PeerListRow*> row);
 	bool addingToSearchIndex() const;
 	void removeFromSearchIndex(not_null<PeerListRow*> row);
+	std::vector<not_null<PeerListRow*>> searchIndexRows(
+		const QString &prefix) const;
+	bool extendsLocalSearch(const QStringList &searchWordsList) const;
 	void setSearchQuery(const QString &query, const QString &normalizedQuery);
 	bool showingSearch() const {
 		return !_searchQuery.isEmpty();
@@ -610,12 +612,21 @@ private:
 	std::map<PeerListRowId, not_null<PeerListRow*>> _rowsById;
 	std::map<PeerData*, std::vector<not_null<PeerListRow*>>> _rowsByPeer;
 
-	std::map<QChar, std::vector<not_null<PeerListRow*>>> _searchIndex;
+	// Rows by their name words, the rows with a name word starting with
+	// some prefix are found in a range of this map.
+	std::map<
+		QString,
+		base::flat_set<not_null<PeerListRow*>>> _searchIndex;
 	QString _searchQuery;
 	QString _normalizedSearchQuery;
 	QString _mentionHighlight;
 	std::vector<not_null<PeerListRow*>> _filterResults;
 
+	// Local results of the last query, a query extending it is searched
+	// only among them instead of all the rows with the same first letter.
+	QStringList _localSearchWords;
+	std::vector<not_null<PeerListRow*>> _localSearchResults;
+
 	int _aboveHeight = 0;
 	object_ptr<TWidget> _aboveWidget = { nullptr };
 	object_ptr<Ui::FlatLabel> _description = { nullptr };
@@ -625,6 +636,7 @@ private:
 	QPoint _lastMousePosition;
 
 	std::vector<std::unique_ptr<PeerListRow>> _searchRows;
+	std::vector<not_null<PeerData*>> _userpicsLoading;
 	base::Timer _repaintByStatus;
 	base::unique_qptr<Ui::PopupMenu> _contextMenu;
 
@@ -38,6 +38,7 @@ constexpr auto kMinLayer = 65;
 constexpr auto kMaxLayer = 75;
 constexpr auto kHangupTimeoutMs = 5000;
 constexpr auto kSha256Size = 32;
+constexpr auto kDebugInfoUpdateInterval = TimeMs(1000);
 
 using tgvoip::Endpoint;
 
@@ -129,6 +130,7 @@ Call::Call(
 , _user(user)
 , _type(type) {
 	_discardByTimeoutTimer.setCallback([this] { hangup(); });
+	_debugInfoTimer.setCallback([this] { updateDebugInfo(); });
 
 	if (_type == Type::Outgoing) {
 		setState(State::Requesting);
@@ -738,6 +740,10 @@ void Call::setState(State state) {
 		switch (_state) {
 		case State::Established:
 			_startTime = getms(true);
+			if (Logs::DebugEnabled()) {
+				updateDebugInfo();
+				_debugInfoTimer.callEach(kDebugInfoUpdateInterval);
+			}
 			break;
 		case State::ExchangingKeys:
 			_delegate->playSound(Delegate::Sound::Connecting);
@@ -845,9 +851,17 @@ void Call::destroyController() {
 		_controller.reset();
 		DEBUG_LOG(("Call Info: Call controller destroyed."));
 	}
+	_debugInfoTimer.cancel();
+	_debugInfo = QString();
 	setSignalBarCount(kSignalBarFinished);
 }
 
+void Call::updateDebugInfo() {
+	if (_controller) {
+		_debugInfo = getDebugLog();
+	}
+}
+
 Call::~Call() {
 	destroyController();
 }
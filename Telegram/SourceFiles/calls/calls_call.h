@@ -122,6 +122,11 @@ public:
 
 	QString getDebugLog() const;
 
+	// Controller statistics, updated while established in debug mode.
+	rpl::producer<QString> debugInfoValue() const {
+		return _debugInfo.value();
+	}
+
 	~Call();
 
 private:
@@ -176,6 +181,7 @@ private:
 	void setFailedQueued(int error);
 	void setSignalBarCount(int count);
 	void destroyController();
+	void updateDebugInfo();
 
 	not_null<Delegate*> _delegate;
 	not_null<UserData*> _user;
@@ -189,6 +195,8 @@ private:
 	TimeMs _startTime = 0;
 	base::DelayedCallTimer _finishByTimeoutTimer;
 	base::Timer _discardByTimeoutTimer;
+	base::Timer _debugInfoTimer;
+	rpl::variable<QString> _debugInfo;
 
 	bool _mute = false;
 	base::Observable<bool> _muteChanged;
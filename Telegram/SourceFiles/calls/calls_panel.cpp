@@ -414,6 +414,18 @@ void Panel::reinitControls() {
 
 	_name->setText(App::peerName(_call->user()));
 	updateStatusText(_call->state());
+
+	_debugInfoLifetime.destroy();
+	if (Logs::DebugEnabled()) {
+		if (!_debugInfo) {
+			_debugInfo.create(this, st::callDebugInfo);
+			_debugInfo->setAttribute(Qt::WA_TransparentForMouseEvents);
+		}
+		_call->debugInfoValue(
+		) | rpl::start_with_next([=](const QString &text) {
+			_debugInfo->setText(text);
+		}, _debugInfoLifetime);
+	}
 }
 
 void Panel::initLayout() {
@@ -668,6 +680,14 @@ void Panel::updateControlsGeometry() {
 	_signalBars->moveToLeft(
 		_padding.left() + skip,
 		_padding.top() + skip + delta / 2);
+
+	if (_debugInfo) {
+		_debugInfo->resizeToWidth(
+			width() - _padding.left() - _padding.right() - 2 * skip);
+		_debugInfo->moveToLeft(
+			_padding.left() + skip,
+			_signalBars->y() + _signalBars->height() + skip);
+	}
 }
 
 void Panel::updateHangupGeometry() {
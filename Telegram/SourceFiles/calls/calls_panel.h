@@ -131,6 +131,8 @@ private:
 	object_ptr<Ui::FlatLabel> _name;
 	object_ptr<Ui::FlatLabel> _status;
 	object_ptr<SignalBars> _signalBars;
+	object_ptr<Ui::FlatLabel> _debugInfo = { nullptr };
+	rpl::lifetime _debugInfoLifetime;
 	std::vector<EmojiPtr> _fingerprint;
 	QRect _fingerprintArea;
 
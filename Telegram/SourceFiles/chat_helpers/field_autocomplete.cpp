@@ -125,7 +125,7 @@ bool FieldAutocomplete::clearFilteredBotCommands() {
 namespace {
 template <typename T, typename U>
 inline int indexOfInFirstN(const T &v, const U &elem, int last) {
-	for (auto b = v.cbegin(), i = b, e = b + qMax(v.size(), last); i != e; ++i) {
+	for (auto b = v.cbegin(), i = b, e = b + qMin(v.size(), last); i != e; ++i) {
 		if (*i == elem) {
 			return (i - b);
 		}
@@ -164,11 +164,15 @@ void FieldAutocomplete::updateFiltered(bool resetScroll) {
 			return true;
 		};
 		auto filterNotPassedByName = [&](UserData *user) -> bool {
-			for (const auto &nameWord : user->nameWords()) {
-				if (nameWord.startsWith(_filter, Qt::CaseInsensitive)) {
-					auto exactUsername = (user->username.compare(_filter, Qt::CaseInsensitive) == 0);
-					return exactUsername;
-				}
+			// Name words are sorted and lowercase, like the filter.
+			const auto &nameWords = user->nameWords();
+			const auto i = std::lower_bound(
+				nameWords.begin(),
+				nameWords.end(),
+				_filter);
+			if (i != nameWords.end() && i->startsWith(_filter)) {
+				auto exactUsername = (user->username.compare(_filter, Qt::CaseInsensitive) == 0);
+				return exactUsername;
 			}
 			return filterNotPassedByUsername(user);
 		};
@@ -30,6 +30,9 @@ namespace {
 constexpr auto kSaveChosenTabTimeout = 1000;
 constexpr auto kSearchRequestDelay = 400;
 constexpr auto kInlineItemsMaxPerRow = 5;
+
+// Thumbnails are preloaded for the rows that far from the visible area.
+constexpr auto kPreloadScreens = 2;
 constexpr auto kSearchBotUsername = str_const("gif");
 
 } // namespace
@@ -166,6 +169,7 @@ void GifsListWidget::visibleTopBottomUpdated(
 	Inner::visibleTopBottomUpdated(visibleTop, visibleBottom);
 	if (top != getVisibleTop()) {
 		_lastScrolled = getms();
+		preloadImages();
 	}
 	checkLoadMore();
 }
@@ -611,9 +615,33 @@ void GifsListWidget::layoutInlineRow(Row &row, int fullWidth) {
 }
 
 void GifsListWidget::preloadImages() {
+	const auto visibleTop = getVisibleTop();
+	const auto visibleBottom = std::max(
+		getVisibleBottom(),
+		visibleTop + st::emojiPanMinHeight);
+	const auto distance = kPreloadScreens * (visibleBottom - visibleTop);
+
+	// Load the closest rows first, they are requested in that order.
+	auto preload = std::vector<std::pair<int, int>>();
+	auto top = st::stickerPanPadding;
 	for (auto row = 0, rows = _rows.size(); row != rows; ++row) {
-		for (auto col = 0, cols = _rows[row].items.size(); col != cols; ++col) {
-			_rows[row].items[col]->preload();
+		const auto bottom = top + _rows[row].height;
+		const auto till = (bottom <= visibleTop)
+			? (visibleTop - bottom)
+			: (top >= visibleBottom)
+			? (top - visibleBottom)
+			: 0;
+		if (till <= distance) {
+			preload.emplace_back(till, row);
+		} else if (top >= visibleBottom) {
+			break;
+		}
+		top = bottom;
+	}
+	ranges::sort(preload);
+	for (const auto &entry : preload) {
+		for (const auto item : _rows[entry.second].items) {
+			item->preload();
 		}
 	}
 }
@@ -0,0 +1,299 @@
+/*
+This file is part of Telegram Desktop,
+the official desktop application for the Telegram messaging service.
+
+For license and copyright information please follow this link:
+https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
+*/
+#include "chat_helpers/stickers_atlas.h"
+
+#include "data/data_document.h"
+#include "data/data_session.h"
+#include "ui/image/image.h"
+#include "storage/cache/storage_cache_database.h"
+#include "auth_session.h"
+
+#include <QtCore/QBuffer>
+
+namespace ChatHelpers {
+namespace {
+
+constexpr auto kSerializeVersion = 1;
+constexpr auto kMaxColumns = 8;
+
+// Atlases of the sets around the visible part of the panel are enough.
+constexpr auto kMaxEntries = 8;
+
+QPoint CellPosition(int index, int columns, QSize cell) {
+	return QPoint(
+		(index % columns) * cell.width(),
+		(index / columns) * cell.height());
+}
+
+QByteArray Serialize(
+		QSize cell,
+		int columns,
+		const std::vector<DocumentId> &ids,
+		const QImage &image) {
+	auto png = QByteArray();
+	{
+		QBuffer buffer(&png);
+		image.save(&buffer, "PNG");
+	}
+	auto result = QByteArray();
+	{
+		QDataStream stream(&result, QIODevice::WriteOnly);
+		stream.setVersion(QDataStream::Qt_5_1);
+		stream
+			<< qint32(kSerializeVersion)
+			<< qint32(cell.width())
+			<< qint32(cell.height())
+			<< qint32(columns)
+			<< qint32(ids.size());
+		for (const auto id : ids) {
+			stream << quint64(id);
+		}
+		stream << png;
+	}
+	return result;
+}
+
+} // namespace
+
+StickersAtlas::StickersAtlas(Fn<void()> repaint)
+: _repaint(std::move(repaint)) {
+}
+
+QSize StickersAtlas::PreviewSize(
+		not_null<DocumentData*> document,
+		QSize cell) {
+	const auto dimensions = document->dimensions;
+	auto coef = qMin(
+		cell.width() / float64(dimensions.width()),
+		cell.height() / float64(dimensions.height()));
+	if (coef > 1) coef = 1;
+	return QSize(
+		qMax(qRound(coef * dimensions.width()), 1),
+		qMax(qRound(coef * dimensions.height()), 1));
+}
+
+bool StickersAtlas::prepare(
+		uint64 setId,
+		const Stickers::Pack &pack,
+		QSize cell) {
+	if (pack.isEmpty() || cell.isEmpty()) {
+		return false;
+	}
+	auto &entry = _entries[setId];
+	if (entry.cell != cell) {
+		entry = Entry();
+		entry.cell = cell;
+	} else if (entry.pack != pack && entry.state == State::Ready) {
+		entry.state = State::Missing;
+		entry.pixmap = QPixmap();
+	}
+	entry.pack = pack;
+	entry.lastUsed = ++_usedCounter;
+
+	switch (entry.state) {
+	case State::Unknown:
+		load(setId, entry);
+		removeOldEntries();
+		return true;
+	case State::Loading:
+	case State::Ready:
+		return true;
+	case State::Missing:
+		return generate(setId, entry);
+	}
+	Unexpected("State in StickersAtlas::prepare.");
+}
+
+void StickersAtlas::paint(
+		Painter &p,
+		QPoint position,
+		int outerWidth,
+		uint64 setId,
+		int index,
+		QSize size) {
+	const auto i = _entries.find(setId);
+	if (i == _entries.end() || i->second.state != State::Ready) {
+		return;
+	}
+	const auto &entry = i->second;
+	if (index < 0 || index >= entry.pack.size()) {
+		return;
+	}
+	const auto factor = cIntRetinaFactor();
+	const auto from = QRect(
+		CellPosition(index, entry.columns, entry.cell) * factor,
+		size * factor);
+	p.drawPixmapLeft(QRect(position, size), outerWidth, entry.pixmap, from);
+}
+
+void StickersAtlas::clear() {
+	_entries.clear();
+}
+
+void StickersAtlas::load(uint64 setId, Entry &entry) {
+	auto [left, right] = base::make_binary_guard();
+	entry.state = State::Loading;
+	entry.loading = std::move(left);
+
+	const auto cell = entry.cell;
+	auto callback = [=, guard = std::move(right)](
+			QByteArray &&value) mutable {
+		auto data = Loaded();
+		QDataStream stream(&value, QIODevice::ReadOnly);
+		stream.setVersion(QDataStream::Qt_5_1);
+		auto version = qint32();
+		auto width = qint32();
+		auto height = qint32();
+		auto columns = qint32();
+		auto count = qint32();
+		stream >> version >> width >> height >> columns >> count;
+		if (stream.status() == QDataStream::Ok
+			&& version == kSerializeVersion
+			&& QSize(width, height) == cell
+			&& columns > 0
+			&& count > 0) {
+			data.columns = columns;
+			data.ids.reserve(count);
+			for (auto i = 0; i != count; ++i) {
+				auto id = quint64();
+				stream >> id;
+				data.ids.push_back(id);
+			}
+			auto png = QByteArray();
+			stream >> png;
+			if (stream.status() == QDataStream::Ok) {
+				data.image = QImage::fromData(png, "PNG").convertToFormat(
+					QImage::Format_ARGB32_Premultiplied);
+			}
+		}
+		crl::on_main([
+			=,
+			guard = std::move(guard),
+			data = std::move(data)
+		]() mutable {
+			if (guard.alive()) {
+				loaded(setId, std::move(data));
+			}
+		});
+	};
+	Auth().data().cache().get(
+		Data::StickersAtlasCacheKey(setId, cell),
+		std::move(callback),
+		Storage::Cache::Priority::Visible);
+}
+
+void StickersAtlas::loaded(uint64 setId, Loaded &&data) {
+	const auto i = _entries.find(setId);
+	if (i == _entries.end()) {
+		return;
+	}
+	auto &entry = i->second;
+	entry.loading = base::binary_guard();
+
+	const auto matches = [&] {
+		if (data.image.isNull() || data.ids.size() != entry.pack.size()) {
+			return false;
+		}
+		for (auto i = 0; i != entry.pack.size(); ++i) {
+			if (entry.pack[i]->id != data.ids[i]) {
+				return false;
+			}
+		}
+		return true;
+	}();
+	if (matches) {
+		entry.state = State::Ready;
+		entry.columns = data.columns;
+		entry.pixmap = App::pixmapFromImageInPlace(std::move(data.image));
+		entry.pixmap.setDevicePixelRatio(cRetinaFactor());
+	} else {
+		entry.state = State::Missing;
+	}
+	_repaint();
+}
+
+bool StickersAtlas::generate(uint64 setId, Entry &entry) {
+	// All the previews are loaded once, after that the set is painted
+	// from the atlas until the stickers in it change.
+	auto ready = true;
+	for (const auto document : entry.pack) {
+		if (!document->sticker()) {
+			return false;
+		}
+		const auto image = document->getStickerThumb();
+		if (!image || !image->loaded()) {
+			document->checkStickerThumb();
+			ready = false;
+		}
+	}
+	if (!ready) {
+		return false;
+	}
+
+	const auto cell = entry.cell;
+	const auto count = entry.pack.size();
+	const auto columns = std::min(count, kMaxColumns);
+	const auto rows = (count + columns - 1) / columns;
+	const auto factor = cIntRetinaFactor();
+	auto image = QImage(
+		QSize(columns * cell.width(), rows * cell.height()) * factor,
+		QImage::Format_ARGB32_Premultiplied);
+	image.setDevicePixelRatio(cRetinaFactor());
+	image.fill(Qt::transparent);
+	auto ids = std::vector<DocumentId>();
+	ids.reserve(count);
+	{
+		QPainter p(&image);
+		for (auto i = 0; i != count; ++i) {
+			const auto document = entry.pack[i];
+			const auto size = PreviewSize(document, cell);
+			const auto preview = document->getStickerThumb()->pixSingle(
+				document->stickerSetOrigin(),
+				size.width(),
+				size.height(),
+				size.width(),
+				size.height(),
+				ImageRoundRadius::None);
+			p.drawPixmap(CellPosition(i, columns, cell), preview);
+			ids.push_back(document->id);
+		}
+	}
+	entry.state = State::Ready;
+	entry.columns = columns;
+	entry.pixmap = App::pixmapFromImageInPlace(base::duplicate(image));
+	entry.pixmap.setDevicePixelRatio(cRetinaFactor());
+
+	const auto key = Data::StickersAtlasCacheKey(setId, cell);
+	crl::async([=, image = std::move(image), ids = std::move(ids)] {
+		const auto value = Serialize(cell, columns, ids, image);
+		crl::on_main(&Auth(), [=] {
+			Auth().data().cache().put(
+				key,
+				Storage::Cache::Database::TaggedValue(
+					base::duplicate(value),
+					Data::kStickerCacheTag),
+				nullptr,
+				Storage::Cache::Priority::Background);
+		});
+	});
+	return true;
+}
+
+void StickersAtlas::removeOldEntries() {
+	while (_entries.size() > kMaxEntries) {
+		const auto oldest = std::min_element(
+			_entries.begin(),
+			_entries.end(),
+			[](const auto &a, const auto &b) {
+				return (a.second.lastUsed < b.second.lastUsed);
+			});
+		_entries.erase(oldest);
+	}
+}
+
+} // namespace ChatHelpers
@@ -0,0 +1,71 @@
+/*
+This file is part of Telegram Desktop,
+the official desktop application for the Telegram messaging service.
+
+For license and copyright information please follow this link:
+https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
+*/
+#pragma once
+
+#include "chat_helpers/stickers.h"
+#include "base/binary_guard.h"
+#include "base/flat_map.h"
+
+namespace ChatHelpers {
+
+// Downscaled previews of all stickers of an installed set in one image.
+// The image is kept in the disk cache, so that a set is painted after a
+// single read and decode instead of one for each of its stickers.
+class StickersAtlas {
+public:
+	explicit StickersAtlas(Fn<void()> repaint);
+
+	static QSize PreviewSize(not_null<DocumentData*> document, QSize cell);
+
+	// Returns false if the stickers of the set should be painted one by
+	// one, true if they are painted from the atlas or it is being read.
+	bool prepare(uint64 setId, const Stickers::Pack &pack, QSize cell);
+	void paint(
+		Painter &p,
+		QPoint position,
+		int outerWidth,
+		uint64 setId,
+		int index,
+		QSize size);
+
+	void clear();
+
+private:
+	enum class State {
+		Unknown,
+		Loading,
+		Missing,
+		Ready,
+	};
+	struct Entry {
+		State state = State::Unknown;
+		Stickers::Pack pack;
+		QSize cell;
+		QPixmap pixmap;
+		int columns = 0;
+		int lastUsed = 0;
+		base::binary_guard loading;
+	};
+	struct Loaded {
+		QImage image;
+		int columns = 0;
+		std::vector<DocumentId> ids;
+	};
+
+	void load(uint64 setId, Entry &entry);
+	void loaded(uint64 setId, Loaded &&data);
+	bool generate(uint64 setId, Entry &entry);
+	void removeOldEntries();
+
+	Fn<void()> _repaint;
+	base::flat_map<uint64, Entry> _entries;
+	int _usedCounter = 0;
+
+};
+
+} // namespace ChatHelpers
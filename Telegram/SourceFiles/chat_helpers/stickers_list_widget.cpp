@@ -16,6 +16,7 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 #include "inline_bots/inline_bot_result.h"
 #include "chat_helpers/stickers.h"
 #include "storage/localstorage.h"
+#include "storage/file_download.h"
 #include "lang/lang_keys.h"
 #include "mainwindow.h"
 #include "dialogs/dialogs_layout.h"
@@ -682,7 +683,8 @@ StickersListWidget::StickersListWidget(QWidget *parent, not_null<Window::Control
 , _addText(lang(lng_stickers_featured_add).toUpper())
 , _addWidth(st::stickersTrendingAdd.font->width(_addText))
 , _settings(this, lang(lng_stickers_you_have))
-, _searchRequestTimer([=] { sendSearchRequest(); }) {
+, _searchRequestTimer([=] { sendSearchRequest(); })
+, _atlas([=] { update(); }) {
 	setMouseTracking(true);
 	setAttribute(Qt::WA_OpaquePaintEvent);
 
@@ -755,10 +757,15 @@ int StickersListWidget::featuredRowHeight() const {
 		+ st::stickersTrendingSkip;
 }
 
-template <typename Callback>
-bool StickersListWidget::enumerateSections(Callback callback) const {
-	auto info = SectionInfo();
+auto StickersListWidget::sectionsLayout() const
+-> const std::vector<SectionInfo> & {
 	const auto &sets = shownSets();
+	if (_sectionsLayoutValid && _sectionsLayout.size() == sets.size()) {
+		return _sectionsLayout;
+	}
+	_sectionsLayout.clear();
+	_sectionsLayout.reserve(sets.size());
+	auto info = SectionInfo();
 	for (auto i = 0; i != sets.size(); ++i) {
 		auto &set = sets[i];
 		info.section = i;
@@ -779,37 +786,45 @@ bool StickersListWidget::enumerateSections(Callback callback) const {
 			info.rowsCount = (info.count / _columnCount) + ((info.count % _columnCount) ? 1 : 0);
 			info.rowsBottom = info.rowsTop + info.rowsCount * _singleSize.height();
 		}
+		_sectionsLayout.push_back(info);
+		info.top = info.rowsBottom;
+	}
+	_sectionsLayoutValid = true;
+	return _sectionsLayout;
+}
+
+void StickersListWidget::invalidateSectionsLayout() {
+	_sectionsLayoutValid = false;
+}
+
+template <typename Callback>
+bool StickersListWidget::enumerateSections(Callback callback) const {
+	for (const auto &info : sectionsLayout()) {
 		if (!callback(info)) {
 			return false;
 		}
-		info.top = info.rowsBottom;
 	}
 	return true;
 }
 
 StickersListWidget::SectionInfo StickersListWidget::sectionInfo(int section) const {
 	Expects(section >= 0 && section < shownSets().size());
-	auto result = SectionInfo();
-	enumerateSections([searchForSection = section, &result](const SectionInfo &info) {
-		if (info.section == searchForSection) {
-			result = info;
-			return false;
-		}
-		return true;
-	});
-	return result;
+	return sectionsLayout()[section];
 }
 
 StickersListWidget::SectionInfo StickersListWidget::sectionInfoByOffset(int yOffset) const {
-	auto result = SectionInfo();
-	enumerateSections([this, &result, yOffset](const SectionInfo &info) {
-		if (yOffset < info.rowsBottom || info.section == shownSets().size() - 1) {
-			result = info;
-			return false;
-		}
-		return true;
-	});
-	return result;
+	const auto &layout = sectionsLayout();
+	if (layout.empty()) {
+		return SectionInfo();
+	}
+	const auto i = std::upper_bound(
+		layout.begin(),
+		layout.end(),
+		yOffset,
+		[](int yOffset, const SectionInfo &info) {
+			return (yOffset < info.rowsBottom);
+		});
+	return (i != layout.end()) ? *i : layout.back();
 }
 
 int StickersListWidget::countDesiredHeight(int newWidth) {
@@ -828,6 +843,7 @@ int StickersListWidget::countDesiredHeight(int newWidth) {
 		- st::buttonRadius;
 	_singleSize = QSize(singleWidth, singleWidth);
 	setColumnCount(columnCount);
+	invalidateSectionsLayout();
 
 	auto visibleHeight = minimalHeight();
 	auto minimalHeight = (visibleHeight - st::stickerPanPadding);
@@ -941,6 +957,7 @@ void StickersListWidget::refreshSearchRows() {
 void StickersListWidget::refreshSearchRows(
 		const std::vector<uint64> *cloudSets) {
 	clearSelection();
+	invalidateSectionsLayout();
 
 	_searchSets.clear();
 	fillLocalSearchRows(_searchNextQuery);
@@ -1122,6 +1139,7 @@ void StickersListWidget::paintEvent(QPaintEvent *e) {
 	p.fillRect(clip, st::emojiPanBg);
 
 	paintStickers(p, clip);
+	Auth().downloader().sendLocalRequests();
 }
 
 void StickersListWidget::paintStickers(Painter &p, QRect clip) {
@@ -1217,7 +1235,8 @@ void StickersListWidget::paintStickers(Painter &p, QRect clip) {
 
 				auto selected = selectedSticker ? (selectedSticker->section == info.section && selectedSticker->index == index) : false;
 				auto deleteSelected = false;
-				paintSticker(p, set, info.rowsTop, index, selected, deleteSelected);
+				const auto fromAtlas = false;
+				paintSticker(p, set, info.rowsTop, index, selected, deleteSelected, fromAtlas);
 			}
 			return true;
 		}
@@ -1252,6 +1271,9 @@ void StickersListWidget::paintStickers(Painter &p, QRect clip) {
 				paintMegagroupEmptySet(p, info.rowsTop, buttonSelected, ms);
 			} else {
 				auto special = (set.flags & MTPDstickerSet::Flag::f_official) != 0;
+				const auto fromAtlas = !(set.flags & MTPDstickerSet_ClientFlag::f_special)
+					&& SetInMyList(set.flags)
+					&& _atlas.prepare(set.id, set.pack, stickerPreviewCell());
 				auto fromRow = floorclamp(clip.y() - info.rowsTop, _singleSize.height(), 0, info.rowsCount);
 				auto toRow = ceilclamp(clip.y() + clip.height() - info.rowsTop, _singleSize.height(), 0, info.rowsCount);
 				for (int i = fromRow; i < toRow; ++i) {
@@ -1261,7 +1283,7 @@ void StickersListWidget::paintStickers(Painter &p, QRect clip) {
 
 						auto selected = selectedSticker ? (selectedSticker->section == info.section && selectedSticker->index == index) : false;
 						auto deleteSelected = selected && selectedSticker->overDelete;
-						paintSticker(p, set, info.rowsTop, index, selected, deleteSelected);
+						paintSticker(p, set, info.rowsTop, index, selected, deleteSelected, fromAtlas);
 					}
 				}
 			}
@@ -1312,7 +1334,11 @@ void StickersListWidget::paintMegagroupEmptySet(Painter &p, int y, bool buttonSe
 	p.drawTextLeft(button.x() - (st::stickerGroupCategoryAdd.width / 2), button.y() + st::stickerGroupCategoryAdd.textTop, width(), _megagroupSetButtonText, _megagroupSetButtonTextWidth);
 }
 
-void StickersListWidget::paintSticker(Painter &p, Set &set, int y, int index, bool selected, bool deleteSelected) {
+QSize StickersListWidget::stickerPreviewCell() const {
+	return _singleSize - QSize(st::buttonRadius * 2, st::buttonRadius * 2);
+}
+
+void StickersListWidget::paintSticker(Painter &p, Set &set, int y, int index, bool selected, bool deleteSelected, bool fromAtlas) {
 	auto document = set.pack[index];
 	if (!document->sticker()) return;
 
@@ -1325,25 +1351,27 @@ void StickersListWidget::paintSticker(Painter &p, Set &set, int y, int index, bo
 		App::roundRect(p, QRect(tl, _singleSize), st::emojiPanHover, StickerHoverCorners);
 	}
 
-	document->checkStickerThumb();
-
-	auto coef = qMin((_singleSize.width() - st::buttonRadius * 2) / float64(document->dimensions.width()), (_singleSize.height() - st::buttonRadius * 2) / float64(document->dimensions.height()));
-	if (coef > 1) coef = 1;
-	auto w = qMax(qRound(coef * document->dimensions.width()), 1);
-	auto h = qMax(qRound(coef * document->dimensions.height()), 1);
+	const auto size = StickersAtlas::PreviewSize(document, stickerPreviewCell());
+	auto w = size.width();
+	auto h = size.height();
 	auto ppos = pos + QPoint((_singleSize.width() - w) / 2, (_singleSize.height() - h) / 2);
-	if (const auto image = document->getStickerThumb()) {
-		if (image->loaded()) {
-			p.drawPixmapLeft(
-				ppos,
-				width(),
-				image->pixSingle(
-					document->stickerSetOrigin(),
-					w,
-					h,
-					w,
-					h,
-					ImageRoundRadius::None));
+	if (fromAtlas) {
+		_atlas.paint(p, ppos, width(), set.id, index, size);
+	} else {
+		document->checkStickerThumb();
+		if (const auto image = document->getStickerThumb()) {
+			if (image->loaded()) {
+				p.drawPixmapLeft(
+					ppos,
+					width(),
+					image->pixSingle(
+						document->stickerSetOrigin(),
+						w,
+						h,
+						w,
+						h,
+						ImageRoundRadius::None));
+			}
 		}
 	}
 
@@ -1670,6 +1698,7 @@ void StickersListWidget::processHideFinished() {
 
 void StickersListWidget::processPanelHideFinished() {
 	clearInstalledLocally();
+	_atlas.clear();
 
 	// Preserve panel state through visibility toggles.
 	//// Reset to the recent stickers section.
@@ -1681,6 +1710,7 @@ void StickersListWidget::processPanelHideFinished() {
 
 void StickersListWidget::refreshStickers() {
 	clearSelection();
+	invalidateSectionsLayout();
 
 	_mySets.clear();
 	_favedStickersMap.clear();
@@ -1718,6 +1748,7 @@ void StickersListWidget::refreshStickers() {
 }
 
 void StickersListWidget::refreshSearchSets() {
+	invalidateSectionsLayout();
 	refreshSearchIndex();
 
 	const auto &sets = Auth().data().stickerSets();
@@ -1779,6 +1810,9 @@ void StickersListWidget::preloadImages() {
 	if (_footer) {
 		_footer->preloadImages();
 	}
+
+	// Read all the preloaded thumbnails from the cache in one batch.
+	Auth().downloader().sendLocalRequests();
 }
 
 uint64 StickersListWidget::currentSet(int yOffset) const {
@@ -1883,6 +1917,7 @@ Stickers::Pack StickersListWidget::collectRecentStickers() {
 
 void StickersListWidget::refreshRecentStickers(bool performResize) {
 	clearSelection();
+	invalidateSectionsLayout();
 
 	auto recentPack = collectRecentStickers();
 	auto recentIt = std::find_if(_mySets.begin(), _mySets.end(), [](auto &set) {
@@ -2193,6 +2228,7 @@ void StickersListWidget::showStickerSet(uint64 setId) {
 	if (setId == Stickers::FeaturedSetId) {
 		if (_section != Section::Featured) {
 			_section = Section::Featured;
+			invalidateSectionsLayout();
 
 			refreshRecentStickers(true);
 			refreshSettingsVisibility();
@@ -2210,6 +2246,7 @@ void StickersListWidget::showStickerSet(uint64 setId) {
 	auto needRefresh = (_section != Section::Stickers);
 	if (needRefresh) {
 		_section = Section::Stickers;
+		invalidateSectionsLayout();
 		refreshRecentStickers(true);
 		refreshSettingsVisibility();
 	}
@@ -2241,6 +2278,7 @@ void StickersListWidget::refreshMegagroupSetGeometry() {
 	_megagroupSetButtonTextWidth = st::stickerGroupCategoryAdd.font->width(_megagroupSetButtonText);
 	auto buttonWidth = _megagroupSetButtonTextWidth - st::stickerGroupCategoryAdd.width;
 	_megagroupSetButtonRect = QRect(left, top, buttonWidth, st::stickerGroupCategoryAdd.height);
+	invalidateSectionsLayout();
 }
 
 void StickersListWidget::showMegagroupSet(ChannelData *megagroup) {
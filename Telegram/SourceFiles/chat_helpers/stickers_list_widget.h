@@ -9,6 +9,7 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 
 #include "chat_helpers/tabbed_selector.h"
 #include "chat_helpers/stickers.h"
+#include "chat_helpers/stickers_atlas.h"
 #include "base/variant.h"
 #include "base/timer.h"
 
@@ -159,6 +160,9 @@ private:
 		int count = 0;
 	};
 
+	// Section geometry is cached until the shown sets or the width change.
+	const std::vector<SectionInfo> &sectionsLayout() const;
+	void invalidateSectionsLayout();
 	template <typename Callback>
 	bool enumerateSections(Callback callback) const;
 	SectionInfo sectionInfo(int section) const;
@@ -207,7 +211,8 @@ private:
 	void paintFeaturedStickers(Painter &p, QRect clip);
 	void paintStickers(Painter &p, QRect clip);
 	void paintMegagroupEmptySet(Painter &p, int y, bool buttonSelected, TimeMs ms);
-	void paintSticker(Painter &p, Set &set, int y, int index, bool selected, bool deleteSelected);
+	QSize stickerPreviewCell() const;
+	void paintSticker(Painter &p, Set &set, int y, int index, bool selected, bool deleteSelected, bool fromAtlas);
 	void paintEmptySearchResults(Painter &p);
 
 	int stickersRight() const;
@@ -257,6 +262,8 @@ private:
 	base::flat_set<not_null<DocumentData*>> _favedStickersMap;
 
 	Section _section = Section::Stickers;
+	mutable std::vector<SectionInfo> _sectionsLayout;
+	mutable bool _sectionsLayoutValid = false;
 
 	uint64 _displayingSetId = 0;
 	uint64 _removingSetId = 0;
@@ -290,6 +297,8 @@ private:
 	QString _searchQuery, _searchNextQuery;
 	mtpRequestId _searchRequestId = 0;
 
+	StickersAtlas _atlas;
+
 };
 
 } // namespace ChatHelpers
@@ -149,6 +149,43 @@ uint32 countCrc32(const void *data, std::size_t size) {
 	return (result ^ 0xFFFFFFFFU);
 }
 
+using FirstCharRanges = std::vector<std::pair<ushort, ushort>>;
+
+// Sorted ranges of characters that start at least one dictionary key.
+FirstCharRanges CollectFirstCharRanges(
+		const std::map<QString, int, std::greater<QString>> &dictionary) {
+	auto chars = std::set<ushort>();
+	for (const auto &item : dictionary) {
+		chars.emplace(item.first[0].unicode());
+	}
+	auto result = FirstCharRanges();
+	for (const auto ch : chars) {
+		if (!result.empty() && result.back().second + 1 == ch) {
+			result.back().second = ch;
+		} else {
+			result.emplace_back(ch, ch);
+		}
+	}
+	return result;
+}
+
+// Bit (ch - from) is set if ch is in [from, from + 64) and starts a key.
+quint64 FirstCharsMask(const FirstCharRanges &ranges, ushort from) {
+	auto result = quint64(0);
+	for (const auto &[first, last] : ranges) {
+		for (auto ch = int(first); ch <= int(last); ++ch) {
+			if (ch >= from && ch < from + 64) {
+				result |= (quint64(1) << (ch - from));
+			}
+		}
+	}
+	return result;
+}
+
+QString MaskString(quint64 mask) {
+	return "0x" + QString::number(mask, 16).toUpper() + "ULL";
+}
+
 } // namespace
 
 Generator::Generator(const Options &options) : project_(Project)
@@ -363,7 +400,10 @@ EmojiPtr Find(const QChar *start, const QChar *end, int *outLength) {\n\
 	auto index = FindIndex(start, end, outLength);\n\
 	return index ? &Items[index - 1] : nullptr;\n\
 }\n\
-\n\
+\n";
+	writeFirstCharsCheck(QString(), data_.map);
+	writeFirstCharsCheck("Replace", data_.replaces);
+	source_->stream() << "\
 void Init() {\n\
 	auto id = IdData;\n\
 	auto takeString = [&id](int size) {\n\
@@ -405,7 +445,9 @@ int FullCount();\n\
 EmojiPtr ByIndex(int index);\n\
 \n\
 EmojiPtr Find(const QChar *ch, const QChar *end, int *outLength = nullptr);\n\
-\n\
+\n";
+	writeFirstCharsFilter(header.get(), QString(), data_.map);
+	header->stream() << "\
 inline bool IsReplaceEdge(const QChar *ch) {\n\
 	return true;\n\
 \n\
@@ -423,6 +465,7 @@ inline bool IsReplaceEdge(const QChar *ch) {\n\
 const std::vector<std::pair<QString, int>> GetReplacementPairs();\n\
 EmojiPtr FindReplace(const QChar *ch, const QChar *end, int *outLength = nullptr);\n\
 \n";
+	writeFirstCharsFilter(header.get(), "Replace", data_.replaces);
 	header->popNamespace().stream() << "\
 \n\
 constexpr auto kPostfix = static_cast<ushort>(0xFE0F);\n\
@@ -651,6 +694,70 @@ int FindIndex(const QChar *start, const QChar *end, int *outLength) {\n\
 	return true;
 }
 
+void Generator::writeFirstCharsFilter(
+		common::CppFile *header,
+		const QString &name,
+		const std::map<QString, int, std::greater<QString>> &dictionary) {
+	// Most of the text is ASCII, check it by two bit masks without a call.
+	const auto ranges = CollectFirstCharRanges(dictionary);
+	header->stream() << "\
+bool MayStart" << name << "NonAscii(ushort code);\n\
+\n\
+inline bool MayStart" << name << "(QChar ch) {\n\
+	const auto code = ch.unicode();\n\
+	if (code >= 0x80) {\n\
+		return MayStart" << name << "NonAscii(code);\n\
+	}\n\
+	const auto mask = (code < 0x40)\n\
+		? " << MaskString(FirstCharsMask(ranges, 0)) << "\n\
+		: " << MaskString(FirstCharsMask(ranges, 0x40)) << ";\n\
+	return ((mask >> (code & 0x3F)) & 1) != 0;\n\
+}\n\
+\n";
+}
+
+void Generator::writeFirstCharsCheck(
+		const QString &name,
+		const std::map<QString, int, std::greater<QString>> &dictionary) {
+	const auto ranges = CollectFirstCharRanges(dictionary);
+	auto nonAscii = FirstCharRanges();
+	for (const auto &range : ranges) {
+		if (range.second >= 0x80) {
+			nonAscii.emplace_back(std::max(range.first, ushort(0x80)), range.second);
+		}
+	}
+	if (nonAscii.empty()) {
+		nonAscii.emplace_back(0xFFFF, 0);
+	}
+
+	// Sorted inclusive ranges, looked up by binary search.
+	source_->stream() << "\
+bool MayStart" << name << "NonAscii(ushort code) {\n\
+	static const ushort Ranges[] = {\n";
+	for (const auto &[first, last] : nonAscii) {
+		source_->stream() << "\
+		0x" << QString::number(first, 16) << ", 0x" << QString::number(last, 16) << ",\n";
+	}
+	source_->stream() << "\
+	};\n\
+	if (code < Ranges[0]) {\n\
+		return false;\n\
+	}\n\
+	auto from = 0;\n\
+	auto till = int(base::array_size(Ranges) / 2);\n\
+	while (till - from > 1) {\n\
+		const auto middle = (from + till) / 2;\n\
+		if (code < Ranges[middle * 2]) {\n\
+			till = middle;\n\
+		} else {\n\
+			from = middle;\n\
+		}\n\
+	}\n\
+	return (code <= Ranges[from * 2 + 1]);\n\
+}\n\
+\n";
+}
+
 bool Generator::writeFindFromDictionary(
 		const std::map<QString, int, std::greater<QString>> &dictionary,
 		bool skipPostfixes,
@@ -48,6 +48,13 @@ private:
 	bool writeGetSections();
 	bool writeFindReplace();
 	bool writeFind();
+	void writeFirstCharsFilter(
+		common::CppFile *header,
+		const QString &name,
+		const std::map<QString, int, std::greater<QString>> &dictionary);
+	void writeFirstCharsCheck(
+		const QString &name,
+		const std::map<QString, int, std::greater<QString>> &dictionary);
 	bool writeFindFromDictionary(
 		const std::map<QString, int, std::greater<QString>> &dictionary,
 		bool skipPostfixes = false,
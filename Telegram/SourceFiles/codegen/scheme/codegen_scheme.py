@@ -90,6 +90,78 @@ textSerializeInit = '';
 textSerializeMethods = '';
 forwards = '';
 forwTypedefs = '';
+functionSizes = {};
+
+# serialized sizes of the fixed size params are folded into constants,
+# so that innerLength() doesn't call into them while traversing a tree
+primitiveSizes = { 'int': 4, 'long': 8, 'double': 8, 'int128': 16, 'int256': 32 };
+fixedSizes = {};
+
+def constructorFixedSize(typedata):
+  prmsList = typedata[2];
+  prms = typedata[3];
+  conditionsList = typedata[5];
+  trivialConditions = typedata[7];
+  result = 0;
+  for paramName in prmsList:
+    if (paramName in trivialConditions):
+      continue;
+    if (paramName in conditionsList):
+      return -1;
+    paramSize = paramFixedSize(prms[paramName]);
+    if (paramSize < 0):
+      return -1;
+    result += paramSize;
+  return result;
+
+# all the constructors of a fixed size bare type have the same size
+def bareTypeFixedSize(restype):
+  if (restype in fixedSizes):
+    return fixedSizes[restype];
+  fixedSizes[restype] = -1; # recursive types are not fixed
+  result = -1;
+  for typedata in typesDict.get(restype, []):
+    size = constructorFixedSize(typedata);
+    if (size < 0 or (result >= 0 and size != result)):
+      result = -1;
+      break;
+    result = size;
+  fixedSizes[restype] = result;
+  return result;
+
+def paramFixedSize(ptype):
+  if (ptype in primitiveSizes):
+    return primitiveSizes[ptype];
+  if (ptype.startswith('flags<')):
+    return 4;
+  bare = ptype[0:1].lower() + ptype[1:];
+  if (bare in primitiveSizes):
+    return 4 + primitiveSizes[bare];
+  if (ptype in boxed and boxed[ptype] in typesDict):
+    size = bareTypeFixedSize(boxed[ptype]);
+    if (size >= 0):
+      return 4 + size;
+  return -1;
+
+def sizeExpression(prmsList, prms, conditionsList, trivialConditions, prefix):
+  result = [];
+  fixed = 0;
+  for k in prmsList:
+    if (k in trivialConditions):
+      continue;
+    paramSize = paramFixedSize(prms[k]);
+    if (k in conditionsList):
+      if (paramSize >= 0):
+        result.append('(' + prefix + 'has_' + k + '() ? ' + str(paramSize) + ' : 0)');
+      else:
+        result.append('(' + prefix + 'has_' + k + '() ? ' + prefix + 'v' + k + '.innerLength() : 0)');
+    elif (paramSize >= 0):
+      fixed += paramSize;
+    else:
+      result.append(prefix + 'v' + k + '.innerLength()');
+  if (fixed > 0 or not len(result)):
+    result.append(str(fixed));
+  return ' + '.join(result);
 
 with open(input_file) as f:
   for line in f:
@@ -374,17 +446,9 @@ for line in lines:
         methodBodies += 'uint32 MTP' + name + '<TQueryType>::innerLength() const {\n';
       else:
         methodBodies += 'uint32 MTP' + name + '::innerLength() const {\n';
-      size = [];
-      for k in prmsList:
-        v = prms[k];
-        if (k in conditionsList):
-          if (not k in trivialConditions):
-            size.append('(has_' + k + '() ? v' + k + '.innerLength() : 0)');
-        else:
-          size.append('v' + k + '.innerLength()');
-      if (not len(size)):
-        size.append('0');
-      methodBodies += '\treturn ' + ' + '.join(size) + ';\n';
+      # sizes are resolved when all the types are known
+      functionSizes[name] = [prmsList, prms, conditionsList, trivialConditions];
+      methodBodies += '\treturn @@size_' + name + '@@;\n';
       methodBodies += '}\n';
 
       funcsText += '\tmtpTypeId type() const {\n\t\treturn mtpc_' + name + ';\n\t}\n'; # type id
@@ -451,6 +515,12 @@ for line in lines:
 
       consts = consts + 1;
 
+def functionSize(match):
+  data = functionSizes[match.group(1)];
+  return sizeExpression(data[0], data[1], data[2], data[3], '');
+methods = re.sub(r'@@size_([a-zA-Z0-9_]+)@@', functionSize, methods);
+inlineMethods = re.sub(r'@@size_([a-zA-Z0-9_]+)@@', functionSize, inlineMethods);
+
 # text serialization: types and funcs
 def addTextSerialize(lst, dct, dataLetter):
   result = '';
@@ -586,8 +656,8 @@ for restype in typesList:
   getters = '';
   visitor = '';
   reader = '';
+  skipper = '';
   writer = '';
-  sizeList = [];
   sizeFast = '';
   newFast = '';
   sizeCases = '';
@@ -610,10 +680,10 @@ for restype in typesList:
     dataText += 'public:\n';
     dataText += '\ttemplate <typename Other>\n';
     dataText += '\tstatic constexpr bool Is() { return std::is_same_v<std::decay_t<Other>, MTPD' + name + '>; };\n\n';
-    sizeList = [];
     creatorParams = [];
     creatorParamsList = [];
     readText = '';
+    skipText = '';
     writeText = '';
 
     if (hasFlags != ''):
@@ -678,15 +748,19 @@ for restype in typesList:
         prmsInit.append('v' + paramName + '(_' + paramName + ')');
         if (withType):
           readText += '\t';
+          skipText += '\t';
           writeText += '\t';
         if (paramName in conditions):
           readText += '\tif (v->has_' + paramName + '()) { v->v' + paramName + '.read(from, end); } else { v->v' + paramName + ' = MTP' + paramType + '(); }\n';
+          skipText += '\tif (flags.v & MTPD' + name + '::Flag::f_' + paramName + ') MTP' + paramType + '::skip(from, end);\n';
           writeText += '\tif (v.has_' + paramName + '()) v.v' + paramName + '.write(to);\n';
-          sizeList.append('(v.has_' + paramName + '() ? v.v' + paramName + '.innerLength() : 0)');
         else:
           readText += '\tv->v' + paramName + '.read(from, end);\n';
+          if (paramName == hasFlags):
+            skipText += '\tauto flags = MTP' + paramType + '(); flags.read(from, end);\n';
+          else:
+            skipText += '\tMTP' + paramType + '::skip(from, end);\n';
           writeText += '\tv.v' + paramName + '.write(to);\n';
-          sizeList.append('v.v' + paramName + '.innerLength()');
 
       dataText += ', '.join(prmsStr) + ');\n';
 
@@ -698,11 +772,16 @@ for restype in typesList:
           continue;
         paramType = prms[paramName];
         dataText += '\tMTP' + paramType + ' v' + paramName + ';\n';
-      sizeCases += '\tcase mtpc_' + name + ': {\n';
-      sizeCases += '\t\tconst MTPD' + name + ' &v(c_' + name + '());\n';
-      sizeCases += '\t\treturn ' + ' + '.join(sizeList) + ';\n';
-      sizeCases += '\t}\n';
-      sizeFast = '\tconst MTPD' + name + ' &v(c_' + name + '());\n\treturn ' + ' + '.join(sizeList) + ';\n';
+      size = sizeExpression(prmsList, prms, conditionsList, trivialConditions, 'v.');
+      if (size.find('v.') >= 0):
+        sizeCases += '\tcase mtpc_' + name + ': {\n';
+        sizeCases += '\t\tconst MTPD' + name + ' &v(c_' + name + '());\n';
+        sizeCases += '\t\treturn ' + size + ';\n';
+        sizeCases += '\t}\n';
+        sizeFast = '\tconst MTPD' + name + ' &v(c_' + name + '());\n\treturn ' + size + ';\n';
+      else:
+        sizeCases += '\tcase mtpc_' + name + ': return ' + size + ';\n';
+        sizeFast = '\treturn ' + size + ';\n';
       newFast = 'new MTPD' + name + '()';
     else:
       constructsBodies += 'const MTPD' + name + ' &MTP' + restype + '::c_' + name + '() const {\n';
@@ -744,17 +823,23 @@ for restype in typesList:
         reader += readText;
         reader += '\t} break;\n';
 
+        skipper += '\tcase mtpc_' + name + ': {\n'; # skip switch line
+        skipper += skipText;
+        skipper += '\t} break;\n';
+
         writer += '\tcase mtpc_' + name + ': {\n'; # write switch line
         writer += '\t\tauto &v = c_' + name + '();\n';
         writer += writeText;
         writer += '\t} break;\n';
       else:
         reader += 'break;\n';
+        skipper += '\tcase mtpc_' + name + ': break;\n';
     else:
       if (len(prms) > len(trivialConditions)):
         reader += '\n\tauto v = new MTPD' + name + '();\n';
         reader += '\tsetData(v);\n';
         reader += readText;
+        skipper += skipText;
 
         writer += '\tconst auto &v = c_' + name + '();\n';
         writer += writeText;
@@ -788,16 +873,20 @@ for restype in typesList:
     visitorMethods += '\treturn base::match_method(c_' + v[0][0] + '(), std::forward<Method>(method), std::forward<Methods>(methods)...);\n';
   visitorMethods += '}\n\n';
 
-  typesText += '\n\tuint32 innerLength() const;\n'; # size method
-  methods += '\nuint32 MTP' + restype + '::innerLength() const {\n';
-  if (withType and sizeCases):
-    methods += '\tswitch (_type) {\n';
-    methods += sizeCases;
-    methods += '\t}\n';
-    methods += '\treturn 0;\n';
+  fixedSize = bareTypeFixedSize(restype);
+  if (fixedSize >= 0): # size method
+    typesText += '\n\tuint32 innerLength() const {\n\t\treturn ' + str(fixedSize) + ';\n\t}\n';
   else:
-    methods += sizeFast;
-  methods += '}\n';
+    typesText += '\n\tuint32 innerLength() const;\n';
+    methods += '\nuint32 MTP' + restype + '::innerLength() const {\n';
+    if (withType and sizeCases):
+      methods += '\tswitch (_type) {\n';
+      methods += sizeCases;
+      methods += '\t}\n';
+      methods += '\treturn 0;\n';
+    else:
+      methods += sizeFast;
+    methods += '}\n';
 
   typesText += '\tmtpTypeId type() const;\n'; # type id method
   methods += 'mtpTypeId MTP' + restype + '::type() const {\n';
@@ -825,6 +914,21 @@ for restype in typesList:
     methods += reader;
   methods += '}\n';
 
+  typesText += '\tstatic void skip(const mtpPrime *&from, const mtpPrime *end, mtpTypeId cons'; # skip method
+  if (not withType):
+    typesText += ' = mtpc_' + name;
+  typesText += ');\n';
+  methods += 'void MTP' + restype + '::skip(const mtpPrime *&from, const mtpPrime *end, mtpTypeId cons) {\n';
+  if (withType):
+    methods += '\tswitch (cons) {\n'
+    methods += skipper;
+    methods += '\tdefault: throw mtpErrorUnexpected(cons, "MTP' + restype + '");\n';
+    methods += '\t}\n';
+  else:
+    methods += '\tif (cons != mtpc_' + v[0][0] + ') throw mtpErrorUnexpected(cons, "MTP' + restype + '");\n';
+    methods += skipper;
+  methods += '}\n';
+
   typesText += '\tvoid write(mtpBuffer &to) const;\n'; # write method
   methods += 'void MTP' + restype + '::write(mtpBuffer &to) const {\n';
   if (withType and writer != ''):
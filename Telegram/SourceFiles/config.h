@@ -45,8 +45,7 @@ enum {
 	LocalEncryptSaltSize = 32, // 256 bit
 
 	AnimationTimerDelta = 7,
-	ClipThreadsCount = 8,
-	AverageGifSize = 320 * 240,
+	ClipThreadsCount = 8, // at most that many threads decode clip frames
 	WaitBeforeGifPause = 200, // wait 200ms for gif draw before pausing it
 	RecentInlineBotsLimit = 10,
 
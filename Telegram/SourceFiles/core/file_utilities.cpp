@@ -51,14 +51,6 @@ QString filedialogDefaultName(
 		const QString &path,
 		bool skipExistance,
 		TimeId fileTime) {
-	auto directoryPath = path;
-	if (directoryPath.isEmpty()) {
-		if (cDialogLastPath().isEmpty()) {
-			Platform::FileDialog::InitLastPath();
-		}
-		directoryPath = cDialogLastPath();
-	}
-
 	QString base;
 	if (fileTime) {
 		const auto date = ParseDateTime(fileTime);
@@ -76,6 +68,13 @@ QString filedialogDefaultName(
 	if (skipExistance) {
 		name = base + extension;
 	} else {
+		auto directoryPath = path;
+		if (directoryPath.isEmpty()) {
+			if (cDialogLastPath().isEmpty()) {
+				Platform::FileDialog::InitLastPath();
+			}
+			directoryPath = cDialogLastPath();
+		}
 		QDir directory(directoryPath);
 		const auto dir = directory.absolutePath();
 		const auto nameBase = (dir.endsWith('/') ? dir : (dir + '/'))
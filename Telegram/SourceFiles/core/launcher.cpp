@@ -12,6 +12,8 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 #include "core/crash_reports.h"
 #include "core/main_queue_processor.h"
 #include "core/update_checker.h"
+#include "core/scroll_benchmark.h"
+#include "core/startup_trace.h"
 #include "base/concurrent_timer.h"
 #include "application.h"
 
@@ -55,11 +57,16 @@ int Launcher::exec() {
 		return psCleanup();
 	}
 
-	// both are finished in Application::closeApplication
-	Logs::start(this); // must be started before Platform is started
-	Platform::start(); // must be started before QApplication is created
+	{
+		const auto trace = StartupTrace::Scope("Logs and Platform start");
+
+		// both are finished in Application::closeApplication
+		Logs::start(this); // must be started before Platform is started
+		Platform::start(); // must be started before QApplication is created
+	}
 
 	auto result = executeApplication();
+	StartupTrace::Finish();
 
 	DEBUG_LOG(("Telegram finished, result: %1").arg(result));
 
@@ -188,8 +195,12 @@ void Launcher::processArguments() {
 		{ "-externalupdater", KeyFormat::NoValues },
 		{ "-tosettings"     , KeyFormat::NoValues },
 		{ "-startintray"    , KeyFormat::NoValues },
+		{ "-hwdecode"       , KeyFormat::NoValues },
+		{ "-tracestartup"   , KeyFormat::NoValues },
+		{ "-benchscroll"    , KeyFormat::NoValues },
 		{ "-sendpath"       , KeyFormat::AllLeftValues },
 		{ "-workdir"        , KeyFormat::OneValue },
+		{ "-sharedcache"    , KeyFormat::OneValue },
 		{ "--"              , KeyFormat::OneValue },
 	};
 	auto parseResult = QMap<QByteArray, QStringList>();
@@ -230,6 +241,13 @@ void Launcher::processArguments() {
 	gNoStartUpdate = parseResult.contains("-noupdate");
 	gStartToSettings = parseResult.contains("-tosettings");
 	gStartInTray = parseResult.contains("-startintray");
+	gHardwareVideoDecoding = parseResult.contains("-hwdecode");
+	if (parseResult.contains("-tracestartup")) {
+		StartupTrace::Start();
+	}
+	if (parseResult.contains("-benchscroll")) {
+		ScrollBenchmark::Enable();
+	}
 	gSendPaths = parseResult.value("-sendpath", {});
 	gWorkingDir = parseResult.value("-workdir", {}).join(QString());
 	if (!gWorkingDir.isEmpty()) {
@@ -239,6 +257,7 @@ void Launcher::processArguments() {
 			gWorkingDir = QString();
 		}
 	}
+	gSharedCacheDir = parseResult.value("-sharedcache", {}).join(QString());
 	gStartUrl = parseResult.value("--", {}).join(QString());
 }
 
@@ -24,11 +24,15 @@ public:
 	void increment(int64 amount);
 	void decrement(int64 amount);
 
+	int64 usage() const {
+		return _usage;
+	}
+
 private:
 	template <typename Unload>
 	void check(Unload &&unload);
 
-	base::last_used_cache<Type*> _cache;
+	base::last_used_cache<Type> _cache;
 	SingleQueuedInvokation _delayed;
 	int64 _usage = 0;
 	int64 _limit = 0;
@@ -0,0 +1,78 @@
+/*
+This file is part of Telegram Desktop,
+the official desktop application for the Telegram messaging service.
+
+For license and copyright information please follow this link:
+https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
+*/
+#include "core/memory_stats.h"
+
+#include "auth_session.h"
+#include "data/data_session.h"
+#include "media/media_clip_reader.h"
+#include "messenger.h"
+#include "mtproto/mtp_instance.h"
+#include "ui/image/image.h"
+#include "layout.h"
+
+namespace Core {
+namespace {
+
+constexpr auto kLogInterval = TimeMs(10 * 60 * 1000);
+
+} // namespace
+
+MemoryStats::MemoryStats(not_null<AuthSession*> session)
+: _session(session)
+, _logTimer([=] { log(); }) {
+	using Stats = Storage::Cache::Database::Stats;
+	_session->data().cache().statsOnMain(
+	) | rpl::start_with_next([=](const Stats &stats) {
+		_cache = stats;
+	}, _lifetime);
+	_logTimer.callEach(kLogInterval);
+}
+
+QString MemoryStats::text() const {
+	const auto data = _session->data().memoryUsage();
+	const auto images = Images::CollectMemoryUsage();
+	const auto clips = Media::Clip::CollectMemoryUsage();
+	const auto mtp = Messenger::Instance().mtp();
+	const auto queues = mtp ? mtp->queuesUsage() : MTP::QueuesUsage();
+
+	auto lines = QStringList();
+	lines.push_back(QString("Session: %1 items, %2 views, %3 photos, "
+		"%4 documents, %5 webpages, %6 sticker sets."
+		).arg(data.items
+		).arg(data.views
+		).arg(data.photos
+		).arg(data.documents
+		).arg(data.webpages
+		).arg(data.stickerSets));
+	lines.push_back(QString("Images: %1 images with %2 unpacked, "
+		"%3 pixmaps with %4."
+		).arg(images.images
+		).arg(formatSizeText(images.imagesBytes)
+		).arg(images.pixmaps
+		).arg(formatSizeText(images.pixmapsBytes)));
+	lines.push_back(QString("Clips: %1 readers with %2 in frames."
+		).arg(clips.readers
+		).arg(formatSizeText(clips.framesBytes)));
+	lines.push_back(QString("Cache: %1 entries with %2 on disk, "
+		"%3 hits, %4 misses."
+		).arg(_cache.full.count
+		).arg(formatSizeText(_cache.full.totalSize)
+		).arg(_cache.metrics.hits
+		).arg(_cache.metrics.misses));
+	lines.push_back(QString("MTP: %1 requests, %2 received with %3."
+		).arg(queues.requests
+		).arg(queues.received
+		).arg(formatSizeText(queues.bytes)));
+	return lines.join('\n');
+}
+
+void MemoryStats::log() {
+	LOG(("Memory Stats:\n%1").arg(text()));
+}
+
+} // namespace Core
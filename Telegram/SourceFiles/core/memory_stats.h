@@ -0,0 +1,35 @@
+/*
+This file is part of Telegram Desktop,
+the official desktop application for the Telegram messaging service.
+
+For license and copyright information please follow this link:
+https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
+*/
+#pragma once
+
+#include "base/timer.h"
+#include "storage/cache/storage_cache_database.h"
+
+class AuthSession;
+
+namespace Core {
+
+// Collects the object counts and the memory held by the main subsystems,
+// so that it is possible to tell where the memory goes from the log.
+class MemoryStats final {
+public:
+	explicit MemoryStats(not_null<AuthSession*> session);
+
+	QString text() const;
+
+private:
+	void log();
+
+	const not_null<AuthSession*> _session;
+	Storage::Cache::Database::Stats _cache;
+	base::Timer _logTimer;
+	rpl::lifetime _lifetime;
+
+};
+
+} // namespace Core
@@ -0,0 +1,269 @@
+/*
+This file is part of Telegram Desktop,
+the official desktop application for the Telegram messaging service.
+
+For license and copyright information please follow this link:
+https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
+*/
+#include "core/paint_profiler.h"
+
+#include "history/history_inner_widget.h"
+#include "dialogs/dialogs_inner_widget.h"
+#include "chat_helpers/stickers_list_widget.h"
+#include "ui/rp_widget.h"
+#include "base/timer.h"
+#include "mediaview.h"
+#include "mainwindow.h"
+#include <chrono>
+#include <typeindex>
+
+#if defined Q_CC_GNU || defined Q_CC_CLANG
+#include <cxxabi.h>
+#endif // Q_CC_GNU || Q_CC_CLANG
+
+namespace Core {
+namespace PaintProfiler {
+namespace {
+
+constexpr auto kReportInterval = TimeMs(1000);
+constexpr auto kMaxClassesShown = 12;
+
+struct Entry {
+	int64 time = 0; // Exclusive, in microseconds.
+	int count = 0;
+};
+
+struct Running {
+	int64 started = 0;
+	int64 children = 0;
+};
+
+class Overlay : public Ui::RpWidget {
+public:
+	Overlay(QWidget *parent);
+
+	void setLines(QStringList &&lines);
+
+protected:
+	void paintEvent(QPaintEvent *e) override;
+
+private:
+	QStringList _lines;
+
+};
+
+bool Enabled = false;
+QPointer<Overlay> Shown;
+std::unique_ptr<base::Timer> ReportTimer;
+std::map<std::type_index, QString> ClassNames;
+std::map<QString, Entry> Classes;
+std::map<QString, Entry> Sections;
+std::vector<Running> Stack;
+Entry Frames;
+int64 MaxFrame = 0;
+
+int64 Now() {
+	using namespace std::chrono;
+	const auto now = steady_clock::now().time_since_epoch();
+	return duration_cast<microseconds>(now).count();
+}
+
+QString Demangle(const char *name) {
+#if defined Q_CC_GNU || defined Q_CC_CLANG
+	auto status = 0;
+	const auto demangled = abi::__cxa_demangle(
+		name,
+		nullptr,
+		nullptr,
+		&status);
+	if (demangled) {
+		auto result = QString::fromLatin1(demangled);
+		free(demangled);
+		if (!status) {
+			return result;
+		}
+	}
+#endif // Q_CC_GNU || Q_CC_CLANG
+	return QString::fromLatin1(name).remove(qsl("class "));
+}
+
+const QString &ClassName(not_null<QWidget*> widget) {
+	const auto type = std::type_index(typeid(*widget));
+	const auto i = ClassNames.find(type);
+	if (i != end(ClassNames)) {
+		return i->second;
+	}
+	return ClassNames.emplace(type, Demangle(type.name())).first->second;
+}
+
+QString SectionName(not_null<QWidget*> widget) {
+	for (auto parent = widget.get(); parent; parent = parent->parentWidget()) {
+		if (dynamic_cast<HistoryInner*>(parent)) {
+			return qsl("HistoryInner");
+		} else if (dynamic_cast<DialogsInner*>(parent)) {
+			return qsl("DialogsInner");
+		} else if (dynamic_cast<ChatHelpers::StickersListWidget*>(parent)) {
+			return qsl("StickersListWidget");
+		} else if (dynamic_cast<MediaView*>(parent)) {
+			return qsl("MediaView");
+		}
+	}
+	return qsl("Other");
+}
+
+QString Milliseconds(int64 microseconds) {
+	return QString::number(microseconds / 1000., 'f', 2);
+}
+
+void AppendRanked(
+		QStringList &lines,
+		const std::map<QString, Entry> &entries,
+		int limit) {
+	auto ranked = std::vector<std::pair<QString, Entry>>(
+		begin(entries),
+		end(entries));
+	ranges::sort(ranked, std::greater<>(), [](const auto &pair) {
+		return pair.second.time;
+	});
+	if (int(ranked.size()) > limit) {
+		ranked.resize(limit);
+	}
+	for (const auto &[name, entry] : ranked) {
+		lines.push_back(qsl("%1 ms %2 x%3"
+			).arg(Milliseconds(entry.time), 8
+			).arg(name
+			).arg(entry.count));
+	}
+}
+
+void Report() {
+	if (!Shown) {
+		if (const auto window = App::wnd()) {
+			Shown = new Overlay(window);
+		} else {
+			return;
+		}
+	}
+	auto lines = QStringList();
+	const auto average = Frames.count ? (Frames.time / Frames.count) : 0;
+	lines.push_back(qsl("Frames: %1, average %2 ms, max %3 ms"
+		).arg(Frames.count
+		).arg(Milliseconds(average)
+		).arg(Milliseconds(MaxFrame)));
+	lines.push_back(QString());
+	lines.push_back(qsl("Sections:"));
+	AppendRanked(lines, Sections, int(Sections.size()));
+	lines.push_back(QString());
+	lines.push_back(qsl("Classes:"));
+	AppendRanked(lines, Classes, kMaxClassesShown);
+	Shown->setLines(std::move(lines));
+
+	Classes.clear();
+	Sections.clear();
+	Frames = Entry();
+	MaxFrame = 0;
+}
+
+Overlay::Overlay(QWidget *parent) : RpWidget(parent) {
+	setAttribute(Qt::WA_TransparentForMouseEvents);
+}
+
+void Overlay::setLines(QStringList &&lines) {
+	_lines = std::move(lines);
+
+	const auto &font = App::monofont();
+	auto width = 0;
+	for (const auto &line : _lines) {
+		accumulate_max(width, font->width(line));
+	}
+	const auto padding = font->height;
+	resize(
+		width + 2 * padding,
+		_lines.size() * font->height + 2 * padding);
+	raise();
+	show();
+	update();
+}
+
+void Overlay::paintEvent(QPaintEvent *e) {
+	Painter p(this);
+	p.fillRect(rect(), QColor(0, 0, 0, 192));
+
+	const auto &font = App::monofont();
+	const auto padding = font->height;
+	p.setFont(font);
+	p.setPen(QColor(255, 255, 255));
+	auto top = padding;
+	for (const auto &line : _lines) {
+		p.drawTextLeft(padding, top, width(), line);
+		top += font->height;
+	}
+}
+
+} // namespace
+
+void Toggle() {
+	Enabled = !Enabled;
+	Stack.clear();
+	Classes.clear();
+	Sections.clear();
+	Frames = Entry();
+	MaxFrame = 0;
+	if (Enabled) {
+		ReportTimer = std::make_unique<base::Timer>(Report);
+		ReportTimer->callEach(kReportInterval);
+	} else {
+		ReportTimer = nullptr;
+		delete Shown.data();
+	}
+}
+
+EventScope::EventScope(QObject *receiver, QEvent *event) {
+	if (!Enabled || !receiver->isWidgetType()) {
+		return;
+	}
+	const auto type = event->type();
+	if (type != QEvent::Paint && type != QEvent::UpdateRequest) {
+		return;
+	}
+	const auto widget = static_cast<QWidget*>(receiver);
+	if (Shown && (widget == Shown.data() || Shown->isAncestorOf(widget))) {
+		return;
+	}
+	_active = true;
+	_frame = (type == QEvent::UpdateRequest);
+	if (!_frame) {
+		// The widget may be destroyed while handling the event.
+		_className = ClassName(widget);
+		_sectionName = SectionName(widget);
+	}
+	Stack.push_back({ Now() });
+}
+
+EventScope::~EventScope() {
+	if (!_active || !Enabled || Stack.empty()) {
+		return;
+	}
+	const auto running = Stack.back();
+	Stack.pop_back();
+	const auto total = Now() - running.started;
+	if (!Stack.empty()) {
+		Stack.back().children += total;
+	}
+	if (_frame) {
+		Frames.time += total;
+		++Frames.count;
+		accumulate_max(MaxFrame, total);
+		return;
+	}
+	const auto exclusive = total - running.children;
+	const auto add = [&](Entry &entry) {
+		entry.time += exclusive;
+		++entry.count;
+	};
+	add(Classes[_className]);
+	add(Sections[_sectionName]);
+}
+
+} // namespace PaintProfiler
+} // namespace Core
@@ -0,0 +1,36 @@
+/*
+This file is part of Telegram Desktop,
+the official desktop application for the Telegram messaging service.
+
+For license and copyright information please follow this link:
+https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
+*/
+#pragma once
+
+namespace Core {
+namespace PaintProfiler {
+
+// Toggled by a debug shortcut. While enabled the paint events time is
+// accumulated per widget class and per section and is shown each second
+// in an overlay on top of the main window. Main thread only.
+void Toggle();
+
+// Measures the delivery of the paint and window update events,
+// so that the time of each frame and of each paint in it is known.
+class EventScope {
+public:
+	EventScope(QObject *receiver, QEvent *event);
+	EventScope(const EventScope &other) = delete;
+	EventScope &operator=(const EventScope &other) = delete;
+	~EventScope();
+
+private:
+	QString _className;
+	QString _sectionName;
+	bool _active = false;
+	bool _frame = false;
+
+};
+
+} // namespace PaintProfiler
+} // namespace Core
@@ -0,0 +1,218 @@
+/*
+This file is part of Telegram Desktop,
+the official desktop application for the Telegram messaging service.
+
+For license and copyright information please follow this link:
+https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
+*/
+#include "core/scroll_benchmark.h"
+
+#include "core/memory_stats.h"
+#include "ui/widgets/scroll_area.h"
+#include "base/timer.h"
+#include "auth_session.h"
+#include <chrono>
+
+namespace Core {
+namespace ScrollBenchmark {
+namespace {
+
+constexpr auto kFrameDuration = TimeMs(16);
+constexpr auto kPhasesCount = 2;
+constexpr auto kKindsCount = 3;
+
+struct Step {
+	int delta = 0; // Pixels scrolled each frame.
+	int frames = 0;
+};
+
+constexpr Step kScript[] = {
+	{ 20, 120 }, // Slow wheel scrolling.
+	{ -60, 60 },
+	{ 200, 30 }, // Fast flicks.
+	{ -200, 30 },
+	{ 600, 10 }, // Page jumps.
+	{ -600, 10 },
+	{ 40, 60 },
+};
+
+struct Replaying {
+	QPointer<Ui::ScrollArea> scroll;
+	Phase phase = Phase::Dialogs;
+	Fn<void()> done;
+	int step = 0;
+	int frame = 0;
+	base::Timer timer;
+};
+
+bool Enabled = false;
+bool Started = false;
+std::unique_ptr<Replaying> Current;
+std::array<std::vector<int64>, kPhasesCount * kKindsCount> Samples;
+
+int64 Now() {
+	using namespace std::chrono;
+	const auto now = steady_clock::now().time_since_epoch();
+	return duration_cast<microseconds>(now).count();
+}
+
+int Index(Phase phase, Kind kind) {
+	return int(phase) * kKindsCount + int(kind);
+}
+
+QString PhaseName(Phase phase) {
+	switch (phase) {
+	case Phase::Dialogs: return qsl("dialogs");
+	case Phase::History: return qsl("history");
+	}
+	Unexpected("Phase in ScrollBenchmark::PhaseName.");
+}
+
+QString KindName(Kind kind) {
+	switch (kind) {
+	case Kind::Paint: return qsl("paint");
+	case Kind::Layout: return qsl("layout");
+	case Kind::Scroll: return qsl("scroll");
+	}
+	Unexpected("Kind in ScrollBenchmark::KindName.");
+}
+
+QString Milliseconds(int64 microseconds) {
+	return QString::number(microseconds / 1000., 'f', 2);
+}
+
+QString Summary(std::vector<int64> samples) {
+	if (samples.empty()) {
+		return qsl("no samples");
+	}
+	ranges::sort(samples);
+	const auto count = int(samples.size());
+	const auto percentile = [&](float64 part) {
+		return Milliseconds(samples[std::min(count - 1, int(part * count))]);
+	};
+	return qsl("%1 samples, p50 %2, p95 %3, p99 %4, max %5"
+	).arg(count
+	).arg(percentile(0.5)
+	).arg(percentile(0.95)
+	).arg(percentile(0.99)
+	).arg(Milliseconds(samples.back()));
+}
+
+void FinishReplay() {
+	Current->timer.cancel();
+
+	// Destroy the timer outside of its callback.
+	crl::on_main([] {
+		if (!Current) {
+			return;
+		}
+		auto done = std::move(Current->done);
+		Current = nullptr;
+		if (done) {
+			done();
+		}
+	});
+}
+
+void ReplayFrame() {
+	const auto scroll = Current->scroll.data();
+	if (!scroll || Current->step == int(base::array_size(kScript))) {
+		FinishReplay();
+		return;
+	}
+	const auto &step = kScript[Current->step];
+
+	// The history is shown from the bottom, so it is scrolled up first.
+	const auto sign = (Current->phase == Phase::History) ? -1 : 1;
+	{
+		const auto scope = Scope(Current->phase, Kind::Scroll);
+		scroll->scrollToY(scroll->scrollTop() + sign * step.delta);
+	}
+	if (++Current->frame == step.frames) {
+		++Current->step;
+		Current->frame = 0;
+	}
+}
+
+} // namespace
+
+void Enable() {
+	Enabled = true;
+}
+
+bool TakeStart() {
+	if (!Enabled || Started) {
+		return false;
+	}
+	Started = true;
+	return true;
+}
+
+void Replay(
+		not_null<Ui::ScrollArea*> scroll,
+		Phase phase,
+		Fn<void()> done) {
+	Expects(Current == nullptr);
+
+	if (!Enabled) {
+		if (done) {
+			done();
+		}
+		return;
+	}
+	Current = std::make_unique<Replaying>();
+	Current->scroll = scroll.get();
+	Current->phase = phase;
+	Current->done = std::move(done);
+	Current->timer.setCallback(ReplayFrame);
+	Current->timer.callEach(kFrameDuration, Qt::PreciseTimer);
+}
+
+void Finish() {
+	if (!Enabled) {
+		return;
+	}
+	Enabled = false;
+	Current = nullptr;
+
+	auto content = QString("Scroll benchmark, times in milliseconds.\n");
+	for (const auto phase : { Phase::Dialogs, Phase::History }) {
+		for (const auto kind : { Kind::Paint, Kind::Layout, Kind::Scroll }) {
+			content += PhaseName(phase)
+				+ ' '
+				+ KindName(kind)
+				+ ": "
+				+ Summary(base::take(Samples[Index(phase, kind)]))
+				+ '\n';
+		}
+	}
+	if (AuthSession::Exists()) {
+		content += "\nMemory after the replay:\n"
+			+ Auth().memoryStats().text()
+			+ '\n';
+	}
+	const auto bytes = content.toUtf8();
+
+	const auto path = cWorkingDir() + qsl("scroll_benchmark.txt");
+	QFile f(path);
+	if (f.open(QIODevice::WriteOnly) && f.write(bytes) == bytes.size()) {
+		LOG(("App Info: scroll benchmark saved to %1").arg(path));
+	} else {
+		LOG(("App Error: could not write scroll benchmark to %1").arg(path));
+	}
+}
+
+Scope::Scope(Phase phase, Kind kind) : _phase(phase), _kind(kind) {
+	if (Current && Current->phase == _phase) {
+		_started = Now();
+	}
+}
+
+Scope::~Scope() {
+	if (_started >= 0 && Current && Current->phase == _phase) {
+		Samples[Index(_phase, _kind)].push_back(Now() - _started);
+	}
+}
+
+} // namespace ScrollBenchmark
+} // namespace Core
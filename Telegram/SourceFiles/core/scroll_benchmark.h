@@ -0,0 +1,60 @@
+/*
+This file is part of Telegram Desktop,
+the official desktop application for the Telegram messaging service.
+
+For license and copyright information please follow this link:
+https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
+*/
+#pragma once
+
+namespace Ui {
+class ScrollArea;
+} // namespace Ui
+
+namespace Core {
+namespace ScrollBenchmark {
+
+// When the app is started with -benchscroll the chats list and then the
+// top chat are scrolled by a fixed script after the start. Paint, layout
+// and scroll handling times of both lists are summarized to
+// scroll_benchmark.txt in the working dir. Main thread only.
+void Enable();
+
+// Returns true only once if the benchmark mode is enabled.
+bool TakeStart();
+
+enum class Phase {
+	Dialogs,
+	History,
+};
+
+// Scrolls the area by the script at a fixed rate, calls done() after it.
+void Replay(
+	not_null<Ui::ScrollArea*> scroll,
+	Phase phase,
+	Fn<void()> done);
+void Finish();
+
+enum class Kind {
+	Paint,
+	Layout,
+	Scroll,
+};
+
+// Records the time spent in the scope while the phase is replayed.
+class Scope {
+public:
+	Scope(Phase phase, Kind kind);
+	Scope(const Scope &other) = delete;
+	Scope &operator=(const Scope &other) = delete;
+	~Scope();
+
+private:
+	const Phase _phase;
+	const Kind _kind;
+	int64 _started = -1;
+
+};
+
+} // namespace ScrollBenchmark
+} // namespace Core
@@ -0,0 +1,244 @@
+/*
+This file is part of Telegram Desktop,
+the official desktop application for the Telegram messaging service.
+
+For license and copyright information please follow this link:
+https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
+*/
+#include "core/stall_detector.h"
+
+#include <QtCore/QThread>
+#include <QtCore/QWaitCondition>
+
+#include <atomic>
+#include <map>
+
+#if !defined TDESKTOP_DISABLE_CRASH_REPORTS \
+	&& (defined Q_OS_MAC || defined Q_OS_LINUX32 || defined Q_OS_LINUX64)
+#define TDESKTOP_SAMPLE_STALL_STACKS
+#include <execinfo.h>
+#include <pthread.h>
+#include <signal.h>
+#endif // !TDESKTOP_DISABLE_CRASH_REPORTS && (Q_OS_MAC || Q_OS_LINUX)
+
+namespace Core {
+namespace {
+
+constexpr auto kPingInterval = TimeMs(500);
+constexpr auto kStallThreshold = TimeMs(2000);
+
+// If the watching thread itself didn't run for that long the system was
+// most likely sleeping, so the main thread is not blamed for that.
+constexpr auto kOversleepThreshold = 4 * kPingInterval;
+
+std::atomic<Qt::HANDLE> MainThreadId = { nullptr };
+std::atomic<uint64> Pinged = { 0 };
+std::atomic<uint64> Answered = { 0 };
+std::atomic<const char*> EventClassName = { nullptr };
+std::atomic<int> EventType = { 0 };
+
+#ifdef TDESKTOP_SAMPLE_STALL_STACKS
+
+constexpr auto kStackSignal = SIGUSR2;
+constexpr auto kMaxFrames = 64;
+constexpr auto kStackWaitTimeout = TimeMs(500);
+
+// The frames of the signal handler itself.
+constexpr auto kSkipFrames = 2;
+
+pthread_t MainThread;
+void *StackAddresses[kMaxFrames] = { nullptr };
+std::atomic<int> StackSize = { -1 };
+
+void StackSignalHandler(int signum) {
+	StackSize = backtrace(StackAddresses, kMaxFrames);
+}
+
+void InstallStackSignalHandler() {
+	// The first backtrace() call may allocate, don't do it in the handler.
+	void *warmup[1] = { nullptr };
+	backtrace(warmup, 1);
+
+	MainThread = pthread_self();
+
+	struct sigaction action = {};
+	action.sa_handler = StackSignalHandler;
+	action.sa_flags = SA_RESTART;
+	sigemptyset(&action.sa_mask);
+	sigaction(kStackSignal, &action, nullptr);
+}
+
+std::vector<void*> SampleMainStack() {
+	StackSize = -1;
+	if (pthread_kill(MainThread, kStackSignal) != 0) {
+		return {};
+	}
+	const auto till = crl::time() + kStackWaitTimeout;
+	while (StackSize < 0 && crl::time() < till) {
+		QThread::msleep(10);
+	}
+	const auto size = StackSize.load();
+	if (size <= kSkipFrames) {
+		return {};
+	}
+	return std::vector<void*>(
+		StackAddresses + kSkipFrames,
+		StackAddresses + size);
+}
+
+QString SymbolizeStack(const std::vector<void*> &stack) {
+	const auto size = int(stack.size());
+	const auto symbols = backtrace_symbols(stack.data(), size);
+	auto result = QStringList();
+	for (auto i = 0; i != size; ++i) {
+		result.push_back(symbols
+			? QString::fromLocal8Bit(symbols[i])
+			: QString::number(quintptr(stack[i]), 16));
+	}
+	free(symbols);
+	return result.join('\n');
+}
+
+#endif // TDESKTOP_SAMPLE_STALL_STACKS
+
+} // namespace
+
+class StallDetector::Thread final : public QThread {
+public:
+	void stop();
+
+protected:
+	void run() override;
+
+private:
+	struct Site {
+		int id = 0;
+		int count = 0;
+	};
+
+	void check();
+	void report(TimeMs duration);
+
+	QMutex _mutex;
+	QWaitCondition _condition;
+	bool _stopped = false;
+
+	TimeMs _lastCheck = 0;
+	TimeMs _pinged = 0;
+	bool _stalled = false;
+	std::map<std::vector<void*>, Site> _sites;
+
+};
+
+void StallDetector::Thread::stop() {
+	QMutexLocker lock(&_mutex);
+	_stopped = true;
+	_condition.wakeAll();
+}
+
+void StallDetector::Thread::run() {
+	QMutexLocker lock(&_mutex);
+	while (!_stopped) {
+		_condition.wait(&_mutex, kPingInterval);
+		if (!_stopped) {
+			check();
+		}
+	}
+}
+
+void StallDetector::Thread::check() {
+	const auto now = crl::time();
+	const auto overslept = (now - _lastCheck > kOversleepThreshold);
+	_lastCheck = now;
+
+	const auto ping = Pinged.load();
+	if (Answered == ping) {
+		if (_stalled) {
+			_stalled = false;
+			LOG(("Stall: main thread is responding again after %1 ms."
+				).arg(now - _pinged));
+		}
+		const auto next = ++Pinged;
+		_pinged = now;
+		crl::on_main([=] {
+			Answered = next;
+		});
+	} else if (overslept) {
+		_pinged = now;
+	} else if (!_stalled && (now - _pinged > kStallThreshold)) {
+		_stalled = true;
+		report(now - _pinged);
+	}
+}
+
+void StallDetector::Thread::report(TimeMs duration) {
+	const auto className = EventClassName.load();
+	const auto event = className
+		? QString("%1 for %2").arg(EventType.load()).arg(className)
+		: QString("none");
+	const auto header = QString("Stall: main thread is not responding "
+		"for %1 ms, event: %2").arg(duration).arg(event);
+
+#ifdef TDESKTOP_SAMPLE_STALL_STACKS
+	const auto stack = SampleMainStack();
+	if (stack.empty()) {
+		LOG(("%1, stack unavailable.").arg(header));
+		return;
+	}
+	auto &site = _sites[stack];
+	if (!site.id) {
+		site.id = int(_sites.size());
+	}
+	if (++site.count > 1) {
+		LOG(("%1, site #%2 (%3 times)."
+			).arg(header
+			).arg(site.id
+			).arg(site.count));
+		return;
+	}
+	LOG(("%1, site #%2, stack:\n%3"
+		).arg(header
+		).arg(site.id
+		).arg(SymbolizeStack(stack)));
+#else // TDESKTOP_SAMPLE_STALL_STACKS
+	LOG(("%1, backtrace omitted.").arg(header));
+#endif // TDESKTOP_SAMPLE_STALL_STACKS
+}
+
+StallDetector::StallDetector() : _thread(std::make_unique<Thread>()) {
+	MainThreadId = QThread::currentThreadId();
+#ifdef TDESKTOP_SAMPLE_STALL_STACKS
+	InstallStackSignalHandler();
+#endif // TDESKTOP_SAMPLE_STALL_STACKS
+	_thread->start(QThread::LowPriority);
+}
+
+StallDetector::~StallDetector() {
+	_thread->stop();
+	_thread->wait();
+	MainThreadId = nullptr;
+}
+
+StallDetector::EventScope::EventScope(QObject *receiver, QEvent *event)
+: _active(receiver
+	&& event
+	&& (QThread::currentThreadId() == MainThreadId.load(
+		std::memory_order_relaxed))) {
+	if (_active) {
+		_className = EventClassName.exchange(
+			receiver->metaObject()->className(),
+			std::memory_order_relaxed);
+		_type = EventType.exchange(
+			int(event->type()),
+			std::memory_order_relaxed);
+	}
+}
+
+StallDetector::EventScope::~EventScope() {
+	if (_active) {
+		EventClassName.store(_className, std::memory_order_relaxed);
+		EventType.store(_type, std::memory_order_relaxed);
+	}
+}
+
+} // namespace Core
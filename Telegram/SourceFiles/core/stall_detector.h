@@ -0,0 +1,44 @@
+/*
+This file is part of Telegram Desktop,
+the official desktop application for the Telegram messaging service.
+
+For license and copyright information please follow this link:
+https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
+*/
+#pragma once
+
+namespace Core {
+
+// Pings the main thread from a separate thread and each time the main
+// thread doesn't answer for too long logs the event it was processing
+// and its stack, so that the recurring stall sites can be found.
+class StallDetector final {
+public:
+	StallDetector();
+	StallDetector(const StallDetector &other) = delete;
+	StallDetector &operator=(const StallDetector &other) = delete;
+	~StallDetector();
+
+	// Remembers the event dispatched in the main thread while it lives.
+	class EventScope {
+	public:
+		EventScope(QObject *receiver, QEvent *event);
+		EventScope(const EventScope &other) = delete;
+		EventScope &operator=(const EventScope &other) = delete;
+		~EventScope();
+
+	private:
+		const char *_className = nullptr;
+		int _type = 0;
+		bool _active = false;
+
+	};
+
+private:
+	class Thread;
+
+	std::unique_ptr<Thread> _thread;
+
+};
+
+} // namespace Core
@@ -0,0 +1,106 @@
+/*
+This file is part of Telegram Desktop,
+the official desktop application for the Telegram messaging service.
+
+For license and copyright information please follow this link:
+https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
+*/
+#include "core/startup_trace.h"
+
+#include <chrono>
+
+namespace Core {
+namespace StartupTrace {
+namespace {
+
+struct Event {
+	const char *name = nullptr;
+	char phase = 0;
+	int64 started = 0;
+	int64 duration = 0;
+};
+
+bool Enabled = false;
+std::chrono::steady_clock::time_point Origin;
+std::vector<Event> Events;
+
+int64 Now() {
+	using namespace std::chrono;
+	return duration_cast<microseconds>(steady_clock::now() - Origin).count();
+}
+
+QByteArray Serialize(const Event &event) {
+	auto result = "{\"name\":\""
+		+ QByteArray(event.name)
+		+ "\",\"cat\":\"startup\",\"ph\":\""
+		+ event.phase
+		+ "\",\"ts\":"
+		+ QByteArray::number(event.started);
+	if (event.phase == 'X') {
+		result += ",\"dur\":" + QByteArray::number(event.duration);
+	} else {
+		result += ",\"s\":\"g\"";
+	}
+	return result + ",\"pid\":1,\"tid\":1}";
+}
+
+} // namespace
+
+void Start() {
+	Enabled = true;
+	Origin = std::chrono::steady_clock::now();
+	Events.clear();
+}
+
+void Finish() {
+	if (!Enabled) {
+		return;
+	}
+	Enabled = false;
+
+	auto content = QByteArray("{\"traceEvents\":[\n");
+	for (const auto &event : Events) {
+		if (&event != &Events.front()) {
+			content += ",\n";
+		}
+		content += Serialize(event);
+	}
+	content += "\n]}\n";
+	Events.clear();
+
+	const auto path = cWorkingDir() + qsl("startup_trace.json");
+	QFile f(path);
+	if (f.open(QIODevice::WriteOnly) && f.write(content) == content.size()) {
+		LOG(("App Info: startup trace saved to %1").arg(path));
+	} else {
+		LOG(("App Error: could not write startup trace to %1").arg(path));
+	}
+}
+
+void Mark(const char *name) {
+	if (!Enabled) {
+		return;
+	}
+	const auto already = ranges::find_if(Events, [&](const Event &event) {
+		return (event.phase == 'i') && !strcmp(event.name, name);
+	});
+	if (already == end(Events)) {
+		Events.push_back({ name, 'i', Now() });
+	}
+}
+
+Scope::Scope(const char *name) {
+	if (Enabled) {
+		_name = name;
+		_started = Now();
+	}
+}
+
+Scope::~Scope() {
+	if (_name && Enabled) {
+		Events.push_back({ _name, 'X', _started, Now() - _started });
+	}
+}
+
+} // namespace StartupTrace
+} // namespace Core
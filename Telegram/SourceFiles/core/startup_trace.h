@@ -0,0 +1,36 @@
+/*
+This file is part of Telegram Desktop,
+the official desktop application for the Telegram messaging service.
+
+For license and copyright information please follow this link:
+https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
+*/
+#pragma once
+
+namespace Core {
+namespace StartupTrace {
+
+// When the app is started with -tracestartup the startup steps are saved
+// to startup_trace.json in the Chrome trace format (see chrome://tracing).
+// Main thread only.
+void Start();
+void Finish();
+
+// Only the first mark with each name is recorded.
+void Mark(const char *name);
+
+class Scope {
+public:
+	explicit Scope(const char *name);
+	Scope(const Scope &other) = delete;
+	Scope &operator=(const Scope &other) = delete;
+	~Scope();
+
+private:
+	const char *_name = nullptr;
+	int64 _started = 0;
+
+};
+
+} // namespace StartupTrace
+} // namespace Core
@@ -0,0 +1,153 @@
+/*
+This file is part of Telegram Desktop,
+the official desktop application for the Telegram messaging service.
+
+For license and copyright information please follow this link:
+https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
+*/
+#include "core/traffic_replay.h"
+
+#include "mtproto/traffic_capture.h"
+#include "history/history.h"
+
+namespace Core {
+namespace {
+
+struct ReplayStats {
+	int fed = 0;
+	int skipped = 0;
+	int broken = 0;
+	int messages = 0;
+	TimeMs duration = 0;
+	TimeMs maxDuration = 0;
+};
+
+// Only the parts that can be applied again are fed: the updates sequence
+// is not checked and the messages are added as already existing ones.
+template <typename Data>
+void FeedSlice(
+		const Data &data,
+		const QVector<MTPMessage> &messages,
+		ReplayStats &stats) {
+	App::feedUsers(data.vusers);
+	App::feedChats(data.vchats);
+	App::feedMsgs(messages, NewMessageExisting);
+	stats.messages += messages.size();
+}
+
+template <typename Data>
+void FeedUpdates(const Data &data, ReplayStats &stats) {
+	auto messages = QVector<MTPMessage>();
+	for (const auto &update : data.vupdates.v) {
+		switch (update.type()) {
+		case mtpc_updateNewMessage:
+			messages.push_back(update.c_updateNewMessage().vmessage);
+			break;
+		case mtpc_updateNewChannelMessage:
+			messages.push_back(update.c_updateNewChannelMessage().vmessage);
+			break;
+		}
+	}
+	FeedSlice(data, messages, stats);
+}
+
+bool FeedPacket(const mtpBuffer &data, ReplayStats &stats) {
+	auto from = data.constData();
+	const auto end = from + data.size();
+	if (from == end) {
+		return false;
+	}
+	switch (*from) {
+	case mtpc_messages_messages:
+	case mtpc_messages_messagesSlice:
+	case mtpc_messages_channelMessages: {
+		auto result = MTPmessages_Messages();
+		result.read(from, end);
+		switch (result.type()) {
+		case mtpc_messages_messages: {
+			const auto &d = result.c_messages_messages();
+			FeedSlice(d, d.vmessages.v, stats);
+		} break;
+		case mtpc_messages_messagesSlice: {
+			const auto &d = result.c_messages_messagesSlice();
+			FeedSlice(d, d.vmessages.v, stats);
+		} break;
+		case mtpc_messages_channelMessages: {
+			const auto &d = result.c_messages_channelMessages();
+			FeedSlice(d, d.vmessages.v, stats);
+		} break;
+		}
+	} return true;
+
+	case mtpc_updates_difference:
+	case mtpc_updates_differenceSlice: {
+		auto result = MTPupdates_Difference();
+		result.read(from, end);
+		if (result.type() == mtpc_updates_difference) {
+			const auto &d = result.c_updates_difference();
+			FeedSlice(d, d.vnew_messages.v, stats);
+		} else {
+			const auto &d = result.c_updates_differenceSlice();
+			FeedSlice(d, d.vnew_messages.v, stats);
+		}
+	} return true;
+
+	case mtpc_updates:
+	case mtpc_updatesCombined: {
+		auto result = MTPUpdates();
+		result.read(from, end);
+		if (result.type() == mtpc_updates) {
+			FeedUpdates(result.c_updates(), stats);
+		} else {
+			FeedUpdates(result.c_updatesCombined(), stats);
+		}
+	} return true;
+	}
+	return false;
+}
+
+} // namespace
+
+QString ReplayTrafficCapture(const QString &path) {
+	const auto packets = MTP::ReadTrafficCapture(path);
+	if (packets.empty()) {
+		return qsl("Nothing to replay in %1.").arg(path);
+	}
+	auto stats = ReplayStats();
+	for (const auto &packet : packets) {
+		const auto started = getms(true);
+		try {
+			if (FeedPacket(packet.data, stats)) {
+				++stats.fed;
+			} else {
+				++stats.skipped;
+			}
+		} catch (Exception &) {
+			++stats.broken;
+		}
+		const auto duration = getms(true) - started;
+		stats.duration += duration;
+		accumulate_max(stats.maxDuration, duration);
+	}
+	const auto captured = packets.back().received - packets.front().received;
+	const auto perSecond = stats.duration
+		? (stats.messages * 1000LL / stats.duration)
+		: 0LL;
+	auto result = QStringList();
+	result.push_back(qsl("Replayed %1 packets captured during %2 ms."
+		).arg(packets.size()
+		).arg(captured));
+	result.push_back(qsl("Fed %1, skipped %2, broken %3, messages %4."
+		).arg(stats.fed
+		).arg(stats.skipped
+		).arg(stats.broken
+		).arg(stats.messages));
+	result.push_back(qsl("Main thread time %1 ms, max %2 ms per packet, "
+		"%3 messages per second."
+		).arg(stats.duration
+		).arg(stats.maxDuration
+		).arg(perSecond));
+	return result.join('\n');
+}
+
+} // namespace Core
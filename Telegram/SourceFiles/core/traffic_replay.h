@@ -0,0 +1,17 @@
+/*
+This file is part of Telegram Desktop,
+the official desktop application for the Telegram messaging service.
+
+For license and copyright information please follow this link:
+https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
+*/
+#pragma once
+
+namespace Core {
+
+// Feeds the users, chats and messages of a traffic capture made by
+// MTP::StartTrafficCapture() to the current session without sending
+// anything and returns the report of the main thread time it took.
+QString ReplayTrafficCapture(const QString &path);
+
+} // namespace Core
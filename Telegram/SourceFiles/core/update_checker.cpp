@@ -11,6 +11,7 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 #include "platform/platform_specific.h"
 #include "base/timer.h"
 #include "base/bytes.h"
+#include "base/openssl_help.h"
 #include "storage/localstorage.h"
 #include "messenger.h"
 #include "mtproto/session.h"
@@ -42,6 +43,11 @@ constexpr auto kMaxResponseSize = 1024 * 1024;
 constexpr auto kMaxUpdateSize = 256 * 1024 * 1024;
 constexpr auto kChunkSize = 128 * 1024;
 
+// The packed update starts with an RSA signature of the SHA1 hash
+// of everything after the signature and the hash themselves.
+constexpr auto kSignatureSize = 128;
+constexpr auto kHashedOffset = kSignatureSize + int(openssl::kSha1Size);
+
 #ifdef TDESKTOP_DISABLE_AUTOUPDATE
 bool UpdaterIsDisabled = true;
 #else // TDESKTOP_DISABLE_AUTOUPDATE
@@ -92,6 +98,9 @@ private:
 	virtual void startLoading() = 0;
 
 	bool validateOutput();
+	bool hashExistingOutput();
+	void hashChunk(bytes::const_span data);
+	bool checkHash();
 	void threadSafeProgress(Progress progress);
 	void threadSafeReady();
 
@@ -100,6 +109,8 @@ private:
 	int _chunkSize = 0;
 
 	QFile _output;
+	SHA_CTX _hashContext;
+	bytes::vector _header;
 	int _alreadySize = 0;
 	int _totalSize = 0;
 	mutable QMutex _sizesMutex;
@@ -384,13 +395,7 @@ bool UnpackUpdate(const QString &filepath) {
 		return false;
 	}
 
-	uchar sha1Buffer[20];
-	bool goodSha1 = !memcmp(compressed.constData() + hSigLen, hashSha1(compressed.constData() + hSigLen + hShaLen, compressedLen + hPropsLen + hOriginalSizeLen, sha1Buffer), hShaLen);
-	if (!goodSha1) {
-		LOG(("Update Error: bad SHA1 hash of update file!"));
-		return false;
-	}
-
+	// The SHA1 hash was already checked by the Loader while downloading.
 	RSA *pbKey = PEM_read_bio_RSAPublicKey(BIO_new_mem_buf(const_cast<char*>(AppBetaVersion ? UpdatesPublicBetaKey : UpdatesPublicKey), -1), 0, 0, 0);
 	if (!pbKey) {
 		LOG(("Update Error: cant read public rsa key!"));
@@ -471,6 +476,7 @@ bool UnpackUpdate(const QString &filepath) {
 		return false;
 	}
 #endif // Q_OS_WIN
+	compressed = QByteArray();
 
 	tempDir.mkdir(tempDir.absolutePath());
 
@@ -737,6 +743,8 @@ std::optional<MTPMessage> GetMessagesElement(
 Loader::Loader(const QString &filename, int chunkSize)
 : _filename(filename)
 , _chunkSize(chunkSize) {
+	SHA1_Init(&_hashContext);
+	_header.reserve(kHashedOffset);
 }
 
 void Loader::start() {
@@ -806,13 +814,51 @@ bool Loader::validateOutput() {
 	const auto goodSize = int((fullSize % _chunkSize)
 		? (fullSize - (fullSize % _chunkSize))
 		: fullSize);
-	if (_output.resize(goodSize)) {
+	if (_output.resize(goodSize) && hashExistingOutput()) {
 		_alreadySize = goodSize;
 		return true;
 	}
 	return false;
 }
 
+bool Loader::hashExistingOutput() {
+	QFile existing(_filepath);
+	if (!existing.open(QIODevice::ReadOnly)) {
+		return false;
+	}
+	auto buffer = QByteArray(_chunkSize, Qt::Uninitialized);
+	while (!existing.atEnd()) {
+		const auto read = existing.read(buffer.data(), buffer.size());
+		if (read <= 0) {
+			return false;
+		}
+		hashChunk(bytes::make_span(buffer).subspan(0, read));
+	}
+	return true;
+}
+
+void Loader::hashChunk(bytes::const_span data) {
+	const auto header = std::min(
+		int(data.size()),
+		kHashedOffset - int(_header.size()));
+	if (header > 0) {
+		_header.insert(_header.end(), data.begin(), data.begin() + header);
+		data = data.subspan(header);
+	}
+	if (!data.empty()) {
+		SHA1_Update(&_hashContext, data.data(), data.size());
+	}
+}
+
+bool Loader::checkHash() {
+	auto hash = bytes::vector(openssl::kSha1Size);
+	SHA1_Final(reinterpret_cast<unsigned char*>(hash.data()), &_hashContext);
+	return (int(_header.size()) == kHashedOffset)
+		&& !bytes::compare(
+			bytes::make_span(_header).subspan(kSignatureSize),
+			bytes::make_span(hash));
+}
+
 void Loader::threadSafeProgress(Progress progress) {
 	crl::on_main(this, [=] {
 		_progress.fire_copy(progress);
@@ -841,6 +887,7 @@ void Loader::writeChunk(bytes::const_span data, int totalSize) {
 			threadSafeFailed();
 			return;
 		}
+		hashChunk(data);
 	}
 
 	const auto progress = [&] {
@@ -854,6 +901,12 @@ void Loader::writeChunk(bytes::const_span data, int totalSize) {
 
 	if (progress.size > 0 && progress.already >= progress.size) {
 		_output.close();
+		if (!checkHash()) {
+			LOG(("Update Error: bad SHA1 hash of update file!"));
+			_output.remove();
+			threadSafeFailed();
+			return;
+		}
 		threadSafeReady();
 	} else {
 		threadSafeProgress(progress);
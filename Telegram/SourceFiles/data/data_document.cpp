@@ -29,6 +29,11 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 #include "mainwindow.h"
 #include "messenger.h"
 
+struct DocumentWebData {
+	QString url;
+	WebFileLocation location;
+};
+
 namespace {
 
 constexpr auto kMemoryForCache = 32 * 1024 * 1024;
@@ -40,6 +45,17 @@ Core::MediaActiveCache<DocumentData> &ActiveCache() {
 	return Instance;
 }
 
+// Mime types and sticker emoji repeat in most of the documents, so they
+// share the same string data instead of keeping a copy in each of them.
+QString InternString(const QString &value) {
+	static auto Interned = base::flat_set<QString>();
+	if (value.isEmpty()) {
+		return QString();
+	}
+	const auto i = Interned.find(value);
+	return (i != Interned.end()) ? *i : *Interned.emplace(value);
+}
+
 int64 ComputeUsage(StickerData *sticker) {
 	return (sticker != nullptr && sticker->image != nullptr)
 		? sticker->image->width() * sticker->image->height() * 4
@@ -457,7 +473,7 @@ void DocumentData::setattributes(const QVector<MTPDocumentAttribute> &attributes
 				_additional = std::make_unique<StickerData>();
 			}
 			if (sticker()) {
-				sticker()->alt = qs(d.valt);
+				sticker()->alt = InternString(qs(d.valt));
 				if (sticker()->set.type() != mtpc_inputStickerSetID || d.vstickerset.type() == mtpc_inputStickerSetID) {
 					sticker()->set = d.vstickerset;
 				}
@@ -540,6 +556,10 @@ Storage::Cache::Key DocumentData::goodThumbnailCacheKey() const {
 	return Data::DocumentThumbCacheKey(_dc, id);
 }
 
+Storage::Cache::Key DocumentData::waveformCacheKey() const {
+	return Data::DocumentWaveformCacheKey(_dc, id);
+}
+
 Image *DocumentData::goodThumbnail() const {
 	return _goodThumbnail.get();
 }
@@ -769,6 +789,14 @@ QString DocumentData::loadingFilePath() const {
 	return loading() ? _loader->fileName() : QString();
 }
 
+std::shared_ptr<Storage::StreamedFile> DocumentData::stream() {
+	if (const auto loader = dynamic_cast<mtpFileLoader*>(
+			loading() ? _loader : nullptr)) {
+		return loader->stream();
+	}
+	return nullptr;
+}
+
 bool DocumentData::displayLoading() const {
 	return loading()
 		? (!_loader->loadingLocal() || !_loader->autoLoading())
@@ -854,14 +882,14 @@ void DocumentData::save(
 		status = FileReady;
 		if (hasWebLocation()) {
 			_loader = new mtpFileLoader(
-				&_urlLocation,
+				&_web->location,
 				size,
 				fromCloud,
 				autoLoading,
 				cacheTag());
-		} else if (!_access && !_url.isEmpty()) {
+		} else if (!_access && hasContentUrl()) {
 			_loader = new webFileLoader(
-				_url,
+				_web->url,
 				toFile,
 				fromCloud,
 				autoLoading,
@@ -1089,11 +1117,56 @@ void DocumentData::checkSticker() {
 	}
 }
 
+void DocumentData::checkStickerAsync() {
+	const auto data = sticker();
+	if (!data) return;
+
+	automaticLoad(stickerSetOrigin(), nullptr);
+	if (data->image || data->decoding || !loaded()) {
+		return;
+	} else if (_data.isEmpty()) {
+		checkSticker();
+		return;
+	}
+	data->decoding = true;
+	crl::async([=, bytes = _data] {
+		auto format = QByteArray();
+		auto image = App::readImage(bytes, &format, false);
+		crl::on_main(_session, [=, image = std::move(image)]() mutable {
+			stickerDecoded(bytes, format, std::move(image));
+		});
+	});
+}
+
+void DocumentData::stickerDecoded(
+		const QByteArray &bytes,
+		const QByteArray &format,
+		QImage &&image) {
+	const auto data = sticker();
+	if (!data) return;
+
+	data->decoding = false;
+	if (data->image || _data.isEmpty()) {
+		return;
+	}
+	data->image = std::make_unique<Image>(
+		std::make_unique<Images::LocalFileSource>(
+			QString(),
+			bytes,
+			format,
+			std::move(image)));
+	if (const auto usage = ComputeUsage(data)) {
+		ActiveCache().increment(usage);
+		ActiveCache().up(this);
+	}
+	_session->downloaderTaskFinished().notify();
+}
+
 void DocumentData::checkStickerThumb() {
 	if (hasGoodStickerThumb()) {
 		thumb->load(stickerSetOrigin());
 	} else {
-		checkSticker();
+		checkStickerAsync();
 	}
 }
 
@@ -1158,11 +1231,13 @@ bool DocumentData::hasRemoteLocation() const {
 }
 
 bool DocumentData::hasWebLocation() const {
-	return _urlLocation.dc() != 0 && _urlLocation.accessHash() != 0;
+	return _web
+		&& _web->location.dc() != 0
+		&& _web->location.accessHash() != 0;
 }
 
 bool DocumentData::isValid() const {
-	return hasRemoteLocation() || hasWebLocation() || !_url.isEmpty();
+	return hasRemoteLocation() || hasWebLocation() || hasContentUrl();
 }
 
 MTPInputDocument DocumentData::mtpInput() const {
@@ -1205,7 +1280,7 @@ bool DocumentData::hasMimeType(QLatin1String mime) const {
 }
 
 void DocumentData::setMimeString(const QString &mime) {
-	_mimeString = mime;
+	_mimeString = InternString(mime);
 }
 
 MediaKey DocumentData::mediaKey() const {
@@ -1214,9 +1289,9 @@ MediaKey DocumentData::mediaKey() const {
 
 Storage::Cache::Key DocumentData::cacheKey() const {
 	if (hasWebLocation()) {
-		return Data::WebDocumentCacheKey(_urlLocation);
-	} else if (!_access && !_url.isEmpty()) {
-		return Data::UrlCacheKey(_url);
+		return Data::WebDocumentCacheKey(_web->location);
+	} else if (!_access && hasContentUrl()) {
+		return Data::UrlCacheKey(_web->url);
 	} else {
 		return Data::DocumentCacheKey(_dc, id);
 	}
@@ -1355,11 +1430,27 @@ void DocumentData::setRemoteLocation(
 }
 
 void DocumentData::setContentUrl(const QString &url) {
-	_url = url;
+	if (!_web) {
+		if (url.isEmpty()) {
+			return;
+		}
+		_web = std::make_unique<DocumentWebData>();
+	}
+	_web->url = url;
 }
 
 void DocumentData::setWebLocation(const WebFileLocation &location) {
-	_urlLocation = location;
+	if (!_web) {
+		if (location.isNull()) {
+			return;
+		}
+		_web = std::make_unique<DocumentWebData>();
+	}
+	_web->location = location;
+}
+
+bool DocumentData::hasContentUrl() const {
+	return _web && !_web->url.isEmpty();
 }
 
 void DocumentData::collectLocalData(DocumentData *local) {
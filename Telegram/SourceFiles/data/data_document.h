@@ -8,6 +8,7 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 #pragma once
 
 #include "data/data_types.h"
+#include "base/last_used_cache.h"
 
 namespace Images {
 class Source;
@@ -17,10 +18,12 @@ namespace Storage {
 namespace Cache {
 struct Key;
 } // namespace Cache
+class StreamedFile;
 } // namespace Storage
 
 class AuthSession;
 class mtpFileLoader;
+struct DocumentWebData;
 
 inline uint64 mediaMix32To64(int32 a, int32 b) {
 	return (uint64(*reinterpret_cast<uint32*>(&a)) << 32)
@@ -48,6 +51,7 @@ struct StickerData : public DocumentAdditionalData {
 	Data::FileOrigin setOrigin() const;
 
 	std::unique_ptr<Image> image;
+	bool decoding = false;
 	QString alt;
 	MTPInputStickerSet set = MTP_inputStickerSetEmpty();
 	StorageImageLocation loc; // doc thumb location
@@ -97,6 +101,9 @@ public:
 		FilePathResolveType type = FilePathResolveCached) const;
 	bool loading() const;
 	QString loadingFilePath() const;
+
+	// The file that is being loaded, the parts are loaded as it is read.
+	std::shared_ptr<Storage::StreamedFile> stream();
 	bool displayLoading() const;
 	void save(
 		Data::FileOrigin origin,
@@ -130,6 +137,10 @@ public:
 
 	StickerData *sticker() const;
 	void checkSticker();
+
+	// Decodes the sticker on a background thread, the views are repainted
+	// by downloaderTaskFinished() when the image is ready.
+	void checkStickerAsync();
 	void checkStickerThumb();
 	Image *getStickerThumb();
 	Image *getStickerImage();
@@ -162,6 +173,7 @@ public:
 
 	Image *goodThumbnail() const;
 	Storage::Cache::Key goodThumbnailCacheKey() const;
+	Storage::Cache::Key waveformCacheKey() const;
 	void setGoodThumbnail(QImage &&image, QByteArray &&bytes);
 	void refreshGoodThumbnail();
 	void replaceGoodThumbnail(std::unique_ptr<Images::Source> &&source);
@@ -201,6 +213,10 @@ public:
 		const QString &songPerformer);
 	QString composeNameString() const;
 
+	base::last_used_hook<DocumentData> &lastUsedHook() {
+		return _lastUsedHook;
+	}
+
 	~DocumentData();
 
 	DocumentId id = 0;
@@ -218,18 +234,24 @@ private:
 	friend class Serialize::Document;
 
 	LocationType locationType() const;
+	void stickerDecoded(
+		const QByteArray &bytes,
+		const QByteArray &format,
+		QImage &&image);
 	void validateGoodThumbnail();
 
 	void destroyLoaderDelayed(mtpFileLoader *newValue = nullptr) const;
 
-	// Two types of location: from MTProto by dc+access or from web by url
-	int32 _dc = 0;
+	bool hasContentUrl() const;
+
+	// Two types of location: from MTProto by dc+access or from web by url.
+	// The web ones are rare (only inline bot results), so they are created
+	// by the first setContentUrl() or setWebLocation() call.
 	uint64 _access = 0;
 	QByteArray _fileReference;
-	QString _url;
 	QString _filename;
 	QString _mimeString;
-	WebFileLocation _urlLocation;
+	std::unique_ptr<DocumentWebData> _web;
 
 	std::unique_ptr<Image> _goodThumbnail;
 	std::unique_ptr<Image> _replyPreview;
@@ -239,13 +261,17 @@ private:
 	FileLocation _location;
 	QByteArray _data;
 	std::unique_ptr<DocumentAdditionalData> _additional;
+	mutable FileLoader *_loader = nullptr;
+	FullMsgId _actionOnLoadMsgId;
+
+	// Small fields are kept together to avoid the alignment padding.
+	int32 _dc = 0;
 	int32 _duration = -1;
+	ActionOnLoad _actionOnLoad = ActionOnLoadNone;
 	bool _isImage = false;
 	bool _supportsStreaming = false;
 
-	ActionOnLoad _actionOnLoad = ActionOnLoadNone;
-	FullMsgId _actionOnLoadMsgId;
-	mutable FileLoader *_loader = nullptr;
+	base::last_used_hook<DocumentData> _lastUsedHook;
 
 };
 
@@ -12,11 +12,55 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 #include "media/media_clip_reader.h"
 #include "auth_session.h"
 
+#include <deque>
+
 namespace Data {
 namespace {
 
 constexpr auto kGoodThumbQuality = 87;
 
+// Each generation decodes a whole video, so only a few are done at once.
+constexpr auto kMaxGeneratingCount = 2;
+
+struct GenerateTask {
+	base::binary_guard guard;
+	FnMut<void(base::binary_guard &&guard)> start;
+};
+
+// Accessed only from the main thread.
+std::deque<GenerateTask> GenerateQueue;
+int GeneratingCount = 0;
+
+void GenerateNext() {
+	// The latest requests are for the items that are visible right now.
+	while (GeneratingCount < kMaxGeneratingCount
+		&& !GenerateQueue.empty()) {
+		auto task = std::move(GenerateQueue.back());
+		GenerateQueue.pop_back();
+		if (task.guard.alive()) {
+			++GeneratingCount;
+			task.start(std::move(task.guard));
+		}
+	}
+}
+
+void GenerateFinished() {
+	--GeneratingCount;
+	GenerateNext();
+}
+
+void EnqueueGenerate(
+		base::binary_guard &&guard,
+		FnMut<void(base::binary_guard &&guard)> &&start) {
+	GenerateQueue.erase(
+		ranges::remove_if(GenerateQueue, [](const GenerateTask &task) {
+			return !task.guard.alive();
+		}),
+		end(GenerateQueue));
+	GenerateQueue.push_back({ std::move(guard), std::move(start) });
+	GenerateNext();
+}
+
 } // namespace
 
 GoodThumbSource::GoodThumbSource(not_null<DocumentData*> document)
@@ -35,30 +79,35 @@ void GoodThumbSource::generate(base::binary_guard &&guard) {
 		_empty = true;
 		return;
 	}
-	crl::async([
-		=,
-		guard = std::move(guard),
-		location = std::move(location)
-	]() mutable {
-		const auto filepath = (location && location->accessEnable())
-			? location->name()
-			: QString();
-		auto result = Media::Clip::PrepareForSending(filepath, data);
-		auto bytes = QByteArray();
-		if (!result.thumbnail.isNull()) {
-			QBuffer buffer(&bytes);
-			result.thumbnail.save(&buffer, "JPG", kGoodThumbQuality);
-		}
-		if (!filepath.isEmpty()) {
-			location->accessDisable();
-		}
-		const auto bytesSize = bytes.size();
-		ready(
-			std::move(guard),
-			std::move(result.thumbnail),
-			bytesSize,
-			std::move(bytes));
-	});
+	auto start = [=, location = std::move(location)](
+			base::binary_guard &&guard) mutable {
+		crl::async([
+			=,
+			guard = std::move(guard),
+			location = std::move(location)
+		]() mutable {
+			const auto filepath = (location && location->accessEnable())
+				? location->name()
+				: QString();
+			auto result = Media::Clip::PrepareForSending(filepath, data);
+			auto bytes = QByteArray();
+			if (!result.thumbnail.isNull()) {
+				QBuffer buffer(&bytes);
+				result.thumbnail.save(&buffer, "JPG", kGoodThumbQuality);
+			}
+			if (!filepath.isEmpty()) {
+				location->accessDisable();
+			}
+			crl::on_main([] { GenerateFinished(); });
+			const auto bytesSize = bytes.size();
+			ready(
+				std::move(guard),
+				std::move(result.thumbnail),
+				bytesSize,
+				std::move(bytes));
+		});
+	};
+	EnqueueGenerate(std::move(guard), std::move(start));
 }
 
 // NB: This method is called from crl::async(), 'this' is unreliable.
@@ -89,7 +138,9 @@ void GoodThumbSource::ready(
 				_document->goodThumbnailCacheKey(),
 				Storage::Cache::Database::TaggedValue{
 					std::move(bytes),
-					Data::kImageCacheTag });
+					Data::kImageCacheTag },
+				nullptr,
+				Storage::Cache::Priority::Background);
 		}
 		Auth().downloaderTaskFinished().notify();
 	});
@@ -124,7 +175,8 @@ void GoodThumbSource::load(
 
 	Auth().data().cache().get(
 		_document->goodThumbnailCacheKey(),
-		std::move(callback));
+		std::move(callback),
+		Storage::Cache::Priority::Visible);
 }
 
 void GoodThumbSource::loadEvenCancelled(
@@ -164,6 +216,9 @@ void GoodThumbSource::cancel() {
 	_loading.kill();
 }
 
+void GoodThumbSource::pause() {
+}
+
 float64 GoodThumbSource::progress() {
 	return 1.;
 }
@@ -226,4 +281,8 @@ QByteArray GoodThumbSource::bytesForCache() {
 	return QByteArray();
 }
 
+QByteArray GoodThumbSource::partialBytes() {
+	return QByteArray();
+}
+
 } // namespace Data
@@ -36,6 +36,7 @@ public:
 	bool loading() override;
 	bool displayLoading() override;
 	void cancel() override;
+	void pause() override;
 	float64 progress() override;
 	int loadOffset() override;
 
@@ -54,6 +55,7 @@ public:
 	void setInformation(int size, int width, int height) override;
 
 	QByteArray bytesForCache() override;
+	QByteArray partialBytes() override;
 
 private:
 	void generate(base::binary_guard &&guard);
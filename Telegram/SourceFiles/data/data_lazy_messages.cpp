@@ -0,0 +1,167 @@
+/*
+This file is part of Telegram Desktop,
+the official desktop application for the Telegram messaging service.
+
+For license and copyright information please follow this link:
+https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
+*/
+#include "data/data_lazy_messages.h"
+
+#include "history/history_item.h"
+
+namespace Data {
+namespace {
+
+template <typename Flags>
+void ReadHeaderTail(
+		LazyMessage &result,
+		const Flags &flags,
+		bool hasFwdFrom,
+		bool hasViaBotId,
+		const mtpPrime *&from,
+		const mtpPrime *end) {
+	using Flag = typename Flags::Enum;
+
+	auto id = MTPint();
+	id.read(from, end);
+	if (flags & Flag::f_from_id) {
+		MTPint::skip(from, end);
+	}
+	MTPPeer::skip(from, end);
+	if (hasFwdFrom) {
+		MTPMessageFwdHeader::skip(from, end);
+	}
+	if (hasViaBotId) {
+		MTPint::skip(from, end);
+	}
+	if (flags & Flag::f_reply_to_msg_id) {
+		MTPint::skip(from, end);
+	}
+	auto date = MTPint();
+	date.read(from, end);
+
+	result.id = id.v;
+	result.date = date.v;
+}
+
+LazyMessage ReadLazyMessage(const mtpPrime *&from, const mtpPrime *end) {
+	if (from + 1 > end) {
+		throw mtpErrorInsufficient();
+	}
+	auto result = LazyMessage();
+	result.from = from;
+	result.type = mtpTypeId(*from);
+
+	auto header = from + 1;
+	switch (result.type) {
+	case mtpc_messageEmpty: {
+		auto id = MTPint();
+		id.read(header, end);
+		result.id = id.v;
+	} break;
+	case mtpc_message: {
+		using Flag = MTPDmessage::Flag;
+		auto flags = MTPflags<MTPDmessage::Flags>();
+		flags.read(header, end);
+		ReadHeaderTail(
+			result,
+			flags.v,
+			bool(flags.v & Flag::f_fwd_from),
+			bool(flags.v & Flag::f_via_bot_id),
+			header,
+			end);
+		result.flags = flags.v;
+	} break;
+	case mtpc_messageService: {
+		auto flags = MTPflags<MTPDmessageService::Flags>();
+		flags.read(header, end);
+		ReadHeaderTail(result, flags.v, false, false, header, end);
+		result.flags = mtpCastFlags(flags.v);
+	} break;
+	}
+
+	MTPMessage::skip(from, end);
+	result.end = from;
+	return result;
+}
+
+} // namespace
+
+MTPMessage LazyMessage::parse() const {
+	auto data = from;
+	auto result = MTPMessage();
+	result.read(data, end);
+	return result;
+}
+
+LazyMessagesSlice ReadLazyMessagesSlice(
+		const mtpPrime *from,
+		const mtpPrime *end) {
+	if (from + 1 > end) {
+		throw mtpErrorInsufficient();
+	}
+	auto result = LazyMessagesSlice();
+	result.type = mtpTypeId(*from++);
+
+	const auto readInt = [&] {
+		auto value = MTPint();
+		value.read(from, end);
+		return value.v;
+	};
+	switch (result.type) {
+	case mtpc_messages_messages: break;
+	case mtpc_messages_messagesSlice: {
+		result.count = readInt();
+	} break;
+	case mtpc_messages_channelMessages: {
+		auto flags = MTPflags<MTPDmessages_channelMessages::Flags>();
+		flags.read(from, end);
+		result.pts = readInt();
+		result.count = readInt();
+	} break;
+	case mtpc_messages_messagesNotModified: {
+		result.count = readInt();
+		return result;
+	} break;
+	default: throw mtpErrorUnexpected(result.type, "MTPmessages_Messages");
+	}
+
+	if (from + 2 > end) {
+		throw mtpErrorInsufficient();
+	} else if (mtpTypeId(*from) != mtpc_vector) {
+		throw mtpErrorUnexpected(mtpTypeId(*from), "MTPVector<MTPMessage>");
+	}
+	const auto count = int(from[1]);
+	from += 2;
+	result.messages.reserve(std::max(count, 0));
+	for (auto i = 0; i < count; ++i) {
+		result.messages.push_back(ReadLazyMessage(from, end));
+	}
+	if (result.type == mtpc_messages_messages) {
+		result.count = count;
+	}
+	result.chats.read(from, end);
+	result.users.read(from, end);
+	return result;
+}
+
+QVector<MTPMessage> ParseLazyMessages(
+		const std::vector<LazyMessage> &messages,
+		ChannelId channelId) {
+	auto result = QVector<MTPMessage>();
+	result.reserve(messages.size());
+	for (const auto &message : messages) {
+		const auto existing = (message.type != mtpc_messageEmpty)
+			&& !(message.flags & MTPDmessage::Flag::f_media)
+			? App::histItemById(channelId, message.id)
+			: nullptr;
+		if (existing && !existing->media()) {
+			result.push_back(MTP_messageEmpty(MTP_int(message.id)));
+		} else {
+			result.push_back(message.parse());
+		}
+	}
+	return result;
+}
+
+} // namespace Data
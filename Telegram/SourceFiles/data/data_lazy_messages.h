@@ -0,0 +1,46 @@
+/*
+This file is part of Telegram Desktop,
+the official desktop application for the Telegram messaging service.
+
+For license and copyright information please follow this link:
+https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
+*/
+#pragma once
+
+namespace Data {
+
+// A message left serialized in the response with its header fields read.
+struct LazyMessage {
+	MTPMessage parse() const;
+
+	mtpTypeId type = 0;
+	MsgId id = 0;
+	TimeId date = 0;
+	MTPDmessage::Flags flags = 0;
+	const mtpPrime *from = nullptr;
+	const mtpPrime *end = nullptr;
+};
+
+// messages.Messages with the messages vector left serialized.
+// The spans point into the response, so it should be handled in place.
+struct LazyMessagesSlice {
+	mtpTypeId type = 0;
+	std::vector<LazyMessage> messages;
+	MTPVector<MTPChat> chats;
+	MTPVector<MTPUser> users;
+	int count = 0;
+	int pts = 0;
+};
+
+LazyMessagesSlice ReadLazyMessagesSlice(
+	const mtpPrime *from,
+	const mtpPrime *end);
+
+// Parses the messages, except the ones already loaded without any media:
+// they are replaced by messageEmpty, because only the id of an existing
+// item is used when it is added to the history again.
+QVector<MTPMessage> ParseLazyMessages(
+	const std::vector<LazyMessage> &messages,
+	ChannelId channelId);
+
+} // namespace Data
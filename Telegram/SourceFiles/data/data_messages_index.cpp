@@ -0,0 +1,122 @@
+/*
+This file is part of Telegram Desktop,
+the official desktop application for the Telegram messaging service.
+
+For license and copyright information please follow this link:
+https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
+*/
+#include "data/data_messages_index.h"
+
+#include "history/history_item.h"
+
+namespace Data {
+namespace {
+
+constexpr auto kMinimalCapacityBits = 10;
+
+} // namespace
+
+uint64 MessagesIndex::Key(FullMsgId itemId) {
+	return (uint64(uint32(itemId.channel)) << 32)
+		| uint64(uint32(itemId.msg));
+}
+
+int MessagesIndex::idealIndex(uint64 key) const {
+	// Fibonacci hashing, the high bits of the product are the best mixed.
+	return int((key * 0x9E3779B97F4A7C15ULL) >> _shift);
+}
+
+HistoryItem *MessagesIndex::find(FullMsgId itemId) const {
+	if (_slots.empty()) {
+		return nullptr;
+	}
+	const auto key = Key(itemId);
+	for (auto index = idealIndex(key); ; index = next(index)) {
+		const auto &slot = _slots[index];
+		if (!slot.item || slot.key == key) {
+			return slot.item;
+		}
+	}
+}
+
+HistoryItem *MessagesIndex::insert(not_null<HistoryItem*> item) {
+	reserve(_size + 1);
+
+	const auto key = Key(item->fullId());
+	auto index = idealIndex(key);
+	for (; _slots[index].item; index = next(index)) {
+		if (_slots[index].key == key) {
+			return std::exchange(_slots[index].item, item.get());
+		}
+	}
+	_slots[index] = { key, item };
+	++_size;
+	return nullptr;
+}
+
+void MessagesIndex::remove(not_null<HistoryItem*> item) {
+	if (_slots.empty()) {
+		return;
+	}
+	const auto key = Key(item->fullId());
+	auto hole = idealIndex(key);
+	for (; _slots[hole].key != key; hole = next(hole)) {
+		if (!_slots[hole].item) {
+			return;
+		}
+	}
+	if (_slots[hole].item != item) {
+		return;
+	}
+
+	// Move back the following items of the probe sequence,
+	// so that lookups never need tombstones.
+	const auto mask = int(_slots.size()) - 1;
+	for (auto index = next(hole); _slots[index].item; index = next(index)) {
+		const auto ideal = idealIndex(_slots[index].key);
+		if (((index - ideal) & mask) >= ((index - hole) & mask)) {
+			_slots[hole] = _slots[index];
+			hole = index;
+		}
+	}
+	_slots[hole] = Slot();
+	--_size;
+}
+
+std::vector<not_null<HistoryItem*>> MessagesIndex::takeAll() {
+	auto result = std::vector<not_null<HistoryItem*>>();
+	result.reserve(_size);
+	for (const auto &slot : base::take(_slots)) {
+		if (slot.item) {
+			result.push_back(slot.item);
+		}
+	}
+	_size = 0;
+	_shift = 0;
+	return result;
+}
+
+void MessagesIndex::reserve(int count) {
+	// Keep the table at most 3/4 full.
+	auto bits = _slots.empty() ? kMinimalCapacityBits : (64 - _shift);
+	while (count * 4 > (1 << bits) * 3) {
+		++bits;
+	}
+	if (!_slots.empty() && 64 - bits == _shift) {
+		return;
+	}
+	auto slots = std::exchange(_slots, std::vector<Slot>(1 << bits));
+	_shift = 64 - bits;
+	for (const auto &slot : slots) {
+		if (!slot.item) {
+			continue;
+		}
+		auto index = idealIndex(slot.key);
+		while (_slots[index].item) {
+			index = next(index);
+		}
+		_slots[index] = slot;
+	}
+}
+
+} // namespace Data
@@ -0,0 +1,50 @@
+/*
+This file is part of Telegram Desktop,
+the official desktop application for the Telegram messaging service.
+
+For license and copyright information please follow this link:
+https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
+*/
+#pragma once
+
+class HistoryItem;
+
+namespace Data {
+
+// All loaded messages by their FullMsgId in one open addressing table
+// with linear probing: a lookup is a multiplication and a short scan of
+// adjacent slots, regardless of the count of channels.
+class MessagesIndex {
+public:
+	HistoryItem *find(FullMsgId itemId) const;
+
+	// Returns the item that was registered with the same id before.
+	HistoryItem *insert(not_null<HistoryItem*> item);
+	void remove(not_null<HistoryItem*> item);
+
+	std::vector<not_null<HistoryItem*>> takeAll();
+
+	int size() const {
+		return _size;
+	}
+
+private:
+	struct Slot {
+		uint64 key = 0;
+		HistoryItem *item = nullptr;
+	};
+
+	static uint64 Key(FullMsgId itemId);
+	int idealIndex(uint64 key) const;
+	int next(int index) const {
+		return (index + 1) & (int(_slots.size()) - 1);
+	}
+	void reserve(int count);
+
+	std::vector<Slot> _slots;
+	int _size = 0;
+	int _shift = 0;
+
+};
+
+} // namespace Data
@@ -25,6 +25,7 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 #include "messenger.h"
 #include "mainwindow.h"
 #include "window/window_controller.h"
+#include "window/themes/window_theme.h"
 #include "storage/localstorage.h"
 #include "ui/image/image.h"
 #include "ui/empty_userpic.h"
@@ -34,6 +35,132 @@ namespace {
 
 constexpr auto kUpdateFullPeerTimeout = TimeMs(5000); // Not more than once in 5 seconds.
 constexpr auto kUserpicSize = 160;
+constexpr auto kUserpicsAtlasSheetSize = 512;
+constexpr auto kUserpicsAtlasSheetsCount = 4;
+
+// Circled userpics of one size packed in a few shared pixmaps, so that
+// long lists of peers are painted from them with blits of subrects and
+// the empty userpics are not painted with text each time.
+class UserpicsAtlas {
+public:
+	explicit UserpicsAtlas(int size);
+
+	static bool Fits(int size);
+
+	template <typename Fill>
+	void paint(Painter &p, int x, int y, const StorageKey &key, Fill &&fill);
+	void clear();
+
+private:
+	using Queue = std::list<int>;
+
+	int takeSlot(const StorageKey &key);
+	not_null<QPixmap*> sheet(int index);
+	QPoint slotPosition(int index) const;
+
+	int _size = 0;
+	int _perLine = 0;
+	int _perSheet = 0;
+	std::vector<QPixmap> _sheets;
+	std::vector<StorageKey> _keys;
+
+	// Used slots, the least recently painted first.
+	Queue _queue;
+	std::map<StorageKey, Queue::iterator> _slots;
+
+};
+
+UserpicsAtlas::UserpicsAtlas(int size)
+: _size(size)
+, _perLine(kUserpicsAtlasSheetSize / (size * cIntRetinaFactor()))
+, _perSheet(_perLine * _perLine) {
+	Expects(Fits(size));
+}
+
+bool UserpicsAtlas::Fits(int size) {
+	return (size > 0)
+		&& (size * cIntRetinaFactor() * 2 <= kUserpicsAtlasSheetSize);
+}
+
+template <typename Fill>
+void UserpicsAtlas::paint(
+		Painter &p,
+		int x,
+		int y,
+		const StorageKey &key,
+		Fill &&fill) {
+	auto index = 0;
+	const auto i = _slots.find(key);
+	if (i != end(_slots)) {
+		_queue.splice(end(_queue), _queue, i->second);
+		index = *i->second;
+	} else {
+		index = takeSlot(key);
+		const auto position = slotPosition(index);
+		Painter q(sheet(index).get());
+		q.setCompositionMode(QPainter::CompositionMode_Source);
+		q.fillRect(QRect(position, QSize(_size, _size)), Qt::transparent);
+		q.setCompositionMode(QPainter::CompositionMode_SourceOver);
+		fill(q, position.x(), position.y());
+	}
+	const auto pixels = _size * cIntRetinaFactor();
+	p.drawPixmap(
+		QPoint(x, y),
+		*sheet(index),
+		QRect(slotPosition(index) * cIntRetinaFactor(), QSize(pixels, pixels)));
+}
+
+void UserpicsAtlas::clear() {
+	_sheets.clear();
+	_keys.clear();
+	_queue.clear();
+	_slots.clear();
+}
+
+int UserpicsAtlas::takeSlot(const StorageKey &key) {
+	auto index = int(_queue.size());
+	if (index == _perSheet * kUserpicsAtlasSheetsCount) {
+		index = _queue.front();
+		_slots.erase(_keys[index]);
+		_queue.pop_front();
+		_keys[index] = key;
+	} else {
+		_keys.push_back(key);
+	}
+	_slots.emplace(key, _queue.insert(end(_queue), index));
+	return index;
+}
+
+not_null<QPixmap*> UserpicsAtlas::sheet(int index) {
+	const auto number = index / _perSheet;
+	while (int(_sheets.size()) <= number) {
+		_sheets.emplace_back(
+			kUserpicsAtlasSheetSize,
+			kUserpicsAtlasSheetSize);
+		_sheets.back().setDevicePixelRatio(cRetinaFactor());
+	}
+	return &_sheets[number];
+}
+
+QPoint UserpicsAtlas::slotPosition(int index) const {
+	const auto inSheet = index % _perSheet;
+	return QPoint(inSheet % _perLine, inSheet / _perLine) * _size;
+}
+
+UserpicsAtlas &Atlas(int size) {
+	// Never destroyed, pixmaps can't outlive the application.
+	static const auto Atlases = new std::map<int, UserpicsAtlas>();
+	static const auto Subscription = Window::Theme::Background(
+	)->add_subscription([](const Window::Theme::BackgroundUpdate &update) {
+		// The empty userpics are painted with the palette colors.
+		if (update.paletteChanged()) {
+			for (auto &[size, atlas] : *Atlases) {
+				atlas.clear();
+			}
+		}
+	});
+	return Atlases->try_emplace(size, size).first->second;
+}
 
 } // namespace
 
@@ -123,7 +250,9 @@ void PeerData::updateNameDelayed(
 
 	Notify::PeerUpdate update(this);
 	update.flags |= UpdateFlag::NameChanged;
-	update.oldNameFirstLetters = nameFirstLetters();
+
+	// The letters the peer was indexed by, if it was indexed at all.
+	update.oldNameFirstLetters = _nameFirstLetters;
 
 	if (isUser()) {
 		if (asUser()->username != newUsername) {
@@ -143,8 +272,8 @@ void PeerData::updateNameDelayed(
 			update.flags |= UpdateFlag::UsernameChanged;
 		}
 	}
-	fillNames();
-	Notify::PeerUpdated().notify(update, true);
+	_nameWordsOutdated = true;
+	Notify::peerUpdated(update);
 }
 
 std::unique_ptr<Ui::EmptyUserpic> PeerData::createEmptyUserpic() const {
@@ -202,11 +331,23 @@ ImagePtr PeerData::currentUserpic() const {
 }
 
 void PeerData::paintUserpic(Painter &p, int x, int y, int size) const {
-	if (auto userpic = currentUserpic()) {
-		p.drawPixmap(x, y, userpic->pixCircled(userpicOrigin(), size, size));
-	} else {
-		_userpicEmpty->paint(p, x, y, x + size + x, size);
+	const auto userpic = currentUserpic();
+	const auto paintTo = [&](Painter &q, int left, int top) {
+		if (userpic) {
+			const auto origin = userpicOrigin();
+			q.drawPixmap(left, top, userpic->pixCircled(origin, size, size));
+		} else {
+			_userpicEmpty->paint(q, left, top, left + size + left, size);
+		}
+	};
+	if (!UserpicsAtlas::Fits(size) || (userpic && useEmptyUserpic())) {
+		paintTo(p, x, y);
+		return;
 	}
+	const auto key = userpic
+		? storageKey(_userpicLocation)
+		: _userpicEmpty->uniqueKey();
+	Atlas(size).paint(p, x, y, key, paintTo);
 }
 
 void PeerData::paintUserpicRounded(Painter &p, int x, int y, int size) const {
@@ -229,6 +370,12 @@ void PeerData::loadUserpic(bool loadFirst, bool prior) {
 	_userpic->load(userpicOrigin(), loadFirst, prior);
 }
 
+void PeerData::pauseUserpicLoading() {
+	if (!_userpic->loaded()) {
+		_userpic->pause();
+	}
+}
+
 bool PeerData::userpicLoaded() const {
 	return _userpic->loaded();
 }
@@ -330,7 +477,8 @@ void PeerData::setUserpicChecked(
 	}
 }
 
-void PeerData::fillNames() {
+void PeerData::fillNames() const {
+	_nameWordsOutdated = false;
 	_nameWords.clear();
 	_nameFirstLetters.clear();
 	auto toIndexList = QStringList();
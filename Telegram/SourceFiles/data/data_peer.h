@@ -124,9 +124,11 @@ public:
 	Text nameText;
 
 	const base::flat_set<QString> &nameWords() const {
+		fillNamesIfNeeded();
 		return _nameWords;
 	}
 	const base::flat_set<QChar> &nameFirstLetters() const {
+		fillNamesIfNeeded();
 		return _nameFirstLetters;
 	}
 
@@ -167,6 +169,7 @@ public:
 		int y,
 		int size) const;
 	void loadUserpic(bool loadFirst = false, bool prior = true);
+	void pauseUserpicLoading();
 	bool userpicLoaded() const;
 	bool useEmptyUserpic() const;
 	StorageKey userpicUniqueKey() const;
@@ -219,7 +222,12 @@ protected:
 	void clearUserpic();
 
 private:
-	void fillNames();
+	void fillNamesIfNeeded() const {
+		if (_nameWordsOutdated) {
+			fillNames();
+		}
+	}
+	void fillNames() const;
 	std::unique_ptr<Ui::EmptyUserpic> createEmptyUserpic() const;
 	void refreshEmptyUserpic() const;
 
@@ -238,8 +246,11 @@ private:
 	Data::NotifySettings _notify;
 
 	ClickHandlerPtr _openLink;
-	base::flat_set<QString> _nameWords; // for filtering
-	base::flat_set<QChar> _nameFirstLetters;
+	// For filtering, most of the peers are never filtered by name,
+	// so the words are prepared only when they're asked for.
+	mutable base::flat_set<QString> _nameWords;
+	mutable base::flat_set<QChar> _nameFirstLetters;
+	mutable bool _nameWordsOutdated = false;
 
 	TimeMs _lastFullUpdate = 0;
 
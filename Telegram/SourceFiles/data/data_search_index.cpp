@@ -0,0 +1,120 @@
+/*
+This file is part of Telegram Desktop,
+the official desktop application for the Telegram messaging service.
+
+For license and copyright information please follow this link:
+https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
+*/
+#include "data/data_search_index.h"
+
+#include "history/history.h"
+#include "history/history_item.h"
+
+namespace Data {
+namespace {
+
+QStringList PrepareWords(const QString &text) {
+	auto result = TextUtilities::PrepareSearchWords(text);
+	result.removeDuplicates();
+	return result;
+}
+
+bool MatchesAll(const QStringList &words, const QStringList &prefixes) {
+	for (const auto &prefix : prefixes) {
+		const auto matches = ranges::find_if(words, [&](const QString &word) {
+			return word.startsWith(prefix);
+		});
+		if (matches == words.end()) {
+			return false;
+		}
+	}
+	return true;
+}
+
+} // namespace
+
+void SearchIndex::add(not_null<HistoryItem*> item, const QString &text) {
+	if (!IsServerMsgId(item->id)) {
+		return;
+	}
+	const auto words = PrepareWords(text);
+	if (words.isEmpty()) {
+		return;
+	}
+	auto &index = _peers[item->history()->peer->id];
+	for (const auto &word : words) {
+		auto &ids = index[word];
+		const auto i = ranges::lower_bound(ids, item->id);
+		if (i == ids.end() || *i != item->id) {
+			ids.insert(i, item->id);
+		}
+	}
+}
+
+std::vector<MsgId> SearchIndex::Collect(
+		const Words &words,
+		const QString &prefix) {
+	auto result = std::vector<MsgId>();
+	for (auto i = words.lower_bound(prefix); i != words.end(); ++i) {
+		if (!i->first.startsWith(prefix)) {
+			break;
+		}
+		const auto till = int(result.size());
+		result.insert(end(result), begin(i->second), end(i->second));
+		std::inplace_merge(
+			begin(result),
+			begin(result) + till,
+			end(result));
+	}
+	result.erase(std::unique(begin(result), end(result)), end(result));
+	return result;
+}
+
+std::vector<not_null<HistoryItem*>> SearchIndex::search(
+		not_null<PeerData*> peer,
+		const QString &query,
+		UserData *from,
+		int limit) const {
+	const auto i = _peers.find(peer->id);
+	const auto prefixes = PrepareWords(query);
+	if (i == _peers.end() || prefixes.isEmpty() || limit <= 0) {
+		return {};
+	}
+	auto ids = std::optional<std::vector<MsgId>>();
+	for (const auto &prefix : prefixes) {
+		auto found = Collect(i->second, prefix);
+		if (ids) {
+			auto both = std::vector<MsgId>();
+			std::set_intersection(
+				begin(*ids),
+				end(*ids),
+				begin(found),
+				end(found),
+				std::back_inserter(both));
+			found = std::move(both);
+		}
+		if (found.empty()) {
+			return {};
+		}
+		ids = std::move(found);
+	}
+
+	const auto channelId = peerToChannel(peer->id);
+	auto result = std::vector<not_null<HistoryItem*>>();
+	for (auto j = ids->rbegin(); j != ids->rend(); ++j) {
+		const auto item = App::histItemById(channelId, *j);
+		if (!item || (from && item->from() != from)) {
+			continue;
+		}
+		const auto words = PrepareWords(item->originalText().text);
+		if (MatchesAll(words, prefixes)) {
+			result.push_back(item);
+			if (int(result.size()) == limit) {
+				break;
+			}
+		}
+	}
+	return result;
+}
+
+} // namespace Data
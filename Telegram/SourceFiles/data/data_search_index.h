@@ -0,0 +1,42 @@
+/*
+This file is part of Telegram Desktop,
+the official desktop application for the Telegram messaging service.
+
+For license and copyright information please follow this link:
+https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
+*/
+#pragma once
+
+class HistoryItem;
+
+namespace Data {
+
+// Inverted index of the words in the texts of the loaded messages, so that
+// the messages we already have are found without a server round trip.
+//
+// Entries are never removed: the hits are checked against the current item
+// text when searching, which skips the deleted and edited messages.
+class SearchIndex final {
+public:
+	void add(not_null<HistoryItem*> item, const QString &text);
+
+	// Returns the newest matching messages first.
+	std::vector<not_null<HistoryItem*>> search(
+		not_null<PeerData*> peer,
+		const QString &query,
+		UserData *from,
+		int limit) const;
+
+private:
+	// Words sharing a prefix are adjacent, message ids are kept sorted.
+	using Words = std::map<QString, std::vector<MsgId>>;
+
+	static std::vector<MsgId> Collect(
+		const Words &words,
+		const QString &prefix);
+
+	base::flat_map<PeerId, Words> _peers;
+
+};
+
+} // namespace Data
@@ -22,10 +22,14 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 #include "inline_bots/inline_bot_layout_item.h"
 #include "storage/localstorage.h"
 #include "storage/storage_encrypted_file.h"
+#include "storage/storage_facade.h"
+#include "storage/storage_shared_cache.h"
+#include "storage/storage_shared_media.h"
 #include "boxes/abstract_box.h"
 #include "passport/passport_form_controller.h"
 #include "data/data_media_types.h"
 #include "data/data_feed.h"
+#include "data/data_search_index.h"
 #include "data/data_photo.h"
 #include "data/data_document.h"
 #include "data/data_web_page.h"
@@ -35,6 +39,10 @@ namespace Data {
 namespace {
 
 constexpr auto kMaxNotifyCheckDelay = 24 * 3600 * TimeMs(1000);
+constexpr auto kDefaultResidentViewsLimit = 10000;
+constexpr auto kAlwaysResidentHistories = 4;
+constexpr auto kResidencyCheckDelay = TimeMs(1000);
+constexpr auto kSharedMediaCountsSaveDelay = TimeMs(5000);
 
 using ViewElement = HistoryView::Element;
 
@@ -72,18 +80,69 @@ Session::Session(not_null<AuthSession*> session)
 , _cache(Messenger::Instance().databases().get(
 	Local::cachePath(),
 	Local::cacheSettings()))
+, _sharedCache(cSharedCacheDir().isEmpty()
+	? nullptr
+	: std::make_unique<Storage::SharedCache>(cSharedCacheDir()))
+, _residentViewsLimit(kDefaultResidentViewsLimit)
+, _residencyCheckTimer([=] { checkHistoriesResidency(); })
 , _groups(this)
-, _unmuteByFinishedTimer([=] { unmuteByFinished(); }) {
+, _unmuteByFinishedTimer([=] { unmuteByFinished(); })
+, _sharedMediaCountsSaveTimer([=] { writeSharedMediaCounts(); }) {
 	_cache->open(Local::cacheKey());
 
 	setupContactViewsViewer();
 	setupChannelLeavingViewer();
+	setupSharedMediaCountsStorage();
 }
 
 Storage::Cache::Database &Session::cache() {
 	return *_cache;
 }
 
+Storage::SharedCache *Session::sharedCache() const {
+	return _sharedCache.get();
+}
+
+SearchIndex *Session::searchIndex() {
+	if (!_searchIndex && _session->supportMode()) {
+		_searchIndex = std::make_unique<SearchIndex>();
+	}
+	return _searchIndex.get();
+}
+
+auto Session::memoryUsage() const -> MemoryUsage {
+	auto result = MemoryUsage();
+	result.items = _messages.size();
+	for (const auto &[item, views] : _views) {
+		result.views += int(views.size());
+	}
+	result.photos = int(_photos.size());
+	result.documents = int(_documents.size());
+	result.webpages = int(_webpages.size());
+	result.stickerSets = _stickerSets.size();
+	return result;
+}
+
+void Session::setStickersReader(FnMut<void()> reader) {
+	_stickersReader = std::move(reader);
+}
+
+void Session::setSavedGifsReader(FnMut<void()> reader) {
+	_savedGifsReader = std::move(reader);
+}
+
+void Session::readStickersIfNeeded() const {
+	if (_stickersReader) {
+		base::take(_stickersReader)();
+	}
+}
+
+void Session::readSavedGifsIfNeeded() const {
+	if (_savedGifsReader) {
+		base::take(_savedGifsReader)();
+	}
+}
+
 void Session::startExport(PeerData *peer) {
 	startExport(peer ? peer->input : MTP_inputPeerEmpty());
 }
@@ -227,6 +286,42 @@ void Session::setupChannelLeavingViewer() {
 	}, _lifetime);
 }
 
+void Session::setupSharedMediaCountsStorage() {
+	auto &storage = _session->storage();
+	storage.restoreSharedMediaCounts(Local::ReadSharedMediaCounts());
+	const auto empty = [] { return rpl::empty_value(); };
+	rpl::merge(
+		storage.sharedMediaSliceUpdated() | rpl::map(empty),
+		storage.sharedMediaOneRemoved() | rpl::map(empty),
+		storage.sharedMediaAllRemoved() | rpl::map(empty),
+		storage.sharedMediaBottomInvalidated() | rpl::map(empty)
+	) | rpl::filter([=] {
+		return !_sharedMediaCountsSaveTimer.isActive();
+	}) | rpl::start_with_next([=] {
+		_sharedMediaCountsSaveTimer.callOnce(kSharedMediaCountsSaveDelay);
+	}, _lifetime);
+}
+
+void Session::writeSharedMediaCounts() {
+	auto counts = _session->storage().collectSharedMediaCounts();
+	for (auto i = counts.begin(); i != counts.end();) {
+		auto &topMessageId = i->second.topMessageId;
+		if (!topMessageId) {
+			const auto history = App::historyLoaded(i->first);
+			const auto last = history ? history->lastMessage() : nullptr;
+			if (last && IsServerMsgId(last->id)) {
+				topMessageId = last->id;
+			}
+		}
+		if (topMessageId) {
+			++i;
+		} else {
+			i = counts.erase(i);
+		}
+	}
+	Local::WriteSharedMediaCounts(counts);
+}
+
 Session::~Session() = default;
 
 template <typename Method>
@@ -436,6 +531,51 @@ rpl::producer<not_null<const History*>> Session::historyUnloaded() const {
 	return _historyUnloaded.events();
 }
 
+void Session::markHistoryViewed(not_null<History*> history) {
+	const auto peerId = history->peer->id;
+	_residentHistories.erase(
+		ranges::remove(_residentHistories, peerId),
+		end(_residentHistories));
+	_residentHistories.push_back(peerId);
+	_residencyCheckTimer.callOnce(kResidencyCheckDelay);
+}
+
+void Session::setResidentViewsLimit(int limit) {
+	_residentViewsLimit = limit;
+	_residencyCheckTimer.callOnce(kResidencyCheckDelay);
+}
+
+void Session::checkHistoriesResidency() {
+	const auto countViews = [](not_null<History*> history) {
+		auto result = 0;
+		for (const auto &block : history->blocks) {
+			result += int(block->messages.size());
+		}
+		return result;
+	};
+	auto histories = std::vector<std::pair<not_null<History*>, int>>();
+	auto views = 0;
+	for (const auto peerId : base::take(_residentHistories)) {
+		if (const auto history = App::historyLoaded(peerId)) {
+			const auto count = countViews(history);
+			histories.emplace_back(history, count);
+			views += count;
+		}
+	}
+
+	// The most recently viewed ones are kept, they can still be on screen.
+	const auto canUnload = int(histories.size()) - kAlwaysResidentHistories;
+	for (auto i = 0; i != int(histories.size()); ++i) {
+		const auto [history, count] = histories[i];
+		if (i < canUnload && views > _residentViewsLimit && count > 0) {
+			history->unloadBlocks();
+			views -= count;
+		} else {
+			_residentHistories.push_back(history->peer->id);
+		}
+	}
+}
+
 void Session::notifyHistoryCleared(not_null<const History*> history) {
 	_historyCleared.fire_copy(history);
 }
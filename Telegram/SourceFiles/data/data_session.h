@@ -11,6 +11,7 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 #include "chat_helpers/stickers.h"
 #include "dialogs/dialogs_key.h"
 #include "data/data_groups.h"
+#include "data/data_messages_index.h"
 #include "history/history_location_manager.h"
 #include "base/timer.h"
 
@@ -43,9 +44,14 @@ namespace Passport {
 struct SavedCredentials;
 } // namespace Passport
 
+namespace Storage {
+class SharedCache;
+} // namespace Storage
+
 namespace Data {
 
 class Feed;
+class SearchIndex;
 enum class FeedUpdateFlag;
 struct FeedUpdate;
 
@@ -77,6 +83,19 @@ public:
 
 	Storage::Cache::Database &cache();
 
+	// Null unless a shared cache folder was passed in the command line.
+	Storage::SharedCache *sharedCache() const;
+
+	struct MemoryUsage {
+		int items = 0;
+		int views = 0;
+		int photos = 0;
+		int documents = 0;
+		int webpages = 0;
+		int stickerSets = 0;
+	};
+	MemoryUsage memoryUsage() const;
+
 	[[nodiscard]] base::Variable<bool> &contactsLoaded() {
 		return _contactsLoaded;
 	}
@@ -120,6 +139,12 @@ public:
 	void notifyHistoryUnloaded(not_null<const History*> history);
 	[[nodiscard]] rpl::producer<not_null<const History*>> historyUnloaded() const;
 
+	// When there are more views in the loaded blocks than the limit the
+	// least recently viewed histories are unloaded, they'll be loaded
+	// again by slices when they're opened.
+	void markHistoryViewed(not_null<History*> history);
+	void setResidentViewsLimit(int limit);
+
 	void notifyItemRemoved(not_null<const HistoryItem*> item);
 	[[nodiscard]] rpl::producer<not_null<const HistoryItem*>> itemRemoved() const;
 	void notifyViewRemoved(not_null<const ViewElement*> view);
@@ -154,6 +179,11 @@ public:
 	void notifySavedGifsUpdated();
 	[[nodiscard]] rpl::producer<> savedGifsUpdated() const;
 
+	// The sticker sets and the saved gifs are read from the local storage
+	// when they're accessed for the first time, not when the app starts.
+	void setStickersReader(FnMut<void()> reader);
+	void setSavedGifsReader(FnMut<void()> reader);
+
 	bool stickersUpdateNeeded(TimeMs now) const {
 		return stickersUpdateNeeded(_lastStickersUpdate, now);
 	}
@@ -185,6 +215,7 @@ public:
 		_lastSavedGifsUpdate = update;
 	}
 	int featuredStickerSetsUnreadCount() const {
+		readStickersIfNeeded();
 		return _featuredStickerSetsUnreadCount.current();
 	}
 	void setFeaturedStickerSetsUnreadCount(int count) {
@@ -194,33 +225,43 @@ public:
 		return _featuredStickerSetsUnreadCount.value();
 	}
 	const Stickers::Sets &stickerSets() const {
+		readStickersIfNeeded();
 		return _stickerSets;
 	}
 	Stickers::Sets &stickerSetsRef() {
+		readStickersIfNeeded();
 		return _stickerSets;
 	}
 	const Stickers::Order &stickerSetsOrder() const {
+		readStickersIfNeeded();
 		return _stickerSetsOrder;
 	}
 	Stickers::Order &stickerSetsOrderRef() {
+		readStickersIfNeeded();
 		return _stickerSetsOrder;
 	}
 	const Stickers::Order &featuredStickerSetsOrder() const {
+		readStickersIfNeeded();
 		return _featuredStickerSetsOrder;
 	}
 	Stickers::Order &featuredStickerSetsOrderRef() {
+		readStickersIfNeeded();
 		return _featuredStickerSetsOrder;
 	}
 	const Stickers::Order &archivedStickerSetsOrder() const {
+		readStickersIfNeeded();
 		return _archivedStickerSetsOrder;
 	}
 	Stickers::Order &archivedStickerSetsOrderRef() {
+		readStickersIfNeeded();
 		return _archivedStickerSetsOrder;
 	}
 	const Stickers::SavedGifs &savedGifs() const {
+		readSavedGifsIfNeeded();
 		return _savedGifs;
 	}
 	Stickers::SavedGifs &savedGifsRef() {
+		readSavedGifsIfNeeded();
 		return _savedGifs;
 	}
 
@@ -436,11 +477,23 @@ public:
 		return _groups;
 	}
 
+	MessagesIndex &messages() {
+		return _messages;
+	}
+	const MessagesIndex &messages() const {
+		return _messages;
+	}
+
+	// Messages are indexed for the local search only in the support mode.
+	SearchIndex *searchIndex();
+
 private:
 	void suggestStartExport();
 
 	void setupContactViewsViewer();
 	void setupChannelLeavingViewer();
+	void setupSharedMediaCountsStorage();
+	void writeSharedMediaCounts();
 	void photoApplyFields(
 		not_null<PhotoData*> photo,
 		const MTPPhoto &data);
@@ -510,6 +563,9 @@ private:
 		PhotoData *photo,
 		DocumentData *document);
 
+	void readStickersIfNeeded() const;
+	void readSavedGifsIfNeeded() const;
+
 	bool stickersUpdateNeeded(TimeMs lastUpdate, TimeMs now) const {
 		constexpr auto kStickersUpdateTimeout = TimeMs(3600'000);
 		return (lastUpdate == 0)
@@ -525,6 +581,8 @@ private:
 		not_null<const PeerData*> peer) const;
 	void unmuteByFinished();
 	void unmuteByFinishedDelayed(TimeMs delay);
+
+	void checkHistoriesResidency();
 	void updateNotifySettingsLocal(not_null<PeerData*> peer);
 	void sendNotifySettingsUpdates();
 
@@ -541,6 +599,7 @@ private:
 	not_null<AuthSession*> _session;
 
 	Storage::DatabasePointer _cache;
+	std::unique_ptr<Storage::SharedCache> _sharedCache;
 
 	std::unique_ptr<Export::ControllerWrap> _export;
 	std::unique_ptr<Export::View::PanelController> _exportPanel;
@@ -565,6 +624,9 @@ private:
 	rpl::event_stream<not_null<const HistoryItem*>> _itemRemoved;
 	rpl::event_stream<not_null<const ViewElement*>> _viewRemoved;
 	rpl::event_stream<not_null<const History*>> _historyUnloaded;
+	std::deque<PeerId> _residentHistories;
+	int _residentViewsLimit = 0;
+	base::Timer _residencyCheckTimer;
 	rpl::event_stream<not_null<const History*>> _historyCleared;
 	base::flat_set<not_null<History*>> _historiesChanged;
 	rpl::event_stream<not_null<History*>> _historyChanged;
@@ -574,6 +636,8 @@ private:
 
 	rpl::event_stream<> _stickersUpdated;
 	rpl::event_stream<> _savedGifsUpdated;
+	mutable FnMut<void()> _stickersReader;
+	mutable FnMut<void()> _savedGifsReader;
 	TimeMs _lastStickersUpdate = 0;
 	TimeMs _lastRecentStickersUpdate = 0;
 	TimeMs _lastFavedStickersUpdate = 0;
@@ -633,6 +697,8 @@ private:
 	base::flat_map<FeedId, std::unique_ptr<Feed>> _feeds;
 	rpl::variable<FeedId> _defaultFeedId = FeedId();
 	Groups _groups;
+	MessagesIndex _messages;
+	std::unique_ptr<SearchIndex> _searchIndex;
 	std::map<
 		not_null<const HistoryItem*>,
 		std::vector<not_null<ViewElement*>>> _views;
@@ -645,6 +711,7 @@ private:
 	rpl::event_stream<> _defaultChatNotifyUpdates;
 	std::unordered_set<not_null<const PeerData*>> _mutedPeers;
 	base::Timer _unmuteByFinishedTimer;
+	base::Timer _sharedMediaCountsSaveTimer;
 
 	MessageIdsList _mimeForwardIds;
 
@@ -27,6 +27,16 @@ constexpr auto kUrlCacheTag = 0x0000030000000000ULL;
 constexpr auto kUrlCacheMask = 0x000000FFFFFFFFFFULL;
 constexpr auto kGeoPointCacheTag = 0x0000040000000000ULL;
 constexpr auto kGeoPointCacheMask = 0x000000FFFFFFFFFFULL;
+constexpr auto kDocumentPartCacheTag = 0x0000050000000000ULL;
+constexpr auto kDocumentPartCacheMask = 0x00000000000000FFULL;
+constexpr auto kDocumentResumeCacheTag = 0x0000060000000000ULL;
+constexpr auto kDocumentResumeCacheMask = 0x00000000000000FFULL;
+constexpr auto kPreparedCacheTag = 0x0000070000000000ULL;
+constexpr auto kPreparedCacheMask = 0x000000FFFFFFFFFFULL;
+constexpr auto kDocumentWaveformCacheTag = 0x0000080000000000ULL;
+constexpr auto kDocumentWaveformCacheMask = 0x00000000000000FFULL;
+constexpr auto kStickersAtlasCacheTag = 0x0000090000000000ULL;
+constexpr auto kStickersAtlasCacheMask = 0x000000FFFFFFFFFFULL;
 
 } // namespace
 
@@ -45,6 +55,39 @@ Storage::Cache::Key DocumentThumbCacheKey(int32 dcId, uint64 id) {
 	};
 }
 
+Storage::Cache::Key DocumentPartCacheKey(int32 dcId, uint64 id, int offset) {
+	const auto part = (uint64(dcId) & Data::kDocumentPartCacheMask);
+	return Storage::Cache::Key{
+		Data::kDocumentPartCacheTag | (uint64(uint32(offset)) << 8) | part,
+		id
+	};
+}
+
+Storage::Cache::Key DocumentResumeCacheKey(int32 dcId, uint64 id) {
+	const auto part = (uint64(dcId) & Data::kDocumentResumeCacheMask);
+	return Storage::Cache::Key{
+		Data::kDocumentResumeCacheTag | part,
+		id
+	};
+}
+
+Storage::Cache::Key DocumentWaveformCacheKey(int32 dcId, uint64 id) {
+	const auto part = (uint64(dcId) & Data::kDocumentWaveformCacheMask);
+	return Storage::Cache::Key{
+		Data::kDocumentWaveformCacheTag | part,
+		id
+	};
+}
+
+Storage::Cache::Key StickersAtlasCacheKey(uint64 setId, QSize cell) {
+	const auto size = (uint64(uint32(cell.width()) & 0xFFFFFU) << 20)
+		| (uint32(cell.height()) & 0xFFFFFU);
+	return Storage::Cache::Key{
+		Data::kStickersAtlasCacheTag | (size & Data::kStickersAtlasCacheMask),
+		setId
+	};
+}
+
 Storage::Cache::Key StorageCacheKey(const StorageImageLocation &location) {
 	const auto dcId = uint64(location.dc()) & 0xFFULL;
 	return Storage::Cache::Key{
@@ -98,6 +141,28 @@ Storage::Cache::Key GeoPointCacheKey(const GeoPointLocation &location) {
 	};
 }
 
+Storage::Cache::Key PreparedImageCacheKey(
+		const Storage::Cache::Key &original,
+		uint64 options,
+		QSize outer) {
+	const auto values = std::array<uint64, 4>{ {
+		original.high,
+		original.low,
+		options,
+		(uint64(uint32(outer.width())) << 32) | uint32(outer.height())
+	} };
+	const auto hash = openssl::Sha256(bytes::object_as_span(&values));
+	const auto bytes = bytes::make_span(hash);
+	const auto bytes1 = bytes.subspan(0, sizeof(uint64));
+	const auto bytes2 = bytes.subspan(sizeof(uint64), sizeof(uint64));
+	const auto part1 = *reinterpret_cast<const uint64*>(bytes1.data());
+	const auto part2 = *reinterpret_cast<const uint64*>(bytes2.data());
+	return Storage::Cache::Key{
+		Data::kPreparedCacheTag | (part1 & Data::kPreparedCacheMask),
+		part2
+	};
+}
+
 } // namespace Data
 
 void AudioMsgId::setTypeFromAudio() {
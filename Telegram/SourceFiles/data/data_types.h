@@ -39,16 +39,25 @@ struct UploadState {
 
 Storage::Cache::Key DocumentCacheKey(int32 dcId, uint64 id);
 Storage::Cache::Key DocumentThumbCacheKey(int32 dcId, uint64 id);
+Storage::Cache::Key DocumentPartCacheKey(int32 dcId, uint64 id, int offset);
+Storage::Cache::Key DocumentResumeCacheKey(int32 dcId, uint64 id);
+Storage::Cache::Key DocumentWaveformCacheKey(int32 dcId, uint64 id);
+Storage::Cache::Key StickersAtlasCacheKey(uint64 setId, QSize cell);
 Storage::Cache::Key StorageCacheKey(const StorageImageLocation &location);
 Storage::Cache::Key WebDocumentCacheKey(const WebFileLocation &location);
 Storage::Cache::Key UrlCacheKey(const QString &location);
 Storage::Cache::Key GeoPointCacheKey(const GeoPointLocation &location);
+Storage::Cache::Key PreparedImageCacheKey(
+	const Storage::Cache::Key &original,
+	uint64 options,
+	QSize outer);
 
 constexpr auto kImageCacheTag = uint8(0x01);
 constexpr auto kStickerCacheTag = uint8(0x02);
 constexpr auto kVoiceMessageCacheTag = uint8(0x03);
 constexpr auto kVideoMessageCacheTag = uint8(0x04);
 constexpr auto kAnimationCacheTag = uint8(0x05);
+constexpr auto kPreparedImageCacheTag = uint8(0x06);
 
 } // namespace Data
 
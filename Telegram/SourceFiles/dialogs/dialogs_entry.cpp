@@ -134,6 +134,25 @@ PositionChange Entry::adjustByPosInChatList(
 	return { movedFrom, movedTo };
 }
 
+std::vector<PositionChange> Entry::AdjustByPosInChatList(
+		Mode list,
+		not_null<IndexedList*> indexed,
+		const std::vector<not_null<Entry*>> &entries) {
+	auto result = std::vector<PositionChange>();
+	auto links = std::vector<not_null<const RowsByLetter*>>();
+	result.reserve(entries.size());
+	links.reserve(entries.size());
+	for (const auto entry : entries) {
+		result.push_back({ entry->mainChatListLink(list)->pos(), 0 });
+		links.push_back(&entry->chatListLinks(list));
+	}
+	indexed->adjustByPos(links);
+	for (auto i = 0, count = int(entries.size()); i != count; ++i) {
+		result[i].movedTo = entries[i]->mainChatListLink(list)->pos();
+	}
+	return result;
+}
+
 void Entry::setChatsListTimeId(TimeId date) {
 	if (_lastMessageTimeId && _lastMessageTimeId >= date) {
 		if (!inChatList(Dialogs::Mode::All)) {
@@ -40,6 +40,10 @@ public:
 	PositionChange adjustByPosInChatList(
 		Mode list,
 		not_null<IndexedList*> indexed);
+	static std::vector<PositionChange> AdjustByPosInChatList(
+		Mode list,
+		not_null<IndexedList*> indexed,
+		const std::vector<not_null<Entry*>> &entries);
 	bool inChatList(Mode list) const {
 		return !chatListLinks(list).empty();
 	}
@@ -23,6 +23,7 @@ RowsByLetter IndexedList::addToEnd(Key key) {
 	RowsByLetter result;
 	if (!_list.contains(key)) {
 		result.emplace(0, _list.addToEnd(key));
+		indexWords(key);
 		for (auto ch : key.entry()->chatsListFirstLetters()) {
 			auto j = _index.find(ch);
 			if (j == _index.cend()) {
@@ -42,6 +43,7 @@ Row *IndexedList::addByName(Key key) {
 	}
 
 	Row *result = _list.addByName(key);
+	indexWords(key);
 	for (auto ch : key.entry()->chatsListFirstLetters()) {
 		auto j = _index.find(ch);
 		if (j == _index.cend()) {
@@ -66,6 +68,23 @@ void IndexedList::adjustByPos(const RowsByLetter &links) {
 	}
 }
 
+void IndexedList::adjustByPos(
+		const std::vector<not_null<const RowsByLetter*>> &links) {
+	auto rows = base::flat_map<QChar, std::vector<not_null<Row*>>>();
+	for (const auto entryLinks : links) {
+		for (const auto [ch, row] : *entryLinks) {
+			rows[ch].push_back(row);
+		}
+	}
+	for (const auto &[ch, list] : rows) {
+		if (ch == QChar(0)) {
+			_list.adjustByPos(list);
+		} else if (const auto i = _index.find(ch); i != _index.cend()) {
+			i->second->adjustByPos(list);
+		}
+	}
+}
+
 void IndexedList::moveToTop(Key key) {
 	if (_list.moveToTop(key)) {
 		for (auto ch : key.entry()->chatsListFirstLetters()) {
@@ -120,6 +139,8 @@ void IndexedList::adjustByName(
 		const base::flat_set<QChar> &oldLetters) {
 	const auto mainRow = _list.adjustByName(key);
 	if (!mainRow) return;
+	unindexWords(key);
+	indexWords(key);
 
 	auto toRemove = oldLetters;
 	auto toAdd = base::flat_set<QChar>();
@@ -159,6 +180,8 @@ void IndexedList::adjustNames(
 	const auto key = Dialogs::Key(history);
 	auto mainRow = _list.getRow(key);
 	if (!mainRow) return;
+	unindexWords(key);
+	indexWords(key);
 
 	auto toRemove = oldLetters;
 	auto toAdd = base::flat_set<QChar>();
@@ -194,6 +217,7 @@ void IndexedList::adjustNames(
 
 void IndexedList::del(Key key, Row *replacedBy) {
 	if (_list.del(key, replacedBy)) {
+		unindexWords(key);
 		for (auto ch : key.entry()->chatsListFirstLetters()) {
 			if (auto it = _index.find(ch); it != _index.cend()) {
 				it->second->del(key, replacedBy);
@@ -202,8 +226,111 @@ void IndexedList::del(Key key, Row *replacedBy) {
 	}
 }
 
+void IndexedList::indexWords(Key key) {
+	auto &words = _wordsByKey[key];
+	words = key.entry()->chatsListNameWords();
+	for (const auto &word : words) {
+		auto entry = std::make_pair(word, key);
+		const auto where = std::lower_bound(
+			begin(_words),
+			end(_words),
+			entry);
+		_words.insert(where, std::move(entry));
+	}
+}
+
+void IndexedList::unindexWords(Key key) {
+	const auto i = _wordsByKey.find(key);
+	if (i == _wordsByKey.end()) {
+		return;
+	}
+	for (const auto &word : i->second) {
+		const auto where = std::lower_bound(
+			begin(_words),
+			end(_words),
+			std::make_pair(word, key));
+		if (where != end(_words) && where->second == key) {
+			_words.erase(where);
+		}
+	}
+	_wordsByKey.erase(i);
+}
+
+std::vector<not_null<Row*>> IndexedList::filtered(
+		const QStringList &words) const {
+	auto result = std::vector<not_null<Row*>>();
+	if (words.isEmpty()) {
+		return result;
+	}
+	using Iterator = std::vector<std::pair<QString, Key>>::const_iterator;
+	const auto startsWith = [&](const QString &word) {
+		const auto from = std::lower_bound(
+			begin(_words),
+			end(_words),
+			word,
+			[](const auto &entry, const QString &word) {
+				return entry.first < word;
+			});
+		const auto till = std::partition_point(
+			from,
+			end(_words),
+			[&](const auto &entry) { return entry.first.startsWith(word); });
+		return std::make_pair(from, till);
+	};
+
+	// Take the keys for the rarest word and check the rest by their names.
+	auto rarest = std::make_pair(Iterator(), Iterator());
+	auto rarestWord = -1;
+	for (auto i = 0, count = words.size(); i != count; ++i) {
+		const auto range = startsWith(words[i]);
+		if (range.first == range.second) {
+			return result;
+		} else if (rarestWord < 0
+			|| (range.second - range.first)
+				< (rarest.second - rarest.first)) {
+			rarest = range;
+			rarestWord = i;
+		}
+	}
+	auto keys = base::flat_set<Key>();
+	for (auto i = rarest.first; i != rarest.second; ++i) {
+		keys.emplace(i->second);
+	}
+	const auto matches = [&](const base::flat_set<QString> &nameWords) {
+		for (auto i = 0, count = words.size(); i != count; ++i) {
+			if (i == rarestWord) {
+				continue;
+			}
+			const auto &word = words[i];
+			const auto found = ranges::find_if(nameWords, [&](
+					const QString &nameWord) {
+				return nameWord.startsWith(word);
+			});
+			if (found == nameWords.end()) {
+				return false;
+			}
+		}
+		return true;
+	};
+	result.reserve(keys.size());
+	for (const auto key : keys) {
+		const auto i = _wordsByKey.find(key);
+		if (i != _wordsByKey.end() && matches(i->second)) {
+			if (const auto row = _list.getRow(key)) {
+				result.push_back(row);
+			}
+		}
+	}
+	ranges::sort(result, [](not_null<Row*> a, not_null<Row*> b) {
+		return (a->pos() < b->pos());
+	});
+	return result;
+}
+
 void IndexedList::clear() {
 	_index.clear();
+	_words.clear();
+	_wordsByKey.clear();
 }
 
 IndexedList::~IndexedList() {
@@ -21,6 +21,7 @@ public:
 	RowsByLetter addToEnd(Key key);
 	Row *addByName(Key key);
 	void adjustByPos(const RowsByLetter &links);
+	void adjustByPos(const std::vector<not_null<const RowsByLetter*>> &links);
 	void moveToTop(Key key);
 
 	// row must belong to this indexed list all().
@@ -50,6 +51,10 @@ public:
 		return &_empty;
 	}
 
+	// Rows of all() having a name word starting with each of the words,
+	// in the order of all().
+	std::vector<not_null<Row*>> filtered(const QStringList &words) const;
+
 	~IndexedList();
 
 	// Part of List interface is duplicated here for all() list.
@@ -82,11 +87,18 @@ private:
 		Mode list,
 		not_null<History*> history,
 		const base::flat_set<QChar> &oldChars);
+	void indexWords(Key key);
+	void unindexWords(Key key);
 
 	SortMode _sortMode;
 	List _list, _empty;
 	base::flat_map<QChar, std::unique_ptr<List>> _index;
 
+	// All name words of all() rows sorted, so that the words starting
+	// with some prefix are found by a binary search.
+	std::vector<std::pair<QString, Key>> _words;
+	base::flat_map<Key, base::flat_set<QString>> _wordsByKey;
+
 };
 
 } // namespace Dialogs
@@ -13,6 +13,7 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 #include "history/feed/history_feed_section.h"
 #include "history/history.h"
 #include "history/history_item.h"
+#include "core/scroll_benchmark.h"
 #include "styles/style_dialogs.h"
 #include "styles/style_chat_helpers.h"
 #include "styles/style_window.h"
@@ -117,6 +118,7 @@ DialogsInner::DialogsInner(QWidget *parent, not_null<Window::Controller*> contro
 	subscribe(Window::Theme::Background(), [=](const Window::Theme::BackgroundUpdate &data) {
 		if (data.paletteChanged()) {
 			Dialogs::Layout::clearUnreadBadgesCache();
+			Dialogs::Layout::clearRowsCache();
 		}
 	});
 
@@ -211,6 +213,9 @@ void DialogsInner::paintRegion(Painter &p, const QRegion &region, bool paintingO
 
 	if (!App::main()) return;
 
+	using namespace Core::ScrollBenchmark;
+	const auto benchmark = Scope(Phase::Dialogs, Kind::Paint);
+
 	auto r = region.boundingRect();
 	if (!paintingOther) {
 		p.setClipRect(r);
@@ -1230,6 +1235,17 @@ void DialogsInner::createDialog(Dialogs::Key key) {
 			_dialogsImportant.get());
 	}
 
+	if (!creating && !_dragging) {
+		// Many dialogs may move at once in updates difference,
+		// reorder them all together after the updates are processed.
+		if (_pendingReorder.empty()) {
+			crl::on_main(this, [=] { applyPendingReorder(); });
+		}
+		_pendingReorder.emplace(key);
+		return;
+	}
+	_pendingReorder.remove(key);
+
 	auto changed = entry->adjustByPosInChatList(
 		Dialogs::Mode::All,
 		_dialogs.get());
@@ -1263,6 +1279,53 @@ void DialogsInner::createDialog(Dialogs::Key key) {
 	}
 }
 
+void DialogsInner::applyPendingReorder() {
+	auto all = std::vector<not_null<Dialogs::Entry*>>();
+	auto important = std::vector<not_null<Dialogs::Entry*>>();
+	for (const auto key : base::take(_pendingReorder)) {
+		const auto entry = key.entry();
+		if (entry->inChatList(Dialogs::Mode::All)) {
+			all.push_back(entry);
+		}
+		if (_dialogsImportant
+			&& entry->toImportant()
+			&& entry->inChatList(Dialogs::Mode::Important)) {
+			important.push_back(entry);
+		}
+	}
+	auto changes = Dialogs::Entry::AdjustByPosInChatList(
+		Dialogs::Mode::All,
+		_dialogs.get(),
+		all);
+	if (_dialogsImportant) {
+		auto importantChanges = Dialogs::Entry::AdjustByPosInChatList(
+			Dialogs::Mode::Important,
+			_dialogsImportant.get(),
+			important);
+		if (Global::DialogsMode() == Dialogs::Mode::Important) {
+			changes = std::move(importantChanges);
+		}
+	}
+
+	auto moved = false;
+	for (const auto &changed : changes) {
+		if (changed.movedFrom == changed.movedTo) {
+			continue;
+		}
+		moved = true;
+		if (!_dragging) {
+			const auto from = dialogsOffset()
+				+ changed.movedFrom * st::dialogsRowHeight;
+			const auto to = dialogsOffset()
+				+ changed.movedTo * st::dialogsRowHeight;
+			emit dialogMoved(from, to);
+		}
+	}
+	if (moved && _state == State::Default) {
+		update();
+	}
+}
+
 void DialogsInner::removeDialog(Dialogs::Key key) {
 	if (key == _menuKey && _menu) {
 		InvokeQueued(this, [this] { _menu = nullptr; });
@@ -1596,80 +1659,19 @@ void DialogsInner::onFilterUpdate(QString newFilter, bool force) {
 		if (_filter.isEmpty() && !_searchFromUser) {
 			clearFilter();
 		} else {
-			QStringList::const_iterator fb = words.cbegin(), fe = words.cend(), fi;
-
 			_state = State::Filtered;
 			_waitingForSearch = true;
 			_filterResults.clear();
 			_filterResultsGlobal.clear();
 			if (!_searchInChat && !words.isEmpty()) {
-				const Dialogs::List *toFilter = nullptr;
-				if (!_dialogs->isEmpty()) {
-					for (fi = fb; fi != fe; ++fi) {
-						auto found = _dialogs->filtered(fi->at(0));
-						if (found->isEmpty()) {
-							toFilter = nullptr;
-							break;
-						}
-						if (!toFilter || toFilter->size() > found->size()) {
-							toFilter = found;
-						}
-					}
-				}
-				const Dialogs::List *toFilterContacts = nullptr;
-				if (!_contactsNoDialogs->isEmpty()) {
-					for (fi = fb; fi != fe; ++fi) {
-						auto found = _contactsNoDialogs->filtered(fi->at(0));
-						if (found->isEmpty()) {
-							toFilterContacts = nullptr;
-							break;
-						}
-						if (!toFilterContacts || toFilterContacts->size() > found->size()) {
-							toFilterContacts = found;
-						}
-					}
-				}
-				_filterResults.reserve((toFilter ? toFilter->size() : 0)
-					+ (toFilterContacts ? toFilterContacts->size() : 0));
-				if (toFilter) {
-					for (const auto row : *toFilter) {
-						const auto &nameWords = row->entry()->chatsListNameWords();
-						auto nb = nameWords.cbegin(), ne = nameWords.cend(), ni = nb;
-						for (fi = fb; fi != fe; ++fi) {
-							auto filterWord = *fi;
-							for (ni = nb; ni != ne; ++ni) {
-								if (ni->startsWith(filterWord)) {
-									break;
-								}
-							}
-							if (ni == ne) {
-								break;
-							}
-						}
-						if (fi == fe) {
-							_filterResults.push_back(row);
-						}
-					}
+				auto found = _dialogs->filtered(words);
+				auto foundContacts = _contactsNoDialogs->filtered(words);
+				_filterResults.reserve(found.size() + foundContacts.size());
+				for (const auto row : found) {
+					_filterResults.push_back(row);
 				}
-				if (toFilterContacts) {
-					for (const auto row : *toFilterContacts) {
-						const auto &nameWords = row->entry()->chatsListNameWords();
-						auto nb = nameWords.cbegin(), ne = nameWords.cend(), ni = nb;
-						for (fi = fb; fi != fe; ++fi) {
-							auto filterWord = *fi;
-							for (ni = nb; ni != ne; ++ni) {
-								if (ni->startsWith(filterWord)) {
-									break;
-								}
-							}
-							if (ni == ne) {
-								break;
-							}
-						}
-						if (fi == fe) {
-							_filterResults.push_back(row);
-						}
-					}
+				for (const auto row : foundContacts) {
+					_filterResults.push_back(row);
 				}
 			}
 			refresh(true);
@@ -1928,6 +1930,18 @@ bool DialogsInner::searchReceived(
 	return lastDateFound != 0;
 }
 
+void DialogsInner::localSearchReceived(
+		const std::vector<not_null<HistoryItem*>> &items) {
+	clearSearchResults(false);
+	for (const auto item : items) {
+		_searchResults.push_back(
+			std::make_unique<Dialogs::FakeRow>(_searchInChat, item));
+	}
+	_searchedCount = int(items.size());
+	_waitingForSearch = false;
+	refresh();
+}
+
 void DialogsInner::peerSearchReceived(
 		const QString &query,
 		const QVector<MTPPeer> &my,
@@ -2060,6 +2074,9 @@ void DialogsInner::notify_historyMuteUpdated(History *history) {
 }
 
 void DialogsInner::refresh(bool toTop) {
+	using namespace Core::ScrollBenchmark;
+	const auto benchmark = Scope(Phase::Dialogs, Kind::Layout);
+
 	int32 h = 0;
 	if (_state == State::Default) {
 		if (shownDialogs()->isEmpty()) {
@@ -41,6 +41,10 @@ public:
 		const QVector<MTPMessage> &result,
 		DialogsSearchRequestType type,
 		int fullCount);
+
+	// Shown until the results from the server replace them.
+	void localSearchReceived(
+		const std::vector<not_null<HistoryItem*>> &items);
 	void peerSearchReceived(
 		const QString &query,
 		const QVector<MTPPeer> &my,
@@ -196,6 +200,7 @@ private:
 //	void applyFeedDialog(const MTPDdialogFeed &dialog); // #feed
 
 	void itemRemoved(not_null<const HistoryItem*> item);
+	void applyPendingReorder();
 	enum class UpdateRowSection {
 		Default       = (1 << 0),
 		Filtered      = (1 << 1),
@@ -296,6 +301,9 @@ private:
 
 	Dialogs::Row *_dragging = nullptr;
 	int _draggingIndex = -1;
+
+	// Position changes are applied once per event loop iteration.
+	base::flat_set<Dialogs::Key> _pendingReorder;
 	int _aboveIndex = -1;
 	QPoint _dragStart;
 	struct PinnedRow {
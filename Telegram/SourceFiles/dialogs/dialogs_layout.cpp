@@ -18,6 +18,8 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 #include "history/history_item.h"
 #include "history/history.h"
 
+#include <list>
+
 namespace Dialogs {
 namespace Layout {
 namespace {
@@ -33,23 +35,24 @@ void paintRowTopRight(Painter &p, const QString &text, QRect &rectForName, bool
 	p.drawText(rectForName.left() + rectForName.width() + st::dialogsDateSkip, rectForName.top() + st::msgNameFont->height - st::msgDateFont->descent, text);
 }
 
-void paintRowDate(Painter &p, QDateTime date, QRect &rectForName, bool active, bool selected) {
+QString RowDateText(QDateTime date) {
 	auto now = QDateTime::currentDateTime();
 	auto lastTime = date;
 	auto nowDate = now.date();
 	auto lastDate = lastTime.date();
 
-	QString dt;
 	bool wasSameDay = (lastDate == nowDate);
 	bool wasRecently = qAbs(lastTime.secsTo(now)) < kRecentlyInSeconds;
 	if (wasSameDay || wasRecently) {
-		dt = lastTime.toString(cTimeFormat());
+		return lastTime.toString(cTimeFormat());
 	} else if (lastDate.year() == nowDate.year() && lastDate.weekNumber() == nowDate.weekNumber()) {
-		dt = langDayOfWeek(lastDate);
-	} else {
-		dt = lastDate.toString(qsl("d.MM.yy"));
+		return langDayOfWeek(lastDate);
 	}
-	paintRowTopRight(p, dt, rectForName, active, selected);
+	return lastDate.toString(qsl("d.MM.yy"));
+}
+
+void paintRowDate(Painter &p, QDateTime date, QRect &rectForName, bool active, bool selected) {
+	paintRowTopRight(p, RowDateText(date), rectForName, active, selected);
 }
 
 void PaintNarrowCounter(
@@ -369,6 +372,311 @@ void paintRow(
 	}
 }
 
+// Everything a chats list row is painted from.
+struct RowState {
+	HistoryItem *item = nullptr;
+	const Data::Draft *cloudDraft = nullptr;
+	QDateTime displayDate;
+	PeerData *from = nullptr;
+	base::flags<Flag> flags;
+	int fullWidth = 0;
+	int unreadCount = 0;
+	bool unreadMuted = false;
+	bool displayMentionBadge = false;
+	bool displayUnreadCounter = false;
+	bool displayUnreadMark = false;
+	bool displayPinnedIcon = false;
+
+	// Not used in painting, but change the way the row looks.
+	MsgId itemId = 0;
+	bool itemUnread = false;
+	bool itemTextCached = false;
+	bool pinned = false;
+	bool promoted = false;
+	TimeId draftDate = 0;
+	bool draftSaving = false;
+	QString dateText;
+	int nameVersion = 0;
+	bool verified = false;
+	StorageKey userpicKey;
+	bool userpicLoaded = false;
+};
+
+bool operator==(const RowState &a, const RowState &b) {
+	return (a.item == b.item)
+		&& (a.cloudDraft == b.cloudDraft)
+		&& (a.from == b.from)
+		&& (a.flags.value() == b.flags.value())
+		&& (a.fullWidth == b.fullWidth)
+		&& (a.unreadCount == b.unreadCount)
+		&& (a.unreadMuted == b.unreadMuted)
+		&& (a.displayMentionBadge == b.displayMentionBadge)
+		&& (a.displayUnreadCounter == b.displayUnreadCounter)
+		&& (a.displayUnreadMark == b.displayUnreadMark)
+		&& (a.displayPinnedIcon == b.displayPinnedIcon)
+		&& (a.itemId == b.itemId)
+		&& (a.itemUnread == b.itemUnread)
+		&& (a.itemTextCached == b.itemTextCached)
+		&& (a.pinned == b.pinned)
+		&& (a.promoted == b.promoted)
+		&& (a.draftDate == b.draftDate)
+		&& (a.draftSaving == b.draftSaving)
+		&& (a.nameVersion == b.nameVersion)
+		&& (a.verified == b.verified)
+		&& (a.userpicKey == b.userpicKey)
+		&& (a.userpicLoaded == b.userpicLoaded)
+		&& (a.displayDate == b.displayDate)
+		&& (a.dateText == b.dateText);
+}
+
+RowState ComputeRowState(
+		not_null<const Row*> row,
+		int fullWidth,
+		bool active,
+		bool selected,
+		bool onlyBackground) {
+	auto result = RowState();
+	const auto entry = row->entry();
+	const auto history = row->history();
+	const auto peer = history ? history->peer.get() : nullptr;
+	const auto unreadCount = entry->chatListUnreadCount();
+	const auto unreadMark = entry->chatListUnreadMark();
+	const auto item = entry->chatsListItem();
+	const auto cloudDraft = [&]() -> const Data::Draft*{
+		if (history && (!item || (!unreadCount && !unreadMark))) {
+			// Draw item, if there are unread messages.
+			if (const auto draft = history->cloudDraft()) {
+				if (!Data::draftIsNull(draft)) {
+					return draft;
+				}
+			}
+		}
+		return nullptr;
+	}();
+	result.item = item;
+	result.cloudDraft = cloudDraft;
+	result.displayDate = [item, cloudDraft] {
+		if (item) {
+			if (cloudDraft) {
+				return (item->date() > cloudDraft->date)
+					? ItemDateTime(item)
+					: ParseDateTime(cloudDraft->date);
+			}
+			return ItemDateTime(item);
+		}
+		return cloudDraft ? ParseDateTime(cloudDraft->date) : QDateTime();
+	}();
+	result.displayMentionBadge = history
+		? history->hasUnreadMentions()
+		: false;
+	result.displayUnreadCounter = [&] {
+		if (result.displayMentionBadge
+			&& unreadCount == 1
+			&& item
+			&& item->isMediaUnread()
+			&& item->mentionsMe()) {
+			return false;
+		}
+		return (unreadCount > 0);
+	}();
+	result.displayUnreadMark = !result.displayUnreadCounter
+		&& !result.displayMentionBadge
+		&& history
+		&& unreadMark;
+	result.displayPinnedIcon = !result.displayUnreadCounter
+		&& !result.displayMentionBadge
+		&& !result.displayUnreadMark
+		&& entry->isPinnedDialog();
+	result.unreadCount = unreadCount;
+	result.unreadMuted = entry->chatListMutedBadge();
+	result.from = history
+		? (history->peer->migrateTo()
+			? history->peer->migrateTo()
+			: history->peer.get())
+		: nullptr;
+	result.flags = (active ? Flag::Active : Flag(0))
+		| (selected ? Flag::Selected : Flag(0))
+		| (onlyBackground ? Flag::OnlyBackground : Flag(0))
+		| (peer && peer->isSelf() ? Flag::SavedMessages : Flag(0));
+	result.fullWidth = fullWidth;
+
+	result.pinned = entry->isPinnedDialog();
+	result.promoted = entry->useProxyPromotion();
+	if (item) {
+		result.itemId = item->id;
+		result.itemUnread = item->unread();
+		result.itemTextCached = (entry->textCachedFor == item);
+	}
+	if (cloudDraft) {
+		result.draftDate = cloudDraft->date;
+		result.draftSaving = (cloudDraft->saveRequestId != 0);
+	}
+	if (result.displayDate.isValid()) {
+		result.dateText = RowDateText(result.displayDate);
+	}
+	if (const auto from = result.from) {
+		const auto userpic = from->currentUserpic();
+		result.nameVersion = from->nameVersion;
+		result.verified = from->isVerified();
+		result.userpicKey = from->userpicUniqueKey();
+		result.userpicLoaded = userpic && userpic->loaded();
+	}
+	return result;
+}
+
+void PaintRowState(
+		Painter &p,
+		not_null<const Row*> row,
+		const RowState &state,
+		TimeMs ms) {
+	const auto entry = row->entry();
+	const auto history = row->history();
+	const auto item = state.item;
+	const auto fullWidth = state.fullWidth;
+	const auto active = (state.flags & Flag::Active) ? true : false;
+	const auto selected = (state.flags & Flag::Selected) ? true : false;
+	const auto paintItemCallback = [&](int nameleft, int namewidth) {
+		const auto texttop = st::dialogsPadding.y()
+			+ st::msgNameFont->height
+			+ st::dialogsSkip;
+		const auto availableWidth = PaintWideCounter(
+			p,
+			texttop,
+			namewidth,
+			fullWidth,
+			state.displayUnreadCounter,
+			state.displayUnreadMark,
+			state.displayMentionBadge,
+			state.displayPinnedIcon,
+			state.unreadCount,
+			active,
+			selected,
+			state.unreadMuted);
+		const auto &color = active
+			? st::dialogsTextFgServiceActive
+			: (selected
+				? st::dialogsTextFgServiceOver
+				: st::dialogsTextFgService);
+		const auto actionWasPainted = history ? history->paintSendAction(
+			p,
+			nameleft,
+			texttop,
+			availableWidth,
+			fullWidth,
+			color,
+			ms) : false;
+		if (!actionWasPainted) {
+			const auto itemRect = QRect(
+				nameleft,
+				texttop,
+				availableWidth,
+				st::dialogsTextFont->height);
+			item->drawInDialog(
+				p,
+				itemRect,
+				active,
+				selected,
+				HistoryItem::DrawInDialog::Normal,
+				entry->textCachedFor,
+				entry->lastItemTextCache);
+		}
+	};
+	const auto paintCounterCallback = [&] {
+		PaintNarrowCounter(
+			p,
+			state.displayUnreadCounter,
+			state.displayUnreadMark,
+			state.displayMentionBadge,
+			state.unreadCount,
+			active,
+			state.unreadMuted);
+	};
+	paintRow(
+		p,
+		row,
+		entry,
+		row->key(),
+		state.from,
+		item,
+		state.cloudDraft,
+		state.displayDate,
+		fullWidth,
+		state.flags,
+		ms,
+		paintItemCallback,
+		paintCounterCallback);
+}
+
+// Pre-rendered rows of the chats list, so that scrolling the list
+// only draws images. A row is painted again when its state changes.
+class RowCaches {
+public:
+	static RowCaches &Instance() {
+		static auto result = RowCaches();
+		return result;
+	}
+
+	const QImage *find(not_null<const Row*> row, const RowState &state);
+	void store(not_null<const Row*> row, RowState &&state, QImage &&image);
+	void remove(not_null<const Row*> row);
+	void clear();
+
+private:
+	struct Cached {
+		not_null<const Row*> row;
+		RowState state;
+		QImage image;
+	};
+
+	// Enough for all the rows visible on a high screen.
+	static constexpr auto kMaxCount = 64;
+
+	std::list<Cached> _list;
+	base::flat_map<not_null<const Row*>, std::list<Cached>::iterator> _map;
+
+};
+
+const QImage *RowCaches::find(
+		not_null<const Row*> row,
+		const RowState &state) {
+	const auto i = _map.find(row);
+	if (i == _map.end()) {
+		return nullptr;
+	} else if (!(i->second->state == state)) {
+		_list.erase(i->second);
+		_map.erase(i);
+		return nullptr;
+	}
+	_list.splice(_list.begin(), _list, i->second);
+	return &i->second->image;
+}
+
+void RowCaches::store(
+		not_null<const Row*> row,
+		RowState &&state,
+		QImage &&image) {
+	remove(row);
+	if (_list.size() >= kMaxCount) {
+		_map.remove(_list.back().row);
+		_list.pop_back();
+	}
+	_list.push_front({ row, std::move(state), std::move(image) });
+	_map.emplace(row, _list.begin());
+}
+
+void RowCaches::remove(not_null<const Row*> row) {
+	const auto i = _map.find(row);
+	if (i != _map.end()) {
+		_list.erase(i->second);
+		_map.erase(i);
+	}
+}
+
+void RowCaches::clear() {
+	_map.clear();
+	_list.clear();
+}
+
 struct UnreadBadgeSizeData {
 	QImage circle;
 	QPixmap left[6], right[6];
@@ -505,136 +813,41 @@ void RowPainter::paint(
 		bool selected,
 		bool onlyBackground,
 		TimeMs ms) {
-	const auto entry = row->entry();
+	const auto state = ComputeRowState(
+		row,
+		fullWidth,
+		active,
+		selected,
+		onlyBackground);
 	const auto history = row->history();
-	const auto peer = history ? history->peer.get() : nullptr;
-	const auto unreadCount = entry->chatListUnreadCount();
-	const auto unreadMark = entry->chatListUnreadMark();
-	const auto unreadMuted = entry->chatListMutedBadge();
-	const auto item = entry->chatsListItem();
-	const auto cloudDraft = [&]() -> const Data::Draft*{
-		if (history && (!item || (!unreadCount && !unreadMark))) {
-			// Draw item, if there are unread messages.
-			if (const auto draft = history->cloudDraft()) {
-				if (!Data::draftIsNull(draft)) {
-					return draft;
-				}
-			}
-		}
-		return nullptr;
-	}();
-	const auto displayDate = [item, cloudDraft] {
-		if (item) {
-			if (cloudDraft) {
-				return (item->date() > cloudDraft->date)
-					? ItemDateTime(item)
-					: ParseDateTime(cloudDraft->date);
-			}
-			return ItemDateTime(item);
-		}
-		return cloudDraft ? ParseDateTime(cloudDraft->date) : QDateTime();
-	}();
-	const auto displayMentionBadge = history
-		? history->hasUnreadMentions()
-		: false;
-	const auto displayUnreadCounter = [&] {
-		if (displayMentionBadge
-			&& unreadCount == 1
-			&& item
-			&& item->isMediaUnread()
-			&& item->mentionsMe()) {
-			return false;
-		}
-		return (unreadCount > 0);
-	}();
-	const auto displayUnreadMark = !displayUnreadCounter
-		&& !displayMentionBadge
+	const auto cacheable = !onlyBackground
 		&& history
-		&& unreadMark;
-	const auto displayPinnedIcon = !displayUnreadCounter
-		&& !displayMentionBadge
-		&& !displayUnreadMark
-		&& entry->isPinnedDialog();
+		&& !row->hasRipple()
+		&& !history->hasSendActionAnimation();
+	if (!cacheable) {
+		PaintRowState(p, row, state, ms);
+		return;
+	}
+	auto &caches = RowCaches::Instance();
+	if (const auto image = caches.find(row, state)) {
+		p.drawImage(0, 0, *image);
+		return;
+	}
+	auto image = QImage(
+		QSize(fullWidth, st::dialogsRowHeight) * cIntRetinaFactor(),
+		QImage::Format_ARGB32_Premultiplied);
+	image.setDevicePixelRatio(cRetinaFactor());
+	{
+		Painter q(&image);
+		PaintRowState(q, row, state, ms);
+	}
+	p.drawImage(0, 0, image);
 
-	const auto from = history
-		? (history->peer->migrateTo()
-			? history->peer->migrateTo()
-			: history->peer.get())
-		: nullptr;
-	const auto flags = (active ? Flag::Active : Flag(0))
-		| (selected ? Flag::Selected : Flag(0))
-		| (onlyBackground ? Flag::OnlyBackground : Flag(0))
-		| (peer && peer->isSelf() ? Flag::SavedMessages : Flag(0));
-	const auto paintItemCallback = [&](int nameleft, int namewidth) {
-		const auto texttop = st::dialogsPadding.y()
-			+ st::msgNameFont->height
-			+ st::dialogsSkip;
-		const auto availableWidth = PaintWideCounter(
-			p,
-			texttop,
-			namewidth,
-			fullWidth,
-			displayUnreadCounter,
-			displayUnreadMark,
-			displayMentionBadge,
-			displayPinnedIcon,
-			unreadCount,
-			active,
-			selected,
-			unreadMuted);
-		const auto &color = active
-			? st::dialogsTextFgServiceActive
-			: (selected
-				? st::dialogsTextFgServiceOver
-				: st::dialogsTextFgService);
-		const auto actionWasPainted = history ? history->paintSendAction(
-			p,
-			nameleft,
-			texttop,
-			availableWidth,
-			fullWidth,
-			color,
-			ms) : false;
-		if (!actionWasPainted) {
-			const auto itemRect = QRect(
-				nameleft,
-				texttop,
-				availableWidth,
-				st::dialogsTextFont->height);
-			item->drawInDialog(
-				p,
-				itemRect,
-				active,
-				selected,
-				HistoryItem::DrawInDialog::Normal,
-				entry->textCachedFor,
-				entry->lastItemTextCache);
-		}
-	};
-	const auto paintCounterCallback = [&] {
-		PaintNarrowCounter(
-			p,
-			displayUnreadCounter,
-			displayUnreadMark,
-			displayMentionBadge,
-			unreadCount,
-			active,
-			unreadMuted);
-	};
-	paintRow(
-		p,
+	// Painting could have filled the item text cache.
+	caches.store(
 		row,
-		entry,
-		row->key(),
-		from,
-		item,
-		cloudDraft,
-		displayDate,
-		fullWidth,
-		flags,
-		ms,
-		paintItemCallback,
-		paintCounterCallback);
+		ComputeRowState(row, fullWidth, active, selected, onlyBackground),
+		std::move(image));
 }
 
 void RowPainter::paint(
@@ -799,5 +1012,13 @@ void clearUnreadBadgesCache() {
 	}
 }
 
+void clearRowsCache() {
+	RowCaches::Instance().clear();
+}
+
+void clearRowCache(not_null<const Row*> row) {
+	RowCaches::Instance().remove(row);
+}
+
 } // namespace Layout
 } // namespace Dialogs
@@ -92,5 +92,8 @@ void paintUnreadCount(
 
 void clearUnreadBadgesCache();
 
+void clearRowsCache();
+void clearRowCache(not_null<const Row*> row);
+
 } // namespace Layout
 } // namespace Dialogs
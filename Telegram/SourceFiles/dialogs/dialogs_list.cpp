@@ -175,6 +175,43 @@ void List::adjustByPos(Row *row) {
 	}
 }
 
+void List::adjustByPos(const std::vector<not_null<Row*>> &rows) {
+	if (_sortMode != SortMode::Date || rows.empty()) {
+		return;
+	} else if (rows.size() == 1) {
+		adjustByPos(rows.front());
+		return;
+	}
+
+	// Take out all the rows and merge them back in one pass.
+	// The rows are expected to be different.
+	auto sorted = rows;
+	ranges::sort(sorted, [](not_null<Row*> a, not_null<Row*> b) {
+		return (a->sortKey() > b->sortKey());
+	});
+	for (const auto row : sorted) {
+		remove(row);
+	}
+	auto before = _begin;
+	for (const auto row : sorted) {
+		while (before != _end && !(before->sortKey() < row->sortKey())) {
+			before = before->_next;
+		}
+		row->_next = before;
+		row->_prev = before->_prev;
+		row->_next->_prev = row;
+		if (row->_prev) {
+			row->_prev->_next = row;
+		} else {
+			_begin = row;
+		}
+	}
+	auto pos = 0;
+	for (auto row = _begin; row != _end; row = row->_next) {
+		row->_pos = pos++;
+	}
+}
+
 bool List::moveToTop(Key key) {
 	auto i = _rowByKey.find(key);
 	if (i == _rowByKey.cend()) {
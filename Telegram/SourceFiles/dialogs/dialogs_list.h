@@ -46,6 +46,7 @@ public:
 	Row *addByName(Key key);
 	bool moveToTop(Key key);
 	void adjustByPos(Row *row);
+	void adjustByPos(const std::vector<not_null<Row*>> &rows);
 	bool del(Key key, Row *replacedBy = nullptr);
 	void remove(Row *row);
 	void clear();
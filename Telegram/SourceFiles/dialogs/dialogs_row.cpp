@@ -10,6 +10,7 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 #include "styles/style_dialogs.h"
 #include "ui/effects/ripple_animation.h"
 #include "dialogs/dialogs_entry.h"
+#include "dialogs/dialogs_layout.h"
 #include "mainwidget.h"
 
 namespace Dialogs {
@@ -40,6 +41,10 @@ void RippleRow::paintRipple(Painter &p, int x, int y, int outerWidth, TimeMs ms,
 	}
 }
 
+Row::~Row() {
+	Layout::clearRowCache(this);
+}
+
 uint64 Row::sortKey() const {
 	return _id.entry()->sortKeyInChatList();
 }
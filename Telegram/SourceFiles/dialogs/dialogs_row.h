@@ -31,6 +31,9 @@ public:
 	void stopLastRipple();
 
 	void paintRipple(Painter &p, int x, int y, int outerWidth, TimeMs ms, const QColor *colorOverride = nullptr) const;
+	bool hasRipple() const {
+		return (_ripple != nullptr);
+	}
 
 private:
 	mutable std::unique_ptr<Ui::RippleAnimation> _ripple;
@@ -48,6 +51,7 @@ public:
 	, _next(next)
 	, _pos(pos) {
 	}
+	~Row();
 
 	Key key() const {
 		return _id;
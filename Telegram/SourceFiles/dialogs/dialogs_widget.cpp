@@ -13,6 +13,7 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 #include "dialogs/dialogs_entry.h"
 #include "history/history.h"
 #include "history/feed/history_feed_section.h"
+#include "core/scroll_benchmark.h"
 #include "ui/widgets/buttons.h"
 #include "ui/widgets/input_fields.h"
 #include "ui/wrap/fade_wrap.h"
@@ -33,6 +34,7 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 #include "storage/storage_media_prepare.h"
 #include "storage/localstorage.h"
 #include "data/data_session.h"
+#include "data/data_search_index.h"
 #include "styles/style_dialogs.h"
 #include "styles/style_window.h"
 
@@ -301,6 +303,13 @@ void DialogsWidget::repaintDialogRow(
 	_inner->repaintDialogRow(history, messageId);
 }
 
+void DialogsWidget::replayScrollBenchmark(Fn<void()> done) {
+	Core::ScrollBenchmark::Replay(
+		_scroll.data(),
+		Core::ScrollBenchmark::Phase::Dialogs,
+		std::move(done));
+}
+
 void DialogsWidget::dialogsToUp() {
 	if (Auth().supportMode()) {
 		return;
@@ -642,6 +651,7 @@ bool DialogsWidget::onSearchMessages(bool searchCache) {
 					MTP_int(0)),
 				rpcDone(&DialogsWidget::searchReceived, DialogsSearchPeerFromStart),
 				rpcFail(&DialogsWidget::searchFailed, DialogsSearchPeerFromStart));
+			searchLocally(peer);
 		} else if (const auto feed = _searchInChat.feed()) {
 			//_searchRequest = MTP::send( // #feed
 			//	MTPchannels_SearchFeed(
@@ -678,6 +688,7 @@ bool DialogsWidget::onSearchMessages(bool searchCache) {
 		} else if (_peerSearchQuery != q) {
 			_peerSearchQuery = q;
 			_peerSearchFull = false;
+			peerSearchFromCachedPrefix(q);
 			_peerSearchRequest = MTP::send(
 				MTPcontacts_Search(
 					MTP_string(_peerSearchQuery),
@@ -707,6 +718,63 @@ bool DialogsWidget::searchForPeersRequired(const QString &query) const {
 	return (query[0] != '#');
 }
 
+// Shows the results of a shorter cached query filtered by the new one
+// until the server answers, the request is still sent because the cached
+// results could be truncated by the limit.
+bool DialogsWidget::peerSearchFromCachedPrefix(const QString &query) {
+	auto found = _peerSearchCache.cend();
+	const auto end = _peerSearchCache.cend();
+	for (auto i = _peerSearchCache.cbegin(); i != end; ++i) {
+		if (query.startsWith(i.key())
+			&& (found == end || i.key().size() > found.key().size())) {
+			found = i;
+		}
+	}
+	if (found == end || found.value().type() != mtpc_contacts_found) {
+		return false;
+	}
+	const auto words = TextUtilities::PrepareSearchWords(query);
+	if (words.isEmpty()) {
+		return false;
+	}
+	const auto username = query.toLower().trimmed();
+	const auto matches = [&](const MTPPeer &mtpPeer) {
+		const auto peer = App::peerLoaded(peerFromMTP(mtpPeer));
+		if (!peer) {
+			return false;
+		} else if (!peer->userName().isEmpty()
+			&& peer->userName().toLower().startsWith(username)) {
+			return true;
+		}
+		const auto &names = peer->nameWords();
+		for (const auto &word : words) {
+			const auto i = ranges::lower_bound(names, word);
+			if (i == names.end() || !i->startsWith(word)) {
+				return false;
+			}
+		}
+		return true;
+	};
+	const auto filter = [&](const QVector<MTPPeer> &peers) {
+		auto result = QVector<MTPPeer>();
+		for (const auto &peer : peers) {
+			if (matches(peer)) {
+				result.push_back(peer);
+			}
+		}
+		return result;
+	};
+	const auto &data = found.value().c_contacts_found();
+	DEBUG_LOG(("Search: showing cached '%1' results for '%2'."
+		).arg(found.key()
+		).arg(query));
+	_inner->peerSearchReceived(
+		query,
+		filter(data.vmy_results.v),
+		filter(data.vresults.v));
+	return true;
+}
+
 void DialogsWidget::onNeedSearchMessages() {
 	if (!onSearchMessages(true)) {
 		_searchTimer.start(AutoSearchTimeout);
@@ -883,6 +951,21 @@ void DialogsWidget::loadPinnedDialogs() {
 	_pinnedDialogsRequestId = MTP::send(MTPmessages_GetPinnedDialogs(), rpcDone(&DialogsWidget::pinnedDialogsReceived), rpcFail(&DialogsWidget::dialogsFailed));
 }
 
+void DialogsWidget::searchLocally(not_null<PeerData*> peer) {
+	const auto index = Auth().data().searchIndex();
+	if (!index) {
+		return;
+	}
+	const auto items = index->search(
+		peer,
+		_searchQuery,
+		_searchQueryFrom,
+		SearchPerPage);
+	if (!items.empty()) {
+		_inner->localSearchReceived(items);
+	}
+}
+
 void DialogsWidget::searchReceived(
 		DialogsSearchRequestType type,
 		const MTPmessages_Messages &result,
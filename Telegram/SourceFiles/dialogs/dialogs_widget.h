@@ -65,6 +65,9 @@ public:
 
 	void dialogsToUp();
 
+	// Scrolls the chats list by the benchmark mode script.
+	void replayScrollBenchmark(Fn<void()> done);
+
 	void startWidthAnimation();
 	void stopWidthAnimation();
 
@@ -138,6 +141,7 @@ private:
 	void pinnedDialogsReceived(
 		const MTPmessages_PeerDialogs &result,
 		mtpRequestId requestId);
+	void searchLocally(not_null<PeerData*> peer);
 	void searchReceived(
 		DialogsSearchRequestType type,
 		const MTPmessages_Messages &result,
@@ -155,6 +159,7 @@ private:
 	void setupSupportLoadingLimit();
 	void setupConnectingWidget();
 	bool searchForPeersRequired(const QString &query) const;
+	bool peerSearchFromCachedPrefix(const QString &query);
 	void setSearchInChat(Dialogs::Key chat, UserData *from = nullptr);
 	void showJumpToDate();
 	void showSearchFrom();
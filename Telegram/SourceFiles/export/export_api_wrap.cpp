@@ -11,6 +11,8 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 #include "export/data/export_data_types.h"
 #include "export/output/export_output_result.h"
 #include "export/output/export_output_file.h"
+#include "export/output/export_output_checkpoint.h"
+#include "export/output/export_output_stats.h"
 #include "mtproto/rpc_sender.h"
 #include "base/value_ordering.h"
 #include "base/bytes.h"
@@ -22,13 +24,11 @@ namespace {
 
 constexpr auto kUserpicsSliceLimit = 100;
 constexpr auto kFileChunkSize = 128 * 1024;
-constexpr auto kFileRequestsCount = 2;
-constexpr auto kFileNextRequestDelay = TimeMs(20);
+constexpr auto kFileRequestsCount = 4;
 constexpr auto kChatsSliceLimit = 100;
 constexpr auto kMessagesSliceLimit = 100;
 constexpr auto kTopPeerSliceLimit = 100;
 constexpr auto kFileMaxSize = 1500 * 1024 * 1024;
-constexpr auto kLocationCacheSize = 100'000;
 
 struct LocationKey {
 	uint64 type;
@@ -67,6 +67,12 @@ LocationKey ComputeLocationKey(const Data::FileLocation &value) {
 	return result;
 }
 
+Output::Checkpoint::Key ComputeCheckpointKey(
+		const Data::FileLocation &value) {
+	const auto key = ComputeLocationKey(value);
+	return { key.type, key.id };
+}
+
 Settings::Type SettingsFromDialogsType(Data::DialogInfo::Type type) {
 	using DialogType = Data::DialogInfo::Type;
 	switch (type) {
@@ -90,19 +96,18 @@ Settings::Type SettingsFromDialogsType(Data::DialogInfo::Type type) {
 
 } // namespace
 
+// Remembers all the files written by the export, so that a document or a
+// photo forwarded to many chats is loaded once and all the messages refer
+// to the same file.
 class ApiWrap::LoadedFileCache {
 public:
 	using Location = Data::FileLocation;
 
-	LoadedFileCache(int limit);
-
 	void save(const Location &location, const QString &relativePath);
 	std::optional<QString> find(const Location &location) const;
 
 private:
-	int _limit = 0;
 	std::map<LocationKey, QString> _map;
-	std::deque<LocationKey> _list;
 
 };
 
@@ -147,7 +152,7 @@ struct ApiWrap::OtherDataProcess {
 };
 
 struct ApiWrap::FileProcess {
-	FileProcess(const QString &path, Output::Stats *stats);
+	FileProcess(const QString &path, Output::Stats *stats, int existing);
 
 	Output::File file;
 	QString relativePath;
@@ -210,6 +215,12 @@ struct ApiWrap::ChatProcess {
 	std::optional<Data::MessagesSlice> slice;
 	bool lastSlice = false;
 	int fileIndex = 0;
+
+	// The next slice is requested while the files of the current one load.
+	std::optional<Data::MessagesSlice> nextSlice;
+	bool nextSliceLast = false;
+	bool nextSliceRequested = false;
+	bool waitingForNextSlice = false;
 };
 
 
@@ -289,24 +300,13 @@ mtpRequestId ApiWrap::RequestBuilder<Request>::send() {
 		: _builder.send();
 }
 
-ApiWrap::LoadedFileCache::LoadedFileCache(int limit) : _limit(limit) {
-	Expects(limit >= 0);
-}
-
 void ApiWrap::LoadedFileCache::save(
 		const Location &location,
 		const QString &relativePath) {
 	if (!location) {
 		return;
 	}
-	const auto key = ComputeLocationKey(location);
-	_map[key] = relativePath;
-	_list.push_back(key);
-	if (_list.size() > _limit) {
-		const auto key = _list.front();
-		_list.pop_front();
-		_map.erase(key);
-	}
+	_map[ComputeLocationKey(location)] = relativePath;
 }
 
 std::optional<QString> ApiWrap::LoadedFileCache::find(
@@ -321,8 +321,12 @@ std::optional<QString> ApiWrap::LoadedFileCache::find(
 	return std::nullopt;
 }
 
-ApiWrap::FileProcess::FileProcess(const QString &path, Output::Stats *stats)
-: file(path, stats) {
+ApiWrap::FileProcess::FileProcess(
+	const QString &path,
+	Output::Stats *stats,
+	int existing)
+: file(path, stats, existing)
+, offset(existing) {
 }
 
 template <typename Request>
@@ -379,7 +383,7 @@ auto ApiWrap::fileRequest(const Data::FileLocation &location, int offset) {
 
 ApiWrap::ApiWrap(Fn<void(FnMut<void()>)> runner)
 : _mtp(std::move(runner))
-, _fileCache(std::make_unique<LoadedFileCache>(kLocationCacheSize)) {
+, _fileCache(std::make_unique<LoadedFileCache>()) {
 }
 
 rpl::producer<RPCError> ApiWrap::errors() const {
@@ -399,6 +403,9 @@ void ApiWrap::startExport(
 
 	_settings = std::make_unique<Settings>(settings);
 	_stats = stats;
+	_checkpoint = std::make_unique<Output::Checkpoint>(
+		_settings->path,
+		*_settings);
 	_startProcess = std::make_unique<StartProcess>();
 	_startProcess->done = std::move(done);
 
@@ -996,11 +1003,19 @@ void ApiWrap::messagesCountLoaded(int localSplitIndex, int count) {
 void ApiWrap::finishExport(FnMut<void()> done) {
 	const auto guard = gsl::finally([&] { _takeoutId = std::nullopt; });
 
+	if (_checkpoint) {
+		_checkpoint->finish();
+	}
+
 	mainRequest(MTPaccount_FinishTakeoutSession(
 		MTP_flags(MTPaccount_FinishTakeoutSession::Flag::f_success)
 	)).done(std::move(done)).send();
 }
 
+TimeMs ApiWrap::floodWaitDuration() const {
+	return _mtp.floodWaitDuration();
+}
+
 void ApiWrap::cancelExportFast() {
 	if (_takeoutId.has_value()) {
 		const auto requestId = mainRequest(MTPaccount_FinishTakeoutSession(
@@ -1245,31 +1260,72 @@ void ApiWrap::requestMessagesSlice() {
 	if (!count) {
 		loadMessagesFiles({});
 		return;
+	} else if (_chatProcess->nextSlice) {
+		if (_chatProcess->nextSliceLast) {
+			_chatProcess->lastSlice = true;
+		}
+		loadMessagesFiles(*base::take(_chatProcess->nextSlice));
+		return;
+	} else if (_chatProcess->nextSliceRequested) {
+		_chatProcess->waitingForNextSlice = true;
+		return;
 	}
+	requestMessagesSliceFrom(
+		_chatProcess->largestIdPlusOne,
+		[=](Data::MessagesSlice &&slice, bool last) {
+		if (last) {
+			_chatProcess->lastSlice = true;
+		}
+		loadMessagesFiles(std::move(slice));
+	});
+}
+
+void ApiWrap::requestMessagesSliceFrom(
+		int offsetId,
+		FnMut<void(Data::MessagesSlice&&, bool last)> done) {
+	Expects(_chatProcess != nullptr);
+
 	requestChatMessages(
 		_chatProcess->info.splits[_chatProcess->localSplitIndex],
-		_chatProcess->largestIdPlusOne,
+		offsetId,
 		-kMessagesSliceLimit,
 		kMessagesSliceLimit,
-		[=](const MTPmessages_Messages &result) {
+		[=, done = std::move(done)](
+			const MTPmessages_Messages &result) mutable {
 		Expects(_chatProcess != nullptr);
 
 		result.match([&](const MTPDmessages_messagesNotModified &data) {
 			error("Unexpected messagesNotModified received.");
 		}, [&](const auto &data) {
-			if constexpr (MTPDmessages_messages::Is<decltype(data)>()) {
-				_chatProcess->lastSlice = true;
-			}
-			loadMessagesFiles(Data::ParseMessagesSlice(
+			const auto last = MTPDmessages_messages::Is<decltype(data)>();
+			done(Data::ParseMessagesSlice(
 				_chatProcess->context,
 				data.vmessages,
 				data.vusers,
 				data.vchats,
-				_chatProcess->info.relativePath));
+				_chatProcess->info.relativePath), last);
 		});
 	});
 }
 
+void ApiWrap::requestNextMessagesSlice(int offsetId) {
+	Expects(_chatProcess != nullptr);
+	Expects(!_chatProcess->nextSlice.has_value());
+	Expects(!_chatProcess->nextSliceRequested);
+
+	_chatProcess->nextSliceRequested = true;
+	requestMessagesSliceFrom(
+		offsetId,
+		[=](Data::MessagesSlice &&slice, bool last) {
+		_chatProcess->nextSliceRequested = false;
+		_chatProcess->nextSlice = std::move(slice);
+		_chatProcess->nextSliceLast = last;
+		if (base::take(_chatProcess->waitingForNextSlice)) {
+			requestMessagesSlice();
+		}
+	});
+}
+
 void ApiWrap::requestChatMessages(
 		int splitIndex,
 		int offsetId,
@@ -1344,6 +1400,10 @@ void ApiWrap::loadMessagesFiles(Data::MessagesSlice &&slice) {
 	_chatProcess->slice = std::move(slice);
 	_chatProcess->fileIndex = 0;
 
+	if (!_chatProcess->lastSlice) {
+		requestNextMessagesSlice(_chatProcess->slice->list.back().id + 1);
+	}
+
 	loadNextMessageFile();
 }
 
@@ -1512,6 +1572,8 @@ bool ApiWrap::processFileLoad(
 		// Don't load thumbs for large files that we skip.
 		file.skipReason = SkipReason::FileSize;
 		return true;
+	} else if (writeStoredFile(file)) {
+		return true;
 	}
 	loadFile(file, std::move(progress), std::move(done));
 	return false;
@@ -1527,7 +1589,11 @@ bool ApiWrap::writePreloadedFile(Data::File &file) {
 		return true;
 	} else if (!file.content.isEmpty()) {
 		const auto process = prepareFileProcess(file);
-		if (const auto result = process->file.writeBlock(file.content)) {
+		const auto result = [&] {
+			const auto result = process->file.writeBlock(file.content);
+			return result ? process->file.flush() : result;
+		}();
+		if (result) {
 			file.relativePath = process->relativePath;
 			_fileCache->save(file.location, file.relativePath);
 		} else {
@@ -1538,6 +1604,23 @@ bool ApiWrap::writePreloadedFile(Data::File &file) {
 	return false;
 }
 
+bool ApiWrap::writeStoredFile(Data::File &file) {
+	Expects(_checkpoint != nullptr);
+
+	if (!file.location) {
+		return false;
+	}
+	const auto key = ComputeCheckpointKey(file.location);
+	if (const auto stored = _checkpoint->find(key)) {
+		if (stored->finished) {
+			file.relativePath = stored->relativePath;
+			_fileCache->save(file.location, file.relativePath);
+			return true;
+		}
+	}
+	return false;
+}
+
 void ApiWrap::loadFile(
 		const Data::File &file,
 		Fn<bool(FileProgress)> progress,
@@ -1546,10 +1629,21 @@ void ApiWrap::loadFile(
 	Expects(file.location.dcId != 0
 		|| file.location.data.type() == mtpc_inputTakeoutFileLocation);
 
-	_fileProcess = prepareFileProcess(file);
+	_fileProcess = prepareFileProcess(file, true);
 	_fileProcess->progress = std::move(progress);
 	_fileProcess->done = std::move(done);
 
+	if (file.location) {
+		const auto result = _checkpoint->fileStarted(
+			ComputeCheckpointKey(file.location),
+			_fileProcess->relativePath,
+			file.size);
+		if (!result) {
+			ioError(result);
+			return;
+		}
+	}
+
 	if (_fileProcess->progress) {
 		const auto progress = FileProgress{
 			_fileProcess->file.size(),
@@ -1563,16 +1657,35 @@ void ApiWrap::loadFile(
 	loadFilePart();
 }
 
-auto ApiWrap::prepareFileProcess(const Data::File &file) const
+auto ApiWrap::prepareFileProcess(
+	const Data::File &file,
+	bool continueStored) const
 -> std::unique_ptr<FileProcess> {
 	Expects(_settings != nullptr);
-
-	const auto relativePath = Output::File::PrepareRelativePath(
-		_settings->path,
-		file.suggestedPath);
+	Expects(_checkpoint != nullptr);
+
+	// Continue loading a file from the last complete part if we can.
+	const auto stored = (continueStored && file.location)
+		? _checkpoint->find(ComputeCheckpointKey(file.location))
+		: std::nullopt;
+	const auto existing = [&] {
+		if (!stored) {
+			return 0;
+		}
+		const auto ready = (file.size > 0)
+			? std::min(stored->ready, file.size - 1)
+			: stored->ready;
+		return ready - (ready % kFileChunkSize);
+	}();
+	const auto relativePath = stored
+		? stored->relativePath
+		: Output::File::PrepareRelativePath(
+			_settings->path,
+			file.suggestedPath);
 	auto result = std::make_unique<FileProcess>(
 		_settings->path + relativePath,
-		_stats);
+		_stats,
+		existing);
 	result->relativePath = relativePath;
 	result->location = file.location;
 	result->size = file.size;
@@ -1599,14 +1712,8 @@ void ApiWrap::loadFilePart() {
 
 	if (_fileProcess->size > 0
 		&& _fileProcess->requests.size() < kFileRequestsCount) {
-		//const auto runner = _runner;
-		//crl::on_main([=] {
-		//	QTimer::singleShot(kFileNextRequestDelay, [=] {
-		//		runner([=] {
-		//			loadFilePart();
-		//		});
-		//	});
-		//});
+		// Keep several parts of a file of a known size in flight.
+		loadFilePart();
 	}
 }
 
@@ -1639,6 +1746,11 @@ void ApiWrap::filePartDone(int offset, const MTPupload_File &result) {
 		Assert(i != end(requests));
 
 		i->bytes = data.vbytes.v;
+		if (_stats) {
+			_stats->incrementMediaBytes(
+				_fileProcess->location.dcId,
+				i->bytes.size());
+		}
 
 		auto &file = _fileProcess->file;
 		while (!requests.empty() && !requests.front().bytes.isEmpty()) {
@@ -1664,6 +1776,18 @@ void ApiWrap::filePartDone(int offset, const MTPupload_File &result) {
 		}
 	}
 
+	if (const auto result = _fileProcess->file.flush(); !result) {
+		ioError(result);
+		return;
+	} else if (_fileProcess->location) {
+		const auto result = _checkpoint->fileFinished(
+			ComputeCheckpointKey(_fileProcess->location),
+			_fileProcess->file.size());
+		if (!result) {
+			ioError(result);
+			return;
+		}
+	}
 	auto process = base::take(_fileProcess);
 	const auto relativePath = process->relativePath;
 	_fileCache->save(process->location, relativePath);
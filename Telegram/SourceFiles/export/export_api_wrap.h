@@ -28,6 +28,7 @@ struct Message;
 namespace Output {
 struct Result;
 class Stats;
+class Checkpoint;
 } // namespace Output
 
 struct Settings;
@@ -84,6 +85,8 @@ public:
 	void finishExport(FnMut<void()> done);
 	void cancelExportFast();
 
+	[[nodiscard]] TimeMs floodWaitDuration() const;
+
 	~ApiWrap();
 
 private:
@@ -144,6 +147,10 @@ private:
 	void checkFirstMessageDate(int localSplitIndex, int count);
 	void messagesCountLoaded(int localSplitIndex, int count);
 	void requestMessagesSlice();
+	void requestMessagesSliceFrom(
+		int offsetId,
+		FnMut<void(Data::MessagesSlice&&, bool last)> done);
+	void requestNextMessagesSlice(int offsetId);
 	void requestChatMessages(
 		int splitIndex,
 		int offsetId,
@@ -165,8 +172,10 @@ private:
 		FnMut<void(QString)> done,
 		Data::Message *message = nullptr);
 	std::unique_ptr<FileProcess> prepareFileProcess(
-		const Data::File &file) const;
+		const Data::File &file,
+		bool continueStored = false) const;
 	bool writePreloadedFile(Data::File &file);
+	bool writeStoredFile(Data::File &file);
 	void loadFile(
 		const Data::File &file,
 		Fn<bool(FileProgress)> progress,
@@ -201,6 +210,7 @@ private:
 
 	std::unique_ptr<StartProcess> _startProcess;
 	std::unique_ptr<LoadedFileCache> _fileCache;
+	std::unique_ptr<Output::Checkpoint> _checkpoint;
 	std::unique_ptr<ContactsProcess> _contactsProcess;
 	std::unique_ptr<UserpicsProcess> _userpicsProcess;
 	std::unique_ptr<OtherDataProcess> _otherDataProcess;
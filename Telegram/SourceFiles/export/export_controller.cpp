@@ -13,6 +13,8 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 #include "export/output/export_output_abstract.h"
 #include "export/output/export_output_result.h"
 #include "export/output/export_output_stats.h"
+#include "export/output/export_output_file.h"
+#include "core/utils.h"
 
 namespace Export {
 namespace {
@@ -29,6 +31,28 @@ Settings NormalizeSettings(const Settings &settings) {
 	return result;
 }
 
+QByteArray StepName(ProcessingState::Step step) {
+	using Step = ProcessingState::Step;
+	switch (step) {
+	case Step::Initializing: return "initializing";
+	case Step::DialogsList: return "dialogs_list";
+	case Step::PersonalInfo: return "personal_info";
+	case Step::Userpics: return "userpics";
+	case Step::Contacts: return "contacts";
+	case Step::Sessions: return "sessions";
+	case Step::OtherData: return "other_data";
+	case Step::Dialogs: return "dialogs";
+	}
+	Unexpected("Step in StepName.");
+}
+
+QByteArray PerSecond(int64 count, TimeMs duration) {
+	return QByteArray::number(
+		duration > 0 ? (count * 1000. / duration) : 0.,
+		'f',
+		1);
+}
+
 } // namespace
 
 class Controller {
@@ -60,6 +84,7 @@ private:
 	void ioError(const QString &path);
 	bool ioCatchError(Output::Result result);
 	void setFinishedState();
+	[[nodiscard]] Output::Result writeStatsSummary();
 
 	//void requestPasswordState();
 	//void passwordStateDone(const MTPaccount_Password &password);
@@ -126,6 +151,10 @@ private:
 	std::vector<Step> _steps;
 	int _stepIndex = -1;
 
+	TimeMs _started = 0;
+	TimeMs _stepStarted = 0;
+	std::vector<TimeMs> _stepDurations;
+
 	rpl::lifetime _lifetime;
 
 };
@@ -239,6 +268,7 @@ void Controller::startExport(
 
 	_settings.path = Output::NormalizePath(_settings);
 	_writer = Output::CreateWriter(_settings.format);
+	_started = _stepStarted = getms(true);
 	fillExportSteps();
 	exportNext();
 }
@@ -310,9 +340,17 @@ void Controller::cancelExportFast() {
 }
 
 void Controller::exportNext() {
+	const auto now = getms(true);
+	if (_stepIndex >= 0) {
+		_stepDurations.push_back(now - _stepStarted);
+	}
+	_stepStarted = now;
+
 	if (++_stepIndex >= _steps.size()) {
 		if (ioCatchError(_writer->finish())) {
 			return;
+		} else if (ioCatchError(writeStatsSummary())) {
+			return;
 		}
 		_api.finishExport([=] {
 			setFinishedState();
@@ -457,6 +495,7 @@ void Controller::exportNextDialog() {
 				return false;
 			}
 			_messagesWritten += result.list.size();
+			_stats.incrementMessages(result.list.size());
 			setState(stateDialogs(DownloadProgress()));
 			return true;
 		}, [=] {
@@ -488,6 +527,7 @@ ProcessingState Controller::prepareState(
 	result.substepsPassed = _substepsPassed;
 	result.substepsNow = substepsInStep(_lastProcessingStep);
 	result.substepsTotal = _substepsTotal;
+	result.elapsed = getms(true) - _started;
 	return result;
 }
 
@@ -578,6 +618,52 @@ int Controller::substepsInStep(Step step) const {
 	return _substepsInStep[static_cast<int>(step)];
 }
 
+Output::Result Controller::writeStatsSummary() {
+	Expects(_stepDurations.size() == _steps.size());
+
+	const auto duration = getms(true) - _started;
+	auto lines = std::vector<std::pair<QByteArray, QByteArray>>();
+	const auto push = [&](const QByteArray &key, auto value) {
+		lines.emplace_back(key, QByteArray::number(value));
+	};
+	push("duration_ms", duration);
+	push("flood_wait_ms", _api.floodWaitDuration());
+	push("files", _stats.filesCount());
+	push("bytes", _stats.bytesCount());
+	for (auto i = 0; i != _steps.size(); ++i) {
+		push("step_" + StepName(_steps[i]) + "_ms", _stepDurations[i]);
+		if (_steps[i] == Step::Dialogs) {
+			push("messages", _stats.messagesCount());
+			lines.emplace_back(
+				"messages_per_second",
+				PerSecond(_stats.messagesCount(), _stepDurations[i]));
+		}
+	}
+	for (auto dcId = 1; dcId <= Output::Stats::kMaxDcId; ++dcId) {
+		const auto bytes = _stats.mediaBytesCount(dcId);
+		if (!bytes) {
+			continue;
+		}
+		const auto prefix = "dc" + QByteArray::number(dcId);
+		push(prefix + "_media_bytes", bytes);
+		lines.emplace_back(
+			prefix + "_media_bytes_per_second",
+			PerSecond(bytes, duration));
+	}
+
+	auto block = QByteArray();
+	for (const auto &[key, value] : lines) {
+		block.append(key).append(": ").append(value).append('\n');
+	}
+
+	// Not counted in the stats, the summary is written after they're ready.
+	auto file = Output::File(_settings.path + "export_stats.txt", nullptr);
+	if (const auto result = file.writeBlock(block); !result) {
+		return result;
+	}
+	return file.flush();
+}
+
 void Controller::setFinishedState() {
 	setState(FinishedState{
 		_writer->mainFilePath(),
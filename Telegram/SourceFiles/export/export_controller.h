@@ -71,6 +71,8 @@ struct ProcessingState {
 	QString bytesName;
 	int bytesLoaded = 0;
 	int bytesCount = 0;
+
+	TimeMs elapsed = 0;
 };
 
 struct ApiErrorState {
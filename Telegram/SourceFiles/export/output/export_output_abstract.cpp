@@ -12,6 +12,7 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 #include "export/output/export_output_json.h"
 #include "export/output/export_output_stats.h"
 #include "export/output/export_output_result.h"
+#include "export/output/export_output_checkpoint.h"
 
 #include <QtCore/QDir>
 #include <QtCore/QDate>
@@ -25,12 +26,22 @@ QString NormalizePath(const Settings &settings) {
 	auto result = path.endsWith('/') ? path : (path + '/');
 	if (!folder.exists() && !settings.forceSubPath) {
 		return result;
+	} else if (Checkpoint::Exists(result, settings)) {
+		return result;
 	}
 	const auto mode = QDir::AllEntries | QDir::NoDotAndDotDot;
 	const auto list = folder.entryInfoList(mode);
 	if (list.isEmpty() && !settings.forceSubPath) {
 		return result;
 	}
+
+	// Continue an unfinished export with the same settings.
+	for (const auto &entry : list) {
+		const auto subPath = entry.absoluteFilePath() + '/';
+		if (entry.isDir() && Checkpoint::Exists(subPath, settings)) {
+			return subPath;
+		}
+	}
 	const auto date = QDate::currentDate();
 	const auto base = QString(settings.onlySinglePeer()
 		? "ChatExport_%1_%2_%3"
@@ -54,6 +65,8 @@ std::unique_ptr<AbstractWriter> CreateWriter(Format format) {
 	case Format::Html: return std::make_unique<HtmlWriter>();
 	case Format::Text: return std::make_unique<TextWriter>();
 	case Format::Json: return std::make_unique<JsonWriter>();
+	case Format::JsonLines:
+		return std::make_unique<JsonWriter>(Format::JsonLines);
 	}
 	Unexpected("Format in Export::Output::CreateWriter.");
 }
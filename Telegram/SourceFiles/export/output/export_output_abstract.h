@@ -37,6 +37,7 @@ enum class Format {
 	Json,
 	Text,
 	Yaml,
+	JsonLines,
 };
 
 class AbstractWriter {
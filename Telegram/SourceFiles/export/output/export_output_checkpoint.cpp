@@ -0,0 +1,253 @@
+/*
+This file is part of Telegram Desktop,
+the official desktop application for the Telegram messaging service.
+
+For license and copyright information please follow this link:
+https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
+*/
+#include "export/output/export_output_checkpoint.h"
+
+#include "export/output/export_output_result.h"
+#include "export/export_settings.h"
+
+#include <QtCore/QFileInfo>
+#include <QtCore/QDataStream>
+
+namespace Export {
+namespace Output {
+namespace {
+
+constexpr auto kVersion = qint32(1);
+constexpr auto kFileName = ".export_checkpoint";
+
+enum class Record : qint32 {
+	Started = 1,
+	Finished = 2,
+};
+
+QByteArray ComputeFingerprint(const Settings &settings) {
+	auto result = QByteArray();
+	QDataStream stream(&result, QIODevice::WriteOnly);
+	stream.setVersion(QDataStream::Qt_5_1);
+	stream
+		<< quint32(settings.format)
+		<< quint32(settings.types)
+		<< quint32(settings.fullChats)
+		<< quint32(settings.media.types)
+		<< qint32(settings.media.sizeLimit)
+		<< qint32(settings.singlePeerFrom)
+		<< qint32(settings.singlePeerTill);
+	settings.singlePeer.match([&](const MTPDinputPeerUser &data) {
+		stream << qint32(1) << qint32(data.vuser_id.v);
+	}, [&](const MTPDinputPeerChat &data) {
+		stream << qint32(2) << qint32(data.vchat_id.v);
+	}, [&](const MTPDinputPeerChannel &data) {
+		stream << qint32(3) << qint32(data.vchannel_id.v);
+	}, [&](const MTPDinputPeerSelf &) {
+		stream << qint32(4);
+	}, [&](const auto &) {
+		stream << qint32(0);
+	});
+	return result;
+}
+
+bool ReadHeader(QDataStream &stream, const QByteArray &fingerprint) {
+	auto version = qint32();
+	auto stored = QByteArray();
+	stream >> version >> stored;
+	return (stream.status() == QDataStream::Ok)
+		&& (version == kVersion)
+		&& (stored == fingerprint);
+}
+
+QByteArray SerializeStarted(
+		Checkpoint::Key key,
+		const QString &relativePath,
+		int size) {
+	auto result = QByteArray();
+	QDataStream stream(&result, QIODevice::WriteOnly);
+	stream.setVersion(QDataStream::Qt_5_1);
+	stream
+		<< qint32(Record::Started)
+		<< quint64(key.type)
+		<< quint64(key.id)
+		<< relativePath
+		<< qint32(size);
+	return result;
+}
+
+QByteArray SerializeFinished(Checkpoint::Key key, int size) {
+	auto result = QByteArray();
+	QDataStream stream(&result, QIODevice::WriteOnly);
+	stream.setVersion(QDataStream::Qt_5_1);
+	stream
+		<< qint32(Record::Finished)
+		<< quint64(key.type)
+		<< quint64(key.id)
+		<< qint32(size);
+	return result;
+}
+
+} // namespace
+
+Checkpoint::Checkpoint(const QString &folder, const Settings &settings)
+: _folder(folder)
+, _path(folder + kFileName)
+, _fingerprint(ComputeFingerprint(settings)) {
+	read();
+}
+
+bool Checkpoint::Exists(const QString &folder, const Settings &settings) {
+	QFile f(folder + kFileName);
+	if (!f.open(QIODevice::ReadOnly)) {
+		return false;
+	}
+	QDataStream stream(&f);
+	stream.setVersion(QDataStream::Qt_5_1);
+	return ReadHeader(stream, ComputeFingerprint(settings));
+}
+
+void Checkpoint::read() {
+	QFile f(_path);
+	if (!f.open(QIODevice::ReadOnly)) {
+		return;
+	}
+	QDataStream stream(&f);
+	stream.setVersion(QDataStream::Qt_5_1);
+	if (!ReadHeader(stream, _fingerprint)) {
+		return;
+	}
+
+	// The last record may be written only partially if the app crashed.
+	while (!stream.atEnd()) {
+		auto record = qint32();
+		auto key = Key();
+		stream >> record >> key.type >> key.id;
+		if (record == qint32(Record::Started)) {
+			auto relativePath = QString();
+			auto size = qint32();
+			stream >> relativePath >> size;
+			if (stream.status() != QDataStream::Ok) {
+				break;
+			}
+			auto &stored = _files[key];
+			stored.relativePath = relativePath;
+			stored.size = size;
+			stored.finished = false;
+		} else if (record == qint32(Record::Finished)) {
+			auto size = qint32();
+			stream >> size;
+			if (stream.status() != QDataStream::Ok) {
+				break;
+			}
+			const auto i = _files.find(key);
+			if (i != end(_files)) {
+				i->second.size = size;
+				i->second.finished = true;
+			}
+		} else {
+			break;
+		}
+	}
+}
+
+auto Checkpoint::find(Key key) const -> std::optional<Stored> {
+	const auto i = _files.find(key);
+	if (i == end(_files)) {
+		return std::nullopt;
+	}
+	auto result = i->second;
+	const auto info = QFileInfo(_folder + result.relativePath);
+	if (!info.exists()) {
+		return std::nullopt;
+	}
+	const auto size = info.size();
+	if (result.finished ? (size != result.size) : (result.size > 0
+		&& size > result.size)) {
+		return std::nullopt;
+	}
+	result.ready = int(size);
+	return result;
+}
+
+Result Checkpoint::fileStarted(
+		Key key,
+		const QString &relativePath,
+		int size) {
+	auto &stored = _files[key];
+	stored.relativePath = relativePath;
+	stored.size = size;
+	stored.finished = false;
+	return writeRecord(SerializeStarted(key, relativePath, size));
+}
+
+Result Checkpoint::fileFinished(Key key, int size) {
+	const auto i = _files.find(key);
+	if (i == end(_files)) {
+		return Result::Success();
+	}
+	i->second.size = size;
+	i->second.finished = true;
+	return writeRecord(SerializeFinished(key, size));
+}
+
+void Checkpoint::finish() {
+	_file.reset();
+	QFile::remove(_path);
+	_files.clear();
+}
+
+Result Checkpoint::open() {
+	// Start from the records read before, dropping a partial last one.
+	const auto temp = _path + ".new";
+	{
+		QFile f(temp);
+		if (!f.open(QIODevice::WriteOnly)) {
+			return error();
+		}
+		auto content = QByteArray();
+		{
+			QDataStream stream(&content, QIODevice::WriteOnly);
+			stream.setVersion(QDataStream::Qt_5_1);
+			stream << kVersion << _fingerprint;
+		}
+		for (const auto &[key, stored] : _files) {
+			content.append(SerializeStarted(
+				key,
+				stored.relativePath,
+				stored.size));
+			if (stored.finished) {
+				content.append(SerializeFinished(key, stored.size));
+			}
+		}
+		if (f.write(content) != content.size() || !f.flush()) {
+			return error();
+		}
+	}
+	QFile::remove(_path);
+	if (!QFile::rename(temp, _path)) {
+		return error();
+	}
+	_file.emplace(_path);
+	return _file->open(QIODevice::Append) ? Result::Success() : error();
+}
+
+Result Checkpoint::writeRecord(const QByteArray &record) {
+	if (!_file) {
+		if (const auto result = open(); !result) {
+			_file.reset();
+			return result;
+		}
+	}
+	if (_file->write(record) == record.size() && _file->flush()) {
+		return Result::Success();
+	}
+	return error();
+}
+
+Result Checkpoint::error() const {
+	return Result(Result::Type::Error, _path);
+}
+
+} // namespace Output
+} // namespace Export
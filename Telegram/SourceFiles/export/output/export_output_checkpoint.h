@@ -0,0 +1,80 @@
+/*
+This file is part of Telegram Desktop,
+the official desktop application for the Telegram messaging service.
+
+For license and copyright information please follow this link:
+https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
+*/
+#pragma once
+
+#include "base/optional.h"
+
+#include <QtCore/QFile>
+#include <QtCore/QString>
+#include <QtCore/QByteArray>
+
+#include <map>
+#include <tuple>
+
+namespace Export {
+
+struct Settings;
+
+namespace Output {
+
+struct Result;
+
+// The list of files downloaded by an unfinished export, kept in its folder.
+// When the export is started again with the same settings it continues in
+// the same folder and doesn't download those files again.
+class Checkpoint {
+public:
+	struct Key {
+		uint64 type = 0;
+		uint64 id = 0;
+
+		inline bool operator<(const Key &other) const {
+			return std::tie(type, id) < std::tie(other.type, other.id);
+		}
+	};
+	struct Stored {
+		QString relativePath;
+		int size = 0;
+		int ready = 0;
+		bool finished = false;
+	};
+
+	Checkpoint(const QString &folder, const Settings &settings);
+
+	[[nodiscard]] static bool Exists(
+		const QString &folder,
+		const Settings &settings);
+
+	// Validates the stored file by the size it has on disk.
+	[[nodiscard]] std::optional<Stored> find(Key key) const;
+
+	[[nodiscard]] Result fileStarted(
+		Key key,
+		const QString &relativePath,
+		int size);
+	[[nodiscard]] Result fileFinished(Key key, int size);
+
+	// Removes the checkpoint after the export is complete.
+	void finish();
+
+private:
+	void read();
+	[[nodiscard]] Result open();
+	[[nodiscard]] Result writeRecord(const QByteArray &record);
+	[[nodiscard]] Result error() const;
+
+	QString _folder;
+	QString _path;
+	QByteArray _fingerprint;
+	std::map<Key, Stored> _files;
+	std::optional<QFile> _file;
+
+};
+
+} // namespace Output
+} // namespace Export
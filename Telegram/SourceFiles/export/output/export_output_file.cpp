@@ -17,46 +17,81 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 
 namespace Export {
 namespace Output {
+namespace {
 
-File::File(const QString &path, Stats *stats) : _path(path), _stats(stats) {
+constexpr auto kBufferSize = 1024 * 1024;
+
+} // namespace
+
+File::File(const QString &path, Stats *stats, int existing)
+: _path(path)
+, _offset(existing)
+, _stats(stats) {
+}
+
+File::~File() {
+	(void)flush();
 }
 
 int File::size() const {
-	return _offset;
+	return _offset + _buffer.size();
 }
 
 bool File::empty() const {
-	return !_offset;
+	return !size();
 }
 
 Result File::writeBlock(const QByteArray &block) {
-	const auto result = writeBlockAttempt(block);
-	if (!result) {
-		_file.reset();
-	}
-	return result;
-}
-
-Result File::writeBlockAttempt(const QByteArray &block) {
 	if (_stats && !_inStats) {
 		_inStats = true;
 		_stats->incrementFiles();
 	}
-	if (const auto result = reopen(); !result) {
-		return result;
+	if (block.isEmpty()) {
+		// An empty file should be created even if nothing is written.
+		return _buffer.isEmpty()
+			? writeBlockAttempt(block)
+			: Result::Success();
+	} else if (_buffer.isEmpty() && block.size() >= kBufferSize) {
+		return writeBlockAttempt(block);
+	}
+	if (_buffer.isEmpty()) {
+		_buffer.reserve(kBufferSize);
 	}
-	const auto size = block.size();
-	if (!size) {
+	_buffer.append(block);
+	return (_buffer.size() >= kBufferSize) ? flush() : Result::Success();
+}
+
+Result File::flush() {
+	if (_buffer.isEmpty()) {
 		return Result::Success();
 	}
-	if (_file->write(block) == size && _file->flush()) {
-		_offset += size;
-		if (_stats) {
-			_stats->incrementBytes(size);
+	const auto result = writeBlockAttempt(_buffer);
+	_buffer = QByteArray();
+	return result;
+}
+
+Result File::writeBlockAttempt(const QByteArray &block) {
+	const auto result = [&] {
+		if (const auto result = reopen(); !result) {
+			return result;
 		}
-		return Result::Success();
+		const auto size = block.size();
+		if (!size) {
+			return Result::Success();
+		}
+		if (_file->write(block) == size && _file->flush()) {
+			_offset += size;
+			if (_stats) {
+				_stats->incrementBytes(size);
+			}
+			return Result::Success();
+		}
+		return error();
+	}();
+	if (!result) {
+		_file.reset();
 	}
-	return error();
+	return result;
 }
 
 Result File::reopen() {
@@ -132,7 +167,11 @@ Result File::Copy(
 	if (bytes.size() != f.size()) {
 		return Result(Result::Type::FatalError, source);
 	}
-	return File(path, stats).writeBlock(bytes);
+	auto file = File(path, stats);
+	if (const auto result = file.writeBlock(bytes); !result) {
+		return result;
+	}
+	return file.flush();
 }
 
 } // namespace Output
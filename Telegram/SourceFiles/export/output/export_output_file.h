@@ -19,14 +19,20 @@ namespace Output {
 struct Result;
 class Stats;
 
+// Small blocks are collected in memory and appended to the file in large
+// writes. Call flush() when the file is complete to know that all of its
+// content was written, the destructor does it ignoring the errors.
 class File {
 public:
-	File(const QString &path, Stats *stats);
+	// The first existing bytes of the file are kept if it is continued.
+	File(const QString &path, Stats *stats, int existing = 0);
+	~File();
 
 	[[nodiscard]] int size() const;
 	[[nodiscard]] bool empty() const;
 
 	[[nodiscard]] Result writeBlock(const QByteArray &block);
+	[[nodiscard]] Result flush();
 
 	[[nodiscard]] static QString PrepareRelativePath(
 		const QString &folder,
@@ -46,6 +52,7 @@ private:
 
 	QString _path;
 	int _offset = 0;
+	QByteArray _buffer;
 	std::optional<QFile> _file;
 
 	Stats *_stats = nullptr;
@@ -91,50 +91,87 @@ auto CalculateThumbSize(
 	};
 }
 
+enum class EscapeKind : uchar {
+	None,
+	Replace,
+	Separator,
+};
+
+// Most of the exported text needs no escaping at all, so the safe runs
+// are found by a table lookup per byte and appended as whole chunks.
+constexpr auto kEscapeKinds = [] {
+	auto result = std::array<EscapeKind, 256>();
+	for (auto i = 0; i != 32; ++i) {
+		result[i] = EscapeKind::Replace;
+	}
+	result[uchar('"')] = EscapeKind::Replace;
+	result[uchar('&')] = EscapeKind::Replace;
+	result[uchar('\'')] = EscapeKind::Replace;
+	result[uchar('<')] = EscapeKind::Replace;
+	result[uchar('>')] = EscapeKind::Replace;
+	result[0xE2] = EscapeKind::Separator;
+	return result;
+}();
+
+inline EscapeKind ComputeEscapeKind(char ch) {
+	return kEscapeKinds[uchar(ch)];
+}
+
+const char *FindEscaped(const char *from, const char *till) {
+	while (from != till && ComputeEscapeKind(*from) == EscapeKind::None) {
+		++from;
+	}
+	return from;
+}
+
+void AppendEscaped(QByteArray &result, char ch) {
+	switch (ch) {
+	case '\n': result.append("<br>", 4); return;
+	case '"': result.append("&quot;", 6); return;
+	case '&': result.append("&amp;", 5); return;
+	case '\'': result.append("&apos;", 6); return;
+	case '<': result.append("&lt;", 4); return;
+	case '>': result.append("&gt;", 4); return;
+	}
+	const auto hex = [](int value) {
+		return char((value >= 10) ? ('A' + (value - 10)) : ('0' + value));
+	};
+	result.append("&#x", 3);
+	result.append(hex(ch >> 4)).append(hex(ch & 0x0F)).append(';');
+}
+
 QByteArray SerializeString(const QByteArray &value) {
 	const auto size = value.size();
 	const auto begin = value.data();
 	const auto end = begin + size;
 
+	auto p = FindEscaped(begin, end);
+	if (p == end) {
+		return value;
+	}
 	auto result = QByteArray();
-	result.reserve(size * 6);
-	for (auto p = begin; p != end; ++p) {
+	result.reserve(size + size / 4 + 16);
+	auto from = begin;
+	while (p != end) {
 		const auto ch = *p;
-		if (ch == '\n') {
-			result.append("<br>", 4);
-		} else if (ch == '"') {
-			result.append("&quot;", 6);
-		} else if (ch == '&') {
-			result.append("&amp;", 5);
-		} else if (ch == '\'') {
-			result.append("&apos;", 6);
-		} else if (ch == '<') {
-			result.append("&lt;", 4);
-		} else if (ch == '>') {
-			result.append("&gt;", 4);
-		} else if (ch >= 0 && ch < 32) {
-			result.append("&#x", 3).append('0' + (ch >> 4));
-			const auto left = (ch & 0x0F);
-			if (left >= 10) {
-				result.append('A' + (left - 10));
+		if (ComputeEscapeKind(ch) == EscapeKind::Separator) {
+			if ((p + 2 < end)
+				&& *(p + 1) == char(0x80)
+				&& (*(p + 2) == char(0xA8) // Line separator.
+					|| *(p + 2) == char(0xA9))) { // Paragraph separator.
+				result.append(from, p - from).append("<br>", 4);
+				from = (p += 3);
 			} else {
-				result.append('0' + left);
-			}
-			result.append(';');
-		} else if (ch == char(0xE2)
-			&& (p + 2 < end)
-			&& *(p + 1) == char(0x80)) {
-			if (*(p + 2) == char(0xA8)) { // Line separator.
-				result.append("<br>", 4);
-			} else if (*(p + 2) == char(0xA9)) { // Paragraph separator.
-				result.append("<br>", 4);
-			} else {
-				result.append(ch);
+				++p;
 			}
 		} else {
-			result.append(ch);
+			result.append(from, p - from);
+			AppendEscaped(result, ch);
+			from = ++p;
 		}
+		p = FindEscaped(p, end);
 	}
+	result.append(from, end - from);
 	return result;
 }
 
@@ -470,15 +507,26 @@ QByteArray HtmlContext::pushTag(
 		} else if (name == "empty") {
 			empty = true;
 		} else {
-			inner.append(' ').append(name);
-			inner.append("=\"").append(SerializeString(value)).append("\"");
+			inner.append(' ').append(name).append("=\"", 2);
+			inner.append(SerializeString(value)).append('"');
 		}
 	}
-	auto result = (data.block ? ("\n" + indent()) : QByteArray())
-		+ "<" + data.name + inner + (empty ? "/" : "") + ">"
-		+ (data.block ? "\n" : "");
+	auto result = QByteArray();
+	result.reserve(_tags.size() + tag.size() + inner.size() + 6);
+	if (data.block) {
+		result.append('\n');
+		appendIndent(result);
+	}
+	result.append('<').append(data.name).append(inner);
+	if (empty) {
+		result.append('/');
+	}
+	result.append('>');
+	if (data.block) {
+		result.append('\n');
+	}
 	if (!empty) {
-		_tags.push_back(data);
+		_tags.push_back(std::move(data));
 	}
 	return result;
 }
@@ -486,17 +534,32 @@ QByteArray HtmlContext::pushTag(
 QByteArray HtmlContext::popTag() {
 	Expects(!_tags.empty());
 
-	const auto data = _tags.back();
+	const auto data = std::move(_tags.back());
 	_tags.pop_back();
-	return (data.block ? ("\n" + indent()) : QByteArray())
-		+ "</" + data.name + ">"
-		+ (data.block ? "\n" : "");
+
+	auto result = QByteArray();
+	result.reserve(_tags.size() + data.name.size() + 5);
+	if (data.block) {
+		result.append('\n');
+		appendIndent(result);
+	}
+	result.append("</", 2).append(data.name).append('>');
+	if (data.block) {
+		result.append('\n');
+	}
+	return result;
 }
 
 QByteArray HtmlContext::indent() const {
 	return QByteArray(_tags.size(), ' ');
 }
 
+void HtmlContext::appendIndent(QByteArray &result) const {
+	const auto was = result.size();
+	result.resize(was + int(_tags.size()));
+	memset(result.data() + was, ' ', _tags.size());
+}
+
 bool HtmlContext::empty() const {
 	return _tags.empty();
 }
@@ -1686,7 +1749,10 @@ Result HtmlWriter::Wrap::close() {
 		while (!_context.empty()) {
 			block.append(_context.popTag());
 		}
-		return _file.writeBlock(block);
+		if (const auto result = _file.writeBlock(block); !result) {
+			return result;
+		}
+		return _file.flush();
 	}
 	return Result::Success();
 }
@@ -26,6 +26,8 @@ public:
 	[[nodiscard]] bool empty() const;
 
 private:
+	void appendIndent(QByteArray &result) const;
+
 	struct Tag {
 		QByteArray name;
 		bool block = true;
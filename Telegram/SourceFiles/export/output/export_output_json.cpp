@@ -90,14 +90,20 @@ QByteArray Indentation(const Context &context) {
 	return Indentation(context.nesting.size());
 }
 
+QByteArray LineStart(const Context &context, int indentation) {
+	return context.compact
+		? QByteArray()
+		: ('\n' + Indentation(indentation));
+}
+
 QByteArray SerializeObject(
 		Context &context,
 		const std::vector<std::pair<QByteArray, QByteArray>> &values) {
-	const auto indent = Indentation(context);
+	const auto indent = LineStart(context, context.nesting.size());
 
 	context.nesting.push_back(Context::kObject);
 	const auto guard = gsl::finally([&] { context.nesting.pop_back(); });
-	const auto next = '\n' + Indentation(context);
+	const auto next = LineStart(context, context.nesting.size());
 
 	auto first = true;
 	auto result = QByteArray();
@@ -114,15 +120,15 @@ QByteArray SerializeObject(
 		result.append(next).append(SerializeString(key)).append(": ", 2);
 		result.append(value);
 	}
-	result.append('\n').append(indent).append("}");
+	result.append(indent).append("}");
 	return result;
 }
 
 QByteArray SerializeArray(
 		Context &context,
 		const std::vector<QByteArray> &values) {
-	const auto indent = Indentation(context.nesting.size());
-	const auto next = '\n' + Indentation(context.nesting.size() + 1);
+	const auto indent = LineStart(context, context.nesting.size());
+	const auto next = LineStart(context, context.nesting.size() + 1);
 
 	auto first = true;
 	auto result = QByteArray();
@@ -135,7 +141,7 @@ QByteArray SerializeArray(
 		}
 		result.append(next).append(value);
 	}
-	result.append('\n').append(indent).append("]");
+	result.append(indent).append("]");
 	return result;
 }
 
@@ -581,6 +587,10 @@ QByteArray SerializeMessage(
 
 } // namespace
 
+JsonWriter::JsonWriter(Format format) : _format(format) {
+	Expects(_format == Format::Json || _format == Format::JsonLines);
+}
+
 Result JsonWriter::start(
 		const Settings &settings,
 		const Environment &environment,
@@ -981,6 +991,18 @@ Result JsonWriter::writeDialogStart(const Data::DialogInfo &data) {
 	}
 	block.append(prepareObjectItemStart("type")
 		+ StringAllowNull(TypeString(data.type)));
+	if (_format == Format::JsonLines) {
+		const auto relativePath = data.relativePath + "messages.jsonl";
+		block.append(prepareObjectItemStart("messages_file")
+			+ SerializeString(relativePath.toUtf8()));
+
+		// Create the file even if there are no messages in the chat.
+		_chat = fileWithRelativePath(relativePath);
+		if (const auto result = _chat->writeBlock({}); !result) {
+			return result;
+		}
+		return _output->writeBlock(block);
+	}
 	block.append(prepareObjectItemStart("messages"));
 	block.append(pushNesting(Context::kArray));
 	return _output->writeBlock(block);
@@ -1008,6 +1030,25 @@ Result JsonWriter::validateDialogsMode(bool isLeftChannel) {
 Result JsonWriter::writeDialogSlice(const Data::MessagesSlice &data) {
 	Expects(_output != nullptr);
 
+	if (_format == Format::JsonLines) {
+		Expects(_chat != nullptr);
+
+		auto context = Context();
+		context.compact = true;
+		auto block = QByteArray();
+		for (const auto &message : data.list) {
+			if (Data::SkipMessageByDate(message, _settings)) {
+				continue;
+			}
+			block.append(SerializeMessage(
+				context,
+				message,
+				data.peers,
+				_environment.internalLinksDomain)).append('\n');
+		}
+		return block.isEmpty() ? Result::Success() : _chat->writeBlock(block);
+	}
+
 	auto block = QByteArray();
 	for (const auto &message : data.list) {
 		if (Data::SkipMessageByDate(message, _settings)) {
@@ -1025,6 +1066,16 @@ Result JsonWriter::writeDialogSlice(const Data::MessagesSlice &data) {
 Result JsonWriter::writeDialogEnd() {
 	Expects(_output != nullptr);
 
+	if (_format == Format::JsonLines) {
+		Expects(_chat != nullptr);
+
+		if (const auto result = _chat->flush(); !result) {
+			return result;
+		}
+		_chat = nullptr;
+		return _output->writeBlock(popNesting());
+	}
+
 	auto block = popNesting();
 	return _output->writeBlock(block + popNesting());
 }
@@ -1058,7 +1109,10 @@ Result JsonWriter::finish() {
 
 	auto block = popNesting();
 	Assert(_context.nesting.empty());
-	return _output->writeBlock(block);
+	if (const auto result = _output->writeBlock(block); !result) {
+		return result;
+	}
+	return _output->flush();
 }
 
 QString JsonWriter::mainFilePath() {
@@ -23,14 +23,21 @@ struct JsonContext {
 
 	// Always fun to use std::vector<bool>.
 	std::vector<Type> nesting;
+
+	// Everything on one line, without indentation.
+	bool compact = false;
 };
 
 } // namespace details
 
+// In the JsonLines format the messages of each chat are written to its own
+// file, one object per line, and result.json has the paths of those files.
 class JsonWriter : public AbstractWriter {
 public:
+	explicit JsonWriter(Format format = Format::Json);
+
 	Format format() override {
-		return Format::Json;
+		return _format;
 	}
 
 	Result start(
@@ -90,6 +97,7 @@ private:
 		const QByteArray &about);
 	[[nodiscard]] Result writeChatsEnd();
 
+	Format _format = Format::Json;
 	Settings _settings;
 	Environment _environment;
 	Stats *_stats = nullptr;
@@ -99,6 +107,7 @@ private:
 	DialogsMode _dialogsMode = DialogsMode::None;
 
 	std::unique_ptr<File> _output;
+	std::unique_ptr<File> _chat;
 
 };
 
@@ -12,7 +12,11 @@ namespace Output {
 
 Stats::Stats(const Stats &other)
 : _files(other._files.load())
-, _bytes(other._bytes.load()) {
+, _bytes(other._bytes.load())
+, _messages(other._messages.load()) {
+	for (auto i = 0; i != _mediaBytes.size(); ++i) {
+		_mediaBytes[i] = other._mediaBytes[i].load();
+	}
 }
 
 void Stats::incrementFiles() {
@@ -23,6 +27,16 @@ void Stats::incrementBytes(int count) {
 	_bytes += count;
 }
 
+void Stats::incrementMessages(int count) {
+	_messages += count;
+}
+
+void Stats::incrementMediaBytes(int dcId, int count) {
+	if (dcId > 0 && dcId <= kMaxDcId) {
+		_mediaBytes[dcId] += count;
+	}
+}
+
 int Stats::filesCount() const {
 	return _files;
 }
@@ -31,5 +45,13 @@ int64 Stats::bytesCount() const {
 	return _bytes;
 }
 
+int Stats::messagesCount() const {
+	return _messages;
+}
+
+int64 Stats::mediaBytesCount(int dcId) const {
+	return (dcId > 0 && dcId <= kMaxDcId) ? _mediaBytes[dcId].load() : 0;
+}
+
 } // namespace Output
 } // namespace Export
@@ -7,6 +7,7 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 */
 #pragma once
 
+#include <array>
 #include <atomic>
 
 namespace Export {
@@ -14,18 +15,26 @@ namespace Output {
 
 class Stats {
 public:
+	static constexpr auto kMaxDcId = 8;
+
 	Stats() = default;
 	Stats(const Stats &other);
 
 	void incrementFiles();
 	void incrementBytes(int count);
+	void incrementMessages(int count);
+	void incrementMediaBytes(int dcId, int count);
 
 	int filesCount() const;
 	int64 bytesCount() const;
+	int messagesCount() const;
+	int64 mediaBytesCount(int dcId) const;
 
 private:
-	std::atomic<int> _files;
-	std::atomic<int64> _bytes;
+	std::atomic<int> _files = 0;
+	std::atomic<int64> _bytes = 0;
+	std::atomic<int> _messages = 0;
+	std::array<std::atomic<int64>, kMaxDcId + 1> _mediaBytes = { { 0 } };
 
 };
 
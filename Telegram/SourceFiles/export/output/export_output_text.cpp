@@ -536,6 +536,11 @@ Result TextWriter::writeUserpicsSlice(const Data::UserpicsSlice &data) {
 }
 
 Result TextWriter::writeUserpicsEnd() {
+	if (_userpics) {
+		if (const auto result = _userpics->flush(); !result) {
+			return result;
+		}
+	}
 	_userpics = nullptr;
 	return Result::Success();
 }
@@ -584,6 +589,8 @@ Result TextWriter::writeSavedContacts(const Data::ContactsList &data) {
 		+ JoinList(kLineBreak, list);
 	if (const auto result = file->writeBlock(full); !result) {
 		return result;
+	} else if (const auto flushed = file->flush(); !flushed) {
+		return flushed;
 	}
 
 	const auto header = "Contacts "
@@ -663,6 +670,8 @@ Result TextWriter::writeFrequentContacts(const Data::ContactsList &data) {
 		+ JoinList(kLineBreak, list);
 	if (const auto result = file->writeBlock(full); !result) {
 		return result;
+	} else if (const auto flushed = file->flush(); !flushed) {
+		return flushed;
 	}
 
 	const auto header = "Frequent contacts "
@@ -719,6 +728,8 @@ Result TextWriter::writeSessions(const Data::SessionsList &data) {
 		+ JoinList(kLineBreak, list);
 	if (const auto result = file->writeBlock(full); !result) {
 		return result;
+	} else if (const auto flushed = file->flush(); !flushed) {
+		return flushed;
 	}
 
 	const auto header = "Sessions "
@@ -767,6 +778,8 @@ Result TextWriter::writeWebSessions(const Data::SessionsList &data) {
 		+ JoinList(kLineBreak, list);
 	if (const auto result = file->writeBlock(full); !result) {
 		return result;
+	} else if (const auto flushed = file->flush(); !flushed) {
+		return flushed;
 	}
 
 	const auto header = "Web sessions "
@@ -855,6 +868,9 @@ Result TextWriter::writeDialogEnd() {
 	Expects(_chats != nullptr);
 	Expects(_chat != nullptr);
 
+	if (const auto result = _chat->flush(); !result) {
+		return result;
+	}
 	_chat = nullptr;
 
 	using Type = Data::DialogInfo::Type;
@@ -944,12 +960,19 @@ Result TextWriter::writeChatsStart(
 }
 
 Result TextWriter::writeChatsEnd() {
+	if (_chats) {
+		if (const auto result = _chats->flush(); !result) {
+			return result;
+		}
+	}
 	_chats = nullptr;
 	return Result::Success();
 }
 
 Result TextWriter::finish() {
-	return Result::Success();
+	Expects(_summary != nullptr);
+
+	return _summary->flush();
 }
 
 QString TextWriter::mainFilePath() {
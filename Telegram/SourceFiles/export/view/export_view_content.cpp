@@ -12,6 +12,29 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 
 namespace Export {
 namespace View {
+namespace {
+
+// Don't show the remaining time until the progress is somewhat stable.
+constexpr auto kTimeLeftMinElapsed = TimeMs(10000);
+constexpr auto kTimeLeftMinProgress = 0.01;
+
+QString AppendTimeLeft(
+		const QString &info,
+		TimeMs elapsed,
+		float64 progress) {
+	if (elapsed < kTimeLeftMinElapsed
+		|| progress < kTimeLeftMinProgress
+		|| progress >= 1.) {
+		return info;
+	}
+	const auto left = qRound64(elapsed * (1. - progress) / progress);
+	const auto text = lng_export_time_left(
+		lt_time,
+		formatDurationText(left / 1000));
+	return info.isEmpty() ? text : (info + ", " + text);
+}
+
+} // namespace
 
 const QString Content::kDoneId = "done";
 
@@ -51,7 +74,12 @@ Content ContentFromState(const ProcessingState &state) {
 			&& !state.entityIndex)
 			? addPart(state.itemIndex, state.itemCount)
 			: addPart(state.entityIndex, state.entityCount);
-		push("main", label, info, doneProgress + addProgress);
+		const auto progress = doneProgress + addProgress;
+		push(
+			"main",
+			label,
+			AppendTimeLeft(info, state.elapsed, progress),
+			progress);
 	};
 	const auto pushBytes = [&](const QString &id, const QString &label) {
 		if (!state.bytesCount) {
@@ -292,7 +292,7 @@ DeclareRefVar(base::Observable<void>, PhoneCallsEnabledChanged);
 typedef QMap<PeerId, MsgId> HiddenPinnedMessagesMap;
 DeclareVar(HiddenPinnedMessagesMap, HiddenPinnedMessages);
 
-typedef QMap<uint64, QPixmap> CircleMasksMap;
+typedef QMap<uint64, QImage> CircleMasksMap;
 DeclareRefVar(CircleMasksMap, CircleMasks);
 
 DeclareVar(bool, AskDownloadPath);
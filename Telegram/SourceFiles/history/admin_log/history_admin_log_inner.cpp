@@ -609,7 +609,12 @@ void InnerWidget::addEvents(Direction direction, const QVector<MTPChannelAdminLo
 	auto newItemsForDownDirection = std::vector<OwnedItem>();
 	auto oldItemsCount = _items.size();
 	auto &addToItems = (direction == Direction::Up) ? _items : newItemsForDownDirection;
-	addToItems.reserve(oldItemsCount + events.size() * 2);
+
+	// An exact reserve() for each page when loading up would reallocate
+	// and move all the loaded items every time, leave it to the vector.
+	if (direction == Direction::Down) {
+		addToItems.reserve(oldItemsCount + events.size() * 2);
+	}
 	for_const (auto &event, events) {
 		Assert(event.type() == mtpc_channelAdminLogEvent);
 		const auto &data = event.c_channelAdminLogEvent();
@@ -555,20 +555,32 @@ bool History::paintSendAction(
 
 bool History::updateSendActionNeedsAnimating(TimeMs ms, bool force) {
 	auto changed = force;
-	for (auto i = _typing.begin(), e = _typing.end(); i != e;) {
-		if (ms >= i.value()) {
-			i = _typing.erase(i);
-			changed = true;
-		} else {
-			++i;
+
+	// On most of the animation frames nothing has ended yet.
+	if (force || ms >= _sendActionsExpireAt) {
+		_sendActionsExpireAt = 0;
+		const auto expireAt = [&](TimeMs until) {
+			if (!_sendActionsExpireAt || _sendActionsExpireAt > until) {
+				_sendActionsExpireAt = until;
+			}
+		};
+		for (auto i = _typing.begin(), e = _typing.end(); i != e;) {
+			if (ms >= i.value()) {
+				i = _typing.erase(i);
+				changed = true;
+			} else {
+				expireAt(i.value());
+				++i;
+			}
 		}
-	}
-	for (auto i = _sendActions.begin(); i != _sendActions.cend();) {
-		if (ms >= i.value().until) {
-			i = _sendActions.erase(i);
-			changed = true;
-		} else {
-			++i;
+		for (auto i = _sendActions.begin(); i != _sendActions.cend();) {
+			if (ms >= i.value().until) {
+				i = _sendActions.erase(i);
+				changed = true;
+			} else {
+				expireAt(i.value().until);
+				++i;
+			}
 		}
 	}
 	if (changed) {
@@ -2263,6 +2275,9 @@ void History::applyDialog(const MTPDdialog &data) {
 		data.vread_inbox_max_id.v,
 		data.vread_outbox_max_id.v);
 	applyDialogTopMessage(data.vtop_message.v);
+	Auth().storage().validateSharedMediaCounts(
+		peer->id,
+		data.vtop_message.v);
 	setUnreadMark(data.is_unread_mark());
 	setUnreadMentionsCount(data.vunread_mentions_count.v);
 	if (const auto channel = peer->asChannel()) {
@@ -2420,7 +2435,10 @@ HistoryItem *History::lastSentMessage() const {
 	return nullptr;
 }
 
-void History::resizeToWidth(int newWidth) {
+void History::resizeToWidth(
+		int newWidth,
+		Element *anchor,
+		int preciseHeight) {
 	const auto resizeAllItems = (_width != newWidth);
 
 	if (!resizeAllItems && !hasPendingResizedItems()) {
@@ -2429,12 +2447,68 @@ void History::resizeToWidth(int newWidth) {
 	_flags &= ~(Flag::f_has_pending_resized_items);
 
 	_width = newWidth;
-	int y = 0;
-	for (const auto &block : blocks) {
+	if (blocks.empty()) {
+		_height = _preciseTop = _preciseBottom = 0;
+		return;
+	}
+	const auto count = int(blocks.size());
+	const auto layout = [&](int index) {
+		// Blocks that were last laid out for this width lay out only
+		// the changed views, even if the history width was different.
+		const auto block = blocks[index].get();
+		return block->resizeGetHeight(
+			newWidth,
+			(block->layoutWidth() != newWidth));
+	};
+
+	auto from = anchor ? anchor->block()->indexInHistory() : (count - 1);
+	auto till = from + 1;
+	auto preciseSum = layout(from);
+	auto preciseCount = int(blocks[from]->messages.size());
+	for (auto above = 0; from > 0 && above < preciseHeight;) {
+		const auto height = layout(--from);
+		above += height;
+		preciseSum += height;
+		preciseCount += blocks[from]->messages.size();
+	}
+	for (auto below = 0; till < count && below < preciseHeight;) {
+		const auto height = layout(till++);
+		below += height;
+		preciseSum += height;
+		preciseCount += blocks[till - 1]->messages.size();
+	}
+
+	// Until the far blocks are laid out their new views are supposed
+	// to be as high as the average view around the anchor.
+	const auto estimatedViewHeight = preciseCount
+		? (preciseSum / preciseCount)
+		: 0;
+	auto y = 0;
+	for (auto i = 0; i != count; ++i) {
+		const auto block = blocks[i].get();
 		block->setY(y);
-		y += block->resizeGetHeight(newWidth, resizeAllItems);
+		y += (i >= from && i < till)
+			? block->height()
+			: block->estimateGetHeight(newWidth, estimatedViewHeight);
 	}
 	_height = y;
+
+	// Far blocks that didn't change since their last layout are precise.
+	while (from > 0 && !blocks[from - 1]->estimated()) {
+		--from;
+	}
+	while (till < count && !blocks[till]->estimated()) {
+		++till;
+	}
+	_preciseTop = blocks[from]->y();
+	_preciseBottom = blocks[till - 1]->y() + blocks[till - 1]->height();
+}
+
+bool History::hasEstimatedHeightsIn(int top, int bottom) const {
+	if (bottom <= 0 || top >= _height) {
+		return false;
+	}
+	return (top < _preciseTop) || (bottom > _preciseBottom);
 }
 
 ChannelId History::channelId() const {
@@ -2793,6 +2867,12 @@ HistoryBlock::HistoryBlock(not_null<History*> history)
 }
 
 int HistoryBlock::resizeGetHeight(int newWidth, bool resizeAllItems) {
+	if (!resizeAllItems
+		&& !_hasPendingResizedItems
+		&& !_estimated
+		&& _heightWidth == newWidth) {
+		return _height;
+	}
 	auto y = 0;
 	for (const auto &message : messages) {
 		message->setY(y);
@@ -2803,6 +2883,27 @@ int HistoryBlock::resizeGetHeight(int newWidth, bool resizeAllItems) {
 		}
 	}
 	_height = y;
+	_heightWidth = _layoutWidth = newWidth;
+	_estimated = _hasPendingResizedItems = false;
+	return _height;
+}
+
+int HistoryBlock::estimateGetHeight(int newWidth, int estimatedViewHeight) {
+	_estimated = _hasPendingResizedItems || (_layoutWidth != newWidth);
+	if (_heightWidth == newWidth
+		&& (!_estimated || _estimatedViewHeight == estimatedViewHeight)
+		&& !_hasPendingResizedItems) {
+		return _height;
+	}
+	auto y = 0;
+	for (const auto &message : messages) {
+		message->setY(y);
+		const auto height = message->height();
+		y += height ? height : estimatedViewHeight;
+	}
+	_height = y;
+	_heightWidth = newWidth;
+	_estimatedViewHeight = estimatedViewHeight;
 	return _height;
 }
 
@@ -2816,6 +2917,7 @@ void HistoryBlock::remove(not_null<Element*> view) {
 	const auto item = view->data();
 	item->clearMainView();
 	messages.erase(messages.begin() + itemIndex);
+	setHasPendingResizedItems();
 	for (auto i = itemIndex, l = int(messages.size()); i < l; ++i) {
 		messages[i]->setIndexInBlock(i);
 	}
@@ -248,9 +248,19 @@ public:
 	MsgId msgIdForRead() const;
 	HistoryItem *lastSentMessage() const;
 
-	void resizeToWidth(int newWidth);
+	// Lays out precisely the blocks around the anchor view (the bottom
+	// of the history if it is nullptr) covering preciseHeight pixels in
+	// both directions. Other blocks get estimated heights without laying
+	// out their text, until they come close to the visible area.
+	void resizeToWidth(
+		int newWidth,
+		Element *anchor,
+		int preciseHeight);
 	int height() const;
 
+	// Whether some part of [top, bottom) has estimated heights.
+	bool hasEstimatedHeightsIn(int top, int bottom) const;
+
 	void itemRemoved(not_null<HistoryItem*> item);
 	void itemVanished(not_null<HistoryItem*> item);
 
@@ -264,6 +274,9 @@ public:
 
 	bool mySendActionUpdated(SendAction::Type type, bool doing);
 	bool paintSendAction(Painter &p, int x, int y, int availableWidth, int outerWidth, style::color color, TimeMs ms);
+	bool hasSendActionAnimation() const {
+		return _sendActionAnimation ? true : false;
+	}
 
 	// Interface for Histories
 	bool updateSendActionNeedsAnimating(TimeMs ms, bool force = false);
@@ -488,6 +501,8 @@ private:
 	bool _mute = false;
 	int _width = 0;
 	int _height = 0;
+	int _preciseTop = 0;
+	int _preciseBottom = 0;
 	Element *_unreadBarView = nullptr;
 	Element *_firstUnreadView = nullptr;
 	HistoryService *_joinedMessage = nullptr;
@@ -521,6 +536,7 @@ private:
 	TypingUsers _typing;
 	using SendActionUsers = QMap<UserData*, SendAction>;
 	SendActionUsers _sendActions;
+	TimeMs _sendActionsExpireAt = 0; // The nearest typing or action end.
 	QString _sendActionString;
 	Text _sendActionText;
 	Ui::SendActionAnimation _sendActionAnimation;
@@ -544,7 +560,26 @@ public:
 	void remove(not_null<Element*> view);
 	void refreshView(not_null<Element*> view);
 
+	// Walks the views only if some of them were changed after the last
+	// layout or the block height for this width was not computed yet.
 	int resizeGetHeight(int newWidth, bool resizeAllItems);
+
+	// Places the views using their last known heights, views that were
+	// never laid out count as estimatedViewHeight.
+	int estimateGetHeight(int newWidth, int estimatedViewHeight);
+	bool estimated() const {
+		return _estimated;
+	}
+	bool hasPendingResizedItems() const {
+		return _hasPendingResizedItems;
+	}
+	void setHasPendingResizedItems() {
+		_hasPendingResizedItems = true;
+	}
+	int layoutWidth() const {
+		return _layoutWidth;
+	}
+
 	int y() const {
 		return _y;
 	}
@@ -588,6 +623,11 @@ protected:
 
 	int _y = 0;
 	int _height = 0;
+	int _layoutWidth = 0;
+	int _heightWidth = 0;
+	int _estimatedViewHeight = 0;
 	int _indexInHistory = -1;
+	bool _estimated = true;
+	bool _hasPendingResizedItems = true;
 
 };
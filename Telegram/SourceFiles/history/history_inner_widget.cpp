@@ -11,6 +11,7 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 #include "styles/style_history.h"
 #include "core/file_utilities.h"
 #include "core/crash_reports.h"
+#include "core/scroll_benchmark.h"
 #include "history/history.h"
 #include "history/history_message.h"
 #include "history/history_media_types.h"
@@ -43,6 +44,15 @@ namespace {
 
 constexpr auto kScrollDateHideTimeout = 1000;
 
+// Messages are laid out precisely that many screens around the scroll
+// position, the precise layout is moved when scrolling comes closer
+// than one screen to its edge.
+constexpr auto kPreciseLayoutScreens = 3;
+
+// Starting with that many selected messages the copied text is composed
+// in the background, the main thread only gathers the message texts.
+constexpr auto kComposeSelectedAsyncCount = 100;
+
 // Helper binary search for an item in a list that is not completely
 // above the given top of the visible area or below the given bottom of the visible area
 // is applied once for blocks list in a history and once for items list in the found block.
@@ -527,6 +537,9 @@ void HistoryInner::paintEvent(QPaintEvent *e) {
 		return;
 	}
 
+	using namespace Core::ScrollBenchmark;
+	const auto benchmark = Scope(Phase::History, Kind::Paint);
+
 	Painter p(this);
 	auto clip = e->rect();
 	auto ms = getms();
@@ -1741,7 +1754,29 @@ void HistoryInner::showContextMenu(QContextMenuEvent *e, bool showFromTouch) {
 }
 
 void HistoryInner::copySelectedText() {
-	SetClipboardWithEntities(getSelectedText());
+	const auto selected = selectedForText();
+	if (selected.size() < kComposeSelectedAsyncCount
+		|| selected.cbegin()->second != FullSelection) {
+		_copySelectedGuard.kill();
+		SetClipboardWithEntities(getSelectedText());
+		return;
+	}
+	auto [left, right] = base::make_binary_guard();
+	_copySelectedGuard = std::move(left);
+	crl::async([
+		parts = collectSelectedText(selected),
+		guard = std::move(right)
+	]() mutable {
+		auto text = ComposeSelectedText(std::move(parts));
+		crl::on_main([
+			text = std::move(text),
+			guard = std::move(guard)
+		] {
+			if (guard.alive()) {
+				SetClipboardWithEntities(text);
+			}
+		});
+	});
 }
 
 void HistoryInner::savePhotoToFile(not_null<PhotoData*> photo) {
@@ -1828,13 +1863,23 @@ void HistoryInner::resizeEvent(QResizeEvent *e) {
 	mouseActionUpdate();
 }
 
-TextWithEntities HistoryInner::getSelectedText() const {
-	auto selected = _selected;
+struct HistoryInner::SelectedTextPart {
+	Data::MessagePosition position;
+	QString author;
+	QDateTime date;
+	TextWithEntities text;
+};
 
+auto HistoryInner::selectedForText() const -> SelectedItems {
+	auto selected = _selected;
 	if (_mouseAction == MouseAction::Selecting && _dragSelFrom && _dragSelTo) {
 		applyDragSelection(&selected);
 	}
+	return selected;
+}
 
+TextWithEntities HistoryInner::getSelectedText() const {
+	const auto selected = selectedForText();
 	if (selected.empty()) {
 		return TextWithEntities();
 	}
@@ -1845,25 +1890,23 @@ TextWithEntities HistoryInner::getSelectedText() const {
 		}
 		return TextWithEntities();
 	}
+	return ComposeSelectedText(collectSelectedText(selected));
+}
 
-	const auto timeFormat = qsl(", [dd.MM.yy hh:mm]\n");
+auto HistoryInner::collectSelectedText(const SelectedItems &selected) const
+-> std::vector<SelectedTextPart> {
 	auto groups = base::flat_set<not_null<const Data::Group*>>();
-	auto fullSize = 0;
-	auto texts = base::flat_map<Data::MessagePosition, TextWithEntities>();
+	auto result = std::vector<SelectedTextPart>();
+	result.reserve(selected.size());
 
 	const auto wrapItem = [&](
 			not_null<HistoryItem*> item,
-			TextWithEntities &&unwrapped) {
-		auto time = ItemDateTime(item).toString(timeFormat);
-		auto part = TextWithEntities();
-		auto size = item->author()->name.size()
-			+ time.size()
-			+ unwrapped.text.size();
-		part.text.reserve(size);
-		part.text.append(item->author()->name).append(time);
-		TextUtilities::Append(part, std::move(unwrapped));
-		texts.emplace(item->position(), part);
-		fullSize += size;
+			TextWithEntities &&text) {
+		result.push_back({
+			item->position(),
+			item->author()->name,
+			ItemDateTime(item),
+			std::move(text) });
 	};
 	const auto addItem = [&](not_null<HistoryItem*> item) {
 		wrapItem(item, HistoryItemText(item));
@@ -1889,15 +1932,37 @@ TextWithEntities HistoryInner::getSelectedText() const {
 			addItem(item);
 		}
 	}
+	return result;
+}
+
+TextWithEntities HistoryInner::ComposeSelectedText(
+		std::vector<SelectedTextPart> &&parts) {
+	if (parts.empty()) {
+		return TextWithEntities();
+	}
+	ranges::sort(parts, std::less<>(), &SelectedTextPart::position);
+
+	const auto timeFormat = qsl(", [dd.MM.yy hh:mm]\n");
+	const auto sep = qsl("\n\n");
+	auto times = std::vector<QString>();
+	times.reserve(parts.size());
+	auto fullSize = (int(parts.size()) - 1) * sep.size();
+	for (const auto &part : parts) {
+		times.push_back(part.date.toString(timeFormat));
+		fullSize += part.author.size()
+			+ times.back().size()
+			+ part.text.text.size();
+	}
 
 	auto result = TextWithEntities();
-	auto sep = qsl("\n\n");
-	result.text.reserve(fullSize + (texts.size() - 1) * sep.size());
-	for (auto i = texts.begin(), e = texts.end(); i != e;) {
-		TextUtilities::Append(result, std::move(i->second));
-		if (++i != e) {
+	result.text.reserve(fullSize);
+	for (auto i = 0, count = int(parts.size()); i != count; ++i) {
+		if (i) {
 			result.text.append(sep);
 		}
+		auto &part = parts[i];
+		result.text.append(part.author).append(times[i]);
+		TextUtilities::Append(result, std::move(part.text));
 	}
 	return result;
 }
@@ -1923,7 +1988,10 @@ void HistoryInner::keyPressEvent(QKeyEvent *e) {
 	}
 }
 
-void HistoryInner::recountHistoryGeometry() {
+void HistoryInner::recountHistoryGeometry(Element *initialAnchor) {
+	using namespace Core::ScrollBenchmark;
+	const auto benchmark = Scope(Phase::History, Kind::Layout);
+
 	_contentWidth = _scroll->width();
 
 	const auto visibleHeight = _scroll->height();
@@ -1932,9 +2000,26 @@ void HistoryInner::recountHistoryGeometry() {
 		accumulate_max(oldHistoryPaddingTop, st::msgMargin.top() + st::msgMargin.bottom() + st::msgPadding.top() + st::msgPadding.bottom() + st::msgNameFont->height + st::botDescSkip + _botAbout->height);
 	}
 
-	_history->resizeToWidth(_contentWidth);
+	const auto anchor = _history->scrollTopItem
+		? _history->scrollTopItem
+		: (_migrated && _migrated->scrollTopItem)
+		? _migrated->scrollTopItem
+		: initialAnchor;
+	const auto anchoredInMigrated = _migrated
+		&& anchor
+		&& (anchor->data()->history() == _migrated);
+	const auto historyAnchor = !anchoredInMigrated
+		? anchor
+		: _history->isEmpty()
+		? nullptr
+		: _history->blocks.front()->messages.front().get();
+	const auto preciseHeight = kPreciseLayoutScreens * visibleHeight;
+	_history->resizeToWidth(_contentWidth, historyAnchor, preciseHeight);
 	if (_migrated) {
-		_migrated->resizeToWidth(_contentWidth);
+		_migrated->resizeToWidth(
+			_contentWidth,
+			anchoredInMigrated ? anchor : nullptr,
+			preciseHeight);
 	}
 
 	// with migrated history we perhaps do not need to display first _history message
@@ -2074,6 +2159,11 @@ void HistoryInner::visibleAreaUpdated(int top, int bottom) {
 			}
 		}
 	}
+	if (preciseLayoutRequired()) {
+		// The scroll state is kept until the layout is refined.
+		_widget->refineHistoryLayout();
+		return;
+	}
 	if (scrolledUp) {
 		_scrollDateCheck.call();
 	} else {
@@ -2081,6 +2171,26 @@ void HistoryInner::visibleAreaUpdated(int top, int bottom) {
 	}
 }
 
+bool HistoryInner::preciseLayoutRequired() {
+	const auto margin = _visibleAreaBottom - _visibleAreaTop;
+	const auto top = _visibleAreaTop - margin;
+	const auto bottom = _visibleAreaBottom + margin;
+	auto result = false;
+	const auto check = [&](not_null<History*> history, int historyTop) {
+		if (historyTop >= 0 && history->hasEstimatedHeightsIn(
+				top - historyTop,
+				bottom - historyTop)) {
+			history->setHasPendingResizedItems();
+			result = true;
+		}
+	};
+	check(_history, historyTop());
+	if (_migrated) {
+		check(_migrated, migratedTop());
+	}
+	return result;
+}
+
 bool HistoryInner::displayScrollDate() const {
 	return (_visibleAreaTop <= height() - 2 * (_visibleAreaBottom - _visibleAreaTop));
 }
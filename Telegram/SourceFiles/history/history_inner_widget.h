@@ -8,6 +8,7 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 #pragma once
 
 #include "base/timer.h"
+#include "base/binary_guard.h"
 #include "ui/rp_widget.h"
 #include "ui/widgets/tooltip.h"
 #include "ui/widgets/scroll_area.h"
@@ -57,7 +58,8 @@ public:
 
 	void touchScrollUpdated(const QPoint &screenPos);
 
-	void recountHistoryGeometry();
+	// The anchor is used for the layout until a scroll state is counted.
+	void recountHistoryGeometry(Element *initialAnchor = nullptr);
 	void updateSize();
 
 	void repaintItem(const HistoryItem *item);
@@ -130,6 +132,7 @@ public slots:
 
 private:
 	class BotAbout;
+	struct SelectedTextPart;
 	using SelectedItems = std::map<HistoryItem*, TextSelection, std::less<>>;
 	enum class MouseAction {
 		None,
@@ -239,6 +242,7 @@ private:
 	void toggleScrollDateShown();
 	void repaintScrollDateCallback();
 	bool displayScrollDate() const;
+	bool preciseLayoutRequired();
 	void scrollDateHide();
 	void keepScrollDateForNow();
 
@@ -286,6 +290,11 @@ private:
 	void reportItem(FullMsgId itemId);
 	void reportAsGroup(FullMsgId itemId);
 	void copySelectedText();
+	SelectedItems selectedForText() const;
+	std::vector<SelectedTextPart> collectSelectedText(
+		const SelectedItems &selected) const;
+	static TextWithEntities ComposeSelectedText(
+		std::vector<SelectedTextPart> &&parts);
 
 	// Does any of the shown histories has this flag set.
 	bool hasPendingResizedItems() const;
@@ -315,6 +324,7 @@ private:
 
 	style::cursor _cursor = style::cur_default;
 	SelectedItems _selected;
+	base::binary_guard _copySelectedGuard;
 
 	MouseAction _mouseAction = MouseAction::None;
 	TextSelectType _mouseSelectType = TextSelectType::Letters;
@@ -10,6 +10,7 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 #include "base/runtime_composer.h"
 #include "base/flags.h"
 #include "base/value_ordering.h"
+#include "base/slab_allocator.h"
 
 enum class UnreadMentionType;
 struct HistoryMessageReplyMarkup;
@@ -265,6 +266,15 @@ public:
 
 	virtual ~HistoryItem();
 
+	// Items are created and destroyed in the main thread in large numbers,
+	// keep them close to each other in memory.
+	static void *operator new(std::size_t size) {
+		return base::main_slab_allocator().allocate(size);
+	}
+	static void operator delete(void *data) {
+		base::slab_allocator::deallocate(data);
+	}
+
 protected:
 	HistoryItem(
 		not_null<History*> history,
@@ -346,7 +346,6 @@ void HistoryPhoto::create(FullMsgId contextId, PeerData *chat) {
 		std::make_shared<PhotoOpenClickHandler>(_data, contextId, chat),
 		std::make_shared<PhotoSaveClickHandler>(_data, contextId, chat),
 		std::make_shared<PhotoCancelClickHandler>(_data, contextId, chat));
-	_data->thumb->load(contextId);
 }
 
 QSize HistoryPhoto::countOptimalSize() {
@@ -435,6 +434,7 @@ QSize HistoryPhoto::countCurrentSize(int newWidth) {
 void HistoryPhoto::draw(Painter &p, const QRect &r, TextSelection selection, TimeMs ms) const {
 	if (width() < st::msgPadding.left() + st::msgPadding.right() + 1) return;
 
+	_data->thumb->load(_realParent->fullId());
 	_data->automaticLoad(_realParent->fullId(), _parent->data());
 	auto selected = (selection == FullSelection);
 	auto loaded = _data->loaded();
@@ -618,6 +618,7 @@ void HistoryPhoto::drawGrouped(
 		RectParts corners,
 		not_null<uint64*> cacheKey,
 		not_null<QPixmap*> cache) const {
+	_data->thumb->load(_realParent->fullId());
 	_data->automaticLoad(_realParent->fullId(), _parent->data());
 
 	validateGroupedCache(geometry, corners, cacheKey, cache);
@@ -826,8 +827,6 @@ HistoryVideo::HistoryVideo(
 	setDocumentLinks(_data, realParent);
 
 	setStatusSize(FileStatusSizeReady);
-
-	_data->thumb->load(realParent->fullId());
 }
 
 QSize HistoryVideo::countOptimalSize() {
@@ -910,6 +909,7 @@ QSize HistoryVideo::countCurrentSize(int newWidth) {
 void HistoryVideo::draw(Painter &p, const QRect &r, TextSelection selection, TimeMs ms) const {
 	if (width() < st::msgPadding.left() + st::msgPadding.right() + 1) return;
 
+	_data->thumb->load(_realParent->fullId());
 	_data->automaticLoad(_realParent->fullId(), _parent->data());
 	bool loaded = _data->loaded(), displayLoading = _data->displayLoading();
 	bool selected = (selection == FullSelection);
@@ -1092,6 +1092,7 @@ void HistoryVideo::drawGrouped(
 		RectParts corners,
 		not_null<uint64*> cacheKey,
 		not_null<QPixmap*> cache) const {
+	_data->thumb->load(_realParent->fullId());
 	_data->automaticLoad(_realParent->fullId(), _parent->data());
 
 	validateGroupedCache(geometry, corners, cacheKey, cache);
@@ -1395,7 +1396,6 @@ QSize HistoryDocument::countOptimalSize() {
 	}
 	auto thumbed = Get<HistoryDocumentThumbed>();
 	if (thumbed) {
-		_data->thumb->load(_realParent->fullId());
 		auto tw = ConvertScale(_data->thumb->width());
 		auto th = ConvertScale(_data->thumb->height());
 		if (tw > th) {
@@ -1480,6 +1480,9 @@ QSize HistoryDocument::countCurrentSize(int newWidth) {
 void HistoryDocument::draw(Painter &p, const QRect &r, TextSelection selection, TimeMs ms) const {
 	if (width() < st::msgPadding.left() + st::msgPadding.right() + 1) return;
 
+	if (Has<HistoryDocumentThumbed>()) {
+		_data->thumb->load(_realParent->fullId());
+	}
 	_data->automaticLoad(_realParent->fullId(), _parent->data());
 	bool loaded = _data->loaded(), displayLoading = _data->displayLoading();
 	bool selected = (selection == FullSelection);
@@ -2043,7 +2046,6 @@ HistoryGif::HistoryGif(
 	setStatusSize(FileStatusSizeReady);
 
 	_caption = createCaption(item);
-	_data->thumb->load(item->fullId());
 }
 
 QSize HistoryGif::countOptimalSize() {
@@ -2227,6 +2229,7 @@ void HistoryGif::draw(Painter &p, const QRect &r, TextSelection selection, TimeM
 	if (width() < st::msgPadding.left() + st::msgPadding.right() + 1) return;
 
 	const auto item = _parent->data();
+	_data->thumb->load(_realParent->fullId());
 	_data->automaticLoad(_realParent->fullId(), item);
 	auto loaded = _data->loaded();
 	auto displayLoading = (item->id < 0) || _data->displayLoading();
@@ -2912,7 +2915,6 @@ HistorySticker::HistorySticker(
 : HistoryMedia(parent)
 , _data(document)
 , _emoji(_data->sticker()->alt) {
-	_data->thumb->load(parent->data()->fullId());
 	if (auto emoji = Ui::Emoji::Find(_emoji)) {
 		_emoji = emoji->text();
 	}
@@ -2979,7 +2981,8 @@ void HistorySticker::draw(Painter &p, const QRect &r, TextSelection selection, T
 
 	if (width() < st::msgPadding.left() + st::msgPadding.right() + 1) return;
 
-	_data->checkSticker();
+	_data->thumb->load(_parent->data()->fullId());
+	_data->checkStickerAsync();
 	bool loaded = _data->loaded();
 	bool selected = (selection == FullSelection);
 
@@ -3003,7 +3006,7 @@ void HistorySticker::draw(Painter &p, const QRect &r, TextSelection selection, T
 		const auto w = _pixw;
 		const auto h = _pixh;
 		const auto &c = st::msgStickerOverlay;
-		if (const auto image = _data->getStickerImage()) {
+		if (const auto image = sticker->image.get()) {
 			return selected
 				? image->pixColored(o, c, w, h)
 				: image->pix(o, w, h);
@@ -29,6 +29,7 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 #include "observer_peer.h"
 #include "storage/storage_shared_media.h"
 #include "data/data_session.h"
+#include "data/data_search_index.h"
 #include "data/data_media_types.h"
 #include "styles/style_dialogs.h"
 #include "styles/style_widgets.h"
@@ -998,6 +999,9 @@ void HistoryMessage::setText(const TextWithEntities &textWithEntities) {
 		_textWidth = -1;
 		_textHeight = 0;
 	}
+	if (const auto index = Auth().data().searchIndex()) {
+		index->add(this, textWithEntities.text);
+	}
 }
 
 void HistoryMessage::setEmptyText() {
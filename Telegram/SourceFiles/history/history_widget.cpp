@@ -12,6 +12,7 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 #include "boxes/share_box.h"
 #include "boxes/edit_caption_box.h"
 #include "core/file_utilities.h"
+#include "core/scroll_benchmark.h"
 #include "ui/toast/toast.h"
 #include "ui/special_buttons.h"
 #include "ui/emoji_config.h"
@@ -27,6 +28,7 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 #include "data/data_drafts.h"
 #include "data/data_session.h"
 #include "data/data_media_types.h"
+#include "data/data_lazy_messages.h"
 #include "history/history.h"
 #include "history/history_item.h"
 #include "history/history_message.h"
@@ -487,6 +489,7 @@ HistoryWidget::HistoryWidget(
 	connect(Media::Capture::instance(), SIGNAL(error()), this, SLOT(onRecordError()));
 	connect(Media::Capture::instance(), SIGNAL(updated(quint16,qint32)), this, SLOT(onRecordUpdate(quint16,qint32)));
 	connect(Media::Capture::instance(), SIGNAL(done(QByteArray,VoiceWaveform,qint32)), this, SLOT(onRecordDone(QByteArray,VoiceWaveform,qint32)));
+	connect(Media::Capture::instance(), SIGNAL(encoded(QByteArray)), this, SLOT(onRecordEncoded(QByteArray)));
 
 	_attachToggle->setClickedCallback(App::LambdaDelayed(st::historyAttach.ripple.hideDuration, this, [this] {
 		chooseAttach();
@@ -1462,13 +1465,28 @@ void HistoryWidget::onRecordDone(
 		QByteArray result,
 		VoiceWaveform waveform,
 		qint32 samples) {
-	if (!canWriteMessage() || result.isEmpty()) return;
+	const auto uploadId = base::take(_recordingUploadId);
+	if (!canWriteMessage() || result.isEmpty()) {
+		Auth().uploader().cancelAhead(uploadId);
+		return;
+	}
 
 	ActivateWindowDelayed(controller());
 	const auto duration = samples / Media::Player::kDefaultFrequency;
 	auto options = ApiWrap::SendOptions(_history);
 	options.replyTo = replyToId();
-	Auth().api().sendVoiceMessage(result, waveform, duration, options);
+	Auth().api().sendVoiceMessage(
+		result,
+		waveform,
+		duration,
+		options,
+		uploadId);
+}
+
+void HistoryWidget::onRecordEncoded(QByteArray part) {
+	if (_recordingUploadId) {
+		Auth().uploader().uploadAheadPart(_recordingUploadId, part);
+	}
 }
 
 void HistoryWidget::onRecordUpdate(quint16 level, qint32 samples) {
@@ -1926,6 +1944,10 @@ void HistoryWidget::showHistory(const PeerId &peerId, MsgId showAtMsgId, bool re
 
 		_history = App::history(_peer);
 		_migrated = _history->migrateFrom();
+		if (_migrated) {
+			Auth().data().markHistoryViewed(_migrated);
+		}
+		Auth().data().markHistoryViewed(_history);
 
 		_topBar->setActiveChat(_history);
 		updateTopBarSelection();
@@ -2496,7 +2518,11 @@ bool HistoryWidget::messagesFailed(const RPCError &error, mtpRequestId requestId
 	return true;
 }
 
-void HistoryWidget::messagesReceived(PeerData *peer, const MTPmessages_Messages &messages, mtpRequestId requestId) {
+void HistoryWidget::messagesReceived(
+		PeerData *peer,
+		const mtpPrime *from,
+		const mtpPrime *end,
+		mtpRequestId requestId) {
 	if (!_history) {
 		_preloadRequest = _preloadDownRequest = _firstLoadRequest = _delayedShowAtRequest = 0;
 		return;
@@ -2508,45 +2534,37 @@ void HistoryWidget::messagesReceived(PeerData *peer, const MTPmessages_Messages
 		return;
 	}
 
-	auto count = 0;
-	const QVector<MTPMessage> emptyList, *histList = &emptyList;
-	switch (messages.type()) {
-	case mtpc_messages_messages: {
-		auto &d(messages.c_messages_messages());
-		App::feedUsers(d.vusers);
-		App::feedChats(d.vchats);
-		histList = &d.vmessages.v;
-		count = histList->size();
-	} break;
+	// Messages are parsed only when they are added to the history, so that
+	// the already loaded ones can skip most of the parsing.
+	const auto slice = Data::ReadLazyMessagesSlice(from, end);
+	auto count = slice.count;
+	switch (slice.type) {
+	case mtpc_messages_messages:
 	case mtpc_messages_messagesSlice: {
-		auto &d(messages.c_messages_messagesSlice());
-		App::feedUsers(d.vusers);
-		App::feedChats(d.vchats);
-		histList = &d.vmessages.v;
-		count = d.vcount.v;
+		App::feedUsers(slice.users);
+		App::feedChats(slice.chats);
 	} break;
 	case mtpc_messages_channelMessages: {
-		auto &d(messages.c_messages_channelMessages());
 		if (peer && peer->isChannel()) {
-			peer->asChannel()->ptsReceived(d.vpts.v);
+			peer->asChannel()->ptsReceived(slice.pts);
 		} else {
 			LOG(("API Error: received messages.channelMessages when no channel was passed! (HistoryWidget::messagesReceived)"));
 		}
-		App::feedUsers(d.vusers);
-		App::feedChats(d.vchats);
-		histList = &d.vmessages.v;
-		count = d.vcount.v;
+		App::feedUsers(slice.users);
+		App::feedChats(slice.chats);
 	} break;
 	case mtpc_messages_messagesNotModified: {
 		LOG(("API Error: received messages.messagesNotModified! (HistoryWidget::messagesReceived)"));
+		count = 0;
 	} break;
 	}
 
-	const auto ExtractFirstId = [&] {
-		return histList->empty() ? -1 : idFromMessage(histList->front());
-	};
-	const auto ExtractLastId = [&] {
-		return histList->empty() ? -1 : idFromMessage(histList->back());
+	// Parse after unloading the blocks, that can destroy existing items.
+	const auto histList = [&] {
+		const auto channelId = peer->isChannel()
+			? peerToChannel(peer->id)
+			: NoChannel;
+		return Data::ParseLazyMessages(slice.messages, channelId);
 	};
 	const auto PeerString = [](PeerId peerId) {
 		if (peerIsUser(peerId)) {
@@ -2561,7 +2579,7 @@ void HistoryWidget::messagesReceived(PeerData *peer, const MTPmessages_Messages
 
 	if (_preloadRequest == requestId) {
 		auto to = toMigrated ? _migrated : _history;
-		addMessagesToFront(peer, *histList);
+		addMessagesToFront(peer, histList());
 		_preloadRequest = 0;
 		preloadHistoryIfNeeded();
 		if (_reportSpamStatus == dbiprsUnknown) {
@@ -2570,7 +2588,7 @@ void HistoryWidget::messagesReceived(PeerData *peer, const MTPmessages_Messages
 		}
 	} else if (_preloadDownRequest == requestId) {
 		auto to = toMigrated ? _migrated : _history;
-		addMessagesToBack(peer, *histList);
+		addMessagesToBack(peer, histList());
 		_preloadDownRequest = 0;
 		preloadHistoryIfNeeded();
 		if (_history->loadedAtBottom() && App::wnd()) App::wnd()->checkHistoryActivation();
@@ -2580,7 +2598,7 @@ void HistoryWidget::messagesReceived(PeerData *peer, const MTPmessages_Messages
 		} else if (_migrated) {
 			_migrated->unloadBlocks();
 		}
-		addMessagesToFront(peer, *histList);
+		addMessagesToFront(peer, histList());
 		_firstLoadRequest = 0;
 		if (_history->loadedAtTop() && _history->isEmpty() && count > 0) {
 			firstLoadMessages();
@@ -2603,7 +2621,7 @@ void HistoryWidget::messagesReceived(PeerData *peer, const MTPmessages_Messages
 			if (_firstLoadRequest) MTP::cancel(_firstLoadRequest);
 			_preloadRequest = _preloadDownRequest = 0;
 			_firstLoadRequest = -1; // hack - don't updateListSize yet
-			addMessagesToFront(peer, *histList);
+			addMessagesToFront(peer, histList());
 			_firstLoadRequest = 0;
 			if (_history->loadedAtTop()
 				&& _history->isEmpty()
@@ -2631,6 +2649,13 @@ void HistoryWidget::messagesReceived(PeerData *peer, const MTPmessages_Messages
 	}
 }
 
+void HistoryWidget::replayScrollBenchmark(Fn<void()> done) {
+	Core::ScrollBenchmark::Replay(
+		_scroll.data(),
+		Core::ScrollBenchmark::Phase::History,
+		std::move(done));
+}
+
 void HistoryWidget::historyLoaded() {
 	countHistoryShowFrom();
 	destroyUnreadBar();
@@ -3452,6 +3477,10 @@ void HistoryWidget::recordStartCallback() {
 		}
 	}
 
+	if (_recordingUploadId) {
+		Auth().uploader().cancelAhead(_recordingUploadId);
+	}
+	_recordingUploadId = rand_value<uint64>();
 	emit Media::Capture::instance()->start();
 
 	_recording = _inField = true;
@@ -3487,6 +3516,9 @@ void HistoryWidget::mouseReleaseEvent(QMouseEvent *e) {
 
 void HistoryWidget::stopRecording(bool send) {
 	emit Media::Capture::instance()->stop(send);
+	if (!send && _recordingUploadId) {
+		Auth().uploader().cancelAhead(base::take(_recordingUploadId));
+	}
 
 	a_recordingLevel = anim::value();
 	_a_recording.stop();
@@ -4842,11 +4874,13 @@ QPixmap HistoryWidget::grabForShowAnimation(
 	if (params.withTopBarShadow) {
 		_topShadow->hide();
 	}
+	// Only the top shadow geometry depends on _inGrab, so there is no
+	// need to relayout the whole history around the grab.
 	_inGrab = true;
-	updateControlsGeometry();
+	updateTopShadowGeometry();
 	auto result = Ui::GrabWidget(this);
 	_inGrab = false;
-	updateControlsGeometry();
+	updateTopShadowGeometry();
 	if (params.withTopBarShadow) {
 		_topShadow->show();
 	}
@@ -4863,6 +4897,13 @@ bool HistoryWidget::skipItemRepaint() {
 	return true;
 }
 
+void HistoryWidget::refineHistoryLayout() {
+	// Relayout keeps the scroll position by the top visible item.
+	crl::on_main(this, [=] {
+		handlePendingHistoryUpdate();
+	});
+}
+
 void HistoryWidget::onUpdateHistoryItems() {
 	if (!_list) return;
 
@@ -4941,6 +4982,10 @@ void HistoryWidget::updateControlsGeometry() {
 	break;
 	}
 
+	updateTopShadowGeometry();
+}
+
+void HistoryWidget::updateTopShadowGeometry() {
 	auto topShadowLeft = (Adaptive::OneColumn() || _inGrab) ? 0 : st::lineWidth;
 	auto topShadowRight = (Adaptive::ThreeColumn() && !_inGrab && _peer) ? st::lineWidth : 0;
 	_topShadow->setGeometryToLeft(
@@ -5108,7 +5153,7 @@ void HistoryWidget::updateHistoryGeometry(bool initial, bool loadedDown, const S
 		controller()->floatPlayerAreaUpdated().notify(true);
 	}
 
-	updateListSize();
+	updateListSize(initial ? initialLayoutAnchor() : nullptr);
 	_updateHistoryGeometryRequired = false;
 
 	if ((!initial && !wasAtBottom)
@@ -5160,8 +5205,23 @@ void HistoryWidget::updateHistoryGeometry(bool initial, bool loadedDown, const S
 	}
 }
 
-void HistoryWidget::updateListSize() {
-	_list->recountHistoryGeometry();
+HistoryView::Element *HistoryWidget::initialLayoutAnchor() const {
+	if (_showAtMsgId
+		&& (_showAtMsgId > 0 || -_showAtMsgId < ServerMaxMsgId)) {
+		if (const auto item = getItemFromHistoryOrMigrated(_showAtMsgId)) {
+			return item->mainView();
+		}
+	}
+	if (const auto bar = _migrated ? _migrated->unreadBar() : nullptr) {
+		return bar;
+	} else if (const auto bar = _history->unreadBar()) {
+		return bar;
+	}
+	return firstUnreadMessage();
+}
+
+void HistoryWidget::updateListSize(HistoryView::Element *initialAnchor) {
+	_list->recountHistoryGeometry(initialAnchor);
 	auto washidden = _scroll->isHidden();
 	if (washidden) {
 		_scroll->show();
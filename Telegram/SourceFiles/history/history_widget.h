@@ -191,13 +191,21 @@ public:
 
 	void start();
 
-	void messagesReceived(PeerData *peer, const MTPmessages_Messages &messages, mtpRequestId requestId);
+	void messagesReceived(
+		PeerData *peer,
+		const mtpPrime *from,
+		const mtpPrime *end,
+		mtpRequestId requestId);
 	void historyLoaded();
 
 	void windowShown();
 	bool doWeReadServerHistory() const;
 	bool doWeReadMentions() const;
 	bool skipItemRepaint();
+	void refineHistoryLayout();
+
+	// Scrolls the shown history by the benchmark mode script.
+	void replayScrollBenchmark(Fn<void()> done);
 
 	void leaveToChildEvent(QEvent *e, QWidget *child) override;
 	void dragEnterEvent(QDragEnterEvent *e) override;
@@ -416,6 +424,7 @@ public slots:
 	void onRecordError();
 	void onRecordDone(QByteArray result, VoiceWaveform waveform, qint32 samples);
 	void onRecordUpdate(quint16 level, qint32 samples);
+	void onRecordEncoded(QByteArray part);
 
 	void onUpdateHistoryItems();
 
@@ -685,7 +694,9 @@ private:
 		int value;
 	};
 	void updateHistoryGeometry(bool initial = false, bool loadedDown = false, const ScrollChange &change = { ScrollChangeNone, 0 });
-	void updateListSize();
+	void updateTopShadowGeometry();
+	void updateListSize(HistoryView::Element *initialAnchor = nullptr);
+	HistoryView::Element *initialLayoutAnchor() const;
 
 	// Does any of the shown histories has this flag set.
 	bool hasPendingResizedItems() const;
@@ -831,6 +842,7 @@ private:
 	bool _cmdStartShown = false;
 	object_ptr<Ui::InputField> _field;
 	bool _recording = false;
+	uint64 _recordingUploadId = 0;
 	bool _inField = false;
 	bool _inReplyEditForward = false;
 	bool _inPinnedMsg = false;
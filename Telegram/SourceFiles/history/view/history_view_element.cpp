@@ -215,6 +215,9 @@ void Element::setPendingResize() {
 	_flags |= Flag::NeedsResize;
 	if (_context == Context::History) {
 		data()->_history->setHasPendingResizedItems();
+		if (_block) {
+			_block->setHasPendingResizedItems();
+		}
 	}
 }
 
@@ -521,6 +524,7 @@ void Element::attachToBlock(not_null<HistoryBlock*> block, int index) {
 	_block = block;
 	_indexInBlock = index;
 	_data->setMainView(this);
+	_block->setHasPendingResizedItems();
 	previousInBlocksChanged();
 }
 
@@ -10,6 +10,7 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 #include "history/view/history_view_object.h"
 #include "base/runtime_composer.h"
 #include "base/flags.h"
+#include "base/slab_allocator.h"
 
 class HistoryBlock;
 class HistoryItem;
@@ -246,6 +247,13 @@ public:
 
 	virtual ~Element();
 
+	static void *operator new(std::size_t size) {
+		return base::main_slab_allocator().allocate(size);
+	}
+	static void operator delete(void *data) {
+		base::slab_allocator::deallocate(data);
+	}
+
 protected:
 	void paintHighlight(
 		Painter &p,
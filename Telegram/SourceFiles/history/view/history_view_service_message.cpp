@@ -180,9 +180,17 @@ int WideChatWidth() {
 }
 
 void ServiceMessagePainter::paintDate(Painter &p, const QDateTime &date, int y, int w) {
-	auto dateText = langDayOfMonthFull(date.date());
-	auto dateTextWidth = st::msgServiceFont->width(dateText);
-	paintPreparedDate(p, dateText, dateTextWidth, y, w);
+	// The floating date is painted with the same date on each scroll step.
+	static auto LastDate = QDate();
+	static auto LastText = QString();
+	static auto LastTextWidth = 0;
+
+	if (LastDate != date.date() || LastText.isEmpty()) {
+		LastDate = date.date();
+		LastText = langDayOfMonthFull(LastDate);
+		LastTextWidth = st::msgServiceFont->width(LastText);
+	}
+	paintPreparedDate(p, LastText, LastTextWidth, y, w);
 }
 
 void ServiceMessagePainter::paintDate(Painter &p, const QString &dateText, int dateTextWidth, int y, int w) {
@@ -44,6 +44,9 @@ constexpr auto kPreloadedScreensCountFull
 	= kPreloadedScreensCount + 1 + kPreloadedScreensCount;
 constexpr auto kMediaCountForSearch = 10;
 
+// Pixmaps of the items farther from the viewport than that are dropped.
+constexpr auto kHeavyPartScreensCount = 2;
+
 UniversalMsgId GetUniversalId(FullMsgId itemId) {
 	return (itemId.channel != 0)
 		? UniversalMsgId(itemId.msg)
@@ -65,6 +68,7 @@ struct ListWidget::Context {
 	not_null<SelectedMap*> selected;
 	not_null<SelectedMap*> dragSelected;
 	DragSelectAction dragSelectAction;
+	not_null<base::flat_set<not_null<BaseLayout*>>*> heavyLayouts;
 };
 
 class ListWidget::Section {
@@ -398,6 +402,7 @@ void ListWidget::Section::paint(
 				itemSelection(item, context),
 				&localContext);
 			p.translate(-rect.topLeft());
+			context.heavyLayouts->emplace(item);
 		}
 	}
 }
@@ -501,22 +506,21 @@ int ListWidget::Section::recountHeight() const {
 	case Type::Photo:
 	case Type::Video:
 	case Type::RoundFile: {
-		auto itemHeight = _itemWidth + st::infoMediaSkip;
+		// All the grid items have the same size, so the height depends
+		// only on the items count and the positions follow the indices.
+		const auto itemHeight = _itemWidth + st::infoMediaSkip;
+		const auto count = int(_items.size());
+		const auto itemsTop = result + _itemsTop;
 		auto index = 0;
-		result += _itemsTop;
 		for (auto &item : _items) {
-			item.second->setPosition(_itemsInRow * result + index);
-			if (++index == _itemsInRow) {
-				result += itemHeight;
-				index = 0;
-			}
-		}
-		if (_items.size() % _itemsInRow) {
-			_rowsCount = int(_items.size()) / _itemsInRow + 1;
-			result += itemHeight;
-		} else {
-			_rowsCount = int(_items.size()) / _itemsInRow;
-		}
+			const auto row = index / _itemsInRow;
+			const auto top = itemsTop + row * itemHeight;
+			item.second->setPosition(
+				_itemsInRow * top + (index % _itemsInRow));
+			++index;
+		}
+		_rowsCount = (count + _itemsInRow - 1) / _itemsInRow;
+		result = itemsTop + _rowsCount * itemHeight;
 	} break;
 
 	case Type::RoundVoiceFile:
@@ -607,6 +611,7 @@ void ListWidget::restart() {
 
 	_overLayout = nullptr;
 	_sections.clear();
+	_heavyLayouts.clear();
 	_layouts.clear();
 
 	_universalAroundId = kDefaultAroundId;
@@ -635,6 +640,9 @@ void ListWidget::itemRemoved(not_null<const HistoryItem*> item) {
 			_overLayout = nullptr;
 		}
 
+		if (const auto layout = getExistingLayout(universalId)) {
+			_heavyLayouts.remove(layout);
+		}
 		_layouts.erase(universalId);
 		_dragSelected.remove(universalId);
 
@@ -1015,6 +1023,29 @@ void ListWidget::visibleTopBottomUpdated(
 	_visibleBottom = visibleBottom;
 
 	checkMoveToOtherViewer();
+	clearHeavyItems();
+}
+
+void ListWidget::clearHeavyItems() {
+	const auto visibleHeight = (_visibleBottom - _visibleTop);
+	if (visibleHeight <= 0) {
+		return;
+	}
+	const auto from = _visibleTop - kHeavyPartScreensCount * visibleHeight;
+	const auto till = _visibleBottom
+		+ kHeavyPartScreensCount * visibleHeight;
+	for (auto i = _heavyLayouts.begin(); i != _heavyLayouts.end();) {
+		const auto layout = i->get();
+		const auto found = findItemDetails(layout);
+		if (found
+			&& found->geometry.y() + found->geometry.height() > from
+			&& found->geometry.y() < till) {
+			++i;
+		} else {
+			layout->clearHeavyPart();
+			i = _heavyLayouts.erase(i);
+		}
+	}
 }
 
 void ListWidget::checkMoveToOtherViewer() {
@@ -1128,7 +1159,8 @@ void ListWidget::paintEvent(QPaintEvent *e) {
 		Layout::PaintContext(ms, hasSelectedItems()),
 		&_selected,
 		&_dragSelected,
-		_dragSelectAction
+		_dragSelectAction,
+		&_heavyLayouts
 	};
 	for (auto it = fromSectionIt; it != tillSectionIt; ++it) {
 		auto top = it->top();
@@ -1136,6 +1168,9 @@ void ListWidget::paintEvent(QPaintEvent *e) {
 		it->paint(p, context, clip.translated(0, -top), outerWidth);
 		p.translate(0, -top);
 	}
+
+	// Read all the thumbnails requested while painting in one batch.
+	Auth().downloader().sendLocalRequests();
 }
 
 void ListWidget::mousePressEvent(QMouseEvent *e) {
@@ -2083,6 +2118,7 @@ void ListWidget::clearStaleLayouts() {
 			if (i->second.item.get() == _overLayout) {
 				_overLayout = nullptr;
 			}
+			_heavyLayouts.remove(i->second.item.get());
 			i = _layouts.erase(i);
 		} else {
 			++i;
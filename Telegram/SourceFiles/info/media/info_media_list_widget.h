@@ -263,6 +263,7 @@ private:
 	void switchToWordSelection();
 	void validateTrippleClickStartTime();
 	void checkMoveToOtherViewer();
+	void clearHeavyItems();
 
 	void setActionBoxWeak(QPointer<Ui::RpWidget> box);
 
@@ -279,6 +280,7 @@ private:
 
 	std::map<UniversalMsgId, CachedItem> _layouts;
 	std::vector<Section> _sections;
+	base::flat_set<not_null<BaseLayout*>> _heavyLayouts;
 
 	int _visibleTop = 0;
 	int _visibleBottom = 0;
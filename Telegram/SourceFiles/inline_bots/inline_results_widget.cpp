@@ -37,6 +37,10 @@ namespace {
 
 constexpr auto kInlineBotRequestDelay = 400;
 
+// Thumbnails are loaded for the rows that are at most that many visible
+// heights away from the visible area.
+constexpr auto kPreloadScreens = 1;
+
 } // namespace
 
 Inner::Inner(QWidget *parent, not_null<Window::Controller*> controller) : TWidget(parent)
@@ -79,6 +83,7 @@ void Inner::visibleTopBottomUpdated(
 		_visibleTop = visibleTop;
 		_lastScrolled = getms();
 	}
+	preloadImages();
 }
 
 void Inner::checkRestrictedPeer() {
@@ -289,7 +294,6 @@ bool Inner::inlineRowsAddItem(Result *result, Row &row, int32 &sumWidth) {
 	auto layout = layoutPrepareInlineResult(result, (_rows.size() * MatrixRowShift) + row.items.size());
 	if (!layout) return false;
 
-	layout->preload();
 	if (inlineRowFinalize(row, sumWidth, layout->isFullLine())) {
 		layout->setPosition(_rows.size() * MatrixRowShift);
 	}
@@ -402,11 +406,42 @@ Inner::Row &Inner::layoutInlineRow(Row &row, int32 sumWidth) {
 }
 
 void Inner::preloadImages() {
+	const auto visibleHeight = (_visibleBottom > _visibleTop)
+		? (_visibleBottom - _visibleTop)
+		: int(st::emojiPanMaxHeight);
+	const auto preloadTop = _visibleTop - kPreloadScreens * visibleHeight;
+	const auto preloadBottom = _visibleTop
+		+ (kPreloadScreens + 1) * visibleHeight;
+
+	auto top = st::stickerPanPadding;
+	if (_switchPmButton) {
+		top += _switchPmButton->height() + st::inlineResultsSkip;
+	}
 	for (auto row = 0, rows = _rows.size(); row != rows; ++row) {
-		for (auto col = 0, cols = _rows[row].items.size(); col != cols; ++col) {
-			_rows[row].items[col]->preload();
+		if (top >= preloadBottom) {
+			break;
+		}
+		const auto &inlineRow = _rows[row];
+		if (top + inlineRow.height > preloadTop) {
+			for (const auto item : inlineRow.items) {
+				item->preload();
+			}
 		}
+		top += inlineRow.height;
+	}
+}
+
+bool Inner::forgetResults(const Results &results) {
+	for (const auto &result : results) {
+		const auto i = _inlineLayouts.find(result.get());
+		if (i != _inlineLayouts.end() && i->second->position() >= 0) {
+			return false;
+		}
+	}
+	for (const auto &result : results) {
+		_inlineLayouts.erase(result.get());
 	}
+	return true;
 }
 
 void Inner::hideInlineRowsPanel() {
@@ -487,6 +522,7 @@ int Inner::refreshInlineRows(PeerData *queryPeer, UserData *bot, const CacheEntr
 	auto h = countHeight();
 	if (h != height()) resize(width(), h);
 	update();
+	preloadImages();
 
 	_lastMousePos = QCursor::pos();
 	updateSelected();
@@ -1032,6 +1068,7 @@ void Widget::inlineResultsDone(const MTPmessages_BotResults &result) {
 		}
 		auto entry = it->second.get();
 		entry->nextOffset = qs(d.vnext_offset);
+		entry->expires = getms() + d.vcache_time.v * TimeMs(1000);
 		if (d.has_switch_pm() && d.vswitch_pm.type() == mtpc_inlineBotSwitchPM) {
 			auto &switchPm = d.vswitch_pm.c_inlineBotSwitchPM();
 			entry->switchPmText = qs(switchPm.vtext);
@@ -1077,7 +1114,14 @@ void Widget::queryInlineBot(UserData *bot, PeerData *peer, QString query) {
 			_inlineRequestId = 0;
 			Notify::inlineBotRequesting(false);
 		}
-		if (_inlineCache.find(query) != _inlineCache.cend()) {
+		auto it = _inlineCache.find(query);
+		if (it != _inlineCache.cend()
+			&& it->second->expires <= getms()
+			&& _inner->forgetResults(it->second->results)) {
+			_inlineCache.erase(it);
+			it = _inlineCache.end();
+		}
+		if (it != _inlineCache.cend()) {
 			_inlineRequestTimer.stop();
 			_inlineQuery = _inlineNextQuery = query;
 			showInlineRows(true);
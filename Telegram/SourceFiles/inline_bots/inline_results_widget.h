@@ -44,6 +44,7 @@ struct CacheEntry {
 	QString nextOffset;
 	QString switchPmText, switchPmStartToken;
 	Results results;
+	TimeMs expires = 0;
 };
 
 class Inner : public TWidget, public Context, private base::Subscriber {
@@ -63,6 +64,9 @@ public:
 
 	void preloadImages();
 
+	// Destroys the layouts of the results if none of them is shown.
+	bool forgetResults(const Results &results);
+
 	void inlineItemLayoutChanged(const ItemBase *layout) override;
 	void inlineItemRepaint(const ItemBase *layout) override;
 	bool inlineItemVisible(const ItemBase *layout) override;
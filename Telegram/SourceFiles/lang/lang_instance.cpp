@@ -195,6 +195,7 @@ void Instance::switchToCustomFile(const QString &filePath) {
 void Instance::reset() {
 	_values.clear();
 	_nonDefaultValues.clear();
+	_unparsedValues.clear();
 	_nonDefaultSet.clear();
 	_legacyId = kLegacyLanguageNone;
 	_customFilePathAbsolute = QString();
@@ -211,6 +212,7 @@ void Instance::fillDefaults() {
 	for (auto i = 0; i != kLangKeysCount; ++i) {
 		_values.emplace_back(GetOriginalValue(LangKey(i)));
 	}
+	_unparsedValues.resize(kLangKeysCount);
 	_nonDefaultSet = std::vector<uchar>(kLangKeysCount, 0);
 }
 
@@ -483,10 +485,26 @@ QString Instance::getNonDefaultValue(const QByteArray &key) const {
 
 void Instance::applyValue(const QByteArray &key, const QByteArray &value) {
 	_nonDefaultValues[key] = value;
-	auto index = ParseKeyValue(key, value, _values);
-	if (index != kLangKeysCount) {
-		_nonDefaultSet[index] = 1;
+	const auto keyIndex = GetKeyIndex(QLatin1String(key));
+	if (keyIndex == kLangKeysCount) {
+		if (!key.startsWith("cloud_")) {
+			LOG(("Lang Warning: Unknown key '%1'"
+				).arg(QString::fromLatin1(key)));
+		}
+		return;
 	}
+	_unparsedValues[keyIndex] = UnparsedValue{ key, value };
+	_nonDefaultSet[keyIndex] = 1;
+}
+
+void Instance::parseValue(LangKey key) const {
+	Expects(_unparsedValues[key].has_value());
+
+	const auto unparsed = *base::take(_unparsedValues[key]);
+	ValueParser parser(unparsed.key, key, unparsed.value);
+	_values[key] = parser.parse()
+		? parser.takeResult()
+		: GetOriginalValue(key);
 }
 
 void Instance::updatePluralRules() {
@@ -511,6 +529,7 @@ void Instance::resetValue(const QByteArray &key) {
 	auto keyIndex = GetKeyIndex(QLatin1String(key));
 	if (keyIndex != kLangKeysCount) {
 		_values[keyIndex] = GetOriginalValue(keyIndex);
+		_unparsedValues[keyIndex] = std::nullopt;
 	}
 }
 
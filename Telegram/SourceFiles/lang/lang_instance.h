@@ -83,6 +83,9 @@ public:
 		Expects(key >= 0 && key < kLangKeysCount);
 		Expects(_values.size() == kLangKeysCount);
 
+		if (_unparsedValues[key]) {
+			parseValue(key);
+		}
 		return _values[key];
 	}
 	QString getNonDefaultValue(const QByteArray &key) const;
@@ -116,6 +119,7 @@ private:
 		Result &result);
 
 	void applyValue(const QByteArray &key, const QByteArray &value);
+	void parseValue(LangKey key) const;
 	void resetValue(const QByteArray &key);
 	void reset();
 	void fillDefaults();
@@ -137,7 +141,13 @@ private:
 
 	mutable QString _systemLanguage;
 
-	std::vector<QString> _values;
+	// Non-default values are parsed when they are used for the first time.
+	struct UnparsedValue {
+		QByteArray key;
+		QByteArray value;
+	};
+	mutable std::vector<QString> _values;
+	mutable std::vector<std::optional<UnparsedValue>> _unparsedValues;
 	std::vector<uchar> _nonDefaultSet;
 	std::map<QByteArray, QByteArray> _nonDefaultValues;
 
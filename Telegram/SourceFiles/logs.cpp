@@ -21,6 +21,12 @@ enum LogDataType {
 	LogDataCount
 };
 
+// Debug messages waiting for the writer thread are dropped above that.
+constexpr auto kMaxQueuedDebugSize = 4 * 1024 * 1024;
+
+// Assumed size of a message that will be formatted by the writer thread.
+constexpr auto kDeferredMessageSize = 1024;
+
 QMutex *_logsMutex(LogDataType type, bool clear = false) {
 	static QMutex *LogsMutexes = 0;
 	if (clear) {
@@ -54,13 +60,58 @@ QString _logsEntryStart() {
 	return QString("[%1 %2-%3]").arg(tm.toString("hh:mm:ss.zzz")).arg(QString("%1").arg(threadId, 2, 10, QChar('0'))).arg(++index, 7, 10, QChar('0'));
 }
 
+class LogsDataFields;
+
+// Writes the debug, tcp and mtp logs in a separate thread, so that
+// the threads producing verbose logs don't wait for the disk.
+class LogsDebugWriter final : public QThread {
+public:
+	explicit LogsDebugWriter(not_null<LogsDataFields*> fields);
+
+	void push(LogDataType type, const QString &msg);
+	void push(
+		LogDataType type,
+		const QString &prefix,
+		FnMut<QString()> &&generator);
+
+	// Writes everything that was pushed before stopping.
+	void stop();
+
+protected:
+	void run() override;
+
+private:
+	struct Entry {
+		LogDataType type = LogDataDebug;
+		QString msg;
+		FnMut<QString()> generator;
+	};
+	void push(Entry &&entry, int size);
+	void writeBatch(std::vector<Entry> &&entries, int dropped);
+
+	const not_null<LogsDataFields*> _fields;
+
+	QMutex _mutex;
+	QWaitCondition _condition;
+	std::vector<Entry> _queue;
+	int _queuedSize = 0;
+	int _dropped = 0;
+	bool _stopped = false;
+
+};
+
 class LogsDataFields {
 public:
 
-	LogsDataFields() {
+	LogsDataFields() : _debugWriter(this) {
 		for (int32 i = 0; i < LogDataCount; ++i) {
 			files[i].reset(new QFile());
 		}
+		_debugWriter.start(QThread::LowPriority);
+	}
+
+	~LogsDataFields() {
+		_debugWriter.stop();
 	}
 
 	bool openMain() {
@@ -93,6 +144,21 @@ public:
 	}
 
 	void write(LogDataType type, const QString &msg) {
+		if (type == LogDataMain) {
+			writeNow(type, msg);
+		} else {
+			_debugWriter.push(type, msg);
+		}
+	}
+
+	void write(
+			LogDataType type,
+			const QString &prefix,
+			FnMut<QString()> &&generator) {
+		_debugWriter.push(type, prefix, std::move(generator));
+	}
+
+	void writeNow(LogDataType type, const QString &msg) {
 		QMutexLocker lock(_logsMutex(type));
 		if (type != LogDataMain) {
 			reopenDebug();
@@ -106,6 +172,7 @@ public:
 	}
 
 private:
+	LogsDebugWriter _debugWriter;
 	std::unique_ptr<QFile> files[LogDataCount];
 
 	int32 part = -1;
@@ -231,6 +298,90 @@ NEW LOGGING INSTANCE STARTED!!!\n\
 
 };
 
+LogsDebugWriter::LogsDebugWriter(not_null<LogsDataFields*> fields)
+: _fields(fields) {
+}
+
+void LogsDebugWriter::push(LogDataType type, const QString &msg) {
+	push({ type, msg }, msg.size());
+}
+
+void LogsDebugWriter::push(
+		LogDataType type,
+		const QString &prefix,
+		FnMut<QString()> &&generator) {
+	push(
+		{ type, prefix, std::move(generator) },
+		prefix.size() + kDeferredMessageSize);
+}
+
+void LogsDebugWriter::push(Entry &&entry, int size) {
+	QMutexLocker lock(&_mutex);
+	if (_stopped) {
+		lock.unlock();
+		if (entry.generator) {
+			entry.msg += entry.generator() + '\n';
+		}
+		_fields->writeNow(entry.type, entry.msg);
+		return;
+	} else if (_queuedSize + size > kMaxQueuedDebugSize) {
+		++_dropped;
+		return;
+	}
+	_queuedSize += size;
+	_queue.push_back(std::move(entry));
+	if (_queue.size() == 1) {
+		_condition.wakeOne();
+	}
+}
+
+void LogsDebugWriter::stop() {
+	{
+		QMutexLocker lock(&_mutex);
+		_stopped = true;
+		_condition.wakeOne();
+	}
+	wait();
+}
+
+void LogsDebugWriter::run() {
+	QMutexLocker lock(&_mutex);
+	while (true) {
+		while (!_stopped && _queue.empty()) {
+			_condition.wait(&_mutex);
+		}
+		if (_queue.empty()) {
+			return;
+		}
+		auto entries = base::take(_queue);
+		const auto dropped = base::take(_dropped);
+		_queuedSize = 0;
+
+		lock.unlock();
+		writeBatch(std::move(entries), dropped);
+		lock.relock();
+	}
+}
+
+void LogsDebugWriter::writeBatch(std::vector<Entry> &&entries, int dropped) {
+	QString batches[LogDataCount];
+	if (dropped > 0) {
+		batches[LogDataDebug] = QString("%1 debug log messages dropped.\n"
+			).arg(dropped);
+	}
+	for (auto &entry : entries) {
+		batches[entry.type] += entry.msg;
+		if (entry.generator) {
+			batches[entry.type] += entry.generator() + '\n';
+		}
+	}
+	for (auto type = 0; type != LogDataCount; ++type) {
+		if (!batches[type].isEmpty()) {
+			_fields->writeNow(LogDataType(type), batches[type]);
+		}
+	}
+}
+
 LogsDataFields *LogsData = 0;
 
 typedef QList<QPair<LogDataType, QString> > LogsInMemoryList;
@@ -254,6 +405,19 @@ void _logsWrite(LogDataType type, const QString &msg) {
 	}
 }
 
+void _logsWrite(
+		LogDataType type,
+		const QString &prefix,
+		FnMut<QString()> &&generator) {
+	if (LogsData && LogsStartIndexChosen < 0) {
+		if (Logs::DebugEnabled()) {
+			LogsData->write(type, prefix, std::move(generator));
+		}
+	} else {
+		_logsWrite(type, prefix + generator() + '\n');
+	}
+}
+
 namespace Logs {
 namespace {
 
@@ -564,6 +728,13 @@ void writeMtp(int32 dc, const QString &v) {
 	_logsWrite(LogDataMtp, msg);
 }
 
+void writeMtp(int32 dc, FnMut<QString()> &&generator) {
+	const auto prefix = QString("%1 (dc:%2) "
+		).arg(_logsEntryStart()
+		).arg(dc);
+	_logsWrite(LogDataMtp, prefix, std::move(generator));
+}
+
 QString full() {
 	if (LogsData) {
 		return LogsData->full();
@@ -33,6 +33,10 @@ void writeDebug(const char *file, int32 line, const QString &v);
 void writeTcp(const QString &v);
 void writeMtp(int32 dc, const QString &v);
 
+// The message is generated in the logs writer thread, so the generator
+// must own copies of all the data it uses.
+void writeMtp(int32 dc, FnMut<QString()> &&generator);
+
 QString full();
 
 inline const char *b(bool v) {
@@ -78,3 +82,6 @@ inline MemoryBuffer mb(const void *ptr, uint32 size) {
 
 #define MTP_LOG(dc, msg) { if (Logs::DebugEnabled() || !Logs::started()) Logs::writeMtp(dc, QString msg); }
 //usage MTP_LOG(dc, ("log: %1 %2").arg(1).arg(2))
+
+#define MTP_LOG_DEFERRED(dc, generator) { if (Logs::DebugEnabled() || !Logs::started()) Logs::writeMtp(dc, generator); }
+//usage MTP_LOG_DEFERRED(dc, [=] { return QString("log: %1").arg(1); })
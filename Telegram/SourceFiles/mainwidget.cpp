@@ -40,6 +40,7 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 #include "apiwrap.h"
 #include "dialogs/dialogs_widget.h"
 #include "dialogs/dialogs_key.h"
+#include "dialogs/dialogs_indexed_list.h"
 #include "history/history.h"
 #include "history/history_widget.h"
 #include "history/history_message.h"
@@ -79,6 +80,8 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 #include "mtproto/dc_options.h"
 #include "core/file_utilities.h"
 #include "core/update_checker.h"
+#include "core/scroll_benchmark.h"
+#include "core/startup_trace.h"
 #include "calls/calls_instance.h"
 #include "calls/calls_top_bar.h"
 #include "export/export_settings.h"
@@ -94,6 +97,15 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 
 namespace {
 
+// Channel differences requested at the same time after a long offline.
+constexpr auto kChannelDifferenceRequestsLimit = 8;
+
+// The server accepts that many message ids in one delete request.
+constexpr auto kDeleteMessagesPerRequest = 100;
+
+// Time for the chats list and the chat to load before they are scrolled.
+constexpr auto kScrollBenchmarkDelay = 5000;
+
 bool IsForceLogoutNotification(const MTPDupdateServiceNotification &data) {
 	return qs(data.vtype).startsWith(qstr("AUTH_KEY_DROP_"));
 }
@@ -831,22 +843,33 @@ void MainWidget::deleteMessages(
 		not_null<PeerData*> peer,
 		const QVector<MTPint> &ids,
 		bool forEveryone) {
-	if (const auto channel = peer->asChannel()) {
-		MTP::send(
-			MTPchannels_DeleteMessages(
-				channel->inputChannel,
-				MTP_vector<MTPint>(ids)),
-			rpcDone(&MainWidget::messagesAffected, peer));
-	} else {
-		auto flags = MTPmessages_DeleteMessages::Flags(0);
-		if (forEveryone) {
-			flags |= MTPmessages_DeleteMessages::Flag::f_revoke;
+	// The requests are independent, so all the chunks are sent at once.
+	for (auto from = 0; from < ids.size();) {
+		const auto count = std::min(
+			int(ids.size()) - from,
+			kDeleteMessagesPerRequest);
+		const auto chunk = (!from && count == ids.size())
+			? ids
+			: ids.mid(from, count);
+		from += count;
+
+		if (const auto channel = peer->asChannel()) {
+			MTP::send(
+				MTPchannels_DeleteMessages(
+					channel->inputChannel,
+					MTP_vector<MTPint>(chunk)),
+				rpcDone(&MainWidget::messagesAffected, peer));
+		} else {
+			auto flags = MTPmessages_DeleteMessages::Flags(0);
+			if (forEveryone) {
+				flags |= MTPmessages_DeleteMessages::Flag::f_revoke;
+			}
+			MTP::send(
+				MTPmessages_DeleteMessages(
+					MTP_flags(flags),
+					MTP_vector<MTPint>(chunk)),
+				rpcDone(&MainWidget::messagesAffected, peer));
 		}
-		MTP::send(
-			MTPmessages_DeleteMessages(
-				MTP_flags(flags),
-				MTP_vector<MTPint>(ids)),
-			rpcDone(&MainWidget::messagesAffected, peer));
 	}
 }
 
@@ -1035,17 +1058,45 @@ void MainWidget::onCacheBackground() {
 		_cachedX = 0;
 		_cachedY = 0;
 		_cachedBackground = App::pixmapFromImageInPlace(std::move(result));
+		_cachedFor = _willCacheFor;
 	} else {
 		auto &bg = Window::Theme::Background()->pixmap();
 
 		QRect to, from;
 		Window::Theme::ComputeBackgroundRects(_willCacheFor, bg.size(), to, from);
-		_cachedX = to.x();
-		_cachedY = to.y();
-		_cachedBackground = App::pixmapFromImageInPlace(bg.toImage().copy(from).scaled(to.width() * cIntRetinaFactor(), to.height() * cIntRetinaFactor(), Qt::IgnoreAspectRatio, Qt::SmoothTransformation));
-		_cachedBackground.setDevicePixelRatio(cRetinaFactor());
+
+		// The smooth scaling of a large wallpaper takes a while,
+		// so it is done in the background, painting goes on meanwhile.
+		auto [left, right] = base::make_binary_guard();
+		_cacheBackgroundGuard = std::move(left);
+		crl::async([
+			=,
+			image = bg.toImage().copy(from),
+			forRect = _willCacheFor,
+			guard = std::move(right)
+		]() mutable {
+			auto scaled = image.scaled(
+				to.width() * cIntRetinaFactor(),
+				to.height() * cIntRetinaFactor(),
+				Qt::IgnoreAspectRatio,
+				Qt::SmoothTransformation);
+			crl::on_main([
+				=,
+				scaled = std::move(scaled),
+				guard = std::move(guard)
+			]() mutable {
+				if (!guard.alive()) {
+					return;
+				}
+				_cachedX = to.x();
+				_cachedY = to.y();
+				_cachedBackground = App::pixmapFromImageInPlace(
+					std::move(scaled));
+				_cachedBackground.setDevicePixelRatio(cRetinaFactor());
+				_cachedFor = forRect;
+			});
+		});
 	}
-	_cachedFor = _willCacheFor;
 }
 
 Dialogs::IndexedList *MainWidget::contactsList() {
@@ -1483,6 +1534,7 @@ bool MainWidget::isIdle() const {
 void MainWidget::clearCachedBackground() {
 	_cachedBackground = QPixmap();
 	_cacheBackgroundTimer.stop();
+	_cacheBackgroundGuard = base::binary_guard();
 	update();
 }
 
@@ -2390,6 +2442,7 @@ void MainWidget::animationCallback() {
 }
 
 void MainWidget::paintEvent(QPaintEvent *e) {
+	Core::StartupTrace::Mark("MainWidget first paint");
 	if (_background) checkChatBackground();
 
 	Painter p(this);
@@ -3008,6 +3061,7 @@ void MainWidget::gotChannelDifference(
 		ChannelData *channel,
 		const MTPupdates_ChannelDifference &diff) {
 	_channelFailDifferenceTimeout.remove(channel);
+	--_channelDifferenceRequests;
 
 	int32 timeout = 0;
 	bool isFinal = true;
@@ -3069,6 +3123,7 @@ void MainWidget::gotChannelDifference(
 	} else if (_controller->activeChatCurrent().peer() == channel) {
 		channel->ptsWaitingForShortPoll(timeout ? (timeout * 1000) : WaitForChannelGetDifference);
 	}
+	sendQueuedChannelDifferences();
 }
 
 void MainWidget::feedChannelDifference(
@@ -3087,7 +3142,9 @@ bool MainWidget::failChannelDifference(ChannelData *channel, const RPCError &err
 	if (MTP::isDefaultHandledError(error)) return false;
 
 	LOG(("RPC Error in getChannelDifference: %1 %2: %3").arg(error.code()).arg(error.type()).arg(error.description()));
+	--_channelDifferenceRequests;
 	failDifferenceStartTimerFor(channel);
+	sendQueuedChannelDifferences();
 	return true;
 }
 
@@ -3101,6 +3158,35 @@ void MainWidget::gotState(const MTPupdates_State &state) {
 
 	_dialogs->loadDialogs();
 	updateOnline();
+
+	Core::StartupTrace::Mark("Updates state received");
+	Core::StartupTrace::Finish();
+
+	if (Core::ScrollBenchmark::TakeStart()) {
+		runScrollBenchmark();
+	}
+}
+
+void MainWidget::runScrollBenchmark() {
+	App::CallDelayed(kScrollBenchmarkDelay, this, [=] {
+		_dialogs->replayScrollBenchmark([=] {
+			const auto list = _dialogs->dialogsList();
+			const auto row = (list && !list->isEmpty())
+				? *list->cbegin()
+				: nullptr;
+			const auto history = row ? row->history() : nullptr;
+			if (!history) {
+				Core::ScrollBenchmark::Finish();
+				return;
+			}
+			Ui::showPeerHistory(history, ShowAtTheEndMsgId);
+			App::CallDelayed(kScrollBenchmarkDelay, this, [=] {
+				_history->replayScrollBenchmark([] {
+					Core::ScrollBenchmark::Finish();
+				});
+			});
+		});
+	});
 }
 
 void MainWidget::gotDifference(const MTPupdates_Difference &difference) {
@@ -3326,6 +3412,15 @@ void MainWidget::getChannelDifference(ChannelData *channel, ChannelDifferenceReq
 		_channelGetDifferenceTimeAfterFail.remove(channel);
 	}
 
+	const auto active = (_controller->activeChatCurrent().peer() == channel);
+	if (!active
+		&& _channelDifferenceRequests >= kChannelDifferenceRequestsLimit) {
+		_channelDifferenceQueue[channel] = from;
+		return;
+	}
+	_channelDifferenceQueue.remove(channel);
+	++_channelDifferenceRequests;
+
 	channel->ptsSetRequesting(true);
 
 	auto filter = MTP_channelMessagesFilterEmpty();
@@ -3338,6 +3433,38 @@ void MainWidget::getChannelDifference(ChannelData *channel, ChannelDifferenceReq
 	MTP::send(MTPupdates_GetChannelDifference(MTP_flags(flags), channel->inputChannel, filter, MTP_int(channel->pts()), MTP_int(MTPChannelGetDifferenceLimit)), rpcDone(&MainWidget::gotChannelDifference, channel), rpcFail(&MainWidget::failChannelDifference, channel));
 }
 
+void MainWidget::sendQueuedChannelDifferences() {
+	while (!_channelDifferenceQueue.empty()
+		&& _channelDifferenceRequests < kChannelDifferenceRequestsLimit) {
+		auto best = _channelDifferenceQueue.begin();
+		auto bestPriority = channelDifferencePriority(best->first);
+		const auto till = _channelDifferenceQueue.end();
+		for (auto i = best + 1; i != till; ++i) {
+			const auto priority = channelDifferencePriority(i->first);
+			if (priority > bestPriority) {
+				best = i;
+				bestPriority = priority;
+			}
+		}
+		const auto channel = best->first;
+		const auto from = best->second;
+		_channelDifferenceQueue.erase(best);
+		getChannelDifference(channel, from);
+	}
+}
+
+uint64 MainWidget::channelDifferencePriority(
+		not_null<ChannelData*> channel) const {
+	if (_controller->activeChatCurrent().peer() == channel.get()) {
+		return std::numeric_limits<uint64>::max();
+	}
+
+	// The chats list is sorted by this key, so the chats that are visible
+	// at the top of the dialogs list catch up before the others.
+	const auto history = App::historyLoaded(channel.get());
+	return history ? history->sortKeyInChatList() : 0;
+}
+
 void MainWidget::mtpPing() {
 	MTP::ping();
 }
@@ -3354,11 +3481,17 @@ void MainWidget::start() {
 	update();
 
 	_started = true;
-	Local::readInstalledStickers();
-	Local::readFeaturedStickers();
-	Local::readRecentStickers();
-	Local::readFavedStickers();
-	Local::readSavedGifs();
+	Auth().data().setStickersReader([] {
+		const auto ms = getms();
+		Local::readInstalledStickers();
+		Local::readFeaturedStickers();
+		Local::readRecentStickers();
+		Local::readFavedStickers();
+		LOG(("Stickers read time: %1").arg(getms() - ms));
+	});
+	Auth().data().setSavedGifsReader([] {
+		Local::readSavedGifs();
+	});
 	if (const auto availableAt = Local::ReadExportSettings().availableAt) {
 		Auth().data().suggestStartExport(availableAt);
 	}
@@ -9,6 +9,7 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 
 #include "core/single_timer.h"
 #include "base/weak_ptr.h"
+#include "base/binary_guard.h"
 #include "ui/rp_widget.h"
 #include "media/player/media_player_float.h"
 
@@ -424,10 +425,13 @@ private:
 	void saveSectionInStack();
 
 	void getChannelDifference(ChannelData *channel, ChannelDifferenceRequest from = ChannelDifferenceRequest::Unknown);
+	void sendQueuedChannelDifferences();
+	uint64 channelDifferencePriority(not_null<ChannelData*> channel) const;
 	void gotDifference(const MTPupdates_Difference &diff);
 	bool failDifference(const RPCError &e);
 	void feedDifference(const MTPVector<MTPUser> &users, const MTPVector<MTPChat> &chats, const MTPVector<MTPMessage> &msgs, const MTPVector<MTPUpdate> &other);
 	void gotState(const MTPupdates_State &state);
+	void runScrollBenchmark();
 	void updSetState(int32 pts, int32 date, int32 qts, int32 seq);
 	void gotChannelDifference(ChannelData *channel, const MTPupdates_ChannelDifference &diff);
 	bool failChannelDifference(ChannelData *channel, const RPCError &err);
@@ -561,6 +565,13 @@ private:
 	int32 _failDifferenceTimeout = 1; // growing timeout for getDifference calls, if it fails
 	typedef QMap<ChannelData*, int32> ChannelFailDifferenceTimeout;
 	ChannelFailDifferenceTimeout _channelFailDifferenceTimeout; // growing timeout for getChannelDifference calls, if it fails
+
+	// Only a few channel differences are requested at the same time, the
+	// others wait here and the chats higher in the list are sent first.
+	base::flat_map<
+		not_null<ChannelData*>,
+		ChannelDifferenceRequest> _channelDifferenceQueue;
+	int _channelDifferenceRequests = 0;
 	SingleTimer _failDifferenceTimer;
 
 	TimeMs _lastUpdateTime = 0;
@@ -571,6 +582,7 @@ private:
 	int _cachedX = 0;
 	int _cachedY = 0;
 	SingleTimer _cacheBackgroundTimer;
+	base::binary_guard _cacheBackgroundGuard;
 
 	typedef QMap<ChannelData*, bool> UpdatedChannels;
 	UpdatedChannels _updatedChannels;
@@ -31,6 +31,7 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 #include "boxes/connection_box.h"
 #include "observer_peer.h"
 #include "mediaview.h"
+#include "media/media_clip_reader.h"
 #include "storage/localstorage.h"
 #include "apiwrap.h"
 #include "settings/settings_intro.h"
@@ -900,6 +901,7 @@ void MainWindow::sendPaths() {
 }
 
 void MainWindow::updateIsActiveHook() {
+	Media::Clip::SetWindowActive(isActive());
 	if (_main) _main->updateOnline();
 }
 
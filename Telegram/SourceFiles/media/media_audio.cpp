@@ -1242,6 +1242,7 @@ void Fader::onTimer() {
 	}
 	auto hasFading = (_suppressAll || _suppressSongAnim);
 	auto hasPlaying = false;
+	_playbackEndsIn = kCheckPlaybackPositionTimeout;
 
 	auto updatePlayback = [this, &hasPlaying, &hasFading](AudioMsgId::Type type, int index, float64 volumeMultiplier, bool suppressGainChanged) {
 		auto track = mixer()->trackForType(type, index);
@@ -1269,7 +1270,11 @@ void Fader::onTimer() {
 		_timer.start(kCheckFadingTimeout);
 		Audio::StopDetachIfNotUsedSafe();
 	} else if (hasPlaying) {
-		_timer.start(kCheckPlaybackPositionTimeout);
+		// Check right when a track ends, so that the next one in the
+		// playlist starts without waiting for the regular check.
+		_timer.start(std::max(
+			std::min(_playbackEndsIn, kCheckPlaybackPositionTimeout),
+			kCheckFadingTimeout));
 		Audio::StopDetachIfNotUsedSafe();
 	} else {
 		Audio::ScheduleDetachIfNotUsedSafe();
@@ -1378,6 +1383,12 @@ int32 Fader::updateOnePlayback(Mixer::Track *track, bool &hasPlaying, bool &hasF
 			}
 		}
 	}
+	if (playing && track->loaded && track->state.frequency > 0) {
+		const auto left = track->state.length - fullPosition;
+		accumulate_min(
+			_playbackEndsIn,
+			std::max(left, int64(0)) * 1000 / track->state.frequency);
+	}
 	if (playing) hasPlaying = true;
 	if (fading) hasFading = true;
 
@@ -1628,15 +1639,6 @@ public:
 
 		auto fmt = format();
 		auto peak = uint16(0);
-		auto callback = [&](uint16 sample) {
-			accumulate_max(peak, sample);
-			sumbytes += Media::Player::kWaveformSamplesCount;
-			if (sumbytes >= countbytes) {
-				sumbytes -= countbytes;
-				peaks.push_back(peak);
-				peak = 0;
-			}
-		};
 		while (processed < countbytes) {
 			buffer.resize(0);
 
@@ -1651,9 +1653,19 @@ public:
 
 			auto sampleBytes = bytes::make_span(buffer);
 			if (fmt == AL_FORMAT_MONO8 || fmt == AL_FORMAT_STEREO8) {
-				Media::Audio::IterateSamples<uchar>(sampleBytes, callback);
+				Media::Audio::CountWaveformPeaks<uchar>(
+					sampleBytes,
+					countbytes,
+					sumbytes,
+					peak,
+					peaks);
 			} else if (fmt == AL_FORMAT_MONO16 || fmt == AL_FORMAT_STEREO16) {
-				Media::Audio::IterateSamples<int16>(sampleBytes, callback);
+				Media::Audio::CountWaveformPeaks<int16>(
+					sampleBytes,
+					countbytes,
+					sumbytes,
+					peak,
+					peaks);
 			}
 			processed += sampleSize() * samples;
 		}
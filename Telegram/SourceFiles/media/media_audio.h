@@ -285,6 +285,7 @@ private:
 	void setStoppedState(Mixer::Track *track, State state = State::Stopped);
 
 	QTimer _timer;
+	TimeMs _playbackEndsIn = 0;
 
 	bool _volumeChangedSong = false;
 	bool _volumeChangedVideo = false;
@@ -335,6 +336,42 @@ TG_FORCE_INLINE uint16 ReadOneSample(int16 data) {
 	return qAbs(data);
 }
 
+// Accumulates the peaks of samples between the waveform points,
+// the inner loop is a plain maximum, so that it is vectorized.
+template <typename SampleType>
+void CountWaveformPeaks(
+		bytes::const_span bytes,
+		int64 countbytes,
+		int64 &sumbytes,
+		uint16 &peak,
+		QVector<uint16> &peaks) {
+	constexpr auto kStep = int64(Player::kWaveformSamplesCount);
+
+	auto samples = reinterpret_cast<const SampleType*>(bytes.data());
+	auto left = int64(bytes.size() / sizeof(SampleType));
+	while (left > 0) {
+		const auto till = std::min(
+			left,
+			(countbytes - sumbytes + kStep - 1) / kStep);
+		auto max = peak;
+		for (auto i = int64(0); i != till; ++i) {
+			const auto sample = ReadOneSample(samples[i]);
+			if (max < sample) {
+				max = sample;
+			}
+		}
+		peak = max;
+		samples += till;
+		left -= till;
+		sumbytes += till * kStep;
+		if (sumbytes >= countbytes) {
+			sumbytes -= countbytes;
+			peaks.push_back(peak);
+			peak = 0;
+		}
+	}
+}
+
 template <typename SampleType, typename Callback>
 void IterateSamples(bytes::const_span bytes, Callback &&callback) {
 	auto samplesPointer = reinterpret_cast<const SampleType*>(bytes.data());
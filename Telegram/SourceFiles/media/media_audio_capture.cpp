@@ -23,6 +23,10 @@ constexpr auto kCaptureFrequency = Player::kDefaultFrequency;
 constexpr auto kCaptureSkipDuration = TimeMs(400);
 constexpr auto kCaptureFadeInDuration = TimeMs(300);
 
+// Encoded data is reported in such parts while recording, so that it
+// could be uploaded before the recording is finished.
+constexpr auto kCaptureEncodedPartSize = 32 * 1024;
+
 Instance *CaptureInstance = nullptr;
 
 bool ErrorHappened(ALCdevice *device) {
@@ -52,6 +56,7 @@ Instance::Instance() : _inner(new Inner(&_thread)) {
 	connect(this, SIGNAL(stop(bool)), _inner, SLOT(onStop(bool)));
 	connect(_inner, SIGNAL(done(QByteArray, VoiceWaveform, qint32)), this, SIGNAL(done(QByteArray, VoiceWaveform, qint32)));
 	connect(_inner, SIGNAL(updated(quint16, qint32)), this, SIGNAL(updated(quint16, qint32)));
+	connect(_inner, SIGNAL(encoded(QByteArray)), this, SIGNAL(encoded(QByteArray)));
 	connect(_inner, SIGNAL(error()), this, SIGNAL(error()));
 	connect(&_thread, SIGNAL(started()), _inner, SLOT(onInit()));
 	connect(&_thread, SIGNAL(finished()), _inner, SLOT(deleteLater()));
@@ -108,6 +113,7 @@ struct Instance::Inner::Private {
 
 	QByteArray data;
 	int32 dataPos = 0;
+	int32 dataReported = 0;
 
 	int64 waveformMod = 0;
 	int64 waveformEach = (kCaptureFrequency / 100);
@@ -343,6 +349,7 @@ void Instance::Inner::onStop(bool needResult) {
 		if ((_captured.size() % sizeof(short)) || (d->fullSamples + capturedSamples < kCaptureFrequency) || (capturedSamples < fadeSamples)) {
 			d->fullSamples = 0;
 			d->dataPos = 0;
+			d->dataReported = 0;
 			d->data.clear();
 			d->waveformMod = 0;
 			d->waveformPeak = 0;
@@ -368,6 +375,7 @@ void Instance::Inner::onStop(bool needResult) {
 			if (encoded != _captured.size()) {
 				d->fullSamples = 0;
 				d->dataPos = 0;
+				d->dataReported = 0;
 				d->data.clear();
 				d->waveformMod = 0;
 				d->waveformPeak = 0;
@@ -464,6 +472,7 @@ void Instance::Inner::onStop(bool needResult) {
 		d->levelMax = 0;
 
 		d->dataPos = 0;
+		d->dataReported = 0;
 		d->data.clear();
 
 		d->waveformMod = 0;
@@ -534,6 +543,12 @@ void Instance::Inner::onTimeout() {
 			memmove(_captured.data(), _captured.constData() + encoded, goodSize);
 			_captured.resize(goodSize);
 		}
+
+		const auto unreported = d->data.size() - d->dataReported;
+		if (unreported >= kCaptureEncodedPartSize) {
+			emit encoded(d->data.mid(d->dataReported, unreported));
+			d->dataReported = d->data.size();
+		}
 	} else {
 		DEBUG_LOG(("Audio Capture: no samples to capture."));
 	}
@@ -34,6 +34,7 @@ signals:
 
 	void done(QByteArray data, VoiceWaveform waveform, qint32 samples);
 	void updated(quint16 level, qint32 samples);
+	void encoded(QByteArray part);
 	void error();
 
 private:
@@ -58,6 +59,7 @@ public:
 signals:
 	void error();
 	void updated(quint16 level, qint32 samples);
+	void encoded(QByteArray part);
 	void done(QByteArray data, VoiceWaveform waveform, qint32 samples);
 
 public slots:
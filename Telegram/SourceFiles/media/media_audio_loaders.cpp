@@ -13,6 +13,13 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 
 namespace Media {
 namespace Player {
+namespace {
+
+// The first buffer is kept small, so that the playback starts right after
+// a fraction of a second is decoded instead of after a full buffer.
+constexpr auto kStartBufferSize = 32 * 1024;
+
+} // namespace
 
 Loaders::Loaders(QThread *thread) : _fromVideoNotify([this] { videoSoundAdded(); }) {
 	moveToThread(thread);
@@ -98,7 +105,10 @@ void Loaders::onStart(const AudioMsgId &audio, qint64 positionMs) {
 		track->loading = true;
 	}
 
-	loadData(audio, positionMs);
+	if (loadData(audio, positionMs)) {
+		// Fill the following buffers while the first one is playing.
+		loadData(audio, TimeMs(0));
+	}
 }
 
 AudioMsgId Loaders::clear(AudioMsgId::Type type) {
@@ -120,10 +130,12 @@ void Loaders::emitError(AudioMsgId::Type type) {
 }
 
 void Loaders::onLoad(const AudioMsgId &audio) {
-	loadData(audio, TimeMs(0));
+	if (loadData(audio, TimeMs(0))) {
+		loadData(audio, TimeMs(0));
+	}
 }
 
-void Loaders::loadData(AudioMsgId audio, TimeMs positionMs) {
+bool Loaders::loadData(AudioMsgId audio, TimeMs positionMs) {
 	auto err = SetupNoErrorStarted;
 	auto type = audio.type();
 	auto l = setupLoader(audio, err, positionMs);
@@ -131,10 +143,13 @@ void Loaders::loadData(AudioMsgId audio, TimeMs positionMs) {
 		if (err == SetupErrorAtStart) {
 			emitError(type);
 		}
-		return;
+		return false;
 	}
 
 	auto started = (err == SetupNoErrorStarted);
+	const auto bufferSize = started
+		? kStartBufferSize
+		: AudioVoiceMsgBufferSize;
 	auto finished = false;
 	auto waiting = false;
 	auto errAtStart = started;
@@ -144,7 +159,7 @@ void Loaders::loadData(AudioMsgId audio, TimeMs positionMs) {
 	if (l->holdsSavedDecodedSamples()) {
 		l->takeSavedDecodedSamples(&samples, &samplesCount);
 	}
-	while (samples.size() < AudioVoiceMsgBufferSize) {
+	while (samples.size() < bufferSize) {
 		auto res = l->readMore(samples, samplesCount);
 		using Result = AudioPlayerLoader::ReadResult;
 		if (res == Result::Error) {
@@ -156,7 +171,7 @@ void Loaders::loadData(AudioMsgId audio, TimeMs positionMs) {
 					}
 				}
 				emitError(type);
-				return;
+				return false;
 			}
 			finished = true;
 			break;
@@ -166,7 +181,7 @@ void Loaders::loadData(AudioMsgId audio, TimeMs positionMs) {
 		} else if (res == Result::Ok) {
 			errAtStart = false;
 		} else if (res == Result::Wait) {
-			waiting = (samples.size() < AudioVoiceMsgBufferSize);
+			waiting = (samples.size() < bufferSize);
 			if (waiting) {
 				l->saveDecodedSamples(&samples, &samplesCount);
 			}
@@ -176,7 +191,7 @@ void Loaders::loadData(AudioMsgId audio, TimeMs positionMs) {
 		QMutexLocker lock(internal::audioPlayerMutex());
 		if (!checkLoader(type)) {
 			clear(type);
-			return;
+			return false;
 		}
 	}
 
@@ -184,7 +199,7 @@ void Loaders::loadData(AudioMsgId audio, TimeMs positionMs) {
 	auto track = checkLoader(type);
 	if (!track) {
 		clear(type);
-		return;
+		return false;
 	}
 
 	if (started) {
@@ -194,7 +209,7 @@ void Loaders::loadData(AudioMsgId audio, TimeMs positionMs) {
 		if (!internal::audioCheckError()) {
 			setStoppedState(track, State::StoppedAtStart);
 			emitError(type);
-			return;
+			return false;
 		}
 
 		track->format = l->format();
@@ -213,12 +228,12 @@ void Loaders::loadData(AudioMsgId audio, TimeMs positionMs) {
 		if (!internal::audioCheckError()) {
 			setStoppedState(track, State::StoppedAtError);
 			emitError(type);
-			return;
+			return false;
 		}
 
 		if (bufferIndex < 0) { // No free buffers, wait.
 			l->saveDecodedSamples(&samples, &samplesCount);
-			return;
+			return false;
 		}
 
 		track->bufferSamples[bufferIndex] = samples;
@@ -231,11 +246,11 @@ void Loaders::loadData(AudioMsgId audio, TimeMs positionMs) {
 		if (!internal::audioCheckError()) {
 			setStoppedState(track, State::StoppedAtError);
 			emitError(type);
-			return;
+			return false;
 		}
 	} else {
 		if (waiting) {
-			return;
+			return false;
 		}
 		finished = true;
 	}
@@ -246,28 +261,30 @@ void Loaders::loadData(AudioMsgId audio, TimeMs positionMs) {
 		clear(type);
 	}
 
-	track->loading = false;
+	// Keep the loading flag if the short start buffer is followed right away.
+	const auto loadMore = started && !finished;
+	track->loading = loadMore;
 	if (track->state.state == State::Resuming || track->state.state == State::Playing || track->state.state == State::Starting) {
 		ALint state = AL_INITIAL;
 		alGetSourcei(track->stream.source, AL_SOURCE_STATE, &state);
 		if (internal::audioCheckError()) {
 			if (state != AL_PLAYING) {
 				if (state == AL_STOPPED && !internal::CheckAudioDeviceConnected()) {
-					return;
+					return loadMore;
 				}
 
 				alSourcef(track->stream.source, AL_GAIN, ComputeVolume(type));
 				if (!internal::audioCheckError()) {
 					setStoppedState(track, State::StoppedAtError);
 					emitError(type);
-					return;
+					return false;
 				}
 
 				alSourcePlay(track->stream.source);
 				if (!internal::audioCheckError()) {
 					setStoppedState(track, State::StoppedAtError);
 					emitError(type);
-					return;
+					return false;
 				}
 
 				emit needToCheck();
@@ -275,8 +292,10 @@ void Loaders::loadData(AudioMsgId audio, TimeMs positionMs) {
 		} else {
 			setStoppedState(track, State::StoppedAtError);
 			emitError(type);
+			return false;
 		}
 	}
+	return loadMore;
 }
 
 AudioPlayerLoader *Loaders::setupLoader(
@@ -59,7 +59,8 @@ private:
 		SetupErrorLoadedFull = 2,
 		SetupNoErrorStarted = 3,
 	};
-	void loadData(AudioMsgId audio, TimeMs positionMs);
+	// Returns true if the next part should be loaded right away.
+	bool loadData(AudioMsgId audio, TimeMs positionMs);
 	AudioPlayerLoader *setupLoader(
 		const AudioMsgId &audio,
 		SetupError &err,
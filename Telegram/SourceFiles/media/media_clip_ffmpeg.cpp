@@ -11,12 +11,20 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 #include "media/media_child_ffmpeg_loader.h"
 #include "storage/file_download.h"
 
+extern "C" {
+#include <libavutil/hwcontext.h>
+#include <libavutil/pixdesc.h>
+} // extern "C"
+
 namespace Media {
 namespace Clip {
 namespace internal {
 namespace {
 
 constexpr int kSkipInvalidDataPackets = 10;
+constexpr int kKeepUpFramesCount = 2;
+constexpr int kSkipFramesCount = 8;
+constexpr auto kDropFramesLag = TimeMs(100);
 constexpr int kAlignImageBy = 16;
 
 void alignedImageBufferCleanupHandler(void *data) {
@@ -25,7 +33,7 @@ void alignedImageBufferCleanupHandler(void *data) {
 }
 
 // Create a QImage of desired size where all the data is aligned to 16 bytes.
-QImage createAlignedImage(QSize size) {
+QImage createAlignedImage(QSize size, QImage::Format format) {
 	auto width = size.width();
 	auto height = size.height();
 	auto widthalign = kAlignImageBy / 4;
@@ -35,13 +43,68 @@ QImage createAlignedImage(QSize size) {
 	auto cleanupdata = static_cast<void*>(buffer);
 	auto bufferval = reinterpret_cast<uintptr_t>(buffer);
 	auto alignedbuffer = buffer + ((bufferval % kAlignImageBy) ? (kAlignImageBy - (bufferval % kAlignImageBy)) : 0);
-	return QImage(alignedbuffer, width, height, bytesperline, QImage::Format_ARGB32, alignedImageBufferCleanupHandler, cleanupdata);
+	return QImage(alignedbuffer, width, height, bytesperline, format, alignedImageBufferCleanupHandler, cleanupdata);
 }
 
 bool isAlignedImage(const QImage &image) {
 	return !(reinterpret_cast<uintptr_t>(image.constBits()) % kAlignImageBy) && !(image.bytesPerLine() % kAlignImageBy);
 }
 
+#if defined Q_OS_WIN
+constexpr auto kHardwareDeviceType = AV_HWDEVICE_TYPE_DXVA2;
+constexpr auto kHardwarePixelFormat = AV_PIX_FMT_DXVA2_VLD;
+#elif defined Q_OS_MAC // Q_OS_WIN
+constexpr auto kHardwareDeviceType = AV_HWDEVICE_TYPE_VIDEOTOOLBOX;
+constexpr auto kHardwarePixelFormat = AV_PIX_FMT_VIDEOTOOLBOX;
+#else // Q_OS_WIN || Q_OS_MAC
+constexpr auto kHardwareDeviceType = AV_HWDEVICE_TYPE_VAAPI;
+constexpr auto kHardwarePixelFormat = AV_PIX_FMT_VAAPI;
+#endif // Q_OS_WIN || Q_OS_MAC
+
+QMutex HardwareDeviceMutex;
+AVBufferRef *HardwareDevice = nullptr;
+bool HardwareDeviceFailed = false;
+
+// One device is shared by all the readers, creating it is not cheap.
+// Returns a new reference to it or nullptr if there is no such device.
+AVBufferRef *HardwareDeviceRef() {
+	QMutexLocker lock(&HardwareDeviceMutex);
+	if (!HardwareDevice && !HardwareDeviceFailed) {
+		const auto res = av_hwdevice_ctx_create(
+			&HardwareDevice,
+			kHardwareDeviceType,
+			nullptr,
+			nullptr,
+			0);
+		if (res < 0) {
+			char err[AV_ERROR_MAX_STRING_SIZE] = { 0 };
+			LOG(("Gif Error: Unable to av_hwdevice_ctx_create, error %1, %2"
+				).arg(res
+				).arg(av_make_error_string(err, sizeof(err), res)));
+			HardwareDevice = nullptr;
+			HardwareDeviceFailed = true;
+		}
+	}
+	return HardwareDevice ? av_buffer_ref(HardwareDevice) : nullptr;
+}
+
+void HardwareDeviceBroken() {
+	QMutexLocker lock(&HardwareDeviceMutex);
+	HardwareDeviceFailed = true;
+}
+
+AVPixelFormat GetHardwareFormat(
+		AVCodecContext *context,
+		const AVPixelFormat *formats) {
+	for (auto format = formats; *format != AV_PIX_FMT_NONE; ++format) {
+		if (*format == kHardwarePixelFormat) {
+			return *format;
+		}
+	}
+	// The hwaccel for this stream is not available, decode in software.
+	return avcodec_default_get_format(context, formats);
+}
+
 } // namespace
 
 FFMpegReaderImplementation::FFMpegReaderImplementation(FileLocation *location, QByteArray *data, const AudioMsgId &audio) : ReaderImplementation(location, data)
@@ -162,11 +225,16 @@ ReaderImplementation::ReadResult FFMpegReaderImplementation::readFramesTill(Time
 		if (_frameRead && _frameTime > frameMs) {
 			return ReadResult::Success;
 		}
+		const auto framesCount = _skipFrames
+			? kSkipFramesCount
+			: kKeepUpFramesCount;
 		auto readResult = readNextFrame();
-		if (readResult != ReadResult::Success || _frameTime > frameMs) {
-			return readResult;
+		for (auto i = 1; i != framesCount; ++i) {
+			if (readResult != ReadResult::Success || _frameTime > frameMs) {
+				return readResult;
+			}
+			readResult = readNextFrame();
 		}
-		readResult = readNextFrame();
 		if (_frameTime <= frameMs) {
 			_frameTime = frameMs + 5; // keep up
 		}
@@ -182,17 +250,26 @@ ReaderImplementation::ReadResult FFMpegReaderImplementation::readFramesTill(Time
 		}
 	}
 	while (_frameTime <= correctMs) {
+		// Frames this late behind the audio are never shown, so while
+		// catching up the decoder may skip the non-reference ones.
+		setDropNonReferenceFrames(correctMs - _frameTime > kDropFramesLag);
 		auto readResult = readNextFrame();
 		if (readResult != ReadResult::Success) {
+			setDropNonReferenceFrames(false);
 			return readResult;
 		}
 	}
+	setDropNonReferenceFrames(false);
 	if (frameMs >= 0) {
 		_frameTimeCorrection = frameMs - correctMs;
 	}
 	return ReadResult::Success;
 }
 
+void FFMpegReaderImplementation::setDropNonReferenceFrames(bool drop) {
+	_codecContext->skip_frame = drop ? AVDISCARD_NONREF : AVDISCARD_DEFAULT;
+}
+
 TimeMs FFMpegReaderImplementation::frameRealTime() const {
 	return _frameMs;
 }
@@ -222,26 +299,41 @@ bool FFMpegReaderImplementation::renderFrame(QImage &to, bool &hasAlpha, const Q
 	if (!size.isEmpty() && rotationSwapWidthHeight()) {
 		toSize.transpose();
 	}
-	if (to.isNull() || to.size() != toSize || !to.isDetached() || !isAlignedImage(to)) {
-		to = createAlignedImage(toSize);
+	const auto frame = softwareFrame();
+	if (!frame) {
+		av_frame_unref(_frame);
+		return false;
 	}
-	hasAlpha = (_frame->format == AV_PIX_FMT_BGRA || (_frame->format == -1 && _codecContext->pix_fmt == AV_PIX_FMT_BGRA));
-	if (_frame->width == toSize.width() && _frame->height == toSize.height() && hasAlpha) {
-		int32 sbpl = _frame->linesize[0], dbpl = to.bytesPerLine(), bpl = qMin(sbpl, dbpl);
-		uchar *s = _frame->data[0], *d = to.bits();
-		for (int32 i = 0, l = _frame->height; i < l; ++i) {
+	const auto format = (frame->format == -1)
+		? _codecContext->pix_fmt
+		: frame->format;
+	hasAlpha = (format == AV_PIX_FMT_BGRA);
+
+	// Opaque frames are already premultiplied, so they are drawn
+	// and wrapped in a QPixmap without any conversion.
+	const auto imageFormat = hasAlpha
+		? QImage::Format_ARGB32
+		: QImage::Format_ARGB32_Premultiplied;
+	if (to.isNull() || to.size() != toSize || to.format() != imageFormat || !to.isDetached() || !isAlignedImage(to)) {
+		to = createAlignedImage(toSize, imageFormat);
+	}
+	if (frame->width == toSize.width() && frame->height == toSize.height() && hasAlpha) {
+		int32 sbpl = frame->linesize[0], dbpl = to.bytesPerLine(), bpl = qMin(sbpl, dbpl);
+		uchar *s = frame->data[0], *d = to.bits();
+		for (int32 i = 0, l = frame->height; i < l; ++i) {
 			memcpy(d + i * dbpl, s + i * sbpl, bpl);
 		}
 	} else {
-		if ((_swsSize != toSize) || (_frame->format != -1 && _frame->format != _codecContext->pix_fmt) || !_swsContext) {
+		if ((_swsSize != toSize) || (format != _swsFormat) || !_swsContext) {
 			_swsSize = toSize;
-			_swsContext = sws_getCachedContext(_swsContext, _frame->width, _frame->height, AVPixelFormat(_frame->format), toSize.width(), toSize.height(), AV_PIX_FMT_BGRA, 0, 0, 0, 0);
+			_swsFormat = format;
+			_swsContext = sws_getCachedContext(_swsContext, frame->width, frame->height, AVPixelFormat(format), toSize.width(), toSize.height(), AV_PIX_FMT_BGRA, 0, 0, 0, 0);
 		}
 		// AV_NUM_DATA_POINTERS defined in AVFrame struct
 		uint8_t *toData[AV_NUM_DATA_POINTERS] = { to.bits(), nullptr };
 		int toLinesize[AV_NUM_DATA_POINTERS] = { to.bytesPerLine(), 0 };
 		int res;
-		if ((res = sws_scale(_swsContext, _frame->data, _frame->linesize, 0, _frame->height, toData, toLinesize)) != _swsSize.height()) {
+		if ((res = sws_scale(_swsContext, frame->data, frame->linesize, 0, frame->height, toData, toLinesize)) != _swsSize.height()) {
 			LOG(("Gif Error: Unable to sws_scale to good size %1, height %2, should be %3").arg(logData()).arg(res).arg(_swsSize.height()));
 			return false;
 		}
@@ -267,10 +359,43 @@ bool FFMpegReaderImplementation::renderFrame(QImage &to, bool &hasAlpha, const Q
 		}
 	}
 
+	if (frame != _frame) {
+		av_frame_unref(frame);
+	}
 	av_frame_unref(_frame);
 	return true;
 }
 
+bool FFMpegReaderImplementation::hardwareDecodingAllowed() const {
+	return cHardwareVideoDecoding()
+		&& (_mode != Mode::Inspecting)
+		&& (_codecContext->codec_id == AV_CODEC_ID_H264);
+}
+
+// Hardware decoded frames are copied to the system memory for sws_scale.
+AVFrame *FFMpegReaderImplementation::softwareFrame() {
+	if (_frame->format != kHardwarePixelFormat) {
+		return _frame;
+	}
+	if (!_transferredFrame) {
+		_transferredFrame = av_frame_alloc();
+	} else {
+		av_frame_unref(_transferredFrame);
+	}
+	const auto res = av_hwframe_transfer_data(_transferredFrame, _frame, 0);
+	if (res < 0) {
+		char err[AV_ERROR_MAX_STRING_SIZE] = { 0 };
+		LOG(("Gif Error: Unable to av_hwframe_transfer_data %1, error %2, %3").arg(logData()).arg(res).arg(av_make_error_string(err, sizeof(err), res)));
+
+		// Next readers will decode in software.
+		HardwareDeviceBroken();
+		return nullptr;
+	}
+	_transferredFrame->width = _frame->width;
+	_transferredFrame->height = _frame->height;
+	return _transferredFrame;
+}
+
 FFMpegReaderImplementation::Rotation FFMpegReaderImplementation::rotationFromDegrees(int degrees) const {
 	switch (degrees) {
 	case 90: return Rotation::Degrees90;
@@ -343,6 +468,13 @@ bool FFMpegReaderImplementation::start(Mode mode, TimeMs &positionMs) {
 
 	_codec = avcodec_find_decoder(_codecContext->codec_id);
 
+	if (hardwareDecodingAllowed()) {
+		if (const auto device = HardwareDeviceRef()) {
+			_codecContext->hw_device_ctx = device;
+			_codecContext->get_format = GetHardwareFormat;
+		}
+	}
+
 	_audioStreamId = av_find_best_stream(_fmtContext, AVMEDIA_TYPE_AUDIO, -1, -1, 0, 0);
 	if (_mode == Mode::Inspecting) {
 		_hasAudioStream = (_audioStreamId >= 0);
@@ -386,15 +518,8 @@ bool FFMpegReaderImplementation::start(Mode mode, TimeMs &positionMs) {
 			}
 		}
 	}
-	if (positionMs > 0) {
-		const auto timeBase = _fmtContext->streams[_streamId]->time_base;
-		const auto timeStamp = (positionMs * timeBase.den)
-			/ (1000LL * timeBase.num);
-		if (av_seek_frame(_fmtContext, _streamId, timeStamp, 0) < 0) {
-			if (av_seek_frame(_fmtContext, _streamId, timeStamp, AVSEEK_FLAG_BACKWARD) < 0) {
-				return false;
-			}
-		}
+	if (positionMs > 0 && !seekToNearestKeyframe(positionMs)) {
+		return false;
 	}
 
 	AVPacket packet;
@@ -415,15 +540,8 @@ bool FFMpegReaderImplementation::start(Mode mode, TimeMs &positionMs) {
 }
 
 bool FFMpegReaderImplementation::inspectAt(TimeMs &positionMs) {
-	if (positionMs > 0) {
-		const auto timeBase = _fmtContext->streams[_streamId]->time_base;
-		const auto timeStamp = (positionMs * timeBase.den)
-			/ (1000LL * timeBase.num);
-		if (av_seek_frame(_fmtContext, _streamId, timeStamp, 0) < 0) {
-			if (av_seek_frame(_fmtContext, _streamId, timeStamp, AVSEEK_FLAG_BACKWARD) < 0) {
-				return false;
-			}
-		}
+	if (positionMs > 0 && !seekToNearestKeyframe(positionMs)) {
+		return false;
 	}
 
 	_packetQueue.clear();
@@ -441,6 +559,30 @@ bool FFMpegReaderImplementation::inspectAt(TimeMs &positionMs) {
 	return true;
 }
 
+bool FFMpegReaderImplementation::seekToNearestKeyframe(TimeMs positionMs) {
+	const auto stream = _fmtContext->streams[_streamId];
+	const auto timeBase = stream->time_base;
+	const auto timeStamp = (positionMs * timeBase.den)
+		/ (1000LL * timeBase.num);
+
+	// The demuxer fills the keyframe index when the file is opened. By
+	// default it seeks to the first keyframe after the position, so check
+	// whether the one before it is closer.
+	const auto before = av_index_search_timestamp(
+		stream,
+		timeStamp,
+		AVSEEK_FLAG_BACKWARD);
+	const auto after = av_index_search_timestamp(stream, timeStamp, 0);
+	const auto backward = (before >= 0)
+		&& (after < 0
+			|| (timeStamp - stream->index_entries[before].timestamp
+				< stream->index_entries[after].timestamp - timeStamp));
+	const auto first = backward ? AVSEEK_FLAG_BACKWARD : 0;
+	const auto second = backward ? 0 : AVSEEK_FLAG_BACKWARD;
+	return (av_seek_frame(_fmtContext, _streamId, timeStamp, first) >= 0)
+		|| (av_seek_frame(_fmtContext, _streamId, timeStamp, second) >= 0);
+}
+
 bool FFMpegReaderImplementation::isGifv() const {
 	if (_hasAudioStream) {
 		return false;
@@ -478,6 +620,9 @@ FFMpegReaderImplementation::~FFMpegReaderImplementation() {
 	}
 	if (_fmtContext) avformat_free_context(_fmtContext);
 	av_frame_free(&_frame);
+	if (_transferredFrame) {
+		av_frame_free(&_transferredFrame);
+	}
 }
 
 FFMpegReaderImplementation::PacketResult FFMpegReaderImplementation::readPacket(AVPacket *packet) {
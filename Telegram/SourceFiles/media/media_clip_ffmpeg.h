@@ -48,6 +48,8 @@ public:
 private:
 	ReadResult readNextFrame();
 	void processReadFrame();
+	void setDropNonReferenceFrames(bool drop);
+	bool seekToNearestKeyframe(TimeMs positionMs);
 
 	enum class PacketResult {
 		Ok,
@@ -70,6 +72,9 @@ private:
 		return (_rotation == Rotation::Degrees90) || (_rotation == Rotation::Degrees270);
 	}
 
+	bool hardwareDecodingAllowed() const;
+	AVFrame *softwareFrame();
+
 	void startPacket();
 	void finishPacket();
 	void clearPacketQueue();
@@ -88,6 +93,7 @@ private:
 	AVCodecContext *_codecContext = nullptr;
 	int _streamId = 0;
 	AVFrame *_frame = nullptr;
+	AVFrame *_transferredFrame = nullptr;
 	bool _opened = false;
 	bool _hadFrame = false;
 	bool _frameRead = false;
@@ -109,6 +115,7 @@ private:
 	int _height = 0;
 	SwsContext *_swsContext = nullptr;
 	QSize _swsSize;
+	int _swsFormat = AV_PIX_FMT_NONE;
 
 	TimeMs _frameMs = 0;
 	int _nextFrameDelay = 0;
@@ -12,7 +12,13 @@ namespace Clip {
 namespace internal {
 
 void ReaderImplementation::initDevice() {
-	if (_data->isEmpty()) {
+	if (_streamed) {
+		_streamedDevice = std::make_unique<Storage::StreamedDevice>(
+			_streamed);
+		_dataSize = _streamed->size();
+		_device = _streamedDevice.get();
+		return;
+	} else if (_data->isEmpty()) {
 		if (_file.isOpen()) _file.close();
 		_file.setFileName(_location->name());
 		_dataSize = _file.size();
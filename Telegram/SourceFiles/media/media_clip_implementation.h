@@ -7,6 +7,8 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 */
 #pragma once
 
+#include "storage/storage_streamed_file.h"
+
 class FileLocation;
 
 namespace Media {
@@ -51,13 +53,27 @@ public:
 		return _dataSize;
 	}
 
+	// Reads the file while it is being downloaded instead of location.
+	void setStreamedFile(std::shared_ptr<Storage::StreamedFile> file) {
+		_streamed = std::move(file);
+	}
+
+	// When frames are read with a lower rate than the clip has, the ones
+	// in between are skipped instead of slowing the clip down.
+	void setSkipFrames(bool skip) {
+		_skipFrames = skip;
+	}
+
 protected:
 	FileLocation *_location;
 	QByteArray *_data;
 	QFile _file;
 	QBuffer _buffer;
+	std::shared_ptr<Storage::StreamedFile> _streamed;
+	std::unique_ptr<Storage::StreamedDevice> _streamedDevice;
 	QIODevice *_device = nullptr;
 	int64 _dataSize = 0;
+	bool _skipFrames = false;
 
 	void initDevice();
 
@@ -9,12 +9,16 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 
 #include "data/data_document.h"
 #include "storage/file_download.h"
+#include "storage/storage_streamed_file.h"
 #include "media/media_clip_ffmpeg.h"
 #include "media/media_clip_qtgif.h"
 #include "media/media_clip_check_streaming.h"
 #include "mainwidget.h"
 #include "mainwindow.h"
 
+#include <QtCore/QWaitCondition>
+#include <atomic>
+
 extern "C" {
 #include <libavcodec/avcodec.h>
 #include <libavformat/avformat.h>
@@ -26,8 +30,32 @@ namespace Media {
 namespace Clip {
 namespace {
 
-QVector<QThread*> threads;
-QVector<Manager*> managers;
+constexpr auto kSmallFrameArea = 128 * 128;
+constexpr auto kSmallFrameDelay = TimeMs(1000 / 15);
+constexpr auto kInactiveFrameDelay = TimeMs(1000 / 10);
+
+QThread *schedulerThread = nullptr;
+Manager *scheduler = nullptr;
+std::atomic<bool> WindowActive { true };
+
+// Short animations are looped from the frames kept in memory.
+constexpr auto kLoopMaxDuration = TimeMs(3000);
+constexpr auto kLoopMaxBytes = int64(8 * 1024 * 1024);
+constexpr auto kLoopBytesBudget = int64(64 * 1024 * 1024);
+
+std::atomic<int64> LoopBytes { 0 };
+
+bool ReserveLoopBytes(int64 bytes) {
+	if (LoopBytes.fetch_add(bytes) + bytes > kLoopBytesBudget) {
+		LoopBytes.fetch_sub(bytes);
+		return false;
+	}
+	return true;
+}
+
+void ReleaseLoopBytes(int64 bytes) {
+	LoopBytes.fetch_sub(bytes);
+}
 
 QImage PrepareFrameImage(const FrameRequest &request, const QImage &original, bool hasAlpha, QImage &cache) {
 	auto needResize = (original.width() != request.framew) || (original.height() != request.frameh);
@@ -93,27 +121,27 @@ Reader::Reader(not_null<DocumentData*> document, FullMsgId msgId, Callback &&cal
 , _mode(mode)
 , _audioMsgId(document, msgId, (mode == Mode::Video) ? rand_value<uint32>() : 0)
 , _seekPositionMs(seekMs) {
-	init(document->location(), document->data());
+	init(
+		document->location(),
+		document->data(),
+		document->loaded() ? nullptr : document->stream());
 }
 
-void Reader::init(const FileLocation &location, const QByteArray &data) {
-	if (threads.size() < ClipThreadsCount) {
-		_threadIndex = threads.size();
-		threads.push_back(new QThread());
-		managers.push_back(new Manager(threads.back()));
-		threads.back()->start();
-	} else {
-		_threadIndex = int32(rand_value<uint32>() % threads.size());
-		int32 loadLevel = 0x7FFFFFFF;
-		for (int32 i = 0, l = threads.size(); i < l; ++i) {
-			int32 level = managers.at(i)->loadLevel();
-			if (level < loadLevel) {
-				_threadIndex = i;
-				loadLevel = level;
-			}
-		}
+void Reader::init(
+		const FileLocation &location,
+		const QByteArray &data,
+		std::shared_ptr<Storage::StreamedFile> streamed) {
+	_streamed = streamed;
+	if (!scheduler) {
+		schedulerThread = new QThread();
+		scheduler = new Manager(schedulerThread);
+		schedulerThread->start();
 	}
-	managers.at(_threadIndex)->append(this, location, data);
+	scheduler->append(
+		this,
+		location,
+		data,
+		std::move(streamed));
 }
 
 Reader::Frame *Reader::frameToShow(int32 *index) const { // 0 means not ready
@@ -185,15 +213,15 @@ void Reader::moveToNextWrite() const {
 	}
 }
 
-void Reader::callback(Reader *reader, int32 threadIndex, Notification notification) {
+void Reader::callback(Reader *reader, Notification notification) {
 	// check if reader is not deleted already
-	if (managers.size() > threadIndex && managers.at(threadIndex)->carries(reader) && reader->_callback) {
+	if (scheduler && scheduler->carries(reader) && reader->_callback) {
 		reader->_callback(notification);
 	}
 }
 
 void Reader::start(int32 framew, int32 frameh, int32 outerw, int32 outerh, ImageRoundRadius radius, RectParts corners) {
-	if (managers.size() <= _threadIndex) error();
+	if (!scheduler) error();
 	if (_state == State::Error) return;
 
 	if (_step.loadAcquire() == WaitingForRequestStep) {
@@ -208,7 +236,7 @@ void Reader::start(int32 framew, int32 frameh, int32 outerw, int32 outerh, Image
 		request.corners = corners;
 		_frames[0].request = _frames[1].request = _frames[2].request = request;
 		moveToNextShow();
-		managers.at(_threadIndex)->start(this);
+		scheduler->start(this);
 	}
 }
 
@@ -224,9 +252,9 @@ QPixmap Reader::current(int32 framew, int32 frameh, int32 outerw, int32 outerh,
 		frame->displayed.storeRelease(1);
 		if (_autoPausedGif.loadAcquire()) {
 			_autoPausedGif.storeRelease(0);
-			if (managers.size() <= _threadIndex) error();
+			if (!scheduler) error();
 			if (_state != State::Error) {
-				managers.at(_threadIndex)->update(this);
+				scheduler->update(this);
 			}
 		}
 	} else {
@@ -257,9 +285,9 @@ QPixmap Reader::current(int32 framew, int32 frameh, int32 outerw, int32 outerh,
 
 	moveToNextShow();
 
-	if (managers.size() <= _threadIndex) error();
+	if (!scheduler) error();
 	if (_state != State::Error) {
-		managers.at(_threadIndex)->update(this);
+		scheduler->update(this);
 	}
 
 	return frame->pix;
@@ -288,6 +316,16 @@ bool Reader::ready() const {
 	return false;
 }
 
+int64 Reader::framesMemoryUsage() const {
+	const auto bytes = [](int width, int height) {
+		return int64(width) * height * 4;
+	};
+	const auto &request = _frames[0].request;
+	const auto perFrame = bytes(_width, _height)
+		+ bytes(request.outerw, request.outerh);
+	return perFrame * int64(base::array_size(_frames));
+}
+
 bool Reader::hasAudio() const {
 	return ready() ? _hasAudio : false;
 }
@@ -304,11 +342,11 @@ TimeMs Reader::getDurationMs() const {
 }
 
 void Reader::pauseResumeVideo() {
-	if (managers.size() <= _threadIndex) error();
+	if (!scheduler) error();
 	if (_state == State::Error) return;
 
 	_videoPauseRequest.storeRelease(1 - _videoPauseRequest.loadAcquire());
-	managers.at(_threadIndex)->start(this);
+	scheduler->start(this);
 }
 
 bool Reader::videoPaused() const {
@@ -328,9 +366,12 @@ State Reader::state() const {
 }
 
 void Reader::stop() {
-	if (managers.size() <= _threadIndex) error();
+	if (_streamed) {
+		_streamed->interrupt();
+	}
+	if (!scheduler) error();
 	if (_state != State::Error) {
-		managers.at(_threadIndex)->stop(this);
+		scheduler->stop(this);
 		_width = _height = 0;
 	}
 }
@@ -351,12 +392,18 @@ Reader::~Reader() {
 
 class ReaderPrivate {
 public:
-	ReaderPrivate(Reader *reader, const FileLocation &location, const QByteArray &data) : _interface(reader)
+	ReaderPrivate(
+		Reader *reader,
+		const FileLocation &location,
+		const QByteArray &data,
+		std::shared_ptr<Storage::StreamedFile> streamed)
+	: _interface(reader)
 	, _mode(reader->mode())
 	, _audioMsgId(reader->audioMsgId())
 	, _seekPositionMs(reader->seekPositionMs())
-	, _data(data) {
-		if (_data.isEmpty()) {
+	, _data(data)
+	, _streamed(std::move(streamed)) {
+		if (_data.isEmpty() && !_streamed) {
 			_location = std::make_unique<FileLocation>(location);
 			if (!_location->accessEnable()) {
 				error();
@@ -378,6 +425,7 @@ public:
 
 				auto firstFramePositionMs = TimeMs(0);
 				auto reader = std::make_unique<internal::FFMpegReaderImplementation>(_location.get(), &_data, AudioMsgId());
+				reader->setStreamedFile(_streamed);
 				if (reader->start(internal::ReaderImplementation::Mode::Normal, firstFramePositionMs)) {
 					auto firstFrameReadResult = reader->readFramesTill(-1, ms);
 					if (firstFrameReadResult == internal::ReaderImplementation::ReadResult::Success) {
@@ -437,7 +485,18 @@ public:
 	}
 
 	ProcessResult finishProcess(TimeMs ms) {
-		auto frameMs = _seekPositionMs + ms - _animationStarted;
+		// Read the frame that would be shown after the delay,
+		// skipping all the frames before it.
+		const auto delay = minimalFrameDelay();
+		auto frameMs = _seekPositionMs + ms - _animationStarted + delay;
+		if (_loop.state == LoopState::Ready) {
+			if (sameLoopRequest() && delay >= _loop.delay) {
+				return finishLoopProcess(frameMs);
+			}
+			clearLoop(LoopState::Waiting);
+		}
+		_implementation->setSkipFrames(delay > 0);
+
 		auto readResult = _implementation->readFramesTill(frameMs, ms);
 		if (readResult == internal::ReaderImplementation::ReadResult::EndOfFile) {
 			stop(Player::State::StoppedAtEnd);
@@ -457,24 +516,138 @@ public:
 		if (!renderFrame()) {
 			return error();
 		}
+		recordLoopFrame(delay);
 		return ProcessResult::CopyFrame;
 	}
 
+	ProcessResult finishLoopProcess(TimeMs frameMs) {
+		const auto count = int(_loop.frames.size());
+		auto steps = 0;
+		do {
+			_loop.frameTime += _loop.frames[_loop.index].durationMs;
+			_loop.index = (_loop.index + 1) % count;
+		} while (_loop.frameTime <= frameMs && ++steps < count);
+		if (_loop.frameTime <= frameMs) {
+			_loop.frameTime = frameMs + 5; // keep up
+		}
+
+		const auto &shown = _loop.frames[_loop.index];
+		_nextFramePositionMs = shown.positionMs;
+		_nextFrameWhen = _animationStarted + _loop.frameTime;
+		frame()->original = shown.image;
+		frame()->alpha = shown.alpha;
+		prepareFrame();
+		return ProcessResult::CopyFrame;
+	}
+
+	bool loopAllowed() const {
+		return (_mode == Reader::Mode::Gif)
+			&& !_hasAudio
+			&& !_seekPositionMs
+			&& (_durationMs > 0)
+			&& (_durationMs < kLoopMaxDuration);
+	}
+
+	bool sameLoopRequest() const {
+		return (_request.factor == _loop.request.factor)
+			&& (_request.framew == _loop.request.framew)
+			&& (_request.frameh == _loop.request.frameh);
+	}
+
+	// The second loop is recorded, so that all its frames are rendered
+	// with the same request, and the third one is shown from memory.
+	void recordLoopFrame(TimeMs delay) {
+		const auto positionMs = _nextFramePositionMs;
+		const auto presentationMs = _implementation->framePresentationTime();
+		const auto looped = (positionMs < _loop.lastPositionMs);
+		_loop.lastPositionMs = positionMs;
+		if (_loop.state == LoopState::Waiting) {
+			if (!looped || !loopAllowed()) {
+				return;
+			}
+			_loop.state = LoopState::Recording;
+			_loop.request = _request;
+			_loop.delay = delay;
+		} else if (_loop.state != LoopState::Recording) {
+			return;
+		} else if (!sameLoopRequest() || delay != _loop.delay) {
+			clearLoop(LoopState::Waiting);
+			_loop.lastPositionMs = positionMs;
+			return;
+		} else if (looped) {
+			auto &frames = _loop.frames;
+			for (auto i = 0, count = int(frames.size()); i != count; ++i) {
+				const auto next = (i + 1 < count)
+					? frames[i + 1].durationMs
+					: presentationMs;
+				frames[i].durationMs = std::max(
+					next - frames[i].durationMs,
+					TimeMs(1));
+			}
+			_loop.state = LoopState::Ready;
+			_loop.index = 0;
+			_loop.frameTime = presentationMs;
+			return;
+		}
+		const auto &image = frame()->original;
+		const auto bytes = int64(image.bytesPerLine()) * image.height();
+		if (_loop.bytes + bytes > kLoopMaxBytes || !ReserveLoopBytes(bytes)) {
+			clearLoop(LoopState::Disabled);
+			return;
+		}
+		_loop.bytes += bytes;
+
+		// The duration is counted when the loop is finished.
+		auto recorded = LoopFrame();
+		recorded.image = image;
+		recorded.alpha = frame()->alpha;
+		recorded.positionMs = positionMs;
+		recorded.durationMs = presentationMs;
+		_loop.frames.push_back(std::move(recorded));
+	}
+
+	void clearLoop(LoopState state) {
+		ReleaseLoopBytes(_loop.bytes);
+		_loop = Loop();
+		_loop.state = state;
+	}
+
+	// Animations that are small or in an inactive window are shown
+	// with a lower frame rate.
+	TimeMs minimalFrameDelay() const {
+		if (_mode != Reader::Mode::Gif || _hasAudio) {
+			return 0;
+		} else if (!WindowActive.load(std::memory_order_relaxed)) {
+			return kInactiveFrameDelay;
+		}
+		const auto factor = _request.factor;
+		const auto area = (_request.outerw / factor)
+			* (_request.outerh / factor);
+		return (area <= kSmallFrameArea) ? kSmallFrameDelay : 0;
+	}
+
 	bool renderFrame() {
 		Assert(frame() != 0 && _request.valid());
+
+		// Release the previous frame, so that its image is reused.
+		frame()->pix = QPixmap();
 		if (!_implementation->renderFrame(frame()->original, frame()->alpha, QSize(_request.framew, _request.frameh))) {
 			return false;
 		}
+		prepareFrame();
+		return true;
+	}
+
+	void prepareFrame() {
 		frame()->original.setDevicePixelRatio(_request.factor);
 		frame()->pix = QPixmap();
 		frame()->pix = PrepareFrame(_request, frame()->original, frame()->alpha, frame()->cache);
 		frame()->when = _nextFrameWhen;
 		frame()->positionMs = _nextFramePositionMs;
-		return true;
 	}
 
 	bool init() {
-		if (_data.isEmpty() && QFileInfo(_location->name()).size() <= Storage::kMaxAnimationInMemory) {
+		if (_data.isEmpty() && !_streamed && QFileInfo(_location->name()).size() <= Storage::kMaxAnimationInMemory) {
 			QFile f(_location->name());
 			if (f.open(QIODevice::ReadOnly)) {
 				_data = f.readAll();
@@ -485,6 +658,7 @@ public:
 		}
 
 		_implementation = std::make_unique<internal::FFMpegReaderImplementation>(_location.get(), &_data, _audioMsgId);
+		_implementation->setStreamedFile(_streamed);
 //		_implementation = new QtGifReaderImplementation(_location, &_data);
 
 		auto implementationMode = [this]() {
@@ -531,6 +705,7 @@ public:
 
 	void stop(Player::State audioState) {
 		_implementation = nullptr;
+		clearLoop(LoopState::Disabled);
 		if (_hasAudio) {
 			Player::mixer()->stop(_audioMsgId, audioState);
 		}
@@ -557,6 +732,7 @@ private:
 	TimeMs _seekPositionMs = 0;
 
 	QByteArray _data;
+	std::shared_ptr<Storage::StreamedFile> _streamed;
 	std::unique_ptr<FileLocation> _location;
 	bool _accessed = false;
 
@@ -592,11 +768,123 @@ private:
 	bool _started = false;
 	TimeMs _videoPausedAtMs = 0;
 
+	enum class LoopState {
+		Waiting,
+		Recording,
+		Ready,
+		Disabled,
+	};
+	struct LoopFrame {
+		QImage image;
+		bool alpha = true;
+		TimeMs positionMs = 0;
+		TimeMs durationMs = 0;
+	};
+	struct Loop {
+		LoopState state = LoopState::Waiting;
+		std::vector<LoopFrame> frames;
+		FrameRequest request;
+		TimeMs delay = 0;
+		TimeMs lastPositionMs = 0;
+		int64 bytes = 0;
+		int index = 0;
+		TimeMs frameTime = 0;
+	};
+	Loop _loop;
+
 	friend class Manager;
 
 };
 
-Manager::Manager(QThread *thread) : _processingInThread(0), _needReProcess(false) {
+class DecodePool {
+public:
+	explicit DecodePool(int threadsCount);
+	~DecodePool();
+
+	void submit(TimeMs deadline, FnMut<void()> job);
+
+private:
+	class Thread : public QThread {
+	public:
+		explicit Thread(not_null<DecodePool*> pool) : _pool(pool) {
+		}
+
+	protected:
+		void run() override {
+			_pool->run();
+		}
+
+	private:
+		not_null<DecodePool*> _pool;
+
+	};
+	struct Job {
+		TimeMs deadline = 0;
+		FnMut<void()> callback;
+	};
+	static bool Later(const Job &a, const Job &b) {
+		return (a.deadline > b.deadline);
+	}
+
+	void run();
+
+	std::vector<std::unique_ptr<Thread>> _threads;
+	std::vector<Job> _jobs; // Heap with the earliest deadline on top.
+	QMutex _mutex;
+	QWaitCondition _added;
+	bool _stopping = false;
+
+};
+
+DecodePool::DecodePool(int threadsCount) {
+	for (auto i = 0; i != threadsCount; ++i) {
+		_threads.push_back(std::make_unique<Thread>(this));
+		_threads.back()->start();
+	}
+}
+
+void DecodePool::submit(TimeMs deadline, FnMut<void()> job) {
+	QMutexLocker lock(&_mutex);
+	if (_stopping) {
+		return;
+	}
+	_jobs.push_back({ deadline, std::move(job) });
+	std::push_heap(_jobs.begin(), _jobs.end(), Later);
+	_added.wakeOne();
+}
+
+void DecodePool::run() {
+	QMutexLocker lock(&_mutex);
+	while (!_stopping) {
+		if (_jobs.empty()) {
+			_added.wait(&_mutex);
+			continue;
+		}
+		std::pop_heap(_jobs.begin(), _jobs.end(), Later);
+		auto job = std::move(_jobs.back().callback);
+		_jobs.pop_back();
+
+		lock.unlock();
+		base::take(job)();
+		lock.relock();
+	}
+}
+
+DecodePool::~DecodePool() {
+	{
+		QMutexLocker lock(&_mutex);
+		_stopping = true;
+		_added.wakeAll();
+	}
+	for (auto i = 0, count = int(_threads.size()); i != count; ++i) {
+		DEBUG_LOG(("Waiting for clip decoding thread to finish: %1").arg(i));
+		_threads[i]->wait();
+	}
+}
+
+Manager::Manager(QThread *thread)
+: _pool(std::make_unique<DecodePool>(
+	qBound(1, QThread::idealThreadCount(), int(ClipThreadsCount)))) {
 	moveToThread(thread);
 	connect(thread, SIGNAL(started()), this, SLOT(process()));
 	connect(thread, SIGNAL(finished()), this, SLOT(finish()));
@@ -609,9 +897,16 @@ Manager::Manager(QThread *thread) : _processingInThread(0), _needReProcess(false
 	anim::registerClipManager(this);
 }
 
-void Manager::append(Reader *reader, const FileLocation &location, const QByteArray &data) {
-	reader->_private = new ReaderPrivate(reader, location, data);
-	_loadLevel.fetchAndAddRelaxed(AverageGifSize);
+void Manager::append(
+		Reader *reader,
+		const FileLocation &location,
+		const QByteArray &data,
+		std::shared_ptr<Storage::StreamedFile> streamed) {
+	reader->_private = new ReaderPrivate(
+		reader,
+		location,
+		data,
+		std::move(streamed));
 	update(reader);
 }
 
@@ -643,6 +938,20 @@ bool Manager::carries(Reader *reader) const {
 	return _readerPointers.contains(reader);
 }
 
+int Manager::readersCount() const {
+	QMutexLocker lock(&_readerPointersMutex);
+	return _readerPointers.size();
+}
+
+int64 Manager::framesMemoryUsage() const {
+	QMutexLocker lock(&_readerPointersMutex);
+	auto result = int64(0);
+	for (auto i = _readerPointers.cbegin(); i != _readerPointers.cend(); ++i) {
+		result += i.key()->framesMemoryUsage();
+	}
+	return result;
+}
+
 Manager::ReaderPointers::iterator Manager::unsafeFindReaderPointer(ReaderPrivate *reader) {
 	ReaderPointers::iterator it = _readerPointers.find(reader->_interface);
 
@@ -663,14 +972,14 @@ bool Manager::handleProcessResult(ReaderPrivate *reader, ProcessResult result, T
 	if (result == ProcessResult::Error) {
 		if (it != _readerPointers.cend()) {
 			it.key()->error();
-			emit callback(it.key(), it.key()->threadIndex(), NotificationReinit);
+			emit callback(it.key(), NotificationReinit);
 			_readerPointers.erase(it);
 		}
 		return false;
 	} else if (result == ProcessResult::Finished) {
 		if (it != _readerPointers.cend()) {
 			it.key()->finished();
-			emit callback(it.key(), it.key()->threadIndex(), NotificationReinit);
+			emit callback(it.key(), NotificationReinit);
 		}
 		return false;
 	}
@@ -679,7 +988,6 @@ bool Manager::handleProcessResult(ReaderPrivate *reader, ProcessResult result, T
 	}
 
 	if (result == ProcessResult::Started) {
-		_loadLevel.fetchAndAddRelaxed(reader->_width * reader->_height - AverageGifSize);
 		it.key()->_durationMs = reader->_durationMs;
 		it.key()->_hasAudio = reader->_hasAudio;
 	}
@@ -707,37 +1015,29 @@ bool Manager::handleProcessResult(ReaderPrivate *reader, ProcessResult result, T
 		if (result == ProcessResult::Started) {
 			reader->startedAt(ms);
 			it.key()->moveToNextWrite();
-			emit callback(it.key(), it.key()->threadIndex(), NotificationReinit);
+			emit callback(it.key(), NotificationReinit);
 		}
 	} else if (result == ProcessResult::Paused) {
 		it.key()->moveToNextWrite();
-		emit callback(it.key(), it.key()->threadIndex(), NotificationReinit);
+		emit callback(it.key(), NotificationReinit);
 	} else if (result == ProcessResult::Repaint) {
 		it.key()->moveToNextWrite();
-		emit callback(it.key(), it.key()->threadIndex(), NotificationRepaint);
+		emit callback(it.key(), NotificationRepaint);
 	}
 	return true;
 }
 
 Manager::ResultHandleState Manager::handleResult(ReaderPrivate *reader, ProcessResult result, TimeMs ms) {
 	if (!handleProcessResult(reader, result, ms)) {
-		_loadLevel.fetchAndAddRelaxed(-1 * (reader->_width > 0 ? reader->_width * reader->_height : AverageGifSize));
-		delete reader;
 		return ResultHandleRemove;
 	}
 
-	_processingInThread->eventDispatcher()->processEvents(QEventLoop::AllEvents);
-	if (_processingInThread->isInterruptionRequested()) {
-		return ResultHandleStop;
-	}
-
 	if (result == ProcessResult::Repaint) {
 		{
 			QMutexLocker lock(&_readerPointersMutex);
 			auto it = constUnsafeFindReaderPointer(reader);
 			if (it != _readerPointers.cend()) {
 				int32 index = 0;
-				Reader *r = it.key();
 				Reader::Frame *frame = it.key()->frameToWrite(&index);
 				if (frame) {
 					frame->clear();
@@ -753,14 +1053,45 @@ Manager::ResultHandleState Manager::handleResult(ReaderPrivate *reader, ProcessR
 	return ResultHandleContinue;
 }
 
-void Manager::process() {
-	if (_processingInThread) {
-		_needReProcess = true;
-		return;
+void Manager::processReader(ReaderPrivate *reader) {
+	const auto ms = getms();
+	const auto state = handleResult(reader, reader->process(ms), ms);
+	{
+		QMutexLocker lock(&_processedMutex);
+		_processed.emplace_back(reader, state);
+	}
+	emit processDelayed();
+}
+
+void Manager::applyProcessed() {
+	auto processed = [&] {
+		QMutexLocker lock(&_processedMutex);
+		return base::take(_processed);
+	}();
+	const auto ms = getms();
+	for (const auto [reader, state] : processed) {
+		const auto i = _readers.find(reader);
+		Assert(i != _readers.end() && i->decoding);
+
+		if (state == ResultHandleRemove) {
+			delete reader;
+			_readers.erase(i);
+			continue;
+		}
+		i->decoding = false;
+		if (reader->_videoPausedAtMs) {
+			i->when = ms + 86400 * 1000ULL;
+		} else if (reader->_nextFrameWhen && reader->_started) {
+			i->when = reader->_nextFrameWhen;
+		} else {
+			i->when = ms + 86400 * 1000ULL;
+		}
 	}
+}
 
+void Manager::process() {
 	_timer.stop();
-	_processingInThread = thread();
+	applyProcessed();
 
 	bool checkAllReaders = false;
 	auto ms = getms(), minms = ms + 86400 * 1000LL;
@@ -770,9 +1101,12 @@ void Manager::process() {
 			if (it->loadAcquire() && it.key()->_private != nullptr) {
 				auto i = _readers.find(it.key()->_private);
 				if (i == _readers.cend()) {
-					_readers.insert(it.key()->_private, 0);
+					_readers.insert(it.key()->_private, Scheduled());
+				} else if (i->decoding) {
+					// Apply the changes when the decoding thread is done.
+					continue;
 				} else {
-					i.value() = ms;
+					i->when = ms;
 					if (i.key()->_autoPausedGif && !it.key()->_autoPausedGif.loadAcquire()) {
 						i.key()->_autoPausedGif = false;
 					}
@@ -792,52 +1126,42 @@ void Manager::process() {
 
 	for (auto i = _readers.begin(), e = _readers.end(); i != e;) {
 		ReaderPrivate *reader = i.key();
-		if (i.value() <= ms) {
-			ResultHandleState state = handleResult(reader, reader->process(ms), ms);
-			if (state == ResultHandleRemove) {
-				i = _readers.erase(i);
-				continue;
-			} else if (state == ResultHandleStop) {
-				_processingInThread = 0;
-				return;
-			}
-			ms = getms();
-			if (reader->_videoPausedAtMs) {
-				i.value() = ms + 86400 * 1000ULL;
-			} else if (reader->_nextFrameWhen && reader->_started) {
-				i.value() = reader->_nextFrameWhen;
-			} else {
-				i.value() = (ms + 86400 * 1000ULL);
-			}
+		if (i->decoding) {
+			++i;
+			continue;
+		} else if (i->when <= ms) {
+			// A reader is processed by one thread at a time,
+			// so a heavy video can't take more than one of them.
+			i->decoding = true;
+			_pool->submit(i->when, [=] { processReader(reader); });
+			++i;
+			continue;
 		} else if (checkAllReaders) {
 			QMutexLocker lock(&_readerPointersMutex);
 			auto it = constUnsafeFindReaderPointer(reader);
 			if (it == _readerPointers.cend()) {
-				_loadLevel.fetchAndAddRelaxed(-1 * (reader->_width > 0 ? reader->_width * reader->_height : AverageGifSize));
 				delete reader;
 				i = _readers.erase(i);
 				continue;
 			}
 		}
-		if (!reader->_autoPausedGif && i.value() < minms) {
-			minms = i.value();
+		if (!reader->_autoPausedGif && i->when < minms) {
+			minms = i->when;
 		}
 		++i;
 	}
 
 	ms = getms();
-	if (_needReProcess || minms <= ms) {
-		_needReProcess = false;
+	if (minms <= ms) {
 		_timer.start(1);
 	} else {
 		_timer.start(minms - ms);
 	}
-
-	_processingInThread = 0;
 }
 
 void Manager::finish() {
 	_timer.stop();
+	_pool = nullptr;
 	clear();
 }
 
@@ -854,9 +1178,11 @@ void Manager::clear() {
 		delete i.key();
 	}
 	_readers.clear();
+	_processed.clear();
 }
 
 Manager::~Manager() {
+	_pool = nullptr;
 	clear();
 }
 
@@ -902,17 +1228,26 @@ FileMediaInformation::Video PrepareForSending(const QString &fname, const QByteA
 	return result;
 }
 
+void SetWindowActive(bool active) {
+	WindowActive.store(active, std::memory_order_relaxed);
+}
+
+MemoryUsage CollectMemoryUsage() {
+	auto result = MemoryUsage();
+	if (scheduler) {
+		result.readers = scheduler->readersCount();
+		result.framesBytes = scheduler->framesMemoryUsage();
+	}
+	return result;
+}
+
 void Finish() {
-	if (!threads.isEmpty()) {
-		for (int32 i = 0, l = threads.size(); i < l; ++i) {
-			threads.at(i)->quit();
-			DEBUG_LOG(("Waiting for clipThread to finish: %1").arg(i));
-			threads.at(i)->wait();
-			delete managers.at(i);
-			delete threads.at(i);
-		}
-		threads.clear();
-		managers.clear();
+	if (schedulerThread) {
+		schedulerThread->quit();
+		DEBUG_LOG(("Waiting for clipThread to finish."));
+		schedulerThread->wait();
+		delete base::take(scheduler);
+		delete base::take(schedulerThread);
 	}
 }
 
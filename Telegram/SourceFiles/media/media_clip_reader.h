@@ -12,6 +12,10 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 
 class FileLocation;
 
+namespace Storage {
+class StreamedFile;
+} // namespace Storage
+
 namespace Media {
 namespace Clip {
 
@@ -52,7 +56,7 @@ public:
 	Reader(const QString &filepath, Callback &&callback, Mode mode = Mode::Gif, TimeMs seekMs = 0);
 	Reader(not_null<DocumentData*> document, FullMsgId msgId, Callback &&callback, Mode mode = Mode::Gif, TimeMs seekMs = 0);
 
-	static void callback(Reader *reader, int threadIndex, Notification notification); // reader can be deleted
+	static void callback(Reader *reader, Notification notification); // reader can be deleted
 
 	void setAutoplay() {
 		_autoplay = true;
@@ -87,9 +91,6 @@ public:
 		return _autoPausedGif.loadAcquire();
 	}
 	bool videoPaused() const;
-	int threadIndex() const {
-		return _threadIndex;
-	}
 
 	int width() const;
 	int height() const;
@@ -114,10 +115,16 @@ public:
 		return _mode;
 	}
 
+	// Estimated from the frame sizes, without touching the frames.
+	int64 framesMemoryUsage() const;
+
 	~Reader();
 
 private:
-	void init(const FileLocation &location, const QByteArray &data);
+	void init(
+		const FileLocation &location,
+		const QByteArray &data,
+		std::shared_ptr<Storage::StreamedFile> streamed = nullptr);
 
 	Callback _callback;
 	Mode _mode;
@@ -157,10 +164,12 @@ private:
 
 	QAtomicInt _autoPausedGif = 0;
 	QAtomicInt _videoPauseRequest = 0;
-	int32 _threadIndex;
 
 	bool _autoplay = false;
 
+	// Blocked reads are interrupted when the reader is stopped.
+	std::shared_ptr<Storage::StreamedFile> _streamed;
+
 	friend class Manager;
 
 	ReaderPrivate *_private = nullptr;
@@ -182,26 +191,35 @@ enum class ProcessResult {
 	Wait,
 };
 
+class DecodePool;
+
+// Schedules all the readers in one thread, while their frames are decoded
+// by a pool of threads taking the readers with the earliest deadlines.
 class Manager : public QObject {
 	Q_OBJECT
 
 public:
 
 	Manager(QThread *thread);
-	int32 loadLevel() const {
-		return _loadLevel.load();
-	}
-	void append(Reader *reader, const FileLocation &location, const QByteArray &data);
+	void append(
+		Reader *reader,
+		const FileLocation &location,
+		const QByteArray &data,
+		std::shared_ptr<Storage::StreamedFile> streamed);
 	void start(Reader *reader);
 	void update(Reader *reader);
 	void stop(Reader *reader);
 	bool carries(Reader *reader) const;
+
+	int readersCount() const;
+	int64 framesMemoryUsage() const;
+
 	~Manager();
 
 signals:
 	void processDelayed();
 
-	void callback(Media::Clip::Reader *reader, qint32 threadIndex, qint32 notification);
+	void callback(Media::Clip::Reader *reader, qint32 notification);
 
 public slots:
 	void process();
@@ -211,7 +229,6 @@ private:
 
 	void clear();
 
-	QAtomicInt _loadLevel;
 	using ReaderPointers = QMap<Reader*, QAtomicInt>;
 	ReaderPointers _readerPointers;
 	mutable QMutex _readerPointersMutex;
@@ -223,22 +240,41 @@ private:
 
 	enum ResultHandleState {
 		ResultHandleRemove,
-		ResultHandleStop,
 		ResultHandleContinue,
 	};
 	ResultHandleState handleResult(ReaderPrivate *reader, ProcessResult result, TimeMs ms);
 
-	typedef QMap<ReaderPrivate*, TimeMs> Readers;
+	// Called in one of the decoding threads.
+	void processReader(ReaderPrivate *reader);
+	void applyProcessed();
+	void remove(ReaderPrivate *reader);
+
+	struct Scheduled {
+		TimeMs when = 0;
+		bool decoding = false;
+	};
+	using Readers = QMap<ReaderPrivate*, Scheduled>;
 	Readers _readers;
 
+	std::vector<std::pair<ReaderPrivate*, ResultHandleState>> _processed;
+	QMutex _processedMutex;
+
+	std::unique_ptr<DecodePool> _pool;
 	QTimer _timer;
-	QThread *_processingInThread;
-	bool _needReProcess;
 
 };
 
 FileMediaInformation::Video PrepareForSending(const QString &fname, const QByteArray &data);
 
+// Animations are played with a lower frame rate while the window is inactive.
+void SetWindowActive(bool active);
+
+struct MemoryUsage {
+	int readers = 0;
+	int64 framesBytes = 0;
+};
+MemoryUsage CollectMemoryUsage();
+
 void Finish();
 
 } // namespace Clip
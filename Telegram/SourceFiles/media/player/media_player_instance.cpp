@@ -133,6 +133,11 @@ void Instance::playlistUpdated(not_null<Data*> data) {
 		data->playlistIndex = std::nullopt;
 	}
 	data->playlistChanges.fire({});
+
+	// The slice may arrive after the playback has started.
+	if (data->isPlaying) {
+		preloadNext(data);
+	}
 }
 
 bool Instance::validPlaylist(not_null<Data*> data) {
@@ -472,7 +477,7 @@ void Instance::preloadNext(not_null<Data*> data) {
 			if (const auto document = media->document()) {
 				const auto isLoaded = document->loaded(
 					DocumentData::FilePathResolveSaveFromDataSilent);
-				if (!isLoaded) {
+				if (!isLoaded && !document->loading()) {
 					DocumentOpenClickHandler::Open(
 						item->fullId(),
 						document,
@@ -47,6 +47,9 @@ constexpr auto kIdsLimit = 48;
 // Preload next messages if we went further from current than that.
 constexpr auto kIdsPreloadAfter = 28;
 
+// Partially loaded progressive photos are decoded after each quarter.
+constexpr auto kProgressiveStepsCount = 4;
+
 Images::Options VideoThumbOptions(not_null<DocumentData*> document) {
 	const auto result = Images::Option::Smooth | Images::Option::Blurred;
 	return (document && document->isVideoMessage())
@@ -54,6 +57,31 @@ Images::Options VideoThumbOptions(not_null<DocumentData*> document) {
 		: result;
 }
 
+// A partially loaded baseline JPEG is decoded with a gray lower part,
+// while a progressive one gives the whole picture in lower quality.
+bool IsProgressiveJpeg(const QByteArray &bytes) {
+	const auto data = reinterpret_cast<const uchar*>(bytes.constData());
+	const auto size = bytes.size();
+	if (size < 2 || data[0] != 0xFF || data[1] != 0xD8) {
+		return false;
+	}
+	auto offset = 2;
+	while (offset + 4 <= size && data[offset] == 0xFF) {
+		const auto marker = data[offset + 1];
+		if (marker == 0xC2 || marker == 0xCA) {
+			return true;
+		} else if ((marker >= 0xC0 && marker <= 0xCF
+			&& marker != 0xC4
+			&& marker != 0xC8
+			&& marker != 0xCC) || marker == 0xDA) {
+			// Other frame type or scan data before a frame header.
+			return false;
+		}
+		offset += 2 + ((int(data[offset + 2]) << 8) | data[offset + 3]);
+	}
+	return false;
+}
+
 } // namespace
 
 struct MediaView::SharedMedia {
@@ -110,6 +138,7 @@ MediaView::MediaView()
 			subscribe(Auth().downloaderTaskFinished(), [this] {
 				if (!isHidden()) {
 					updateControls();
+					preparePrefetchedPhotos();
 				}
 			});
 			subscribe(Auth().calls().currentCallChanged(), [this](Calls::Call *call) {
@@ -613,6 +642,9 @@ void MediaView::step_radial(TimeMs ms, bool timer) {
 	if (timer && (wasAnimating || _radial.animating()) && (!anim::Disabled() || updated)) {
 		update(radialRect());
 	}
+	if (_photo) {
+		checkProgressivePhoto();
+	}
 	const auto ready = _doc && _doc->loaded();
 	const auto streamVideo = ready && (_doc->isAnimation() || _doc->isVideoFile());
 	const auto tryOpenImage = ready && (_doc->size < App::kImageSizeLimit);
@@ -636,6 +668,53 @@ void MediaView::step_radial(TimeMs ms, bool timer) {
 	}
 }
 
+void MediaView::checkProgressivePhoto() {
+	if (_full > 0
+		|| _photo->loaded()
+		|| _progressiveDecoding.alive()) {
+		return;
+	}
+	const auto bytes = _photo->full->partialBytes();
+	const auto step = _photo->full->bytesSize() / kProgressiveStepsCount;
+	if (step <= 0
+		|| bytes.size() < _progressiveSize + step
+		|| !IsProgressiveJpeg(bytes)) {
+		return;
+	}
+	_progressiveSize = bytes.size();
+
+	auto [left, right] = base::make_binary_guard();
+	_progressiveDecoding = std::move(left);
+	crl::async([=, guard = std::move(right)]() mutable {
+		auto image = FileLoader::ReadImage(bytes, QSize());
+		crl::on_main([
+			=,
+			guard = std::move(guard),
+			image = std::move(image)
+		]() mutable {
+			if (guard.alive()) {
+				progressivePhotoDecoded(std::move(image));
+			}
+		});
+	});
+}
+
+void MediaView::progressivePhotoDecoded(QImage &&image) {
+	if (image.isNull() || !_photo || _photo->loaded() || _full > 0) {
+		return;
+	}
+	const auto w = _width * cIntRetinaFactor();
+	const auto h = int((_photo->full->height() * (qreal(w) / qreal(_photo->full->width()))) + 0.9999);
+	_current = App::pixmapFromImageInPlace(image.scaled(
+		w,
+		h,
+		Qt::IgnoreAspectRatio,
+		Qt::SmoothTransformation));
+	_current.setDevicePixelRatio(cRetinaFactor());
+	_full = 0;
+	update(_x, _y, _w, _h);
+}
+
 void MediaView::zoomIn() {
 	int32 newZoom = _zoom;
 	if (newZoom == ZoomToScreenLevel) {
@@ -920,6 +999,10 @@ void MediaView::onDocClick() {
 		if (_doc->loading() && !_radial.animating()) {
 			_radial.start(_doc->progress());
 		}
+		if (_doc->loading() && _doc->isVideoFile() && !_gif) {
+			initAnimation();
+			updateControls();
+		}
 	}
 }
 
@@ -1556,23 +1639,26 @@ void MediaView::displayPhoto(not_null<PhotoData*> photo, HistoryItem *item) {
 	Auth().downloader().clearPriorities();
 	_full = -1;
 	_current = QPixmap();
+	_progressiveDecoding = base::binary_guard();
+	_progressiveSize = 0;
 	_down = OverNone;
-	_w = ConvertScale(photo->full->width());
-	_h = ConvertScale(photo->full->height());
 	if (isHidden()) {
 		moveToScreen();
 	}
-	if (_w > width()) {
-		_h = qRound(_h * width() / float64(_w));
-		_w = width();
-	}
-	if (_h > height()) {
-		_w = qRound(_w * height() / float64(_h));
-		_h = height();
-	}
+	const auto size = photoFitSize(photo);
+	_w = size.width();
+	_h = size.height();
 	_x = (width() - _w) / 2;
 	_y = (height() - _h) / 2;
 	_width = _w;
+	if (const auto i = _prepared.find(photo); i != _prepared.end()) {
+		if (i->second.size() == photoPixmapSize(photo)) {
+			_current = App::pixmapFromImageInPlace(base::take(i->second));
+			_current.setDevicePixelRatio(cRetinaFactor());
+			_full = 1;
+		}
+		_prepared.erase(i);
+	}
 	if (_msgid && item) {
 		_from = item->senderOriginal();
 	} else {
@@ -1790,6 +1876,8 @@ void MediaView::initAnimation() {
 	} else if (location.accessEnable()) {
 		createClipReader();
 		location.accessDisable();
+	} else if (_doc->isVideoFile() && _doc->loading()) {
+		createClipReader(); // Played while loading, see DocumentData::stream().
 	} else if (_doc->dimensions.width() && _doc->dimensions.height()) {
 		auto w = _doc->dimensions.width();
 		auto h = _doc->dimensions.height();
@@ -1946,7 +2034,7 @@ void MediaView::toggleVideoPaused() {
 }
 
 void MediaView::restartVideoAtSeekPosition(TimeMs positionMs) {
-	// Seek works bad: it seeks to the next keyframe after positionMs.
+	// Seek goes to the nearest keyframe, so it can't be precise.
 	// At least let user to seek to the beginning of the video.
 	if (positionMs < 1000
 		&& (!_videoDurationMs || (positionMs * 20 < _videoDurationMs))) {
@@ -2669,7 +2757,7 @@ bool MediaView::moveToNext(int delta) {
 		return false;
 	}
 	auto newIndex = *_index + delta;
-	return moveToEntity(entityByIndex(newIndex));
+	return moveToEntity(entityByIndex(newIndex), delta);
 }
 
 bool MediaView::moveToEntity(const Entity &entity, int preloadDelta) {
@@ -2713,10 +2801,12 @@ void MediaView::preloadData(int delta) {
 		}
 	}
 
+	auto photos = std::vector<not_null<PhotoData*>>();
 	for (auto index = from; index != till; ++index) {
 		auto entity = entityByIndex(index);
 		if (auto photo = base::get_if<not_null<PhotoData*>>(&entity.data)) {
 			(*photo)->download(fileOrigin());
+			photos.push_back(*photo);
 		} else if (auto document = base::get_if<not_null<DocumentData*>>(&entity.data)) {
 			if (const auto image = (*document)->getStickerImage()) {
 				image->load(fileOrigin());
@@ -2726,6 +2816,123 @@ void MediaView::preloadData(int delta) {
 			}
 		}
 	}
+	prefetchPhotos(std::move(photos), delta);
+}
+
+void MediaView::prefetchPhotos(
+		std::vector<not_null<PhotoData*>> &&photos,
+		int delta) {
+	const auto direction = (delta > 0) ? 1 : (delta < 0) ? -1 : 0;
+	const auto changed = direction
+		&& _prefetchDirection
+		&& (direction != _prefetchDirection);
+	const auto wanted = [&](not_null<PhotoData*> photo) {
+		return (photo == _photo)
+			|| (ranges::find(photos, photo) != end(photos));
+	};
+	if (changed) {
+		// The photos we were loading ahead are not needed any more.
+		for (const auto photo : _prefetched) {
+			if (!wanted(photo) && photo->loading()) {
+				photo->cancel();
+			}
+		}
+	}
+	for (auto i = _preparing.begin(); i != _preparing.end();) {
+		if (wanted(i->first)) {
+			++i;
+		} else {
+			i = _preparing.erase(i);
+		}
+	}
+	for (auto i = _prepared.begin(); i != _prepared.end();) {
+		if (wanted(i->first)) {
+			++i;
+		} else {
+			i = _prepared.erase(i);
+		}
+	}
+	if (direction) {
+		_prefetchDirection = direction;
+	}
+	_prefetched = std::move(photos);
+	preparePrefetchedPhotos();
+}
+
+void MediaView::preparePrefetchedPhotos() {
+	if (isHidden()) {
+		return;
+	}
+	for (const auto photo : _prefetched) {
+		if (_prepared.contains(photo)
+			|| _preparing.contains(photo)
+			|| !photo->loaded()) {
+			continue;
+		}
+		const auto size = photoPixmapSize(photo);
+		auto original = photo->full->original();
+		if (size.isEmpty() || original.isNull()) {
+			continue;
+		}
+		auto [left, right] = base::make_binary_guard();
+		_preparing.emplace(photo, std::move(left));
+		crl::async([
+			=,
+			original = std::move(original),
+			guard = std::move(right)
+		]() mutable {
+			auto image = original.scaled(
+				size,
+				Qt::IgnoreAspectRatio,
+				Qt::SmoothTransformation);
+			image.setDevicePixelRatio(cRetinaFactor());
+			crl::on_main([
+				=,
+				guard = std::move(guard),
+				image = std::move(image)
+			]() mutable {
+				if (guard.alive()) {
+					_preparing.remove(photo);
+					_prepared.emplace(photo, std::move(image));
+				}
+			});
+		});
+	}
+}
+
+void MediaView::cancelPrefetch() {
+	for (const auto photo : base::take(_prefetched)) {
+		if (photo != _photo && photo->loading()) {
+			photo->cancel();
+		}
+	}
+	_preparing.clear();
+	_prepared.clear();
+	_prefetchDirection = 0;
+}
+
+QSize MediaView::photoFitSize(not_null<PhotoData*> photo) const {
+	auto w = ConvertScale(photo->full->width());
+	auto h = ConvertScale(photo->full->height());
+	if (w > width()) {
+		h = qRound(h * width() / float64(w));
+		w = width();
+	}
+	if (h > height()) {
+		w = qRound(w * height() / float64(h));
+		h = height();
+	}
+	return QSize(w, h);
+}
+
+QSize MediaView::photoPixmapSize(not_null<PhotoData*> photo) const {
+	const auto fullWidth = photo->full->width();
+	if (fullWidth <= 0) {
+		return QSize();
+	}
+	const auto w = photoFitSize(photo).width() * cIntRetinaFactor();
+	const auto h = int((photo->full->height() * (qreal(w) / qreal(fullWidth))) + 0.9999);
+	return QSize(w, h);
 }
 
 void MediaView::mousePressEvent(QMouseEvent *e) {
@@ -3009,6 +3216,11 @@ void MediaView::contextMenuEvent(QContextMenuEvent *e) {
 	}
 }
 
+void MediaView::hideEvent(QHideEvent *e) {
+	cancelPrefetch();
+	TWidget::hideEvent(e);
+}
+
 void MediaView::touchEvent(QTouchEvent *e) {
 	switch (e->type()) {
 	case QEvent::TouchBegin: {
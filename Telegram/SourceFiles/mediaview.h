@@ -12,6 +12,7 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 #include "data/data_shared_media.h"
 #include "data/data_user_photos.h"
 #include "data/data_web_page.h"
+#include "base/binary_guard.h"
 
 namespace Media {
 namespace Player {
@@ -86,6 +87,7 @@ protected:
 	void mouseMoveEvent(QMouseEvent *e) override;
 	void mouseReleaseEvent(QMouseEvent *e) override;
 	void contextMenuEvent(QContextMenuEvent *e) override;
+	void hideEvent(QHideEvent *e) override;
 	void touchEvent(QTouchEvent *e);
 
 	bool event(QEvent *e) override;
@@ -140,6 +142,16 @@ private:
 	void moveToScreen();
 	bool moveToNext(int delta);
 	void preloadData(int delta);
+
+	// Photos ahead in the navigation direction are loaded and prepared
+	// for the screen in the background, so that they're shown instantly.
+	void prefetchPhotos(
+		std::vector<not_null<PhotoData*>> &&photos,
+		int delta);
+	void preparePrefetchedPhotos();
+	void cancelPrefetch();
+	QSize photoFitSize(not_null<PhotoData*> photo) const;
+	QSize photoPixmapSize(not_null<PhotoData*> photo) const;
 	struct Entity {
 		base::optional_variant<
 			not_null<PhotoData*>,
@@ -236,6 +248,10 @@ private:
 	void step_state(TimeMs ms, bool timer);
 	void step_radial(TimeMs ms, bool timer);
 
+	// Progressive photos are shown in their decoded part while loading.
+	void checkProgressivePhoto();
+	void progressivePhotoDecoded(QImage &&image);
+
 	void zoomIn();
 	void zoomOut();
 	void zoomReset();
@@ -300,6 +316,13 @@ private:
 	QPixmap _current;
 	Media::Clip::ReaderPointer _gif;
 	int32 _full = -1; // -1 - thumb, 0 - medium, 1 - full
+	base::binary_guard _progressiveDecoding;
+	int _progressiveSize = 0;
+
+	int _prefetchDirection = 0;
+	std::vector<not_null<PhotoData*>> _prefetched;
+	base::flat_map<not_null<PhotoData*>, base::binary_guard> _preparing;
+	base::flat_map<not_null<PhotoData*>, QImage> _prepared;
 
 	// Video without audio stream playback information.
 	bool _videoIsSilent = false;
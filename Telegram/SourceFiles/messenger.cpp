@@ -27,6 +27,7 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 #include "lang/lang_cloud_manager.h"
 #include "lang/lang_hardcoded.h"
 #include "core/update_checker.h"
+#include "core/startup_trace.h"
 #include "passport/passport_form_controller.h"
 #include "observer_peer.h"
 #include "storage/storage_databases.h"
@@ -57,6 +58,8 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 namespace {
 
 constexpr auto kQuitPreventTimeoutMs = 1500;
+constexpr auto kNetworkChangeResumeDelay = TimeMs(500);
+constexpr auto kPrewarmDownloadsPeriod = 5 * 60 * TimeMs(1000);
 
 Messenger *SingleInstance = nullptr;
 
@@ -74,6 +77,10 @@ struct Messenger::Private {
 	MTP::Instance::Config mtpConfig;
 	MTP::AuthKeysList mtpKeysToDestroy;
 	base::Timer quitTimer;
+
+	QNetworkConfigurationManager networkManager;
+	base::flat_set<QString> activeNetworks;
+	base::Timer resumeConnectionsTimer;
 };
 
 Messenger::Messenger(not_null<Core::Launcher*> launcher)
@@ -97,7 +104,10 @@ Messenger::Messenger(not_null<Core::Launcher*> launcher)
 	Global::start();
 	Sandbox::refreshGlobalProxy(); // Depends on Global::started().
 
-	startLocalStorage();
+	{
+		const auto trace = Core::StartupTrace::Scope("Local::start");
+		startLocalStorage();
+	}
 
 	if (Local::oldSettingsVersion() < AppVersion) {
 		psNewVersion();
@@ -112,11 +122,14 @@ Messenger::Messenger(not_null<Core::Launcher*> launcher)
 	_translator = std::make_unique<Lang::Translator>();
 	QCoreApplication::instance()->installTranslator(_translator.get());
 
-	style::startManager();
-	anim::startManager();
-	Ui::InitTextOptions();
-	Ui::Emoji::Init();
-	Media::Player::start();
+	{
+		const auto trace = Core::StartupTrace::Scope("Style and emoji");
+		style::startManager();
+		anim::startManager();
+		Ui::InitTextOptions();
+		Ui::Emoji::Init();
+		Media::Player::start();
+	}
 
 	DEBUG_LOG(("Application Info: inited..."));
 
@@ -125,18 +138,22 @@ Messenger::Messenger(not_null<Core::Launcher*> launcher)
 	cChangeTimeFormat(QLocale::system().timeFormat(QLocale::ShortFormat));
 
 	connect(&killDownloadSessionsTimer, SIGNAL(timeout()), this, SLOT(killDownloadSessions()));
+	startNetworkChangesTracking();
 
 	DEBUG_LOG(("Application Info: starting app..."));
 
 	// Create mime database, so it won't be slow later.
 	QMimeDatabase().mimeTypeForName(qsl("text/plain"));
 
-	_window = std::make_unique<MainWindow>();
-	_window->init();
+	{
+		const auto trace = Core::StartupTrace::Scope("MainWindow");
+		_window = std::make_unique<MainWindow>();
+		_window->init();
 
-	auto currentGeometry = _window->geometry();
-	_mediaView = std::make_unique<MediaView>();
-	_window->setGeometry(currentGeometry);
+		auto currentGeometry = _window->geometry();
+		_mediaView = std::make_unique<MediaView>();
+		_window->setGeometry(currentGeometry);
+	}
 
 	QCoreApplication::instance()->installEventFilter(this);
 	Sandbox::connect(SIGNAL(applicationStateChanged(Qt::ApplicationState)), this, SLOT(onAppStateChanged(Qt::ApplicationState)));
@@ -147,7 +164,10 @@ Messenger::Messenger(not_null<Core::Launcher*> launcher)
 
 	App::initMedia();
 
-	Local::ReadMapState state = Local::readMap(QByteArray());
+	const auto state = [&] {
+		const auto trace = Core::StartupTrace::Scope("Local::readMap");
+		return Local::readMap(QByteArray());
+	}();
 	if (state == Local::ReadMapPassNeeded) {
 		Global::SetLocalPasscode(true);
 		Global::RefLocalPasscodeChanged().notify();
@@ -158,6 +178,7 @@ Messenger::Messenger(not_null<Core::Launcher*> launcher)
 		startMtp();
 		DEBUG_LOG(("Application Info: MTP started..."));
 		if (AuthSession::Exists()) {
+			const auto trace = Core::StartupTrace::Scope("setupMain");
 			_window->setupMain();
 		} else {
 			_window->setupIntro();
@@ -634,9 +655,78 @@ void Messenger::forceLogOut(const TextWithEntities &explanation) {
 
 void Messenger::checkLocalTime() {
 	const auto updated = checkms();
+	if (updated) {
+		resumeConnections();
+	}
 	if (App::main()) App::main()->checkLastUpdate(updated);
 }
 
+void Messenger::startNetworkChangesTracking() {
+	auto &manager = _private->networkManager;
+	for (const auto &network : manager.allConfigurations(
+			QNetworkConfiguration::Active)) {
+		_private->activeNetworks.emplace(network.identifier());
+	}
+	_private->resumeConnectionsTimer.setCallback([=] {
+		resumeConnections();
+	});
+
+	// A switch between two networks may keep us online all the time,
+	// so the active configurations are tracked instead of online state.
+	const auto changed = [=](const QNetworkConfiguration &network) {
+		const auto id = network.identifier();
+		const auto active = (network.state() & QNetworkConfiguration::Active)
+			== QNetworkConfiguration::Active;
+		auto &networks = _private->activeNetworks;
+		if (active == (networks.find(id) != networks.end())) {
+			return;
+		} else if (active) {
+			networks.emplace(id);
+		} else {
+			networks.remove(id);
+		}
+		_private->resumeConnectionsTimer.callOnce(kNetworkChangeResumeDelay);
+	};
+	connect(
+		&manager,
+		&QNetworkConfigurationManager::configurationChanged,
+		this,
+		changed);
+	connect(
+		&manager,
+		&QNetworkConfigurationManager::configurationRemoved,
+		this,
+		changed);
+}
+
+void Messenger::resumeConnections() {
+	if (!_mtproto) {
+		return;
+	}
+	DEBUG_LOG(("MTP Info: network changed, restarting connections."));
+	_private->resumeConnectionsTimer.cancel();
+
+	// Each session restarts in its own thread, so the main and the media
+	// dcs reconnect in parallel without waiting for the ping timeouts.
+	_mtproto->restart();
+	if (AuthSession::Exists()) {
+		const auto dcs = Auth().downloader().recentlyUsedDcs(
+			kPrewarmDownloadsPeriod);
+		for (const auto dcId : dcs) {
+			for (auto i = 0; i != MTP::kDownloadSessionsCount; ++i) {
+				_mtproto->sendAnything(MTP::downloadDcId(dcId, i));
+			}
+			killDownloadSessionsStart(dcId);
+		}
+	}
+
+	// The request is queued in the restarted session and goes out in the
+	// first packet of the new connection.
+	if (const auto main = App::main()) {
+		main->getDifference();
+	}
+}
+
 void Messenger::onAppStateChanged(Qt::ApplicationState state) {
 	if (state == Qt::ApplicationActive) {
 		handleAppActivated();
@@ -729,8 +819,11 @@ void Messenger::onSwitchTestMode() {
 void Messenger::authSessionCreate(const MTPUser &user) {
 	Expects(_mtproto != nullptr);
 
-	_authSession = std::make_unique<AuthSession>(user);
-	authSessionChanged().notify(true);
+	{
+		const auto trace = Core::StartupTrace::Scope("AuthSession");
+		_authSession = std::make_unique<AuthSession>(user);
+		authSessionChanged().notify(true);
+	}
 }
 
 void Messenger::authSessionDestroy() {
@@ -220,6 +220,8 @@ public slots:
 private:
 	void destroyMtpKeys(MTP::AuthKeysList &&keys);
 	void startLocalStorage();
+	void startNetworkChangesTracking();
+	void resumeConnections();
 
 	friend void App::quit();
 	static void QuitAttempt();
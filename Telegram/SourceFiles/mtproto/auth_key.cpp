@@ -7,6 +7,8 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 */
 #include "mtproto/auth_key.h"
 
+#include "base/openssl_help.h"
+
 extern "C" {
 #include <openssl/aes.h>
 #include <openssl/modes.h>
@@ -73,23 +75,19 @@ void AuthKey::prepareAES(const MTPint128 &msgKey, MTPint256 &aesKey, MTPint256 &
 }
 
 void aesIgeEncryptRaw(const void *src, void *dst, uint32 len, const void *key, const void *iv) {
-	uchar aes_key[32], aes_iv[32];
-	memcpy(aes_key, key, 32);
-	memcpy(aes_iv, iv, 32);
-
-	AES_KEY aes;
-	AES_set_encrypt_key(aes_key, 256, &aes);
-	AES_ige_encrypt(static_cast<const uchar*>(src), static_cast<uchar*>(dst), len, &aes, aes_iv, AES_ENCRYPT);
+	openssl::AesIgeEncrypt(
+		bytes::make_span(static_cast<const bytes::type*>(src), len),
+		bytes::make_span(static_cast<bytes::type*>(dst), len),
+		bytes::make_span(static_cast<const bytes::type*>(key), 32),
+		bytes::make_span(static_cast<const bytes::type*>(iv), 32));
 }
 
 void aesIgeDecryptRaw(const void *src, void *dst, uint32 len, const void *key, const void *iv) {
-	uchar aes_key[32], aes_iv[32];
-	memcpy(aes_key, key, 32);
-	memcpy(aes_iv, iv, 32);
-
-	AES_KEY aes;
-	AES_set_decrypt_key(aes_key, 256, &aes);
-	AES_ige_encrypt(static_cast<const uchar*>(src), static_cast<uchar*>(dst), len, &aes, aes_iv, AES_DECRYPT);
+	openssl::AesIgeDecrypt(
+		bytes::make_span(static_cast<const bytes::type*>(src), len),
+		bytes::make_span(static_cast<bytes::type*>(dst), len),
+		bytes::make_span(static_cast<const bytes::type*>(key), 32),
+		bytes::make_span(static_cast<const bytes::type*>(iv), 32));
 }
 
 void aesCtrEncrypt(bytes::span data, const void *key, CTRState *state) {
@@ -12,6 +12,39 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 #include "mtproto/session.h"
 
 namespace MTP {
+namespace {
+
+constexpr auto kDefaultBulkInFlight = 4;
+constexpr auto kMaxBulkInFlight = 32;
+
+// Requests wrapped in takeout or messages range are paced by the method
+// that is wrapped, because the server counts floods for it.
+mtpTypeId BulkRequestMethod(const SecureRequest &request) {
+	const auto end = request->constData() + request->size();
+	auto from = request->constData() + SecureRequest::kMessageBodyPosition;
+	while (from < end) {
+		switch (mtpTypeId(*from)) {
+		case mtpc_invokeWithTakeout: from += 3; break;
+		case mtpc_invokeWithMessagesRange: from += 4; break;
+		default: return mtpTypeId(*from);
+		}
+	}
+	return 0;
+}
+
+} // namespace
+
+struct ConcurrentSender::Bulk {
+	BulkGenerator generator;
+	std::optional<BulkRequest> next;
+	bool generated = false;
+	int maxInFlight = 0;
+	int inFlight = 0;
+	Fn<void(const BulkStats &)> progress;
+	FnMut<void(const BulkStats &)> done;
+	BulkStats stats;
+	TimeMs started = 0;
+};
 
 class ConcurrentSender::RPCDoneHandler : public RPCAbstractDoneHandler {
 public:
@@ -81,6 +114,15 @@ ConcurrentSender::RPCFailHandler::RPCFailHandler(
 bool ConcurrentSender::RPCFailHandler::operator()(
 		mtpRequestId requestId,
 		const RPCError &error) {
+	if (MTP::isFloodError(error)) {
+		const auto seconds = error.type().mid(
+			qstr("FLOOD_WAIT_").size()).toInt();
+		_runner([=, weak = _weak] {
+			if (const auto strong = weak.get()) {
+				strong->senderRequestFlood(requestId, seconds);
+			}
+		});
+	}
 	if (_skipPolicy == FailSkipPolicy::Simple) {
 		if (MTP::isDefaultHandledError(error)) {
 			return false;
@@ -218,6 +260,246 @@ void ConcurrentSender::senderRequestCancelAll() {
 
 void ConcurrentSender::senderRequestDetach(mtpRequestId requestId) {
 	_requests.erase(requestId);
+	bulkRequestFinished(requestId, 0, false);
+}
+
+void ConcurrentSender::senderRequestFlood(
+		mtpRequestId requestId,
+		int seconds) {
+	_floodWaitDuration += std::max(seconds, 1) * TimeMs(1000);
+
+	const auto i = _bulkRequests.find(requestId);
+	if (i == end(_bulkRequests)) {
+		return;
+	}
+	auto &pacing = _pacing[i->second.method];
+	const auto current = pacing.limit
+		? pacing.limit
+		: std::max(pacing.inFlight, 1);
+	pacing.limit = std::max(current / 2, 1);
+	pacing.successes = 0;
+	accumulate_max(
+		pacing.pausedTill,
+		getms(true) + std::max(seconds, 1) * TimeMs(1000));
+	if (const auto j = _bulks.find(i->second.bulkId); j != end(_bulks)) {
+		++j->second->stats.floodWaits;
+	}
+}
+
+ConcurrentSender::BulkBuilder::BulkBuilder(
+	not_null<ConcurrentSender*> sender,
+	BulkGenerator &&generator) noexcept
+: _sender(sender)
+, _generator(std::move(generator))
+, _maxInFlight(kDefaultBulkInFlight) {
+}
+
+auto ConcurrentSender::BulkBuilder::maxInFlight(
+	int count
+) noexcept -> BulkBuilder & {
+	_maxInFlight = std::clamp(count, 1, kMaxBulkInFlight);
+	return *this;
+}
+
+auto ConcurrentSender::BulkBuilder::progress(
+	Fn<void(const BulkStats &)> &&handler
+) noexcept -> BulkBuilder & {
+	_progress = std::move(handler);
+	return *this;
+}
+
+auto ConcurrentSender::BulkBuilder::done(
+	FnMut<void(const BulkStats &)> &&handler
+) noexcept -> BulkBuilder & {
+	_done = std::move(handler);
+	return *this;
+}
+
+uint64 ConcurrentSender::BulkBuilder::start() {
+	auto bulk = std::make_unique<Bulk>();
+	bulk->generator = std::move(_generator);
+	bulk->maxInFlight = _maxInFlight;
+	bulk->progress = std::move(_progress);
+	bulk->done = std::move(_done);
+	return _sender->bulkStart(std::move(bulk));
+}
+
+auto ConcurrentSender::bulk(BulkGenerator &&generator) noexcept
+-> BulkBuilder {
+	return BulkBuilder(this, std::move(generator));
+}
+
+void ConcurrentSender::cancelBulk(uint64 bulkId) {
+	if (!_bulks.take(bulkId)) {
+		return;
+	}
+	auto list = std::vector<mtpRequestId>();
+	for (const auto &[requestId, info] : _bulkRequests) {
+		if (info.bulkId == bulkId) {
+			list.push_back(requestId);
+		}
+	}
+	for (const auto requestId : list) {
+		senderRequestCancel(requestId);
+	}
+}
+
+TimeMs ConcurrentSender::floodWaitDuration() const {
+	return _floodWaitDuration;
+}
+
+uint64 ConcurrentSender::bulkStart(std::unique_ptr<Bulk> bulk) {
+	const auto bulkId = ++_bulkIdAutoIncrement;
+	bulk->started = getms(true);
+	_bulks.emplace(bulkId, std::move(bulk));
+	bulkSendNext(bulkId);
+	return bulkId;
+}
+
+void ConcurrentSender::bulkSendNext(uint64 bulkId) {
+	const auto i = _bulks.find(bulkId);
+	if (i == end(_bulks)) {
+		return;
+	}
+	const auto bulk = i->second.get();
+	const auto now = getms(true);
+	auto resumeAfter = TimeMs(0);
+	while (bulk->inFlight < bulk->maxInFlight) {
+		if (!bulk->next) {
+			if (bulk->generated) {
+				break;
+			} else if (auto next = bulk->generator()) {
+				bulk->next.emplace(std::move(*next));
+			} else {
+				bulk->generated = true;
+				break;
+			}
+		}
+		const auto method = BulkRequestMethod(bulk->next->_serialized);
+		auto &pacing = _pacing[method];
+		if (pacing.pausedTill > now) {
+			resumeAfter = pacing.pausedTill - now;
+			break;
+		} else if (pacing.limit > 0 && pacing.inFlight >= pacing.limit) {
+			break;
+		}
+		++pacing.inFlight;
+		++bulk->inFlight;
+		++bulk->stats.sent;
+
+		auto builder = std::move(*bulk->next);
+		bulk->next.reset();
+		const auto requestId = bulkSend(std::move(builder));
+		_bulkRequests.emplace(requestId, BulkRequestInfo{ bulkId, method });
+	}
+	if (resumeAfter > 0) {
+		bulkResumeAfter(resumeAfter);
+	} else if (bulk->generated && !bulk->next && !bulk->inFlight) {
+		auto stats = bulk->stats;
+		stats.duration = now - bulk->started;
+		auto done = std::move(bulk->done);
+		_bulks.erase(bulkId);
+		if (done) {
+			done(stats);
+		}
+	}
+}
+
+void ConcurrentSender::bulkSendAll() {
+	auto list = std::vector<uint64>();
+	list.reserve(_bulks.size());
+	for (const auto &pair : _bulks) {
+		list.push_back(pair.first);
+	}
+	for (const auto bulkId : list) {
+		bulkSendNext(bulkId);
+	}
+}
+
+mtpRequestId ConcurrentSender::bulkSend(RequestBuilder &&builder) {
+	Expects(builder._sender == this);
+
+	auto &handlers = builder._handlers;
+	handlers.done = [=, done = std::move(handlers.done)](
+			mtpRequestId requestId,
+			bytes::const_span result) mutable {
+		const auto weak = base::make_weak(this);
+		if (done) {
+			std::move(done)(requestId, result);
+		}
+		if (weak.get()) {
+			bulkRequestFinished(requestId, result.size(), true);
+		}
+	};
+	handlers.fail = [=, fail = std::move(handlers.fail)](
+			mtpRequestId requestId,
+			RPCError &&error) mutable {
+		const auto weak = base::make_weak(this);
+		if (fail) {
+			std::move(fail)(requestId, std::move(error));
+		}
+		if (weak.get()) {
+			bulkRequestFinished(requestId, 0, false);
+		}
+	};
+	return builder.send();
+}
+
+void ConcurrentSender::bulkRequestFinished(
+		mtpRequestId requestId,
+		int64 bytes,
+		bool ok) {
+	const auto info = _bulkRequests.take(requestId);
+	if (!info) {
+		return;
+	}
+	auto &pacing = _pacing[info->method];
+	--pacing.inFlight;
+	if (ok && pacing.limit > 0 && ++pacing.successes >= pacing.limit) {
+		pacing.successes = 0;
+		if (++pacing.limit > kMaxBulkInFlight) {
+			pacing.limit = 0;
+		}
+	}
+
+	const auto i = _bulks.find(info->bulkId);
+	if (i == end(_bulks)) {
+		return;
+	}
+	const auto bulk = i->second.get();
+	--bulk->inFlight;
+	if (ok) {
+		++bulk->stats.done;
+		bulk->stats.bytes += bytes;
+	} else {
+		++bulk->stats.failed;
+	}
+	if (bulk->progress) {
+		auto stats = bulk->stats;
+		stats.duration = getms(true) - bulk->started;
+		bulk->progress(stats);
+	}
+
+	// Other bulks could be waiting for the same method.
+	bulkSendAll();
+}
+
+void ConcurrentSender::bulkResumeAfter(TimeMs delay) {
+	const auto when = getms(true) + delay;
+	if (_bulkResumeTime > 0 && _bulkResumeTime <= when) {
+		return;
+	}
+	_bulkResumeTime = when;
+	crl::on_main([=, weak = base::make_weak(this), runner = _runner] {
+		QTimer::singleShot(int(delay), [=] {
+			runner([=] {
+				if (const auto strong = weak.get()) {
+					strong->_bulkResumeTime = 0;
+					strong->bulkSendAll();
+				}
+			});
+		});
+	});
 }
 
 } // namespace MTP
@@ -73,6 +73,8 @@ class ConcurrentSender : public base::has_weak_ptr {
 		void setAfter(mtpRequestId requestId) noexcept;
 
 	private:
+		friend class ConcurrentSender;
+
 		not_null<ConcurrentSender*> _sender;
 		SecureRequest _serialized;
 		ShiftedDcId _dcId = 0;
@@ -170,6 +172,58 @@ public:
 
 	[[nodiscard]] auto requestCanceller() noexcept;
 
+	struct BulkStats {
+		int sent = 0;
+		int done = 0;
+		int failed = 0;
+		int floodWaits = 0;
+		int64 bytes = 0;
+		TimeMs duration = 0;
+	};
+
+	// Returns the next request with its handlers or nullopt if finished.
+	using BulkRequest = RequestBuilder;
+	using BulkGenerator = FnMut<std::optional<BulkRequest>()>;
+
+	// Sends the generated requests keeping a bounded number in flight.
+	// A FLOOD_WAIT_X for some method pauses sending requests of it for
+	// X seconds and halves their number in flight, it grows back by one
+	// after each series of successful responses.
+	class BulkBuilder {
+	public:
+		BulkBuilder(const BulkBuilder &other) = delete;
+		BulkBuilder(BulkBuilder &&other) = default;
+		BulkBuilder &operator=(const BulkBuilder &other) = delete;
+		BulkBuilder &operator=(BulkBuilder &&other) = delete;
+
+		[[nodiscard]] BulkBuilder &maxInFlight(int count) noexcept;
+		[[nodiscard]] BulkBuilder &progress(
+			Fn<void(const BulkStats &)> &&handler) noexcept;
+		[[nodiscard]] BulkBuilder &done(
+			FnMut<void(const BulkStats &)> &&handler) noexcept;
+
+		uint64 start();
+
+	private:
+		friend class ConcurrentSender;
+		BulkBuilder(
+			not_null<ConcurrentSender*> sender,
+			BulkGenerator &&generator) noexcept;
+
+		not_null<ConcurrentSender*> _sender;
+		BulkGenerator _generator;
+		int _maxInFlight = 0;
+		Fn<void(const BulkStats &)> _progress;
+		FnMut<void(const BulkStats &)> _done;
+
+	};
+
+	[[nodiscard]] BulkBuilder bulk(BulkGenerator &&generator) noexcept;
+	void cancelBulk(uint64 bulkId);
+
+	// Sum of the FLOOD_WAIT_X delays received for all the requests.
+	[[nodiscard]] TimeMs floodWaitDuration() const;
+
 	~ConcurrentSender();
 
 private:
@@ -179,6 +233,19 @@ private:
 	friend class RPCFailHandler;
 	friend class RequestBuilder;
 	friend class SentRequestWrap;
+	friend class BulkBuilder;
+
+	struct Bulk;
+	struct BulkRequestInfo {
+		uint64 bulkId = 0;
+		mtpTypeId method = 0;
+	};
+	struct Pacing {
+		int limit = 0; // Zero while there were no flood waits.
+		int inFlight = 0;
+		int successes = 0;
+		TimeMs pausedTill = 0;
+	};
 
 	void senderRequestRegister(mtpRequestId requestId, Handlers &&handlers);
 	void senderRequestDone(
@@ -190,10 +257,25 @@ private:
 	void senderRequestCancel(mtpRequestId requestId);
 	void senderRequestCancelAll();
 	void senderRequestDetach(mtpRequestId requestId);
+	void senderRequestFlood(mtpRequestId requestId, int seconds);
+
+	uint64 bulkStart(std::unique_ptr<Bulk> bulk);
+	void bulkSendNext(uint64 bulkId);
+	void bulkSendAll();
+	mtpRequestId bulkSend(RequestBuilder &&builder);
+	void bulkRequestFinished(mtpRequestId requestId, int64 bytes, bool ok);
+	void bulkResumeAfter(TimeMs delay);
 
 	const Fn<void(FnMut<void()>)> _runner;
 	base::flat_map<mtpRequestId, Handlers> _requests;
 
+	base::flat_map<uint64, std::unique_ptr<Bulk>> _bulks;
+	base::flat_map<mtpRequestId, BulkRequestInfo> _bulkRequests;
+	base::flat_map<mtpTypeId, Pacing> _pacing;
+	uint64 _bulkIdAutoIncrement = 0;
+	TimeMs _bulkResumeTime = 0;
+	TimeMs _floodWaitDuration = 0;
+
 };
 
 template <typename Response, typename InvokeFullDone>
@@ -12,8 +12,10 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 #include "mtproto/rpc_sender.h"
 #include "mtproto/dc_options.h"
 #include "mtproto/connection_abstract.h"
+#include "mtproto/request_tracer.h"
 #include "zlib.h"
 #include "messenger.h"
+#include "storage/localstorage.h"
 #include "core/launcher.h"
 #include "lang/lang_keys.h"
 #include "base/openssl_help.h"
@@ -36,6 +38,8 @@ constexpr auto kRecreateKeyId = AuthKey::KeyId(0xFFFFFFFFFFFFFFFFULL);
 constexpr auto kIntSize = static_cast<int>(sizeof(mtpPrime));
 constexpr auto kMaxModExpSize = 256;
 constexpr auto kWaitForBetterTimeout = TimeMs(2000);
+constexpr auto kFastestPriority = 4; // above any computed priority
+constexpr auto kConnectStaggerTimeout = TimeMs(300);
 constexpr auto kMinConnectedTimeout = TimeMs(1000);
 constexpr auto kMaxConnectedTimeout = TimeMs(8000);
 constexpr auto kMinReceiveTimeout = TimeMs(4000);
@@ -49,6 +53,11 @@ constexpr auto kTestModeDcIdShift = 10000;
 // If we can't connect for this time we will ask _instance to update config.
 constexpr auto kRequestConfigTimeout = TimeMs(8000);
 
+// Several DCs create their keys at once, so checked primes and some client
+// DH halves for the last used prime are kept to be shared by all of them.
+constexpr auto kMaxValidatedPrimes = 8;
+constexpr auto kPreparedModExpsCount = 4;
+
 // Don't try to handle messages larger than this size.
 constexpr auto kMaxMessageLength = 16 * 1024 * 1024;
 
@@ -61,6 +70,19 @@ QString LogIdsVector(const QVector<MTPlong> &ids) {
 	return idsStr + "]";
 }
 
+// Copies the packet, so that it is serialized in the logs writer thread.
+FnMut<QString()> DeferredSerialize(
+		const char *prefix,
+		const mtpPrime *from,
+		const mtpPrime *end) {
+	auto copy = mtpBuffer(end - from);
+	std::copy(from, end, copy.begin());
+	return [=, copy = std::move(copy)] {
+		auto data = copy.constData();
+		return prefix + mtpTextSerialize(data, data + copy.size());
+	};
+}
+
 bool IsGoodModExpFirst(
 		const openssl::BigNum &modexp,
 		const openssl::BigNum &prime) {
@@ -146,6 +168,20 @@ bool IsPrimeAndGoodCheck(const openssl::BigNum &prime, int g) {
 	return true;
 }
 
+struct DhCache {
+	QMutex mutex;
+	std::deque<std::pair<int, bytes::vector>> validated;
+	int g = 0;
+	bytes::vector prime;
+	std::deque<ModExpFirst> prepared;
+	bool preparing = false;
+};
+
+DhCache &GetDhCache() {
+	static DhCache result;
+	return result;
+}
+
 bool IsPrimeAndGood(bytes::const_span primeBytes, int g) {
 	static constexpr unsigned char GoodPrime[] = {
 		0xC7, 0x1C, 0xAE, 0xB9, 0xC6, 0xB1, 0xC9, 0x04, 0x8E, 0x6C, 0x52, 0x2F, 0x70, 0xF1, 0x3F, 0x73,
@@ -171,7 +207,26 @@ bool IsPrimeAndGood(bytes::const_span primeBytes, int g) {
 		}
 	}
 
-	return IsPrimeAndGoodCheck(openssl::BigNum(primeBytes), g);
+	auto &cache = GetDhCache();
+	const auto validated = [&](const std::pair<int, bytes::vector> &pair) {
+		return (pair.first == g) && !bytes::compare(pair.second, primeBytes);
+	};
+	{
+		QMutexLocker lock(&cache.mutex);
+		if (ranges::find_if(cache.validated, validated)
+			!= end(cache.validated)) {
+			return true;
+		}
+	}
+	if (!IsPrimeAndGoodCheck(openssl::BigNum(primeBytes), g)) {
+		return false;
+	}
+	QMutexLocker lock(&cache.mutex);
+	if (cache.validated.size() >= kMaxValidatedPrimes) {
+		cache.validated.pop_front();
+	}
+	cache.validated.emplace_back(g, bytes::make_vector(primeBytes));
+	return true;
 }
 
 bytes::vector CreateAuthKey(
@@ -215,6 +270,71 @@ ModExpFirst CreateModExp(
 	}
 }
 
+void PrepareModExps() {
+	auto &cache = GetDhCache();
+	QMutexLocker lock(&cache.mutex);
+	if (cache.preparing
+		|| cache.prime.empty()
+		|| cache.prepared.size() >= kPreparedModExpsCount) {
+		return;
+	}
+	cache.preparing = true;
+	crl::async([] {
+		auto &cache = GetDhCache();
+		QMutexLocker lock(&cache.mutex);
+		while (!cache.prime.empty()
+			&& cache.prepared.size() < kPreparedModExpsCount) {
+			const auto g = cache.g;
+			const auto prime = cache.prime;
+			lock.unlock();
+
+			auto randomSeed = bytes::vector(ModExpFirst::kRandomPowerSize);
+			bytes::set_random(randomSeed);
+			auto modexp = CreateModExp(g, prime, randomSeed);
+
+			lock.relock();
+			if (cache.g == g && cache.prime == prime) {
+				cache.prepared.push_back(std::move(modexp));
+			}
+		}
+		cache.preparing = false;
+	});
+}
+
+void RememberDhPrime(int g, bytes::const_span primeBytes) {
+	auto &cache = GetDhCache();
+	{
+		QMutexLocker lock(&cache.mutex);
+		if (cache.g != g || bytes::compare(cache.prime, primeBytes)) {
+			cache.g = g;
+			cache.prime = bytes::make_vector(primeBytes);
+			cache.prepared.clear();
+		}
+	}
+	PrepareModExps();
+}
+
+ModExpFirst TakeModExp(int g, bytes::const_span primeBytes) {
+	auto &cache = GetDhCache();
+	auto result = ModExpFirst();
+	{
+		QMutexLocker lock(&cache.mutex);
+		if (cache.g == g
+			&& !bytes::compare(cache.prime, primeBytes)
+			&& !cache.prepared.empty()) {
+			result = std::move(cache.prepared.front());
+			cache.prepared.pop_front();
+		}
+	}
+	PrepareModExps();
+	if (!result.modexp.empty()) {
+		return result;
+	}
+	auto randomSeed = bytes::vector(ModExpFirst::kRandomPowerSize);
+	bytes::set_random(randomSeed);
+	return CreateModExp(g, primeBytes, randomSeed);
+}
+
 void wrapInvokeAfter(SecureRequest &to, const SecureRequest &from, const RequestMap &haveSent, int32 skipBeforeRequest = 0) {
 	const auto afterId = *(mtpMsgId*)(from->after->data() + 4);
 	const auto i = afterId ? haveSent.constFind(afterId) : haveSent.cend();
@@ -341,19 +461,26 @@ void ConnectionPrivate::appendTestConnection(
 		DcOptions::Variants::Protocol protocol,
 		const QString &ip,
 		int port,
-		const bytes::vector &protocolSecret) {
+		const bytes::vector &protocolSecret,
+		bool fastest,
+		TimeMs delay) {
 	QWriteLocker lock(&stateConnMutex);
 
-	const auto priority = (qthelp::is_ipv6(ip) ? 0 : 1)
-		+ (protocol == DcOptions::Variants::Tcp ? 1 : 0)
-		+ (protocolSecret.empty() ? 0 : 1);
+	const auto priority = fastest
+		? kFastestPriority
+		: ((qthelp::is_ipv6(ip) ? 0 : 1)
+			+ (protocol == DcOptions::Variants::Tcp ? 1 : 0)
+			+ (protocolSecret.empty() ? 0 : 1));
 	_testConnections.push_back({
 		AbstractConnection::Create(
 			_instance,
 			protocol,
 			thread(),
 			_connectionOptions->proxy),
-		priority
+		priority,
+		protocol,
+		ip.toStdString(),
+		port
 	});
 	auto weak = _testConnections.back().data.get();
 	connect(weak, &AbstractConnection::error, [=](int errorCode) {
@@ -375,9 +502,34 @@ void ConnectionPrivate::appendTestConnection(
 		onDisconnected(weak);
 	});
 
-	InvokeQueued(_testConnections.back().data, [=] {
+	const auto start = [=] {
 		weak->connectToServer(ip, port, protocolSecret, getProtocolDcId());
-	});
+	};
+	if (delay > 0) {
+		QTimer::singleShot(int(delay), weak, start);
+	} else {
+		InvokeQueued(weak, start);
+	}
+}
+
+void ConnectionPrivate::notifyTestConnectionPing(
+		const TestConnection &connection) {
+	if (connection.ip.empty()
+		|| isTemporaryDcId(bareDc)
+		|| _connectionOptions->proxy.type != ProxyData::Type::None) {
+		return;
+	}
+	const auto changed = _instance->dcOptions()->notifyEndpointPing(
+		bareDc,
+		connection.ip,
+		connection.port,
+		(connection.protocol == DcOptions::Variants::Http),
+		connection.data->pingTime());
+	if (changed) {
+		InvokeQueued(_instance, [] {
+			Local::writeSettings();
+		});
+	}
 }
 
 int16 ConnectionPrivate::getProtocolDcId() const {
@@ -856,11 +1008,13 @@ void ConnectionPrivate::tryToSend() {
 	bool needAnyResponse = false;
 	SecureRequest toSendRequest;
 	{
-		QWriteLocker locker1(sessionData->toSendMutex());
-
-		auto toSendDummy = PreRequestMap();
-		auto &toSend = prependOnly ? toSendDummy : sessionData->toSendMap();
-		if (prependOnly) locker1.unlock();
+		// Take the queued requests and serialize them without holding
+		// the lock, so that the main thread can add new ones meanwhile.
+		auto toSend = PreRequestMap();
+		if (!prependOnly) {
+			QWriteLocker locker1(sessionData->toSendMutex());
+			toSend = base::take(sessionData->toSendMap());
+		}
 
 		uint32 toSendCount = toSend.size();
 		if (pingRequest) ++toSendCount;
@@ -874,10 +1028,7 @@ void ConnectionPrivate::tryToSend() {
 		auto first = pingRequest ? pingRequest : (ackRequest ? ackRequest : (resendRequest ? resendRequest : (stateRequest ? stateRequest : (httpWaitRequest ? httpWaitRequest : toSend.cbegin().value()))));
 		if (toSendCount == 1 && first->msDate > 0) { // if can send without container
 			toSendRequest = first;
-			if (!prependOnly) {
-				toSend.clear();
-				locker1.unlock();
-			}
+			toSend.clear();
 
 			mtpMsgId msgId = prepareToSend(toSendRequest, msgid());
 			if (pingRequest) {
@@ -888,6 +1039,7 @@ void ConnectionPrivate::tryToSend() {
 			}
 
 			if (toSendRequest->requestId) {
+				TraceRequest(toSendRequest->requestId, TraceStage::Sent);
 				if (toSendRequest.needAck()) {
 					toSendRequest->msDate = toSendRequest.isStateRequest() ? 0 : getms(true);
 
@@ -984,6 +1136,7 @@ void ConnectionPrivate::tryToSend() {
 				*(haveSentArr++) = msgId;
 				bool added = false;
 				if (req->requestId) {
+					TraceRequest(req->requestId, TraceStage::Sent);
 					if (req.needAck()) {
 						req->msDate = req.isStateRequest() ? 0 : getms(true);
 						int32 reqNeedsLayer = (needsLayer && req->needsLayer) ? toSendRequest->size() : 0;
@@ -1126,23 +1279,60 @@ void ConnectionPrivate::connectToServer(bool afterConfig) {
 			: !useHttp
 			? Variants::Http
 			: Variants::ProtocolCount;
-		for (auto address = 0; address != Variants::AddressTypeCount; ++address) {
-			if (address == skipAddress) {
-				continue;
-			}
-			for (auto protocol = 0; protocol != Variants::ProtocolCount; ++protocol) {
-				if (protocol == skipProtocol) {
+		const auto options = _instance->dcOptions();
+		const auto direct = (_connectionOptions->proxy.type
+			== ProxyData::Type::None);
+		const auto ping = [&](int protocol, const DcOptions::Endpoint &endpoint) {
+			return direct
+				? options->endpointPing(
+					bareDc,
+					endpoint.ip,
+					endpoint.port,
+					(protocol == Variants::Http))
+				: TimeMs(0);
+		};
+		const auto enumerate = [&](auto &&method) {
+			for (auto address = 0; address != Variants::AddressTypeCount; ++address) {
+				if (address == skipAddress) {
 					continue;
 				}
-				for (const auto &endpoint : variants.data[address][protocol]) {
-					appendTestConnection(
-						static_cast<Variants::Protocol>(protocol),
-						QString::fromStdString(endpoint.ip),
-						endpoint.port,
-						endpoint.secret);
+				for (auto protocol = 0; protocol != Variants::ProtocolCount; ++protocol) {
+					if (protocol == skipProtocol) {
+						continue;
+					}
+					for (const auto &endpoint : variants.data[address][protocol]) {
+						method(protocol, endpoint);
+					}
 				}
 			}
-		}
+		};
+
+		// Happy eyeballs: the endpoint that was the fastest last time
+		// is tried first, the others join it if it doesn't answer fast.
+		auto fastest = TimeMs(0);
+		enumerate([&](int protocol, const DcOptions::Endpoint &endpoint) {
+			const auto value = ping(protocol, endpoint);
+			if (value > 0 && (!fastest || value < fastest)) {
+				fastest = value;
+			}
+		});
+		auto fastestAdded = false;
+		enumerate([&](int protocol, const DcOptions::Endpoint &endpoint) {
+			const auto isFastest = !fastestAdded
+				&& fastest > 0
+				&& (ping(protocol, endpoint) == fastest);
+			if (isFastest) {
+				fastestAdded = true;
+			}
+			appendTestConnection(
+				static_cast<Variants::Protocol>(protocol),
+				QString::fromStdString(endpoint.ip),
+				endpoint.port,
+				endpoint.secret,
+				isFastest,
+				(fastest > 0 && !isFastest) ? kConnectStaggerTimeout : 0);
+		});
+	}
 	}
 	if (_testConnections.empty()) {
 		if (_instance->isKeysDestroyer()) {
@@ -1405,7 +1595,7 @@ void ConnectionPrivate::handleReceived() {
 		constexpr auto kMinimalEncryptedIntsCount = kEncryptedHeaderIntsCount + 4U; // + 1 data + 3 padding
 		constexpr auto kMinimalIntsCount = kExternalHeaderIntsCount + kMinimalEncryptedIntsCount;
 		auto intsCount = uint32(intsBuffer.size());
-		auto ints = intsBuffer.constData();
+		auto ints = intsBuffer.data();
 		if ((intsCount < kMinimalIntsCount) || (intsCount > kMaxMessageLength / kIntSize)) {
 			LOG(("TCP Error: bad message received, len %1").arg(intsCount * kIntSize));
 			TCP_LOG(("TCP Error: bad message %1").arg(Logs::mb(ints, intsCount * kIntSize).str()));
@@ -1419,19 +1609,19 @@ void ConnectionPrivate::handleReceived() {
 			return restartOnError();
 		}
 
+		// The message is decrypted in place, the packet is not needed after.
 		auto encryptedInts = ints + kExternalHeaderIntsCount;
 		auto encryptedIntsCount = (intsCount - kExternalHeaderIntsCount) & ~0x03U;
 		auto encryptedBytesCount = encryptedIntsCount * kIntSize;
-		auto decryptedBuffer = QByteArray(encryptedBytesCount, Qt::Uninitialized);
 		auto msgKey = *(MTPint128*)(ints + 2);
 
 #ifdef TDESKTOP_MTPROTO_OLD
-		aesIgeDecrypt_oldmtp(encryptedInts, decryptedBuffer.data(), encryptedBytesCount, key, msgKey);
+		aesIgeDecrypt_oldmtp(encryptedInts, encryptedInts, encryptedBytesCount, key, msgKey);
 #else // TDESKTOP_MTPROTO_OLD
-		aesIgeDecrypt(encryptedInts, decryptedBuffer.data(), encryptedBytesCount, key, msgKey);
+		aesIgeDecrypt(encryptedInts, encryptedInts, encryptedBytesCount, key, msgKey);
 #endif // TDESKTOP_MTPROTO_OLD
 
-		auto decryptedInts = reinterpret_cast<const mtpPrime*>(decryptedBuffer.constData());
+		auto decryptedInts = encryptedInts;
 		auto serverSalt = *(uint64*)&decryptedInts[0];
 		auto session = *(uint64*)&decryptedInts[2];
 		auto msgId = *(uint64*)&decryptedInts[4];
@@ -1544,7 +1734,7 @@ void ConnectionPrivate::handleReceived() {
 		auto from = decryptedInts + kEncryptedHeaderIntsCount;
 		auto end = from + (messageLength / kIntSize);
 		auto sfrom = decryptedInts + 4U; // msg_id + seq_no + length + message
-		MTP_LOG(_shiftedDcId, ("Recv: ") + mtpTextSerialize(sfrom, end));
+		MTP_LOG_DEFERRED(_shiftedDcId, DeferredSerialize("Recv: ", sfrom, end));
 
 		bool needToHandle = false;
 		{
@@ -1597,6 +1787,8 @@ void ConnectionPrivate::handleReceived() {
 				emit needToSendAsync();
 			}
 		}
+
+		_connection->releaseBuffer(std::move(intsBuffer));
 	}
 	if (_connection->needHttpWait()) {
 		emit sendHttpWaitAsync();
@@ -2061,6 +2253,8 @@ ConnectionPrivate::HandleResult ConnectionPrivate::handleOneReceived(const mtpPr
 
 		auto requestId = wasSent(reqMsgId.v);
 		if (requestId && requestId != mtpRequestId(0xFFFFFFFF)) {
+			TraceRequest(requestId, TraceStage::Received);
+
 			// Save rpc_result for processing in the main thread.
 			QWriteLocker locker(sessionData->haveReceivedMutex());
 			sessionData->haveReceivedResponses().insert(requestId, response);
@@ -2272,6 +2466,9 @@ void ConnectionPrivate::requestsAcked(const QVector<MTPlong> &ids, bool byRespon
 						haveSent.erase(req);
 					} else {
 						mtpRequestId reqId = req.value()->requestId;
+						if (!byResponse) {
+							TraceRequest(reqId, TraceStage::Acked);
+						}
 						bool moveToAcked = byResponse;
 						if (!moveToAcked) { // ignore ACK, if we need a response (if we have a handler)
 							moveToAcked = !_instance->hasCallbacks(reqId);
@@ -2427,6 +2624,7 @@ void ConnectionPrivate::onConnected(
 		connection.get(),
 		[](const TestConnection &test) { return test.data.get(); });
 	Assert(i != end(_testConnections));
+	notifyTestConnectionPing(*i);
 	const auto my = i->priority;
 	const auto j = ranges::find_if(
 		_testConnections,
@@ -2538,6 +2736,9 @@ void ConnectionPrivate::updateAuthKey() 	{
 	_authKeyStrings = std::make_unique<ConnectionPrivate::AuthKeyCreateStrings>();
 	_authKeyData->nonce = rand_value<MTPint128>();
 
+	// Client DH halves are computed while we wait for the server ones.
+	PrepareModExps();
+
 	MTPReq_pq_multi req_pq;
 	req_pq.vnonce = _authKeyData->nonce;
 
@@ -2739,6 +2940,7 @@ void ConnectionPrivate::dhParamsAnswered() {
 		_authKeyStrings->dh_prime = bytes::make_vector(
 			dh_inner_data.vdh_prime.v);
 		_authKeyData->g = dh_inner_data.vg.v;
+		RememberDhPrime(_authKeyData->g, _authKeyStrings->dh_prime);
 		_authKeyStrings->g_a = bytes::make_vector(dh_inner_data.vg_a.v);
 		_authKeyData->retry_id = MTP_long(0);
 		_authKeyData->retries = 0;
@@ -2777,9 +2979,7 @@ void ConnectionPrivate::dhClientParamsSend() {
 	}
 
 	// gen rand 'b'
-	auto randomSeed = bytes::vector(ModExpFirst::kRandomPowerSize);
-	bytes::set_random(randomSeed);
-	auto g_b_data = CreateModExp(_authKeyData->g, _authKeyStrings->dh_prime, randomSeed);
+	auto g_b_data = TakeModExp(_authKeyData->g, _authKeyStrings->dh_prime);
 	if (g_b_data.modexp.empty()) {
 		LOG(("AuthKey Error: could not generate good g_b."));
 		return restart();
@@ -3129,7 +3329,7 @@ bool ConnectionPrivate::sendSecureRequest(
 	memcpy(request->data() + 2, &session, 2 * sizeof(mtpPrime));
 
 	auto from = request->constData() + 4;
-	MTP_LOG(_shiftedDcId, ("Send: ") + mtpTextSerialize(from, from + messageSize));
+	MTP_LOG_DEFERRED(_shiftedDcId, DeferredSerialize("Send: ", from, from + messageSize));
 
 #ifdef TDESKTOP_MTPROTO_OLD
 	uint32 padding = fullSize - 4 - messageSize;
@@ -146,6 +146,9 @@ private:
 	struct TestConnection {
 		ConnectionPointer data;
 		int priority = 0;
+		DcOptions::Variants::Protocol protocol = DcOptions::Variants::Tcp;
+		std::string ip;
+		int port = 0;
 	};
 	void connectToServer(bool afterConfig = false);
 	void doDisconnect();
@@ -205,7 +208,10 @@ private:
 		DcOptions::Variants::Protocol protocol,
 		const QString &ip,
 		int port,
-		const bytes::vector &protocolSecret);
+		const bytes::vector &protocolSecret,
+		bool fastest = false,
+		TimeMs delay = 0);
+	void notifyTestConnectionPing(const TestConnection &connection);
 
 	// if badTime received - search for ids in sessionData->haveSent and sessionData->wereAcked and sync time/salt, return true if found
 	bool requestsFixTimeSalt(const QVector<MTPlong> &ids, int32 serverTime, uint64 serverSalt);
@@ -14,6 +14,12 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 
 namespace MTP {
 namespace internal {
+namespace {
+
+constexpr auto kMaxPooledBuffers = 4;
+constexpr auto kMaxPooledBufferSize = 1024 * 1024;
+
+} // namespace
 
 ConnectionPointer::ConnectionPointer() = default;
 
@@ -78,8 +84,7 @@ ConnectionPointer::~ConnectionPointer() {
 mtpBuffer AbstractConnection::prepareSecurePacket(
 		uint64 keyId,
 		MTPint128 msgKey,
-		uint32 size) const {
-	auto result = mtpBuffer();
+		uint32 size) {
 	constexpr auto kTcpPrefixInts = 2;
 	constexpr auto kAuthKeyIdPosition = kTcpPrefixInts;
 	constexpr auto kAuthKeyIdInts = 2;
@@ -90,7 +95,7 @@ mtpBuffer AbstractConnection::prepareSecurePacket(
 		+ kAuthKeyIdInts
 		+ kMessageKeyInts;
 	constexpr auto kTcpPostfixInts = 4;
-	result.reserve(kPrefixInts + size + kTcpPostfixInts);
+	auto result = takeBuffer(kPrefixInts + size + kTcpPostfixInts);
 	result.resize(kPrefixInts);
 	*reinterpret_cast<uint64*>(&result[kAuthKeyIdPosition]) = keyId;
 	*reinterpret_cast<MTPint128*>(&result[kMessageKeyPosition]) = msgKey;
@@ -134,10 +139,30 @@ gsl::span<const mtpPrime> AbstractConnection::parseNotSecureResponse(
 	return gsl::make_span(answer + 5, answerLen);
 }
 
-mtpBuffer AbstractConnection::preparePQFake(const MTPint128 &nonce) const {
+mtpBuffer AbstractConnection::preparePQFake(const MTPint128 &nonce) {
 	return prepareNotSecurePacket(MTPReq_pq(nonce));
 }
 
+mtpBuffer AbstractConnection::takeBuffer(int capacity) {
+	auto result = mtpBuffer();
+	if (!_buffers.empty()) {
+		result = std::move(_buffers.back());
+		_buffers.pop_back();
+	}
+	result.reserve(capacity);
+	return result;
+}
+
+void AbstractConnection::releaseBuffer(mtpBuffer &&buffer) {
+	if (_buffers.size() >= kMaxPooledBuffers
+		|| !buffer.isDetached()
+		|| buffer.capacity() * sizeof(mtpPrime) > kMaxPooledBufferSize) {
+		return;
+	}
+	buffer.resize(0); // Keeps the capacity.
+	_buffers.push_back(std::move(buffer));
+}
+
 MTPResPQ AbstractConnection::readPQFakeReply(
 		const mtpBuffer &buffer) const {
 	const auto answer = parseNotSecureResponse(buffer);
@@ -102,11 +102,15 @@ public:
 	}
 
 	template <typename Request>
-	mtpBuffer prepareNotSecurePacket(const Request &request) const;
+	mtpBuffer prepareNotSecurePacket(const Request &request);
 	mtpBuffer prepareSecurePacket(
 		uint64 keyId,
 		MTPint128 msgKey,
-		uint32 size) const;
+		uint32 size);
+
+	// Packets are serialized to reused buffers, not allocated each time.
+	virtual mtpBuffer takeBuffer(int capacity);
+	virtual void releaseBuffer(mtpBuffer &&buffer);
 
 	gsl::span<const mtpPrime> parseNotSecureResponse(
 		const mtpBuffer &buffer) const;
@@ -128,22 +132,22 @@ protected:
 	bool _sentEncrypted = false;
 	int _pingTime = 0;
 	ProxyData _proxy;
+	std::vector<mtpBuffer> _buffers;
 
 	// first we always send fake MTPReq_pq to see if connection works at all
 	// we send them simultaneously through TCP/HTTP/IPv4/IPv6 to choose the working one
-	mtpBuffer preparePQFake(const MTPint128 &nonce) const;
+	mtpBuffer preparePQFake(const MTPint128 &nonce);
 	MTPResPQ readPQFakeReply(const mtpBuffer &buffer) const;
 
 };
 
 template <typename Request>
-mtpBuffer AbstractConnection::prepareNotSecurePacket(const Request &request) const {
+mtpBuffer AbstractConnection::prepareNotSecurePacket(const Request &request) {
 	const auto intsSize = request.innerLength() >> 2;
 	const auto intsPadding = requiresExtendedPadding()
 		? uint32(rand_value<uchar>() & 0x3F)
 		: 0;
 
-	auto result = mtpBuffer();
 	constexpr auto kTcpPrefixInts = 2;
 	constexpr auto kAuthKeyIdInts = 2;
 	constexpr auto kMessageIdInts = 2;
@@ -154,7 +158,8 @@ mtpBuffer AbstractConnection::prepareNotSecurePacket(const Request &request) con
 		+ kMessageLengthInts;
 	constexpr auto kTcpPostfixInts = 4;
 
-	result.reserve(kPrefixInts + intsSize + intsPadding + kTcpPostfixInts);
+	auto result = takeBuffer(
+		kPrefixInts + intsSize + intsPadding + kTcpPostfixInts);
 	result.resize(kPrefixInts);
 
 	const auto messageId = &result[kTcpPrefixInts + kAuthKeyIdInts];
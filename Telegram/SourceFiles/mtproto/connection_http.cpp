@@ -42,18 +42,31 @@ void HttpConnection::sendData(mtpBuffer &&buffer) {
 	request.setHeader(QNetworkRequest::ContentLengthHeader, QVariant(requestSize));
 	request.setHeader(QNetworkRequest::ContentTypeHeader, QVariant(qsl("application/x-www-form-urlencoded")));
 
-	TCP_LOG(("HTTP Info: sending %1 len request").arg(requestSize));
-	_requests.insert(_manager.post(request, QByteArray((const char*)(&buffer[2]), requestSize)));
+	// HTTP/1.0 proxies close the connection after each reply without it.
+	request.setRawHeader("Connection", "keep-alive");
+
+	TCP_LOG(("HTTP Info: sending %1 len request, %2 in flight"
+		).arg(requestSize
+		).arg(int(_requests.size())));
+	const auto reply = _manager.post(
+		request,
+		QByteArray((const char*)(&buffer[2]), requestSize));
+	_requests.emplace(reply, getms());
+	_stats.sent += requestSize;
+	accumulate_max(_stats.maxInFlight, int(_requests.size()));
+	releaseBuffer(std::move(buffer));
 }
 
 void HttpConnection::disconnectFromServer() {
 	if (_status == Status::Finished) return;
 	_status = Status::Finished;
 
-	for (const auto request : base::take(_requests)) {
+	for (const auto &[request, sent] : base::take(_requests)) {
+		Q_UNUSED(sent);
 		request->abort();
 		request->deleteLater();
 	}
+	logStats();
 
 	disconnect(
 		&_manager,
@@ -85,6 +98,31 @@ void HttpConnection::connectToServer(
 	sendData(std::move(buffer));
 }
 
+void HttpConnection::countFinished(QNetworkReply *reply, int64 received) {
+	const auto i = _requests.find(reply);
+	if (i == _requests.end()) {
+		return;
+	}
+	++_stats.count;
+	_stats.received += received;
+	_stats.duration += getms() - i->second;
+	_requests.erase(i);
+}
+
+void HttpConnection::logStats() const {
+	if (!_stats.count) {
+		return;
+	}
+	DEBUG_LOG(("HTTP Info: "
+		"%1 requests, %2 bytes sent, %3 bytes received, "
+		"%4 ms average reply, %5 max in flight"
+		).arg(_stats.count
+		).arg(_stats.sent
+		).arg(_stats.received
+		).arg(_stats.duration / _stats.count
+		).arg(_stats.maxInFlight));
+}
+
 mtpBuffer HttpConnection::handleResponse(QNetworkReply *reply) {
 	QByteArray response = reply->readAll();
 	TCP_LOG(("HTTP Info: read %1 bytes").arg(response.size()));
@@ -158,14 +196,14 @@ void HttpConnection::requestFinished(QNetworkReply *reply) {
 
 	reply->deleteLater();
 	if (reply->error() == QNetworkReply::NoError) {
-		_requests.remove(reply);
-
 		mtpBuffer data = handleResponse(reply);
+		countFinished(reply, data.size() * sizeof(mtpPrime));
+
 		if (data.size() == 1) {
 			emit error(data[0]);
 		} else if (!data.isEmpty()) {
 			if (_status == Status::Ready) {
-				_receivedQueue.push_back(data);
+				_receivedQueue.push_back(std::move(data));
 				emit receivedData();
 			} else {
 				try {
@@ -192,9 +230,10 @@ void HttpConnection::requestFinished(QNetworkReply *reply) {
 			}
 		}
 	} else {
-		if (!_requests.remove(reply)) {
+		if (!_requests.contains(reply)) {
 			return;
 		}
+		countFinished(reply, 0);
 
 		emit error(handleError(reply));
 	}
@@ -213,7 +252,7 @@ bool HttpConnection::usingHttpWait() {
 }
 
 bool HttpConnection::needHttpWait() {
-	return _requests.isEmpty();
+	return _requests.empty();
 }
 
 int32 HttpConnection::debugState() const {
@@ -40,9 +40,19 @@ public:
 	static qint32 handleError(QNetworkReply *reply); // returnes error code
 
 private:
+	struct RequestsStats {
+		int count = 0;
+		int maxInFlight = 0;
+		int64 sent = 0;
+		int64 received = 0;
+		TimeMs duration = 0;
+	};
+
 	QUrl url() const;
 
 	void requestFinished(QNetworkReply *reply);
+	void countFinished(QNetworkReply *reply, int64 received);
+	void logStats() const;
 
 	enum class Status {
 		Waiting = 0,
@@ -55,7 +65,11 @@ private:
 	QNetworkAccessManager _manager;
 	QString _address;
 
-	QSet<QNetworkReply*> _requests;
+	// Replies in flight with the time they were sent. They share the
+	// keep-alive connections of _manager, so a new request does not wait
+	// for the long-poll reply.
+	base::flat_map<QNetworkReply*, TimeMs> _requests;
+	RequestsStats _stats;
 
 	TimeMs _pingTime = 0;
 
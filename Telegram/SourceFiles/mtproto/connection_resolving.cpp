@@ -195,6 +195,18 @@ void ResolvingConnection::sendData(mtpBuffer &&buffer) {
 	_child->sendData(std::move(buffer));
 }
 
+mtpBuffer ResolvingConnection::takeBuffer(int capacity) {
+	Expects(_child != nullptr);
+
+	return _child->takeBuffer(capacity);
+}
+
+void ResolvingConnection::releaseBuffer(mtpBuffer &&buffer) {
+	Expects(_child != nullptr);
+
+	_child->releaseBuffer(std::move(buffer));
+}
+
 bool ResolvingConnection::requiresExtendedPadding() const {
 	Expects(_child != nullptr);
 
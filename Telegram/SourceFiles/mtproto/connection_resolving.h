@@ -27,6 +27,8 @@ public:
 	TimeMs pingTime() const override;
 	TimeMs fullConnectTimeout() const override;
 	void sendData(mtpBuffer &&buffer) override;
+	mtpBuffer takeBuffer(int capacity) override;
+	void releaseBuffer(mtpBuffer &&buffer) override;
 	void disconnectFromServer() override;
 	void connectToServer(
 		const QString &address,
@@ -412,7 +412,8 @@ mtpBuffer TcpConnection::parsePacket(bytes::const_span bytes) {
 		}
 		return mtpBuffer(1, ints[0]);
 	}
-	auto result = mtpBuffer(ints.size());
+	auto result = takeBuffer(ints.size());
+	result.resize(ints.size());
 	memcpy(result.data(), ints.data(), ints.size() * sizeof(mtpPrime));
 	return result;
 }
@@ -561,6 +562,7 @@ void TcpConnection::sendBuffer(mtpBuffer &&buffer) {
 	_socket.write(
 		reinterpret_cast<const char*>(bytes.data()),
 		bytes.size());
+	releaseBuffer(std::move(buffer));
 }
 
 
@@ -621,7 +623,7 @@ void TcpConnection::socketPacket(bytes::const_span bytes) {
 	if (_status == Status::Finished) return;
 
 	// old quickack?..
-	const auto data = parsePacket(bytes);
+	auto data = parsePacket(bytes);
 	if (data.size() == 1) {
 		if (data[0] != 0) {
 			emit error(data[0]);
@@ -631,7 +633,7 @@ void TcpConnection::socketPacket(bytes::const_span bytes) {
 	//} else if (data.size() == 2) {
 		// new quickack?..
 	} else if (_status == Status::Ready) {
-		_receivedQueue.push_back(data);
+		_receivedQueue.push_back(std::move(data));
 		emit receivedData();
 	} else if (_status == Status::Waiting) {
 		try {
@@ -145,6 +145,74 @@ bool SecureRequest::needAck() const {
 	return true;
 }
 
+namespace internal {
+namespace {
+
+thread_local TypeDataPool *CurrentPool = nullptr;
+
+} // namespace
+
+TypeDataPool::~TypeDataPool() {
+	for (const auto &blocks : _blocks) {
+		for (const auto block : blocks) {
+			::operator delete(block);
+		}
+	}
+	if (_allocated > 0) {
+		DEBUG_LOG(("MTP Info: type data pool reused %1 of %2 blocks."
+			).arg(_reused
+			).arg(_allocated));
+	}
+}
+
+TypeDataPool::Scope::Scope(TypeDataPool &pool)
+: _previous(base::take(CurrentPool)) {
+	CurrentPool = &pool;
+}
+
+TypeDataPool::Scope::~Scope() {
+	CurrentPool = _previous;
+}
+
+// Blocks are always taken from the heap with the size rounded up to
+// the size class, so any of them can be recycled by any pool later
+// and the ones freed outside of a scope go back to the heap as usual.
+void *TypeDataPool::Allocate(std::size_t size) {
+	const auto index = (size - 1) / kSizeStep;
+	if (index >= kClassesCount) {
+		return ::operator new(size);
+	}
+	if (const auto pool = CurrentPool) {
+		++pool->_allocated;
+		auto &blocks = pool->_blocks[index];
+		if (!blocks.empty()) {
+			++pool->_reused;
+			const auto result = blocks.back();
+			blocks.pop_back();
+			return result;
+		}
+
+		// Free() can't allocate, it only fills the reserved space.
+		blocks.reserve(kMaxBlocks);
+	}
+	return ::operator new((index + 1) * kSizeStep);
+}
+
+void TypeDataPool::Free(void *data, std::size_t size) {
+	const auto index = (size - 1) / kSizeStep;
+	if (index < kClassesCount) {
+		if (const auto pool = CurrentPool) {
+			auto &blocks = pool->_blocks[index];
+			if (blocks.size() < blocks.capacity()) {
+				blocks.push_back(data);
+				return;
+			}
+		}
+	}
+	::operator delete(data);
+}
+
+} // namespace internal
 } // namespace MTP
 
 Exception::Exception(const QString &msg) noexcept : _msg(msg.toUtf8()) {
@@ -209,6 +277,21 @@ void MTPstring::read(const mtpPrime *&from, const mtpPrime *end, mtpTypeId cons)
 	v = QByteArray(reinterpret_cast<const char*>(buf), l);
 }
 
+void MTPstring::skip(const mtpPrime *&from, const mtpPrime *end, mtpTypeId cons) {
+	if (from + 1 > end) throw mtpErrorInsufficient();
+	if (cons != mtpc_string) throw mtpErrorUnexpected(cons, "MTPstring");
+
+	const uchar *buf = (const uchar*)from;
+	if (buf[0] == 254) {
+		const auto l = (uint32)buf[1] + ((uint32)buf[2] << 8) + ((uint32)buf[3] << 16);
+		from += ((l + 4) >> 2) + (((l + 4) & 0x03) ? 1 : 0);
+	} else {
+		const auto l = (uint32)buf[0];
+		from += ((l + 1) >> 2) + (((l + 1) & 0x03) ? 1 : 0);
+	}
+	if (from > end) throw mtpErrorInsufficient();
+}
+
 void MTPstring::write(mtpBuffer &to) const {
 	uint32 l = v.length(), s = l + ((l < 254) ? 1 : 4), was = to.size();
 	if (s & 0x03) {
@@ -40,6 +40,7 @@ constexpr auto kLogoutDcShift = 0x02;
 constexpr auto kUpdaterDcShift = 0x03;
 constexpr auto kExportDcShift = 0x04;
 constexpr auto kExportMediaDcShift = 0x05;
+constexpr auto kBulkDcShift = 0x06;
 constexpr auto kMaxMediaDcCount = 0x10;
 constexpr auto kBaseDownloadDcShift = 0x10;
 constexpr auto kBaseUploadDcShift = 0x20;
@@ -91,6 +92,43 @@ public:
 namespace MTP {
 namespace internal {
 
+// Recycles the memory of the parsed TL objects. While a scope is active
+// on a thread the freed objects stay in the pool and the ones parsed next
+// reuse them, so handling a response doesn't go to the heap for each of
+// the thousands of small objects it consists of.
+class TypeDataPool {
+public:
+	TypeDataPool() = default;
+	TypeDataPool(const TypeDataPool &other) = delete;
+	TypeDataPool &operator=(const TypeDataPool &other) = delete;
+	~TypeDataPool();
+
+	class Scope {
+	public:
+		explicit Scope(TypeDataPool &pool);
+		Scope(const Scope &other) = delete;
+		Scope &operator=(const Scope &other) = delete;
+		~Scope();
+
+	private:
+		TypeDataPool *_previous = nullptr;
+
+	};
+
+	static void *Allocate(std::size_t size);
+	static void Free(void *data, std::size_t size);
+
+private:
+	static constexpr auto kSizeStep = std::size_t(16);
+	static constexpr auto kClassesCount = std::size_t(32);
+	static constexpr auto kMaxBlocks = std::size_t(1024);
+
+	std::array<std::vector<void*>, kClassesCount> _blocks;
+	int64 _allocated = 0;
+	int64 _reused = 0;
+
+};
+
 class TypeData {
 public:
 	TypeData() = default;
@@ -102,6 +140,13 @@ public:
 	virtual ~TypeData() {
 	}
 
+	static void *operator new(std::size_t size) {
+		return TypeDataPool::Allocate(size);
+	}
+	static void operator delete(void *data, std::size_t size) {
+		TypeDataPool::Free(data, size);
+	}
+
 private:
 	void incrementCounter() const {
 		_counter.ref();
@@ -261,6 +306,11 @@ public:
 		cons = (mtpTypeId)*(from++);
 		bareT::read(from, end, cons);
 	}
+	static void skip(const mtpPrime *&from, const mtpPrime *end, mtpTypeId cons = 0) {
+		if (from + 1 > end) throw mtpErrorInsufficient();
+		cons = (mtpTypeId)*(from++);
+		bareT::skip(from, end, cons);
+	}
 	void write(mtpBuffer &to) const {
         to.push_back(bareT::type());
 		bareT::write(to);
@@ -385,6 +435,11 @@ public:
 		if (cons != mtpc_int) throw mtpErrorUnexpected(cons, "MTPint");
 		v = (int32)*(from++);
 	}
+	static void skip(const mtpPrime *&from, const mtpPrime *end, mtpTypeId cons = mtpc_int) {
+		if (from + 1 > end) throw mtpErrorInsufficient();
+		if (cons != mtpc_int) throw mtpErrorUnexpected(cons, "MTPint");
+		from += 1;
+	}
 	void write(mtpBuffer &to) const {
 		to.push_back((mtpPrime)v);
 	}
@@ -428,6 +483,11 @@ public:
 		if (cons != mtpc_flags) throw mtpErrorUnexpected(cons, "MTPflags");
 		v = Flags::from_raw(static_cast<typename Flags::Type>(*(from++)));
 	}
+	static void skip(const mtpPrime *&from, const mtpPrime *end, mtpTypeId cons = mtpc_flags) {
+		if (from + 1 > end) throw mtpErrorInsufficient();
+		if (cons != mtpc_flags) throw mtpErrorUnexpected(cons, "MTPflags");
+		from += 1;
+	}
 	void write(mtpBuffer &to) const {
 		to.push_back(static_cast<mtpPrime>(v.value()));
 	}
@@ -486,6 +546,11 @@ public:
 		v = (uint64)(((uint32*)from)[0]) | ((uint64)(((uint32*)from)[1]) << 32);
 		from += 2;
 	}
+	static void skip(const mtpPrime *&from, const mtpPrime *end, mtpTypeId cons = mtpc_long) {
+		if (from + 2 > end) throw mtpErrorInsufficient();
+		if (cons != mtpc_long) throw mtpErrorUnexpected(cons, "MTPlong");
+		from += 2;
+	}
 	void write(mtpBuffer &to) const {
 		to.push_back((mtpPrime)(v & 0xFFFFFFFFL));
 		to.push_back((mtpPrime)(v >> 32));
@@ -529,6 +594,11 @@ public:
 		h = (uint64)(((uint32*)from)[2]) | ((uint64)(((uint32*)from)[3]) << 32);
 		from += 4;
 	}
+	static void skip(const mtpPrime *&from, const mtpPrime *end, mtpTypeId cons = mtpc_int128) {
+		if (from + 4 > end) throw mtpErrorInsufficient();
+		if (cons != mtpc_int128) throw mtpErrorUnexpected(cons, "MTPint128");
+		from += 4;
+	}
 	void write(mtpBuffer &to) const {
 		to.push_back((mtpPrime)(l & 0xFFFFFFFFL));
 		to.push_back((mtpPrime)(l >> 32));
@@ -572,6 +642,11 @@ public:
 		l.read(from, end);
 		h.read(from, end);
 	}
+	static void skip(const mtpPrime *&from, const mtpPrime *end, mtpTypeId cons = mtpc_int256) {
+		if (from + 8 > end) throw mtpErrorInsufficient();
+		if (cons != mtpc_int256) throw mtpErrorUnexpected(cons, "MTPint256");
+		from += 8;
+	}
 	void write(mtpBuffer &to) const {
 		l.write(to);
 		h.write(to);
@@ -613,6 +688,11 @@ public:
 		*(uint64*)(&v) = (uint64)(((uint32*)from)[0]) | ((uint64)(((uint32*)from)[1]) << 32);
 		from += 2;
 	}
+	static void skip(const mtpPrime *&from, const mtpPrime *end, mtpTypeId cons = mtpc_double) {
+		if (from + 2 > end) throw mtpErrorInsufficient();
+		if (cons != mtpc_double) throw mtpErrorUnexpected(cons, "MTPdouble");
+		from += 2;
+	}
 	void write(mtpBuffer &to) const {
 		uint64 iv = *(uint64*)(&v);
 		to.push_back((mtpPrime)(iv & 0xFFFFFFFFL));
@@ -649,6 +729,7 @@ public:
 		return mtpc_string;
 	}
 	void read(const mtpPrime *&from, const mtpPrime *end, mtpTypeId cons = mtpc_string);
+	static void skip(const mtpPrime *&from, const mtpPrime *end, mtpTypeId cons = mtpc_string);
 	void write(mtpBuffer &to) const;
 
 	QByteArray v;
@@ -735,6 +816,14 @@ public:
 		}
 		v = std::move(vector);
 	}
+	static void skip(const mtpPrime *&from, const mtpPrime *end, mtpTypeId cons = mtpc_vector) {
+		if (from + 1 > end) throw mtpErrorInsufficient();
+		if (cons != mtpc_vector) throw mtpErrorUnexpected(cons, "MTPvector");
+		auto count = static_cast<uint32>(*(from++));
+		while (count--) {
+			T::skip(from, end);
+		}
+	}
 	void write(mtpBuffer &to) const {
 		to.push_back(v.size());
 		for (const auto &item : v) {
@@ -12,6 +12,8 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 namespace MTP {
 namespace {
 
+constexpr auto kMaxPing = TimeMs(60 * 1000);
+
 const char *(PublicRSAKeys[]) = { "\
 -----BEGIN RSA PUBLIC KEY-----\n\
 MIIBCgKCAQEAwVACPi9w23mF3tBkdZz+zwrzKOaaQdr01vAbU4E1pvkfj4sqDsm6\n\
@@ -371,7 +373,22 @@ QByteArray DcOptions::serialize() const {
 		}
 	}
 
-	constexpr auto kVersion = 1;
+	auto pings = std::vector<EndpointPing>();
+	{
+		QMutexLocker lock(&_pingsMutex);
+		pings.reserve(_pings.size());
+		for (const auto &[key, ping] : _pings) {
+			const auto &[id, ip, port, http] = key;
+			pings.push_back({ id, ip, port, http, ping });
+
+			// id + ip + port + http + ping
+			size += sizeof(qint32) + sizeof(qint32) + ip.size();
+			size += sizeof(qint32) + sizeof(qint32) + sizeof(qint32);
+		}
+	}
+	size += sizeof(qint32);
+
+	constexpr auto kVersion = 2;
 
 	auto result = QByteArray();
 	result.reserve(size);
@@ -406,6 +423,16 @@ QByteArray DcOptions::serialize() const {
 				<< Serialize::bytes(key.n)
 				<< Serialize::bytes(key.e);
 		}
+
+		// Endpoint pings.
+		stream << qint32(pings.size());
+		for (const auto &ping : pings) {
+			stream << qint32(ping.id) << qint32(ping.ip.size());
+			stream.writeRawData(ping.ip.data(), ping.ip.size());
+			stream << qint32(ping.port)
+				<< qint32(ping.http ? 1 : 0)
+				<< qint32(ping.ping);
+		}
 	}
 	return result;
 }
@@ -500,6 +527,94 @@ void DcOptions::constructFromSerialized(const QByteArray &serialized) {
 			}
 		}
 	}
+
+	// Read endpoint pings
+	if (version > 1 && !stream.atEnd()) {
+		auto count = qint32(0);
+		stream >> count;
+		if (stream.status() != QDataStream::Ok) {
+			LOG(("MTP Error: Bad data for pings in DcOptions::constructFromSerialized()"));
+			return;
+		}
+
+		QMutexLocker lock(&_pingsMutex);
+		_pings.clear();
+		for (auto i = 0; i != count; ++i) {
+			qint32 id = 0, ipSize = 0, port = 0, http = 0, ping = 0;
+			stream >> id >> ipSize;
+
+			constexpr auto kMaxIpSize = 45;
+			if (ipSize <= 0 || ipSize > kMaxIpSize) {
+				LOG(("MTP Error: Bad data for pings inside DcOptions::constructFromSerialized()"));
+				return;
+			}
+			auto ip = std::string(ipSize, ' ');
+			stream.readRawData(ip.data(), ipSize);
+			stream >> port >> http >> ping;
+			if (stream.status() != QDataStream::Ok) {
+				LOG(("MTP Error: Bad data for pings inside DcOptions::constructFromSerialized()"));
+				return;
+			}
+			if (ping > 0 && ping <= kMaxPing) {
+				_pings.emplace(PingKey(id, ip, port, http != 0), ping);
+			}
+		}
+	}
+}
+
+bool DcOptions::notifyEndpointPing(
+		DcId dcId,
+		const std::string &ip,
+		int port,
+		bool http,
+		TimeMs ping) {
+	if (ping <= 0 || ping > kMaxPing) {
+		return false;
+	}
+	const auto fastest = [&] {
+		auto result = std::optional<PingKey>();
+		auto min = TimeMs(0);
+		for (const auto &[key, value] : _pings) {
+			if (std::get<0>(key) == dcId && (!result || value < min)) {
+				result = key;
+				min = value;
+			}
+		}
+		return result;
+	};
+
+	QMutexLocker lock(&_pingsMutex);
+	const auto was = fastest();
+	auto &value = _pings[PingKey(dcId, ip, port, http)];
+	value = value ? ((value * 3 + ping) / 4) : ping;
+	return (fastest() != was);
+}
+
+TimeMs DcOptions::endpointPing(
+		DcId dcId,
+		const std::string &ip,
+		int port,
+		bool http) const {
+	QMutexLocker lock(&_pingsMutex);
+	const auto i = _pings.find(PingKey(dcId, ip, port, http));
+	return (i != end(_pings)) ? i->second : TimeMs(0);
+}
+
+auto DcOptions::fastestEndpoints() const -> std::vector<EndpointPing> {
+	auto result = std::vector<EndpointPing>();
+
+	QMutexLocker lock(&_pingsMutex);
+	for (const auto &[key, ping] : _pings) {
+		const auto &[id, ip, port, http] = key;
+		if (!result.empty() && result.back().id == id) {
+			if (ping < result.back().ping) {
+				result.back() = { id, ip, port, http, ping };
+			}
+		} else {
+			result.push_back({ id, ip, port, http, ping });
+		}
+	}
+	return result;
 }
 
 DcOptions::Ids DcOptions::configEnumDcIds() const {
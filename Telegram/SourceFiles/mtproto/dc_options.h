@@ -85,6 +85,30 @@ public:
 	Variants lookup(DcId dcId, DcType type, bool throughProxy) const;
 	DcType dcType(ShiftedDcId shiftedDcId) const;
 
+	// Smoothed round trip times of the endpoints we've connected to.
+	// They are serialized with the options, so that the fastest endpoint
+	// is tried first right after the app launch.
+	struct EndpointPing {
+		DcId id = 0;
+		std::string ip;
+		int port = 0;
+		bool http = false;
+		TimeMs ping = 0;
+	};
+	// Returns true if the fastest endpoint of that dc has changed.
+	bool notifyEndpointPing(
+		DcId dcId,
+		const std::string &ip,
+		int port,
+		bool http,
+		TimeMs ping);
+	TimeMs endpointPing(
+		DcId dcId,
+		const std::string &ip,
+		int port,
+		bool http) const;
+	std::vector<EndpointPing> fastestEndpoints() const;
+
 	void setCDNConfig(const MTPDcdnConfig &config);
 	bool hasCDNKeysForDc(DcId dcId) const;
 	bool getDcRSAKey(DcId dcId, const QVector<MTPlong> &fingerprints, internal::RSAPublicKey *result) const;
@@ -129,6 +153,10 @@ private:
 	std::map<DcId, std::map<uint64, internal::RSAPublicKey>> _cdnPublicKeys;
 	mutable QReadWriteLock _useThroughLockers;
 
+	using PingKey = std::tuple<DcId, std::string, int, bool>;
+	std::map<PingKey, TimeMs> _pings;
+	mutable QMutex _pingsMutex;
+
 	mutable base::Observable<Ids> _changed;
 
 	// True when we have overriden options from a .tdesktop-endpoints file.
@@ -15,6 +15,8 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 #include "mtproto/connection.h"
 #include "mtproto/sender.h"
 #include "mtproto/rsa_public_key.h"
+#include "mtproto/request_tracer.h"
+#include "mtproto/traffic_capture.h"
 #include "storage/localstorage.h"
 #include "calls/calls_instance.h"
 #include "auth_session.h"
@@ -25,11 +27,65 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 #include "lang/lang_cloud_manager.h"
 #include "base/timer.h"
 
+#include "zlib.h"
+
 namespace MTP {
 namespace {
 
 constexpr auto kConfigBecomesOldIn = 2 * 60 * TimeMs(1000);
 constexpr auto kConfigBecomesOldForBlockedIn = 8 * TimeMs(1000);
+constexpr auto kGzipMinSize = 1024;
+constexpr auto kGzipMaxSize = 256 * 1024;
+
+// Large requests are sent as gzip_packed if that makes them smaller.
+SecureRequest GzipPacked(SecureRequest &&request) {
+	constexpr auto kBodyPosition = SecureRequest::kMessageBodyPosition;
+
+	const auto length = request.innerLength();
+	if (length < kGzipMinSize || length > kGzipMaxSize) {
+		return std::move(request);
+	}
+	const auto type = mtpTypeId((*request)[kBodyPosition]);
+	if (type == mtpc_upload_saveFilePart
+		|| type == mtpc_upload_saveBigFilePart
+		|| type == mtpc_gzip_packed) {
+		return std::move(request);
+	}
+
+	auto stream = z_stream();
+	const auto init = deflateInit2(
+		&stream,
+		Z_DEFAULT_COMPRESSION,
+		Z_DEFLATED,
+		16 + MAX_WBITS,
+		8,
+		Z_DEFAULT_STRATEGY);
+	if (init != Z_OK) {
+		return std::move(request);
+	}
+	auto packed = QByteArray(deflateBound(&stream, length), Qt::Uninitialized);
+	stream.next_in = reinterpret_cast<Bytef*>(
+		request->data() + kBodyPosition);
+	stream.avail_in = length;
+	stream.next_out = reinterpret_cast<Bytef*>(packed.data());
+	stream.avail_out = packed.size();
+	const auto done = deflate(&stream, Z_FINISH);
+	packed.resize(stream.total_out);
+	deflateEnd(&stream);
+	if (done != Z_STREAM_END) {
+		return std::move(request);
+	}
+
+	const auto bytes = MTP_bytes(std::move(packed));
+	const auto packedLength = sizeof(mtpPrime) + bytes.innerLength();
+	if (packedLength >= length) {
+		return std::move(request);
+	}
+	auto result = SecureRequest::Prepare(packedLength >> 2);
+	result->push_back(mtpc_gzip_packed);
+	bytes.write(*result);
+	return result;
+}
 
 } // namespace
 
@@ -61,6 +117,7 @@ public:
 	void restart(ShiftedDcId shiftedDcId);
 	int32 dcstate(ShiftedDcId shiftedDcId = 0);
 	QString dctransport(ShiftedDcId shiftedDcId = 0);
+	QueuesUsage queuesUsage() const;
 	void ping();
 	void cancel(mtpRequestId requestId);
 	int32 state(mtpRequestId requestId); // < 0 means waiting for such count of ms
@@ -212,6 +269,7 @@ private:
 	std::map<DcId, std::vector<mtpRequestId>> _authWaiters;
 
 	RPCResponseHandler _globalHandler;
+	internal::TypeDataPool _typeDataPool;
 	Fn<void(ShiftedDcId shiftedDcId, int32 state)> _stateChangedHandler;
 	Fn<void(ShiftedDcId shiftedDcId)> _sessionResetHandler;
 
@@ -381,6 +439,7 @@ void Instance::Private::setMainDcId(DcId mainDcId) {
 	_mainDcId = mainDcId;
 	if (oldMainDcId != _mainDcId) {
 		killSession(oldMainDcId);
+		killSession(ShiftDcId(oldMainDcId, kBulkDcShift));
 	}
 	Local::writeMtpData();
 }
@@ -535,6 +594,17 @@ void Instance::Private::cancel(mtpRequestId requestId) {
 }
 
 // result < 0 means waiting for such count of ms.
+QueuesUsage Instance::Private::queuesUsage() const {
+	auto result = QueuesUsage();
+	for (const auto &[shiftedDcId, session] : _sessions) {
+		const auto usage = session->queuesUsage();
+		result.requests += usage.requests;
+		result.received += usage.received;
+		result.bytes += usage.bytes;
+	}
+	return result;
+}
+
 int32 Instance::Private::state(mtpRequestId requestId) {
 	if (requestId > 0) {
 		if (const auto shiftedDcId = queryRequestByDc(requestId)) {
@@ -878,6 +948,13 @@ void Instance::Private::sendRequest(
 		mtpRequestId afterRequestId) {
 	const auto session = getSession(shiftedDcId);
 
+	if (internal::TracingEnabled()
+		&& request->size() > SecureRequest::kMessageBodyPosition) {
+		internal::TraceRequest(
+			requestId,
+			mtpTypeId((*request)[SecureRequest::kMessageBodyPosition]));
+	}
+	request = GzipPacked(std::move(request));
 	request->requestId = requestId;
 	storeRequest(requestId, request, std::move(callbacks));
 
@@ -904,6 +981,7 @@ void Instance::Private::registerRequest(
 
 void Instance::Private::unregisterRequest(mtpRequestId requestId) {
 	DEBUG_LOG(("MTP Info: unregistering request %1.").arg(requestId));
+	internal::ForgetTracedRequest(requestId);
 
 	_requestsDelays.erase(requestId);
 
@@ -1010,6 +1088,8 @@ void Instance::Private::execCallback(
 		mtpRequestId requestId,
 		const mtpPrime *from,
 		const mtpPrime *end) {
+	internal::CaptureReceived(requestId, from, end);
+
 	RPCResponseHandler h;
 	{
 		QMutexLocker locker(&_parserMapLock);
@@ -1022,7 +1102,9 @@ void Instance::Private::execCallback(
 		}
 	}
 	if (h.onDone || h.onFail) {
+		internal::TypeDataPool::Scope pool(_typeDataPool);
 		const auto handleError = [&](const MTPRpcError &error) {
+			internal::TraceRequest(requestId, internal::TraceStage::Handled);
 			const auto wrapped = RPCError(error);
 			DEBUG_LOG(("RPC Info: "
 				"error received, code %1, type %2, description: %3"
@@ -1044,6 +1126,9 @@ void Instance::Private::execCallback(
 				error.read(from, end);
 				handleError(error);
 			} else {
+				internal::TraceRequest(
+					requestId,
+					internal::TraceStage::Handled);
 				if (h.onDone) {
 					(*h.onDone)(requestId, from, end);
 				}
@@ -1067,7 +1152,10 @@ bool Instance::Private::hasCallbacks(mtpRequestId requestId) {
 }
 
 void Instance::Private::globalCallback(const mtpPrime *from, const mtpPrime *end) {
+	internal::CaptureReceived(0, from, end);
+
 	if (_globalHandler.onDone) {
+		internal::TypeDataPool::Scope pool(_typeDataPool);
 		(*_globalHandler.onDone)(0, from, end); // some updates were received
 	}
 }
@@ -1584,6 +1672,10 @@ QString Instance::dctransport(ShiftedDcId shiftedDcId) {
 	return _private->dctransport(shiftedDcId);
 }
 
+QueuesUsage Instance::queuesUsage() const {
+	return _private->queuesUsage();
+}
+
 void Instance::ping() {
 	_private->ping();
 }
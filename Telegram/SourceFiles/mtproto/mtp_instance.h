@@ -10,6 +10,7 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 #include <map>
 #include <set>
 #include "mtproto/rpc_sender.h"
+#include "scheme.h"
 
 namespace MTP {
 namespace internal {
@@ -23,6 +24,26 @@ class AuthKey;
 using AuthKeyPtr = std::shared_ptr<AuthKey>;
 using AuthKeysList = std::vector<AuthKeyPtr>;
 
+// Requests with large responses are sent through a separate session to
+// the main dc, so that they don't delay small requests in the main one.
+template <typename Request>
+constexpr auto IsBulkRequest = false;
+
+template <>
+constexpr auto IsBulkRequest<MTPchannels_GetParticipants> = true;
+
+template <>
+constexpr auto IsBulkRequest<MTPmessages_GetHistory> = true;
+
+template <>
+constexpr auto IsBulkRequest<MTPmessages_GetStickerSet> = true;
+
+struct QueuesUsage {
+	int requests = 0;
+	int received = 0;
+	int64 bytes = 0;
+};
+
 class Instance : public QObject {
 	Q_OBJECT
 
@@ -68,6 +89,9 @@ public:
 			ShiftedDcId shiftedDcId = 0,
 			TimeMs msCanWait = 0,
 			mtpRequestId afterRequestId = 0) {
+		if (IsBulkRequest<Request> && !shiftedDcId && !afterRequestId) {
+			shiftedDcId = ShiftDcId(0, kBulkDcShift);
+		}
 		const auto requestId = GetNextRequestId();
 		sendSerialized(
 			requestId,
@@ -135,6 +159,7 @@ public:
 	void restart(ShiftedDcId shiftedDcId);
 	int32 dcstate(ShiftedDcId shiftedDcId = 0);
 	QString dctransport(ShiftedDcId shiftedDcId = 0);
+	QueuesUsage queuesUsage() const;
 	void ping();
 	void cancel(mtpRequestId requestId);
 	int32 state(mtpRequestId requestId); // < 0 means waiting for such count of ms
@@ -0,0 +1,229 @@
+/*
+This file is part of Telegram Desktop,
+the official desktop application for the Telegram messaging service.
+
+For license and copyright information please follow this link:
+https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
+*/
+#include "mtproto/request_tracer.h"
+
+namespace MTP {
+namespace internal {
+
+std::atomic<bool> TracingEnabledValue = { false };
+
+namespace {
+
+constexpr auto kBucketsCount = 16;
+constexpr auto kMaxTracedRequests = 4096;
+constexpr auto kStagesCount = int(TraceStage::Handled) + 1;
+
+enum class Interval {
+	Queue, // Enqueued -> Sent.
+	Ack, // Sent -> Acked.
+	Response, // Sent -> Received.
+	Dispatch, // Received -> Handled.
+	Total, // Enqueued -> Handled.
+};
+constexpr auto kIntervalsCount = int(Interval::Total) + 1;
+
+// Bucket i > 0 holds values in [2^(i-1), 2^i) milliseconds,
+// the last one holds everything that is even larger.
+struct Histogram {
+	void add(TimeMs value);
+	TimeMs percentile(int percent) const;
+
+	std::array<int, kBucketsCount> buckets = { { 0 } };
+	int count = 0;
+	TimeMs sum = 0;
+	TimeMs max = 0;
+};
+
+struct Method {
+	std::array<Histogram, kIntervalsCount> intervals;
+	int count = 0;
+};
+
+struct Request {
+	mtpTypeId type = 0;
+	std::array<TimeMs, kStagesCount> stamps = { { 0 } };
+};
+
+struct Tracer {
+	QMutex mutex;
+	std::map<mtpRequestId, Request> requests;
+	std::map<mtpTypeId, Method> methods;
+};
+
+Tracer &GetTracer() {
+	static Tracer result;
+	return result;
+}
+
+void Histogram::add(TimeMs value) {
+	value = std::max(value, TimeMs(0));
+	auto index = 0;
+	while (index + 1 < kBucketsCount && (TimeMs(1) << index) <= value) {
+		++index;
+	}
+	++buckets[index];
+	++count;
+	sum += value;
+	accumulate_max(max, value);
+}
+
+TimeMs Histogram::percentile(int percent) const {
+	const auto needed = (int64(count) * percent + 99) / 100;
+	auto collected = int64(0);
+	for (auto index = 0; index != kBucketsCount; ++index) {
+		collected += buckets[index];
+		if (collected >= needed) {
+			return std::min(TimeMs(1) << index, max);
+		}
+	}
+	return max;
+}
+
+TimeMs Stamp(const Request &request, TraceStage stage) {
+	return request.stamps[int(stage)];
+}
+
+void AddInterval(
+		Method &method,
+		Interval interval,
+		TimeMs from,
+		TimeMs till) {
+	if (from && till) {
+		method.intervals[int(interval)].add(till - from);
+	}
+}
+
+void Collect(const Request &request) {
+	const auto enqueued = Stamp(request, TraceStage::Enqueued);
+	const auto sent = Stamp(request, TraceStage::Sent);
+	const auto acked = Stamp(request, TraceStage::Acked);
+	const auto received = Stamp(request, TraceStage::Received);
+	const auto handled = Stamp(request, TraceStage::Handled);
+
+	auto &method = GetTracer().methods[request.type];
+	++method.count;
+	AddInterval(method, Interval::Queue, enqueued, sent);
+	AddInterval(method, Interval::Ack, sent, acked);
+	AddInterval(method, Interval::Response, sent, received);
+	AddInterval(method, Interval::Dispatch, received, handled);
+	AddInterval(method, Interval::Total, enqueued, handled);
+}
+
+QString IntervalName(Interval interval) {
+	switch (interval) {
+	case Interval::Queue: return qsl("queue");
+	case Interval::Ack: return qsl("ack");
+	case Interval::Response: return qsl("response");
+	case Interval::Dispatch: return qsl("dispatch");
+	case Interval::Total: return qsl("total");
+	}
+	Unexpected("Interval in IntervalName.");
+}
+
+} // namespace
+
+void TraceRequestStarted(mtpRequestId requestId, mtpTypeId type) {
+	auto &tracer = GetTracer();
+	QMutexLocker lock(&tracer.mutex);
+	if (tracer.requests.size() >= kMaxTracedRequests) {
+		return;
+	}
+	auto &request = tracer.requests[requestId];
+	request.type = type;
+	request.stamps[int(TraceStage::Enqueued)] = getms(true);
+}
+
+void TraceRequestStage(mtpRequestId requestId, TraceStage stage) {
+	auto &tracer = GetTracer();
+	QMutexLocker lock(&tracer.mutex);
+	const auto i = tracer.requests.find(requestId);
+	if (i == tracer.requests.end()) {
+		return;
+	}
+
+	// Resent requests keep the time of the last send.
+	i->second.stamps[int(stage)] = getms(true);
+	if (stage == TraceStage::Handled) {
+		Collect(i->second);
+		tracer.requests.erase(i);
+	}
+}
+
+void TraceRequestForgotten(mtpRequestId requestId) {
+	auto &tracer = GetTracer();
+	QMutexLocker lock(&tracer.mutex);
+	tracer.requests.erase(requestId);
+}
+
+} // namespace internal
+
+void SetRequestTracingEnabled(bool enabled) {
+	auto &tracer = internal::GetTracer();
+	QMutexLocker lock(&tracer.mutex);
+	internal::TracingEnabledValue = enabled;
+	tracer.requests.clear();
+	if (enabled) {
+		tracer.methods.clear();
+	}
+}
+
+bool RequestTracingEnabled() {
+	return internal::TracingEnabled();
+}
+
+QString RequestTracingReport() {
+	using namespace internal;
+
+	auto &tracer = GetTracer();
+	QMutexLocker lock(&tracer.mutex);
+
+	auto methods = std::vector<std::pair<mtpTypeId, const Method*>>();
+	methods.reserve(tracer.methods.size());
+	for (const auto &[type, method] : tracer.methods) {
+		methods.emplace_back(type, &method);
+	}
+	ranges::sort(methods, std::greater<>(), [](const auto &pair) {
+		return pair.second->count;
+	});
+
+	auto result = QStringList();
+	result.push_back(
+		qsl("Requests latency, ms: avg / p50 / p90 / p99 / max"));
+	for (const auto &[type, method] : methods) {
+		result.push_back(qsl("0x%1, %2 requests"
+			).arg(type, 8, 16, QChar('0')
+			).arg(method->count));
+		for (auto index = 0; index != kIntervalsCount; ++index) {
+			const auto &histogram = method->intervals[index];
+			if (!histogram.count) {
+				continue;
+			}
+			result.push_back(qsl("\t%1: %2 / %3 / %4 / %5 / %6"
+				).arg(IntervalName(Interval(index))
+				).arg(histogram.sum / histogram.count
+				).arg(histogram.percentile(50)
+				).arg(histogram.percentile(90)
+				).arg(histogram.percentile(99)
+				).arg(histogram.max));
+		}
+	}
+	return result.join('\n');
+}
+
+bool WriteRequestTracingReport(const QString &path) {
+	QFile file(path);
+	if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+		LOG(("MTP Error: could not write requests trace to '%1'."
+			).arg(path));
+		return false;
+	}
+	file.write(RequestTracingReport().toUtf8());
+	return true;
+}
+
+} // namespace MTP
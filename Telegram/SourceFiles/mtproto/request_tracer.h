@@ -0,0 +1,59 @@
+/*
+This file is part of Telegram Desktop,
+the official desktop application for the Telegram messaging service.
+
+For license and copyright information please follow this link:
+https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
+*/
+#pragma once
+
+namespace MTP {
+namespace internal {
+
+enum class TraceStage {
+	Enqueued,
+	Sent,
+	Acked,
+	Received,
+	Handled,
+};
+
+extern std::atomic<bool> TracingEnabledValue;
+
+inline bool TracingEnabled() {
+	return TracingEnabledValue.load(std::memory_order_relaxed);
+}
+
+void TraceRequestStarted(mtpRequestId requestId, mtpTypeId type);
+void TraceRequestStage(mtpRequestId requestId, TraceStage stage);
+void TraceRequestForgotten(mtpRequestId requestId);
+
+// Tracing is disabled by default and costs a single relaxed load then.
+inline void TraceRequest(mtpRequestId requestId, mtpTypeId type) {
+	if (TracingEnabled()) {
+		TraceRequestStarted(requestId, type);
+	}
+}
+
+inline void TraceRequest(mtpRequestId requestId, TraceStage stage) {
+	if (TracingEnabled()) {
+		TraceRequestStage(requestId, stage);
+	}
+}
+
+inline void ForgetTracedRequest(mtpRequestId requestId) {
+	if (TracingEnabled()) {
+		TraceRequestForgotten(requestId);
+	}
+}
+
+} // namespace internal
+
+// Collects per method latency histograms of the send queue wait, the ack
+// and the response round trips and of the main thread dispatch.
+void SetRequestTracingEnabled(bool enabled);
+bool RequestTracingEnabled();
+QString RequestTracingReport();
+bool WriteRequestTracingReport(const QString &path);
+
+} // namespace MTP
@@ -16,6 +16,10 @@ namespace MTP {
 namespace internal {
 namespace {
 
+// A burst of responses is handled in slices, so that the main thread
+// gets to process input and paint between them.
+constexpr auto kReceiveTimeSlice = TimeMs(16);
+
 QString LogIds(const QVector<uint64> &ids) {
 	if (!ids.size()) return "[]";
 	auto idsStr = QString("[%1").arg(*ids.cbegin());
@@ -119,6 +123,39 @@ void SessionData::clear(Instance *instance) {
 	instance->clearCallbacksDelayed(std::move(clearCallbacks));
 }
 
+QueuesUsage SessionData::queuesUsage() const {
+	const auto bytes = [](const mtpBuffer &buffer) {
+		return int64(buffer.size()) * int64(sizeof(mtpPrime));
+	};
+	auto result = QueuesUsage();
+	{
+		QReadLocker locker(toSendMutex());
+		for (const auto &request : _toSend) {
+			++result.requests;
+			result.bytes += bytes(*request);
+		}
+	}
+	{
+		QReadLocker locker(haveSentMutex());
+		for (const auto &request : _haveSent) {
+			++result.requests;
+			result.bytes += bytes(*request);
+		}
+	}
+	{
+		QReadLocker locker(haveReceivedMutex());
+		for (const auto &response : _receivedResponses) {
+			++result.received;
+			result.bytes += bytes(response);
+		}
+		for (const auto &update : _receivedUpdates) {
+			++result.received;
+			result.bytes += bytes(update);
+		}
+	}
+	return result;
+}
+
 Session::Session(not_null<Instance*> instance, ShiftedDcId shiftedDcId) : QObject()
 , _instance(instance)
 , data(this)
@@ -249,10 +286,22 @@ void Session::sendAnything(qint64 msCanWait) {
 		DEBUG_LOG(("MTP Info: dcWithShift %1 stopped send timer, can wait for %2ms from current %3").arg(dcWithShift).arg(msWait).arg(msSendCall));
 		sender.stop();
 		msSendCall = 0;
-		needToResumeAndSend();
+		sendQueued();
 	}
 }
 
+void Session::sendQueued() {
+	// Requests added in the same event loop iteration go in one container.
+	if (_sendQueued) {
+		return;
+	}
+	_sendQueued = true;
+	InvokeQueued(this, [=] {
+		_sendQueued = false;
+		needToResumeAndSend();
+	});
+}
+
 void Session::needToResumeAndSend() {
 	if (_killed) {
 		DEBUG_LOG(("Session Info: can't resume a killed session"));
@@ -439,6 +488,10 @@ QString Session::transport() const {
 	return _connection ? _connection->transport() : QString();
 }
 
+QueuesUsage Session::queuesUsage() const {
+	return data.queuesUsage();
+}
+
 mtpRequestId Session::resend(quint64 msgId, qint64 msCanWait, bool forceContainer, bool sendMsgStateInfo) {
 	SecureRequest request;
 	{
@@ -580,6 +633,7 @@ void Session::tryToReceive() {
 		_needToReceive = true;
 		return;
 	}
+	const auto till = getms(true) + kReceiveTimeSlice;
 	while (true) {
 		auto requestId = mtpRequestId(0);
 		auto isUpdate = false;
@@ -611,6 +665,10 @@ void Session::tryToReceive() {
 		} else {
 			_instance->execCallback(requestId, message.constData(), message.constData() + message.size());
 		}
+		if (getms(true) >= till) {
+			QTimer::singleShot(0, this, SLOT(tryToReceive()));
+			return;
+		}
 	}
 }
 
@@ -13,6 +13,7 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 namespace MTP {
 
 class Instance;
+struct QueuesUsage;
 class AuthKey;
 using AuthKeyPtr = std::shared_ptr<AuthKey>;
 
@@ -39,13 +40,15 @@ public:
 
 };
 
+// Received ids are mostly growing, so they are kept in a sorted vector
+// where a new id is usually appended without any allocation.
 class ReceivedMsgIds {
 public:
 	bool registerMsgId(mtpMsgId msgId, bool needAck) {
-		auto i = _idsNeedAck.constFind(msgId);
-		if (i == _idsNeedAck.cend()) {
+		const auto i = _idsNeedAck.find(msgId);
+		if (i == _idsNeedAck.end()) {
 			if (_idsNeedAck.size() < MTPIdsBufferSize || msgId > min()) {
-				_idsNeedAck.insert(msgId, needAck);
+				_idsNeedAck.emplace(msgId, needAck);
 				return true;
 			}
 			MTP_LOG(-1, ("No need to handle - %1 < min = %2").arg(msgId).arg(min()));
@@ -56,18 +59,19 @@ public:
 	}
 
 	mtpMsgId min() const {
-		return _idsNeedAck.isEmpty() ? 0 : _idsNeedAck.cbegin().key();
+		return _idsNeedAck.empty() ? 0 : _idsNeedAck.front().first;
 	}
 
 	mtpMsgId max() const {
-		auto end = _idsNeedAck.cend();
-		return _idsNeedAck.isEmpty() ? 0 : (--end).key();
+		return _idsNeedAck.empty() ? 0 : _idsNeedAck.back().first;
 	}
 
 	void shrink() {
-		auto size = _idsNeedAck.size();
-		while (size-- > MTPIdsBufferSize) {
-			_idsNeedAck.erase(_idsNeedAck.begin());
+		const auto size = int(_idsNeedAck.size());
+		if (size > MTPIdsBufferSize) {
+			_idsNeedAck.erase(
+				_idsNeedAck.begin(),
+				_idsNeedAck.begin() + (size - MTPIdsBufferSize));
 		}
 	}
 
@@ -77,11 +81,11 @@ public:
 		NoAckNeeded,
 	};
 	State lookup(mtpMsgId msgId) const {
-		auto i = _idsNeedAck.constFind(msgId);
-		if (i == _idsNeedAck.cend()) {
+		const auto i = _idsNeedAck.find(msgId);
+		if (i == _idsNeedAck.end()) {
 			return State::NotFound;
 		}
-		return i.value() ? State::NeedsAck : State::NoAckNeeded;
+		return i->second ? State::NeedsAck : State::NoAckNeeded;
 	}
 
 	void clear() {
@@ -89,7 +93,7 @@ public:
 	}
 
 private:
-	QMap<mtpMsgId, bool> _idsNeedAck;
+	base::flat_map<mtpMsgId, bool> _idsNeedAck;
 
 };
 
@@ -276,6 +280,10 @@ public:
 
 	void clear(Instance *instance);
 
+	// Requests waiting to be sent or acknowledged and received messages
+	// waiting to be processed in the main thread.
+	QueuesUsage queuesUsage() const;
+
 private:
 	uint64 _session = 0;
 	uint64 _salt = 0;
@@ -338,6 +346,7 @@ public:
 	int32 requestState(mtpRequestId requestId) const;
 	int32 getState() const;
 	QString transport() const;
+	QueuesUsage queuesUsage() const;
 
 	// Nulls msgId and seqNo in request, if newRequest = true.
 	void sendPrepared(
@@ -374,6 +383,7 @@ public slots:
 
 private:
 	void createDcData();
+	void sendQueued();
 
 	bool rpcErrorOccured(mtpRequestId requestId, const RPCFailHandlerPtr &onFail, const RPCError &err);
 
@@ -381,6 +391,7 @@ private:
 	std::unique_ptr<Connection> _connection;
 
 	bool _killed = false;
+	bool _sendQueued = false;
 	bool _needToReceive = false;
 
 	SessionData data;
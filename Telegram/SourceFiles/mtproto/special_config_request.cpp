@@ -174,7 +174,8 @@ SpecialConfigRequest::SpecialConfigRequest(
 		bytes::const_span secret)> callback,
 	const QString &phone)
 : _callback(std::move(callback))
-, _phone(phone) {
+, _phone(phone)
+, _sendNextTimer([=] { sendNextRequest(); }) {
 	_manager.setProxy(QNetworkProxy::NoProxy);
 	_attempts = {
 		{ Type::App, qsl("software-download.microsoft.com") },
@@ -193,13 +194,21 @@ void SpecialConfigRequest::sendNextRequest() {
 	const auto attempt = _attempts.back();
 	_attempts.pop_back();
 	if (!_attempts.empty()) {
-		App::CallDelayed(kSendNextTimeout, this, [=] {
-			sendNextRequest();
-		});
+		_sendNextTimer.callOnce(kSendNextTimeout);
+	} else {
+		_sendNextTimer.cancel();
 	}
 	performRequest(attempt);
 }
 
+void SpecialConfigRequest::cancelOtherRequests() {
+	_attempts.clear();
+	_sendNextTimer.cancel();
+	for (auto &request : base::take(_requests)) {
+		request.destroy();
+	}
+}
+
 void SpecialConfigRequest::performRequest(const Attempt &attempt) {
 	const auto type = attempt.type;
 	auto url = QUrl();
@@ -234,11 +243,19 @@ void SpecialConfigRequest::requestFinished(
 		Type type,
 		not_null<QNetworkReply*> reply) {
 	const auto result = finalizeRequest(reply);
-	switch (type) {
-	case Type::App: handleResponse(result); break;
-	case Type::Dns: handleResponse(
-		ConcatenateDnsTxtFields(ParseDnsResponse(result))); break;
-	default: Unexpected("Type in SpecialConfigRequest::requestFinished.");
+	const auto good = [&] {
+		switch (type) {
+		case Type::App: return handleResponse(result);
+		case Type::Dns: return handleResponse(
+			ConcatenateDnsTxtFields(ParseDnsResponse(result)));
+		}
+		Unexpected("Type in SpecialConfigRequest::requestFinished.");
+	}();
+	if (good) {
+		cancelOtherRequests();
+	} else if (!_attempts.empty()) {
+		// Don't wait for the timeout if this attempt failed already.
+		sendNextRequest();
 	}
 }
 
@@ -328,20 +345,20 @@ bool SpecialConfigRequest::decryptSimpleConfig(const QByteArray &bytes) {
 	return true;
 }
 
-void SpecialConfigRequest::handleResponse(const QByteArray &bytes) {
+bool SpecialConfigRequest::handleResponse(const QByteArray &bytes) {
 	if (!decryptSimpleConfig(bytes)) {
-		return;
+		return false;
 	}
 	Assert(_simpleConfig.type() == mtpc_help_configSimple);
 	auto &config = _simpleConfig.c_help_configSimple();
 	auto now = unixtime();
 	if (now < config.vdate.v || now > config.vexpires.v) {
 		LOG(("Config Error: Bad date frame for simple config: %1-%2, our time is %3.").arg(config.vdate.v).arg(config.vexpires.v).arg(now));
-		return;
+		return false;
 	}
 	if (config.vrules.v.empty()) {
 		LOG(("Config Error: Empty simple config received."));
-		return;
+		return false;
 	}
 	for (auto &rule : config.vrules.v) {
 		Assert(rule.type() == mtpc_accessPointRule);
@@ -378,6 +395,7 @@ void SpecialConfigRequest::handleResponse(const QByteArray &bytes) {
 			}
 		}
 	}
+	return true;
 }
 
 DomainResolver::DomainResolver(Fn<void(
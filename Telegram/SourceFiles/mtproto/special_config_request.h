@@ -8,6 +8,7 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 #pragma once
 
 #include "base/bytes.h"
+#include "base/timer.h"
 
 namespace MTP {
 
@@ -47,7 +48,8 @@ private:
 	void performRequest(const Attempt &attempt);
 	void requestFinished(Type type, not_null<QNetworkReply*> reply);
 	QByteArray finalizeRequest(not_null<QNetworkReply*> reply);
-	void handleResponse(const QByteArray &bytes);
+	bool handleResponse(const QByteArray &bytes);
+	void cancelOtherRequests();
 	bool decryptSimpleConfig(const QByteArray &bytes);
 
 	Fn<void(
@@ -61,6 +63,7 @@ private:
 	QNetworkAccessManager _manager;
 	std::vector<Attempt> _attempts;
 	std::vector<ServiceWebRequest> _requests;
+	base::Timer _sendNextTimer;
 
 };
 
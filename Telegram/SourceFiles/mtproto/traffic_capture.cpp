@@ -0,0 +1,147 @@
+/*
+This file is part of Telegram Desktop,
+the official desktop application for the Telegram messaging service.
+
+For license and copyright information please follow this link:
+https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
+*/
+#include "mtproto/traffic_capture.h"
+
+namespace MTP {
+namespace internal {
+
+std::atomic<bool> CapturingEnabledValue = { false };
+
+namespace {
+
+constexpr auto kSignature = mtpPrime(0x50434454); // "TDCP"
+constexpr auto kVersion = mtpPrime(1);
+constexpr auto kMaxPacketPrimes = mtpPrime(16 * 1024 * 1024);
+
+// Each packet is written as the receive time in milliseconds (two primes),
+// the request id, the primes count and the primes of the packet.
+struct Capture {
+	QMutex mutex;
+	QFile file;
+	TimeMs started = 0;
+};
+
+Capture &GetCapture() {
+	static Capture result;
+	return result;
+}
+
+template <typename Type>
+bool WriteValue(QFile &file, const Type &value) {
+	const auto size = qint64(sizeof(Type));
+	return file.write(reinterpret_cast<const char*>(&value), size) == size;
+}
+
+template <typename Type>
+bool ReadValue(QFile &file, Type &value) {
+	const auto size = qint64(sizeof(Type));
+	return file.read(reinterpret_cast<char*>(&value), size) == size;
+}
+
+} // namespace
+
+void CaptureReceivedPacket(
+		mtpRequestId requestId,
+		const mtpPrime *from,
+		const mtpPrime *end) {
+	auto &capture = GetCapture();
+	QMutexLocker lock(&capture.mutex);
+	if (!capture.file.isOpen()) {
+		return;
+	}
+	const auto received = int64(getms(true) - capture.started);
+	const auto count = mtpPrime(end - from);
+	const auto size = qint64(count * sizeof(mtpPrime));
+	const auto written = WriteValue(capture.file, received)
+		&& WriteValue(capture.file, mtpPrime(requestId))
+		&& WriteValue(capture.file, count)
+		&& (capture.file.write(reinterpret_cast<const char*>(from), size)
+			== size);
+	if (!written) {
+		LOG(("MTP Error: could not write traffic capture to '%1'."
+			).arg(capture.file.fileName()));
+		CapturingEnabledValue = false;
+		capture.file.close();
+	}
+}
+
+} // namespace internal
+
+bool StartTrafficCapture(const QString &path) {
+	auto &capture = internal::GetCapture();
+	QMutexLocker lock(&capture.mutex);
+	if (capture.file.isOpen()) {
+		return true;
+	}
+	capture.file.setFileName(path);
+	if (!capture.file.open(QIODevice::WriteOnly | QIODevice::Truncate)
+		|| !internal::WriteValue(capture.file, internal::kSignature)
+		|| !internal::WriteValue(capture.file, internal::kVersion)) {
+		LOG(("MTP Error: could not start traffic capture to '%1'."
+			).arg(path));
+		capture.file.close();
+		return false;
+	}
+	capture.started = getms(true);
+	internal::CapturingEnabledValue = true;
+	return true;
+}
+
+void StopTrafficCapture() {
+	auto &capture = internal::GetCapture();
+	QMutexLocker lock(&capture.mutex);
+	internal::CapturingEnabledValue = false;
+	capture.file.close();
+}
+
+bool TrafficCaptureStarted() {
+	return internal::CapturingEnabled();
+}
+
+std::vector<CapturedPacket> ReadTrafficCapture(const QString &path) {
+	using namespace internal;
+
+	auto result = std::vector<CapturedPacket>();
+	QFile file(path);
+	auto signature = mtpPrime(0);
+	auto version = mtpPrime(0);
+	if (!file.open(QIODevice::ReadOnly)
+		|| !ReadValue(file, signature)
+		|| !ReadValue(file, version)
+		|| signature != kSignature
+		|| version != kVersion) {
+		LOG(("MTP Error: could not read traffic capture from '%1'."
+			).arg(path));
+		return result;
+	}
+	while (!file.atEnd()) {
+		auto received = int64(0);
+		auto requestId = mtpPrime(0);
+		auto count = mtpPrime(0);
+		if (!ReadValue(file, received)
+			|| !ReadValue(file, requestId)
+			|| !ReadValue(file, count)
+			|| count < 0
+			|| count > kMaxPacketPrimes) {
+			break;
+		}
+		auto packet = CapturedPacket();
+		packet.received = received;
+		packet.requestId = requestId;
+		packet.data.resize(count);
+		const auto size = qint64(count * sizeof(mtpPrime));
+		const auto bytes = reinterpret_cast<char*>(packet.data.data());
+		if (file.read(bytes, size) != size) {
+			break;
+		}
+		result.push_back(std::move(packet));
+	}
+	return result;
+}
+
+} // namespace MTP
@@ -0,0 +1,51 @@
+/*
+This file is part of Telegram Desktop,
+the official desktop application for the Telegram messaging service.
+
+For license and copyright information please follow this link:
+https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
+*/
+#pragma once
+
+namespace MTP {
+namespace internal {
+
+extern std::atomic<bool> CapturingEnabledValue;
+
+inline bool CapturingEnabled() {
+	return CapturingEnabledValue.load(std::memory_order_relaxed);
+}
+
+void CaptureReceivedPacket(
+	mtpRequestId requestId,
+	const mtpPrime *from,
+	const mtpPrime *end);
+
+// Capturing is disabled by default and costs a single relaxed load then.
+inline void CaptureReceived(
+		mtpRequestId requestId,
+		const mtpPrime *from,
+		const mtpPrime *end) {
+	if (CapturingEnabled()) {
+		CaptureReceivedPacket(requestId, from, end);
+	}
+}
+
+} // namespace internal
+
+// Writes the decrypted responses and updates with the time they were
+// received to a file, so that their handling can be replayed offline.
+bool StartTrafficCapture(const QString &path);
+void StopTrafficCapture();
+bool TrafficCaptureStarted();
+
+struct CapturedPacket {
+	TimeMs received = 0; // Since the capture was started.
+	mtpRequestId requestId = 0; // Zero for updates.
+	mtpBuffer data;
+};
+
+// Returns the packets read until the end or the first broken one.
+std::vector<CapturedPacket> ReadTrafficCapture(const QString &path);
+
+} // namespace MTP
@@ -8,6 +8,9 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 #include "observer_peer.h"
 
 #include "base/observer.h"
+#include "base/flat_map.h"
+
+#include <array>
 
 namespace Notify {
 namespace {
@@ -28,6 +31,126 @@ void FinishCallback() {
 
 base::Observable<PeerUpdate, PeerUpdatedHandler> PeerUpdatedObservable;
 
+// Viewers are indexed by peer and by flag bit, so that an update reaches
+// only the viewers of its peer and of the flags it has.
+class ViewersTable {
+public:
+	rpl::lifetime add(
+		PeerData *peer,
+		PeerUpdate::Flags flags,
+		Fn<void(const PeerUpdate&)> callback);
+	void send(const PeerUpdate &update);
+
+private:
+	static constexpr auto kFlagsCount = 32;
+
+	struct Viewer {
+		PeerData *peer = nullptr;
+		PeerUpdate::Flags flags;
+		Fn<void(const PeerUpdate&)> callback;
+		uint64 sent = 0;
+		bool removed = false;
+	};
+	using Viewers = std::vector<std::shared_ptr<Viewer>>;
+
+	void remove(const std::shared_ptr<Viewer> &viewer);
+	static void Remove(Viewers &list, const std::shared_ptr<Viewer> &viewer);
+
+	base::flat_map<PeerData*, Viewers> _byPeer;
+	std::array<Viewers, kFlagsCount> _byFlag;
+	uint64 _sent = 0;
+
+};
+
+rpl::lifetime ViewersTable::add(
+		PeerData *peer,
+		PeerUpdate::Flags flags,
+		Fn<void(const PeerUpdate&)> callback) {
+	auto viewer = std::make_shared<Viewer>();
+	viewer->peer = peer;
+	viewer->flags = flags;
+	viewer->callback = std::move(callback);
+	if (peer) {
+		_byPeer[peer].push_back(viewer);
+	} else {
+		for (auto i = 0; i != kFlagsCount; ++i) {
+			if (flags.value() & (1U << i)) {
+				_byFlag[i].push_back(viewer);
+			}
+		}
+	}
+	return rpl::lifetime([=, weak = std::weak_ptr<Viewer>(viewer)] {
+		if (const auto strong = weak.lock()) {
+			remove(strong);
+		}
+	});
+}
+
+void ViewersTable::remove(const std::shared_ptr<Viewer> &viewer) {
+	viewer->removed = true;
+	if (const auto peer = viewer->peer) {
+		const auto i = _byPeer.find(peer);
+		if (i != end(_byPeer)) {
+			Remove(i->second, viewer);
+			if (i->second.empty()) {
+				_byPeer.erase(i);
+			}
+		}
+	} else {
+		for (auto i = 0; i != kFlagsCount; ++i) {
+			if (viewer->flags.value() & (1U << i)) {
+				Remove(_byFlag[i], viewer);
+			}
+		}
+	}
+}
+
+void ViewersTable::Remove(
+		Viewers &list,
+		const std::shared_ptr<Viewer> &viewer) {
+	list.erase(
+		std::remove(begin(list), end(list), viewer),
+		end(list));
+}
+
+void ViewersTable::send(const PeerUpdate &update) {
+	// Collect the receivers first, because callbacks may add or remove
+	// viewers. A viewer of several flags is found in several lists.
+	const auto sent = ++_sent;
+	auto receivers = Viewers();
+	const auto i = _byPeer.find(update.peer);
+	if (i != end(_byPeer)) {
+		for (const auto &viewer : i->second) {
+			if (viewer->flags & update.flags) {
+				receivers.push_back(viewer);
+			}
+		}
+	}
+	for (auto i = 0; i != kFlagsCount; ++i) {
+		if (!(update.flags.value() & (1U << i))) {
+			continue;
+		}
+		for (const auto &viewer : _byFlag[i]) {
+			if (viewer->sent != sent) {
+				viewer->sent = sent;
+				receivers.push_back(viewer);
+			}
+		}
+	}
+	for (const auto &viewer : receivers) {
+		if (!viewer->removed) {
+			viewer->callback(update);
+		}
+	}
+}
+
+ViewersTable PeerUpdatedViewers;
+
+void SendPeerUpdate(const PeerUpdate &update) {
+	PeerUpdatedObservable.notify(update, true);
+	PeerUpdatedViewers.send(update);
+}
+
 } // namespace
 
 void mergePeerUpdate(PeerUpdate &mergeTo, const PeerUpdate &mergeFrom) {
@@ -75,11 +198,11 @@ void peerUpdatedSendDelayed() {
 
 	auto smallList = base::take(*SmallUpdates);
 	auto allList = base::take(*AllUpdates);
-	for (auto &update : smallList) {
-		PeerUpdated().notify(std::move(update), true);
+	for (const auto &update : smallList) {
+		SendPeerUpdate(update);
 	}
-	for (auto &update : allList) {
-		PeerUpdated().notify(std::move(update), true);
+	for (const auto &update : allList) {
+		SendPeerUpdate(update);
 	}
 
 	if (SmallUpdates->isEmpty()) {
@@ -88,6 +211,10 @@ void peerUpdatedSendDelayed() {
 	}
 }
 
+void peerUpdated(const PeerUpdate &update) {
+	SendPeerUpdate(update);
+}
+
 base::Observable<PeerUpdate, PeerUpdatedHandler> &PeerUpdated() {
 	return PeerUpdatedObservable;
 }
@@ -95,24 +222,22 @@ base::Observable<PeerUpdate, PeerUpdatedHandler> &PeerUpdated() {
 rpl::producer<PeerUpdate> PeerUpdateViewer(
 		PeerUpdate::Flags flags) {
 	return [=](const auto &consumer) {
-		auto lifetime = rpl::lifetime();
-		lifetime.make_state<base::Subscription>(
-			PeerUpdated().add_subscription({ flags, [=](
-					const PeerUpdate &update) {
-				consumer.put_next_copy(update);
-			}}));
-		return lifetime;
+		return PeerUpdatedViewers.add(nullptr, flags, [=](
+				const PeerUpdate &update) {
+			consumer.put_next_copy(update);
+		});
 	};
 }
 
 rpl::producer<PeerUpdate> PeerUpdateViewer(
 		not_null<PeerData*> peer,
 		PeerUpdate::Flags flags) {
-	return PeerUpdateViewer(
-		flags
-	) | rpl::filter([=](const PeerUpdate &update) {
-		return (update.peer == peer);
-	});
+	return [=](const auto &consumer) {
+		return PeerUpdatedViewers.add(peer, flags, [=](
+				const PeerUpdate &update) {
+			consumer.put_next_copy(update);
+		});
+	};
 }
 
 rpl::producer<PeerUpdate> PeerUpdateValue(
@@ -85,6 +85,9 @@ inline void peerUpdatedDelayed(PeerData *peer, PeerUpdate::Flags events) {
 }
 void peerUpdatedSendDelayed();
 
+// Sends the update right away without merging it with the delayed ones.
+void peerUpdated(const PeerUpdate &update);
+
 class PeerUpdatedHandler {
 public:
 	template <typename Lambda>
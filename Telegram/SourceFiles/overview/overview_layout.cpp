@@ -382,6 +382,11 @@ TextState Photo::getState(
 	return {};
 }
 
+void Photo::clearHeavyPart() {
+	_pix = QPixmap();
+	_goodLoaded = false;
+}
+
 Video::Video(
 	not_null<HistoryItem*> parent,
 	not_null<DocumentData*> video)
@@ -544,6 +549,11 @@ TextState Video::getState(
 	return {};
 }
 
+void Video::clearHeavyPart() {
+	_pix = QPixmap();
+	_thumbLoaded = false;
+}
+
 void Video::updateStatusText() {
 	bool showPause = false;
 	int statusSize = 0;
@@ -1156,6 +1166,10 @@ TextState Document::getState(
 	return {};
 }
 
+void Document::clearHeavyPart() {
+	_thumb = QPixmap();
+}
+
 const style::RoundCheckbox &Document::checkboxStyle() const {
 	return st::overviewSmallCheck;
 }
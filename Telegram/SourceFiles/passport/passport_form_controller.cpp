@@ -1382,10 +1382,13 @@ void FormController::uploadScan(
 		return std::nullopt;
 	}();
 	auto &scan = nonconst->fileInEdit(type, fileIndex);
-	encryptFile(scan, std::move(content), [=](UploadScanData &&result) {
-		uploadEncryptedFile(
-			nonconst->fileInEdit(type, fileIndex),
-			std::move(result));
+	encryptFile(scan, std::move(content), [=](
+			UploadScanData &&result,
+			QImage &&image) {
+		auto &file = nonconst->fileInEdit(type, fileIndex);
+		file.fields.image = std::move(image);
+		_scanUpdated.fire(&file);
+		uploadEncryptedFile(file, std::move(result));
 	});
 }
 
@@ -1412,7 +1415,6 @@ void FormController::prepareFile(
 	file.fields.dcId = MTP::maindc();
 	file.fields.secret = GenerateSecretBytes();
 	file.fields.date = unixtime();
-	file.fields.image = ReadImage(bytes::make_span(content));
 	file.fields.downloadOffset = file.fields.size;
 
 	_scanUpdated.fire(&file);
@@ -1421,7 +1423,7 @@ void FormController::prepareFile(
 void FormController::encryptFile(
 		EditFile &file,
 		QByteArray &&content,
-		Fn<void(UploadScanData &&result)> callback) {
+		Fn<void(UploadScanData &&result, QImage &&image)> callback) {
 	prepareFile(file, content);
 
 	const auto weak = std::weak_ptr<bool>(file.guard);
@@ -1431,6 +1433,8 @@ void FormController::encryptFile(
 		bytes = std::move(content),
 		fileSecret = file.fields.secret
 	] {
+		// The preview is decoded here as well, not in the main thread.
+		auto image = ReadImage(bytes::make_span(bytes));
 		auto data = EncryptData(
 			bytes::make_span(bytes),
 			fileSecret);
@@ -1443,9 +1447,13 @@ void FormController::encryptFile(
 			result.bytes.data(),
 			result.bytes.size(),
 			result.md5checksum.data());
-		crl::on_main([=, encrypted = std::move(result)]() mutable {
+		crl::on_main([
+			=,
+			encrypted = std::move(result),
+			image = std::move(image)
+		]() mutable {
 			if (weak.lock()) {
-				callback(std::move(encrypted));
+				callback(std::move(encrypted), std::move(image));
 			}
 		});
 	});
@@ -13,6 +13,8 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 #include "history/history.h"
 #include "lang/lang_keys.h"
 
+#include <crl/crl.h>
+
 namespace Platform {
 namespace Notifications {
 #ifndef TDESKTOP_DISABLE_GTK_INTEGRATION
@@ -227,6 +229,28 @@ private:
 
 using Notification = std::shared_ptr<NotificationData>;
 
+// Showing and closing make synchronous D-Bus calls to the notifications
+// server, so they are done in order on a separate queue.
+class NotificationSender {
+public:
+	explicit NotificationSender(crl::weak_on_queue<NotificationSender>) {
+	}
+
+	void show(
+			const Notification &notification,
+			const QString &imagePath,
+			FnMut<void()> failed) {
+		notification->setImage(imagePath);
+		if (!notification->show()) {
+			failed();
+		}
+	}
+	void close(const Notification &notification) {
+		notification->close();
+	}
+
+};
+
 QString GetServerName() {
 	if (!LibNotifyLoaded()) {
 		return QString();
@@ -321,6 +345,7 @@ public:
 private:
 	QString escapeNotificationText(const QString &text) const;
 	void showNextNotification();
+	void closeNotification(const Notification &notification);
 
 	struct QueuedNotification {
 		PeerData *peer = nullptr;
@@ -345,6 +370,7 @@ private:
 	bool _poorSupported = false;
 
 	std::shared_ptr<Manager*> _guarded;
+	crl::object_on_queue<NotificationSender> _sender;
 
 };
 #endif // !TDESKTOP_DISABLE_GTK_INTEGRATION
@@ -446,7 +472,7 @@ void Manager::Private::showNextNotification() {
 	} else {
 		key = data.peer->userpicUniqueKey();
 	}
-	notification->setImage(_cachedUserpics.get(key, data.peer));
+	const auto imagePath = _cachedUserpics.get(key, data.peer);
 
 	auto i = _notifications.find(peerId);
 	if (i != _notifications.cend()) {
@@ -454,7 +480,7 @@ void Manager::Private::showNextNotification() {
 		if (j != i->cend()) {
 			auto oldNotification = j.value();
 			i->erase(j);
-			oldNotification->close();
+			closeNotification(oldNotification);
 			i = _notifications.find(peerId);
 		}
 	}
@@ -462,14 +488,22 @@ void Manager::Private::showNextNotification() {
 		i = _notifications.insert(peerId, QMap<MsgId, Notification>());
 	}
 	_notifications[peerId].insert(msgId, notification);
-	if (!notification->show()) {
-		i = _notifications.find(peerId);
-		if (i != _notifications.cend()) {
-			i->remove(msgId);
-			if (i->isEmpty()) _notifications.erase(i);
-		}
-		showNextNotification();
-	}
+
+	auto failed = [weak = std::weak_ptr<Manager*>(_guarded), peerId, msgId] {
+		crl::on_main(weak, [=] {
+			(*weak.lock())->clearNotification(peerId, msgId);
+		});
+	};
+	_sender.with([=, failed = std::move(failed)](
+			NotificationSender &sender) mutable {
+		sender.show(notification, imagePath, std::move(failed));
+	});
+}
+
+void Manager::Private::closeNotification(const Notification &notification) {
+	_sender.with([=](NotificationSender &sender) {
+		sender.close(notification);
+	});
 }
 
 void Manager::Private::clearAll() {
@@ -478,7 +512,7 @@ void Manager::Private::clearAll() {
 	auto temp = base::take(_notifications);
 	for_const (auto &notifications, temp) {
 		for_const (auto notification, notifications) {
-			notification->close();
+			closeNotification(notification);
 		}
 	}
 }
@@ -498,7 +532,7 @@ void Manager::Private::clearFromHistory(History *history) {
 		_notifications.erase(i);
 
 		for_const (auto notification, temp) {
-			notification->close();
+			closeNotification(notification);
 		}
 	}
 
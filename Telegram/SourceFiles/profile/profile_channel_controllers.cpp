@@ -32,6 +32,11 @@ constexpr auto kParticipantsFirstPageCount = 16;
 constexpr auto kParticipantsPerPage = 200;
 constexpr auto kSortByOnlineDelay = TimeMs(1000);
 
+// Only a small part of a large channel members is loaded, so the local
+// results mean little there and the server is searched almost at once.
+constexpr auto kServerSearchFirstMembersCount = 1000;
+constexpr auto kServerSearchFirstDelay = TimeMs(200);
+
 void RemoveAdmin(
 		not_null<ChannelData*> channel,
 		not_null<UserData*> user,
@@ -1086,7 +1091,11 @@ void ParticipantsBoxSearchController::searchQuery(const QString &query) {
 		_requestId = 0;
 		_allLoaded = false;
 		if (!_query.isEmpty() && !searchInCache()) {
-			_timer.callOnce(AutoSearchTimeout);
+			const auto large = (_channel->membersCount()
+				>= kServerSearchFirstMembersCount);
+			_timer.callOnce(large
+				? kServerSearchFirstDelay
+				: TimeMs(AutoSearchTimeout));
 		} else {
 			_timer.cancel();
 		}
@@ -45,6 +45,9 @@ public:
 	Type *make_state(Args&& ...args);
 
 	void terminate();
+	bool terminated() const {
+		return _terminated;
+	}
 
 	virtual ~type_erased_handlers() = default;
 
@@ -293,6 +296,9 @@ public:
 	Type *make_state(Args&& ...args) const;
 
 	void terminate() const;
+	bool terminated() const {
+		return !_handlers || _handlers->terminated();
+	}
 	auto terminator() const {
 		return [self = *this] {
 			self.terminate();
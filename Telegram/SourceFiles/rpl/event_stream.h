@@ -43,14 +43,12 @@ public:
 				const auto &consumer) {
 			if (auto strong = weak.lock()) {
 				auto result = [weak, consumer] {
+					// Terminating the shared handlers is enough for the
+					// stream to skip them, no need to look them up here.
+					consumer.terminate();
 					if (auto strong = weak.lock()) {
-						auto it = std::find(
-							strong->consumers.begin(),
-							strong->consumers.end(),
-							consumer);
-						if (it != strong->consumers.end()) {
-							it->terminate();
-						}
+						++strong->terminated;
+						strong->compact();
 					}
 				};
 				strong->consumers.push_back(std::move(consumer));
@@ -73,7 +71,11 @@ public:
 
 private:
 	struct Data {
+		// Removes terminated consumers when they make up half of the list.
+		void compact();
+
 		std::vector<consumer<Value, no_error>> consumers;
+		int terminated = 0;
 		int depth = 0;
 	};
 	std::weak_ptr<Data> make_weak() const;
@@ -140,12 +142,38 @@ inline void event_stream<Value>::fire_forward(
 			// Erase stale consumers.
 			if (copy->depth == 1) {
 				consumers.erase(removeFrom.base(), consumers.end());
+				copy->terminated = 0;
 			}
 		}
 	}
 	--copy->depth;
 }
 
+template <typename Value>
+inline void event_stream<Value>::Data::compact() {
+	if (depth > 0 || terminated * 2 <= int(consumers.size())) {
+		return;
+	}
+	terminated = 0;
+
+	// Destroying handlers may end other subscriptions to this stream,
+	// so destroy the terminated consumers after the list is consistent.
+	auto removed = std::vector<consumer<Value, no_error>>();
+	auto from = consumers.begin();
+	auto till = consumers.end();
+	auto to = from;
+	for (; from != till; ++from) {
+		if (from->terminated()) {
+			removed.push_back(std::move(*from));
+		} else if (to != from) {
+			*to++ = std::move(*from);
+		} else {
+			++to;
+		}
+	}
+	consumers.erase(to, till);
+}
+
 template <typename Value>
 inline auto event_stream<Value>::make_weak() const
 -> std::weak_ptr<Data> {
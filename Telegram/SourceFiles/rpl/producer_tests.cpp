@@ -9,6 +9,7 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 
 #include <rpl/producer.h>
 #include <rpl/event_stream.h>
+#include "base/benchmark.h"
 
 using namespace rpl;
 
@@ -327,6 +328,65 @@ TEST_CASE("basic event_streams tests", "[rpl::event_stream]") {
 		}
 		REQUIRE(*sum == 1 + 2 + 3 + 4);
 	}
+
+	SECTION("event_stream releases unsubscribed handlers") {
+		auto stream = event_stream<int>();
+		auto captured = std::make_shared<int>(0);
+		auto alive = std::vector<lifetime>(10);
+		for (auto &consumer : alive) {
+			stream.events() | start_with_next([=](int value) {
+				*captured += value;
+			}, consumer);
+		}
+		alive.erase(begin(alive), begin(alive) + 9);
+		REQUIRE(captured.use_count() < 10);
+		stream.fire(1);
+		REQUIRE(*captured == 1);
+		REQUIRE(captured.use_count() == 2);
+	}
+}
+
+// Hidden, run by the tests_benchmarks target.
+TEST_CASE("event_stream benchmarks", "[.][benchmark]") {
+	using base::benchmark::measure;
+
+	SECTION("fire to many consumers") {
+		auto stream = event_stream<int>();
+		auto sum = 0;
+		auto alive = lifetime();
+		for (auto i = 0; i != 100; ++i) {
+			stream.events() | start_with_next([&](int value) {
+				sum += value;
+			}, alive);
+		}
+		measure("event_stream: 100K fires to 100 consumers", [&] {
+			for (auto i = 0; i != 100000; ++i) {
+				stream.fire_copy(1);
+			}
+		});
+		REQUIRE(sum == 100 * 100000);
+	}
+
+	SECTION("subscribe and unsubscribe many consumers") {
+		auto stream = event_stream<int>();
+		auto sum = 0;
+		auto alive = std::vector<lifetime>(10000);
+		measure("event_stream: 10 x 10K subscriptions", [&] {
+			for (auto j = 0; j != 10; ++j) {
+				for (auto &consumer : alive) {
+					stream.events() | start_with_next([&](int value) {
+						sum += value;
+					}, consumer);
+				}
+				for (auto &consumer : alive) {
+					consumer.destroy();
+				}
+			}
+		});
+		stream.fire(1);
+		REQUIRE(sum == 0);
+		REQUIRE(!stream.has_consumers());
+	}
 }
 
 TEST_CASE("basic piping tests", "[rpl::producer]") {
@@ -19,6 +19,7 @@ bool gTestMode = false;
 bool gManyInstance = false;
 QString gKeyFile;
 QString gWorkingDir, gExeDir, gExeName;
+QString gSharedCacheDir;
 
 QStringList gSendPaths;
 QString gStartUrl;
@@ -30,6 +31,7 @@ bool gStartInTray = false;
 bool gAutoStart = false;
 bool gSendToMenu = false;
 bool gUseExternalVideoPlayer = false;
+bool gHardwareVideoDecoding = false;
 bool gAutoUpdate = true;
 TWindowPos gWindowPos;
 LaunchMode gLaunchMode = LaunchModeNormal;
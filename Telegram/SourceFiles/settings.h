@@ -40,6 +40,7 @@ DeclareSetting(bool, StartMinimized);
 DeclareSetting(bool, StartInTray);
 DeclareSetting(bool, SendToMenu);
 DeclareSetting(bool, UseExternalVideoPlayer);
+DeclareSetting(bool, HardwareVideoDecoding);
 enum LaunchMode {
 	LaunchModeNormal = 0,
 	LaunchModeAutoStart,
@@ -57,6 +58,7 @@ inline void cForceWorkingDir(const QString &newDir) {
 	}
 
 }
+DeclareSetting(QString, SharedCacheDir);
 DeclareReadSetting(QString, ExeName);
 DeclareReadSetting(QString, ExeDir);
 DeclareSetting(QString, DialogLastPath);
@@ -10,6 +10,7 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 #include "platform/platform_specific.h"
 #include "ui/toast/toast.h"
 #include "mainwidget.h"
+#include "auth_session.h"
 #include "data/data_session.h"
 #include "storage/localstorage.h"
 #include "boxes/confirm_box.h"
@@ -17,7 +18,11 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 #include "messenger.h"
 #include "mtproto/mtp_instance.h"
 #include "mtproto/dc_options.h"
+#include "mtproto/request_tracer.h"
+#include "mtproto/traffic_capture.h"
 #include "core/file_utilities.h"
+#include "core/memory_stats.h"
+#include "core/traffic_replay.h"
 #include "core/update_checker.h"
 #include "window/themes/window_theme.h"
 #include "window/themes/window_theme_editor.h"
@@ -117,6 +122,40 @@ auto GenerateCodes() {
 		Platform::RegisterCustomScheme();
 		Ui::Toast::Show("Forced custom scheme register.");
 	});
+	codes.emplace(qsl("tracerequests"), [] {
+		if (!MTP::RequestTracingEnabled()) {
+			MTP::SetRequestTracingEnabled(true);
+			Ui::Toast::Show("Started requests tracing.");
+			return;
+		}
+		const auto path = cWorkingDir() + qsl("requests_trace.txt");
+		MTP::SetRequestTracingEnabled(false);
+		if (MTP::WriteRequestTracingReport(path)) {
+			File::ShowInFolder(path);
+		}
+	});
+	codes.emplace(qsl("capturetraffic"), [] {
+		const auto path = cWorkingDir() + qsl("traffic_capture.tdcap");
+		if (!MTP::TrafficCaptureStarted()) {
+			if (MTP::StartTrafficCapture(path)) {
+				Ui::Toast::Show("Started traffic capture.");
+			}
+			return;
+		}
+		MTP::StopTrafficCapture();
+		File::ShowInFolder(path);
+	});
+	codes.emplace(qsl("replaytraffic"), [] {
+		if (AuthSession::Exists()) {
+			const auto path = cWorkingDir() + qsl("traffic_capture.tdcap");
+			Ui::show(Box<InformBox>(Core::ReplayTrafficCapture(path)));
+		}
+	});
+	codes.emplace(qsl("memorystats"), [] {
+		if (AuthSession::Exists()) {
+			Ui::show(Box<InformBox>(Auth().memoryStats().text()));
+		}
+	});
 	codes.emplace(qsl("export"), [] {
 		Auth().data().startExport();
 	});
@@ -10,6 +10,7 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 #include "mainwindow.h"
 #include "mainwidget.h"
 #include "messenger.h"
+#include "core/paint_profiler.h"
 #include "media/player/media_player_instance.h"
 #include "platform/platform_specific.h"
 #include "base/parse_helper.h"
@@ -99,6 +100,14 @@ bool next_chat() {
 	return false;
 }
 
+bool paint_profiler() {
+	if (!Logs::DebugEnabled()) {
+		return false;
+	}
+	Core::PaintProfiler::Toggle();
+	return true;
+}
+
 // other commands here
 
 } // namespace ShortcutCommands
@@ -179,6 +188,8 @@ struct DataStruct {
 			DeclareAlias("ctrl+backtab", previous_chat);
 		}
 
+		DeclareCommand("ctrl+alt+shift+p", paint_profiler);
+
 		// other commands here
 
 #undef DeclareCommand
@@ -10,6 +10,13 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 namespace Storage {
 namespace Cache {
 namespace details {
+namespace {
+
+// The binlog is always replayed sequentially, so we start from small reads
+// and double the read size while whole blocks are read, up to the limit.
+constexpr auto kInitialReadBlockSize = size_type(64 * 1024);
+
+} // namespace
 
 BinlogWrapper::BinlogWrapper(
 	File &binlog,
@@ -18,7 +25,7 @@ BinlogWrapper::BinlogWrapper(
 : _binlog(binlog)
 , _settings(settings)
 , _till(till ? till : _binlog.size())
-, _data(_settings.readBlockSize)
+, _data(std::min(_settings.readBlockSize, kInitialReadBlockSize))
 , _full(_data) {
 }
 
@@ -65,6 +72,10 @@ bool BinlogWrapper::readPart() {
 		bytes::move(_full, _part);
 		_part = _full.subspan(0, _part.size());
 	}
+	if ((_grow || _part.size() == _full.size())
+		&& left > _full.size() - _part.size()) {
+		growBuffer();
+	}
 	const auto amount = std::min(
 		left,
 		int64(_full.size() - _part.size()));
@@ -74,10 +85,27 @@ bool BinlogWrapper::readPart() {
 	if (!readBytes) {
 		return no();
 	}
+	_grow = (readBytes == amount);
 	_part = _full.subspan(0, _part.size() + readBytes);
 	return true;
 }
 
+void BinlogWrapper::growBuffer() {
+	const auto size = std::min(
+		_full.size() * 2,
+		_settings.readBlockSize);
+	if (size == _full.size()) {
+		return;
+	}
+
+	// The unread part is always at the start of the buffer here.
+	Assert(_part.empty() || _part.data() == _full.data());
+	const auto part = _part.size();
+	_data.resize(size);
+	_full = _data;
+	_part = _full.subspan(0, part);
+}
+
 bytes::const_span BinlogWrapper::readRecord(ReadRecordSize readRecordSize) {
 	if (_finished) {
 		return {};
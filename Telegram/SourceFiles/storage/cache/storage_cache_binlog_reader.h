@@ -35,6 +35,7 @@ private:
 	friend class BinlogReader;
 
 	bool readPart();
+	void growBuffer();
 	void finish(size_type rollback = 0);
 
 	using ReadRecordSize = size_type (*)(
@@ -49,6 +50,7 @@ private:
 	bytes::vector _data;
 	bytes::span _full;
 	bytes::span _part;
+	bool _grow = false;
 	bool _finished = false;
 	bool _failed = false;
 
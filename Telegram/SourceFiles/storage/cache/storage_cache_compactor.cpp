@@ -9,6 +9,7 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 
 #include "storage/cache/storage_cache_database_object.h"
 #include "storage/cache/storage_cache_binlog_reader.h"
+#include "base/concurrent_timer.h"
 #include <unordered_set>
 
 namespace Storage {
@@ -41,6 +42,7 @@ private:
 	bool readHeader();
 	bool openCompact();
 	void parseChunk();
+	void scheduleChunk(bool pause);
 	void fail();
 	void done(int64 till);
 	void finish();
@@ -48,17 +50,17 @@ private:
 
 	std::vector<Key> readChunk();
 	bool readBlock(std::vector<Key> &result);
-	void processValues(const std::vector<Raw> &values);
+	void processValues(const std::vector<Raw> &values, bool pause);
 
+	template <typename Method>
+	decltype(auto) withListType(Method &&method);
 	template <typename MultiRecord>
 	void initList();
 	RawSpan fillList(RawSpan values);
-	template <typename RecordStore>
-	RawSpan fillList(std::vector<RecordStore> &list, RawSpan values);
-	template <typename RecordStore>
-	void addListRecord(
-		std::vector<RecordStore> &list,
-		const Raw &raw);
+	template <typename MultiRecord>
+	RawSpan fillList(RawSpan values);
+	template <typename MultiRecord>
+	void addListRecord(const Raw &raw);
 	bool writeList();
 	template <typename MultiRecord>
 	bool writeMultiStore();
@@ -76,9 +78,14 @@ private:
 	BinlogWrapper _wrapper;
 	size_type _partSize = 0;
 	std::unordered_set<Key> _written;
-	base::variant<
-		std::vector<MultiStore::Part>,
-		std::vector<MultiStoreWithTime::Part>> _list;
+	base::ConcurrentTimer _nextChunkTimer;
+	crl::time_type _chunkStarted = 0;
+	int64 _chunkFrom = 0;
+
+	// MultiStore header followed by up to _partSize parts, written to
+	// the compact binlog and encrypted in place without extra copies.
+	bytes::vector _list;
+	size_type _listSize = 0;
 
 };
 
@@ -98,30 +105,38 @@ CompactorObject::CompactorObject(
 , _key(std::move(key))
 , _info(info)
 , _wrapper(_binlog, _settings, _info.till)
-, _partSize(_settings.maxBundledRecords) { // Perhaps a better estimate?
+, _partSize(_settings.maxBundledRecords) // Perhaps a better estimate?
+, _nextChunkTimer(_weak, [=] { parseChunk(); }) {
 	Expects(_settings.compactChunkSize > 0);
 
 	_written.reserve(_info.keysCount);
 	start();
 }
 
+template <typename Method>
+decltype(auto) CompactorObject::withListType(Method &&method) {
+	return _settings.trackEstimatedTime
+		? method(MultiStoreWithTime())
+		: method(MultiStore());
+}
+
 template <typename MultiRecord>
 void CompactorObject::initList() {
 	using Part = typename MultiRecord::Part;
-	auto list = std::vector<Part>();
-	list.reserve(_partSize);
-	_list = std::move(list);
+	static_assert(GoodForEncryption<MultiRecord>);
+	static_assert(GoodForEncryption<Part>);
+
+	_list = bytes::vector(sizeof(MultiRecord) + _partSize * sizeof(Part));
+	_listSize = 0;
 }
 
 void CompactorObject::start() {
 	if (!openBinlog() || !readHeader() || !openCompact()) {
 		fail();
 	}
-	if (_settings.trackEstimatedTime) {
-		initList<MultiStoreWithTime>();
-	} else {
-		initList<MultiStore>();
-	}
+	withListType([&](auto record) {
+		initList<decltype(record)>();
+	});
 	parseChunk();
 }
 
@@ -216,28 +231,23 @@ void CompactorObject::finalize() {
 }
 
 bool CompactorObject::writeList() {
-	if (_list.is<std::vector<MultiStore::Part>>()) {
-		return writeMultiStore<MultiStore>();
-	} else if (_list.is<std::vector<MultiStoreWithTime::Part>>()) {
-		return writeMultiStore<MultiStoreWithTime>();
-	} else {
-		Unexpected("List type in CompactorObject::writeList.");
-	}
+	return withListType([&](auto record) {
+		return writeMultiStore<decltype(record)>();
+	});
 }
 
 template <typename MultiRecord>
 bool CompactorObject::writeMultiStore() {
 	using Part = typename MultiRecord::Part;
-	Assert(_list.is<std::vector<Part>>());
-	auto &list = _list.get_unchecked<std::vector<Part>>();
-	if (list.empty()) {
+	if (!_listSize) {
 		return true;
 	}
-	const auto guard = gsl::finally([&] { list.clear(); });
-	const auto size = list.size();
-	auto header = MultiRecord(size);
-	if (_compact.write(bytes::object_as_span(&header))
-		&& _compact.write(bytes::make_span(list))) {
+	const auto size = base::take(_listSize);
+	new (_list.data()) MultiRecord(size);
+	const auto data = bytes::make_span(_list).subspan(
+		0,
+		sizeof(MultiRecord) + size * sizeof(Part));
+	if (_compact.write(data)) {
 		_compact.flush();
 		return true;
 	}
@@ -297,6 +307,8 @@ bool CompactorObject::readBlock(std::vector<Key> &result) {
 }
 
 void CompactorObject::parseChunk() {
+	_chunkStarted = crl::time();
+	_chunkFrom = _binlog.offset();
 	auto keys = readChunk();
 	if (_wrapper.failed()) {
 		fail();
@@ -307,17 +319,24 @@ void CompactorObject::parseChunk() {
 	}
 	_database.with([
 		weak = _weak,
-		keys = std::move(keys)
+		keys = std::move(keys),
+		processed = _binlog.offset()
 	](DatabaseObject &database) {
+		database.compactorProgress(processed);
 		auto result = database.getManyRaw(keys);
-		weak.with([result = std::move(result)](CompactorObject &that) {
-			that.processValues(result);
+		const auto pause = database.compactorShouldPause();
+		weak.with([
+			result = std::move(result),
+			pause
+		](CompactorObject &that) {
+			that.processValues(result, pause);
 		});
 	});
 }
 
 void CompactorObject::processValues(
-		const std::vector<std::pair<Key, Entry>> &values) {
+		const std::vector<std::pair<Key, Entry>> &values,
+		bool pause) {
 	auto left = gsl::make_span(values);
 	while (true) {
 		left = fillList(left);
@@ -328,37 +347,52 @@ void CompactorObject::processValues(
 			return;
 		}
 	}
-	parseChunk();
+	scheduleChunk(pause);
+}
+
+void CompactorObject::scheduleChunk(bool pause) {
+	auto delay = pause ? _settings.compactPauseDelay : crl::time_type(0);
+	if (_settings.compactBytesPerSecond > 0) {
+		const auto read = _binlog.offset() - _chunkFrom;
+		const auto allowed = read * crl::time_type(1000)
+			/ _settings.compactBytesPerSecond;
+		const auto passed = crl::time() - _chunkStarted;
+		delay = std::max(delay, allowed - passed);
+	}
+	if (delay > 0) {
+		_nextChunkTimer.callOnce(delay);
+	} else {
+		parseChunk();
+	}
 }
 
 auto CompactorObject::fillList(RawSpan values) -> RawSpan {
-	return _list.match([&](auto &list) {
-		return fillList(list, values);
+	return withListType([&](auto record) {
+		return fillList<decltype(record)>(values);
 	});
 }
 
-template <typename RecordStore>
-auto CompactorObject::fillList(
-	std::vector<RecordStore> &list,
-	RawSpan values
-) -> RawSpan {
+template <typename MultiRecord>
+auto CompactorObject::fillList(RawSpan values) -> RawSpan {
 	const auto b = std::begin(values);
 	const auto e = std::end(values);
 	auto i = b;
-	while (i != e && list.size() != _partSize) {
-		addListRecord(list, *i++);
+	while (i != e && _listSize != _partSize) {
+		addListRecord<MultiRecord>(*i++);
 	}
 	return values.subspan(i - b);
 }
 
-template <typename RecordStore>
-void CompactorObject::addListRecord(
-		std::vector<RecordStore> &list,
-		const Raw &raw) {
+template <typename MultiRecord>
+void CompactorObject::addListRecord(const Raw &raw) {
+	using RecordStore = typename MultiRecord::Part;
 	if (!_written.emplace(raw.first).second) {
 		return;
 	}
-	auto record = RecordStore();
+	const auto place = _list.data()
+		+ sizeof(MultiRecord)
+		+ (_listSize++) * sizeof(RecordStore);
+	auto &record = *new (place) RecordStore();
 	record.key = raw.first;
 	record.setSize(raw.second.size);
 	record.checksum = raw.second.checksum;
@@ -368,7 +402,6 @@ void CompactorObject::addListRecord(
 		record.time.setRelative(raw.second.useTime);
 		record.time.system = _info.systemTime;
 	}
-	list.push_back(record);
 }
 
 Compactor::Compactor(
@@ -8,71 +8,494 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 #include "storage/cache/storage_cache_database.h"
 
 #include "storage/cache/storage_cache_database_object.h"
+#include <rpl/combine.h>
+#include <deque>
+#include <mutex>
 
 namespace Storage {
 namespace Cache {
+namespace details {
+
+class RequestLanes {
+public:
+	using Task = FnMut<void(DatabaseObject&)>;
+
+	void push(Priority priority, Task &&task);
+
+	// Requests pushed till now have ids not greater than the result.
+	uint64 lastId() const;
+
+	void serveOne(DatabaseObject &object);
+	void serveTill(uint64 id, DatabaseObject &object);
+
+	std::array<LaneMetrics, kPrioritiesCount> metrics() const;
+
+private:
+	struct Request {
+		uint64 id = 0;
+		Task task;
+	};
+	struct Lane {
+		std::deque<Request> requests;
+		size_type skipped = 0;
+		LaneMetrics metrics;
+	};
+
+	Task takeOne();
+	Task takeTill(uint64 id);
+	Task take(Lane &lane);
+
+	// Each time a lower lane is skipped for a higher one it is counted,
+	// after kStarvationLimit skips the lower lane is served out of turn.
+	static constexpr auto kStarvationLimit = size_type(16);
+
+	mutable std::mutex _mutex;
+	std::array<Lane, kPrioritiesCount> _lanes;
+	uint64 _lastId = 0;
+
+};
+
+void RequestLanes::push(Priority priority, Task &&task) {
+	std::lock_guard<std::mutex> lock(_mutex);
+	auto &lane = _lanes[static_cast<int>(priority)];
+	lane.requests.push_back({ ++_lastId, std::move(task) });
+	lane.metrics.depth = lane.requests.size();
+	accumulate_max(lane.metrics.peakDepth, lane.metrics.depth);
+}
+
+uint64 RequestLanes::lastId() const {
+	std::lock_guard<std::mutex> lock(_mutex);
+	return _lastId;
+}
+
+void RequestLanes::serveOne(DatabaseObject &object) {
+	if (auto task = takeOne()) {
+		task(object);
+	}
+}
+
+void RequestLanes::serveTill(uint64 id, DatabaseObject &object) {
+	while (auto task = takeTill(id)) {
+		task(object);
+	}
+}
+
+auto RequestLanes::metrics() const
+-> std::array<LaneMetrics, kPrioritiesCount> {
+	std::lock_guard<std::mutex> lock(_mutex);
+	auto result = std::array<LaneMetrics, kPrioritiesCount>();
+	for (auto i = 0; i != kPrioritiesCount; ++i) {
+		result[i] = _lanes[i].metrics;
+	}
+	return result;
+}
+
+auto RequestLanes::takeOne() -> Task {
+	std::lock_guard<std::mutex> lock(_mutex);
+	auto chosen = -1;
+	auto promoted = false;
+	for (auto i = 0; i != kPrioritiesCount; ++i) {
+		if (_lanes[i].requests.empty()) {
+			continue;
+		} else if (chosen < 0) {
+			chosen = i;
+		} else if (_lanes[i].skipped >= kStarvationLimit) {
+			chosen = i;
+			promoted = true;
+			break;
+		}
+	}
+	if (chosen < 0) {
+		// All the requests were served by the requests waiting for them.
+		return nullptr;
+	}
+	for (auto i = chosen + 1; i != kPrioritiesCount; ++i) {
+		if (!_lanes[i].requests.empty()) {
+			++_lanes[i].skipped;
+		}
+	}
+	auto &lane = _lanes[chosen];
+	lane.skipped = 0;
+	if (promoted) {
+		++lane.metrics.promoted;
+	}
+	return take(lane);
+}
+
+auto RequestLanes::takeTill(uint64 id) -> Task {
+	std::lock_guard<std::mutex> lock(_mutex);
+	Lane *chosen = nullptr;
+	for (auto &lane : _lanes) {
+		if (lane.requests.empty() || lane.requests.front().id > id) {
+			continue;
+		} else if (!chosen
+			|| lane.requests.front().id < chosen->requests.front().id) {
+			chosen = &lane;
+		}
+	}
+	if (!chosen) {
+		return nullptr;
+	}
+	return take(*chosen);
+}
+
+auto RequestLanes::take(Lane &lane) -> Task {
+	auto result = std::move(lane.requests.front().task);
+	lane.requests.pop_front();
+	if (lane.requests.empty()) {
+		lane.skipped = 0;
+	}
+	lane.metrics.depth = lane.requests.size();
+	++lane.metrics.served;
+	return result;
+}
+
+} // namespace details
+
+namespace {
+
+QString ComputeShardPath(const QString &path, size_type index) {
+	if (!index) {
+		return path;
+	}
+	auto result = path;
+	while (result.endsWith('/')) {
+		result.chop(1);
+	}
+	return result + QStringLiteral("_shard") + QString::number(index);
+}
+
+int64 ComputeShardSizeLimit(const Database::Settings &settings) {
+	if (!settings.totalSizeLimit) {
+		return 0;
+	}
+	return std::max(
+		settings.totalSizeLimit / settings.shardsCount,
+		int64(settings.maxDataSize) + 1);
+}
+
+base::flat_map<uint8, int64> ComputeShardTagSizeLimits(
+		const base::flat_map<uint8, int64> &limits,
+		size_type shardsCount) {
+	auto result = limits;
+	for (auto &[tag, limit] : result) {
+		limit = std::max(limit / shardsCount, int64(1));
+	}
+	return result;
+}
+
+Database::Settings ComputeShardSettings(const Database::Settings &settings) {
+	auto result = settings;
+	result.totalSizeLimit = ComputeShardSizeLimit(settings);
+	result.tagSizeLimits = ComputeShardTagSizeLimits(
+		settings.tagSizeLimits,
+		settings.shardsCount);
+	return result;
+}
+
+void MergeMetrics(details::Metrics &to, const details::Metrics &from) {
+	to.hits += from.hits;
+	to.misses += from.misses;
+	for (const auto &[tag, hits] : from.taggedHits) {
+		to.taggedHits[tag] += hits;
+	}
+	to.getLatency.merge(from.getLatency);
+	to.putLatency.merge(from.putLatency);
+	to.binlogBytesWritten += from.binlogBytesWritten;
+	to.dataBytesWritten += from.dataBytesWritten;
+	to.compactionsCount += from.compactionsCount;
+	to.compactionsDuration += from.compactionsDuration;
+	to.prunesCount += from.prunesCount;
+	to.prunedEntries += from.prunedEntries;
+	to.prunesDuration += from.prunesDuration;
+	for (auto i = 0; i != kPrioritiesCount; ++i) {
+		auto &lane = to.lanes[i];
+		lane.depth += from.lanes[i].depth;
+		lane.peakDepth += from.lanes[i].peakDepth;
+		lane.served += from.lanes[i].served;
+		lane.promoted += from.lanes[i].promoted;
+	}
+}
+
+Database::Stats MergeStats(const std::vector<Database::Stats> &list) {
+	auto result = Database::Stats();
+	for (const auto &stats : list) {
+		result.full.count += stats.full.count;
+		result.full.totalSize += stats.full.totalSize;
+		for (const auto &[tag, summary] : stats.tagged) {
+			auto &merged = result.tagged[tag];
+			merged.count += summary.count;
+			merged.totalSize += summary.totalSize;
+		}
+		result.clearing = result.clearing || stats.clearing;
+		result.clearProcessed += stats.clearProcessed;
+		result.clearTotal += stats.clearTotal;
+		result.compacting = result.compacting || stats.compacting;
+		result.compactProcessed += stats.compactProcessed;
+		result.compactTotal += stats.compactTotal;
+		MergeMetrics(result.metrics, stats.metrics);
+	}
+	return result;
+}
+
+class ErrorJoiner {
+public:
+	ErrorJoiner(size_type count, FnMut<void(Error)> &&done);
+
+	void call(Error error);
+
+private:
+	std::mutex _mutex;
+	size_type _left = 0;
+	Error _error;
+	FnMut<void(Error)> _done;
+
+};
+
+ErrorJoiner::ErrorJoiner(size_type count, FnMut<void(Error)> &&done)
+: _left(count)
+, _done(std::move(done)) {
+	Expects(_left > 0);
+}
+
+void ErrorJoiner::call(Error error) {
+	auto done = FnMut<void(Error)>();
+	auto result = Error();
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		if (_error.type == Error::Type::None) {
+			_error = error;
+		}
+		if (--_left > 0) {
+			return;
+		}
+		done = std::move(_done);
+		result = _error;
+	}
+	if (done) {
+		done(result);
+	}
+}
+
+class ValuesJoiner {
+public:
+	using TaggedValue = Database::TaggedValue;
+	ValuesJoiner(
+		size_type count,
+		size_type parts,
+		FnMut<void(std::vector<TaggedValue>&&)> &&done);
+
+	void call(
+		const std::vector<size_type> &indices,
+		std::vector<TaggedValue> &&values);
+
+private:
+	std::mutex _mutex;
+	size_type _left = 0;
+	std::vector<TaggedValue> _values;
+	FnMut<void(std::vector<TaggedValue>&&)> _done;
+
+};
+
+ValuesJoiner::ValuesJoiner(
+	size_type count,
+	size_type parts,
+	FnMut<void(std::vector<TaggedValue>&&)> &&done)
+: _left(parts)
+, _values(count)
+, _done(std::move(done)) {
+	Expects(_left > 0);
+}
+
+void ValuesJoiner::call(
+		const std::vector<size_type> &indices,
+		std::vector<TaggedValue> &&values) {
+	Expects(indices.size() == values.size());
+
+	auto done = FnMut<void(std::vector<TaggedValue>&&)>();
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		for (auto i = 0, count = int(indices.size()); i != count; ++i) {
+			_values[indices[i]] = std::move(values[i]);
+		}
+		if (--_left > 0) {
+			return;
+		}
+		done = std::move(_done);
+	}
+	if (done) {
+		done(std::move(_values));
+	}
+}
+
+FnMut<void(Error)> WrapDone(FnMut<void()> &&done) {
+	if (!done) {
+		return nullptr;
+	}
+	return [done = std::move(done)](Error) mutable {
+		done();
+	};
+}
+
+} // namespace
 
 Database::Database(const QString &path, const Settings &settings)
-: _wrapped(path, settings) {
+: _settings(settings) {
+	Expects(_settings.shardsCount > 0);
+
+	const auto shardSettings = ComputeShardSettings(_settings);
+	_shards.reserve(_settings.shardsCount);
+	_lanes.reserve(_settings.shardsCount);
+	for (auto i = size_type(0); i != _settings.shardsCount; ++i) {
+		_shards.push_back(std::make_shared<Wrapped>(
+			ComputeShardPath(path, i),
+			shardSettings));
+		_lanes.push_back(std::make_shared<Lanes>());
+	}
+}
+
+size_type Database::shardIndex(const Key &key) const {
+	if (_shards.size() == 1) {
+		return 0;
+	}
+	const auto mixed = (key.high ^ key.low) * 0x9E3779B97F4A7C15ULL;
+	return (mixed >> 32) % _shards.size();
+}
+
+template <typename Method>
+void Database::invoke(size_type index, Method &&method) {
+	const auto &lanes = _lanes[index];
+	_shards[index]->with([
+		lanes,
+		id = lanes->lastId(),
+		method = std::forward<Method>(method)
+	](Implementation &unwrapped) mutable {
+		lanes->serveTill(id, unwrapped);
+		method(unwrapped);
+	});
+}
+
+template <typename Method>
+void Database::enqueue(size_type index, Priority priority, Method &&method) {
+	const auto &lanes = _lanes[index];
+	lanes->push(priority, std::forward<Method>(method));
+	_shards[index]->with([lanes](Implementation &unwrapped) {
+		lanes->serveOne(unwrapped);
+	});
+}
+
+template <typename Method>
+void Database::invokeEach(FnMut<void(Error)> &&done, Method &&method) {
+	if (_shards.size() == 1) {
+		invoke(0, [
+			done = std::move(done),
+			method = std::forward<Method>(method)
+		](Implementation &unwrapped) mutable {
+			method(unwrapped, std::move(done));
+		});
+		return;
+	}
+	const auto joiner = done
+		? std::make_shared<ErrorJoiner>(_shards.size(), std::move(done))
+		: nullptr;
+	for (auto i = size_type(0); i != size_type(_shards.size()); ++i) {
+		invoke(i, [=](Implementation &unwrapped) mutable {
+			auto done = joiner
+				? FnMut<void(Error)>([=](Error error) {
+					joiner->call(error);
+				})
+				: FnMut<void(Error)>();
+			method(unwrapped, std::move(done));
+		});
+	}
 }
 
 void Database::reconfigure(const Settings &settings) {
-	_wrapped.with([settings](Implementation &unwrapped) mutable {
-		unwrapped.reconfigure(settings);
+	Expects(settings.shardsCount == size_type(_shards.size()));
+
+	_settings = settings;
+	const auto shardSettings = ComputeShardSettings(_settings);
+	invokeEach(nullptr, [=](Implementation &unwrapped, auto&&) {
+		unwrapped.reconfigure(shardSettings);
 	});
 }
 
 void Database::updateSettings(const SettingsUpdate &update) {
-	_wrapped.with([update](Implementation &unwrapped) mutable {
-		unwrapped.updateSettings(update);
+	_settings.totalSizeLimit = update.totalSizeLimit;
+	_settings.totalTimeLimit = update.totalTimeLimit;
+	_settings.tagSizeLimits = update.tagSizeLimits;
+
+	auto shardUpdate = update;
+	shardUpdate.totalSizeLimit = ComputeShardSizeLimit(_settings);
+	shardUpdate.tagSizeLimits = ComputeShardTagSizeLimits(
+		_settings.tagSizeLimits,
+		_settings.shardsCount);
+	invokeEach(nullptr, [=](Implementation &unwrapped, auto&&) {
+		unwrapped.updateSettings(shardUpdate);
 	});
 }
 
 void Database::open(EncryptionKey &&key, FnMut<void(Error)> &&done) {
-	_wrapped.with([
-		key = std::move(key),
-		done = std::move(done)
-	](Implementation &unwrapped) mutable {
-		unwrapped.open(std::move(key), std::move(done));
+	const auto shared = std::make_shared<EncryptionKey>(std::move(key));
+	invokeEach(std::move(done), [=](
+			Implementation &unwrapped,
+			FnMut<void(Error)> &&done) {
+		unwrapped.open(base::duplicate(*shared), std::move(done));
 	});
 }
 
 void Database::close(FnMut<void()> &&done) {
-	_wrapped.with([
-		done = std::move(done)
-	](Implementation &unwrapped) mutable {
-		unwrapped.close(std::move(done));
+	invokeEach(WrapDone(std::move(done)), [](
+			Implementation &unwrapped,
+			FnMut<void(Error)> &&done) {
+		unwrapped.close([done = std::move(done)]() mutable {
+			if (done) {
+				done(Error::NoError());
+			}
+		});
 	});
 }
 
 void Database::waitForCleaner(FnMut<void()> &&done) {
-	_wrapped.with([
-		done = std::move(done)
-	](Implementation &unwrapped) mutable {
-		unwrapped.waitForCleaner(std::move(done));
+	invokeEach(WrapDone(std::move(done)), [](
+			Implementation &unwrapped,
+			FnMut<void(Error)> &&done) {
+		unwrapped.waitForCleaner([done = std::move(done)]() mutable {
+			if (done) {
+				done(Error::NoError());
+			}
+		});
 	});
 }
 
 void Database::put(
 		const Key &key,
 		QByteArray &&value,
-		FnMut<void(Error)> &&done) {
-	return put(key, TaggedValue(std::move(value), 0), std::move(done));
+		FnMut<void(Error)> &&done,
+		Priority priority) {
+	return put(
+		key,
+		TaggedValue(std::move(value), 0),
+		std::move(done),
+		priority);
 }
 
-void Database::get(const Key &key, FnMut<void(QByteArray&&)> &&done) {
+void Database::get(
+		const Key &key,
+		FnMut<void(QByteArray&&)> &&done,
+		Priority priority) {
 	if (done) {
 		auto untag = [done = std::move(done)](TaggedValue &&value) mutable {
 			done(std::move(value.bytes));
 		};
-		getWithTag(key, std::move(untag));
+		getWithTag(key, std::move(untag), priority);
 	} else {
-		getWithTag(key, nullptr);
+		getWithTag(key, nullptr, priority);
 	}
 }
 
 void Database::remove(const Key &key, FnMut<void(Error)> &&done) {
-	_wrapped.with([
+	invoke(shardIndex(key), [
 		key,
 		done = std::move(done)
 	](Implementation &unwrapped) mutable {
@@ -83,23 +506,46 @@ void Database::remove(const Key &key, FnMut<void(Error)> &&done) {
 void Database::putIfEmpty(
 		const Key &key,
 		QByteArray &&value,
-		FnMut<void(Error)> &&done) {
+		FnMut<void(Error)> &&done,
+		Priority priority) {
 	return putIfEmpty(
 		key,
 		TaggedValue(std::move(value), 0),
-		std::move(done));
+		std::move(done),
+		priority);
 }
 
 void Database::copyIfEmpty(
 		const Key &from,
 		const Key &to,
 		FnMut<void(Error)> &&done) {
-	_wrapped.with([
+	const auto source = shardIndex(from);
+	const auto target = shardIndex(to);
+	if (source == target) {
+		invoke(source, [
+			from,
+			to,
+			done = std::move(done)
+		](Implementation &unwrapped) mutable {
+			unwrapped.copyIfEmpty(from, to, std::move(done));
+		});
+		return;
+	}
+	invoke(source, [
 		from,
 		to,
+		weak = std::weak_ptr<Wrapped>(_shards[target]),
+		lanes = _lanes[target],
 		done = std::move(done)
 	](Implementation &unwrapped) mutable {
-		unwrapped.copyIfEmpty(from, to, std::move(done));
+		unwrapped.get(from, [&](TaggedValue &&value) {
+			PutToShard(
+				weak,
+				lanes,
+				to,
+				std::move(value),
+				std::move(done));
+		});
 	});
 }
 
@@ -107,20 +553,71 @@ void Database::moveIfEmpty(
 		const Key &from,
 		const Key &to,
 		FnMut<void(Error)> &&done) {
-	_wrapped.with([
+	const auto source = shardIndex(from);
+	const auto target = shardIndex(to);
+	if (source == target) {
+		invoke(source, [
+			from,
+			to,
+			done = std::move(done)
+		](Implementation &unwrapped) mutable {
+			unwrapped.moveIfEmpty(from, to, std::move(done));
+		});
+		return;
+	}
+
+	// Unlike the single shard case the source is removed even if
+	// the target already has a value, it is never needed afterwards.
+	invoke(source, [
 		from,
 		to,
+		weak = std::weak_ptr<Wrapped>(_shards[target]),
+		lanes = _lanes[target],
 		done = std::move(done)
 	](Implementation &unwrapped) mutable {
-		unwrapped.moveIfEmpty(from, to, std::move(done));
+		unwrapped.get(from, [&](TaggedValue &&value) {
+			unwrapped.remove(from, nullptr);
+			PutToShard(
+				weak,
+				lanes,
+				to,
+				std::move(value),
+				std::move(done));
+		});
 	});
 }
 
-void Database::put(
+void Database::PutToShard(
+		const std::weak_ptr<Wrapped> &weak,
+		const std::shared_ptr<Lanes> &lanes,
 		const Key &key,
 		TaggedValue &&value,
 		FnMut<void(Error)> &&done) {
-	_wrapped.with([
+	const auto strong = weak.lock();
+	if (!strong || value.bytes.isEmpty()) {
+		if (done) {
+			done(Error::NoError());
+		}
+		return;
+	}
+	strong->with([
+		lanes,
+		id = lanes->lastId(),
+		key,
+		value = std::move(value),
+		done = std::move(done)
+	](Implementation &unwrapped) mutable {
+		lanes->serveTill(id, unwrapped);
+		unwrapped.putIfEmpty(key, std::move(value), std::move(done));
+	});
+}
+
+void Database::put(
+		const Key &key,
+		TaggedValue &&value,
+		FnMut<void(Error)> &&done,
+		Priority priority) {
+	enqueue(shardIndex(key), priority, [
 		key,
 		value = std::move(value),
 		done = std::move(done)
@@ -132,8 +629,9 @@ void Database::put(
 void Database::putIfEmpty(
 		const Key &key,
 		TaggedValue &&value,
-		FnMut<void(Error)> &&done) {
-	_wrapped.with([
+		FnMut<void(Error)> &&done,
+		Priority priority) {
+	enqueue(shardIndex(key), priority, [
 		key,
 		value = std::move(value),
 		done = std::move(done)
@@ -144,8 +642,9 @@ void Database::putIfEmpty(
 
 void Database::getWithTag(
 		const Key &key,
-		FnMut<void(TaggedValue&&)> &&done) {
-	_wrapped.with([
+		FnMut<void(TaggedValue&&)> &&done,
+		Priority priority) {
+	enqueue(shardIndex(key), priority, [
 		key,
 		done = std::move(done)
 	](Implementation &unwrapped) mutable {
@@ -153,25 +652,81 @@ void Database::getWithTag(
 	});
 }
 
+void Database::getMany(
+		std::vector<Key> &&keys,
+		FnMut<void(std::vector<TaggedValue>&&)> &&done,
+		Priority priority) {
+	if (_shards.size() == 1) {
+		enqueue(0, priority, [
+			keys = std::move(keys),
+			done = std::move(done)
+		](Implementation &unwrapped) mutable {
+			unwrapped.getMany(keys, std::move(done));
+		});
+		return;
+	}
+	auto parts = base::flat_map<
+		size_type,
+		std::pair<std::vector<Key>, std::vector<size_type>>>();
+	for (auto i = size_type(0); i != size_type(keys.size()); ++i) {
+		auto &part = parts[shardIndex(keys[i])];
+		part.first.push_back(keys[i]);
+		part.second.push_back(i);
+	}
+	if (parts.empty()) {
+		if (done) {
+			done({});
+		}
+		return;
+	}
+	const auto joiner = std::make_shared<ValuesJoiner>(
+		keys.size(),
+		parts.size(),
+		std::move(done));
+	for (auto &[index, part] : parts) {
+		enqueue(index, priority, [
+			joiner,
+			keys = std::move(part.first),
+			indices = std::move(part.second)
+		](Implementation &unwrapped) mutable {
+			unwrapped.getMany(keys, [&](std::vector<TaggedValue> &&values) {
+				joiner->call(indices, std::move(values));
+			});
+		});
+	}
+}
+
 auto Database::statsOnMain() const -> rpl::producer<Stats> {
-	return _wrapped.producer_on_main([](const Implementation &unwrapped) {
-		return unwrapped.stats();
-	});
+	const auto generator = [&](size_type index) {
+		return [lanes = _lanes[index]](const Implementation &unwrapped) {
+			auto result = unwrapped.stats();
+			result.metrics.lanes = lanes->metrics();
+			return result;
+		};
+	};
+	if (_shards.size() == 1) {
+		return _shards.front()->producer_on_main(generator(0));
+	}
+	auto list = std::vector<rpl::producer<Stats>>();
+	list.reserve(_shards.size());
+	for (auto i = size_type(0); i != size_type(_shards.size()); ++i) {
+		list.push_back(_shards[i]->producer_on_main(generator(i)));
+	}
+	return rpl::combine(std::move(list), MergeStats);
 }
 
 void Database::clear(FnMut<void(Error)> &&done) {
-	_wrapped.with([
-		done = std::move(done)
-	](Implementation &unwrapped) mutable {
+	invokeEach(std::move(done), [](
+			Implementation &unwrapped,
+			FnMut<void(Error)> &&done) {
 		unwrapped.clear(std::move(done));
 	});
 }
 
 void Database::clearByTag(uint8 tag, FnMut<void(Error)> &&done) {
-	_wrapped.with([
-		tag,
-		done = std::move(done)
-	](Implementation &unwrapped) mutable {
+	invokeEach(std::move(done), [=](
+			Implementation &unwrapped,
+			FnMut<void(Error)> &&done) {
 		unwrapped.clearByTag(tag, std::move(done));
 	});
 }
@@ -13,18 +13,26 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 #include <crl/crl_time.h>
 #include <rpl/producer.h>
 #include <QtCore/QString>
+#include <memory>
+#include <vector>
 
 namespace Storage {
 class EncryptionKey;
 namespace Cache {
 namespace details {
 class DatabaseObject;
+class RequestLanes;
 } // namespace details
 
+// Reads and writes are served by priority lanes. A request may overtake
+// the requests of the lower lanes made before it, so a get() may not see
+// a put() of the same key from a lower lane. All the other requests wait
+// for the lane requests made before them.
 class Database {
 public:
 	using Settings = details::Settings;
 	using SettingsUpdate = details::SettingsUpdate;
+	using EvictionPolicy = details::EvictionPolicy;
 	Database(const QString &path, const Settings &settings);
 
 	void reconfigure(const Settings &settings);
@@ -36,14 +44,19 @@ public:
 	void put(
 		const Key &key,
 		QByteArray &&value,
-		FnMut<void(Error)> &&done = nullptr);
-	void get(const Key &key, FnMut<void(QByteArray&&)> &&done);
+		FnMut<void(Error)> &&done = nullptr,
+		Priority priority = Priority::Interactive);
+	void get(
+		const Key &key,
+		FnMut<void(QByteArray&&)> &&done,
+		Priority priority = Priority::Interactive);
 	void remove(const Key &key, FnMut<void(Error)> &&done = nullptr);
 
 	void putIfEmpty(
 		const Key &key,
 		QByteArray &&value,
-		FnMut<void(Error)> &&done = nullptr);
+		FnMut<void(Error)> &&done = nullptr,
+		Priority priority = Priority::Interactive);
 	void copyIfEmpty(
 		const Key &from,
 		const Key &to,
@@ -57,15 +70,27 @@ public:
 	void put(
 		const Key &key,
 		TaggedValue &&value,
-		FnMut<void(Error)> &&done = nullptr);
+		FnMut<void(Error)> &&done = nullptr,
+		Priority priority = Priority::Interactive);
 	void putIfEmpty(
 		const Key &key,
 		TaggedValue &&value,
-		FnMut<void(Error)> &&done = nullptr);
-	void getWithTag(const Key &key, FnMut<void(TaggedValue&&)> &&done);
+		FnMut<void(Error)> &&done = nullptr,
+		Priority priority = Priority::Interactive);
+	void getWithTag(
+		const Key &key,
+		FnMut<void(TaggedValue&&)> &&done,
+		Priority priority = Priority::Interactive);
+
+	// Reads all the values in one hop, result is ordered as the keys.
+	void getMany(
+		std::vector<Key> &&keys,
+		FnMut<void(std::vector<TaggedValue>&&)> &&done,
+		Priority priority = Priority::Interactive);
 
 	using Stats = details::Stats;
 	using TaggedSummary = details::TaggedSummary;
+	using Metrics = details::Metrics;
 	rpl::producer<Stats> statsOnMain() const;
 
 	void clear(FnMut<void(Error)> &&done = nullptr);
@@ -76,7 +101,26 @@ public:
 
 private:
 	using Implementation = details::DatabaseObject;
-	crl::object_on_queue<Implementation> _wrapped;
+	using Wrapped = crl::object_on_queue<Implementation>;
+	using Lanes = details::RequestLanes;
+
+	size_type shardIndex(const Key &key) const;
+	template <typename Method>
+	void invoke(size_type index, Method &&method);
+	template <typename Method>
+	void enqueue(size_type index, Priority priority, Method &&method);
+	template <typename Method>
+	void invokeEach(FnMut<void(Error)> &&done, Method &&method);
+	static void PutToShard(
+		const std::weak_ptr<Wrapped> &weak,
+		const std::shared_ptr<Lanes> &lanes,
+		const Key &key,
+		TaggedValue &&value,
+		FnMut<void(Error)> &&done);
+
+	Settings _settings;
+	std::vector<std::shared_ptr<Wrapped>> _shards;
+	std::vector<std::shared_ptr<Lanes>> _lanes;
 
 };
 
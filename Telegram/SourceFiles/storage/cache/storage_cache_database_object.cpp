@@ -58,6 +58,12 @@ int32 GetUnixtime() {
 	return std::max(int32(time(nullptr)), 1);
 }
 
+int64 CountMicroseconds(std::chrono::steady_clock::time_point started) {
+	const auto passed = std::chrono::steady_clock::now() - started;
+	return std::chrono::duration_cast<std::chrono::microseconds>(
+		passed).count();
+}
+
 } // namespace
 
 DatabaseObject::Entry::Entry(
@@ -67,7 +73,7 @@ DatabaseObject::Entry::Entry(
 	size_type size,
 	uint64 useTime)
 : useTime(useTime)
-, size(size)
+, size(int32(size))
 , checksum(checksum)
 , place(place)
 , tag(tag) {
@@ -95,6 +101,7 @@ void DatabaseObject::reconfigure(const Settings &settings) {
 void DatabaseObject::updateSettings(const SettingsUpdate &update) {
 	_settings.totalSizeLimit = update.totalSizeLimit;
 	_settings.totalTimeLimit = update.totalTimeLimit;
+	_settings.tagSizeLimits = update.tagSizeLimits;
 	checkSettings();
 
 	optimize();
@@ -110,6 +117,9 @@ void DatabaseObject::checkSettings() {
 		|| _settings.totalTimeLimit > 0);
 	Expects(!_settings.totalSizeLimit
 		|| _settings.totalSizeLimit > _settings.maxDataSize);
+	for (const auto &[tag, limit] : _settings.tagSizeLimits) {
+		Expects(limit > 0);
+	}
 }
 
 template <typename Callback, typename ...Args>
@@ -175,6 +185,10 @@ QString DatabaseObject::CompactReadyFilename() {
 	return QStringLiteral("binlog-ready");
 }
 
+QString DatabaseObject::SnapshotFilename() {
+	return QStringLiteral("snapshot");
+}
+
 QString DatabaseObject::binlogPath(Version version) const {
 	return computePath(version) + BinlogFilename();
 }
@@ -191,13 +205,23 @@ QString DatabaseObject::compactReadyPath() const {
 	return _path + CompactReadyFilename();
 }
 
+QString DatabaseObject::snapshotPath(Version version) const {
+	return computePath(version) + SnapshotFilename();
+}
+
+QString DatabaseObject::snapshotPath() const {
+	return _path + SnapshotFilename();
+}
+
 File::Result DatabaseObject::openBinlog(
 		Version version,
 		File::Mode mode,
 		EncryptionKey &key) {
 	const auto ready = compactReadyPath(version);
 	const auto path = binlogPath(version);
-	if (QFile(ready).exists() && !File::Move(ready, path)) {
+	if (QFile(ready).exists()
+		&& (!removeSnapshot(snapshotPath(version))
+			|| !File::Move(ready, path))) {
 		return File::Result::Failed;
 	}
 	const auto result = _binlog.open(path, mode, key);
@@ -232,7 +256,7 @@ bool DatabaseObject::writeHeader() {
 	if (_settings.trackEstimatedTime) {
 		header.flags |= header.kTrackEstimatedTime;
 	}
-	return _binlog.write(bytes::object_as_span(&header));
+	return writeToBinlog(bytes::object_as_span(&header));
 }
 
 template <typename Reader, typename ...Handlers>
@@ -249,6 +273,9 @@ void DatabaseObject::readBinlogHelper(
 }
 
 void DatabaseObject::readBinlog() {
+	if (!readSnapshot()) {
+		_snapshotOffset = 0;
+	}
 	BinlogWrapper wrapper(_binlog, _settings);
 	if (_settings.trackEstimatedTime) {
 		BinlogReader<
@@ -284,6 +311,136 @@ void DatabaseObject::readBinlog() {
 	optimize();
 }
 
+bool DatabaseObject::readSnapshot() {
+	static_assert(GoodForEncryption<SnapshotHeader>);
+	static_assert(GoodForEncryption<StoreWithTime>);
+
+	if (_settings.snapshotAfterBytes <= 0) {
+		return false;
+	}
+	auto file = File();
+	const auto result = file.open(snapshotPath(), File::Mode::Read, _key);
+	if (result != File::Result::Success) {
+		return false;
+	}
+	auto header = SnapshotHeader();
+	const auto flags = _settings.trackEstimatedTime
+		? BasicHeader::kTrackEstimatedTime
+		: 0U;
+	if (file.read(bytes::object_as_span(&header)) != sizeof(header)
+		|| header.format != SnapshotHeader::kFormat
+		|| header.flags != flags
+		|| header.binlogOffset < _binlog.offset()
+		|| header.binlogOffset > _binlog.size()
+		|| header.binlogExcessLength < 0) {
+		return false;
+	}
+	const auto count = size_type(header.count);
+	const auto size = count * size_type(sizeof(StoreWithTime));
+	if (file.size() != file.offset() + size) {
+		return false;
+	}
+	auto records = std::vector<StoreWithTime>(count);
+	if (file.read(bytes::make_span(records)) != size) {
+		return false;
+	}
+	for (const auto &record : records) {
+		const auto size = record.getSize();
+		if (size <= 0 || size > _settings.maxDataSize) {
+			return false;
+		}
+	}
+	if (!_binlog.seek(header.binlogOffset)) {
+		return false;
+	}
+
+	_map.reserve(count);
+	for (const auto &record : records) {
+		setMapEntry(record.key, Entry(
+			record.place,
+			record.tag,
+			record.checksum,
+			record.getSize(),
+			record.time.getRelative()));
+	}
+	applyTimePoint(header.time);
+	_binlogExcessLength = header.binlogExcessLength;
+	_snapshotOffset = header.binlogOffset;
+	return true;
+}
+
+void DatabaseObject::writeSnapshotDelayed() {
+	if (_settings.snapshotAfterBytes <= 0
+		|| _writingSnapshot
+		|| !_binlog.isOpen()
+		|| (_binlog.size() - _snapshotOffset
+			< _settings.snapshotAfterBytes)) {
+		return;
+	}
+	_writingSnapshot = true;
+	_weak.with([](DatabaseObject &that) {
+		if (base::take(that._writingSnapshot)) {
+			that.writeSnapshot();
+		}
+	});
+}
+
+void DatabaseObject::writeSnapshot() {
+	if (_settings.snapshotAfterBytes <= 0
+		|| !_binlog.isOpen()
+		|| _binlog.size() == _snapshotOffset) {
+		return;
+	}
+
+	// Removed and accessed keys are already applied to _map.
+	writeBundles();
+
+	auto header = SnapshotHeader();
+	header.flags = _settings.trackEstimatedTime
+		? BasicHeader::kTrackEstimatedTime
+		: 0U;
+	header.count = uint32(_map.size());
+	header.binlogOffset = _binlog.size();
+	header.binlogExcessLength = _binlogExcessLength;
+	header.time = _time;
+
+	auto records = std::vector<StoreWithTime>();
+	records.reserve(_map.size());
+	for (const auto &[key, entry] : _map) {
+		auto record = StoreWithTime();
+		record.key = key;
+		record.setSize(entry.size);
+		record.checksum = entry.checksum;
+		record.tag = entry.tag;
+		record.place = entry.place;
+		record.time.setRelative(entry.useTime);
+		record.time.system = _time.system;
+		records.push_back(record);
+	}
+
+	const auto path = snapshotPath();
+	const auto temporary = path + QStringLiteral("-new");
+	auto file = File();
+	const auto result = file.open(temporary, File::Mode::Write, _key);
+	if (result != File::Result::Success) {
+		return;
+	} else if (!file.write(bytes::object_as_span(&header))
+		|| !file.write(bytes::make_span(records))
+		|| !file.flush()) {
+		file.close();
+		QFile(temporary).remove();
+		return;
+	}
+	file.close();
+	if (File::Move(temporary, path)) {
+		_snapshotOffset = header.binlogOffset;
+	}
+}
+
+bool DatabaseObject::removeSnapshot(const QString &path) {
+	return QFile(path).remove() || !QFile(path).exists();
+}
+
 uint64 DatabaseObject::countRelativeTime() const {
 	const auto now = GetUnixtime();
 	const auto delta = std::max(int64(now) - int64(_time.system), 0LL);
@@ -301,6 +458,7 @@ void DatabaseObject::optimize() {
 	if (!startDelayedPruning()) {
 		checkCompactor();
 	}
+	writeSnapshotDelayed();
 }
 
 bool DatabaseObject::startDelayedPruning() {
@@ -312,6 +470,8 @@ bool DatabaseObject::startDelayedPruning() {
 		if (_settings.totalSizeLimit > 0
 			&& _totalSize > _settings.totalSizeLimit) {
 			return true;
+		} else if (tagsOverSizeLimits()) {
+			return true;
 		} else if ((!_minimalEntryTime && !_map.empty())
 			|| _minimalEntryTime <= before) {
 			return true;
@@ -336,18 +496,34 @@ bool DatabaseObject::startDelayedPruning() {
 	return false;
 }
 
+bool DatabaseObject::tagsOverSizeLimits() const {
+	for (const auto &[tag, limit] : _settings.tagSizeLimits) {
+		const auto i = _taggedStats.find(tag);
+		if (i != end(_taggedStats) && i->second.totalSize > limit) {
+			return true;
+		}
+	}
+	return false;
+}
+
 void DatabaseObject::prune() {
 	if (!_stale.empty()) {
 		return;
 	}
+	const auto started = std::chrono::steady_clock::now();
 	auto stale = base::flat_set<Key>();
 	auto staleTotalSize = int64();
 	collectTimeStale(stale, staleTotalSize);
+	collectTagStale(stale, staleTotalSize);
 	collectSizeStale(stale, staleTotalSize);
+	++_metrics.prunesCount;
+	_metrics.prunedEntries += stale.size();
+	_metrics.prunesDuration += CountMicroseconds(started);
 	if (stale.size() <= _settings.staleRemoveChunk) {
 		clearStaleNow(stale);
 	} else {
 		_stale = ranges::view::all(stale) | ranges::to_vector;
+		_staleTotal = _stale.size();
 		startStaleClear();
 	}
 }
@@ -401,8 +577,12 @@ void DatabaseObject::clearStaleChunk() {
 	_stale.resize(count - clear);
 	if (_stale.empty()) {
 		base::take(_stale);
+		_staleTotal = 0;
 		optimize();
 	} else {
+		// Each chunk is cleared in a separate queue task, so get / put
+		// requests are processed between them, report the progress.
+		pushStatsDelayed();
 		clearStaleChunkDelayed();
 	}
 }
@@ -433,47 +613,103 @@ void DatabaseObject::collectTimeStale(
 	}
 }
 
+void DatabaseObject::collectTagStale(
+		base::flat_set<Key> &stale,
+		int64 &staleTotalSize) {
+	for (const auto &pair : _settings.tagSizeLimits) {
+		const auto tag = pair.first;
+		const auto limit = pair.second;
+		const auto i = _taggedStats.find(tag);
+		if (i == end(_taggedStats) || i->second.totalSize <= limit) {
+			continue;
+		}
+		auto tagSize = int64();
+		for (const auto &[key, entry] : _map) {
+			if (entry.tag == tag && !stale.contains(key)) {
+				tagSize += entry.size;
+			}
+		}
+		collectLeastValuableStale(
+			stale,
+			staleTotalSize,
+			tagSize - limit,
+			[&](const Entry &entry) { return (entry.tag == tag); });
+	}
+}
+
 void DatabaseObject::collectSizeStale(
 		base::flat_set<Key> &stale,
 		int64 &staleTotalSize) {
 	const auto removeSize = (_settings.totalSizeLimit > 0)
 		? (_totalSize - staleTotalSize - _settings.totalSizeLimit)
 		: 0;
+	collectLeastValuableStale(
+		stale,
+		staleTotalSize,
+		removeSize,
+		[](const Entry &) { return true; });
+}
+
+template <typename Filter>
+void DatabaseObject::collectLeastValuableStale(
+		base::flat_set<Key> &stale,
+		int64 &staleTotalSize,
+		int64 removeSize,
+		Filter &&filter) {
 	if (removeSize <= 0) {
 		return;
 	}
 
-	using Bucket = std::pair<const Key, Entry>;
+	// Entries with lower tag priority are evicted first. For the frequency
+	// policy rarely used entries are evicted next and a single scroll
+	// through new content can't flush the entries that are reused all
+	// the time. Ties are broken by the use time.
+	using Rank = std::tuple<int, int, uint64>;
+	const auto frequency = (_settings.evictionPolicy
+		== EvictionPolicy::Frequency);
+	const auto priority = [&](uint8 tag) {
+		const auto i = _settings.tagPriorities.find(tag);
+		return (i != end(_settings.tagPriorities)) ? i->second : 0;
+	};
+	const auto rank = [&](const Key &key, const Entry &entry) {
+		return Rank(
+			priority(entry.tag),
+			frequency ? _frequency.frequency(key) : 0,
+			entry.useTime);
+	};
+
+	using Bucket = Map::value_type;
 	auto oldest = base::flat_multi_map<
-		int64,
+		Rank,
 		const Bucket*,
 		std::greater<>>();
 	auto oldestTotalSize = int64();
 
-	const auto canRemoveFirst = [&](const Entry &adding) {
-		const auto totalSizeAfterAdd = oldestTotalSize + adding.size;
-		const auto &first = oldest.begin()->second->second;
-		return (adding.useTime <= first.useTime
-			&& (totalSizeAfterAdd - removeSize >= first.size));
+	const auto canRemoveFirst = [&](const Rank &adding, const Entry &entry) {
+		const auto totalSizeAfterAdd = oldestTotalSize + entry.size;
+		const auto &[firstRank, first] = *oldest.begin();
+		return (adding <= firstRank
+			&& (totalSizeAfterAdd - removeSize >= first->second.size));
 	};
 
 	for (const auto &bucket : _map) {
 		const auto &entry = bucket.second;
-		if (stale.contains(bucket.first)) {
+		if (!filter(entry) || stale.contains(bucket.first)) {
 			continue;
 		}
+		const auto adding = rank(bucket.first, entry);
 		const auto add = (oldestTotalSize < removeSize)
 			? true
-			: (entry.useTime < oldest.begin()->second->second.useTime);
+			: (adding < oldest.begin()->first);
 		if (!add) {
 			continue;
 		}
-		while (!oldest.empty() && canRemoveFirst(entry)) {
+		while (!oldest.empty() && canRemoveFirst(adding, entry)) {
 			oldestTotalSize -= oldest.begin()->second->second.size;
 			oldest.erase(oldest.begin());
 		}
 		oldestTotalSize += entry.size;
-		oldest.emplace(entry.useTime, &bucket);
+		oldest.emplace(adding, &bucket);
 	}
 
 	for (const auto &pair : oldest) {
@@ -575,6 +811,7 @@ bool DatabaseObject::processRecordMultiAccess(
 		_binlogExcessLength += sizeof(*entry);
 		if (const auto i = _map.find(*entry); i != end(_map)) {
 			i->second.useTime = relative;
+			recordEntryFrequency(*entry);
 		}
 	}
 	return true;
@@ -583,6 +820,9 @@ bool DatabaseObject::processRecordMultiAccess(
 void DatabaseObject::setMapEntry(const Key &key, Entry &&entry) {
 	auto &already = _map[key];
 	updateStats(already, entry);
+	if (entry.size != 0) {
+		recordEntryFrequency(key);
+	}
 	if (already.size != 0) {
 		_binlogExcessLength += _settings.trackEstimatedTime
 			? sizeof(StoreWithTime)
@@ -629,6 +869,36 @@ void DatabaseObject::updateStats(const Entry &was, const Entry &now) {
 	pushStatsDelayed();
 }
 
+void DatabaseObject::recordLatency(
+		LatencyHistogram &histogram,
+		TimePoint started) {
+	const auto microseconds = CountMicroseconds(started);
+	histogram.add(microseconds);
+
+	// Smooth the value, so that one slow read doesn't pause compaction.
+	const auto latency = crl::time_type(microseconds / 1000);
+	_foregroundLatency = (_foregroundLatency * 7 + latency) / 8;
+}
+
+void DatabaseObject::recordHit(uint8 tag) {
+	++_metrics.hits;
+	++_metrics.taggedHits[tag];
+	pushStatsDelayed();
+}
+
+void DatabaseObject::recordMiss() {
+	++_metrics.misses;
+	pushStatsDelayed();
+}
+
+bool DatabaseObject::writeToBinlog(bytes::span bytes) {
+	if (!_binlog.write(bytes)) {
+		return false;
+	}
+	_metrics.binlogBytesWritten += bytes.size();
+	return true;
+}
+
 void DatabaseObject::pushStatsDelayed() {
 	if (_pushingStats) {
 		return;
@@ -696,13 +966,17 @@ void DatabaseObject::compactorDone(
 			return;
 		}
 	}
-	if (!File::Move(path, ready)) {
+	if (!removeSnapshot(snapshotPath()) || !File::Move(path, ready)) {
 		compactorFail();
 		return;
 	}
+	_snapshotOffset = 0;
 	const auto guard = gsl::finally([&] {
 		_compactor = CompactorWrap();
+		pushStatsDelayed();
 	});
+	++_metrics.compactionsCount;
+	_metrics.compactionsDuration += crl::time() - _compactor.started;
 	_binlog.close();
 	if (!File::Move(ready, binlog)) {
 		compactorFail();
@@ -719,6 +993,7 @@ void DatabaseObject::compactorDone(
 	}
 	_binlogExcessLength -= _compactor.excessLength;
 	Assert(_binlogExcessLength >= 0);
+	writeSnapshotDelayed();
 }
 
 void DatabaseObject::compactorFail() {
@@ -729,11 +1004,26 @@ void DatabaseObject::compactorFail() {
 		delay * 2,
 		kMaxDelayAfterFailure);
 	QFile(compactReadyPath()).remove();
+	pushStatsDelayed();
+}
+
+void DatabaseObject::compactorProgress(int64 processed) {
+	if (!_compactor.object) {
+		return;
+	}
+	_compactor.processed = processed;
+	pushStatsDelayed();
+}
+
+bool DatabaseObject::compactorShouldPause() const {
+	return (_settings.compactPauseLatency > 0)
+		&& (_foregroundLatency >= _settings.compactPauseLatency);
 }
 
 void DatabaseObject::close(FnMut<void()> &&done) {
 	if (_binlog.isOpen()) {
 		writeBundles();
+		writeSnapshot();
 		_binlog.close();
 	}
 	invokeCallback(done);
@@ -746,13 +1036,20 @@ void DatabaseObject::clearState() {
 	_map = {};
 	_removing = {};
 	_accessed = {};
+	_bundleArena = {};
 	_stale = {};
+	_staleTotal = 0;
 	_time = {};
 	_binlogExcessLength = 0;
+	_snapshotOffset = 0;
+	_writingSnapshot = false;
 	_totalSize = 0;
 	_minimalEntryTime = 0;
 	_entriesWithMinimalTimeCount = 0;
+	_frequency = {};
+	_foregroundLatency = 0;
 	_taggedStats = {};
+	_metrics = {};
 	_pushingStats = false;
 	_writeBundlesTimer.cancel();
 	_pruneTimer.cancel();
@@ -767,6 +1064,11 @@ void DatabaseObject::put(
 		remove(key, std::move(done));
 		return;
 	}
+	const auto started = std::chrono::steady_clock::now();
+	const auto latency = gsl::finally([&] {
+		recordLatency(_metrics.putLatency, started);
+	});
+
 	_removing.erase(key);
 	_stale.erase(ranges::remove(_stale, key), end(_stale));
 
@@ -804,6 +1106,7 @@ void DatabaseObject::put(
 			invokeCallback(done, ioError(path));
 		} else {
 			data.flush();
+			_metrics.dataBytesWritten += data.size();
 			invokeCallback(done, Error::NoError());
 			optimize();
 		}
@@ -842,7 +1145,7 @@ std::optional<QString> DatabaseObject::writeKeyPlaceGeneric(
 	}
 	const auto result = placePath(record.place);
 	auto writeable = record;
-	const auto success = _binlog.write(bytes::object_as_span(&writeable));
+	const auto success = writeToBinlog(bytes::object_as_span(&writeable));
 	if (!success) {
 		_binlog.close();
 		return QString();
@@ -898,7 +1201,7 @@ Error DatabaseObject::writeExistingPlaceGeneric(
 	}
 	record.place = entry.place;
 	auto writeable = record;
-	const auto success = _binlog.write(bytes::object_as_span(&writeable));
+	const auto success = writeToBinlog(bytes::object_as_span(&writeable));
 	if (!success) {
 		_binlog.close();
 		return ioError(binlogPath());
@@ -935,24 +1238,62 @@ Error DatabaseObject::writeExistingPlace(
 void DatabaseObject::get(
 		const Key &key,
 		FnMut<void(TaggedValue&&)> &&done) {
+	const auto started = std::chrono::steady_clock::now();
+	auto result = readValue(key);
+	recordLatency(_metrics.getLatency, started);
+
+	invokeCallback(done, std::move(result));
+}
+
+void DatabaseObject::getMany(
+		const std::vector<Key> &keys,
+		FnMut<void(std::vector<TaggedValue>&&)> &&done) {
+	auto result = std::vector<TaggedValue>(keys.size());
+	auto order = std::vector<std::pair<PlaceId, size_type>>();
+	order.reserve(keys.size());
+	const auto count = size_type(keys.size());
+	for (auto i = size_type(0); i != count; ++i) {
+		if (const auto j = _map.find(keys[i]); j != end(_map)) {
+			order.emplace_back(j->second.place, i);
+		}
+	}
+
+	// Read the data files ordered by their places, so that the files
+	// from the same folder are read one after another.
+	ranges::sort(order);
+	for (const auto &[place, index] : order) {
+		const auto started = std::chrono::steady_clock::now();
+		result[index] = readValue(keys[index]);
+		recordLatency(_metrics.getLatency, started);
+	}
+	_metrics.misses += size_type(keys.size() - order.size());
+	pushStatsDelayed();
+
+	invokeCallback(done, std::move(result));
+}
+
+TaggedValue DatabaseObject::readValue(const Key &key) {
 	const auto i = _map.find(key);
 	if (i == _map.end()) {
-		invokeCallback(done, TaggedValue());
-		return;
+		recordMiss();
+		return TaggedValue();
 	}
 	const auto &entry = i->second;
 
 	auto bytes = readValueData(entry.place, entry.size);
 	if (bytes.isEmpty()) {
 		remove(key, nullptr);
-		invokeCallback(done, TaggedValue());
+		recordMiss();
+		return TaggedValue();
 	} else if (CountChecksum(bytes::make_span(bytes)) != entry.checksum) {
 		remove(key, nullptr);
-		invokeCallback(done, TaggedValue());
-	} else {
-		invokeCallback(done, TaggedValue(std::move(bytes), entry.tag));
-		recordEntryAccess(key);
+		recordMiss();
+		return TaggedValue();
 	}
+	auto result = TaggedValue(std::move(bytes), entry.tag);
+	recordHit(result.tag);
+	recordEntryAccess(key);
+	return result;
 }
 
 QByteArray DatabaseObject::readValueData(PlaceId place, size_type size) const {
@@ -965,7 +1306,9 @@ QByteArray DatabaseObject::readValueData(PlaceId place, size_type size) const {
 	case File::Result::Success: {
 		auto result = QByteArray(size, Qt::Uninitialized);
 		const auto bytes = bytes::make_detached_span(result);
-		const auto read = data.readWithPadding(bytes);
+		const auto read = (size <= _settings.mappedReadLimit)
+			? data.readWithPaddingMapped(bytes)
+			: data.readWithPadding(bytes);
 		if (read != size) {
 			return QByteArray();
 		}
@@ -980,10 +1323,19 @@ void DatabaseObject::recordEntryAccess(const Key &key) {
 		return;
 	}
 	_accessed.emplace(key);
+	recordEntryFrequency(key);
 	writeMultiAccessLazy();
 	optimize();
 }
 
+void DatabaseObject::recordEntryFrequency(const Key &key) {
+	if (_settings.evictionPolicy != EvictionPolicy::Frequency) {
+		return;
+	}
+	_frequency.reserve(_map.size());
+	_frequency.increment(key);
+}
+
 void DatabaseObject::remove(const Key &key, FnMut<void(Error)> &&done) {
 	const auto i = _map.find(key);
 	if (i != _map.end()) {
@@ -1064,6 +1416,12 @@ Stats DatabaseObject::collectStats() const {
 	result.full.count = _map.size();
 	result.full.totalSize = _totalSize;
 	result.clearing = (_cleaner.object != nullptr) || !_stale.empty();
+	result.clearProcessed = _staleTotal - size_type(_stale.size());
+	result.clearTotal = _staleTotal;
+	result.compacting = (_compactor.object != nullptr);
+	result.compactProcessed = _compactor.processed;
+	result.compactTotal = _compactor.total;
+	result.metrics = _metrics;
 	return result;
 }
 
@@ -1081,6 +1439,31 @@ void DatabaseObject::writeMultiRemoveLazy() {
 	}
 }
 
+template <typename Record>
+bytes::span DatabaseObject::prepareBundle(
+		const Record &header,
+		const std::set<Key> &keys) {
+	using Part = typename Record::Part;
+	static_assert(std::is_same_v<Part, Key>);
+	static_assert(GoodForEncryption<Record>);
+	static_assert(GoodForEncryption<Part>);
+
+	// Parts are placed right after the header in a reused arena, so the
+	// whole record is encrypted in place and written by a single call.
+	const auto size = size_type(sizeof(Record) + keys.size() * sizeof(Part));
+	if (_bundleArena.size() < size) {
+		_bundleArena.resize(size);
+	}
+	const auto result = bytes::make_span(_bundleArena).subspan(0, size);
+	bytes::copy(result, bytes::object_as_span(&header));
+	auto parts = result.subspan(sizeof(Record));
+	for (const auto &key : keys) {
+		bytes::copy(parts, bytes::object_as_span(&key));
+		parts = parts.subspan(sizeof(Part));
+	}
+	return result;
+}
+
 Error DatabaseObject::writeMultiRemove() {
 	Expects(_removing.size() <= _settings.maxBundledRecords);
 
@@ -1088,17 +1471,11 @@ Error DatabaseObject::writeMultiRemove() {
 		return Error::NoError();
 	}
 	const auto size = _removing.size();
-	auto header = MultiRemove(size);
-	auto list = std::vector<MultiRemove::Part>();
-	list.reserve(size);
-	for (const auto &key : base::take(_removing)) {
-		list.push_back(key);
-	}
-	if (_binlog.write(bytes::object_as_span(&header))
-		&& _binlog.write(bytes::make_span(list))) {
+	const auto bundle = prepareBundle(MultiRemove(size), _removing);
+	_removing.clear();
+	if (writeToBinlog(bundle)) {
 		_binlog.flush();
-		_binlogExcessLength += bytes::object_as_span(&header).size()
-			+ bytes::make_span(list).size();
+		_binlogExcessLength += bundle.size();
 		return Error::NoError();
 	}
 	_binlog.close();
@@ -1126,26 +1503,17 @@ Error DatabaseObject::writeMultiAccessBlock() {
 
 	const auto time = countTimePoint();
 	const auto size = _accessed.size();
-	auto header = MultiAccess(time, size);
-	auto list = std::vector<MultiAccess::Part>();
-	if (size > 0) {
-		list.reserve(size);
-		for (const auto &key : base::take(_accessed)) {
-			list.push_back(key);
-		}
-	}
 	_time = time;
-	for (const auto &entry : list) {
-		if (const auto i = _map.find(entry); i != end(_map)) {
+	for (const auto &key : _accessed) {
+		if (const auto i = _map.find(key); i != end(_map)) {
 			i->second.useTime = _time.getRelative();
 		}
 	}
-
-	if (_binlog.write(bytes::object_as_span(&header))
-		&& (!size || _binlog.write(bytes::make_span(list)))) {
+	const auto bundle = prepareBundle(MultiAccess(time, size), _accessed);
+	_accessed.clear();
+	if (writeToBinlog(bundle)) {
 		_binlog.flush();
-		_binlogExcessLength += bytes::object_as_span(&header).size()
-			+ bytes::make_span(list).size();
+		_binlogExcessLength += bundle.size();
 		return Error::NoError();
 	}
 	_binlog.close();
@@ -1206,6 +1574,9 @@ void DatabaseObject::checkCompactor() {
 		base::duplicate(_key),
 		info);
 	_compactor.excessLength = _binlogExcessLength;
+	_compactor.total = info.till;
+	_compactor.started = crl::time();
+	pushStatsDelayed();
 }
 
 void DatabaseObject::clear(FnMut<void(Error)> &&done) {
@@ -1228,11 +1599,14 @@ void DatabaseObject::clear(FnMut<void(Error)> &&done) {
 
 void DatabaseObject::clearByTag(uint8 tag, FnMut<void(Error)> &&done) {
 	const auto hadStale = !_stale.empty();
+	const auto wasCount = size_type(_stale.size());
 	for (const auto &[key, entry] : _map) {
 		if (entry.tag == tag) {
 			_stale.push_back(key);
 		}
 	}
+	_staleTotal = (hadStale ? _staleTotal : 0)
+		+ (size_type(_stale.size()) - wasCount);
 	if (!hadStale) {
 		startStaleClear();
 	}
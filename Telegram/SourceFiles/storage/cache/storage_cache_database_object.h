@@ -8,12 +8,14 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 #pragma once
 
 #include "storage/cache/storage_cache_database.h"
+#include "storage/cache/storage_cache_key_map.h"
 #include "storage/storage_encrypted_file.h"
 #include "base/binary_guard.h"
 #include "base/concurrent_timer.h"
 #include "base/bytes.h"
 #include "base/flat_set.h"
 #include <set>
+#include <chrono>
 #include <rpl/event_stream.h>
 
 namespace Storage {
@@ -41,6 +43,9 @@ public:
 		TaggedValue &&value,
 		FnMut<void(Error)> &&done);
 	void get(const Key &key, FnMut<void(TaggedValue&&)> &&done);
+	void getMany(
+		const std::vector<Key> &keys,
+		FnMut<void(std::vector<TaggedValue>&&)> &&done);
 	void remove(const Key &key, FnMut<void(Error)> &&done);
 
 	void putIfEmpty(
@@ -64,9 +69,12 @@ public:
 
 	static QString BinlogFilename();
 	static QString CompactReadyFilename();
+	static QString SnapshotFilename();
 
 	void compactorDone(const QString &path, int64 originalReadTill);
 	void compactorFail();
+	void compactorProgress(int64 processed);
+	bool compactorShouldPause() const;
 
 	struct Entry {
 		Entry() = default;
@@ -77,8 +85,9 @@ public:
 			size_type size,
 			uint64 useTime);
 
+		// Packed to 24 bytes, size always fits in kDataSizeLimit.
 		uint64 useTime = 0;
-		size_type size = 0;
+		int32 size = 0;
 		uint32 checksum = 0;
 		PlaceId place = { { 0 } };
 		uint8 tag = 0;
@@ -97,11 +106,14 @@ private:
 	struct CompactorWrap {
 		std::unique_ptr<Compactor> object;
 		int64 excessLength = 0;
+		int64 processed = 0;
+		int64 total = 0;
+		crl::time_type started = 0;
 		crl::time_type nextAttempt = 0;
 		crl::time_type delayAfterFailure = 10 * crl::time_type(1000);
 		base::binary_guard guard;
 	};
-	using Map = std::unordered_map<Key, Entry>;
+	using Map = KeyMap<Entry>;
 
 	template <typename Callback, typename ...Args>
 	void invokeCallback(Callback &&callback, Args &&...args) const;
@@ -114,6 +126,8 @@ private:
 	QString binlogPath() const;
 	QString compactReadyPath(Version version) const;
 	QString compactReadyPath() const;
+	QString snapshotPath(Version version) const;
+	QString snapshotPath() const;
 	Error openSomeBinlog(EncryptionKey &&key);
 	Error openNewBinlog(EncryptionKey &key);
 	File::Result openBinlog(
@@ -124,6 +138,10 @@ private:
 	bool writeHeader();
 
 	void readBinlog();
+	bool readSnapshot();
+	void writeSnapshot();
+	void writeSnapshotDelayed();
+	bool removeSnapshot(const QString &path);
 	template <typename Reader, typename ...Handlers>
 	void readBinlogHelper(Reader &reader, Handlers &&...handlers);
 	template <typename Record, typename Postprocess>
@@ -151,6 +169,7 @@ private:
 	void checkCompactor();
 	void adjustRelativeTime();
 	bool startDelayedPruning();
+	bool tagsOverSizeLimits() const;
 	uint64 countRelativeTime() const;
 	EstimatedTimePoint countTimePoint() const;
 	void applyTimePoint(EstimatedTimePoint time);
@@ -160,14 +179,28 @@ private:
 	void collectTimeStale(
 		base::flat_set<Key> &stale,
 		int64 &staleTotalSize);
+	void collectTagStale(
+		base::flat_set<Key> &stale,
+		int64 &staleTotalSize);
 	void collectSizeStale(
 		base::flat_set<Key> &stale,
 		int64 &staleTotalSize);
+	template <typename Filter>
+	void collectLeastValuableStale(
+		base::flat_set<Key> &stale,
+		int64 &staleTotalSize,
+		int64 removeSize,
+		Filter &&filter);
 	void startStaleClear();
 	void clearStaleNow(const base::flat_set<Key> &stale);
 	void clearStaleChunkDelayed();
 	void clearStaleChunk();
 
+	using TimePoint = std::chrono::steady_clock::time_point;
+	void recordLatency(LatencyHistogram &histogram, TimePoint started);
+	void recordHit(uint8 tag);
+	void recordMiss();
+
 	void updateStats(const Entry &was, const Entry &now);
 	Stats collectStats() const;
 	void pushStatsDelayed();
@@ -176,7 +209,14 @@ private:
 	void setMapEntry(const Key &key, Entry &&entry);
 	void eraseMapEntry(const Map::const_iterator &i);
 	void recordEntryAccess(const Key &key);
+	void recordEntryFrequency(const Key &key);
+	TaggedValue readValue(const Key &key);
 	QByteArray readValueData(PlaceId place, size_type size) const;
+	bool writeToBinlog(bytes::span bytes);
+	template <typename Record>
+	bytes::span prepareBundle(
+		const Record &header,
+		const std::set<Key> &keys);
 
 	Version findAvailableVersion() const;
 	QString versionPath() const;
@@ -224,16 +264,23 @@ private:
 	Map _map;
 	std::set<Key> _removing;
 	std::set<Key> _accessed;
+	bytes::vector _bundleArena;
 	std::vector<Key> _stale;
+	size_type _staleTotal = 0;
 
 	EstimatedTimePoint _time;
 
+	crl::time_type _foregroundLatency = 0;
 	int64 _binlogExcessLength = 0;
+	int64 _snapshotOffset = 0;
+	bool _writingSnapshot = false;
 	int64 _totalSize = 0;
 	uint64 _minimalEntryTime = 0;
 	size_type _entriesWithMinimalTimeCount = 0;
+	FrequencySketch _frequency;
 
 	base::flat_map<uint8, TaggedSummary> _taggedStats;
+	Metrics _metrics;
 	rpl::event_stream<Stats> _stats;
 	bool _pushingStats = false;
 	bool _clearingStale = false;
@@ -8,13 +8,17 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 #include "catch.hpp"
 
 #include "storage/cache/storage_cache_database.h"
+#include "storage/cache/storage_cache_database_object.h"
 #include "storage/storage_encryption.h"
 #include "storage/storage_encrypted_file.h"
 #include "base/concurrent_timer.h"
+#include "base/benchmark.h"
 #include <crl/crl.h>
 #include <QtCore/QFile>
 #include <QtWidgets/QApplication>
 #include <thread>
+#include <random>
+#include <unordered_map>
 
 using namespace Storage::Cache;
 
@@ -117,6 +121,20 @@ Database::TaggedValue GetWithTag(Database &db, const Key &key) {
 	return ValueWithTag;
 }
 
+auto Values = std::vector<Database::TaggedValue>();
+const auto GetValues = [](std::vector<Database::TaggedValue> &&values) {
+	Values = std::move(values);
+	Semaphore.release();
+};
+
+std::vector<Database::TaggedValue> GetMany(
+		Database &db,
+		std::vector<Key> &&keys) {
+	db.getMany(std::move(keys), GetValues);
+	Semaphore.acquire();
+	return Values;
+}
+
 Error Put(Database &db, const Key &key, QByteArray &&value) {
 	db.put(key, std::move(value), GetResult);
 	Semaphore.acquire();
@@ -171,7 +189,7 @@ const auto AdvanceTime = [](int32 seconds) {
 	std::this_thread::sleep_for(std::chrono::milliseconds(1000) * seconds);
 };
 
-TEST_CASE("init timers", "[storage_cache_database]") {
+TEST_CASE("init timers", "[storage_cache_database][benchmark]") {
 	static auto init = [] {
 		int argc = 0;
 		char **argv = nullptr;
@@ -448,6 +466,23 @@ TEST_CASE("encrypted cache db", "[storage_cache_database]") {
 		REQUIRE((Get(db, Key{ 1, 0 }) == Test2()));
 		Close(db);
 	}
+	SECTION("reading many values from db") {
+		Database db(name, Settings);
+
+		REQUIRE(Open(db, key).type == Error::Type::None);
+		const auto values = GetMany(db, {
+			Key{ 1, 0 },
+			Key{ 1, 1 },
+			Key{ 0, 1 },
+			Key{ 5, 2 },
+		});
+		REQUIRE(values.size() == 4);
+		REQUIRE((values[0].bytes == Test2()));
+		REQUIRE(values[1].bytes.isEmpty());
+		REQUIRE((values[2].bytes == Test1()));
+		REQUIRE(((values[3].bytes == Test1()) && (values[3].tag == 2)));
+		Close(db);
+	}
 	SECTION("deleting in db by tag") {
 		Database db(name, Settings);
 
@@ -538,6 +573,104 @@ TEST_CASE("cache db remove", "[storage_cache_database]") {
 	}
 }
 
+TEST_CASE("cache db snapshot", "[storage_cache_database]") {
+	auto settings = Settings;
+	settings.snapshotAfterBytes = 1;
+	SECTION("writing db with snapshot") {
+		Database db(name, settings);
+
+		REQUIRE(Clear(db).type == Error::Type::None);
+		REQUIRE(Open(db, key).type == Error::Type::None);
+		REQUIRE(Put(db, Key{ 0, 1 }, Test1()).type == Error::Type::None);
+		REQUIRE(Put(db, Key{ 1, 0 }, Test2()).type == Error::Type::None);
+		REQUIRE(Put(db, Key{ 1, 1 }, Test1()).type == Error::Type::None);
+		Close(db);
+	}
+	SECTION("reading snapshot and writing binlog tail") {
+		Database db(name, settings);
+
+		REQUIRE(Open(db, key).type == Error::Type::None);
+		REQUIRE((Get(db, Key{ 0, 1 }) == Test1()));
+		REQUIRE((Get(db, Key{ 1, 0 }) == Test2()));
+		Remove(db, Key{ 1, 1 });
+		REQUIRE(Put(db, Key{ 2, 0 }, Test2()).type == Error::Type::None);
+		Close(db);
+	}
+	SECTION("reading snapshot and binlog tail") {
+		Database db(name, settings);
+
+		REQUIRE(Open(db, key).type == Error::Type::None);
+		REQUIRE((Get(db, Key{ 0, 1 }) == Test1()));
+		REQUIRE((Get(db, Key{ 1, 0 }) == Test2()));
+		REQUIRE(Get(db, Key{ 1, 1 }).isEmpty());
+		REQUIRE((Get(db, Key{ 2, 0 }) == Test2()));
+		Close(db);
+	}
+	SECTION("reading db without snapshot") {
+		Database db(name, Settings);
+
+		REQUIRE(Open(db, key).type == Error::Type::None);
+		REQUIRE((Get(db, Key{ 0, 1 }) == Test1()));
+		REQUIRE(Get(db, Key{ 1, 1 }).isEmpty());
+		REQUIRE((Get(db, Key{ 2, 0 }) == Test2()));
+		Close(db);
+	}
+}
+
+TEST_CASE("sharded cache db", "[storage_cache_database]") {
+	if (!DisableLargeTest) {
+		return;
+	}
+	auto settings = Settings;
+	settings.shardsCount = 4;
+	const auto count = 16U;
+	const auto value = [](uint32 index) {
+		auto result = Test1();
+		result[0] = char('A') + index;
+		return result;
+	};
+	SECTION("writing sharded db") {
+		Database db(name, settings);
+
+		REQUIRE(Clear(db).type == Error::Type::None);
+		REQUIRE(Open(db, key).type == Error::Type::None);
+		for (auto i = 0U; i != count; ++i) {
+			const auto result = Put(db, Key{ i, i + 1 }, value(i));
+			REQUIRE(result.type == Error::Type::None);
+		}
+		Close(db);
+	}
+	SECTION("reading sharded db") {
+		Database db(name, settings);
+
+		REQUIRE(Open(db, key).type == Error::Type::None);
+		for (auto i = 0U; i != count; ++i) {
+			REQUIRE((Get(db, Key{ i, i + 1 }) == value(i)));
+		}
+		REQUIRE(Get(db, Key{ count, count + 1 }).isEmpty());
+		Close(db);
+	}
+	SECTION("copying and moving between shards") {
+		Database db(name, settings);
+
+		REQUIRE(Open(db, key).type == Error::Type::None);
+		for (auto i = 0U; i != count; ++i) {
+			const auto to = Key{ i + 100, i + 101 };
+			REQUIRE(CopyIfEmpty(db, Key{ i, i + 1 }, to).type
+				== Error::Type::None);
+			REQUIRE((Get(db, to) == value(i)));
+		}
+		for (auto i = 0U; i != count; ++i) {
+			const auto from = Key{ i + 100, i + 101 };
+			const auto to = Key{ i + 200, i + 201 };
+			REQUIRE(MoveIfEmpty(db, from, to).type == Error::Type::None);
+			REQUIRE(Get(db, from).isEmpty());
+			REQUIRE((Get(db, to) == value(i)));
+		}
+		Close(db);
+	}
+}
+
 TEST_CASE("cache db bundled actions", "[storage_cache_database]") {
 	if (!DisableLargeTest) {
 		return;
@@ -603,6 +736,56 @@ TEST_CASE("cache db bundled actions", "[storage_cache_database]") {
 	}
 }
 
+TEST_CASE("cache db priority lanes", "[storage_cache_database]") {
+	// Holds the database queue until all the requests are added.
+	crl::semaphore blocked;
+	const auto block = [&](Database &db) {
+		db.get(Key{ 0, 0 }, [&](QByteArray&&) {
+			Semaphore.release();
+			blocked.acquire();
+		});
+		Semaphore.acquire();
+	};
+	const auto waitAll = [&](Database &db) {
+		db.remove(Key{ 0, 0 }, [&](Error) { Semaphore.release(); });
+		blocked.release();
+		Semaphore.acquire();
+	};
+	auto order = std::vector<int>();
+	const auto record = [&](int index) {
+		return [&, index](QByteArray&&) { order.push_back(index); };
+	};
+	SECTION("higher lanes are served first") {
+		Database db(name, Settings);
+
+		REQUIRE(Clear(db).type == Error::Type::None);
+		REQUIRE(Open(db, key).type == Error::Type::None);
+		block(db);
+		db.get(Key{ 1, 0 }, record(0), Priority::Background);
+		db.get(Key{ 1, 1 }, record(1), Priority::Prefetch);
+		db.get(Key{ 1, 2 }, record(2), Priority::Background);
+		db.get(Key{ 1, 3 }, record(3), Priority::Visible);
+		db.get(Key{ 1, 4 }, record(4), Priority::Interactive);
+		waitAll(db);
+		REQUIRE((order == std::vector<int>{ 3, 4, 1, 0, 2 }));
+		Close(db);
+	}
+	SECTION("lower lanes are not starved") {
+		Database db(name, Settings);
+
+		REQUIRE(Open(db, key).type == Error::Type::None);
+		block(db);
+		db.get(Key{ 2, 0 }, record(-1), Priority::Background);
+		for (auto i = 0; i != 40; ++i) {
+			db.get(Key{ 3, uint64(i) }, record(i), Priority::Visible);
+		}
+		waitAll(db);
+		REQUIRE(order.size() == 41);
+		REQUIRE(order[16] == -1);
+		Close(db);
+	}
+}
+
 TEST_CASE("cache db limits", "[storage_cache_database]") {
 	if (DisableLimitsTests || !DisableLargeTest) {
 		return;
@@ -672,6 +855,79 @@ TEST_CASE("cache db limits", "[storage_cache_database]") {
 		REQUIRE((Get(db, Key{ 2, 2 }) == Test2()));
 		Close(db);
 	}
+	SECTION("db size limit with frequency eviction") {
+		auto settings = Settings;
+		settings.trackEstimatedTime = true;
+		settings.totalSizeLimit = 17 * 3 + 1;
+		settings.evictionPolicy = Database::EvictionPolicy::Frequency;
+		Database db(name, settings);
+
+		db.clear(nullptr);
+		db.open(base::duplicate(key), nullptr);
+		db.put(Key{ 0, 1 }, Test1(), nullptr);
+		db.get(Key{ 0, 1 }, nullptr);
+		db.get(Key{ 0, 1 }, nullptr);
+		AdvanceTime(2);
+		db.put(Key{ 1, 0 }, Test2(), nullptr);
+		AdvanceTime(2);
+		db.put(Key{ 1, 1 }, Test1(), nullptr);
+		AdvanceTime(2);
+		db.put(Key{ 2, 0 }, Test2(), nullptr);
+		AdvanceTime(2);
+
+		// Oldest { 0, 1 } is used often, so rarely used { 1, 0 } is removed.
+		REQUIRE((Get(db, Key{ 0, 1 }) == Test1()));
+		REQUIRE(Get(db, Key{ 1, 0 }).isEmpty());
+		REQUIRE((Get(db, Key{ 1, 1 }) == Test1()));
+		REQUIRE((Get(db, Key{ 2, 0 }) == Test2()));
+		Close(db);
+	}
+	SECTION("db tag size limit") {
+		auto settings = Settings;
+		settings.trackEstimatedTime = true;
+		settings.tagSizeLimits.emplace(uint8(1), 17 * 2 + 1);
+		Database db(name, settings);
+
+		db.clear(nullptr);
+		db.open(base::duplicate(key), nullptr);
+		db.put(Key{ 0, 1 }, Database::TaggedValue(Test2(), 1), nullptr);
+		db.put(Key{ 0, 2 }, Test2(), nullptr);
+		AdvanceTime(2);
+		db.put(Key{ 1, 0 }, Database::TaggedValue(Test2(), 1), nullptr);
+		db.put(Key{ 1, 1 }, Database::TaggedValue(Test2(), 1), nullptr);
+		AdvanceTime(2);
+
+		// Only the oldest { 0, 1 } with the tag is removed.
+		REQUIRE(Get(db, Key{ 0, 1 }).isEmpty());
+		REQUIRE((Get(db, Key{ 0, 2 }) == Test2()));
+		REQUIRE((Get(db, Key{ 1, 0 }) == Test2()));
+		REQUIRE((Get(db, Key{ 1, 1 }) == Test2()));
+		Close(db);
+	}
+	SECTION("db size limit with tag priorities") {
+		auto settings = Settings;
+		settings.trackEstimatedTime = true;
+		settings.totalSizeLimit = 17 * 3 + 1;
+		settings.tagPriorities.emplace(uint8(1), 1);
+		Database db(name, settings);
+
+		db.clear(nullptr);
+		db.open(base::duplicate(key), nullptr);
+		db.put(Key{ 0, 1 }, Database::TaggedValue(Test2(), 1), nullptr);
+		AdvanceTime(2);
+		db.put(Key{ 1, 0 }, Test2(), nullptr);
+		AdvanceTime(2);
+		db.put(Key{ 1, 1 }, Test2(), nullptr);
+		db.put(Key{ 2, 0 }, Test2(), nullptr);
+		AdvanceTime(2);
+
+		// Oldest { 0, 1 } has a higher priority, so { 1, 0 } is removed.
+		REQUIRE((Get(db, Key{ 0, 1 }) == Test2()));
+		REQUIRE(Get(db, Key{ 1, 0 }).isEmpty());
+		REQUIRE((Get(db, Key{ 1, 1 }) == Test2()));
+		REQUIRE((Get(db, Key{ 2, 0 }) == Test2()));
+		Close(db);
+	}
 	SECTION("db time limit") {
 		auto settings = Settings;
 		settings.trackEstimatedTime = true;
@@ -738,3 +994,109 @@ TEST_CASE("large db", "[storage_cache_database]") {
 		Close(db);
 	}
 }
+
+TEST_CASE("cache index map", "[storage_cache_database]") {
+	using Entry = details::DatabaseObject::Entry;
+	const auto MakeEntry = [](int index) {
+		auto result = Entry();
+		result.useTime = uint64(index);
+		result.size = index % 1000 + 1;
+		return result;
+	};
+	SECTION("key map matches unordered map") {
+		auto random = std::mt19937_64(1);
+		auto map = details::KeyMap<Entry>();
+		auto check = std::unordered_map<Key, Entry>();
+		for (auto i = 0; i != 100000; ++i) {
+			const auto key = Key{ random() % 16, random() % 256 };
+			switch (random() % 3) {
+			case 0: map[key] = check[key] = MakeEntry(i); break;
+			case 1: {
+				const auto erased = size_type(check.erase(key));
+				REQUIRE(map.erase(key) == erased);
+			} break;
+			case 2: {
+				const auto j = map.find(key);
+				const auto k = check.find(key);
+				REQUIRE((j == end(map)) == (k == end(check)));
+				if (j != end(map)) {
+					REQUIRE(j->second.useTime == k->second.useTime);
+				}
+			} break;
+			}
+			REQUIRE(map.size() == size_type(check.size()));
+		}
+		for (const auto &[key, entry] : map) {
+			REQUIRE(check[key].useTime == entry.useTime);
+		}
+	}
+}
+
+// Hidden, run by the tests_benchmarks target.
+TEST_CASE("cache db benchmarks", "[.][benchmark]") {
+	using Entry = details::DatabaseObject::Entry;
+	using base::benchmark::measure;
+	using base::benchmark::report;
+
+	SECTION("key map") {
+		constexpr auto kCount = 500000;
+		auto random = std::mt19937_64(1);
+		auto keys = std::vector<Key>();
+		keys.reserve(kCount);
+		for (auto i = 0; i != kCount; ++i) {
+			keys.push_back(Key{ random(), random() });
+		}
+		const auto fill = [&](const std::string &name, auto &map) {
+			for (auto i = 0; i != kCount; ++i) {
+				auto &entry = map[keys[i]];
+				entry.useTime = uint64(i);
+				entry.size = i % 1000 + 1;
+			}
+			auto found = 0;
+			measure(name + ": 500K finds", [&] {
+				for (auto i = 0; i != kCount; ++i) {
+					const auto &key = keys[random() % kCount];
+					found += (map.find(key) != end(map)) ? 1 : 0;
+				}
+			});
+			REQUIRE(found == kCount);
+		};
+		auto map = details::KeyMap<Entry>();
+		auto check = std::unordered_map<Key, Entry>();
+		fill("KeyMap", map);
+		fill("unordered_map", check);
+		const auto checkMemory = check.bucket_count() * sizeof(void*)
+			+ check.size() * (sizeof(std::pair<const Key, Entry>)
+				+ 2 * sizeof(void*));
+		report("KeyMap: memory", map.memoryUsage() / 1024., "KB");
+		report("unordered_map: memory", checkMemory / 1024., "KB");
+	}
+
+	SECTION("put and get") {
+		constexpr auto kCount = 10000;
+		auto settings = Database::Settings();
+		settings.trackEstimatedTime = false;
+		settings.writeBundleDelay = crl::time_type(100);
+		Database db(name, settings);
+		REQUIRE(Clear(db).type == Error::Type::None);
+		REQUIRE(Open(db, key).type == Error::Type::None);
+
+		const auto value = QByteArray(1024, 'a');
+		measure("cache db: 10K puts of 1 KB", [&] {
+			for (auto i = 0; i != kCount; ++i) {
+				db.put(Key{ uint64(i), 0 }, base::duplicate(value), nullptr);
+			}
+			Put(db, Key{ uint64(kCount), 0 }, base::duplicate(value));
+		});
+		auto found = 0;
+		measure("cache db: 10K gets of 1 KB", [&] {
+			for (auto i = 0; i != kCount; ++i) {
+				found += (Get(db, Key{ uint64(i), 0 }).size() == 1024)
+					? 1
+					: 0;
+			}
+		});
+		REQUIRE(found == kCount);
+		Close(db);
+	}
+}
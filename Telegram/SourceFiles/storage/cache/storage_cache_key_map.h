@@ -0,0 +1,321 @@
+/*
+This file is part of Telegram Desktop,
+the official desktop application for the Telegram messaging service.
+
+For license and copyright information please follow this link:
+https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
+*/
+#pragma once
+
+#include "storage/cache/storage_cache_types.h"
+#include "base/algorithm.h"
+
+#include <vector>
+#include <utility>
+
+namespace Storage {
+namespace Cache {
+namespace details {
+
+// Open addressing hash table with linear probing and backward shift
+// deletion, all values are stored in one contiguous array of slots.
+//
+// Unlike std::unordered_map any insertion or erasure invalidates
+// all iterators, pointers and references to the elements.
+template <typename Value>
+class KeyMap {
+	template <typename Map, typename Pair>
+	class iterator_base;
+
+public:
+	using key_type = Key;
+	using mapped_type = Value;
+	using value_type = std::pair<Key, Value>;
+	using iterator = iterator_base<KeyMap, value_type>;
+	using const_iterator = iterator_base<const KeyMap, const value_type>;
+
+	KeyMap() = default;
+	KeyMap(const KeyMap &other) = default;
+	KeyMap(KeyMap &&other);
+	KeyMap &operator=(const KeyMap &other) = default;
+	KeyMap &operator=(KeyMap &&other);
+
+	size_type size() const {
+		return _size;
+	}
+	bool empty() const {
+		return !_size;
+	}
+	size_type capacity() const {
+		return size_type(_slots.size());
+	}
+	size_type memoryUsage() const {
+		return capacity() * size_type(sizeof(value_type) + sizeof(uint8));
+	}
+
+	iterator begin() {
+		return iterator(this, skipEmpty(0));
+	}
+	iterator end() {
+		return iterator(this, capacity());
+	}
+	const_iterator begin() const {
+		return const_iterator(this, skipEmpty(0));
+	}
+	const_iterator end() const {
+		return const_iterator(this, capacity());
+	}
+	const_iterator cbegin() const {
+		return begin();
+	}
+	const_iterator cend() const {
+		return end();
+	}
+
+	friend iterator begin(KeyMap &map) {
+		return map.begin();
+	}
+	friend iterator end(KeyMap &map) {
+		return map.end();
+	}
+	friend const_iterator begin(const KeyMap &map) {
+		return map.begin();
+	}
+	friend const_iterator end(const KeyMap &map) {
+		return map.end();
+	}
+
+	iterator find(const Key &key) {
+		return iterator(this, findIndex(key));
+	}
+	const_iterator find(const Key &key) const {
+		return const_iterator(this, findIndex(key));
+	}
+	bool contains(const Key &key) const {
+		return (findIndex(key) != capacity());
+	}
+
+	Value &operator[](const Key &key);
+	void erase(const_iterator i);
+	size_type erase(const Key &key);
+	void reserve(size_type count);
+	void clear();
+
+private:
+	static constexpr auto kMinimalCapacity = size_type(16);
+
+	static uint64 Hash(const Key &key);
+	size_type mask() const {
+		return capacity() - 1;
+	}
+	size_type next(size_type index) const {
+		return (index + 1) & mask();
+	}
+	size_type idealIndex(const Key &key) const {
+		return size_type(Hash(key) & uint64(mask()));
+	}
+	size_type findIndex(const Key &key) const;
+	size_type skipEmpty(size_type index) const;
+	void rehash(size_type capacity);
+
+	std::vector<value_type> _slots;
+	std::vector<uint8> _used;
+	size_type _size = 0;
+
+};
+
+template <typename Value>
+template <typename Map, typename Pair>
+class KeyMap<Value>::iterator_base {
+public:
+	using iterator_category = std::forward_iterator_tag;
+	using value_type = Pair;
+	using difference_type = std::ptrdiff_t;
+	using pointer = Pair*;
+	using reference = Pair&;
+
+	iterator_base() = default;
+	iterator_base(Map *map, size_type index) : _map(map), _index(index) {
+	}
+	template <
+		typename OtherMap,
+		typename OtherPair,
+		typename = std::enable_if_t<std::is_const_v<Map>
+			&& !std::is_const_v<OtherMap>>>
+	iterator_base(const iterator_base<OtherMap, OtherPair> &other)
+	: _map(other._map)
+	, _index(other._index) {
+	}
+
+	reference operator*() const {
+		return _map->_slots[_index];
+	}
+	pointer operator->() const {
+		return &_map->_slots[_index];
+	}
+	iterator_base &operator++() {
+		_index = _map->skipEmpty(_index + 1);
+		return *this;
+	}
+	iterator_base operator++(int) {
+		auto result = *this;
+		++*this;
+		return result;
+	}
+
+	template <typename OtherMap, typename OtherPair>
+	bool operator==(const iterator_base<OtherMap, OtherPair> &other) const {
+		return (_index == other._index);
+	}
+	template <typename OtherMap, typename OtherPair>
+	bool operator!=(const iterator_base<OtherMap, OtherPair> &other) const {
+		return !(*this == other);
+	}
+
+private:
+	template <typename OtherMap, typename OtherPair>
+	friend class iterator_base;
+	friend class KeyMap<Value>;
+
+	Map *_map = nullptr;
+	size_type _index = 0;
+
+};
+
+template <typename Value>
+KeyMap<Value>::KeyMap(KeyMap &&other)
+: _slots(std::move(other._slots))
+, _used(std::move(other._used))
+, _size(base::take(other._size)) {
+}
+
+template <typename Value>
+KeyMap<Value> &KeyMap<Value>::operator=(KeyMap &&other) {
+	if (this != &other) {
+		_slots = std::move(other._slots);
+		_used = std::move(other._used);
+		_size = base::take(other._size);
+	}
+	return *this;
+}
+
+template <typename Value>
+uint64 KeyMap<Value>::Hash(const Key &key) {
+	auto result = (key.high * 0x9E3779B97F4A7C15ULL) ^ key.low;
+	result ^= (result >> 33);
+	result *= 0xFF51AFD7ED558CCDULL;
+	result ^= (result >> 33);
+	return result;
+}
+
+template <typename Value>
+auto KeyMap<Value>::findIndex(const Key &key) const -> size_type {
+	if (_slots.empty()) {
+		return 0;
+	}
+	for (auto index = idealIndex(key); _used[index]; index = next(index)) {
+		if (_slots[index].first == key) {
+			return index;
+		}
+	}
+	return capacity();
+}
+
+template <typename Value>
+auto KeyMap<Value>::skipEmpty(size_type index) const -> size_type {
+	const auto till = capacity();
+	while (index != till && !_used[index]) {
+		++index;
+	}
+	return index;
+}
+
+template <typename Value>
+Value &KeyMap<Value>::operator[](const Key &key) {
+	if (const auto index = findIndex(key); index != capacity()) {
+		return _slots[index].second;
+	}
+	reserve(_size + 1);
+	auto index = idealIndex(key);
+	while (_used[index]) {
+		index = next(index);
+	}
+	_used[index] = 1;
+	_slots[index].first = key;
+	++_size;
+	return _slots[index].second;
+}
+
+template <typename Value>
+void KeyMap<Value>::erase(const_iterator i) {
+	Expects(i._index >= 0 && i._index < capacity());
+	Expects(_used[i._index]);
+
+	// Move back the following elements of the probe sequence,
+	// so that lookups never need tombstones.
+	auto hole = i._index;
+	for (auto index = next(hole); _used[index]; index = next(index)) {
+		const auto ideal = idealIndex(_slots[index].first);
+		if (((index - ideal) & mask()) >= ((index - hole) & mask())) {
+			_slots[hole] = std::move(_slots[index]);
+			hole = index;
+		}
+	}
+	_used[hole] = 0;
+	_slots[hole] = value_type();
+	--_size;
+}
+
+template <typename Value>
+auto KeyMap<Value>::erase(const Key &key) -> size_type {
+	const auto i = find(key);
+	if (i == end()) {
+		return 0;
+	}
+	erase(i);
+	return 1;
+}
+
+template <typename Value>
+void KeyMap<Value>::reserve(size_type count) {
+	// Keep the table at most 3/4 full.
+	auto required = std::max(capacity(), kMinimalCapacity);
+	while (count * 4 > required * 3) {
+		required *= 2;
+	}
+	if (required != capacity()) {
+		rehash(required);
+	}
+}
+
+template <typename Value>
+void KeyMap<Value>::clear() {
+	_slots = std::vector<value_type>();
+	_used = std::vector<uint8>();
+	_size = 0;
+}
+
+template <typename Value>
+void KeyMap<Value>::rehash(size_type capacity) {
+	Expects(!(capacity & (capacity - 1)));
+	Expects(_size * 4 <= capacity * 3);
+
+	auto slots = std::exchange(_slots, std::vector<value_type>(capacity));
+	auto used = std::exchange(_used, std::vector<uint8>(capacity, 0));
+	const auto count = size_type(slots.size());
+	for (auto i = size_type(0); i != count; ++i) {
+		if (!used[i]) {
+			continue;
+		}
+		auto index = idealIndex(slots[i].first);
+		while (_used[index]) {
+			index = next(index);
+		}
+		_used[index] = 1;
+		_slots[index] = std::move(slots[i]);
+	}
+}
+
+} // namespace details
+} // namespace Cache
+} // namespace Storage
@@ -7,7 +7,10 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 */
 #include "storage/cache/storage_cache_types.h"
 
+#include "base/algorithm.h"
+
 #include <QtCore/QDir>
+#include <cmath>
 
 namespace Storage {
 namespace Cache {
@@ -48,6 +51,127 @@ TaggedValue::TaggedValue(QByteArray &&bytes, uint8 tag)
 : bytes(std::move(bytes)), tag(tag) {
 }
 
+void LatencyHistogram::add(int64 microseconds) {
+	auto bucket = 0;
+	while (bucket + 1 < kBucketsCount && (microseconds >> (bucket + 1))) {
+		++bucket;
+	}
+	++buckets[bucket];
+	++count;
+}
+
+int64 LatencyHistogram::percentile(float64 part) const {
+	Expects(part >= 0. && part <= 1.);
+
+	if (!count) {
+		return 0;
+	}
+	const auto limit = std::max(
+		size_type(std::ceil(count * part)),
+		size_type(1));
+	auto accumulated = size_type(0);
+	for (auto i = 0; i != kBucketsCount; ++i) {
+		accumulated += buckets[i];
+		if (accumulated >= limit) {
+			return (int64(1) << (i + 1));
+		}
+	}
+	return (int64(1) << kBucketsCount);
+}
+
+void LatencyHistogram::merge(const LatencyHistogram &other) {
+	for (auto i = 0; i != kBucketsCount; ++i) {
+		buckets[i] += other.buckets[i];
+	}
+	count += other.count;
+}
+
+void FrequencySketch::reserve(size_type count) {
+	auto width = std::max(_width, kMinimalWidth);
+	while (width < count && width < kMaximalWidth) {
+		width *= 2;
+	}
+	if (width != _width) {
+		grow(width);
+	}
+}
+
+void FrequencySketch::increment(const Key &key) {
+	if (!_width) {
+		grow(kMinimalWidth);
+	}
+	auto indices = std::array<size_type, kDepth>();
+	auto minimal = kMaxCounter;
+	for (auto row = 0; row != kDepth; ++row) {
+		indices[row] = index(key, row);
+		accumulate_min(minimal, _counters[indices[row]]);
+	}
+	if (minimal == kMaxCounter) {
+		return;
+	}
+
+	// Conservative update: only the smallest counters are increased.
+	for (const auto index : indices) {
+		if (_counters[index] == minimal) {
+			++_counters[index];
+		}
+	}
+	if (++_additions >= _width * kAgingFactor) {
+		halve();
+	}
+}
+
+int FrequencySketch::frequency(const Key &key) const {
+	if (!_width) {
+		return 0;
+	}
+	auto result = int(kMaxCounter);
+	for (auto row = 0; row != kDepth; ++row) {
+		accumulate_min(result, int(_counters[index(key, row)]));
+	}
+	return result;
+}
+
+size_type FrequencySketch::index(const Key &key, int row) const {
+	static constexpr auto kSeeds = std::array<uint64, kDepth>{ {
+		0x9E3779B97F4A7C15ULL,
+		0xC2B2AE3D27D4EB4FULL,
+		0x165667B19E3779F9ULL,
+		0xD6E8FEB86659FD93ULL,
+	} };
+	auto hash = (key.high ^ (key.low * kSeeds[row])) + kSeeds[row];
+	hash ^= (hash >> 33);
+	hash *= 0xFF51AFD7ED558CCDULL;
+	hash ^= (hash >> 33);
+	return row * _width + size_type(hash & uint64(_width - 1));
+}
+
+void FrequencySketch::grow(size_type width) {
+	Expects(width > _width);
+	Expects(!(width & (width - 1)));
+
+	// Each new counter inherits the old counter with the same low bits,
+	// so estimates stay upper bounds without re-counting anything.
+	auto counters = std::vector<uint8>(kDepth * width, uint8(0));
+	if (_width > 0) {
+		for (auto row = 0; row != kDepth; ++row) {
+			for (auto i = size_type(0); i != width; ++i) {
+				counters[row * width + i]
+					= _counters[row * _width + (i & (_width - 1))];
+			}
+		}
+	}
+	_counters = std::move(counters);
+	_width = width;
+}
+
+void FrequencySketch::halve() {
+	for (auto &counter : _counters) {
+		counter >>= 1;
+	}
+	_additions /= 2;
+}
+
 QString ComputeBasePath(const QString &original) {
 	const auto result = QDir(original).absolutePath();
 	return result.endsWith('/') ? result : (result + '/');
@@ -13,6 +13,8 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 #include <crl/crl_time.h>
 #include <QtCore/QString>
 #include <QtCore/QByteArray>
+#include <array>
+#include <vector>
 
 namespace Storage {
 namespace Cache {
@@ -51,6 +53,16 @@ inline Error Error::NoError() {
 	return Error();
 }
 
+// Requests of the higher lanes are served first, while the lower ones
+// wait, see Database. The order is kept only inside the same lane.
+enum class Priority : uint8 {
+	Visible,
+	Interactive,
+	Prefetch,
+	Background,
+};
+constexpr auto kPrioritiesCount = 4;
+
 namespace details {
 
 using RecordType = uint8;
@@ -64,9 +76,15 @@ constexpr auto kBundledRecordsLimit
 	= size_type(1 << (RecordsCount().size() * 8));
 constexpr auto kDataSizeLimit = size_type(1 << (EntrySize().size() * 8));
 
+enum class EvictionPolicy : uchar {
+	LeastRecentlyUsed,
+	Frequency, // Rarely used entries go first, then least recently used.
+};
+
 struct Settings {
 	size_type maxBundledRecords = 16 * 1024;
 	size_type readBlockSize = 8 * 1024 * 1024;
+	size_type mappedReadLimit = 0; // Values up to this size are mmap-ed.
 	size_type maxDataSize = (kDataSizeLimit - 1);
 	crl::time_type writeBundleDelay = 15 * 60 * crl::time_type(1000);
 	size_type staleRemoveChunk = 256;
@@ -74,19 +92,37 @@ struct Settings {
 	int64 compactAfterExcess = 8 * 1024 * 1024;
 	int64 compactAfterFullSize = 0;
 	size_type compactChunkSize = 16 * 1024;
+	int64 compactBytesPerSecond = 0; // Zero means no throughput limit.
+	crl::time_type compactPauseLatency = 0; // Pause if get / put are slower.
+	crl::time_type compactPauseDelay = crl::time_type(1000);
 
 	bool trackEstimatedTime = true;
 	int64 totalSizeLimit = 1024 * 1024 * 1024;
 	size_type totalTimeLimit = 31 * 24 * 60 * 60; // One month in seconds.
 	crl::time_type pruneTimeout = 5 * crl::time_type(1000);
 	crl::time_type maxPruneCheckTimeout = 3600 * crl::time_type(1000);
+	EvictionPolicy evictionPolicy = EvictionPolicy::LeastRecentlyUsed;
+
+	// Entries of a tag are pruned down to its own size limit, and when
+	// the total size is over the limit lower priority tags go first.
+	base::flat_map<uint8, int64> tagSizeLimits;
+	base::flat_map<uint8, int> tagPriorities;
 
 	bool clearOnWrongKey = false;
+
+	// Index snapshot is written after the binlog grows by that many bytes
+	// and on close, so open() replays only the binlog tail after it.
+	int64 snapshotAfterBytes = 0; // Zero disables index snapshots.
+
+	// Keys are routed by hash to independent binlogs with own queues.
+	// Size limits are split evenly between the shards.
+	size_type shardsCount = 1;
 };
 
 struct SettingsUpdate {
 	int64 totalSizeLimit = Settings().totalSizeLimit;
 	size_type totalTimeLimit = Settings().totalTimeLimit;
+	base::flat_map<uint8, int64> tagSizeLimits = Settings().tagSizeLimits;
 };
 
 struct TaggedValue {
@@ -101,10 +137,72 @@ struct TaggedSummary {
 	size_type count = 0;
 	size_type totalSize = 0;
 };
+struct LatencyHistogram {
+	// Bucket i counts values in [2^i, 2^(i+1)) microseconds.
+	static constexpr auto kBucketsCount = 24;
+
+	void add(int64 microseconds);
+	int64 percentile(float64 part) const;
+	void merge(const LatencyHistogram &other);
+
+	std::array<size_type, kBucketsCount> buckets = { { 0 } };
+	size_type count = 0;
+};
+// Count-min sketch of entry access frequencies with periodic aging.
+class FrequencySketch {
+public:
+	void reserve(size_type count);
+	void increment(const Key &key);
+	int frequency(const Key &key) const;
+
+private:
+	static constexpr auto kDepth = 4;
+	static constexpr auto kMaxCounter = uint8(15);
+	static constexpr auto kMinimalWidth = size_type(64);
+	static constexpr auto kMaximalWidth = size_type(1024 * 1024);
+	static constexpr auto kAgingFactor = size_type(10);
+
+	size_type index(const Key &key, int row) const;
+	void grow(size_type width);
+	void halve();
+
+	std::vector<uint8> _counters; // kDepth rows, _width counters in each.
+	size_type _width = 0;
+	size_type _additions = 0;
+
+};
+
+struct LaneMetrics {
+	size_type depth = 0; // Requests waiting in the lane right now.
+	size_type peakDepth = 0;
+	size_type served = 0;
+	size_type promoted = 0; // Served before higher lanes not to starve.
+};
+struct Metrics {
+	size_type hits = 0;
+	size_type misses = 0;
+	base::flat_map<uint8, size_type> taggedHits;
+	LatencyHistogram getLatency;
+	LatencyHistogram putLatency;
+	int64 binlogBytesWritten = 0;
+	int64 dataBytesWritten = 0;
+	size_type compactionsCount = 0;
+	crl::time_type compactionsDuration = 0;
+	size_type prunesCount = 0;
+	size_type prunedEntries = 0;
+	int64 prunesDuration = 0; // In microseconds.
+	std::array<LaneMetrics, kPrioritiesCount> lanes;
+};
 struct Stats {
 	TaggedSummary full;
 	base::flat_map<uint8, TaggedSummary> tagged;
 	bool clearing = false;
+	int64 clearProcessed = 0;
+	int64 clearTotal = 0;
+	bool compacting = false;
+	int64 compactProcessed = 0;
+	int64 compactTotal = 0;
+	Metrics metrics;
 };
 
 using Version = int32;
@@ -154,6 +252,19 @@ struct EstimatedTimePoint {
 	}
 };
 
+struct SnapshotHeader {
+	static constexpr auto kFormat = uint32(1);
+
+	uint32 format = kFormat;
+	uint32 flags = 0;
+	uint32 count = 0;
+	uint32 reserved1 = 0;
+	int64 binlogOffset = 0;
+	int64 binlogExcessLength = 0;
+	EstimatedTimePoint time;
+	uint32 reserved2 = 0;
+};
+
 struct Store {
 	static constexpr auto kType = RecordType(0x01);
 
@@ -8,11 +8,16 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 #include "storage/file_download.h"
 
 #include "data/data_document.h"
+#include "data/data_peer.h"
 #include "data/data_session.h"
 #include "mainwidget.h"
 #include "mainwindow.h"
 #include "messenger.h"
 #include "storage/localstorage.h"
+#include "storage/cache/storage_cache_database.h"
+#include "storage/storage_streamed_file.h"
+#include "storage/storage_file_parts_writer.h"
+#include "storage/storage_shared_cache.h"
 #include "platform/platform_file_utilities.h"
 #include "auth_session.h"
 #include "apiwrap.h"
@@ -20,10 +25,25 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 #include "base/bytes.h"
 #include "base/openssl_help.h"
 
+#include <numeric>
+
 namespace Storage {
+namespace {
+
+// Keep at least as much requested as 16 parts of 128 KB did before.
+constexpr auto kMinRequestedAmount = int64(16 * 128 * 1024);
+constexpr auto kMaxRequestedAmount = int64(16 * 1024 * 1024);
+constexpr auto kSpeedWindow = TimeMs(1000);
+constexpr auto kMaxDownloadQueries = 48; // max 48 parts from all the dcs
+constexpr auto kPriorityWeights = std::array<float64, kLoadPrioritiesCount>{
+	{ 8., 4., 1. }
+};
+
+} // namespace
 
 Downloader::Downloader()
-: _delayedLoadersDestroyer([this] { _delayedDestroyedLoaders.clear(); }) {
+: _delayedLoadersDestroyer([this] { _delayedDestroyedLoaders.clear(); })
+, _localRequestsSender([this] { sendLocalRequests(); }) {
 }
 
 void Downloader::delayedDestroyLoader(std::unique_ptr<FileLoader> loader) {
@@ -43,6 +63,9 @@ void Downloader::requestedAmountIncrement(MTP::DcId dcId, int index, int amount)
 		it = _requestedBytesAmount.emplace(dcId, RequestedInDc { { 0 } }).first;
 	}
 	it->second[index] += amount;
+	if (amount > 0) {
+		_lastUsed[dcId] = getms(true);
+	}
 	if (it->second[index]) {
 		Messenger::Instance().killDownloadSessionsStop(dcId);
 	} else {
@@ -63,6 +86,169 @@ int Downloader::chooseDcIndexForRequest(MTP::DcId dcId) const {
 	return result;
 }
 
+std::vector<MTP::DcId> Downloader::recentlyUsedDcs(TimeMs period) const {
+	const auto now = getms(true);
+	auto result = std::vector<MTP::DcId>();
+	for (const auto &[dcId, used] : _lastUsed) {
+		if (used + period < now) {
+			continue;
+		}
+		const auto i = _requestedBytesAmount.find(dcId);
+		const auto idle = (i == _requestedBytesAmount.end())
+			|| ranges::all_of(i->second, [](int64 amount) {
+				return !amount;
+			});
+		if (idle) {
+			result.push_back(dcId);
+		}
+	}
+	return result;
+}
+
+void Downloader::requestSucceeded(
+		MTP::DcId dcId,
+		int amount,
+		TimeMs sent) {
+	const auto now = getms(true);
+	auto &speed = _speeds[dcId];
+	const auto duration = float64(std::max(now - sent, TimeMs(1)));
+	speed.roundTrip = (speed.roundTrip > 0.)
+		? (speed.roundTrip * 7. + duration) / 8.
+		: duration;
+
+	// Don't count the time when nothing was requested from the dc.
+	if (!speed.windowStart || sent > speed.lastReceived + kSpeedWindow) {
+		speed.windowStart = sent;
+		speed.windowAmount = 0;
+	}
+	speed.lastReceived = now;
+	speed.windowAmount += amount;
+	const auto passed = now - speed.windowStart;
+	if (passed >= kSpeedWindow) {
+		const auto current = float64(speed.windowAmount) / passed;
+		speed.throughput = (speed.throughput > 0.)
+			? (speed.throughput * 3. + current) / 4.
+			: current;
+		speed.windowStart = now;
+		speed.windowAmount = 0;
+	}
+}
+
+int64 Downloader::requestedAmountLimit(MTP::DcId dcId) const {
+	const auto i = _speeds.find(dcId);
+	if (i == end(_speeds) || i->second.throughput <= 0.) {
+		return kMinRequestedAmount;
+	}
+	const auto product = i->second.throughput * i->second.roundTrip;
+	return snap(int64(product * 2), kMinRequestedAmount, kMaxRequestedAmount);
+}
+
+bool Downloader::canRequestMore(MTP::DcId dcId) const {
+	const auto i = _requestedBytesAmount.find(dcId);
+	if (i == end(_requestedBytesAmount)) {
+		return true;
+	}
+	const auto requested = std::accumulate(
+		begin(i->second),
+		end(i->second),
+		int64(0));
+	return (requested < requestedAmountLimit(dcId));
+}
+
+void Downloader::queryStarted(LoadPriority priority, int amount) {
+	const auto index = static_cast<int>(priority);
+	auto &queries = _priorityQueries[index];
+	if (!queries.count) {
+		// Idle priorities don't save up the bandwidth for later.
+		queries.virtualTime = effectiveVirtualTime(queries);
+	}
+	++queries.count;
+	++_queriesCount;
+	queries.virtualTime += amount / kPriorityWeights[index];
+}
+
+void Downloader::queryFinished(LoadPriority priority) {
+	auto &queries = _priorityQueries[static_cast<int>(priority)];
+	Assert(queries.count > 0);
+
+	--queries.count;
+	--_queriesCount;
+}
+
+bool Downloader::canStartQuery() const {
+	return (_queriesCount < kMaxDownloadQueries);
+}
+
+auto Downloader::scheduleOrder() const
+-> std::array<LoadPriority, kLoadPrioritiesCount> {
+	auto result = std::array<LoadPriority, kLoadPrioritiesCount>();
+	for (auto i = 0; i != kLoadPrioritiesCount; ++i) {
+		result[i] = static_cast<LoadPriority>(i);
+	}
+	const auto time = [&](LoadPriority priority) {
+		const auto index = static_cast<int>(priority);
+		return effectiveVirtualTime(_priorityQueries[index]);
+	};
+	std::stable_sort(begin(result), end(result), [&](
+			LoadPriority a,
+			LoadPriority b) {
+		return time(a) < time(b);
+	});
+	return result;
+}
+
+float64 Downloader::activeVirtualTime() const {
+	auto result = std::optional<float64>();
+	auto maximal = 0.;
+	for (const auto &queries : _priorityQueries) {
+		if (queries.count && (!result || queries.virtualTime < *result)) {
+			result = queries.virtualTime;
+		}
+		accumulate_max(maximal, queries.virtualTime);
+	}
+	return result.value_or(maximal);
+}
+
+float64 Downloader::effectiveVirtualTime(
+		const PriorityQueries &queries) const {
+	return queries.count
+		? queries.virtualTime
+		: std::max(queries.virtualTime, activeVirtualTime());
+}
+
+void Downloader::requestLocal(
+		const Cache::Key &key,
+		FnMut<void(QByteArray&&)> &&done) {
+	_localRequests.push_back({ key, std::move(done) });
+	_localRequestsSender.call();
+}
+
+void Downloader::sendLocalRequests() {
+	if (_localRequests.empty()) {
+		return;
+	}
+	auto requests = base::take(_localRequests);
+	auto keys = std::vector<Cache::Key>();
+	auto callbacks = std::vector<FnMut<void(QByteArray&&)>>();
+	keys.reserve(requests.size());
+	callbacks.reserve(requests.size());
+	for (auto &request : requests) {
+		keys.push_back(request.key);
+		callbacks.push_back(std::move(request.done));
+	}
+	Auth().data().cache().getMany(std::move(keys), [
+		callbacks = std::move(callbacks)
+	](std::vector<Cache::Database::TaggedValue> &&values) mutable {
+		Expects(values.size() == callbacks.size());
+
+		for (auto i = 0, count = int(values.size()); i != count; ++i) {
+			if (callbacks[i]) {
+				callbacks[i](std::move(values[i].bytes));
+			}
+		}
+	});
+}
+
 Downloader::~Downloader() {
 	// The file loaders have pointer to downloader and they cancel
 	// requests in destructor where they use that pointer, so all
@@ -76,9 +262,38 @@ namespace {
 
 constexpr auto kDownloadPhotoPartSize = 64 * 1024; // 64kb for photo
 constexpr auto kDownloadDocumentPartSize = 128 * 1024; // 128kb for document
-constexpr auto kMaxFileQueries = 16; // max 16 file parts downloaded at the same time
+constexpr auto kDownloadMaxPartSize = 512 * 1024; // 512kb is the server limit
+constexpr auto kMaxFileQueries = 32; // max 32 file parts downloaded at the same time
+constexpr auto kPartSizeGrowQueries = 16; // grow part size if we need more parts
 constexpr auto kMaxWebFileQueries = 8; // max 8 http[s] files downloaded at the same time
 constexpr auto kDownloadCdnPartSize = 128 * 1024; // 128kb for cdn requests
+constexpr auto kStreamedPartSize = kDownloadCdnPartSize; // same as cache keys
+constexpr auto kStreamedAheadLimit = 8 * 1024 * 1024; // cancel farther on seek
+constexpr auto kResumeStateVersion = 1;
+constexpr auto kResumeStateSaveStep = 2 * 1024 * 1024; // save each 2 MB written
+constexpr auto kMaxPendingWritesSize = 8 * 1024 * 1024; // throttle loading
+
+// Returns the bytes of upload.file pointing inside the response buffer.
+bytes::const_span ReadFilePartBytes(const mtpPrime *from, const mtpPrime *end) {
+	constexpr auto kBytesPosition = 3; // type, storage.FileType, mtime
+
+	if (end - from < kBytesPosition + 1) {
+		throw mtpErrorInsufficient();
+	}
+	const auto buffer = reinterpret_cast<const uchar*>(from + kBytesPosition);
+	const auto large = (buffer[0] == 254);
+	const auto length = large
+		? (uint32(buffer[1])
+			| (uint32(buffer[2]) << 8)
+			| (uint32(buffer[3]) << 16))
+		: uint32(buffer[0]);
+	const auto skip = large ? 4 : 1;
+	const auto available = (end - from - kBytesPosition) * sizeof(mtpPrime);
+	if (skip + length > available) {
+		throw mtpErrorInsufficient();
+	}
+	return bytes::make_span(buffer + skip, length);
+}
 
 } // namespace
 
@@ -166,15 +381,28 @@ QImage FileLoader::imageData(const QSize &shrinkBox) const {
 	return _imageData;
 }
 
+QImage FileLoader::ReadImage(
+		const QByteArray &data,
+		const QSize &shrinkBox,
+		QByteArray *format) {
+	auto image = App::readImage(data, format, false);
+	if (!image.isNull()
+		&& !shrinkBox.isEmpty()
+		&& (image.width() > shrinkBox.width()
+			|| image.height() > shrinkBox.height())) {
+		return image.scaled(
+			shrinkBox,
+			Qt::KeepAspectRatio,
+			Qt::SmoothTransformation);
+	}
+	return image;
+}
+
 void FileLoader::readImage(const QSize &shrinkBox) const {
 	auto format = QByteArray();
-	auto image = App::readImage(_data, &format, false);
+	auto image = ReadImage(_data, shrinkBox, &format);
 	if (!image.isNull()) {
-		if (!shrinkBox.isEmpty() && (image.width() > shrinkBox.width() || image.height() > shrinkBox.height())) {
-			_imageData = image.scaled(shrinkBox, Qt::KeepAspectRatio, Qt::SmoothTransformation);
-		} else {
-			_imageData = std::move(image);
-		}
+		_imageData = std::move(image);
 		_imageFormat = format;
 	}
 }
@@ -203,7 +431,9 @@ void FileLoader::permitLoadFromCloud() {
 }
 
 void FileLoader::loadNext() {
-	if (_queue->queriesCount >= _queue->queriesLimit) {
+	if (_queue != &_webQueue) {
+		return LoadNextParts(_downloader);
+	} else if (_queue->queriesCount >= _queue->queriesLimit) {
 		return;
 	}
 	for (auto i = _queue->start; i;) {
@@ -217,6 +447,63 @@ void FileLoader::loadNext() {
 	}
 }
 
+void FileLoader::LoadNextParts(not_null<Storage::Downloader*> downloader) {
+	while (downloader->canStartQuery() && LoadNextPart(downloader)) {
+	}
+
+	// Each preemption gives a part to one of the starving loaders.
+	while (PreemptForStarving()) {
+	}
+}
+
+bool FileLoader::LoadNextPart(not_null<Storage::Downloader*> downloader) {
+	for (const auto priority : downloader->scheduleOrder()) {
+		for (auto &queue : queues) {
+			if (queue.queriesCount >= queue.queriesLimit) {
+				continue;
+			}
+			for (auto i = queue.start; i; i = i->_next) {
+				if (i->_loadPriority == priority && i->loadPart()) {
+					return true;
+				}
+			}
+		}
+	}
+	return false;
+}
+
+bool FileLoader::PreemptForStarving() {
+	for (auto &queue : queues) {
+		for (auto i = queue.start; i; i = i->_next) {
+			if (i->_loadPriority == Storage::LoadPriority::Autoload
+				|| !i->starving()) {
+				continue;
+			}
+			if (PreemptAutoloadPart(queue)) {
+				return i->loadPart();
+			} else if (queue.queriesCount < queue.queriesLimit) {
+				// Only the global limit is reached, any dc will do.
+				for (auto &other : queues) {
+					if (PreemptAutoloadPart(other)) {
+						return i->loadPart();
+					}
+				}
+			}
+		}
+	}
+	return false;
+}
+
+bool FileLoader::PreemptAutoloadPart(FileLoaderQueue &queue) {
+	for (auto i = queue.start; i; i = i->_next) {
+		if (i->_loadPriority == Storage::LoadPriority::Autoload
+			&& i->preemptPart()) {
+			return true;
+		}
+	}
+	return false;
+}
+
 void FileLoader::removeFromQueue() {
 	if (!_inQueue) return;
 	if (_next) {
@@ -250,6 +537,9 @@ void FileLoader::localLoaded(
 		const QImage &imageData) {
 	_localLoading.kill();
 	if (result.data.isEmpty()) {
+		if (tryLoadShared()) {
+			return;
+		}
 		_localStatus = LocalStatus::NotFound;
 		start(true);
 		return;
@@ -372,7 +662,7 @@ void FileLoader::start(bool loadFirst, bool prior) {
 	return startLoading(loadFirst, prior);
 }
 
-void FileLoader::loadLocal(const Storage::Cache::Key &key) {
+void FileLoader::loadLocal(const Storage::Cache::Key &key, bool shared) {
 	const auto readImage = (_locationType != AudioFileLocation);
 	auto [first, second] = base::make_binary_guard();
 	_localLoading = std::move(first);
@@ -396,7 +686,7 @@ void FileLoader::loadLocal(const Storage::Cache::Key &key) {
 				std::move(image));
 		});
 	};
-	Auth().data().cache().get(key, [=, callback = std::move(done)](
+	auto request = [=, callback = std::move(done)](
 			QByteArray &&value) mutable {
 		if (readImage) {
 			crl::async([
@@ -417,7 +707,12 @@ void FileLoader::loadLocal(const Storage::Cache::Key &key) {
 		} else {
 			callback(std::move(value), {}, {});
 		}
-	});
+	};
+	if (shared) {
+		Auth().data().sharedCache()->get(key, std::move(request));
+	} else {
+		_downloader->requestLocal(key, std::move(request));
+	}
 }
 
 bool FileLoader::tryLoadLocal() {
@@ -429,8 +724,10 @@ bool FileLoader::tryLoadLocal() {
 	}
 
 	if (const auto key = cacheKey()) {
-		loadLocal(*key);
+		loadLocal(*key, false);
 		emit progress(this);
+	} else {
+		loadResumeState();
 	}
 
 	if (_localStatus != LocalStatus::NotTried) {
@@ -443,6 +740,18 @@ bool FileLoader::tryLoadLocal() {
 	return false;
 }
 
+bool FileLoader::tryLoadShared() {
+	if (_sharedTried) {
+		return false;
+	}
+	_sharedTried = true;
+	if (const auto key = sharedCacheKey()) {
+		loadLocal(*key, true);
+		return true;
+	}
+	return false;
+}
+
 void FileLoader::cancel() {
 	cancel(false);
 }
@@ -473,7 +782,19 @@ void FileLoader::cancel(bool fail) {
 }
 
 void FileLoader::startLoading(bool loadFirst, bool prior) {
-	if ((_queue->queriesCount >= _queue->queriesLimit && (!loadFirst || !prior)) || _finished) {
+	if (_finished) {
+		return;
+	} else if (_queue != &_webQueue) {
+		_loadPriority = ((loadFirst && prior) || streaming())
+			? Storage::LoadPriority::Visible
+			: _autoLoading
+			? Storage::LoadPriority::Autoload
+			: Storage::LoadPriority::UserInitiated;
+		if (loadFirst && prior) {
+			loadPart(); // Visible files don't wait for the free queries.
+		}
+		return LoadNextParts(_downloader);
+	} else if (_queue->queriesCount >= _queue->queriesLimit && (!loadFirst || !prior)) {
 		return;
 	}
 	loadPart();
@@ -588,13 +909,18 @@ mtpFileLoader::mtpFileLoader(
 }
 
 int32 mtpFileLoader::currentOffset(bool includeSkipped) const {
-	return (_fileIsOpen ? _file.size() : _data.size()) - (includeSkipped ? 0 : _skippedBytes);
+	return (_fileIsOpen ? _fileSize : _data.size()) - (includeSkipped ? 0 : _skippedBytes);
 }
 
 Data::FileOrigin mtpFileLoader::fileOrigin() const {
 	return _origin;
 }
 
+QByteArray mtpFileLoader::partialBytes() const {
+	// Parts may be received out of order, the bytes after a gap are useless.
+	return (_fileIsOpen || _finished || _skippedBytes) ? QByteArray() : _data;
+}
+
 void mtpFileLoader::refreshFileReferenceFrom(
 		const Data::UpdatedFileReferences &data,
 		int requestId,
@@ -619,53 +945,348 @@ void mtpFileLoader::refreshFileReferenceFrom(
 	} else {
 		_fileReference = updated;
 	}
-	const auto offset = finishSentRequestGetOffset(requestId);
-	makeRequest(offset);
+	if (_sentRequests.find(requestId) == end(_sentRequests)) {
+		return; // The part was preempted while refreshing the reference.
+	}
+	const auto request = finishSentRequest(requestId);
+	makeRequest(request.offset, request.limit);
 }
 
 bool mtpFileLoader::loadPart() {
-	if (_finished || _lastComplete || (!_sentRequests.empty() && !_size)) {
+	if (_finished || writesThrottled()) {
+		return false;
+	} else if (_streamed) {
+		return loadStreamedPart();
+	} else if (!_sentRequests.empty()
+		&& !_downloader->canRequestMore(_cdnDcId ? _cdnDcId : _dcId)) {
+		return false;
+	} else if (!_preemptedParts.empty()) {
+		const auto [offset, limit] = *begin(_preemptedParts);
+		_preemptedParts.erase(begin(_preemptedParts));
+		makeRequest(offset, limit);
+		return true;
+	} else if (_lastComplete || (!_sentRequests.empty() && !_size)) {
 		return false;
 	} else if (_size && _nextRequestOffset >= _size) {
 		return false;
 	}
 
-	makeRequest(_nextRequestOffset);
-	_nextRequestOffset += partSize();
+	const auto limit = partSize();
+	makeRequest(_nextRequestOffset, limit);
+	_nextRequestOffset += limit;
 	return true;
 }
 
+bool mtpFileLoader::starving() const {
+	if (_finished || !_sentRequests.empty() || writesThrottled()) {
+		return false;
+	} else if (_streamed) {
+		return (_streamedCacheLoading < 0) && (nextStreamedPart() >= 0);
+	} else if (!_preemptedParts.empty()) {
+		return true;
+	}
+	return !_lastComplete && (!_size || _nextRequestOffset < _size);
+}
+
+bool mtpFileLoader::preemptPart() {
+	if (!_size) {
+		return false;
+	}
+
+	// Cancel the farthest part, it will be needed the last.
+	auto farthest = end(_sentRequests);
+	for (auto i = begin(_sentRequests); i != end(_sentRequests); ++i) {
+		if (i->first != _cdnHashesRequestId
+			&& (farthest == end(_sentRequests)
+				|| i->second.offset > farthest->second.offset)) {
+			farthest = i;
+		}
+	}
+	if (farthest == end(_sentRequests)) {
+		return false;
+	}
+	const auto requestId = farthest->first;
+	MTP::cancel(requestId);
+	const auto request = finishSentRequest(requestId);
+	if (!_streamed) {
+		_preemptedParts.emplace(request.offset, request.limit);
+	}
+	return true;
+}
+
+bool mtpFileLoader::streaming() const {
+	return (_streamed != nullptr);
+}
+
+std::shared_ptr<Storage::StreamedFile> mtpFileLoader::stream() {
+	if (_streamed) {
+		return _streamed;
+	} else if (_finished || !_size || !_id) {
+		return nullptr;
+	}
+	_streamed = std::make_shared<Storage::StreamedFile>(_size);
+	_streamed->wanted(
+	) | rpl::start_with_next([=](int offset) {
+		streamFrom(offset);
+	}, _streamLifetime);
+
+	// Parts before the streaming were requested one after another.
+	// Preempted ones are requested again in the streaming order.
+	const auto preempted = [&](int offset) {
+		const auto i = _preemptedParts.upper_bound(offset);
+		return (i != begin(_preemptedParts))
+			&& (offset < std::prev(i)->first + std::prev(i)->second);
+	};
+	const auto till = std::min(_nextRequestOffset, _size);
+	for (auto offset = 0; offset < till; offset += kStreamedPartSize) {
+		if (!streamedPartPending(offset) && !preempted(offset)) {
+			_streamedParts.emplace(offset);
+		}
+	}
+	_preemptedParts.clear();
+	_loadPriority = Storage::LoadPriority::Visible;
+	loadNext();
+	return _streamed;
+}
+
+bool mtpFileLoader::loadStreamedPart() {
+	if (!_sentRequests.empty()
+		&& !_downloader->canRequestMore(_cdnDcId ? _cdnDcId : _dcId)) {
+		return false;
+	}
+	const auto offset = nextStreamedPart();
+	if (offset < 0) {
+		return false;
+	} else if (cacheStreamedParts()
+		&& !_streamedCacheChecked.contains(offset)) {
+		if (_streamedCacheLoading >= 0) {
+			return false;
+		}
+		loadStreamedFromCache(offset);
+		return true;
+	}
+	makeRequest(offset, kStreamedPartSize);
+	return true;
+}
+
+int mtpFileLoader::streamedPartsCount() const {
+	return (_size + kStreamedPartSize - 1) / kStreamedPartSize;
+}
+
+bool mtpFileLoader::streamedPartPending(int offset) const {
+	const auto covers = [&](int from, int size) {
+		return (offset >= from) && (offset < from + size);
+	};
+	for (const auto &[requestId, request] : _sentRequests) {
+		if (requestId != _cdnHashesRequestId
+			&& covers(request.offset, request.limit)) {
+			return true;
+		}
+	}
+	for (const auto &[partOffset, data] : _cdnUncheckedParts) {
+		if (covers(partOffset, data.size())) {
+			return true;
+		}
+	}
+	return (offset == _streamedCacheLoading);
+}
+
+int mtpFileLoader::nextStreamedPart() const {
+	// Look for the first missing part after the read position,
+	// wrap around to the beginning when everything after it is loaded.
+	const auto count = streamedPartsCount();
+	const auto from = _streamPosition / kStreamedPartSize;
+	for (auto i = 0; i != count; ++i) {
+		const auto offset = ((from + i) % count) * kStreamedPartSize;
+		if (!_streamedParts.contains(offset)
+			&& !streamedPartPending(offset)) {
+			return offset;
+		}
+	}
+	return -1;
+}
+
+bool mtpFileLoader::cacheStreamedParts() const {
+	// Small files are put to the cache as a whole when they're loaded.
+	return (_toCache != LoadToCacheAsWell)
+		|| (_size > Storage::kMaxFileInMemory);
+}
+
+void mtpFileLoader::loadStreamedFromCache(int offset) {
+	_streamedCacheLoading = offset;
+	auto [first, second] = base::make_binary_guard();
+	_streamedCacheGuard = std::move(first);
+	_downloader->requestLocal(
+		Data::DocumentPartCacheKey(_dcId, _id, offset),
+		[=, guard = std::move(second)](QByteArray &&value) mutable {
+		crl::on_main([
+			=,
+			value = std::move(value),
+			guard = std::move(guard)
+		]() mutable {
+			if (guard.alive()) {
+				streamedCacheLoaded(offset, std::move(value));
+			}
+		});
+	});
+}
+
+void mtpFileLoader::streamedCacheLoaded(int offset, QByteArray &&value) {
+	_streamedCacheLoading = -1;
+	_streamedCacheChecked.emplace(offset);
+	if (value.size() != std::min(kStreamedPartSize, _size - offset)) {
+		loadNext();
+		return;
+	}
+
+	// Mark it loaded before feeding, so that it is not put to the cache.
+	_streamedParts.emplace(offset);
+	partLoaded(offset, bytes::make_span(value));
+}
+
+void mtpFileLoader::feedStreamed(int offset, bytes::const_span buffer) {
+	Expects(_streamed != nullptr);
+
+	_streamed->supply(offset, QByteArray(
+		reinterpret_cast<const char*>(buffer.data()),
+		buffer.size()));
+
+	const auto cache = cacheStreamedParts();
+	for (auto part = 0; part < buffer.size(); part += kStreamedPartSize) {
+		const auto partOffset = offset + part;
+		if (_streamedParts.contains(partOffset)) {
+			continue;
+		}
+		_streamedParts.emplace(partOffset);
+		if (!cache) {
+			continue;
+		}
+		const auto data = buffer.subspan(
+			part,
+			std::min(int(buffer.size()) - part, kStreamedPartSize));
+		Auth().data().cache().put(
+			Data::DocumentPartCacheKey(_dcId, _id, partOffset),
+			Storage::Cache::Database::TaggedValue(
+				QByteArray(
+					reinterpret_cast<const char*>(data.data()),
+					data.size()),
+				_cacheTag));
+	}
+}
+
+void mtpFileLoader::streamFrom(int offset) {
+	if (_finished) {
+		return;
+	}
+	_streamPosition = offset - (offset % kStreamedPartSize);
+	if (_streamedParts.contains(_streamPosition)) {
+		supplyStreamed(_streamPosition);
+	} else if (!streamedPartPending(_streamPosition)) {
+		cancelFarStreamedRequests();
+	}
+	loadNext();
+}
+
+void mtpFileLoader::supplyStreamed(int offset) {
+	// The part was loaded, but the stream has thrown it out of memory.
+	const auto size = std::min(kStreamedPartSize, _size - offset);
+	auto result = QByteArray();
+	if (_fileIsOpen) {
+		if (!waitForWrites()) {
+			return;
+		}
+		_file.flush();
+		QFile file(_filename);
+		if (file.open(QIODevice::ReadOnly) && file.seek(offset)) {
+			result = file.read(size);
+		}
+	} else if (_data.size() >= offset + size) {
+		result = _data.mid(offset, size);
+	}
+	if (result.size() == size) {
+		_streamed->supply(offset, std::move(result));
+	} else {
+		_streamedParts.remove(offset);
+		_streamedCacheChecked.remove(offset);
+	}
+}
+
+void mtpFileLoader::cancelFarStreamedRequests() {
+	auto far = std::vector<mtpRequestId>();
+	for (const auto &[requestId, request] : _sentRequests) {
+		const auto ahead = request.offset - _streamPosition;
+		if (requestId != _cdnHashesRequestId
+			&& (ahead < 0 || ahead >= kStreamedAheadLimit)) {
+			far.push_back(requestId);
+		}
+	}
+	for (const auto requestId : far) {
+		MTP::cancel(requestId);
+		finishSentRequest(requestId);
+	}
+}
+
 int mtpFileLoader::partSize() const {
-	return kDownloadCdnPartSize;
-
-	// Different part sizes are not supported for now :(
-	// Because we start downloading with some part size
-	// and then we get a cdn-redirect where we support only
-	// fixed part size download for hash checking.
-	//
-	//if (_cdnDcId) {
-	//	return kDownloadCdnPartSize;
-	//} else if (_locationType == UnknownFileLocation) {
-	//	return kDownloadPhotoPartSize;
-	//}
-	//return kDownloadDocumentPartSize;
-}
-
-mtpFileLoader::RequestData mtpFileLoader::prepareRequest(int offset) const {
+	// CDN file hashes are provided for fixed size parts only.
+	return (_cdnDcId || !_partSize) ? kDownloadCdnPartSize : _partSize;
+}
+
+bool mtpFileLoader::adaptivePartSize() const {
+	return _size
+		&& !_cdnDcId
+		&& !_location
+		&& !_urlLocation
+		&& !_geoLocation;
+}
+
+void mtpFileLoader::adjustPartSize(MTP::DcId dcId) {
+	if (!adaptivePartSize()) {
+		return;
+	}
+	const auto current = partSize();
+	const auto larger = current * 2;
+	if (larger > kDownloadMaxPartSize
+		|| (_nextRequestOffset % larger) != 0
+		|| (_size - _nextRequestOffset) < larger * kPartSizeGrowQueries) {
+		return;
+	}
+
+	// Offsets stay aligned by the part size, so that parts never cross
+	// a 1 MB boundary and CDN hashes still match if we get redirected.
+	const auto limit = _downloader->requestedAmountLimit(dcId);
+	if (limit >= int64(larger) * kPartSizeGrowQueries) {
+		_partSize = larger;
+	}
+}
+
+mtpFileLoader::RequestData mtpFileLoader::prepareRequest(
+		int offset,
+		int limit) const {
 	auto result = RequestData();
 	result.dcId = _cdnDcId ? _cdnDcId : _dcId;
 	result.dcIndex = _size ? _downloader->chooseDcIndexForRequest(result.dcId) : 0;
 	result.offset = offset;
+	result.limit = limit;
 	return result;
 }
 
-void mtpFileLoader::makeRequest(int offset) {
+void mtpFileLoader::makeRequest(int offset, int limit) {
 	Expects(!_finished);
 
-	auto requestData = prepareRequest(offset);
+	if (_cdnDcId && limit > kDownloadCdnPartSize) {
+		// Resending a larger part after a redirect to CDN.
+		for (auto part = 0; part < limit; part += kDownloadCdnPartSize) {
+			if (_size && offset + part >= _size) {
+				break;
+			}
+			makeRequest(offset + part, kDownloadCdnPartSize);
+		}
+		return;
+	}
+	auto requestData = prepareRequest(offset, limit);
 	auto send = [this, &requestData] {
 		auto offset = requestData.offset;
-		auto limit = partSize();
+		auto limit = requestData.limit;
 		auto shiftedDcId = MTP::downloadDcId(requestData.dcId, requestData.dcIndex);
 		if (_cdnDcId) {
 			Assert(requestData.dcId == _cdnDcId);
@@ -717,7 +1338,7 @@ void mtpFileLoader::makeRequest(int offset) {
 					computeLocation(),
 					MTP_int(offset),
 					MTP_int(limit)),
-				rpcDone(&mtpFileLoader::normalPartLoaded),
+				rpcDone(&mtpFileLoader::normalPartLoadedBare),
 				rpcFail(&mtpFileLoader::partFailed),
 				shiftedDcId,
 				50);
@@ -756,6 +1377,7 @@ void mtpFileLoader::requestMoreCdnFileHashes() {
 	requestData.dcId = _dcId;
 	requestData.dcIndex = 0;
 	requestData.offset = offset;
+	requestData.limit = partSize();
 	auto shiftedDcId = MTP::downloadDcId(requestData.dcId, requestData.dcIndex);
 	auto requestId = _cdnHashesRequestId = MTP::send(
 		MTPupload_GetCdnFileHashes(
@@ -773,12 +1395,33 @@ void mtpFileLoader::normalPartLoaded(
 	Expects(!_finished);
 	Expects(result.type() == mtpc_upload_fileCdnRedirect || result.type() == mtpc_upload_file);
 
-	auto offset = finishSentRequestGetOffset(requestId);
+	const auto request = finishSentRequest(requestId);
 	if (result.type() == mtpc_upload_fileCdnRedirect) {
-		return switchToCDN(offset, result.c_upload_fileCdnRedirect());
+		return switchToCDN(request, result.c_upload_fileCdnRedirect());
 	}
 	auto buffer = bytes::make_span(result.c_upload_file().vbytes.v);
-	return partLoaded(offset, buffer);
+	_downloader->requestSucceeded(request.dcId, buffer.size(), request.sent);
+	adjustPartSize(request.dcId);
+	return partLoaded(request.offset, buffer);
+}
+
+void mtpFileLoader::normalPartLoadedBare(
+		const mtpPrime *from,
+		const mtpPrime *end,
+		mtpRequestId requestId) {
+	// Parts are fed straight from the response, without copying them.
+	if (from == end || mtpTypeId(*from) != mtpc_upload_file) {
+		auto result = MTPupload_File();
+		result.read(from, end);
+		return normalPartLoaded(result, requestId);
+	}
+	Expects(!_finished);
+
+	const auto buffer = ReadFilePartBytes(from, end);
+	const auto request = finishSentRequest(requestId);
+	_downloader->requestSucceeded(request.dcId, buffer.size(), request.sent);
+	adjustPartSize(request.dcId);
+	return partLoaded(request.offset, buffer);
 }
 
 void mtpFileLoader::webPartLoaded(
@@ -786,7 +1429,8 @@ void mtpFileLoader::webPartLoaded(
 		mtpRequestId requestId) {
 	Expects(result.type() == mtpc_upload_webFile);
 
-	auto offset = finishSentRequestGetOffset(requestId);
+	const auto request = finishSentRequest(requestId);
+	const auto offset = request.offset;
 	auto &webFile = result.c_upload_webFile();
 	if (!_size) {
 		_size = webFile.vsize.v;
@@ -795,47 +1439,84 @@ void mtpFileLoader::webPartLoaded(
 		return cancel(true);
 	}
 	auto buffer = bytes::make_span(webFile.vbytes.v);
+	_downloader->requestSucceeded(request.dcId, buffer.size(), request.sent);
 	return partLoaded(offset, buffer);
 }
 
 void mtpFileLoader::cdnPartLoaded(const MTPupload_CdnFile &result, mtpRequestId requestId) {
 	Expects(!_finished);
 
-	auto offset = finishSentRequestGetOffset(requestId);
+	const auto request = finishSentRequest(requestId);
+	const auto offset = request.offset;
 	if (result.type() == mtpc_upload_cdnFileReuploadNeeded) {
 		auto requestData = RequestData();
 		requestData.dcId = _dcId;
 		requestData.dcIndex = 0;
 		requestData.offset = offset;
+		requestData.limit = request.limit;
 		auto shiftedDcId = MTP::downloadDcId(requestData.dcId, requestData.dcIndex);
 		auto requestId = MTP::send(MTPupload_ReuploadCdnFile(MTP_bytes(_cdnToken), result.c_upload_cdnFileReuploadNeeded().vrequest_token), rpcDone(&mtpFileLoader::reuploadDone), rpcFail(&mtpFileLoader::cdnPartFailed), shiftedDcId);
 		placeSentRequest(requestId, requestData);
 		return;
 	}
 	Expects(result.type() == mtpc_upload_cdnFile);
+	Expects(_cdnEncryptionKey.size() == MTP::CTRState::KeySize);
+	Expects(_cdnEncryptionIV.size() == MTP::CTRState::IvecSize);
+
+	const auto &encrypted = result.c_upload_cdnFile().vbytes.v;
+	_downloader->requestSucceeded(
+		request.dcId,
+		encrypted.size(),
+		request.sent);
+
+	// Decryption and hashing are done in the background, the part is
+	// counted as pending until it is fed to the loader.
+	++_cdnDecryptingParts;
+	crl::async([
+		=,
+		guard = QPointer<mtpFileLoader>(this),
+		key = _cdnEncryptionKey,
+		iv = _cdnEncryptionIV,
+		decryptInPlace = encrypted
+	]() mutable {
+		auto state = MTP::CTRState();
+		auto ivec = bytes::make_span(state.ivec);
+		bytes::copy(ivec, bytes::make_span(iv));
+
+		auto counterOffset = static_cast<uint32>(offset) >> 4;
+		state.ivec[15] = static_cast<uchar>(counterOffset & 0xFF);
+		state.ivec[14] = static_cast<uchar>((counterOffset >> 8) & 0xFF);
+		state.ivec[13] = static_cast<uchar>((counterOffset >> 16) & 0xFF);
+		state.ivec[12] = static_cast<uchar>((counterOffset >> 24) & 0xFF);
+
+		auto buffer = bytes::make_detached_span(decryptInPlace);
+		MTP::aesCtrEncrypt(
+			buffer,
+			bytes::make_span(key).data(),
+			&state);
+		auto hash = openssl::Sha256(buffer);
+		crl::on_main(guard, [
+			=,
+			decrypted = std::move(decryptInPlace),
+			hash = std::move(hash)
+		] {
+			cdnPartDecrypted(offset, decrypted, hash);
+		});
+	});
+}
 
-	auto key = bytes::make_span(_cdnEncryptionKey);
-	auto iv = bytes::make_span(_cdnEncryptionIV);
-	Expects(key.size() == MTP::CTRState::KeySize);
-	Expects(iv.size() == MTP::CTRState::IvecSize);
-
-	auto state = MTP::CTRState();
-	auto ivec = bytes::make_span(state.ivec);
-	std::copy(iv.begin(), iv.end(), ivec.begin());
-
-	auto counterOffset = static_cast<uint32>(offset) >> 4;
-	state.ivec[15] = static_cast<uchar>(counterOffset & 0xFF);
-	state.ivec[14] = static_cast<uchar>((counterOffset >> 8) & 0xFF);
-	state.ivec[13] = static_cast<uchar>((counterOffset >> 16) & 0xFF);
-	state.ivec[12] = static_cast<uchar>((counterOffset >> 24) & 0xFF);
-
-	auto decryptInPlace = result.c_upload_cdnFile().vbytes.v;
-	auto buffer = bytes::make_detached_span(decryptInPlace);
-	MTP::aesCtrEncrypt(buffer, key.data(), &state);
-
-	switch (checkCdnFileHash(offset, buffer)) {
+void mtpFileLoader::cdnPartDecrypted(
+		int offset,
+		const QByteArray &decrypted,
+		const bytes::vector &hash) {
+	--_cdnDecryptingParts;
+	if (_finished) {
+		return;
+	}
+	const auto buffer = bytes::make_span(decrypted);
+	switch (checkCdnFileHashValue(offset, hash)) {
 	case CheckCdnHashResult::NoHash: {
-		_cdnUncheckedParts.emplace(offset, decryptInPlace);
+		_cdnUncheckedParts.emplace(offset, decrypted);
 		requestMoreCdnFileHashes();
 	} return;
 
@@ -846,15 +1527,23 @@ void mtpFileLoader::cdnPartLoaded(const MTPupload_CdnFile &result, mtpRequestId
 
 	case CheckCdnHashResult::Good: return partLoaded(offset, buffer);
 	}
-	Unexpected("Result of checkCdnFileHash()");
+	Unexpected("Result of checkCdnFileHashValue()");
 }
 
 mtpFileLoader::CheckCdnHashResult mtpFileLoader::checkCdnFileHash(int offset, bytes::const_span buffer) {
+	if (_cdnFileHashes.find(offset) == _cdnFileHashes.cend()) {
+		return CheckCdnHashResult::NoHash;
+	}
+	return checkCdnFileHashValue(offset, openssl::Sha256(buffer));
+}
+
+mtpFileLoader::CheckCdnHashResult mtpFileLoader::checkCdnFileHashValue(
+		int offset,
+		bytes::const_span realHash) {
 	auto cdnFileHashIt = _cdnFileHashes.find(offset);
 	if (cdnFileHashIt == _cdnFileHashes.cend()) {
 		return CheckCdnHashResult::NoHash;
 	}
-	auto realHash = openssl::Sha256(buffer);
 	if (bytes::compare(realHash, bytes::make_span(cdnFileHashIt->second.hash))) {
 		return CheckCdnHashResult::Invalid;
 	}
@@ -862,9 +1551,9 @@ mtpFileLoader::CheckCdnHashResult mtpFileLoader::checkCdnFileHash(int offset, by
 }
 
 void mtpFileLoader::reuploadDone(const MTPVector<MTPFileHash> &result, mtpRequestId requestId) {
-	auto offset = finishSentRequestGetOffset(requestId);
+	const auto request = finishSentRequest(requestId);
 	addCdnHashes(result.v);
-	makeRequest(offset);
+	makeRequest(request.offset, request.limit);
 }
 
 void mtpFileLoader::getCdnFileHashesDone(const MTPVector<MTPFileHash> &result, mtpRequestId requestId) {
@@ -922,22 +1611,31 @@ void mtpFileLoader::getCdnFileHashesDone(const MTPVector<MTPFileHash> &result, m
 void mtpFileLoader::placeSentRequest(mtpRequestId requestId, const RequestData &requestData) {
 	Expects(!_finished);
 
-	_downloader->requestedAmountIncrement(requestData.dcId, requestData.dcIndex, partSize());
+	_downloader->requestedAmountIncrement(requestData.dcId, requestData.dcIndex, requestData.limit);
+	_downloader->queryStarted(_loadPriority, requestData.limit);
 	++_queue->queriesCount;
-	_sentRequests.emplace(requestId, requestData);
+	const auto i = _sentRequests.emplace(requestId, requestData).first;
+	i->second.sent = getms(true);
+	i->second.priority = _loadPriority;
 }
 
-int mtpFileLoader::finishSentRequestGetOffset(mtpRequestId requestId) {
+mtpFileLoader::RequestData mtpFileLoader::finishSentRequest(
+		mtpRequestId requestId) {
 	auto it = _sentRequests.find(requestId);
 	Assert(it != _sentRequests.cend());
 
 	auto requestData = it->second;
-	_downloader->requestedAmountIncrement(requestData.dcId, requestData.dcIndex, -partSize());
+	_downloader->requestedAmountIncrement(requestData.dcId, requestData.dcIndex, -requestData.limit);
+	_downloader->queryFinished(requestData.priority);
 
 	--_queue->queriesCount;
 	_sentRequests.erase(it);
 
-	return requestData.offset;
+	return requestData;
+}
+
+int mtpFileLoader::finishSentRequestGetOffset(mtpRequestId requestId) {
+	return finishSentRequest(requestId).offset;
 }
 
 bool mtpFileLoader::feedPart(int offset, bytes::const_span buffer) {
@@ -945,16 +1643,14 @@ bool mtpFileLoader::feedPart(int offset, bytes::const_span buffer) {
 
 	if (buffer.size()) {
 		if (_fileIsOpen) {
-			auto fsize = _file.size();
-			if (offset < fsize) {
+			if (offset < _fileSize) {
 				_skippedBytes -= buffer.size();
-			} else if (offset > fsize) {
-				_skippedBytes += offset - fsize;
+			} else if (offset > _fileSize) {
+				_skippedBytes += offset - _fileSize;
 			}
-			_file.seek(offset);
-			if (_file.write(reinterpret_cast<const char*>(buffer.data()), buffer.size()) != qint64(buffer.size())) {
-				cancel(true);
-				return false;
+			writePart(offset, buffer);
+			if (resumable()) {
+				addResumeRange(offset, buffer.size());
 			}
 		} else {
 			_data.reserve(offset + buffer.size());
@@ -979,9 +1675,22 @@ bool mtpFileLoader::feedPart(int offset, bytes::const_span buffer) {
 	if (!buffer.size() || (buffer.size() % 1024)) { // bad next offset
 		_lastComplete = true;
 	}
+	if (_streamed) {
+		feedStreamed(offset, buffer);
+	}
+	const auto allRequested = _streamed
+		? (int(_streamedParts.size()) == streamedPartsCount())
+		: (_lastComplete || (_size && _nextRequestOffset >= _size));
 	if (_sentRequests.empty()
 		&& _cdnUncheckedParts.empty()
-		&& (_lastComplete || (_size && _nextRequestOffset >= _size))) {
+		&& !_cdnDecryptingParts
+		&& _preemptedParts.empty()
+		&& allRequested) {
+		if (!waitForWrites()) {
+			cancel(true);
+			return false;
+		}
+		_writer = nullptr;
 		if (!_filename.isEmpty() && (_toCache == LoadToCacheAsWell)) {
 			if (!_fileIsOpen) {
 				_fileIsOpen = _file.open(QIODevice::WriteOnly);
@@ -997,6 +1706,11 @@ bool mtpFileLoader::feedPart(int offset, bytes::const_span buffer) {
 			_fileIsOpen = false;
 			Platform::File::PostprocessDownloaded(QFileInfo(_file).absoluteFilePath());
 		}
+		if (_streamed) {
+			_streamed->finish(
+				_filename,
+				(_toCache == LoadToCacheAsWell) ? _data : QByteArray());
+		}
 		removeFromQueue();
 
 		if (_localStatus == LocalStatus::NotFound) {
@@ -1006,7 +1720,11 @@ bool mtpFileLoader::feedPart(int offset, bytes::const_span buffer) {
 					mediaKey(_locationType, _dcId, _id),
 					FileLocation(_filename));
 			}
-			if (_urlLocation
+			if (const auto key = sharedCacheKey()) {
+				Auth().data().sharedCache()->put(
+					*key,
+					base::duplicate(_data));
+			} else if (_urlLocation
 				|| _locationType == UnknownFileLocation
 				|| _toCache == LoadToCacheAsWell) {
 				if (const auto key = cacheKey()) {
@@ -1022,7 +1740,45 @@ bool mtpFileLoader::feedPart(int offset, bytes::const_span buffer) {
 		}
 	}
 	if (_finished) {
+		if (resumable()) {
+			clearResumeState();
+		}
 		_downloader->taskFinished().notify();
+	} else if (_resumeUnsavedBytes >= kResumeStateSaveStep) {
+		saveResumeState();
+	}
+	return true;
+}
+
+void mtpFileLoader::writePart(int offset, bytes::const_span buffer) {
+	if (!_writer) {
+		_writer = std::make_unique<Storage::FilePartsWriter>(
+			&_file,
+			[=] { partsWritten(); });
+	}
+	_writer->write(offset, QByteArray(
+		reinterpret_cast<const char*>(buffer.data()),
+		buffer.size()));
+	_fileSize = std::max(_fileSize, offset + int(buffer.size()));
+}
+
+void mtpFileLoader::partsWritten() {
+	if (_writer->failed()) {
+		cancel(true);
+	} else if (!writesThrottled()) {
+		loadNext();
+	}
+}
+
+bool mtpFileLoader::writesThrottled() const {
+	// Don't request more parts while the disk can't keep up.
+	return _writer && (_writer->pendingSize() > kMaxPendingWritesSize);
+}
+
+bool mtpFileLoader::waitForWrites() {
+	if (_writer) {
+		_writer->wait();
+		return !_writer->failed();
 	}
 	return true;
 }
@@ -1065,9 +1821,9 @@ bool mtpFileLoader::cdnPartFailed(
 	}
 	if (error.type() == qstr("FILE_TOKEN_INVALID")
 		|| error.type() == qstr("REQUEST_TOKEN_INVALID")) {
-		auto offset = finishSentRequestGetOffset(requestId);
+		const auto request = finishSentRequest(requestId);
 		changeCDNParams(
-			offset,
+			request,
 			0,
 			QByteArray(),
 			QByteArray(),
@@ -1084,13 +1840,19 @@ void mtpFileLoader::cancelRequests() {
 		MTP::cancel(requestId);
 		finishSentRequestGetOffset(requestId);
 	}
+	if (_streamed) {
+		_streamedCacheGuard.kill();
+		_streamedCacheLoading = -1;
+		_streamed->fail();
+	}
+	_writer = nullptr;
 }
 
 void mtpFileLoader::switchToCDN(
-		int offset,
+		const RequestData &request,
 		const MTPDupload_fileCdnRedirect &redirect) {
 	changeCDNParams(
-		offset,
+		request,
 		redirect.vdc_id.v,
 		redirect.vfile_token.v,
 		redirect.vencryption_key.v,
@@ -1109,7 +1871,7 @@ void mtpFileLoader::addCdnHashes(const QVector<MTPFileHash> &hashes) {
 }
 
 void mtpFileLoader::changeCDNParams(
-		int offset,
+		const RequestData &request,
 		MTP::DcId dcId,
 		const QByteArray &token,
 		const QByteArray &encryptionKey,
@@ -1134,19 +1896,18 @@ void mtpFileLoader::changeCDNParams(
 	addCdnHashes(hashes);
 
 	if (resendAllRequests && !_sentRequests.empty()) {
-		auto resendOffsets = std::vector<int>();
-		resendOffsets.reserve(_sentRequests.size());
+		auto resendRequests = std::vector<RequestData>();
+		resendRequests.reserve(_sentRequests.size());
 		while (!_sentRequests.empty()) {
 			auto requestId = _sentRequests.begin()->first;
 			MTP::cancel(requestId);
-			auto resendOffset = finishSentRequestGetOffset(requestId);
-			resendOffsets.push_back(resendOffset);
+			resendRequests.push_back(finishSentRequest(requestId));
 		}
-		for (auto resendOffset : resendOffsets) {
-			makeRequest(resendOffset);
+		for (const auto &resend : resendRequests) {
+			makeRequest(resend.offset, resend.limit);
 		}
 	}
-	makeRequest(offset);
+	makeRequest(request.offset, request.limit);
 }
 
 std::optional<Storage::Cache::Key> mtpFileLoader::cacheKey() const {
@@ -1162,6 +1923,225 @@ std::optional<Storage::Cache::Key> mtpFileLoader::cacheKey() const {
 	return std::nullopt;
 }
 
+std::optional<Storage::Cache::Key> mtpFileLoader::sharedCacheKey() const {
+	// Only the data that is kept in memory may be put to the shared cache.
+	if (!Auth().data().sharedCache()
+		|| (!_filename.isEmpty() && _toCache != LoadToCacheAsWell)
+		|| !sharedCacheAllowed()) {
+		return std::nullopt;
+	}
+	return cacheKey();
+}
+
+bool mtpFileLoader::sharedCacheAllowed() const {
+	if (_urlLocation || _geoLocation) {
+		return false;
+	} else if (base::get_if<Data::FileOriginStickerSet>(&_origin)) {
+		return true;
+	} else if (const auto message
+		= base::get_if<Data::FileOriginMessage>(&_origin)) {
+		// Media from public channels is the same for everyone.
+		const auto channel = App::channelLoaded(message->channel);
+		return channel && channel->isBroadcast() && channel->isPublic();
+	}
+	return false;
+}
+
+void mtpFileLoader::loadResumeState() {
+	if (!resumable()) {
+		return;
+	}
+	auto [first, second] = base::make_binary_guard();
+	_localLoading = std::move(first);
+	_downloader->requestLocal(
+		Data::DocumentResumeCacheKey(_dcId, _id),
+		[=, guard = std::move(second)](QByteArray &&value) mutable {
+		crl::on_main([
+			=,
+			value = std::move(value),
+			guard = std::move(guard)
+		]() mutable {
+			if (guard.alive()) {
+				resumeStateLoaded(std::move(value));
+			}
+		});
+	});
+}
+
+bool mtpFileLoader::resumable() const {
+	return _id
+		&& (_size > 0)
+		&& !_location
+		&& !_urlLocation
+		&& !_geoLocation
+		&& !_filename.isEmpty()
+		&& (_toCache == LoadToFileOnly);
+}
+
+void mtpFileLoader::resumeStateLoaded(QByteArray &&value) {
+	_localLoading.kill();
+	_localStatus = LocalStatus::NotFound;
+	if (_finished) {
+		return;
+	} else if (!value.isEmpty() && !restoreResumeState(value)) {
+		clearResumeState();
+	}
+	start(true);
+}
+
+bool mtpFileLoader::restoreResumeState(const QByteArray &value) {
+	QDataStream stream(value);
+	stream.setVersion(QDataStream::Qt_5_1);
+
+	qint32 version = 0, size = 0, rangesCount = 0;
+	QString path;
+	stream >> version >> path >> size >> rangesCount;
+	if (stream.status() != QDataStream::Ok
+		|| version != kResumeStateVersion
+		|| size != _size
+		|| rangesCount <= 0
+		|| rangesCount > (_size / kDownloadCdnPartSize) + 1) {
+		return false;
+	}
+
+	// Parts are aligned by their size and are never smaller than 128 KB,
+	// so the missing ranges can be requested again in 128 KB parts.
+	const auto aligned = [&](int offset) {
+		return !(offset % kDownloadCdnPartSize) || (offset == _size);
+	};
+	auto ranges = std::map<int, int>();
+	auto till = 0;
+	auto loaded = 0;
+	for (auto i = 0; i != rangesCount; ++i) {
+		qint32 from = 0, to = 0;
+		stream >> from >> to;
+		if (stream.status() != QDataStream::Ok
+			|| from < till
+			|| to <= from
+			|| to > _size
+			|| !aligned(from)
+			|| !aligned(to)) {
+			return false;
+		}
+		ranges.emplace(from, to);
+		loaded += to - from;
+		till = to;
+	}
+	if (till >= _size) {
+		return false;
+	}
+
+	qint32 hashesCount = 0;
+	stream >> hashesCount;
+	if (stream.status() != QDataStream::Ok || hashesCount < 0) {
+		return false;
+	}
+	auto hashes = std::map<int, CdnFileHash>();
+	for (auto i = 0; i != hashesCount; ++i) {
+		qint32 offset = 0, limit = 0;
+		QByteArray hash;
+		stream >> offset >> limit >> hash;
+		if (stream.status() != QDataStream::Ok) {
+			return false;
+		}
+		hashes.emplace(offset, CdnFileHash(limit, hash));
+	}
+	if (!openResumedFile(path, till)) {
+		return false;
+	}
+
+	_resumeRanges = std::move(ranges);
+	_cdnFileHashes = std::move(hashes);
+	_skippedBytes = till - loaded;
+	_nextRequestOffset = till;
+
+	// Missing parts are requested first, as if they were preempted.
+	auto from = 0;
+	for (const auto &[offset, to] : _resumeRanges) {
+		for (auto part = from; part < offset; part += kDownloadCdnPartSize) {
+			_preemptedParts.emplace(part, kDownloadCdnPartSize);
+		}
+		from = to;
+	}
+	saveResumeState();
+	return true;
+}
+
+bool mtpFileLoader::openResumedFile(const QString &path, int size) {
+	if (path.isEmpty() || QFileInfo(path).size() < size) {
+		return false;
+	} else if (path != _filename) {
+		// The new name was chosen because the partial file existed.
+		if (QFile::exists(_filename) || !QFile::rename(path, _filename)) {
+			return false;
+		}
+	}
+	_fileIsOpen = _file.open(QIODevice::ReadWrite);
+	if (!_fileIsOpen) {
+		return false;
+	} else if (!_file.resize(size)) {
+		_file.close();
+		_fileIsOpen = false;
+		return false;
+	}
+	_fileSize = size;
+	return true;
+}
+
+void mtpFileLoader::addResumeRange(int offset, int size) {
+	auto from = offset;
+	auto till = offset + size;
+	auto i = _resumeRanges.upper_bound(from);
+	if (i != begin(_resumeRanges) && std::prev(i)->second >= from) {
+		--i;
+		from = i->first;
+		till = std::max(till, i->second);
+		i = _resumeRanges.erase(i);
+	}
+	while (i != end(_resumeRanges) && i->first <= till) {
+		till = std::max(till, i->second);
+		i = _resumeRanges.erase(i);
+	}
+	_resumeRanges.emplace(from, till);
+	_resumeUnsavedBytes += size;
+}
+
+void mtpFileLoader::saveResumeState() {
+	// Only the ranges that reached the file are saved as loaded.
+	if (!waitForWrites()) {
+		return;
+	}
+	_file.flush();
+	_resumeUnsavedBytes = 0;
+
+	auto result = QByteArray();
+	{
+		QDataStream stream(&result, QIODevice::WriteOnly);
+		stream.setVersion(QDataStream::Qt_5_1);
+		stream
+			<< qint32(kResumeStateVersion)
+			<< _filename
+			<< qint32(_size)
+			<< qint32(_resumeRanges.size());
+		for (const auto &[from, till] : _resumeRanges) {
+			stream << qint32(from) << qint32(till);
+		}
+		stream << qint32(_cdnFileHashes.size());
+		for (const auto &[offset, hash] : _cdnFileHashes) {
+			stream << qint32(offset) << qint32(hash.limit) << hash.hash;
+		}
+	}
+	Auth().data().cache().put(
+		Data::DocumentResumeCacheKey(_dcId, _id),
+		Storage::Cache::Database::TaggedValue(std::move(result), _cacheTag));
+}
+
+void mtpFileLoader::clearResumeState() {
+	_resumeRanges.clear();
+	_resumeUnsavedBytes = 0;
+	Auth().data().cache().remove(Data::DocumentResumeCacheKey(_dcId, _id));
+}
+
 mtpFileLoader::~mtpFileLoader() {
 	cancelRequests();
 }
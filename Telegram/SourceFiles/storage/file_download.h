@@ -10,17 +10,30 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 #include "base/observer.h"
 #include "data/data_file_origin.h"
 #include "base/binary_guard.h"
+#include "storage/cache/storage_cache_types.h"
+#include "base/flat_set.h"
+
+namespace Storage {
+class StreamedFile;
+class FilePartsWriter;
+} // namespace Storage
 
 namespace Storage {
-namespace Cache {
-struct Key;
-} // namespace Cache
 
 constexpr auto kMaxFileInMemory = 10 * 1024 * 1024; // 10 MB max file could be hold in memory
 constexpr auto kMaxVoiceInMemory = 2 * 1024 * 1024; // 2 MB audio is hold in memory and auto loaded
 constexpr auto kMaxStickerInMemory = 2 * 1024 * 1024; // 2 MB stickers hold in memory, auto loaded and displayed inline
 constexpr auto kMaxAnimationInMemory = kMaxFileInMemory; // 10 MB gif and mp4 animations held in memory while playing
 
+// Parts of all the loaders are scheduled by weighted fair queuing between
+// these priorities, autoload parts are preempted by starving loaders.
+enum class LoadPriority : uchar {
+	Visible,
+	UserInitiated,
+	Autoload,
+};
+constexpr auto kLoadPrioritiesCount = 3;
+
 class Downloader final {
 public:
 	Downloader();
@@ -39,17 +52,67 @@ public:
 	void requestedAmountIncrement(MTP::DcId dcId, int index, int amount);
 	int chooseDcIndexForRequest(MTP::DcId dcId) const;
 
+	// Dcs that had download requests in the last period, but have none
+	// now, so that their sessions can be started before they are needed.
+	std::vector<MTP::DcId> recentlyUsedDcs(TimeMs period) const;
+
+	// Requested bytes limit per dc follows the measured round trip time
+	// and throughput (bandwidth-delay product) of the loaded parts.
+	void requestSucceeded(MTP::DcId dcId, int amount, TimeMs sent);
+	int64 requestedAmountLimit(MTP::DcId dcId) const;
+	bool canRequestMore(MTP::DcId dcId) const;
+
+	// Queries from all the dcs share a global limit, free ones are given
+	// first to the priority that received the least weighted amount.
+	void queryStarted(LoadPriority priority, int amount);
+	void queryFinished(LoadPriority priority);
+	bool canStartQuery() const;
+	std::array<LoadPriority, kLoadPrioritiesCount> scheduleOrder() const;
+
+	// Cache reads are collected and sent in batches with getMany().
+	void requestLocal(
+		const Cache::Key &key,
+		FnMut<void(QByteArray&&)> &&done);
+	void sendLocalRequests();
+
 	~Downloader();
 
 private:
+	struct LocalRequest {
+		Cache::Key key;
+		FnMut<void(QByteArray&&)> done;
+	};
+	struct DcSpeed {
+		TimeMs windowStart = 0;
+		TimeMs lastReceived = 0;
+		int64 windowAmount = 0;
+		float64 throughput = 0.; // Bytes per millisecond.
+		float64 roundTrip = 0.; // Milliseconds.
+	};
+	struct PriorityQueries {
+		int count = 0;
+		float64 virtualTime = 0.; // Requested bytes divided by weight.
+	};
+
+	float64 activeVirtualTime() const;
+	float64 effectiveVirtualTime(const PriorityQueries &queries) const;
+
 	base::Observable<void> _taskFinishedObservable;
 	int _priority = 1;
 
 	SingleQueuedInvokation _delayedLoadersDestroyer;
 	std::vector<std::unique_ptr<FileLoader>> _delayedDestroyedLoaders;
 
+	SingleQueuedInvokation _localRequestsSender;
+	std::vector<LocalRequest> _localRequests;
+
 	using RequestedInDc = std::array<int64, MTP::kDownloadSessionsCount>;
 	std::map<MTP::DcId, RequestedInDc> _requestedBytesAmount;
+	std::map<MTP::DcId, TimeMs> _lastUsed;
+	std::map<MTP::DcId, DcSpeed> _speeds;
+
+	std::array<PriorityQueries, kLoadPrioritiesCount> _priorityQueries;
+	int _queriesCount = 0;
 
 };
 
@@ -91,11 +154,23 @@ public:
 	const QByteArray &bytes() const {
 		return _data;
 	}
+	virtual QByteArray partialBytes() const {
+		return QByteArray();
+	}
 	virtual uint64 objId() const {
 		return 0;
 	}
 	QByteArray imageFormat(const QSize &shrinkBox = QSize()) const;
 	QImage imageData(const QSize &shrinkBox = QSize()) const;
+	bool imageDecoded() const {
+		return !_imageData.isNull();
+	}
+
+	// Can be called from any thread.
+	static QImage ReadImage(
+		const QByteArray &data,
+		const QSize &shrinkBox,
+		QByteArray *format = nullptr);
 	QString fileName() const {
 		return _filename;
 	}
@@ -153,8 +228,17 @@ protected:
 	void readImage(const QSize &shrinkBox) const;
 
 	bool tryLoadLocal();
-	void loadLocal(const Storage::Cache::Key &key);
+	bool tryLoadShared();
+	void loadLocal(const Storage::Cache::Key &key, bool shared);
 	virtual std::optional<Storage::Cache::Key> cacheKey() const = 0;
+
+	// Public media is looked up in the machine-wide cache, if there is
+	// one, and is stored there when downloaded instead of the own cache.
+	virtual std::optional<Storage::Cache::Key> sharedCacheKey() const {
+		return std::nullopt;
+	}
+	virtual void loadResumeState() { // Tried if there is no cache key.
+	}
 	virtual void cancelRequests() = 0;
 
 	void startLoading(bool loadFirst, bool prior);
@@ -164,10 +248,27 @@ protected:
 	void loadNext();
 	virtual bool loadPart() = 0;
 
+	// Doesn't have any parts loading while it could load some.
+	virtual bool starving() const {
+		return false;
+	}
+	virtual bool preemptPart() {
+		return false;
+	}
+	virtual bool streaming() const {
+		return false;
+	}
+
+	static void LoadNextParts(not_null<Storage::Downloader*> downloader);
+	static bool LoadNextPart(not_null<Storage::Downloader*> downloader);
+	static bool PreemptForStarving();
+	static bool PreemptAutoloadPart(FileLoaderQueue &queue);
+
 	not_null<Storage::Downloader*> _downloader;
 	FileLoader *_prev = nullptr;
 	FileLoader *_next = nullptr;
 	int _priority = 0;
+	Storage::LoadPriority _loadPriority = Storage::LoadPriority::Autoload;
 	FileLoaderQueue *_queue = nullptr;
 
 	bool _paused = false;
@@ -177,6 +278,7 @@ protected:
 	bool _finished = false;
 	bool _cancelled = false;
 	mutable LocalStatus _localStatus = LocalStatus::NotTried;
+	bool _sharedTried = false;
 
 	QString _filename;
 	QFile _file;
@@ -235,6 +337,7 @@ public:
 
 	int32 currentOffset(bool includeSkipped = false) const override;
 	Data::FileOrigin fileOrigin() const override;
+	QByteArray partialBytes() const override;
 
 	uint64 objId() const override {
 		return _id;
@@ -248,6 +351,10 @@ public:
 		int requestId,
 		const QByteArray &current);
 
+	// Parts are loaded in the order they're read from the stream, the
+	// seeks included, and are cached separately until the file is loaded.
+	std::shared_ptr<Storage::StreamedFile> stream();
+
 	~mtpFileLoader();
 
 private:
@@ -255,6 +362,9 @@ private:
 		MTP::DcId dcId = 0;
 		int dcIndex = 0;
 		int offset = 0;
+		int limit = 0;
+		TimeMs sent = 0;
+		Storage::LoadPriority priority = Storage::LoadPriority::Autoload;
 	};
 	struct CdnFileHash {
 		CdnFileHash(int limit, QByteArray hash) : limit(limit), hash(hash) {
@@ -263,15 +373,37 @@ private:
 		QByteArray hash;
 	};
 	std::optional<Storage::Cache::Key> cacheKey() const override;
+	std::optional<Storage::Cache::Key> sharedCacheKey() const override;
+	bool sharedCacheAllowed() const;
+	void loadResumeState() override;
 	void cancelRequests() override;
 
+	// Files loaded to disk only keep the written ranges in the cache
+	// and continue from the first missing part after a restart.
+	bool resumable() const;
+	void resumeStateLoaded(QByteArray &&value);
+	bool restoreResumeState(const QByteArray &value);
+	bool openResumedFile(const QString &path, int size);
+	void addResumeRange(int offset, int size);
+	void saveResumeState();
+	void clearResumeState();
+
 	int partSize() const;
-	RequestData prepareRequest(int offset) const;
-	void makeRequest(int offset);
+	bool adaptivePartSize() const;
+	void adjustPartSize(MTP::DcId dcId);
+	RequestData prepareRequest(int offset, int limit) const;
+	void makeRequest(int offset, int limit);
 
 	MTPInputFileLocation computeLocation() const;
 	bool loadPart() override;
+	bool starving() const override;
+	bool preemptPart() override;
+	bool streaming() const override;
 	void normalPartLoaded(const MTPupload_File &result, mtpRequestId requestId);
+	void normalPartLoadedBare(
+		const mtpPrime *from,
+		const mtpPrime *end,
+		mtpRequestId requestId);
 	void webPartLoaded(const MTPupload_WebFile &result, mtpRequestId requestId);
 	void cdnPartLoaded(const MTPupload_CdnFile &result, mtpRequestId requestId);
 	void reuploadDone(const MTPVector<MTPFileHash> &result, mtpRequestId requestId);
@@ -281,14 +413,23 @@ private:
 	bool feedPart(int offset, bytes::const_span buffer);
 	void partLoaded(int offset, bytes::const_span buffer);
 
+	// Parts loaded to disk are written on a separate queue.
+	void writePart(int offset, bytes::const_span buffer);
+	void partsWritten();
+	bool writesThrottled() const;
+	bool waitForWrites();
+
 	bool partFailed(const RPCError &error, mtpRequestId requestId);
 	bool cdnPartFailed(const RPCError &error, mtpRequestId requestId);
 
 	void placeSentRequest(mtpRequestId requestId, const RequestData &requestData);
+	RequestData finishSentRequest(mtpRequestId requestId);
 	int finishSentRequestGetOffset(mtpRequestId requestId);
-	void switchToCDN(int offset, const MTPDupload_fileCdnRedirect &redirect);
+	void switchToCDN(
+		const RequestData &request,
+		const MTPDupload_fileCdnRedirect &redirect);
 	void addCdnHashes(const QVector<MTPFileHash> &hashes);
-	void changeCDNParams(int offset, MTP::DcId dcId, const QByteArray &token, const QByteArray &encryptionKey, const QByteArray &encryptionIV, const QVector<MTPFileHash> &hashes);
+	void changeCDNParams(const RequestData &request, MTP::DcId dcId, const QByteArray &token, const QByteArray &encryptionKey, const QByteArray &encryptionIV, const QVector<MTPFileHash> &hashes);
 
 	enum class CheckCdnHashResult {
 		NoHash,
@@ -296,12 +437,33 @@ private:
 		Good,
 	};
 	CheckCdnHashResult checkCdnFileHash(int offset, bytes::const_span buffer);
+	CheckCdnHashResult checkCdnFileHashValue(
+		int offset,
+		bytes::const_span realHash);
+	void cdnPartDecrypted(
+		int offset,
+		const QByteArray &decrypted,
+		const bytes::vector &hash);
+
+	bool loadStreamedPart();
+	int streamedPartsCount() const;
+	bool streamedPartPending(int offset) const;
+	int nextStreamedPart() const;
+	bool cacheStreamedParts() const;
+	void loadStreamedFromCache(int offset);
+	void streamedCacheLoaded(int offset, QByteArray &&bytes);
+	void feedStreamed(int offset, bytes::const_span buffer);
+	void streamFrom(int offset);
+	void supplyStreamed(int offset);
+	void cancelFarStreamedRequests();
 
 	std::map<mtpRequestId, RequestData> _sentRequests;
+	std::map<int, int> _preemptedParts; // offset -> limit
 
 	bool _lastComplete = false;
 	int32 _skippedBytes = 0;
 	int32 _nextRequestOffset = 0;
+	int _partSize = 0;
 
 	MTP::DcId _dcId = 0; // for photo locations
 	StorageImageLocation *_location = nullptr;
@@ -322,6 +484,21 @@ private:
 	std::map<int, CdnFileHash> _cdnFileHashes;
 	std::map<int, QByteArray> _cdnUncheckedParts;
 	mtpRequestId _cdnHashesRequestId = 0;
+	int _cdnDecryptingParts = 0;
+
+	std::shared_ptr<Storage::StreamedFile> _streamed;
+	base::flat_set<int> _streamedParts; // Loaded part offsets.
+	base::flat_set<int> _streamedCacheChecked;
+	int _streamedCacheLoading = -1;
+	int _streamPosition = 0;
+	base::binary_guard _streamedCacheGuard;
+	rpl::lifetime _streamLifetime;
+
+	std::map<int, int> _resumeRanges; // offset -> till
+	int _resumeUnsavedBytes = 0;
+
+	std::unique_ptr<Storage::FilePartsWriter> _writer;
+	int _fileSize = 0;
 
 };
 
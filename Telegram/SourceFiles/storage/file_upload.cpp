@@ -17,7 +17,37 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 namespace Storage {
 namespace {
 
-constexpr auto kMaxUploadFileParallelSize = MTP::kUploadSessionsCount * 512 * 1024; // max 512kb uploaded at the same time in each session
+// Each session starts with as much in flight as all of them had before.
+constexpr auto kMinUploadSessionWindow = uint32(512 * 1024);
+constexpr auto kMaxUploadSessionWindow = uint32(4 * 1024 * 1024);
+constexpr auto kMaxUploadingFiles = 4; // send parts of 4 files at the same time
+constexpr auto kSpeedWindow = TimeMs(1000);
+constexpr auto kRoundTripPeriod = TimeMs(10000); // least ack latency lifetime
+constexpr auto kUploadAheadMinSize = 1024 * 1024; // smaller are prepared fast
+constexpr auto kUploadAheadStreamLimit = 1024 * 1024; // tiny part size below
+constexpr auto kUploadedContentLifetime = TimeMs(60 * 60 * 1000);
+constexpr auto kUploadedContentLimit = 64;
+constexpr auto kContentHashChunkSize = 1024 * 1024;
+
+QByteArray ContentHash(const QString &filepath, const QByteArray &content) {
+	auto md5 = HashMd5();
+	if (!content.isEmpty()) {
+		md5.feed(content.constData(), content.size());
+	} else {
+		QFile file(filepath);
+		if (!file.open(QIODevice::ReadOnly)) {
+			return QByteArray();
+		}
+		while (!file.atEnd()) {
+			const auto chunk = file.read(kContentHashChunkSize);
+			if (chunk.isEmpty()) {
+				return QByteArray();
+			}
+			md5.feed(chunk.constData(), chunk.size());
+		}
+	}
+	return QByteArray(reinterpret_cast<const char*>(md5.result()), 16);
+}
 
 } // namespace
 
@@ -38,7 +68,14 @@ struct Uploader::File {
 	uint64 thumbId() const;
 	const QString &filename() const;
 
+	UploadFileParts &parts();
+	uint64 partsOfId() const;
+	bool hasPartsToSend();
+	void requestFinished(int size, bool docPart);
+
 	HashMd5 md5Hash;
+	HashMd5 contentHash; // Of all the document parts.
+	std::optional<MTPInputFile> reused;
 
 	std::unique_ptr<QFile> docFile;
 	int32 docSentParts = 0;
@@ -46,6 +83,12 @@ struct Uploader::File {
 	int32 docPartSize = 0;
 	int32 docPartsCount = 0;
 
+	int requestsCount = 0;
+	int docRequestsCount = 0;
+	uint32 sentSize = 0;
+	int64 uploadedSize = 0;
+	TimeMs started = 0;
+
 };
 
 Uploader::File::File(const SendMediaReady &media) : media(media) {
@@ -111,6 +154,37 @@ const QString &Uploader::File::filename() const {
 	return file ? file->filename : media.filename;
 }
 
+UploadFileParts &Uploader::File::parts() {
+	return file
+		? ((type() == SendMediaType::Photo
+			|| type() == SendMediaType::Secure)
+			? file->fileparts
+			: file->thumbparts)
+		: media.parts;
+}
+
+uint64 Uploader::File::partsOfId() const {
+	return file
+		? ((type() == SendMediaType::Photo
+			|| type() == SendMediaType::Secure)
+			? file->id
+			: file->thumbId)
+		: media.thumbId;
+}
+
+bool Uploader::File::hasPartsToSend() {
+	return !parts().isEmpty() || (docSentParts < docPartsCount);
+}
+
+void Uploader::File::requestFinished(int size, bool docPart) {
+	--requestsCount;
+	if (docPart) {
+		--docRequestsCount;
+	}
+	sentSize -= size;
+	uploadedSize += size;
+}
+
 Uploader::Uploader() {
 	nextTimer.setSingleShot(true);
 	connect(&nextTimer, SIGNAL(timeout()), this, SLOT(sendNext()));
@@ -177,42 +251,247 @@ void Uploader::upload(
 			document->setLocation(FileLocation(file->filepath));
 		}
 	}
-	queue.emplace(msgId, File(file));
+	if (!takeAhead(msgId, file)) {
+		queue.emplace(msgId, File(file));
+	}
+	checkUploadedContent(msgId, file);
 	sendNext();
 }
 
-void Uploader::currentFailed() {
-	auto j = queue.find(uploadingId);
-	if (j != queue.end()) {
-		if (j->second.type() == SendMediaType::Photo) {
-			_photoFailed.fire_copy(j->first);
-		} else if (j->second.type() == SendMediaType::File
-			|| j->second.type() == SendMediaType::Audio) {
-			const auto document = Auth().data().document(j->second.id());
-			if (document->uploading()) {
-				document->status = FileUploadFailed;
+void Uploader::checkUploadedContent(
+		const FullMsgId &msgId,
+		const std::shared_ptr<FileLoadResult> &file) {
+	if (file->type != SendMediaType::File || file->contentKey.isEmpty()) {
+		return;
+	}
+	const auto i = _uploadedContent.find(file->contentKey);
+	if (i == _uploadedContent.end()
+		|| getms(true) - i->second.uploaded > kUploadedContentLifetime) {
+		return;
+	}
+
+	// The parts are sent while the whole content is hashed.
+	auto [first, second] = base::make_binary_guard();
+	_contentChecks.emplace(msgId, std::move(first));
+	crl::async([
+		=,
+		filepath = file->filepath,
+		content = file->content,
+		key = file->contentKey,
+		guard = std::move(second)
+	]() mutable {
+		auto hash = ContentHash(filepath, content);
+		crl::on_main([
+			=,
+			hash = std::move(hash),
+			guard = std::move(guard)
+		]() mutable {
+			if (guard.alive()) {
+				uploadedContentChecked(msgId, key, hash);
 			}
-			_documentFailed.fire_copy(j->first);
-		} else if (j->second.type() == SendMediaType::Secure) {
-			_secureFailed.fire_copy(j->first);
-		} else {
-			Unexpected("Type in Uploader::currentFailed.");
+		});
+	});
+}
+
+void Uploader::uploadedContentChecked(
+		const FullMsgId &msgId,
+		const QByteArray &key,
+		const QByteArray &hash) {
+	_contentChecks.remove(msgId);
+	const auto i = _uploadedContent.find(key);
+	const auto j = queue.find(msgId);
+	if (i == _uploadedContent.end()
+		|| j == queue.end()
+		|| hash.isEmpty()
+		|| i->second.hash != hash
+		|| getms(true) - i->second.uploaded > kUploadedContentLifetime) {
+		return;
+	}
+	auto &file = j->second;
+	file.reused = i->second.file;
+	for (auto k = begin(requestsSent); k != end(requestsSent);) {
+		const auto &request = k->second;
+		if (request.fullId != msgId || !request.docPart) {
+			++k;
+			continue;
 		}
-		queue.erase(j);
+		MTP::cancel(k->first);
+		_sessions[request.session].sent -= request.size;
+		--file.requestsCount;
+		--file.docRequestsCount;
+		file.sentSize -= request.size;
+		k = requestsSent.erase(k);
 	}
+	file.docSentParts = file.docPartsCount;
+	file.docFile = nullptr;
+	sendNext();
+}
 
-	requestsSent.clear();
-	docRequestsSent.clear();
-	dcMap.clear();
-	uploadingId = FullMsgId();
-	sentSize = 0;
-	for (int i = 0; i < MTP::kUploadSessionsCount; ++i) {
-		sentSizes[i] = 0;
+void Uploader::rememberUploadedContent(
+		File &file,
+		const MTPInputFile &input) {
+	if (!file.file
+		|| file.file->contentKey.isEmpty()
+		|| file.docSentParts != file.docPartsCount) {
+		return;
+	}
+	const auto hash = QByteArray(
+		reinterpret_cast<const char*>(file.contentHash.result()),
+		16);
+	_uploadedContent[file.file->contentKey] = UploadedContent{
+		hash,
+		input,
+		getms(true)
+	};
+	while (_uploadedContent.size() > kUploadedContentLimit) {
+		const auto oldest = ranges::min_element(
+			_uploadedContent,
+			std::less<>(),
+			[](const auto &pair) { return pair.second.uploaded; });
+		_uploadedContent.erase(oldest);
+	}
+}
+
+void Uploader::uploadAhead(uint64 id, const QString &filepath) {
+	const auto info = QFileInfo(filepath);
+	if (!info.isFile()
+		|| info.size() < kUploadAheadMinSize
+		|| info.size() > App::kFileSizeLimit) {
+		return;
 	}
+	auto file = std::make_shared<FileLoadResult>(
+		TaskId(),
+		id,
+		FileLoadTo(PeerId(0), false, MsgId(0)),
+		TextWithTags(),
+		nullptr);
+	file->type = SendMediaType::File;
+	file->filepath = filepath;
+	file->filesize = int32(info.size());
+	_ahead.emplace(id, File(file));
+	sendNext();
+}
+
+void Uploader::uploadAheadPart(uint64 id, const QByteArray &bytes) {
+	auto i = _ahead.find(id);
+	if (i == _ahead.end()) {
+		auto file = std::make_shared<FileLoadResult>(
+			TaskId(),
+			id,
+			FileLoadTo(PeerId(0), false, MsgId(0)),
+			TextWithTags(),
+			nullptr);
+		file->type = SendMediaType::Audio;
+		i = _ahead.emplace(id, File(file)).first;
+	}
+	auto &file = i->second;
+	auto &content = file.file->content;
+	if (content.size() + bytes.size() >= kUploadAheadStreamLimit) {
+		// The complete file will be sent with larger parts.
+		cancelAhead(id);
+		return;
+	}
+	content.append(bytes);
 
+	// The last part may still grow, so only the complete ones are sent.
+	file.docSize = content.size();
+	file.docPartSize = DocumentUploadPartSize0;
+	file.docPartsCount = content.size() / file.docPartSize;
 	sendNext();
 }
 
+void Uploader::cancelAhead(uint64 id) {
+	const auto i = _ahead.find(id);
+	if (i == _ahead.end()) {
+		return;
+	}
+	_ahead.erase(i);
+	for (auto j = begin(requestsSent); j != end(requestsSent);) {
+		if (j->second.aheadId == id) {
+			MTP::cancel(j->first);
+			_sessions[j->second.session].sent -= j->second.size;
+			j = requestsSent.erase(j);
+		} else {
+			++j;
+		}
+	}
+}
+
+bool Uploader::takeAhead(
+		const FullMsgId &msgId,
+		const std::shared_ptr<FileLoadResult> &file) {
+	const auto i = _ahead.find(file->id);
+	if (i == _ahead.end()) {
+		return false;
+	}
+	const auto &ahead = i->second.file;
+	const auto streamed = (ahead->type == SendMediaType::Audio);
+	const auto matches = streamed
+		? (file->type == SendMediaType::Audio
+			&& file->filesize < kUploadAheadStreamLimit
+			&& file->content.startsWith(ahead->content))
+		: (file->type == SendMediaType::File
+			&& file->filepath == ahead->filepath
+			&& file->filesize == ahead->filesize
+			&& file->content.isEmpty());
+	if (!matches) {
+		cancelAhead(file->id);
+		return false;
+	}
+	auto taken = std::move(i->second);
+	_ahead.erase(i);
+	taken.file = file;
+	if (streamed) {
+		taken.setDocSize(file->filesize);
+	}
+	taken.partsCount = file->thumbparts.size();
+	for (auto &[requestId, request] : requestsSent) {
+		if (request.aheadId == file->id) {
+			request.aheadId = 0;
+			request.fullId = msgId;
+		}
+	}
+	queue.emplace(msgId, std::move(taken));
+	return true;
+}
+
+void Uploader::failed(const FullMsgId &msgId) {
+	auto j = queue.find(msgId);
+	if (j == queue.end()) {
+		return;
+	}
+	const auto type = j->second.type();
+	const auto id = j->second.id();
+	cancelRequests(msgId);
+	queue.erase(j);
+
+	if (type == SendMediaType::Photo) {
+		_photoFailed.fire_copy(msgId);
+	} else if (type == SendMediaType::File || type == SendMediaType::Audio) {
+		const auto document = Auth().data().document(id);
+		if (document->uploading()) {
+			document->status = FileUploadFailed;
+		}
+		_documentFailed.fire_copy(msgId);
+	} else if (type == SendMediaType::Secure) {
+		_secureFailed.fire_copy(msgId);
+	} else {
+		Unexpected("Type in Uploader::failed.");
+	}
+}
+
+void Uploader::cancelRequests(const FullMsgId &msgId) {
+	for (auto i = begin(requestsSent); i != end(requestsSent);) {
+		if (i->second.fullId == msgId) {
+			MTP::cancel(i->first);
+			_sessions[i->second.session].sent -= i->second.size;
+			i = requestsSent.erase(i);
+		} else {
+			++i;
+		}
+	}
+}
+
 void Uploader::stopSessions() {
 	for (int i = 0; i < MTP::kUploadSessionsCount; ++i) {
 		MTP::stopSession(MTP::uploadDcId(i));
@@ -220,10 +499,12 @@ void Uploader::stopSessions() {
 }
 
 void Uploader::sendNext() {
-	if (sentSize >= kMaxUploadFileParallelSize || _pausedId.msg) return;
+	if (_pausedId.msg) return;
+
+	finishUploaded();
 
 	bool stopping = stopSessionsTimer.isActive();
-	if (queue.empty()) {
+	if (queue.empty() && _ahead.empty()) {
 		if (!stopping) {
 			stopSessionsTimer.start(MTPAckSendWaiting + MTPKillFileSessionTimeout);
 		}
@@ -233,193 +514,334 @@ void Uploader::sendNext() {
 	if (stopping) {
 		stopSessionsTimer.stop();
 	}
-	auto i = uploadingId.msg ? queue.find(uploadingId) : queue.begin();
-	if (!uploadingId.msg) {
-		uploadingId = i->first;
-	} else if (i == queue.end()) {
-		i = queue.begin();
-		uploadingId = i->first;
+	auto sent = false;
+	for (auto session = chooseSession(); session >= 0;) {
+		if (!sendPart(session)) {
+			break;
+		}
+		sent = true;
+		session = chooseSession();
+	}
+	if (sent) {
+		nextTimer.start(UploadRequestInterval);
 	}
-	auto &uploadingData = i->second;
+}
 
-	auto todc = 0;
-	for (auto dc = 1; dc != MTP::kUploadSessionsCount; ++dc) {
-		if (sentSizes[dc] < sentSizes[todc]) {
-			todc = dc;
+int Uploader::chooseSession() const {
+	auto result = -1;
+	for (auto i = 0; i != MTP::kUploadSessionsCount; ++i) {
+		const auto sent = _sessions[i].sent;
+		if (sent < sessionWindow(i)
+			&& (result < 0 || sent < _sessions[result].sent)) {
+			result = i;
 		}
 	}
+	return result;
+}
 
-	auto &parts = uploadingData.file
-		? ((uploadingData.type() == SendMediaType::Photo
-			|| uploadingData.type() == SendMediaType::Secure)
-			? uploadingData.file->fileparts
-			: uploadingData.file->thumbparts)
-		: uploadingData.media.parts;
-	const auto partsOfId = uploadingData.file
-		? ((uploadingData.type() == SendMediaType::Photo
-			|| uploadingData.type() == SendMediaType::Secure)
-			? uploadingData.file->id
-			: uploadingData.file->thumbId)
-		: uploadingData.media.thumbId;
-	if (parts.isEmpty()) {
-		if (uploadingData.docSentParts >= uploadingData.docPartsCount) {
-			if (requestsSent.empty() && docRequestsSent.empty()) {
-				const auto silent = uploadingData.file
-					&& uploadingData.file->to.silent;
-				if (uploadingData.type() == SendMediaType::Photo) {
-					auto photoFilename = uploadingData.filename();
-					if (!photoFilename.endsWith(qstr(".jpg"), Qt::CaseInsensitive)) {
-						// Server has some extensions checking for inputMediaUploadedPhoto,
-						// so force the extension to be .jpg anyway. It doesn't matter,
-						// because the filename from inputFile is not used anywhere.
-						photoFilename += qstr(".jpg");
-					}
-					const auto md5 = uploadingData.file
-						? uploadingData.file->filemd5
-						: uploadingData.media.jpeg_md5;
-					const auto file = MTP_inputFile(
-						MTP_long(uploadingData.id()),
-						MTP_int(uploadingData.partsCount),
-						MTP_string(photoFilename),
-						MTP_bytes(md5));
-					_photoReady.fire({ uploadingId, silent, file });
-				} else if (uploadingData.type() == SendMediaType::File
-					|| uploadingData.type() == SendMediaType::Audio) {
-					QByteArray docMd5(32, Qt::Uninitialized);
-					hashMd5Hex(uploadingData.md5Hash.result(), docMd5.data());
-
-					const auto file = (uploadingData.docSize > UseBigFilesFrom)
-						? MTP_inputFileBig(
-							MTP_long(uploadingData.id()),
-							MTP_int(uploadingData.docPartsCount),
-							MTP_string(uploadingData.filename()))
-						: MTP_inputFile(
-							MTP_long(uploadingData.id()),
-							MTP_int(uploadingData.docPartsCount),
-							MTP_string(uploadingData.filename()),
-							MTP_bytes(docMd5));
-					if (uploadingData.partsCount) {
-						const auto thumbFilename = uploadingData.file
-							? uploadingData.file->thumbname
-							: (qsl("thumb.") + uploadingData.media.thumbExt);
-						const auto thumbMd5 = uploadingData.file
-							? uploadingData.file->thumbmd5
-							: uploadingData.media.jpeg_md5;
-						const auto thumb = MTP_inputFile(
-							MTP_long(uploadingData.thumbId()),
-							MTP_int(uploadingData.partsCount),
-							MTP_string(thumbFilename),
-							MTP_bytes(thumbMd5));
-						_thumbDocumentReady.fire({
-							uploadingId,
-							silent,
-							file,
-							thumb });
-					} else {
-						_documentReady.fire({ uploadingId, silent, file });
-					}
-				} else if (uploadingData.type() == SendMediaType::Secure) {
-					_secureReady.fire({
-						uploadingId,
-						uploadingData.id(),
-						uploadingData.partsCount });
-				}
-				queue.erase(uploadingId);
-				uploadingId = FullMsgId();
-				sendNext();
-			}
-			return;
-		}
+uint32 Uploader::sessionWindow(int index) const {
+	// The least ack latency is used, so that the parts waiting
+	// in the session queue don't make the window grow endlessly.
+	const auto &session = _sessions[index];
+	if (session.throughput <= 0.) {
+		return kMinUploadSessionWindow;
+	}
+	const auto product = session.throughput * session.minRoundTrip;
+	return snap(
+		uint32(product * 2),
+		kMinUploadSessionWindow,
+		kMaxUploadSessionWindow);
+}
 
-		auto &content = uploadingData.file
-			? uploadingData.file->content
-			: uploadingData.media.data;
-		QByteArray toSend;
-		if (content.isEmpty()) {
-			if (!uploadingData.docFile) {
-				const auto filepath = uploadingData.file
-					? uploadingData.file->filepath
-					: uploadingData.media.file;
-				uploadingData.docFile = std::make_unique<QFile>(filepath);
-				if (!uploadingData.docFile->open(QIODevice::ReadOnly)) {
-					currentFailed();
-					return;
-				}
-			}
-			toSend = uploadingData.docFile->read(uploadingData.docPartSize);
-			if (uploadingData.docSize <= UseBigFilesFrom) {
-				uploadingData.md5Hash.feed(toSend.constData(), toSend.size());
-			}
-		} else {
-			const auto offset = uploadingData.docSentParts
-				* uploadingData.docPartSize;
-			toSend = content.mid(offset, uploadingData.docPartSize);
-			if ((uploadingData.type() == SendMediaType::File
-				|| uploadingData.type() == SendMediaType::Audio)
-				&& uploadingData.docSentParts <= UseBigFilesFrom) {
-				uploadingData.md5Hash.feed(toSend.constData(), toSend.size());
-			}
+Uploader::File *Uploader::chooseFileToSend(Request &request) {
+	// Files that have all the parts sent don't take a place here, so the
+	// next file starts while the last parts of the previous one are sent.
+	auto result = static_cast<File*>(nullptr);
+	auto files = 0;
+	const auto consider = [&](File &file, FullMsgId fullId, uint64 id) {
+		if (!file.hasPartsToSend()) {
+			return true;
+		} else if (!result || file.sentSize < result->sentSize) {
+			result = &file;
+			request.fullId = fullId;
+			request.aheadId = id;
 		}
-		if ((toSend.size() > uploadingData.docPartSize)
-			|| ((toSend.size() < uploadingData.docPartSize
-				&& uploadingData.docSentParts + 1 != uploadingData.docPartsCount))) {
-			currentFailed();
-			return;
+		return (++files != kMaxUploadingFiles);
+	};
+	for (auto &[fullId, file] : queue) {
+		if (!consider(file, fullId, 0)) {
+			return result;
 		}
-		mtpRequestId requestId;
-		if (uploadingData.docSize > UseBigFilesFrom) {
-			requestId = MTP::send(
-				MTPupload_SaveBigFilePart(
-					MTP_long(uploadingData.id()),
-					MTP_int(uploadingData.docSentParts),
-					MTP_int(uploadingData.docPartsCount),
-					MTP_bytes(toSend)),
-				rpcDone(&Uploader::partLoaded),
-				rpcFail(&Uploader::partFailed),
-				MTP::uploadDcId(todc));
-		} else {
-			requestId = MTP::send(
-				MTPupload_SaveFilePart(
-					MTP_long(uploadingData.id()),
-					MTP_int(uploadingData.docSentParts),
-					MTP_bytes(toSend)),
-				rpcDone(&Uploader::partLoaded),
-				rpcFail(&Uploader::partFailed),
-				MTP::uploadDcId(todc));
+	}
+	for (auto &[id, file] : _ahead) {
+		if (!consider(file, FullMsgId(), id)) {
+			return result;
 		}
-		docRequestsSent.emplace(requestId, uploadingData.docSentParts);
-		dcMap.emplace(requestId, todc);
-		sentSize += uploadingData.docPartSize;
-		sentSizes[todc] += uploadingData.docPartSize;
+	}
+	return result;
+}
 
-		uploadingData.docSentParts++;
-	} else {
+bool Uploader::sendPart(int session) {
+	auto request = Request();
+	request.session = session;
+	const auto file = chooseFileToSend(request);
+	if (!file) {
+		return false;
+	}
+	auto &uploadingData = *file;
+	if (!uploadingData.started) {
+		uploadingData.started = getms(true);
+	}
+
+	auto &parts = uploadingData.parts();
+	if (!parts.isEmpty()) {
 		auto part = parts.begin();
 
 		const auto requestId = MTP::send(
 			MTPupload_SaveFilePart(
-				MTP_long(partsOfId),
+				MTP_long(uploadingData.partsOfId()),
 				MTP_int(part.key()),
 				MTP_bytes(part.value())),
 			rpcDone(&Uploader::partLoaded),
 			rpcFail(&Uploader::partFailed),
-			MTP::uploadDcId(todc));
-		requestsSent.emplace(requestId, part.value());
-		dcMap.emplace(requestId, todc);
-		sentSize += part.value().size();
-		sentSizes[todc] += part.value().size();
+			MTP::uploadDcId(session));
+		request.size = part.value().size();
+		placeSentRequest(requestId, request, uploadingData);
 
 		parts.erase(part);
+		return true;
+	}
+
+	auto &content = uploadingData.file
+		? uploadingData.file->content
+		: uploadingData.media.data;
+	QByteArray toSend;
+	if (content.isEmpty()) {
+		if (!uploadingData.docFile) {
+			const auto filepath = uploadingData.file
+				? uploadingData.file->filepath
+				: uploadingData.media.file;
+			uploadingData.docFile = std::make_unique<QFile>(filepath);
+			if (!uploadingData.docFile->open(QIODevice::ReadOnly)) {
+				sendFailed(request);
+				return true;
+			}
+		}
+		toSend = uploadingData.docFile->read(uploadingData.docPartSize);
+		uploadingData.contentHash.feed(toSend.constData(), toSend.size());
+		if (uploadingData.docSize <= UseBigFilesFrom) {
+			uploadingData.md5Hash.feed(toSend.constData(), toSend.size());
+		}
+	} else {
+		const auto offset = uploadingData.docSentParts
+			* uploadingData.docPartSize;
+		toSend = content.mid(offset, uploadingData.docPartSize);
+		uploadingData.contentHash.feed(toSend.constData(), toSend.size());
+		if ((uploadingData.type() == SendMediaType::File
+			|| uploadingData.type() == SendMediaType::Audio)
+			&& uploadingData.docSentParts <= UseBigFilesFrom) {
+			uploadingData.md5Hash.feed(toSend.constData(), toSend.size());
+		}
+	}
+	if ((toSend.size() > uploadingData.docPartSize)
+		|| ((toSend.size() < uploadingData.docPartSize
+			&& uploadingData.docSentParts + 1 != uploadingData.docPartsCount))) {
+		sendFailed(request);
+		return true;
+	}
+	mtpRequestId requestId;
+	if (uploadingData.docSize > UseBigFilesFrom) {
+		requestId = MTP::send(
+			MTPupload_SaveBigFilePart(
+				MTP_long(uploadingData.id()),
+				MTP_int(uploadingData.docSentParts),
+				MTP_int(uploadingData.docPartsCount),
+				MTP_bytes(toSend)),
+			rpcDone(&Uploader::partLoaded),
+			rpcFail(&Uploader::partFailed),
+			MTP::uploadDcId(session));
+	} else {
+		requestId = MTP::send(
+			MTPupload_SaveFilePart(
+				MTP_long(uploadingData.id()),
+				MTP_int(uploadingData.docSentParts),
+				MTP_bytes(toSend)),
+			rpcDone(&Uploader::partLoaded),
+			rpcFail(&Uploader::partFailed),
+			MTP::uploadDcId(session));
+	}
+	request.size = toSend.size();
+	request.docPart = true;
+	placeSentRequest(requestId, request, uploadingData);
+
+	uploadingData.docSentParts++;
+	return true;
+}
+
+void Uploader::sendFailed(const Request &request) {
+	if (request.aheadId) {
+		cancelAhead(request.aheadId);
+	} else {
+		failed(request.fullId);
+	}
+}
+
+void Uploader::placeSentRequest(
+		mtpRequestId requestId,
+		const Request &request,
+		File &file) {
+	const auto i = requestsSent.emplace(requestId, request).first;
+	i->second.sent = getms(true);
+	_sessions[request.session].sent += request.size;
+
+	++file.requestsCount;
+	if (request.docPart) {
+		++file.docRequestsCount;
 	}
-	nextTimer.start(UploadRequestInterval);
+	file.sentSize += request.size;
+}
+
+void Uploader::partAcknowledged(const Request &request) {
+	const auto now = getms(true);
+	auto &session = _sessions[request.session];
+	session.sent -= request.size;
+
+	const auto latency = float64(std::max(now - request.sent, TimeMs(1)));
+	if (session.minRoundTrip <= 0.
+		|| latency < session.minRoundTrip
+		|| now - session.minRoundTripMeasured > kRoundTripPeriod) {
+		session.minRoundTrip = latency;
+		session.minRoundTripMeasured = now;
+	}
+
+	// Don't count the time when nothing was sent in the session.
+	if (!session.windowStart
+		|| request.sent > session.lastReceived + kSpeedWindow) {
+		session.windowStart = request.sent;
+		session.windowAmount = 0;
+	}
+	session.lastReceived = now;
+	session.windowAmount += request.size;
+	const auto passed = now - session.windowStart;
+	if (passed >= kSpeedWindow) {
+		const auto current = float64(session.windowAmount) / passed;
+		session.throughput = (session.throughput > 0.)
+			? (session.throughput * 3. + current) / 4.
+			: current;
+		session.windowStart = now;
+		session.windowAmount = 0;
+	}
+}
+
+void Uploader::finishUploaded() {
+	auto ready = std::vector<FullMsgId>();
+	for (auto &[fullId, file] : queue) {
+		if (!file.hasPartsToSend() && !file.requestsCount) {
+			ready.push_back(fullId);
+		}
+	}
+	for (const auto &fullId : ready) {
+		const auto i = queue.find(fullId);
+		if (i != queue.end()) {
+			auto file = std::move(i->second);
+			queue.erase(i);
+			fileReady(fullId, file);
+		}
+	}
+}
+
+void Uploader::fileReady(const FullMsgId &fullId, File &file) {
+	if (file.started) {
+		const auto duration = std::max(getms(true) - file.started, TimeMs(1));
+		DEBUG_LOG(("Upload Info: %1 bytes uploaded in %2 ms."
+			).arg(file.uploadedSize
+			).arg(duration));
+	}
+	const auto silent = file.file && file.file->to.silent;
+	if (file.type() == SendMediaType::Photo) {
+		auto photoFilename = file.filename();
+		if (!photoFilename.endsWith(qstr(".jpg"), Qt::CaseInsensitive)) {
+			// Server has some extensions checking for inputMediaUploadedPhoto,
+			// so force the extension to be .jpg anyway. It doesn't matter,
+			// because the filename from inputFile is not used anywhere.
+			photoFilename += qstr(".jpg");
+		}
+		const auto md5 = file.file
+			? file.file->filemd5
+			: file.media.jpeg_md5;
+		const auto inputFile = MTP_inputFile(
+			MTP_long(file.id()),
+			MTP_int(file.partsCount),
+			MTP_string(photoFilename),
+			MTP_bytes(md5));
+		_photoReady.fire({ fullId, silent, inputFile });
+	} else if (file.type() == SendMediaType::File
+		|| file.type() == SendMediaType::Audio) {
+		QByteArray docMd5(32, Qt::Uninitialized);
+		hashMd5Hex(file.md5Hash.result(), docMd5.data());
+
+		const auto inputFile = file.reused
+			? *file.reused
+			: (file.docSize > UseBigFilesFrom)
+			? MTP_inputFileBig(
+				MTP_long(file.id()),
+				MTP_int(file.docPartsCount),
+				MTP_string(file.filename()))
+			: MTP_inputFile(
+				MTP_long(file.id()),
+				MTP_int(file.docPartsCount),
+				MTP_string(file.filename()),
+				MTP_bytes(docMd5));
+		if (!file.reused) {
+			rememberUploadedContent(file, inputFile);
+		}
+		if (file.partsCount) {
+			const auto thumbFilename = file.file
+				? file.file->thumbname
+				: (qsl("thumb.") + file.media.thumbExt);
+			const auto thumbMd5 = file.file
+				? file.file->thumbmd5
+				: file.media.jpeg_md5;
+			const auto thumb = MTP_inputFile(
+				MTP_long(file.thumbId()),
+				MTP_int(file.partsCount),
+				MTP_string(thumbFilename),
+				MTP_bytes(thumbMd5));
+			_thumbDocumentReady.fire({
+				fullId,
+				silent,
+				inputFile,
+				thumb });
+		} else {
+			_documentReady.fire({ fullId, silent, inputFile });
+		}
+	} else if (file.type() == SendMediaType::Secure) {
+		_secureReady.fire({
+			fullId,
+			file.id(),
+			file.partsCount });
+	}
+}
+
+float64 Uploader::throughput(const FullMsgId &msgId) const {
+	const auto i = queue.find(msgId);
+	if (i == queue.end() || !i->second.started) {
+		return 0.;
+	}
+	const auto duration = std::max(getms(true) - i->second.started, TimeMs(1));
+	return i->second.uploadedSize * 1000. / duration;
 }
 
 void Uploader::cancel(const FullMsgId &msgId) {
 	uploaded.erase(msgId);
-	if (uploadingId == msgId) {
-		currentFailed();
+	const auto i = queue.find(msgId);
+	if (i == queue.end()) {
+		return;
+	} else if (i->second.started) {
+		failed(msgId);
+		sendNext();
 	} else {
-		queue.erase(msgId);
+		queue.erase(i);
 	}
 }
 
@@ -438,82 +860,75 @@ void Uploader::confirm(const FullMsgId &msgId) {
 void Uploader::clear() {
 	uploaded.clear();
 	queue.clear();
+	_ahead.clear();
+	_contentChecks.clear();
 	for (const auto &requestData : requestsSent) {
 		MTP::cancel(requestData.first);
 	}
 	requestsSent.clear();
-	for (const auto &requestData : docRequestsSent) {
-		MTP::cancel(requestData.first);
-	}
-	docRequestsSent.clear();
-	dcMap.clear();
-	sentSize = 0;
 	for (int i = 0; i < MTP::kUploadSessionsCount; ++i) {
 		MTP::stopSession(MTP::uploadDcId(i));
-		sentSizes[i] = 0;
+		_sessions[i].sent = 0;
 	}
 	stopSessionsTimer.stop();
 }
 
 void Uploader::partLoaded(const MTPBool &result, mtpRequestId requestId) {
-	auto j = docRequestsSent.end();
-	auto i = requestsSent.find(requestId);
+	const auto i = requestsSent.find(requestId);
 	if (i == requestsSent.cend()) {
-		j = docRequestsSent.find(requestId);
+		sendNext();
+		return;
 	}
-	if (i != requestsSent.cend() || j != docRequestsSent.cend()) {
-		if (mtpIsFalse(result)) { // failed to upload current file
-			currentFailed();
-			return;
-		} else {
-			auto dcIt = dcMap.find(requestId);
-			if (dcIt == dcMap.cend()) { // must not happen
-				currentFailed();
-				return;
-			}
-			auto dc = dcIt->second;
-			dcMap.erase(dcIt);
-
-			int32 sentPartSize = 0;
-			auto k = queue.find(uploadingId);
-			Assert(k != queue.cend());
-			auto &[fullId, file] = *k;
-			if (i != requestsSent.cend()) {
-				sentPartSize = i->second.size();
-				requestsSent.erase(i);
-			} else {
-				sentPartSize = file.docPartSize;
-				docRequestsSent.erase(j);
-			}
-			sentSize -= sentPartSize;
-			sentSizes[dc] -= sentPartSize;
-			if (file.type() == SendMediaType::Photo) {
-				file.fileSentSize += sentPartSize;
-				const auto photo = Auth().data().photo(file.id());
-				if (photo->uploading() && file.file) {
-					photo->uploadingData->size = file.file->partssize;
-					photo->uploadingData->offset = file.fileSentSize;
-				}
-				_photoProgress.fire_copy(fullId);
-			} else if (file.type() == SendMediaType::File
-				|| file.type() == SendMediaType::Audio) {
-				const auto document = Auth().data().document(file.id());
-				if (document->uploading()) {
-					const auto doneParts = file.docSentParts
-						- int(docRequestsSent.size());
-					document->uploadingData->offset = std::min(
-						document->uploadingData->size,
-						doneParts * file.docPartSize);
-				}
-				_documentProgress.fire_copy(fullId);
-			} else if (file.type() == SendMediaType::Secure) {
-				file.fileSentSize += sentPartSize;
-				_secureProgress.fire_copy({
-					fullId,
-					file.fileSentSize,
-					file.file->partssize });
-			}
+	const auto request = i->second;
+	requestsSent.erase(i);
+	partAcknowledged(request);
+
+	if (request.aheadId) {
+		const auto k = _ahead.find(request.aheadId);
+		Assert(k != _ahead.cend());
+		k->second.requestFinished(request.size, request.docPart);
+		if (mtpIsFalse(result)) {
+			cancelAhead(request.aheadId);
+		}
+		sendNext();
+		return;
+	}
+	const auto k = queue.find(request.fullId);
+	Assert(k != queue.cend());
+	auto &[fullId, file] = *k;
+	file.requestFinished(request.size, request.docPart);
+
+	if (mtpIsFalse(result)) { // failed to upload this file
+		failed(request.fullId);
+		sendNext();
+		return;
+	}
+	const auto sentPartSize = request.size;
+	if (file.type() == SendMediaType::Photo) {
+		file.fileSentSize += sentPartSize;
+		const auto photo = Auth().data().photo(file.id());
+		if (photo->uploading() && file.file) {
+			photo->uploadingData->size = file.file->partssize;
+			photo->uploadingData->offset = file.fileSentSize;
+		}
+		_photoProgress.fire_copy(fullId);
+	} else if (file.type() == SendMediaType::File
+		|| file.type() == SendMediaType::Audio) {
+		const auto document = Auth().data().document(file.id());
+		if (document->uploading()) {
+			const auto doneParts = file.docSentParts
+				- file.docRequestsCount;
+			document->uploadingData->offset = std::min(
+				document->uploadingData->size,
+				doneParts * file.docPartSize);
 		}
+		_documentProgress.fire_copy(fullId);
+	} else if (file.type() == SendMediaType::Secure) {
+		file.fileSentSize += sentPartSize;
+		_secureProgress.fire_copy({
+			fullId,
+			file.fileSentSize,
+			file.file->partssize });
 	}
 
 	sendNext();
@@ -522,10 +937,13 @@ void Uploader::partLoaded(const MTPBool &result, mtpRequestId requestId) {
 bool Uploader::partFailed(const RPCError &error, mtpRequestId requestId) {
 	if (MTP::isDefaultHandledError(error)) return false;
 
-	// failed to upload current file
-	if ((requestsSent.find(requestId) != requestsSent.cend())
-		|| (docRequestsSent.find(requestId) != docRequestsSent.cend())) {
-		currentFailed();
+	// failed to upload this file
+	const auto i = requestsSent.find(requestId);
+	if (i != requestsSent.cend()) {
+		const auto request = i->second;
+		requestsSent.erase(i);
+		_sessions[request.session].sent -= request.size;
+		sendFailed(request);
 	}
 	sendNext();
 	return true;
@@ -7,6 +7,8 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 */
 #pragma once
 
+#include "base/binary_guard.h"
+
 struct FileLoadResult;
 struct SendMediaReady;
 
@@ -53,8 +55,18 @@ public:
 		const FullMsgId &msgId,
 		const std::shared_ptr<FileLoadResult> &file);
 
+	// Documents sent from disk as is start uploading while they are
+	// prepared, upload() takes the already sent parts by the file id.
+	void uploadAhead(uint64 id, const QString &filepath);
+	void cancelAhead(uint64 id);
+
+	// Voice messages are streamed while they are recorded, the complete
+	// parts of the appended bytes are sent right away.
+	void uploadAheadPart(uint64 id, const QByteArray &bytes);
+
 	int32 currentOffset(const FullMsgId &msgId) const; // -1 means file not found
 	int32 fullSize(const FullMsgId &msgId) const;
+	float64 throughput(const FullMsgId &msgId) const; // Bytes per second.
 
 	void cancel(const FullMsgId &msgId);
 	void pause(const FullMsgId &msgId);
@@ -102,22 +114,73 @@ public slots:
 
 private:
 	struct File;
+	struct Request {
+		FullMsgId fullId;
+		uint64 aheadId = 0;
+		int session = 0;
+		int size = 0;
+		bool docPart = false;
+		TimeMs sent = 0;
+	};
+	struct UploadedContent {
+		QByteArray hash;
+		MTPInputFile file;
+		TimeMs uploaded = 0;
+	};
+	struct Session {
+		uint32 sent = 0;
+		TimeMs windowStart = 0;
+		TimeMs lastReceived = 0;
+		int64 windowAmount = 0;
+		float64 throughput = 0.; // Bytes per millisecond.
+		float64 minRoundTrip = 0.; // Milliseconds.
+		TimeMs minRoundTripMeasured = 0;
+	};
+
+	// Parts of a few files are sent at the same time, each session keeps
+	// in flight as much as its measured bandwidth-delay product allows.
+	int chooseSession() const;
+	uint32 sessionWindow(int index) const;
+	File *chooseFileToSend(Request &request);
+	bool sendPart(int session);
+	void sendFailed(const Request &request);
+	bool takeAhead(
+		const FullMsgId &msgId,
+		const std::shared_ptr<FileLoadResult> &file);
+	void placeSentRequest(
+		mtpRequestId requestId,
+		const Request &request,
+		File &file);
+	void partAcknowledged(const Request &request);
+	void finishUploaded();
+	void fileReady(const FullMsgId &fullId, File &file);
 
 	void partLoaded(const MTPBool &result, mtpRequestId requestId);
 	bool partFailed(const RPCError &err, mtpRequestId requestId);
 
-	void currentFailed();
+	// Documents with the same size and content samples as a recently
+	// uploaded one are hashed as a whole and reuse its uploaded file.
+	void checkUploadedContent(
+		const FullMsgId &msgId,
+		const std::shared_ptr<FileLoadResult> &file);
+	void uploadedContentChecked(
+		const FullMsgId &msgId,
+		const QByteArray &key,
+		const QByteArray &hash);
+	void rememberUploadedContent(File &file, const MTPInputFile &input);
+
+	void failed(const FullMsgId &msgId);
+	void cancelRequests(const FullMsgId &msgId);
 
-	base::flat_map<mtpRequestId, QByteArray> requestsSent;
-	base::flat_map<mtpRequestId, int32> docRequestsSent;
-	base::flat_map<mtpRequestId, int32> dcMap;
-	uint32 sentSize = 0;
-	uint32 sentSizes[MTP::kUploadSessionsCount] = { 0 };
+	base::flat_map<mtpRequestId, Request> requestsSent;
+	std::array<Session, MTP::kUploadSessionsCount> _sessions;
 
-	FullMsgId uploadingId;
 	FullMsgId _pausedId;
 	std::map<FullMsgId, File> queue;
 	std::map<FullMsgId, File> uploaded;
+	std::map<uint64, File> _ahead;
+	std::map<QByteArray, UploadedContent> _uploadedContent;
+	base::flat_map<FullMsgId, base::binary_guard> _contentChecks;
 	QTimer nextTimer, stopSessionsTimer;
 
 	rpl::event_stream<UploadedPhoto> _photoReady;
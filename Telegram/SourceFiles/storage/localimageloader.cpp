@@ -18,11 +18,47 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 #include "lang/lang_keys.h"
 #include "boxes/confirm_box.h"
 #include "storage/file_download.h"
+#include "storage/file_upload.h"
 #include "storage/storage_media_prepare.h"
+#include "auth_session.h"
 
 namespace {
 
 constexpr auto kThumbnailQuality = 87;
+constexpr auto kContentSampleSize = 64 * 1024;
+
+QByteArray ContentSampleKey(
+		const QString &filepath,
+		const QByteArray &content,
+		qint64 size) {
+	auto md5 = HashMd5();
+	const auto offsets = {
+		qint64(0),
+		std::max((size - kContentSampleSize) / 2, qint64(0)),
+		std::max(size - kContentSampleSize, qint64(0)),
+	};
+	if (!content.isEmpty()) {
+		for (const auto offset : offsets) {
+			const auto sample = content.mid(offset, kContentSampleSize);
+			md5.feed(sample.constData(), sample.size());
+		}
+	} else {
+		QFile file(filepath);
+		if (!file.open(QIODevice::ReadOnly)) {
+			return QByteArray();
+		}
+		for (const auto offset : offsets) {
+			if (!file.seek(offset)) {
+				return QByteArray();
+			}
+			const auto sample = file.read(kContentSampleSize);
+			md5.feed(sample.constData(), sample.size());
+		}
+	}
+	auto result = QByteArray(reinterpret_cast<const char*>(md5.result()), 16);
+	result.append(QByteArray::number(size));
+	return result;
+}
 
 } // namespace
 
@@ -88,7 +124,12 @@ SendMediaReady PreparePeerPhoto(PeerId peerId, QImage &&image) {
 		0);
 }
 
-TaskQueue::TaskQueue(TimeMs stopTimeoutMs) {
+TaskQueue::TaskQueue(TimeMs stopTimeoutMs, int workersCount)
+: _workersCount(std::max(workersCount, 1)) {
+	_tasksToProcess.reserve(_workersCount);
+	for (auto i = 0; i != _workersCount; ++i) {
+		_tasksToProcess.push_back(std::make_unique<WorkerTasks>());
+	}
 	if (stopTimeoutMs > 0) {
 		_stopTimer = new QTimer(this);
 		connect(_stopTimer, SIGNAL(timeout()), this, SLOT(stop()));
@@ -99,43 +140,83 @@ TaskQueue::TaskQueue(TimeMs stopTimeoutMs) {
 
 TaskId TaskQueue::addTask(std::unique_ptr<Task> &&task) {
 	const auto result = task->id();
+	_finishOrder.push_back(result);
 	{
-		QMutexLocker lock(&_tasksToProcessMutex);
-		_tasksToProcess.push_back(std::move(task));
+		auto &worker = *_tasksToProcess[_nextWorker];
+		_nextWorker = (_nextWorker + 1) % _workersCount;
+
+		QMutexLocker lock(&worker.mutex);
+		worker.tasks.push_back(std::move(task));
 	}
 
-	wakeThread();
+	wakeThreads();
 
 	return result;
 }
 
 void TaskQueue::addTasks(std::vector<std::unique_ptr<Task>> &&tasks) {
-	{
-		QMutexLocker lock(&_tasksToProcessMutex);
-		for (auto &task : tasks) {
-			_tasksToProcess.push_back(std::move(task));
-		}
+	for (auto &task : tasks) {
+		_finishOrder.push_back(task->id());
+
+		auto &worker = *_tasksToProcess[_nextWorker];
+		_nextWorker = (_nextWorker + 1) % _workersCount;
+
+		QMutexLocker lock(&worker.mutex);
+		worker.tasks.push_back(std::move(task));
 	}
 
-	wakeThread();
+	wakeThreads();
 }
 
-void TaskQueue::wakeThread() {
-	if (!_thread) {
-		_thread = new QThread();
+void TaskQueue::wakeThreads() {
+	if (_threads.empty()) {
+		for (auto i = 0; i != _workersCount; ++i) {
+			const auto thread = new QThread();
+
+			const auto worker = new TaskQueueWorker(this, i);
+			worker->moveToThread(thread);
 
-		_worker = new TaskQueueWorker(this);
-		_worker->moveToThread(_thread);
+			connect(this, SIGNAL(taskAdded()), worker, SLOT(onTaskAdded()));
+			connect(worker, SIGNAL(taskProcessed()), this, SLOT(onTaskProcessed()));
 
-		connect(this, SIGNAL(taskAdded()), _worker, SLOT(onTaskAdded()));
-		connect(_worker, SIGNAL(taskProcessed()), this, SLOT(onTaskProcessed()));
+			thread->start();
 
-		_thread->start();
+			_threads.push_back(thread);
+			_workers.push_back(worker);
+		}
 	}
 	if (_stopTimer) _stopTimer->stop();
 	emit taskAdded();
 }
 
+std::unique_ptr<Task> TaskQueue::takeTask(int worker) {
+	for (auto i = 0; i != _workersCount; ++i) {
+		const auto index = (worker + i) % _workersCount;
+		auto &from = *_tasksToProcess[index];
+		QMutexLocker lock(&from.mutex);
+		if (from.tasks.empty()) {
+			continue;
+		}
+
+		// Own tasks are taken from the front, stolen ones from the back.
+		auto result = std::unique_ptr<Task>();
+		if (index == worker) {
+			result = std::move(from.tasks.front());
+			from.tasks.pop_front();
+		} else {
+			result = std::move(from.tasks.back());
+			from.tasks.pop_back();
+		}
+		return result;
+	}
+	return nullptr;
+}
+
+void TaskQueue::taskProcessed(std::unique_ptr<Task> &&task) {
+	QMutexLocker lock(&_tasksToFinishMutex);
+	_tasksToFinish.emplace(task->id(), std::move(task));
+}
+
 void TaskQueue::cancelTask(TaskId id) {
 	const auto removeFrom = [&](std::deque<std::unique_ptr<Task>> &queue) {
 		const auto proj = [](const std::unique_ptr<Task> &task) {
@@ -146,51 +227,75 @@ void TaskQueue::cancelTask(TaskId id) {
 			queue.erase(i);
 		}
 	};
-	{
-		QMutexLocker lock(&_tasksToProcessMutex);
-		removeFrom(_tasksToProcess);
-		if (_taskInProcessId == id) {
-			_taskInProcessId = TaskId();
-		}
+	const auto i = ranges::find(_finishOrder, id);
+	if (i != _finishOrder.end()) {
+		_finishOrder.erase(i);
+	}
+	for (const auto &worker : _tasksToProcess) {
+		QMutexLocker lock(&worker->mutex);
+		removeFrom(worker->tasks);
 	}
 	QMutexLocker lock(&_tasksToFinishMutex);
-	removeFrom(_tasksToFinish);
+	_tasksToFinish.remove(id);
 }
 
 void TaskQueue::onTaskProcessed() {
-	do {
+	while (!_finishOrder.empty()) {
 		auto task = std::unique_ptr<Task>();
 		{
 			QMutexLocker lock(&_tasksToFinishMutex);
-			if (_tasksToFinish.empty()) break;
-			task = std::move(_tasksToFinish.front());
-			_tasksToFinish.pop_front();
+			const auto i = _tasksToFinish.find(_finishOrder.front());
+			if (i == _tasksToFinish.end()) break;
+			task = std::move(i->second);
+			_tasksToFinish.erase(i);
 		}
+		_finishOrder.pop_front();
 		task->finish();
-	} while (true);
+	}
 
-	if (_stopTimer) {
-		QMutexLocker lock(&_tasksToProcessMutex);
-		if (_tasksToProcess.empty() && !_taskInProcessId) {
-			_stopTimer->start();
+	// Tasks that were cancelled while they were processed.
+	auto cancelled = std::vector<std::unique_ptr<Task>>();
+	{
+		QMutexLocker lock(&_tasksToFinishMutex);
+		for (auto i = _tasksToFinish.begin(); i != _tasksToFinish.end();) {
+			if (ranges::find(_finishOrder, i->first) == _finishOrder.end()) {
+				cancelled.push_back(std::move(i->second));
+				i = _tasksToFinish.erase(i);
+			} else {
+				++i;
+			}
 		}
 	}
+
+	if (_stopTimer && _finishOrder.empty()) {
+		_stopTimer->start();
+	}
 }
 
 void TaskQueue::stop() {
-	if (_thread) {
-		_thread->requestInterruption();
-		_thread->quit();
+	if (!_threads.empty()) {
+		for (const auto thread : _threads) {
+			thread->requestInterruption();
+			thread->quit();
+		}
 		DEBUG_LOG(("Waiting for taskThread to finish"));
-		_thread->wait();
-		delete _worker;
-		delete _thread;
-		_worker = 0;
-		_thread = 0;
+		for (const auto thread : _threads) {
+			thread->wait();
+		}
+		for (const auto worker : _workers) {
+			delete worker;
+		}
+		for (const auto thread : _threads) {
+			delete thread;
+		}
+		_workers.clear();
+		_threads.clear();
+	}
+	for (const auto &worker : _tasksToProcess) {
+		worker->tasks.clear();
 	}
-	_tasksToProcess.clear();
 	_tasksToFinish.clear();
-	_taskInProcessId = TaskId();
+	_finishOrder.clear();
 }
 
 TaskQueue::~TaskQueue() {
@@ -202,38 +307,17 @@ void TaskQueueWorker::onTaskAdded() {
 	if (_inTaskAdded) return;
 	_inTaskAdded = true;
 
-	bool someTasksLeft = false;
 	do {
-		auto task = std::unique_ptr<Task>();
-		{
-			QMutexLocker lock(&_queue->_tasksToProcessMutex);
-			if (!_queue->_tasksToProcess.empty()) {
-				task = std::move(_queue->_tasksToProcess.front());
-				_queue->_tasksToProcess.pop_front();
-				_queue->_taskInProcessId = task->id();
-			}
+		auto task = _queue->takeTask(_index);
+		if (!task) {
+			break;
 		}
+		task->process();
+		_queue->taskProcessed(std::move(task));
+		emit taskProcessed();
 
-		if (task) {
-			task->process();
-			bool emitTaskProcessed = false;
-			{
-				QMutexLocker lockToProcess(&_queue->_tasksToProcessMutex);
-				if (_queue->_taskInProcessId == task->id()) {
-					_queue->_taskInProcessId = TaskId();
-					someTasksLeft = !_queue->_tasksToProcess.empty();
-
-					QMutexLocker lockToFinish(&_queue->_tasksToFinishMutex);
-					emitTaskProcessed = _queue->_tasksToFinish.empty();
-					_queue->_tasksToFinish.push_back(std::move(task));
-				}
-			}
-			if (emitTaskProcessed) {
-				emit taskProcessed();
-			}
-		}
 		QCoreApplication::processEvents();
-	} while (someTasksLeft && !thread()->isInterruptionRequested());
+	} while (!thread()->isInterruptionRequested());
 
 	_inTaskAdded = false;
 }
@@ -277,8 +361,9 @@ FileLoadTask::FileLoadTask(
 	int32 duration,
 	const VoiceWaveform &waveform,
 	const FileLoadTo &to,
-	const TextWithTags &caption)
-: _id(rand_value<uint64>())
+	const TextWithTags &caption,
+	uint64 id)
+: _id(id ? id : rand_value<uint64>())
 , _to(to)
 , _content(voice)
 , _duration(duration)
@@ -702,6 +787,9 @@ void FileLoadTask::process() {
 	_result->type = _type;
 	_result->filepath = _filepath;
 	_result->content = _content;
+	if (_type == SendMediaType::File) {
+		_result->contentKey = ContentSampleKey(_filepath, _content, filesize);
+	}
 
 	_result->filename = filename;
 	_result->filemime = filemime;
@@ -734,6 +822,10 @@ void FileLoadTask::finish() {
 		removeFromAlbum();
 	} else if (App::main()) {
 		App::main()->onSendFileConfirm(_result);
+		return;
+	}
+	if (AuthSession::Exists()) {
+		Auth().uploader().cancelAhead(_id);
 	}
 }
 
@@ -110,7 +110,10 @@ class TaskQueue : public QObject {
 	Q_OBJECT
 
 public:
-	explicit TaskQueue(TimeMs stopTimeoutMs = 0); // <= 0 - never stop worker
+	// stopTimeoutMs <= 0 - never stop workers.
+	// Several workers steal tasks from each other, but finish() is still
+	// called in the order the tasks were added.
+	explicit TaskQueue(TimeMs stopTimeoutMs = 0, int workersCount = 1);
 
 	TaskId addTask(std::unique_ptr<Task> &&task);
 	void addTasks(std::vector<std::unique_ptr<Task>> &&tasks);
@@ -128,14 +131,23 @@ public slots:
 private:
 	friend class TaskQueueWorker;
 
-	void wakeThread();
+	struct WorkerTasks {
+		QMutex mutex;
+		std::deque<std::unique_ptr<Task>> tasks;
+	};
 
-	std::deque<std::unique_ptr<Task>> _tasksToProcess;
-	std::deque<std::unique_ptr<Task>> _tasksToFinish;
-	TaskId _taskInProcessId = TaskId();
-	QMutex _tasksToProcessMutex, _tasksToFinishMutex;
-	QThread *_thread = nullptr;
-	TaskQueueWorker *_worker = nullptr;
+	void wakeThreads();
+	std::unique_ptr<Task> takeTask(int worker); // own first, then steal
+	void taskProcessed(std::unique_ptr<Task> &&task);
+
+	const int _workersCount = 1;
+	std::vector<std::unique_ptr<WorkerTasks>> _tasksToProcess;
+	int _nextWorker = 0;
+	base::flat_map<TaskId, std::unique_ptr<Task>> _tasksToFinish;
+	std::deque<TaskId> _finishOrder; // owner thread only
+	QMutex _tasksToFinishMutex;
+	std::vector<QThread*> _threads;
+	std::vector<TaskQueueWorker*> _workers;
 	QTimer *_stopTimer = nullptr;
 
 };
@@ -144,7 +156,9 @@ class TaskQueueWorker : public QObject {
 	Q_OBJECT
 
 public:
-	TaskQueueWorker(TaskQueue *queue) : _queue(queue) {
+	TaskQueueWorker(TaskQueue *queue, int index)
+	: _queue(queue)
+	, _index(index) {
 	}
 
 signals:
@@ -155,6 +169,7 @@ public slots:
 
 private:
 	TaskQueue *_queue;
+	int _index = 0;
 	bool _inTaskAdded = false;
 
 };
@@ -206,6 +221,7 @@ struct FileLoadResult {
 	QString filename;
 	QString filemime;
 	int32 filesize = 0;
+	QByteArray contentKey; // Size and samples of a document sent as is.
 	UploadFileParts fileparts;
 	QByteArray filemd5;
 	int32 partssize;
@@ -295,7 +311,8 @@ public:
 		int32 duration,
 		const VoiceWaveform &waveform,
 		const FileLoadTo &to,
-		const TextWithTags &caption);
+		const TextWithTags &caption,
+		uint64 id = 0);
 
 	uint64 fileid() const {
 		return _id;
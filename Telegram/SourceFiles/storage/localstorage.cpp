@@ -11,6 +11,7 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 #include "storage/serialize_common.h"
 #include "storage/storage_encrypted_file.h"
 #include "storage/storage_clear_legacy.h"
+#include "storage/storage_shared_media.h"
 #include "chat_helpers/stickers.h"
 #include "data/data_drafts.h"
 #include "boxes/send_files_box.h"
@@ -20,6 +21,7 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 #include "export/export_settings.h"
 #include "core/crash_reports.h"
 #include "core/update_checker.h"
+#include "core/startup_trace.h"
 #include "observer_peer.h"
 #include "mainwidget.h"
 #include "mainwindow.h"
@@ -33,6 +35,8 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 #include "window/window_controller.h"
 #include "base/flags.h"
 #include "data/data_session.h"
+#include "data/data_document.h"
+#include "storage/cache/storage_cache_database.h"
 #include "history/history.h"
 
 extern "C" {
@@ -46,6 +50,10 @@ constexpr auto kThemeFileSizeLimit = 5 * 1024 * 1024;
 constexpr auto kFileLoaderQueueStopTimeout = TimeMs(5000);
 constexpr auto kDefaultStickerInstallDate = TimeId(1);
 constexpr auto kProxyTypeShift = 1024;
+constexpr auto kCacheCompactBytesPerSecond = int64(4 * 1024 * 1024);
+constexpr auto kCacheCompactPauseLatency = crl::time_type(50);
+constexpr auto kCacheSnapshotAfterBytes = int64(16 * 1024 * 1024);
+constexpr auto kCacheHeavyTagsSizeShare = 2;
 
 constexpr auto kSinglePeerTypeUser = qint32(1);
 constexpr auto kSinglePeerTypeChat = qint32(2);
@@ -121,6 +129,180 @@ FileKey genKey(FileOptions options = FileOption::User | FileOption::Safe) {
 	return result;
 }
 
+QByteArray PrepareEncrypted(QByteArray toEncrypt, const MTP::AuthKeyPtr &key) {
+	// prepare for encryption
+	uint32 size = toEncrypt.size(), fullSize = size;
+	if (fullSize & 0x0F) {
+		fullSize += 0x10 - (fullSize & 0x0F);
+		toEncrypt.resize(fullSize);
+		memset_rand(toEncrypt.data() + size, fullSize - size);
+	}
+	*(uint32*)toEncrypt.data() = size;
+	QByteArray encrypted(0x10 + fullSize, Qt::Uninitialized); // 128bit of sha1 - key128, sizeof(data), data
+	hashSha1(toEncrypt.constData(), toEncrypt.size(), encrypted.data());
+	MTP::aesEncryptLocal(toEncrypt.constData(), encrypted.data() + 0x10, fullSize, key, encrypted.constData());
+
+	return encrypted;
+}
+
+// Files are prepared on the main thread, encrypted and written in the
+// background. A newer write of a file replaces the pending one, so the
+// frequent writes of drafts or settings are done once per write time.
+class FileWriter {
+public:
+	struct Part {
+		QByteArray data;
+		MTP::AuthKeyPtr key; // The data is written as is without a key.
+		FnMut<QByteArray()> prepare; // If set the data is prepared by it.
+	};
+	struct Task {
+		QString base; // Full path without the version suffix.
+		bool safe = false;
+		std::vector<Part> parts;
+	};
+
+	void enqueue(Task &&task);
+
+	// Wait for the pending write, so that the file can be read or removed.
+	void flush(const QString &base);
+	void cancel(const QString &base);
+	void flushAll();
+
+private:
+	struct State {
+		QMutex mutex; // Guards the pending tasks.
+		QMutex writing; // Locked while a task is written.
+		std::map<QString, Task> pending;
+	};
+
+	static void Process(const std::shared_ptr<State> &state, const QString &base);
+	static void Write(Task &&task);
+
+	const std::shared_ptr<State> _state = std::make_shared<State>();
+
+};
+
+void FileWriter::enqueue(Task &&task) {
+	const auto base = task.base;
+	{
+		QMutexLocker lock(&_state->mutex);
+		auto &pending = _state->pending;
+		const auto i = pending.find(base);
+		if (i != end(pending)) {
+			i->second = std::move(task);
+			return;
+		}
+		pending.emplace(base, std::move(task));
+	}
+	crl::async([state = _state, base] {
+		Process(state, base);
+	});
+}
+
+void FileWriter::flush(const QString &base) {
+	Process(_state, base);
+}
+
+void FileWriter::cancel(const QString &base) {
+	QMutexLocker writing(&_state->writing);
+	QMutexLocker lock(&_state->mutex);
+	_state->pending.erase(base);
+}
+
+void FileWriter::flushAll() {
+	QMutexLocker writing(&_state->writing);
+	auto pending = [&] {
+		QMutexLocker lock(&_state->mutex);
+		return base::take(_state->pending);
+	}();
+	for (auto &[path, task] : pending) {
+		Write(std::move(task));
+	}
+}
+
+void FileWriter::Process(
+		const std::shared_ptr<State> &state,
+		const QString &base) {
+	QMutexLocker writing(&state->writing);
+	auto task = [&]() -> std::optional<Task> {
+		QMutexLocker lock(&state->mutex);
+		auto &pending = state->pending;
+		const auto i = pending.find(base);
+		if (i == end(pending)) {
+			return std::nullopt;
+		}
+		auto result = std::move(i->second);
+		pending.erase(i);
+		return std::move(result);
+	}();
+	if (task) {
+		Write(std::move(*task));
+	}
+}
+
+void FileWriter::Write(Task &&task) {
+	// detect order of read attempts and file version
+	QString toTry[2], toDelete;
+	toTry[0] = task.base + '0';
+	if (task.safe) {
+		toTry[1] = task.base + '1';
+		QFileInfo toTry0(toTry[0]);
+		QFileInfo toTry1(toTry[1]);
+		if (toTry0.exists()) {
+			if (toTry1.exists()) {
+				QDateTime mod0 = toTry0.lastModified(), mod1 = toTry1.lastModified();
+				if (mod0 > mod1) {
+					qSwap(toTry[0], toTry[1]);
+				}
+			} else {
+				qSwap(toTry[0], toTry[1]);
+			}
+			toDelete = toTry[1];
+		} else if (toTry1.exists()) {
+			toDelete = toTry[1];
+		}
+	}
+
+	QFile file(toTry[0]);
+	if (!file.open(QIODevice::WriteOnly)) {
+		return;
+	}
+	auto content = QByteArray();
+	{
+		QDataStream stream(&content, QIODevice::WriteOnly);
+		stream.setVersion(QDataStream::Qt_5_1);
+		for (auto &part : task.parts) {
+			if (part.prepare) {
+				part.data = part.prepare();
+			}
+			stream << (part.key ? PrepareEncrypted(part.data, part.key) : part.data);
+		}
+	}
+	qint32 version = AppVersion;
+	int32 dataSize = content.size();
+
+	HashMd5 md5;
+	md5.feed(content.constData(), content.size());
+	md5.feed(&dataSize, sizeof(dataSize));
+	md5.feed(&version, sizeof(version));
+	md5.feed(tdfMagic, tdfMagicLen);
+
+	file.write(tdfMagic, tdfMagicLen);
+	file.write((const char*)&version, sizeof(version));
+	file.write(content);
+	file.write((const char*)md5.result(), 0x10);
+	file.close();
+
+	if (!toDelete.isEmpty()) {
+		QFile::remove(toDelete);
+	}
+}
+
+FileWriter &Writer() {
+	static FileWriter result;
+	return result;
+}
+
 void clearKey(const FileKey &key, FileOptions options = FileOption::User | FileOption::Safe) {
 	if (options & FileOption::User) {
 		if (!_userWorking()) return;
@@ -130,7 +312,9 @@ void clearKey(const FileKey &key, FileOptions options = FileOption::User | FileO
 
 	QString base = (options & FileOption::User) ? _userBasePath : _basePath, name;
 	name.reserve(base.size() + 0x11);
-	name.append(base).append(toFilePart(key)).append('0');
+	name.append(base).append(toFilePart(key));
+	Writer().cancel(name);
+	name.append('0');
 	QFile::remove(name);
 	if (options & FileOption::Safe) {
 		name[name.size() - 1] = '1';
@@ -228,96 +412,45 @@ struct FileWriteDescriptor {
 			if (!_working()) return;
 		}
 
-		// detect order of read attempts and file version
-		QString toTry[2];
-		toTry[0] = ((options & FileOption::User) ? _userBasePath : _basePath) + name + '0';
-		if (options & FileOption::Safe) {
-			toTry[1] = ((options & FileOption::User) ? _userBasePath : _basePath) + name + '1';
-			QFileInfo toTry0(toTry[0]);
-			QFileInfo toTry1(toTry[1]);
-			if (toTry0.exists()) {
-				if (toTry1.exists()) {
-					QDateTime mod0 = toTry0.lastModified(), mod1 = toTry1.lastModified();
-					if (mod0 > mod1) {
-						qSwap(toTry[0], toTry[1]);
-					}
-				} else {
-					qSwap(toTry[0], toTry[1]);
-				}
-				toDelete = toTry[1];
-			} else if (toTry1.exists()) {
-				toDelete = toTry[1];
-			}
-		}
-
-		file.setFileName(toTry[0]);
-		if (file.open(QIODevice::WriteOnly)) {
-			file.write(tdfMagic, tdfMagicLen);
-			qint32 version = AppVersion;
-			file.write((const char*)&version, sizeof(version));
-
-			stream.setDevice(&file);
-			stream.setVersion(QDataStream::Qt_5_1);
-		}
+		task.base = ((options & FileOption::User) ? _userBasePath : _basePath) + name;
+		task.safe = (options & FileOption::Safe);
+		valid = true;
 	}
 	bool writeData(const QByteArray &data) {
-		if (!file.isOpen()) return false;
-
-		stream << data;
-		quint32 len = data.isNull() ? 0xffffffff : data.size();
-		if (QSysInfo::ByteOrder != QSysInfo::BigEndian) {
-			len = qbswap(len);
-		}
-		md5.feed(&len, sizeof(len));
-		md5.feed(data.constData(), data.size());
-		dataSize += sizeof(len) + data.size();
+		if (!valid) return false;
 
+		task.parts.push_back({ data, nullptr });
 		return true;
 	}
 	static QByteArray prepareEncrypted(EncryptedDescriptor &data, const MTP::AuthKeyPtr &key = LocalKey) {
 		data.finish();
-		QByteArray &toEncrypt(data.data);
-
-		// prepare for encryption
-		uint32 size = toEncrypt.size(), fullSize = size;
-		if (fullSize & 0x0F) {
-			fullSize += 0x10 - (fullSize & 0x0F);
-			toEncrypt.resize(fullSize);
-			memset_rand(toEncrypt.data() + size, fullSize - size);
-		}
-		*(uint32*)toEncrypt.data() = size;
-		QByteArray encrypted(0x10 + fullSize, Qt::Uninitialized); // 128bit of sha1 - key128, sizeof(data), data
-		hashSha1(toEncrypt.constData(), toEncrypt.size(), encrypted.data());
-		MTP::aesEncryptLocal(toEncrypt.constData(), encrypted.data() + 0x10, fullSize, key, encrypted.constData());
-
-		return encrypted;
+		return PrepareEncrypted(data.data, key);
 	}
 	bool writeEncrypted(EncryptedDescriptor &data, const MTP::AuthKeyPtr &key = LocalKey) {
-		return writeData(prepareEncrypted(data, key));
+		if (!valid) return false;
+
+		data.finish();
+		task.parts.push_back({ data.data, key });
+		return true;
 	}
-	void finish() {
-		if (!file.isOpen()) return;
 
-		stream.setDevice(0);
+	// The serialization is done with the encryption in the background.
+	bool writeEncrypted(
+			FnMut<QByteArray()> prepare,
+			const MTP::AuthKeyPtr &key = LocalKey) {
+		if (!valid) return false;
 
-		md5.feed(&dataSize, sizeof(dataSize));
-		qint32 version = AppVersion;
-		md5.feed(&version, sizeof(version));
-		md5.feed(tdfMagic, tdfMagicLen);
-		file.write((const char*)md5.result(), 0x10);
-		file.close();
-
-		if (!toDelete.isEmpty()) {
-			QFile::remove(toDelete);
-		}
+		task.parts.push_back({ QByteArray(), key, std::move(prepare) });
+		return true;
 	}
-	QFile file;
-	QDataStream stream;
-
-	QString toDelete;
+	void finish() {
+		if (!valid) return;
 
-	HashMd5 md5;
-	int32 dataSize = 0;
+		valid = false;
+		Writer().enqueue(std::move(task));
+	}
+	FileWriter::Task task;
+	bool valid = false;
 
 	~FileWriteDescriptor() {
 		finish();
@@ -331,6 +464,8 @@ bool readFile(FileReadDescriptor &result, const QString &name, FileOptions optio
 		if (!_working()) return false;
 	}
 
+	Writer().flush(((options & FileOption::User) ? _userBasePath : _basePath) + name);
+
 	// detect order of read attempts
 	QString toTry[2];
 	toTry[0] = ((options & FileOption::User) ? _userBasePath : _basePath) + name + '0';
@@ -516,6 +651,7 @@ enum { // Local Storage Keys
 	lskExportSettings = 0x13, // no data
 	lskBackground = 0x14, // no data
 	lskSelfSerialized = 0x15, // serialized self
+	lskSharedMediaCounts = 0x16, // no data
 };
 
 enum {
@@ -641,6 +777,19 @@ FileKey _recentStickersKeyOld = 0;
 FileKey _installedStickersKey = 0, _featuredStickersKey = 0, _recentStickersKey = 0, _favedStickersKey = 0, _archivedStickersKey = 0;
 FileKey _savedGifsKey = 0;
 
+// Each write serializes all the sets of its kind, so a series of changes
+// (like loading many sets one by one) is written once after a timeout.
+enum class StickersWrite {
+	Installed = (1 << 0),
+	Featured = (1 << 1),
+	Recent = (1 << 2),
+	Faved = (1 << 3),
+	Archived = (1 << 4),
+};
+using StickersWrites = base::flags<StickersWrite>;
+inline constexpr auto is_flag_type(StickersWrite) { return true; };
+StickersWrites _stickersWritePending;
+
 FileKey _backgroundKeyDay = 0;
 FileKey _backgroundKeyNight = 0;
 bool _backgroundCanWrite = true;
@@ -661,6 +810,7 @@ qint64 _cacheTotalSizeLimit = Database::Settings().totalSizeLimit;
 qint32 _cacheTotalTimeLimit = Database::Settings().totalTimeLimit;
 
 FileKey _exportSettingsKey = 0;
+FileKey _sharedMediaCountsKey = 0;
 
 FileKey _savedPeersKey = 0;
 FileKey _langPackKey = 0;
@@ -684,6 +834,200 @@ AuthSessionSettings &GetStoredAuthSessionCache() {
 
 void _writeMap(WriteMapWhen when = WriteMapWhen::Soon);
 
+// Changes of the file locations are appended to a log next to the full
+// locations file, so that each download doesn't rewrite all of them.
+// The full file is rewritten when the log grows larger than the list.
+constexpr auto kLocationsLogMinRecords = 256;
+constexpr auto kLocationsLogMaxRecordSize = 1024 * 1024;
+
+enum class LocationsLogRecord : quint32 {
+	Insert = 1,
+	Remove = 2,
+	Alias = 3,
+};
+
+std::unique_ptr<Storage::File> _locationsLog;
+int _locationsLogRecords = 0;
+
+QString _locationsLogPath() {
+	return _userBasePath + toFilePart(_locationsKey) + 'l';
+}
+
+Storage::EncryptionKey _locationsLogKey() {
+	return Storage::EncryptionKey(bytes::make_vector(LocalKey->data()));
+}
+
+void _closeLocationsLog() {
+	_locationsLog = nullptr;
+	_locationsLogRecords = 0;
+}
+
+void _resetLocationsLog() {
+	_closeLocationsLog();
+
+	auto log = std::make_unique<Storage::File>();
+	const auto result = log->open(
+		_locationsLogPath(),
+		Storage::File::Mode::Write,
+		_locationsLogKey());
+	if (result == Storage::File::Result::Success) {
+		_locationsLog = std::move(log);
+	}
+}
+
+void _removeFileLocation(MediaKey location, const QString &fname) {
+	for (auto i = _fileLocations.find(location), e = _fileLocations.end(); (i != e) && (i.key() == location); ++i) {
+		if (i.value().fname == fname) {
+			_fileLocations.erase(i);
+			break;
+		}
+	}
+	_fileLocationPairs.remove(fname);
+}
+
+void _insertFileLocation(MediaKey location, const FileLocation &local) {
+	const auto i = _fileLocationPairs.constFind(local.fname);
+	if (i != _fileLocationPairs.cend()) {
+		_removeFileLocation(i.value().first, local.fname);
+	}
+	_fileLocations.insert(location, local);
+	_fileLocationPairs.insert(local.fname, FileLocationPair(location, local));
+}
+
+template <typename ...Values>
+QByteArray _serializeLocationsLogRecord(
+		LocationsLogRecord type,
+		MediaKey location,
+		const Values &...values) {
+	auto result = QByteArray();
+	{
+		QDataStream stream(&result, QIODevice::WriteOnly);
+		stream.setVersion(QDataStream::Qt_5_1);
+		stream
+			<< quint32(type)
+			<< quint64(location.first)
+			<< quint64(location.second);
+		(stream << ... << values);
+	}
+	return result;
+}
+
+bool _applyLocationsLogRecord(const QByteArray &record) {
+	QDataStream stream(record);
+	stream.setVersion(QDataStream::Qt_5_1);
+	quint32 type = 0;
+	quint64 first = 0, second = 0;
+	stream >> type >> first >> second;
+	const auto location = MediaKey(first, second);
+	switch (LocationsLogRecord(type)) {
+	case LocationsLogRecord::Insert: {
+		FileLocation local;
+		QByteArray bookmark;
+		stream >> local.fname >> bookmark >> local.modified >> local.size;
+		if (stream.status() != QDataStream::Ok) {
+			return false;
+		}
+		local.setBookmark(bookmark);
+		_insertFileLocation(location, local);
+	} return true;
+	case LocationsLogRecord::Remove: {
+		QString fname;
+		stream >> fname;
+		if (stream.status() != QDataStream::Ok) {
+			return false;
+		}
+		_removeFileLocation(location, fname);
+	} return true;
+	case LocationsLogRecord::Alias: {
+		quint64 vfirst = 0, vsecond = 0;
+		stream >> vfirst >> vsecond;
+		if (stream.status() != QDataStream::Ok) {
+			return false;
+		}
+		_fileLocationAliases.insert(location, MediaKey(vfirst, vsecond));
+	} return true;
+	}
+	return false;
+}
+
+std::optional<QByteArray> _readLocationsLogRecord(Storage::File &log) {
+	constexpr auto kBlockSize = int(Storage::CtrState::kBlockSize);
+
+	auto head = QByteArray(kBlockSize, Qt::Uninitialized);
+	const auto read = log.read(bytes::make_detached_span(head));
+	if (!read) {
+		return QByteArray();
+	} else if (read != kBlockSize) {
+		return std::nullopt;
+	}
+	const auto size = qFromBigEndian<quint32>(
+		reinterpret_cast<const uchar*>(head.constData()));
+	if (!size || size > kLocationsLogMaxRecordSize) {
+		return std::nullopt;
+	}
+	const auto full = int(sizeof(quint32) + size);
+	const auto padded = ((full + kBlockSize - 1) / kBlockSize) * kBlockSize;
+	if (padded > kBlockSize) {
+		auto tail = QByteArray(padded - kBlockSize, Qt::Uninitialized);
+		if (log.read(bytes::make_detached_span(tail)) != tail.size()) {
+			return std::nullopt;
+		}
+		head.append(tail);
+	}
+	return head.mid(sizeof(quint32), size);
+}
+
+void _writeLocations(WriteMapWhen when);
+
+void _writeLocationsChange(const QByteArray &record) {
+	const auto limit = std::max(
+		kLocationsLogMinRecords,
+		int(_fileLocations.size()));
+	if (_locationsLog && _locationsLogRecords < limit) {
+		auto framed = QByteArray();
+		{
+			QDataStream stream(&framed, QIODevice::WriteOnly);
+			stream.setVersion(QDataStream::Qt_5_1);
+			stream << record;
+		}
+		if (_locationsLog->writeWithPadding(
+				bytes::make_detached_span(framed))
+			&& _locationsLog->flush()) {
+			++_locationsLogRecords;
+			return;
+		}
+		_closeLocationsLog();
+	}
+	_writeLocations(WriteMapWhen::Fast);
+}
+
+void _readLocationsLog() {
+	auto log = std::make_unique<Storage::File>();
+	const auto result = log->open(
+		_locationsLogPath(),
+		Storage::File::Mode::ReadAppend,
+		_locationsLogKey());
+	if (result != Storage::File::Result::Success) {
+		_writeLocations(WriteMapWhen::Fast);
+		return;
+	}
+	auto records = 0;
+	while (true) {
+		const auto record = _readLocationsLogRecord(*log);
+		if (!record || (!record->isEmpty()
+			&& !_applyLocationsLogRecord(*record))) {
+			// The last record could be written partially, start again.
+			_writeLocations(WriteMapWhen::Fast);
+			return;
+		} else if (record->isEmpty()) {
+			break;
+		}
+		++records;
+	}
+	_locationsLog = std::move(log);
+	_locationsLogRecords = records;
+}
+
 void _writeLocations(WriteMapWhen when = WriteMapWhen::Soon) {
 	if (when != WriteMapWhen::Now) {
 		_manager->writeLocations(when == WriteMapWhen::Fast);
@@ -694,6 +1038,8 @@ void _writeLocations(WriteMapWhen when = WriteMapWhen::Soon) {
 	_manager->writingLocations();
 	if (_fileLocations.isEmpty()) {
 		if (_locationsKey) {
+			_closeLocationsLog();
+			QFile::remove(_locationsLogPath());
 			clearKey(_locationsKey);
 			_locationsKey = 0;
 			_mapChanged = true;
@@ -751,8 +1097,14 @@ void _writeLocations(WriteMapWhen when = WriteMapWhen::Soon) {
 			data.stream << quint64(i.key().first) << quint64(i.key().second) << quint64(i.value().first) << quint64(i.value().second);
 		}
 
-		FileWriteDescriptor file(_locationsKey);
-		file.writeEncrypted(data);
+		{
+			FileWriteDescriptor file(_locationsKey);
+			file.writeEncrypted(data);
+		}
+
+		// The log is started again only after the full file is on disk.
+		Writer().flush(_userBasePath + toFilePart(_locationsKey));
+		_resetLocationsLog();
 	}
 }
 
@@ -810,6 +1162,8 @@ void _readLocations() {
 			}
 		}
 	}
+
+	_readLocationsLog();
 }
 
 void _writeReportSpamStatuses() {
@@ -2189,6 +2543,7 @@ ReadMapState _readMap(const QByteArray &pass) {
 	quint64 savedGifsKey = 0;
 	quint64 backgroundKeyDay = 0, backgroundKeyNight = 0;
 	quint64 userSettingsKey = 0, recentHashtagsAndBotsKey = 0, savedPeersKey = 0, exportSettingsKey = 0;
+	quint64 sharedMediaCountsKey = 0;
 	while (!map.stream.atEnd()) {
 		quint32 keyType;
 		map.stream >> keyType;
@@ -2278,6 +2633,9 @@ ReadMapState _readMap(const QByteArray &pass) {
 		case lskExportSettings: {
 			map.stream >> exportSettingsKey;
 		} break;
+		case lskSharedMediaCounts: {
+			map.stream >> sharedMediaCountsKey;
+		} break;
 		default:
 		LOG(("App Error: unknown key type in encrypted map: %1").arg(keyType));
 		return ReadMapFailed;
@@ -2307,6 +2665,7 @@ ReadMapState _readMap(const QByteArray &pass) {
 	_userSettingsKey = userSettingsKey;
 	_recentHashtagsAndBotsKey = recentHashtagsAndBotsKey;
 	_exportSettingsKey = exportSettingsKey;
+	_sharedMediaCountsKey = sharedMediaCountsKey;
 	_oldMapVersion = mapData.version;
 	if (_oldMapVersion < AppVersion) {
 		_mapChanged = true;
@@ -2407,6 +2766,7 @@ void _writeMap(WriteMapWhen when) {
 	if (_userSettingsKey) mapSize += sizeof(quint32) + sizeof(quint64);
 	if (_recentHashtagsAndBotsKey) mapSize += sizeof(quint32) + sizeof(quint64);
 	if (_exportSettingsKey) mapSize += sizeof(quint32) + sizeof(quint64);
+	if (_sharedMediaCountsKey) mapSize += sizeof(quint32) + sizeof(quint64);
 
 	EncryptedDescriptor mapData(mapSize);
 	if (!self.isEmpty()) {
@@ -2464,16 +2824,65 @@ void _writeMap(WriteMapWhen when) {
 	if (_exportSettingsKey) {
 		mapData.stream << quint32(lskExportSettings) << quint64(_exportSettingsKey);
 	}
+	if (_sharedMediaCountsKey) {
+		mapData.stream << quint32(lskSharedMediaCounts) << quint64(_sharedMediaCountsKey);
+	}
 	map.writeEncrypted(mapData);
 
 	_mapChanged = false;
 }
 
+QByteArray SerializeDrafts(
+		PeerId peer,
+		const MessageDraft &localDraft,
+		const MessageDraft &editDraft) {
+	auto msgTags = TextUtilities::SerializeTags(
+		localDraft.textWithTags.tags);
+	auto editTags = TextUtilities::SerializeTags(
+		editDraft.textWithTags.tags);
+
+	int size = sizeof(quint64);
+	size += Serialize::stringSize(localDraft.textWithTags.text) + Serialize::bytearraySize(msgTags) + 2 * sizeof(qint32);
+	size += Serialize::stringSize(editDraft.textWithTags.text) + Serialize::bytearraySize(editTags) + 2 * sizeof(qint32);
+
+	EncryptedDescriptor data(size);
+	data.stream << quint64(peer);
+	data.stream << localDraft.textWithTags.text << msgTags;
+	data.stream << qint32(localDraft.msgId) << qint32(localDraft.previewCancelled ? 1 : 0);
+	data.stream << editDraft.textWithTags.text << editTags;
+	data.stream << qint32(editDraft.msgId) << qint32(editDraft.previewCancelled ? 1 : 0);
+	data.finish();
+	return data.data;
+}
+
+base::flat_map<uint8, int64> CacheTagSizeLimits(int64 totalSizeLimit) {
+	// Large animations and video messages can't take all the cache,
+	// so watching them doesn't evict stickers and userpics.
+	const auto limit = totalSizeLimit / kCacheHeavyTagsSizeShare;
+	auto result = base::flat_map<uint8, int64>();
+	result.emplace(Data::kAnimationCacheTag, limit);
+	result.emplace(Data::kVideoMessageCacheTag, limit);
+	return result;
+}
+
+base::flat_map<uint8, int> CacheTagPriorities() {
+	auto result = base::flat_map<uint8, int>();
+	result.emplace(Data::kImageCacheTag, 1);
+	result.emplace(Data::kStickerCacheTag, 1);
+	result.emplace(Data::kVoiceMessageCacheTag, 1);
+	return result;
+}
+
 } // namespace
 
+void _writePendingStickers();
+
 void finish() {
 	if (_manager) {
+		_writePendingStickers();
 		_writeMap(WriteMapWhen::Now);
+		Writer().flushAll();
+		_closeLocationsLog();
 		_manager->finish();
 		_manager->deleteLater();
 		_manager = 0;
@@ -2539,8 +2948,14 @@ void start() {
 	_oldSettingsVersion = settingsData.version;
 	_settingsSalt = salt;
 
-	loadTheme();
-	readLangPack();
+	{
+		const auto trace = Core::StartupTrace::Scope("Local theme");
+		loadTheme();
+	}
+	{
+		const auto trace = Core::StartupTrace::Scope("Local lang pack");
+		readLangPack();
+	}
 
 	applyReadContext(std::move(context));
 }
@@ -2708,6 +3123,9 @@ void reset() {
 	if (_localLoader) {
 		_localLoader->stop();
 	}
+	Writer().flushAll();
+
+	_closeLocationsLog();
 
 	_passKeySalt.clear(); // reset passcode, local key
 	_draftsMap.clear();
@@ -2719,10 +3137,12 @@ void reset() {
 	_locationsKey = _reportSpamStatusesKey = _trustedBotsKey = 0;
 	_recentStickersKeyOld = 0;
 	_installedStickersKey = _featuredStickersKey = _recentStickersKey = _favedStickersKey = _archivedStickersKey = 0;
+	_stickersWritePending = StickersWrites();
 	_savedGifsKey = 0;
 	_backgroundKeyDay = _backgroundKeyNight = 0;
 	Window::Theme::Background()->reset();
 	_userSettingsKey = _recentHashtagsAndBotsKey = _savedPeersKey = _exportSettingsKey = 0;
+	_sharedMediaCountsKey = 0;
 	_oldMapVersion = _oldSettingsVersion = 0;
 	_cacheTotalSizeLimit = Database::Settings().totalSizeLimit;
 	_cacheTotalTimeLimit = Database::Settings().totalTimeLimit;
@@ -2739,6 +3159,19 @@ bool checkPasscode(const QByteArray &passcode) {
 	return checkKey->equals(PassKey);
 }
 
+void checkPasscodeAsync(
+		const QByteArray &passcode,
+		Fn<void(bool correct)> callback) {
+	// The key derivation is slow on purpose, don't freeze the lock screen.
+	crl::async([=, salt = _passKeySalt]() mutable {
+		auto checkKey = MTP::AuthKeyPtr();
+		createLocalKey(passcode, &salt, &checkKey);
+		crl::on_main([=] {
+			callback(PassKey && checkKey->equals(PassKey));
+		});
+	});
+}
+
 void setPasscode(const QByteArray &passcode) {
 	createLocalKey(passcode, &_passKeySalt, &PassKey);
 
@@ -2769,6 +3202,7 @@ base::flat_set<QString> CollectGoodNames() {
 		_backgroundKeyDay,
 		_recentHashtagsAndBotsKey,
 		_exportSettingsKey,
+		_sharedMediaCountsKey,
 		_savedPeersKey,
 		_trustedBotsKey
 	};
@@ -2791,6 +3225,9 @@ base::flat_set<QString> CollectGoodNames() {
 	for (const auto &value : keys) {
 		push(value);
 	}
+	if (_locationsKey) {
+		result.emplace(toFilePart(_locationsKey) + 'l');
+	}
 	return result;
 }
 
@@ -2841,24 +3278,11 @@ void writeDrafts(const PeerId &peer, const MessageDraft &localDraft, const Messa
 			_writeMap(WriteMapWhen::Fast);
 		}
 
-		auto msgTags = TextUtilities::SerializeTags(
-			localDraft.textWithTags.tags);
-		auto editTags = TextUtilities::SerializeTags(
-			editDraft.textWithTags.tags);
-
-		int size = sizeof(quint64);
-		size += Serialize::stringSize(localDraft.textWithTags.text) + Serialize::bytearraySize(msgTags) + 2 * sizeof(qint32);
-		size += Serialize::stringSize(editDraft.textWithTags.text) + Serialize::bytearraySize(editTags) + 2 * sizeof(qint32);
-
-		EncryptedDescriptor data(size);
-		data.stream << quint64(peer);
-		data.stream << localDraft.textWithTags.text << msgTags;
-		data.stream << qint32(localDraft.msgId) << qint32(localDraft.previewCancelled ? 1 : 0);
-		data.stream << editDraft.textWithTags.text << editTags;
-		data.stream << qint32(editDraft.msgId) << qint32(editDraft.previewCancelled ? 1 : 0);
-
+		// Only a snapshot of the drafts is taken on the main thread.
 		FileWriteDescriptor file(i.value());
-		file.writeEncrypted(data);
+		file.writeEncrypted([=] {
+			return SerializeDrafts(peer, localDraft, editDraft);
+		});
 
 		_draftsNotReadMap.remove(peer);
 	}
@@ -3020,28 +3444,26 @@ void writeFileLocation(MediaKey location, const FileLocation &local) {
 		location = aliasIt.value();
 	}
 
-	FileLocationPairs::iterator i = _fileLocationPairs.find(local.fname);
-	if (i != _fileLocationPairs.cend()) {
-		if (i.value().second == local) {
-			if (i.value().first != location) {
-				_fileLocationAliases.insert(location, i.value().first);
-				_writeLocations(WriteMapWhen::Fast);
-			}
-			return;
-		}
+	FileLocationPairs::const_iterator i = _fileLocationPairs.constFind(local.fname);
+	if (i != _fileLocationPairs.cend() && i.value().second == local) {
 		if (i.value().first != location) {
-			for (FileLocations::iterator j = _fileLocations.find(i.value().first), e = _fileLocations.end(); (j != e) && (j.key() == i.value().first);) {
-				if (j.value() == i.value().second) {
-					_fileLocations.erase(j);
-					break;
-				}
-			}
-			_fileLocationPairs.erase(i);
+			_fileLocationAliases.insert(location, i.value().first);
+			_writeLocationsChange(_serializeLocationsLogRecord(
+				LocationsLogRecord::Alias,
+				location,
+				quint64(i.value().first.first),
+				quint64(i.value().first.second)));
 		}
+		return;
 	}
-	_fileLocations.insert(location, local);
-	_fileLocationPairs.insert(local.fname, FileLocationPair(location, local));
-	_writeLocations(WriteMapWhen::Fast);
+	_insertFileLocation(location, local);
+	_writeLocationsChange(_serializeLocationsLogRecord(
+		LocationsLogRecord::Insert,
+		location,
+		local.name(),
+		local.bookmark(),
+		local.modified,
+		qint32(local.size)));
 }
 
 FileLocation readFileLocation(MediaKey location, bool check) {
@@ -3054,9 +3476,13 @@ FileLocation readFileLocation(MediaKey location, bool check) {
 	for (FileLocations::iterator i = _fileLocations.find(location); (i != _fileLocations.end()) && (i.key() == location);) {
 		if (check) {
 			if (!i.value().check()) {
-				_fileLocationPairs.remove(i.value().fname);
+				const auto fname = i.value().fname;
+				_fileLocationPairs.remove(fname);
 				i = _fileLocations.erase(i);
-				_writeLocations();
+				_writeLocationsChange(_serializeLocationsLogRecord(
+					LocationsLogRecord::Remove,
+					location,
+					fname));
 				continue;
 			}
 		}
@@ -3107,6 +3533,12 @@ Storage::Cache::Database::Settings cacheSettings() {
 	result.totalSizeLimit = _cacheTotalSizeLimit;
 	result.totalTimeLimit = _cacheTotalTimeLimit;
 	result.maxDataSize = Storage::kMaxFileInMemory;
+	result.compactBytesPerSecond = kCacheCompactBytesPerSecond;
+	result.compactPauseLatency = kCacheCompactPauseLatency;
+	result.evictionPolicy = Database::EvictionPolicy::Frequency;
+	result.snapshotAfterBytes = kCacheSnapshotAfterBytes;
+	result.tagSizeLimits = CacheTagSizeLimits(_cacheTotalSizeLimit);
+	result.tagPriorities = CacheTagPriorities();
 	return result;
 }
 
@@ -3114,6 +3546,7 @@ void updateCacheSettings(Storage::Cache::Database::SettingsUpdate &update) {
 	Expects(update.totalSizeLimit > Database::Settings().maxDataSize);
 	Expects(update.totalTimeLimit >= 0);
 
+	update.tagSizeLimits = CacheTagSizeLimits(update.totalSizeLimit);
 	if (_cacheTotalSizeLimit == update.totalSizeLimit
 		&& _cacheTotalTimeLimit == update.totalTimeLimit) {
 		return;
@@ -3150,6 +3583,11 @@ public:
 			if (!_waveform.isEmpty()) {
 				voice->waveform = _waveform;
 				voice->wavemax = _wavemax;
+				Auth().data().cache().put(
+					_doc->waveformCacheKey(),
+					Storage::Cache::Database::TaggedValue{
+						documentWaveformEncode5bit(_waveform),
+						Data::kVoiceMessageCacheTag });
 			}
 			if (voice->waveform.isEmpty()) {
 				voice->waveform.resize(1);
@@ -3177,14 +3615,47 @@ protected:
 
 };
 
+void _voiceWaveformCacheLoaded(
+		not_null<DocumentData*> document,
+		const QByteArray &value) {
+	const auto voice = document->voice();
+	if (!voice
+		|| !_localLoader
+		|| voice->waveform.isEmpty()
+		|| voice->waveform[0] != -1) {
+		return;
+	}
+	const auto waveform = documentWaveformDecode(value);
+	if (waveform.isEmpty()) {
+		TaskId taskId = _localLoader->addTask(
+			std::make_unique<CountWaveformTask>(document));
+		memcpy(voice->waveform.data() + 1, &taskId, sizeof(taskId));
+		return;
+	}
+	voice->waveform = waveform;
+	voice->wavemax = *ranges::max_element(waveform, [](char a, char b) {
+		return uchar(a) < uchar(b);
+	});
+	Auth().data().requestDocumentViewRepaint(document);
+}
+
 void countVoiceWaveform(DocumentData *document) {
 	if (const auto voice = document->voice()) {
 		if (_localLoader) {
+			// Counting, the task id is empty while the cache is checked.
 			voice->waveform.resize(1 + sizeof(TaskId));
-			voice->waveform[0] = -1; // counting
-			TaskId taskId = _localLoader->addTask(
-				std::make_unique<CountWaveformTask>(document));
+			voice->waveform[0] = -1;
+			const auto taskId = TaskId(nullptr);
 			memcpy(voice->waveform.data() + 1, &taskId, sizeof(taskId));
+
+			auto callback = [=](QByteArray &&value) {
+				crl::on_main(&Auth(), [=, value = std::move(value)] {
+					_voiceWaveformCacheLoaded(document, value);
+				});
+			};
+			Auth().data().cache().get(
+				document->waveformCacheKey(),
+				std::move(callback));
 		}
 	}
 }
@@ -3524,7 +3995,14 @@ void _readStickerSets(FileKey &stickersKey, Stickers::Order *outOrder = nullptr,
 	}
 }
 
-void writeInstalledStickers() {
+void _scheduleStickersWrite(StickersWrite what) {
+	if (!_working()) return;
+
+	_stickersWritePending |= what;
+	_manager->writeStickers();
+}
+
+void _writeInstalledStickers() {
 	if (!Global::started()) return;
 
 	_writeStickerSets(_installedStickersKey, [](const Stickers::Set &set) {
@@ -3545,7 +4023,7 @@ void writeInstalledStickers() {
 	}, Auth().data().stickerSetsOrder());
 }
 
-void writeFeaturedStickers() {
+void _writeFeaturedStickers() {
 	if (!Global::started()) return;
 
 	_writeStickerSets(_featuredStickersKey, [](const Stickers::Set &set) {
@@ -3564,7 +4042,7 @@ void writeFeaturedStickers() {
 	}, Auth().data().featuredStickerSetsOrder());
 }
 
-void writeRecentStickers() {
+void _writeRecentStickers() {
 	if (!Global::started()) return;
 
 	_writeStickerSets(_recentStickersKey, [](const Stickers::Set &set) {
@@ -3575,7 +4053,7 @@ void writeRecentStickers() {
 	}, Stickers::Order());
 }
 
-void writeFavedStickers() {
+void _writeFavedStickers() {
 	if (!Global::started()) return;
 
 	_writeStickerSets(_favedStickersKey, [](const Stickers::Set &set) {
@@ -3586,7 +4064,7 @@ void writeFavedStickers() {
 	}, Stickers::Order());
 }
 
-void writeArchivedStickers() {
+void _writeArchivedStickers() {
 	if (!Global::started()) return;
 
 	_writeStickerSets(_archivedStickersKey, [](const Stickers::Set &set) {
@@ -3597,6 +4075,48 @@ void writeArchivedStickers() {
 	}, Auth().data().archivedStickerSetsOrder());
 }
 
+void _writePendingStickers() {
+	const auto pending = base::take(_stickersWritePending);
+	if (!pending || !AuthSession::Exists()) {
+		return;
+	}
+	if (pending & StickersWrite::Installed) {
+		_writeInstalledStickers();
+	}
+	if (pending & StickersWrite::Featured) {
+		_writeFeaturedStickers();
+	}
+	if (pending & StickersWrite::Recent) {
+		_writeRecentStickers();
+	}
+	if (pending & StickersWrite::Faved) {
+		_writeFavedStickers();
+	}
+	if (pending & StickersWrite::Archived) {
+		_writeArchivedStickers();
+	}
+}
+
+void writeInstalledStickers() {
+	_scheduleStickersWrite(StickersWrite::Installed);
+}
+
+void writeFeaturedStickers() {
+	_scheduleStickersWrite(StickersWrite::Featured);
+}
+
+void writeRecentStickers() {
+	_scheduleStickersWrite(StickersWrite::Recent);
+}
+
+void writeFavedStickers() {
+	_scheduleStickersWrite(StickersWrite::Faved);
+}
+
+void writeArchivedStickers() {
+	_scheduleStickersWrite(StickersWrite::Archived);
+}
+
 void importOldRecentStickers() {
 	if (!_recentStickersKeyOld) return;
 
@@ -4473,6 +4993,92 @@ Export::Settings ReadExportSettings() {
 		: Export::Settings();
 }
 
+void WriteSharedMediaCounts(const Storage::SharedMediaCountsMap &counts) {
+	if (!_working()) return;
+
+	if (counts.empty()) {
+		if (_sharedMediaCountsKey) {
+			clearKey(_sharedMediaCountsKey);
+			_sharedMediaCountsKey = 0;
+			_mapChanged = true;
+		}
+		_writeMap();
+	} else {
+		if (!_sharedMediaCountsKey) {
+			_sharedMediaCountsKey = genKey();
+			_mapChanged = true;
+			_writeMap(WriteMapWhen::Fast);
+		}
+		quint32 size = sizeof(quint32);
+		for (const auto &[peerId, entry] : counts) {
+			size += sizeof(quint64) + sizeof(qint32) + sizeof(quint32);
+			for (const auto &count : entry.counts) {
+				size += count ? sizeof(qint32) : 0;
+			}
+		}
+		EncryptedDescriptor data(size);
+		data.stream << quint32(counts.size());
+		for (const auto &[peerId, entry] : counts) {
+			auto known = quint32(0);
+			const auto types = Storage::kSharedMediaTypeCount;
+			for (auto index = 0; index != types; ++index) {
+				known |= entry.counts[index] ? (1U << index) : 0U;
+			}
+			data.stream
+				<< quint64(peerId)
+				<< qint32(entry.topMessageId)
+				<< known;
+			for (const auto &count : entry.counts) {
+				if (count) {
+					data.stream << qint32(*count);
+				}
+			}
+		}
+
+		FileWriteDescriptor file(_sharedMediaCountsKey);
+		file.writeEncrypted(data);
+	}
+}
+
+Storage::SharedMediaCountsMap ReadSharedMediaCounts() {
+	if (!_sharedMediaCountsKey) {
+		return {};
+	}
+
+	FileReadDescriptor file;
+	if (!readEncryptedFile(file, _sharedMediaCountsKey)) {
+		clearKey(_sharedMediaCountsKey);
+		_sharedMediaCountsKey = 0;
+		_writeMap();
+		return {};
+	}
+
+	auto result = Storage::SharedMediaCountsMap();
+	quint32 size = 0;
+	file.stream >> size;
+	for (auto i = quint32(); i != size; ++i) {
+		quint64 peerId = 0;
+		qint32 topMessageId = 0;
+		quint32 known = 0;
+		file.stream >> peerId >> topMessageId >> known;
+		auto entry = Storage::SharedMediaCounts();
+		entry.topMessageId = topMessageId;
+		const auto types = Storage::kSharedMediaTypeCount;
+		for (auto index = 0; index != types; ++index) {
+			if (known & (1U << index)) {
+				qint32 count = 0;
+				file.stream >> count;
+				entry.counts[index] = count;
+			}
+		}
+		if (!_checkStreamStatus(file.stream)) {
+			return {};
+		}
+		result.emplace(PeerId(peerId), entry);
+	}
+	return result;
+}
+
 void writeSavedPeers() {
 	if (!_working()) return;
 
@@ -4754,6 +5360,8 @@ bool ClearManager::hasTask(ClearManagerTask task) {
 }
 
 void ClearManager::start() {
+	Writer().flushAll();
+	_closeLocationsLog();
 	moveToThread(data->thread);
 	connect(data->thread, SIGNAL(started()), this, SLOT(onStart()));
 	connect(data->thread, SIGNAL(finished()), data->thread, SLOT(deleteLater()));
@@ -4836,6 +5444,8 @@ Manager::Manager() {
 	connect(&_mapWriteTimer, SIGNAL(timeout()), this, SLOT(mapWriteTimeout()));
 	_locationsWriteTimer.setSingleShot(true);
 	connect(&_locationsWriteTimer, SIGNAL(timeout()), this, SLOT(locationsWriteTimeout()));
+	_stickersWriteTimer.setSingleShot(true);
+	connect(&_stickersWriteTimer, SIGNAL(timeout()), this, SLOT(stickersWriteTimeout()));
 }
 
 void Manager::writeMap(bool fast) {
@@ -4862,6 +5472,12 @@ void Manager::writingLocations() {
 	_locationsWriteTimer.stop();
 }
 
+void Manager::writeStickers() {
+	if (!_stickersWriteTimer.isActive()) {
+		_stickersWriteTimer.start(WriteMapTimeout);
+	}
+}
+
 void Manager::mapWriteTimeout() {
 	_writeMap(WriteMapWhen::Now);
 }
@@ -4870,7 +5486,12 @@ void Manager::locationsWriteTimeout() {
 	_writeLocations(WriteMapWhen::Now);
 }
 
+void Manager::stickersWriteTimeout() {
+	_writePendingStickers();
+}
+
 void Manager::finish() {
+	_stickersWriteTimer.stop();
 	if (_mapWriteTimer.isActive()) {
 		mapWriteTimeout();
 	}
@@ -14,6 +14,8 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 
 namespace Storage {
 class EncryptionKey;
+struct SharedMediaCounts;
+using SharedMediaCountsMap = base::flat_map<PeerId, SharedMediaCounts>;
 } // namespace Storage
 
 namespace Window {
@@ -42,6 +44,9 @@ QString readAutoupdatePrefix();
 void reset();
 
 bool checkPasscode(const QByteArray &passcode);
+void checkPasscodeAsync(
+	const QByteArray &passcode,
+	Fn<void(bool correct)> callback);
 void setPasscode(const QByteArray &passcode);
 
 enum ClearManagerTask {
@@ -150,6 +155,9 @@ void saveRecentSearchHashtags(const QString &text);
 void WriteExportSettings(const Export::Settings &settings);
 Export::Settings ReadExportSettings();
 
+void WriteSharedMediaCounts(const Storage::SharedMediaCountsMap &counts);
+Storage::SharedMediaCountsMap ReadSharedMediaCounts();
+
 void addSavedPeer(PeerData *peer, const QDateTime &position);
 void removeSavedPeer(PeerData *peer);
 void readSavedPeers();
@@ -177,15 +185,18 @@ public:
 	void writingMap();
 	void writeLocations(bool fast);
 	void writingLocations();
+	void writeStickers();
 	void finish();
 
 public slots:
 	void mapWriteTimeout();
 	void locationsWriteTimeout();
+	void stickersWriteTimeout();
 
 private:
 	QTimer _mapWriteTimer;
 	QTimer _locationsWriteTimer;
+	QTimer _stickersWriteTimer;
 
 };
 
@@ -9,6 +9,11 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 
 #include "base/openssl_help.h"
 
+#ifdef OS_POSIX
+#include <sys/mman.h>
+#include <unistd.h>
+#endif // OS_POSIX
+
 namespace Storage {
 namespace {
 
@@ -41,6 +46,22 @@ BasicHeader::BasicHeader()
 , reserved1(0) {
 }
 
+void PrepareMappedRead(uchar *data, int64 size) {
+#ifdef OS_POSIX
+	// Ask for the whole range at once instead of faulting page by page.
+	static const auto kPageSize = int64(sysconf(_SC_PAGESIZE));
+	if (kPageSize <= 0) {
+		return;
+	}
+	const auto address = reinterpret_cast<uintptr_t>(data);
+	const auto aligned = address - (address % uintptr_t(kPageSize));
+	posix_madvise(
+		reinterpret_cast<void*>(aligned),
+		size + int64(address - aligned),
+		POSIX_MADV_WILLNEED);
+#endif // OS_POSIX
+}
+
 } // namespace
 
 File::Result File::open(
@@ -262,6 +283,55 @@ size_type File::readWithPadding(bytes::span bytes) {
 	return size;
 }
 
+size_type File::readWithPaddingMapped(bytes::span bytes) {
+	const auto size = bytes.size();
+	const auto part = size % kBlockSize;
+	const auto padded = int64(size - part + (part ? kBlockSize : 0));
+	if (!padded || offset() + padded > _dataSize) {
+		return readWithPadding(bytes);
+	}
+	const auto read = readMapped(bytes, padded);
+	return (read >= 0) ? read : readWithPadding(bytes);
+}
+
+size_type File::readMapped(bytes::span bytes, int64 padded) {
+	Expects(padded >= bytes.size());
+	Expects(padded % kBlockSize == 0);
+
+	const auto from = offset();
+	const auto realOffset = FileLock::kSkipBytes
+		+ int64(sizeof(BasicHeader))
+		+ from;
+	const auto mapped = _data.map(realOffset, padded);
+	if (!mapped) {
+		return -1;
+	}
+	PrepareMappedRead(mapped, padded);
+
+	const auto size = bytes.size();
+	const auto part = size % kBlockSize;
+	const auto good = size - part;
+	const auto source = bytes::make_span(
+		static_cast<const uchar*>(mapped),
+		padded);
+	if (good) {
+		bytes::copy(bytes, source.subspan(0, good));
+		decrypt(bytes.subspan(0, good));
+	}
+	if (part) {
+		auto storage = bytes::array<kBlockSize>();
+		const auto tail = bytes::make_span(storage);
+		bytes::copy(tail, source.subspan(good, kBlockSize));
+		decrypt(tail);
+		bytes::copy(bytes.subspan(good), tail.subspan(0, part));
+	}
+	_data.unmap(mapped);
+	if (!seek(from + padded)) {
+		return 0;
+	}
+	return size;
+}
+
 bool File::writeWithPadding(bytes::span bytes) {
 	const auto size = bytes.size();
 	const auto part = size % kBlockSize;
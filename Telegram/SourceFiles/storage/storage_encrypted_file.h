@@ -35,6 +35,9 @@ public:
 	size_type readWithPadding(bytes::span bytes);
 	bool writeWithPadding(bytes::span bytes);
 
+	// Decrypts from the memory mapped file, falls back to plain reading.
+	size_type readWithPaddingMapped(bytes::span bytes);
+
 	bool flush();
 
 	bool isOpen() const;
@@ -56,6 +59,7 @@ private:
 	Result readHeader(const EncryptionKey &key);
 
 	size_type readPlain(bytes::span bytes);
+	size_type readMapped(bytes::span bytes, int64 padded);
 	size_type writePlain(bytes::const_span bytes);
 	void decrypt(bytes::span bytes);
 	void encrypt(bytes::span bytes);
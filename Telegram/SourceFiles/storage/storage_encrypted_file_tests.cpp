@@ -166,6 +166,77 @@ TEST_CASE("simple encrypted file", "[storage_encrypted_file]") {
 	}
 }
 
+TEST_CASE("mapped encrypted file reading", "[storage_encrypted_file]") {
+	const auto value = bytes::make_span("testbytetestbytetestbyte")
+		.subspan(0, 24);
+	SECTION("writing file with padding") {
+		Storage::File file;
+		const auto result = file.open(
+			Name,
+			Storage::File::Mode::Write,
+			Key);
+		REQUIRE(result == Storage::File::Result::Success);
+
+		auto data = bytes::make_vector(value);
+		const auto success = file.writeWithPadding(data);
+		REQUIRE(success);
+	}
+	SECTION("reading file mapped") {
+		Storage::File file;
+		const auto result = file.open(
+			Name,
+			Storage::File::Mode::Read,
+			Key);
+		REQUIRE(result == Storage::File::Result::Success);
+
+		auto data = bytes::vector(value.size());
+		const auto read = file.readWithPaddingMapped(data);
+		REQUIRE(read == data.size());
+		REQUIRE(data == bytes::make_vector(value));
+		REQUIRE(file.offset() == 32);
+	}
+}
+
+TEST_CASE("large block encrypted file", "[storage_encrypted_file]") {
+	const auto value = [] {
+		auto result = bytes::vector(4 * 1024 * 1024 + 48);
+		for (auto i = 0, count = int(result.size()); i != count; ++i) {
+			result[i] = bytes::type(i % 251);
+		}
+		return result;
+	}();
+	SECTION("writing file in one block") {
+		Storage::File file;
+		const auto result = file.open(
+			Name,
+			Storage::File::Mode::Write,
+			Key);
+		REQUIRE(result == Storage::File::Result::Success);
+
+		auto data = value;
+		const auto success = file.write(data);
+		REQUIRE(success);
+	}
+	SECTION("reading file in small blocks") {
+		Storage::File file;
+		const auto result = file.open(
+			Name,
+			Storage::File::Mode::Read,
+			Key);
+		REQUIRE(result == Storage::File::Result::Success);
+
+		auto data = bytes::vector(value.size());
+		const auto part = 16 * 1024;
+		for (auto offset = 0; offset < int(data.size()); offset += part) {
+			const auto till = std::min(offset + part, int(data.size()));
+			const auto read = file.read(
+				bytes::make_span(data).subspan(offset, till - offset));
+			REQUIRE(read == till - offset);
+		}
+		REQUIRE(data == value);
+	}
+}
+
 TEST_CASE("two process encrypted file", "[storage_encrypted_file]") {
 	SECTION("writing file") {
 		Storage::File file;
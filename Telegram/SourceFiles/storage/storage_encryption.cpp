@@ -9,6 +9,10 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 
 #include "base/openssl_help.h"
 
+#include <QtCore/QSemaphore>
+#include <QtCore/QThread>
+#include <atomic>
+
 namespace Storage {
 
 CtrState::CtrState(bytes::const_span key, bytes::const_span iv) {
@@ -19,31 +23,100 @@ CtrState::CtrState(bytes::const_span key, bytes::const_span iv) {
 	bytes::copy(_iv, iv);
 }
 
-template <typename Method>
-void CtrState::process(bytes::span data, int64 offset, Method method) {
+void CtrState::process(bytes::span data, int64 offset) {
 	Expects((data.size() % kBlockSize) == 0);
 	Expects((offset % kBlockSize) == 0);
 
-	AES_KEY aes;
-	AES_set_encrypt_key(
-		reinterpret_cast<const uchar*>(_key.data()),
-		_key.size() * CHAR_BIT,
-		&aes);
-
-	unsigned char ecountBuf[kBlockSize] = { 0 };
-	unsigned int offsetInBlock = 0;
 	const auto blockIndex = offset / kBlockSize;
-	auto iv = incrementedIv(blockIndex);
-
-	CRYPTO_ctr128_encrypt(
-		reinterpret_cast<const uchar*>(data.data()),
-		reinterpret_cast<uchar*>(data.data()),
-		data.size(),
-		&aes,
-		reinterpret_cast<unsigned char*>(iv.data()),
-		ecountBuf,
-		&offsetInBlock,
-		(block128_f)method);
+	const auto threads = std::min(
+		QThread::idealThreadCount(),
+		int(data.size() / kParallelChunkSize));
+	if (data.size() < kParallelMinimalSize || threads < 2) {
+		ProcessChunk(_key, incrementedIv(blockIndex), data);
+	} else {
+		processParallel(data, blockIndex, threads);
+	}
+}
+
+void CtrState::ProcessChunk(
+		const bytes::array<kKeySize> &key,
+		const bytes::array<kIvSize> &iv,
+		bytes::span data) {
+	const auto context = EVP_CIPHER_CTX_new();
+	Assert(context != nullptr);
+	const auto guard = gsl::finally([&] { EVP_CIPHER_CTX_free(context); });
+
+	EVP_EncryptInit_ex(
+		context,
+		EVP_aes_256_ctr(),
+		nullptr,
+		reinterpret_cast<const uchar*>(key.data()),
+		reinterpret_cast<const uchar*>(iv.data()));
+	auto left = data;
+	while (!left.empty()) {
+		const auto part = std::min(left.size(), kParallelChunkSize);
+		auto written = 0;
+		EVP_EncryptUpdate(
+			context,
+			reinterpret_cast<uchar*>(left.data()),
+			&written,
+			reinterpret_cast<const uchar*>(left.data()),
+			int(part));
+		Assert(written == part);
+		left = left.subspan(part);
+	}
+}
+
+void CtrState::processParallel(
+		bytes::span data,
+		int64 blockIndex,
+		int threads) {
+	struct Shared {
+		bytes::array<kKeySize> key;
+		std::vector<bytes::array<kIvSize>> ivs;
+		bytes::span data;
+		std::atomic<size_type> next{ 0 };
+		QSemaphore finished;
+	};
+	const auto shared = std::make_shared<Shared>();
+	const auto count = (data.size() + kParallelChunkSize - 1)
+		/ kParallelChunkSize;
+	const auto chunkBlocks = kParallelChunkSize / kBlockSize;
+	shared->key = _key;
+	shared->data = data;
+	shared->ivs.reserve(count);
+	for (auto i = size_type(0); i != count; ++i) {
+		shared->ivs.push_back(incrementedIv(blockIndex + i * chunkBlocks));
+	}
+
+	// Counter ranges of the chunks are independent in CTR mode. Chunks
+	// are taken one by one both by the workers and by the calling thread,
+	// so we never wait for a worker task that didn't start yet.
+	const auto work = [=] {
+		auto processed = 0;
+		while (true) {
+			const auto index = shared->next++;
+			if (index >= count) {
+				return processed;
+			}
+			const auto from = index * kParallelChunkSize;
+			const auto till = std::min(
+				from + kParallelChunkSize,
+				size_type(shared->data.size()));
+			ProcessChunk(
+				shared->key,
+				shared->ivs[index],
+				shared->data.subspan(from, till - from));
+			++processed;
+		}
+	};
+	for (auto i = 1; i != threads; ++i) {
+		crl::async([=] {
+			shared->finished.release(work());
+		});
+	}
+	const auto mine = work();
+	shared->finished.acquire(int(count - mine));
 }
 
 auto CtrState::incrementedIv(int64 blockIndex)
@@ -66,11 +139,11 @@ auto CtrState::incrementedIv(int64 blockIndex)
 }
 
 void CtrState::encrypt(bytes::span data, int64 offset) {
-	return process(data, offset, AES_encrypt);
+	return process(data, offset);
 }
 
 void CtrState::decrypt(bytes::span data, int64 offset) {
-	return process(data, offset, AES_encrypt);
+	return process(data, offset);
 }
 
 EncryptionKey::EncryptionKey(bytes::vector &&data)
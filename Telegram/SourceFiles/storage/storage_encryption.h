@@ -25,8 +25,17 @@ public:
 	void decrypt(bytes::span data, int64 offset);
 
 private:
-	template <typename Method>
-	void process(bytes::span data, int64 offset, Method method);
+	// Large buffers are split into chunks processed on worker threads.
+	static constexpr auto kParallelMinimalSize = size_type(1024 * 1024);
+	static constexpr auto kParallelChunkSize = size_type(256 * 1024);
+
+	static void ProcessChunk(
+		const bytes::array<kKeySize> &key,
+		const bytes::array<kIvSize> &iv,
+		bytes::span data);
+
+	void process(bytes::span data, int64 offset);
+	void processParallel(bytes::span data, int64 blockIndex, int threads);
 
 	bytes::array<kIvSize> incrementedIv(int64 blockIndex);
 
@@ -26,6 +26,9 @@ public:
 	rpl::producer<SharedMediaRemoveOne> sharedMediaOneRemoved() const;
 	rpl::producer<SharedMediaRemoveAll> sharedMediaAllRemoved() const;
 	rpl::producer<SharedMediaInvalidateBottom> sharedMediaBottomInvalidated() const;
+	void restoreSharedMediaCounts(SharedMediaCountsMap &&counts);
+	void validateSharedMediaCounts(PeerId peerId, MsgId topMessageId);
+	SharedMediaCountsMap collectSharedMediaCounts() const;
 
 	void add(UserPhotosAddNew &&query);
 	void add(UserPhotosAddSlice &&query);
@@ -99,6 +102,20 @@ rpl::producer<SharedMediaInvalidateBottom> Facade::Impl::sharedMediaBottomInvali
 	return _sharedMedia.bottomInvalidated();
 }
 
+void Facade::Impl::restoreSharedMediaCounts(SharedMediaCountsMap &&counts) {
+	_sharedMedia.restoreCounts(std::move(counts));
+}
+
+void Facade::Impl::validateSharedMediaCounts(
+		PeerId peerId,
+		MsgId topMessageId) {
+	_sharedMedia.validateCounts(peerId, topMessageId);
+}
+
+SharedMediaCountsMap Facade::Impl::collectSharedMediaCounts() const {
+	return _sharedMedia.collectCounts();
+}
+
 void Facade::Impl::add(UserPhotosAddNew &&query) {
 	return _userPhotos.add(std::move(query));
 }
@@ -219,6 +236,18 @@ rpl::producer<SharedMediaInvalidateBottom> Facade::sharedMediaBottomInvalidated(
 	return _impl->sharedMediaBottomInvalidated();
 }
 
+void Facade::restoreSharedMediaCounts(SharedMediaCountsMap &&counts) {
+	_impl->restoreSharedMediaCounts(std::move(counts));
+}
+
+void Facade::validateSharedMediaCounts(PeerId peerId, MsgId topMessageId) {
+	_impl->validateSharedMediaCounts(peerId, topMessageId);
+}
+
+SharedMediaCountsMap Facade::collectSharedMediaCounts() const {
+	return _impl->collectSharedMediaCounts();
+}
+
 void Facade::add(UserPhotosAddNew &&query) {
 	return _impl->add(std::move(query));
 }
@@ -27,6 +27,8 @@ struct SharedMediaInvalidateBottom;
 struct SharedMediaQuery;
 using SharedMediaResult = SparseIdsListResult;
 struct SharedMediaSliceUpdate;
+struct SharedMediaCounts;
+using SharedMediaCountsMap = base::flat_map<PeerId, SharedMediaCounts>;
 
 struct UserPhotosAddNew;
 struct UserPhotosAddSlice;
@@ -63,6 +65,10 @@ public:
 	rpl::producer<SharedMediaRemoveAll> sharedMediaAllRemoved() const;
 	rpl::producer<SharedMediaInvalidateBottom> sharedMediaBottomInvalidated() const;
 
+	void restoreSharedMediaCounts(SharedMediaCountsMap &&counts);
+	void validateSharedMediaCounts(PeerId peerId, MsgId topMessageId);
+	SharedMediaCountsMap collectSharedMediaCounts() const;
+
 	void add(UserPhotosAddNew &&query);
 	void add(UserPhotosAddSlice &&query);
 	void remove(UserPhotosRemoveOne &&query);
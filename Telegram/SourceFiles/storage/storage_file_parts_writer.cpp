@@ -0,0 +1,130 @@
+/*
+This file is part of Telegram Desktop,
+the official desktop application for the Telegram messaging service.
+
+For license and copyright information please follow this link:
+https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
+*/
+#include "storage/storage_file_parts_writer.h"
+
+#include <crl/crl.h>
+#include <atomic>
+
+namespace Storage {
+namespace details {
+namespace {
+
+constexpr auto kCollectPartsSize = 1024 * 1024;
+
+} // namespace
+
+struct FilePartsWriterState {
+	std::atomic<int64> pending = { 0 };
+	std::atomic<bool> failed = { false };
+};
+
+class FilePartsWriterObject {
+public:
+	FilePartsWriterObject(
+		crl::weak_on_queue<FilePartsWriterObject> weak,
+		not_null<QFile*> file,
+		std::shared_ptr<FilePartsWriterState> state,
+		Fn<void()> written);
+
+	void write(int offset, QByteArray &&bytes);
+
+private:
+	const not_null<QFile*> _file;
+	const std::shared_ptr<FilePartsWriterState> _state;
+	const Fn<void()> _written;
+
+};
+
+FilePartsWriterObject::FilePartsWriterObject(
+	crl::weak_on_queue<FilePartsWriterObject> weak,
+	not_null<QFile*> file,
+	std::shared_ptr<FilePartsWriterState> state,
+	Fn<void()> written)
+: _file(file)
+, _state(std::move(state))
+, _written(std::move(written)) {
+}
+
+void FilePartsWriterObject::write(int offset, QByteArray &&bytes) {
+	const auto size = int64(bytes.size());
+	if (!_state->failed) {
+		if (!_file->seek(offset) || _file->write(bytes) != size) {
+			_state->failed = true;
+		}
+	}
+	_state->pending -= size;
+	_written();
+}
+
+} // namespace details
+
+FilePartsWriter::FilePartsWriter(not_null<QFile*> file, Fn<void()> written)
+: _state(std::make_shared<details::FilePartsWriterState>())
+, _wrapped(
+	file,
+	_state,
+	[weak = base::make_weak(this), written = std::move(written)] {
+		crl::on_main(weak, written);
+	}) {
+}
+
+void FilePartsWriter::write(int offset, QByteArray &&bytes) {
+	if (!_collected.isEmpty()
+		&& offset != _collectedOffset + _collected.size()) {
+		flushCollected();
+	}
+	if (_collected.isEmpty()) {
+		_collectedOffset = offset;
+		_collected = std::move(bytes);
+	} else {
+		_collected.append(bytes);
+	}
+	if (_collected.size() >= details::kCollectPartsSize) {
+		flushCollected();
+	}
+}
+
+void FilePartsWriter::flushCollected() {
+	if (_collected.isEmpty()) {
+		return;
+	}
+	_state->pending += _collected.size();
+	_wrapped.with([
+		offset = _collectedOffset,
+		bytes = base::take(_collected)
+	](Implementation &unwrapped) mutable {
+		unwrapped.write(offset, std::move(bytes));
+	});
+}
+
+int64 FilePartsWriter::pendingSize() const {
+	return _state->pending + _collected.size();
+}
+
+bool FilePartsWriter::failed() const {
+	return _state->failed;
+}
+
+void FilePartsWriter::wait() {
+	flushCollected();
+	if (!_state->pending) {
+		return;
+	}
+	crl::semaphore semaphore;
+	_wrapped.with([&](Implementation &) {
+		semaphore.release();
+	});
+	semaphore.acquire();
+}
+
+FilePartsWriter::~FilePartsWriter() {
+	// The file is owned by the caller, it must outlive the writes.
+	wait();
+}
+
+} // namespace Storage
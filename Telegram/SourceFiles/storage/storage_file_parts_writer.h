@@ -0,0 +1,51 @@
+/*
+This file is part of Telegram Desktop,
+the official desktop application for the Telegram messaging service.
+
+For license and copyright information please follow this link:
+https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
+*/
+#pragma once
+
+#include "base/weak_ptr.h"
+#include <crl/crl_object_on_queue.h>
+#include <QtCore/QFile>
+
+namespace Storage {
+namespace details {
+
+class FilePartsWriterObject;
+struct FilePartsWriterState;
+
+} // namespace details
+
+// Writes parts of a file that is being downloaded on a separate queue
+// in the order they were given, adjacent parts are written together.
+// While there are pending writes the file is used on that queue, so the
+// owner may touch it only after wait() and must check failed() then.
+class FilePartsWriter final : public base::has_weak_ptr {
+public:
+	// Called on the main thread each time some parts were written.
+	FilePartsWriter(not_null<QFile*> file, Fn<void()> written);
+	~FilePartsWriter();
+
+	void write(int offset, QByteArray &&bytes);
+	int64 pendingSize() const;
+	bool failed() const;
+
+	// Blocks until all the given parts are written.
+	void wait();
+
+private:
+	using Implementation = details::FilePartsWriterObject;
+
+	void flushCollected();
+
+	const std::shared_ptr<details::FilePartsWriterState> _state;
+	int _collectedOffset = 0;
+	QByteArray _collected;
+	crl::object_on_queue<Implementation> _wrapped;
+
+};
+
+} // namespace Storage
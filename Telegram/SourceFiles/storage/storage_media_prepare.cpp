@@ -12,10 +12,14 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 #include "core/mime_type.h"
 #include "ui/image/image_prepare.h"
 
+#include <QtCore/QSemaphore>
+#include <atomic>
+
 namespace Storage {
 namespace {
 
 constexpr auto kMaxAlbumCount = 10;
+constexpr auto kMaxPrepareThreads = 4;
 
 bool HasExtensionFrom(const QString &file, const QStringList &extensions) {
 	for (const auto &extension : extensions) {
@@ -52,58 +56,50 @@ QSize PrepareShownDimensions(const QImage &preview) {
 		: result;
 }
 
-bool PrepareAlbumMediaIsWaiting(
-		QSemaphore &semaphore,
-		PreparedFile &file,
-		int previewWidth) {
-	// TODO: Use some special thread queue, like a separate QThreadPool.
-	crl::async([=, &semaphore, &file] {
-		const auto guard = gsl::finally([&] { semaphore.release(); });
-		if (!file.path.isEmpty()) {
-			file.mime = Core::MimeTypeForFile(QFileInfo(file.path)).name();
-			file.information = FileLoadTask::ReadMediaInformation(
-				file.path,
-				QByteArray(),
-				file.mime);
-		} else if (!file.content.isEmpty()) {
-			file.mime = Core::MimeTypeForData(file.content).name();
-			file.information = FileLoadTask::ReadMediaInformation(
-				QString(),
-				file.content,
-				file.mime);
-		} else {
-			Assert(file.information != nullptr);
-		}
+void PrepareAlbumMedia(PreparedFile &file, int previewWidth) {
+	if (!file.path.isEmpty()) {
+		file.mime = Core::MimeTypeForFile(QFileInfo(file.path)).name();
+		file.information = FileLoadTask::ReadMediaInformation(
+			file.path,
+			QByteArray(),
+			file.mime);
+	} else if (!file.content.isEmpty()) {
+		file.mime = Core::MimeTypeForData(file.content).name();
+		file.information = FileLoadTask::ReadMediaInformation(
+			QString(),
+			file.content,
+			file.mime);
+	} else {
+		Assert(file.information != nullptr);
+	}
 
-		using Image = FileMediaInformation::Image;
-		using Video = FileMediaInformation::Video;
-		if (const auto image = base::get_if<Image>(
-				&file.information->media)) {
-			if (ValidPhotoForAlbum(*image)) {
-				file.shownDimensions = PrepareShownDimensions(image->data);
-				file.preview = Images::prepareOpaque(image->data.scaledToWidth(
-					std::min(previewWidth, ConvertScale(image->data.width()))
-						* cIntRetinaFactor(),
-					Qt::SmoothTransformation));
-				Assert(!file.preview.isNull());
-				file.preview.setDevicePixelRatio(cRetinaFactor());
-				file.type = PreparedFile::AlbumType::Photo;
-			}
-		} else if (const auto video = base::get_if<Video>(
-				&file.information->media)) {
-			if (ValidVideoForAlbum(*video)) {
-				auto blurred = Images::prepareBlur(Images::prepareOpaque(video->thumbnail));
-				file.shownDimensions = PrepareShownDimensions(video->thumbnail);
-				file.preview = std::move(blurred).scaledToWidth(
-					previewWidth * cIntRetinaFactor(),
-					Qt::SmoothTransformation);
-				Assert(!file.preview.isNull());
-				file.preview.setDevicePixelRatio(cRetinaFactor());
-				file.type = PreparedFile::AlbumType::Video;
-			}
+	using Image = FileMediaInformation::Image;
+	using Video = FileMediaInformation::Video;
+	if (const auto image = base::get_if<Image>(
+			&file.information->media)) {
+		if (ValidPhotoForAlbum(*image)) {
+			file.shownDimensions = PrepareShownDimensions(image->data);
+			file.preview = Images::prepareOpaque(image->data.scaledToWidth(
+				std::min(previewWidth, ConvertScale(image->data.width()))
+					* cIntRetinaFactor(),
+				Qt::SmoothTransformation));
+			Assert(!file.preview.isNull());
+			file.preview.setDevicePixelRatio(cRetinaFactor());
+			file.type = PreparedFile::AlbumType::Photo;
 		}
-	});
-	return true;
+	} else if (const auto video = base::get_if<Video>(
+			&file.information->media)) {
+		if (ValidVideoForAlbum(*video)) {
+			auto blurred = Images::prepareBlur(Images::prepareOpaque(video->thumbnail));
+			file.shownDimensions = PrepareShownDimensions(video->thumbnail);
+			file.preview = std::move(blurred).scaledToWidth(
+				previewWidth * cIntRetinaFactor(),
+				Qt::SmoothTransformation);
+			Assert(!file.preview.isNull());
+			file.preview.setDevicePixelRatio(cRetinaFactor());
+			file.type = PreparedFile::AlbumType::Video;
+		}
+	}
 }
 
 void PrepareAlbum(PreparedList &result, int previewWidth) {
@@ -113,22 +109,40 @@ void PrepareAlbum(PreparedList &result, int previewWidth) {
 	}
 
 	result.albumIsPossible = (count > 1);
-	auto waiting = 0;
-	QSemaphore semaphore;
-	for (auto &file : result.files) {
-		if (PrepareAlbumMediaIsWaiting(semaphore, file, previewWidth)) {
-			++waiting;
-		}
+	if (!count) {
+		return;
 	}
-	if (waiting > 0) {
-		semaphore.acquire(waiting);
-		if (result.albumIsPossible) {
-			const auto badIt = ranges::find(
-				result.files,
-				PreparedFile::AlbumType::None,
-				[](const PreparedFile &file) { return file.type; });
-			result.albumIsPossible = (badIt == result.files.end());
+
+	// Files are taken one by one both by the workers and by the calling
+	// thread, so no more than kMaxPrepareThreads files are read and
+	// decoded at the same time and the calling thread doesn't sit idle.
+	auto next = std::atomic<int>{ 0 };
+	const auto work = [&] {
+		while (true) {
+			const auto index = next++;
+			if (index >= count) {
+				return;
+			}
+			PrepareAlbumMedia(result.files[index], previewWidth);
 		}
+	};
+	const auto workers = std::min(count, kMaxPrepareThreads) - 1;
+	QSemaphore finished;
+	for (auto i = 0; i != workers; ++i) {
+		crl::async([&] {
+			work();
+			finished.release();
+		});
+	}
+	work();
+	finished.acquire(workers);
+
+	if (result.albumIsPossible) {
+		const auto badIt = ranges::find(
+			result.files,
+			PreparedFile::AlbumType::None,
+			[](const PreparedFile &file) { return file.type; });
+		result.albumIsPossible = (badIt == result.files.end());
 	}
 }
 
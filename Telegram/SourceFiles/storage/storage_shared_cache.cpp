@@ -0,0 +1,125 @@
+/*
+This file is part of Telegram Desktop,
+the official desktop application for the Telegram messaging service.
+
+For license and copyright information please follow this link:
+https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
+*/
+#include "storage/storage_shared_cache.h"
+
+#include <QtCore/QCoreApplication>
+#include <QtCore/QDir>
+#include <QtCore/QFile>
+
+namespace Storage {
+namespace details {
+namespace {
+
+constexpr auto kMaxEntrySize = 8 * 1024 * 1024;
+
+QString KeyPart(uint64 value) {
+	return QString("%1").arg(value, 16, 16, QChar('0'));
+}
+
+} // namespace
+
+class SharedCacheObject {
+public:
+	SharedCacheObject(
+		crl::weak_on_queue<SharedCacheObject> weak,
+		const QString &path);
+
+	void get(const Cache::Key &key, FnMut<void(QByteArray&&)> &&done);
+	void put(const Cache::Key &key, QByteArray &&value);
+
+private:
+	QString entryFolder(const Cache::Key &key) const;
+	QString entryPath(const Cache::Key &key) const;
+
+	QString _path;
+
+};
+
+SharedCacheObject::SharedCacheObject(
+	crl::weak_on_queue<SharedCacheObject> weak,
+	const QString &path)
+: _path(QDir(path).absolutePath() + '/') {
+}
+
+QString SharedCacheObject::entryFolder(const Cache::Key &key) const {
+	// Spread the entries between 256 folders to keep them small.
+	return _path + KeyPart(key.high).mid(0, 2) + '/';
+}
+
+QString SharedCacheObject::entryPath(const Cache::Key &key) const {
+	return entryFolder(key) + KeyPart(key.high) + KeyPart(key.low);
+}
+
+void SharedCacheObject::get(
+		const Cache::Key &key,
+		FnMut<void(QByteArray&&)> &&done) {
+	auto file = QFile(entryPath(key));
+	if (!file.open(QIODevice::ReadOnly) || file.size() > kMaxEntrySize) {
+		done(QByteArray());
+		return;
+	}
+	done(file.readAll());
+}
+
+void SharedCacheObject::put(const Cache::Key &key, QByteArray &&value) {
+	if (value.isEmpty() || value.size() > kMaxEntrySize) {
+		return;
+	}
+	const auto path = entryPath(key);
+	if (QFile::exists(path) || !QDir().mkpath(entryFolder(key))) {
+		return;
+	}
+	const auto temporary = path
+		+ '.'
+		+ QString::number(QCoreApplication::applicationPid())
+		+ ".tmp";
+	auto file = QFile(temporary);
+	if (!file.open(QIODevice::WriteOnly)) {
+		return;
+	}
+	const auto written = (file.write(value) == value.size());
+	file.close();
+
+	// Other users of the machine should be able to read the entry.
+	if (!written
+		|| !file.setPermissions(QFileDevice::ReadOwner
+			| QFileDevice::WriteOwner
+			| QFileDevice::ReadGroup
+			| QFileDevice::ReadOther)
+		|| !file.rename(path)) {
+		// Rename fails if some other instance has written it already.
+		file.remove();
+	}
+}
+
+} // namespace details
+
+SharedCache::SharedCache(const QString &path) : _wrapped(path) {
+}
+
+void SharedCache::get(
+		const Cache::Key &key,
+		FnMut<void(QByteArray&&)> &&done) {
+	_wrapped.with([
+		key,
+		done = std::move(done)
+	](Implementation &unwrapped) mutable {
+		unwrapped.get(key, std::move(done));
+	});
+}
+
+void SharedCache::put(const Cache::Key &key, QByteArray &&value) {
+	_wrapped.with([
+		key,
+		value = std::move(value)
+	](Implementation &unwrapped) mutable {
+		unwrapped.put(key, std::move(value));
+	});
+}
+
+} // namespace Storage
@@ -0,0 +1,39 @@
+/*
+This file is part of Telegram Desktop,
+the official desktop application for the Telegram messaging service.
+
+For license and copyright information please follow this link:
+https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
+*/
+#pragma once
+
+#include "storage/cache/storage_cache_types.h"
+#include <crl/crl_object_on_queue.h>
+
+namespace Storage {
+namespace details {
+
+class SharedCacheObject;
+
+} // namespace details
+
+// A machine-wide cache of public media, shared by the app instances that
+// run on one machine, for example by the users of a terminal server.
+// Entries are never changed after they're written: each one is written to
+// a temporary file and then renamed, so that other processes never read a
+// partially written entry and the readers don't need any locking.
+class SharedCache final {
+public:
+	explicit SharedCache(const QString &path);
+
+	// The callback is called on a background thread, empty if not found.
+	void get(const Cache::Key &key, FnMut<void(QByteArray&&)> &&done);
+	void put(const Cache::Key &key, QByteArray &&value);
+
+private:
+	using Implementation = details::SharedCacheObject;
+	crl::object_on_queue<Implementation> _wrapped;
+
+};
+
+} // namespace Storage
@@ -18,6 +18,13 @@ std::map<PeerId, SharedMedia::Lists>::iterator
 		return result;
 	}
 	result = _lists.emplace(peer, Lists {}).first;
+	const auto restored = _restored.find(peer);
+	if (restored != _restored.end()) {
+		if (restored->second.validated) {
+			ApplyCounts(result->second, restored->second.data);
+		}
+		_restored.erase(restored);
+	}
 	for (auto index = 0; index != kSharedMediaTypeCount; ++index) {
 		auto &list = result->second[index];
 		auto type = static_cast<SharedMediaType>(index);
@@ -33,6 +40,16 @@ std::map<PeerId, SharedMedia::Lists>::iterator
 	return result;
 }
 
+void SharedMedia::ApplyCounts(
+		Lists &lists,
+		const SharedMediaCounts &counts) {
+	for (auto index = 0; index != kSharedMediaTypeCount; ++index) {
+		if (const auto count = counts.counts[index]) {
+			lists[index].restoreCount(*count);
+		}
+	}
+}
+
 void SharedMedia::add(SharedMediaAddNew &&query) {
 	auto peer = query.peerId;
 	auto peerIt = enforceLists(peer);
@@ -79,6 +96,7 @@ void SharedMedia::remove(SharedMediaRemoveOne &&query) {
 }
 
 void SharedMedia::remove(SharedMediaRemoveAll &&query) {
+	_restored.remove(query.peerId);
 	auto peerIt = _lists.find(query.peerId);
 	if (peerIt != _lists.end()) {
 		for (auto index = 0; index != kSharedMediaTypeCount; ++index) {
@@ -89,6 +107,7 @@ void SharedMedia::remove(SharedMediaRemoveAll &&query) {
 }
 
 void SharedMedia::invalidate(SharedMediaInvalidateBottom &&query) {
+	_restored.remove(query.peerId);
 	auto peerIt = _lists.find(query.peerId);
 	if (peerIt != _lists.end()) {
 		for (auto index = 0; index != kSharedMediaTypeCount; ++index) {
@@ -98,17 +117,69 @@ void SharedMedia::invalidate(SharedMediaInvalidateBottom &&query) {
 	}
 }
 
+void SharedMedia::restoreCounts(Counts &&counts) {
+	for (auto &[peer, data] : counts) {
+		if (_lists.find(peer) == _lists.end()) {
+			_restored.emplace(peer, Restored{ std::move(data) });
+		}
+	}
+}
+
+void SharedMedia::validateCounts(PeerId peerId, MsgId topMessageId) {
+	const auto i = _restored.find(peerId);
+	if (i == _restored.end() || i->second.validated) {
+		return;
+	} else if (i->second.data.topMessageId != topMessageId) {
+		_restored.erase(i);
+		return;
+	}
+	i->second.validated = true;
+}
+
+auto SharedMedia::collectCounts() const -> Counts {
+	auto result = Counts();
+	for (const auto &[peer, restored] : _restored) {
+		auto counts = restored.data;
+		if (restored.validated) {
+			counts.topMessageId = 0;
+		}
+		result.emplace(peer, counts);
+	}
+	for (const auto &[peer, lists] : _lists) {
+		auto counts = SharedMediaCounts();
+		auto known = false;
+		for (auto index = 0; index != kSharedMediaTypeCount; ++index) {
+			counts.counts[index] = lists[index].count();
+			known = known || counts.counts[index].has_value();
+		}
+		if (known) {
+			result.emplace(peer, counts);
+		}
+	}
+	return result;
+}
+
 rpl::producer<SharedMediaResult> SharedMedia::query(SharedMediaQuery &&query) const {
 	Expects(IsValidSharedMediaType(query.key.type));
 	auto peerIt = _lists.find(query.key.peerId);
+	auto index = static_cast<int>(query.key.type);
 	if (peerIt != _lists.end()) {
-		auto index = static_cast<int>(query.key.type);
 		return peerIt->second[index].query(SparseIdsListQuery(
 			query.key.messageId,
 			query.limitBefore,
 			query.limitAfter));
 	}
-	return [](auto consumer) {
+	auto count = std::optional<int>();
+	const auto restored = _restored.find(query.key.peerId);
+	if (restored != _restored.end() && restored->second.validated) {
+		count = restored->second.data.counts[index];
+	}
+	return [=](auto consumer) {
+		if (count) {
+			auto result = SharedMediaResult();
+			result.count = count;
+			consumer.put_next(std::move(result));
+		}
 		consumer.put_done();
 		return rpl::lifetime();
 	};
@@ -179,9 +179,18 @@ struct SharedMediaSliceUpdate {
 	SparseIdsSliceUpdate data;
 };
 
+// Counts are kept between the launches and are trusted only after the
+// dialog of the peer is received with the same top message as was known
+// when they were saved, otherwise some messages could be missed.
+struct SharedMediaCounts {
+	MsgId topMessageId = 0;
+	std::array<std::optional<int>, kSharedMediaTypeCount> counts;
+};
+
 class SharedMedia {
 public:
 	using Type = SharedMediaType;
+	using Counts = SharedMediaCountsMap;
 
 	void add(SharedMediaAddNew &&query);
 	void add(SharedMediaAddExisting &&query);
@@ -190,6 +199,12 @@ public:
 	void remove(SharedMediaRemoveAll &&query);
 	void invalidate(SharedMediaInvalidateBottom &&query);
 
+	void restoreCounts(Counts &&counts);
+	void validateCounts(PeerId peerId, MsgId topMessageId);
+
+	// Top message ids are filled only for the not yet validated counts.
+	Counts collectCounts() const;
+
 	rpl::producer<SharedMediaResult> query(SharedMediaQuery &&query) const;
 	rpl::producer<SharedMediaSliceUpdate> sliceUpdated() const;
 	rpl::producer<SharedMediaRemoveOne> oneRemoved() const;
@@ -198,10 +213,16 @@ public:
 
 private:
 	using Lists = std::array<SparseIdsList, kSharedMediaTypeCount>;
+	struct Restored {
+		SharedMediaCounts data;
+		bool validated = false;
+	};
 
 	std::map<PeerId, Lists>::iterator enforceLists(PeerId peer);
+	static void ApplyCounts(Lists &lists, const SharedMediaCounts &counts);
 
 	std::map<PeerId, Lists> _lists;
+	base::flat_map<PeerId, Restored> _restored;
 
 	rpl::event_stream<SharedMediaSliceUpdate> _sliceUpdated;
 	rpl::event_stream<SharedMediaRemoveOne> _oneRemoved;
@@ -39,16 +39,24 @@ SparseIdsList::AddResult SparseIdsList::uniteAndAdd(
 		MsgRange noSkipRange) {
 	const auto uniteFromIndex = uniteFrom - _slices.begin();
 	const auto was = int(uniteFrom->messages.size());
-	_slices.modify(uniteFrom, [&](Slice &slice) {
-		slice.merge(messages, noSkipRange);
-	});
 	const auto firstToErase = uniteFrom + 1;
-	if (firstToErase != uniteTill) {
+	_slices.modify(uniteFrom, [&](Slice &slice) {
+		// The united slices follow each other without intersections, so
+		// their ids are only appended and the new ids are merged once,
+		// instead of merging the whole grown set for each of the slices.
+		slice.range = {
+			qMin(slice.range.from, noSkipRange.from),
+			qMax(slice.range.till, noSkipRange.till)
+		};
 		for (auto it = firstToErase; it != uniteTill; ++it) {
-			_slices.modify(uniteFrom, [&](Slice &slice) {
-				slice.merge(it->messages, it->range);
-			});
+			slice.messages.merge(
+				std::begin(it->messages),
+				std::end(it->messages));
+			accumulate_max(slice.range.till, it->range.till);
 		}
+		slice.messages.merge(std::begin(messages), std::end(messages));
+	});
+	if (firstToErase != uniteTill) {
 		_slices.erase(firstToErase, uniteTill);
 		uniteFrom = _slices.begin() + uniteFromIndex;
 	}
@@ -176,6 +184,16 @@ void SparseIdsList::invalidateBottom() {
 	_count = std::nullopt;
 }
 
+std::optional<int> SparseIdsList::count() const {
+	return _count;
+}
+
+void SparseIdsList::restoreCount(int count) {
+	if (!_count && _slices.empty()) {
+		_count = count;
+	}
+}
+
 rpl::producer<SparseIdsListResult> SparseIdsList::query(
 		SparseIdsListQuery &&query) const {
 	return [this, query = std::move(query)](auto consumer) {
@@ -49,6 +49,11 @@ public:
 	void removeOne(MsgId messageId);
 	void removeAll();
 	void invalidateBottom();
+
+	// The count may be restored only while nothing is known about it.
+	std::optional<int> count() const;
+	void restoreCount(int count);
+
 	rpl::producer<SparseIdsListResult> query(SparseIdsListQuery &&query) const;
 	rpl::producer<SparseIdsSliceUpdate> sliceUpdated() const;
 
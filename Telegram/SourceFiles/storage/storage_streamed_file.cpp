@@ -0,0 +1,171 @@
+/*
+This file is part of Telegram Desktop,
+the official desktop application for the Telegram messaging service.
+
+For license and copyright information please follow this link:
+https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
+*/
+#include "storage/storage_streamed_file.h"
+
+namespace Storage {
+namespace {
+
+// Parts behind the read offset go first, then the farthest ahead ones.
+// They're supplied again by the loader from the disk or the cache.
+constexpr auto kPartsInMemoryLimit = int64(32 * 1024 * 1024);
+
+} // namespace
+
+StreamedFile::StreamedFile(int size) : _size(size) {
+	Expects(_size > 0);
+}
+
+int StreamedFile::size() const {
+	return _size;
+}
+
+void StreamedFile::supply(int offset, QByteArray &&bytes) {
+	Expects(offset >= 0 && offset + bytes.size() <= _size);
+
+	if (bytes.isEmpty()) {
+		return;
+	}
+	QMutexLocker lock(&_mutex);
+	auto &part = _parts[offset];
+	_partsSize += bytes.size() - part.size();
+	part = std::move(bytes);
+	prune();
+	_supplied.wakeAll();
+}
+
+void StreamedFile::finish(const QString &path, const QByteArray &data) {
+	Expects(!path.isEmpty() || data.size() == _size);
+
+	QMutexLocker lock(&_mutex);
+	_finished = true;
+	_data = data;
+	if (_data.isEmpty()) {
+		_file.setFileName(path);
+	}
+	_supplied.wakeAll();
+}
+
+void StreamedFile::fail() {
+	QMutexLocker lock(&_mutex);
+	if (!_finished) {
+		_failed = true;
+		_supplied.wakeAll();
+	}
+}
+
+rpl::producer<int> StreamedFile::wanted() const {
+	return _wanted.events();
+}
+
+void StreamedFile::interrupt() {
+	QMutexLocker lock(&_mutex);
+	++_interrupts;
+	_supplied.wakeAll();
+}
+
+int StreamedFile::read(int offset, bytes::span buffer) {
+	Expects(offset >= 0);
+
+	QMutexLocker lock(&_mutex);
+	const auto interrupts = _interrupts;
+	auto notified = false;
+	while (true) {
+		if (_failed || _interrupts != interrupts) {
+			return -1;
+		} else if (offset >= _size || buffer.empty()) {
+			return 0;
+		} else if (const auto result = readFromParts(offset, buffer)) {
+			_lastReadOffset = offset;
+			return result;
+		} else if (_finished) {
+			return readFromFinished(offset, buffer);
+		} else if (!notified) {
+			notified = true;
+			notifyWanted(offset);
+		}
+		_supplied.wait(&_mutex);
+	}
+}
+
+int StreamedFile::readFromParts(int offset, bytes::span buffer) {
+	auto i = _parts.upper_bound(offset);
+	if (i == begin(_parts)) {
+		return 0;
+	}
+	--i;
+	const auto till = i->first + i->second.size();
+	if (till <= offset) {
+		return 0;
+	}
+	const auto count = std::min(int(buffer.size()), till - offset);
+	bytes::copy(
+		buffer,
+		bytes::make_span(i->second).subspan(offset - i->first, count));
+	return count;
+}
+
+int StreamedFile::readFromFinished(int offset, bytes::span buffer) {
+	const auto count = std::min(int(buffer.size()), _size - offset);
+	if (!_data.isEmpty()) {
+		bytes::copy(buffer, bytes::make_span(_data).subspan(offset, count));
+		return count;
+	} else if (!_file.isOpen() && !_file.open(QIODevice::ReadOnly)) {
+		return -1;
+	} else if (!_file.seek(offset)) {
+		return -1;
+	}
+	const auto read = _file.read(
+		reinterpret_cast<char*>(buffer.data()),
+		count);
+	return (read > 0) ? int(read) : -1;
+}
+
+void StreamedFile::prune() {
+	while (_partsSize > kPartsInMemoryLimit && _parts.size() > 1) {
+		const auto first = begin(_parts);
+		const auto behind = (first->first + first->second.size()
+			<= _lastReadOffset);
+		const auto i = behind ? first : std::prev(end(_parts));
+		_partsSize -= i->second.size();
+		_parts.erase(i);
+	}
+}
+
+void StreamedFile::notifyWanted(int offset) {
+	const auto weak = std::weak_ptr<StreamedFile>(shared_from_this());
+	crl::on_main([=] {
+		if (const auto strong = weak.lock()) {
+			strong->_wanted.fire_copy(offset);
+		}
+	});
+}
+
+StreamedDevice::StreamedDevice(std::shared_ptr<StreamedFile> file)
+: _file(std::move(file)) {
+	Expects(_file != nullptr);
+}
+
+bool StreamedDevice::isSequential() const {
+	return false;
+}
+
+qint64 StreamedDevice::size() const {
+	return _file->size();
+}
+
+qint64 StreamedDevice::readData(char *data, qint64 maxSize) {
+	return _file->read(
+		int(pos()),
+		bytes::make_span(data, std::min(maxSize, size() - pos())));
+}
+
+qint64 StreamedDevice::writeData(const char *data, qint64 maxSize) {
+	return -1;
+}
+
+} // namespace Storage
@@ -0,0 +1,80 @@
+/*
+This file is part of Telegram Desktop,
+the official desktop application for the Telegram messaging service.
+
+For license and copyright information please follow this link:
+https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
+*/
+#pragma once
+
+#include "base/bytes.h"
+#include <rpl/event_stream.h>
+#include <QtCore/QFile>
+#include <QtCore/QMutex>
+#include <QtCore/QWaitCondition>
+
+namespace Storage {
+
+// Parts of a file that is being downloaded while some reader plays it.
+// The loader supplies parts on the main thread and a reader thread
+// blocks in read() until the range it needs is supplied.
+class StreamedFile final
+	: public std::enable_shared_from_this<StreamedFile> {
+public:
+	explicit StreamedFile(int size);
+
+	int size() const;
+
+	// Main thread.
+	void supply(int offset, QByteArray &&bytes);
+	void finish(const QString &path, const QByteArray &data);
+	void fail();
+	rpl::producer<int> wanted() const; // Offsets that readers wait for.
+
+	// Wakes up all the blocked reads, they return an error.
+	void interrupt();
+
+	// Reader thread, returns the read bytes count or -1 on error.
+	int read(int offset, bytes::span buffer);
+
+private:
+	int readFromParts(int offset, bytes::span buffer);
+	int readFromFinished(int offset, bytes::span buffer);
+	void prune();
+	void notifyWanted(int offset);
+
+	const int _size = 0;
+
+	QMutex _mutex;
+	QWaitCondition _supplied;
+	std::map<int, QByteArray> _parts;
+	int64 _partsSize = 0;
+	int _lastReadOffset = 0;
+	int _interrupts = 0;
+	bool _failed = false;
+
+	bool _finished = false;
+	QByteArray _data;
+	QFile _file;
+
+	rpl::event_stream<int> _wanted;
+
+};
+
+class StreamedDevice final : public QIODevice {
+public:
+	explicit StreamedDevice(std::shared_ptr<StreamedFile> file);
+
+	bool isSequential() const override;
+	qint64 size() const override;
+
+protected:
+	qint64 readData(char *data, qint64 maxSize) override;
+	qint64 writeData(const char *data, qint64 maxSize) override;
+
+private:
+	const std::shared_ptr<StreamedFile> _file;
+
+};
+
+} // namespace Storage
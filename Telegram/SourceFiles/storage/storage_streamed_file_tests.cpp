@@ -0,0 +1,54 @@
+/*
+This file is part of Telegram Desktop,
+the official desktop application for the Telegram messaging service.
+
+For license and copyright information please follow this link:
+https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
+*/
+#include "catch.hpp"
+
+#include "storage/storage_streamed_file.h"
+
+namespace {
+
+QByteArray Read(Storage::StreamedFile &file, int offset, int size) {
+	auto buffer = bytes::vector(size);
+	const auto read = file.read(offset, buffer);
+	if (read < 0) {
+		return "error";
+	}
+	return QByteArray(reinterpret_cast<const char*>(buffer.data()), read);
+}
+
+} // namespace
+
+TEST_CASE("streamed file", "[storage_streamed_file]") {
+	const auto file = std::make_shared<Storage::StreamedFile>(32);
+	file->supply(0, QByteArray("01234567"));
+	file->supply(16, QByteArray("abcdefghijklmnop"));
+
+	SECTION("reading supplied parts") {
+		REQUIRE(Read(*file, 0, 16) == "01234567");
+		REQUIRE(Read(*file, 4, 2) == "45");
+		REQUIRE(Read(*file, 20, 16) == "efghijklmnop");
+		REQUIRE(Read(*file, 32, 16).isEmpty());
+	}
+	SECTION("reading finished file") {
+		file->finish(QString(), "0123456789ABCDEFabcdefghijklmnop");
+		REQUIRE(Read(*file, 4, 8) == "4567");
+		REQUIRE(Read(*file, 8, 12) == "89ABCDEFabcd");
+	}
+	SECTION("reading failed file") {
+		file->fail();
+		REQUIRE(Read(*file, 0, 8) == "error");
+	}
+	SECTION("reading through device") {
+		Storage::StreamedDevice device(file);
+		REQUIRE(device.open(QIODevice::ReadOnly));
+		REQUIRE(device.size() == 32);
+		REQUIRE(device.seek(18));
+		REQUIRE(device.read(4) == "cdef");
+		REQUIRE(device.seek(2));
+		REQUIRE(device.read(4) == "2345");
+	}
+}
@@ -270,6 +270,7 @@ TemplatesIndex ComputeIndex(const TemplatesData &data) {
 	using Id = TemplatesIndex::Id;
 	using Term = TemplatesIndex::Term;
 
+	auto result = TemplatesIndex();
 	auto uniqueFirst = std::map<QChar, base::flat_set<Id>>();
 	auto uniqueFull = std::map<Id, base::flat_set<Term>>();
 	const auto pushString = [&](
@@ -287,13 +288,13 @@ TemplatesIndex ComputeIndex(const TemplatesData &data) {
 			const auto id = std::make_pair(path, normalized);
 			for (const auto &key : question.normalizedKeys) {
 				pushString(id, key, kWeightStep * kWeightStep);
+				result.keys.emplace(key, id);
 			}
 			pushString(id, question.question, kWeightStep);
 			pushString(id, question.value, 1);
 		}
 	}
 
-	auto result = TemplatesIndex();
 	for (const auto &[ch, unique] : uniqueFirst) {
 		result.first.emplace(ch, unique | ranges::to_vector);
 	}
@@ -317,6 +318,16 @@ void ReplaceFileIndex(
 	for (auto &[id, list] : source.full) {
 		result.full.emplace(id, std::move(list));
 	}
+	for (auto i = begin(result.keys); i != end(result.keys);) {
+		if (i->second.first == path) {
+			i = result.keys.erase(i);
+		} else {
+			++i;
+		}
+	}
+	for (auto &[key, id] : source.keys) {
+		result.keys.emplace(key, std::move(id));
+	}
 
 	using Id = TemplatesIndex::Id;
 	for (auto &[ch, list] : result.first) {
@@ -603,16 +614,11 @@ auto Templates::matchExact(QString query) const
 
 	query = NormalizeKey(query);
 
-	for (const auto &[path, file] : _data.files) {
-		for (const auto &[normalized, question] : file.questions) {
-			for (const auto &key : question.normalizedKeys) {
-				if (key == query) {
-					return QuestionByKey{ question, key };
-				}
-			}
-		}
+	const auto i = _index.keys.find(query);
+	if (i == end(_index.keys)) {
+		return {};
 	}
-	return {};
+	return QuestionByKey{ questionById(i->second), query };
 }
 
 auto Templates::matchFromEnd(QString query) const
@@ -621,26 +627,23 @@ auto Templates::matchFromEnd(QString query) const
 		query = query.mid(query.size() - _maxKeyLength);
 	}
 
-	const auto size = query.size();
-	auto queries = std::vector<QString>();
-	queries.reserve(size);
-	for (auto i = 0; i != size; ++i) {
-		queries.push_back(NormalizeKey(query.mid(size - i - 1)));
-	}
-
-	auto result = std::optional<QuestionByKey>();
-	for (const auto &[path, file] : _data.files) {
-		for (const auto &[normalized, question] : file.questions) {
-			for (const auto &key : question.normalizedKeys) {
-				if (key.size() <= queries.size()
-					&& queries[key.size() - 1] == key
-					&& (!result || result->key.size() < key.size())) {
-					result = QuestionByKey{ question, key };
-				}
-			}
+	// Keys are compared with the same length suffixes, longest first.
+	for (auto length = query.size(); length > 0; --length) {
+		const auto key = NormalizeKey(query.mid(query.size() - length));
+		if (key.size() != length) {
+			continue;
+		}
+		const auto i = _index.keys.find(key);
+		if (i != end(_index.keys)) {
+			return QuestionByKey{ questionById(i->second), key };
 		}
 	}
-	return result;
+	return {};
+}
+
+auto Templates::questionById(const details::TemplatesIndex::Id &id) const
+-> const Question & {
+	return _data.files.at(id.first).questions.at(id.second);
 }
 
 Templates::~Templates() = default;
@@ -661,11 +664,8 @@ auto Templates::query(const QString &text) const -> std::vector<Question> {
 	}
 	using Id = TemplatesIndex::Id;
 	using Term = TemplatesIndex::Term;
-	const auto questionById = [&](const Id &id) {
-		return _data.files.at(id.first).questions.at(id.second);
-	};
 
-	using Pair = std::pair<Question, int>;
+	using Pair = std::pair<const Id*, int>;
 	const auto computeWeight = [&](const Id &id) {
 		auto result = 0;
 		const auto full = _index.full.find(id);
@@ -694,20 +694,28 @@ auto Templates::query(const QString &text) const -> std::vector<Question> {
 		}
 		return result;
 	};
-	const auto pairById = [&](const Id &id) {
-		return std::make_pair(questionById(id), computeWeight(id));
-	};
-	const auto good = narrowed->second | ranges::view::transform(
-		pairById
-	) | ranges::view::filter([](const Pair &pair) {
-		return pair.second > 0;
-	}) | ranges::to_vector | ranges::action::sort(
-		std::greater<>(),
-		[](const Pair &pair) { return pair.second; }
-	);
-	return good | ranges::view::transform([](const Pair &pair) {
-		return pair.first;
-	}) | ranges::view::take(kQueryLimit) | ranges::to_vector;
+	auto good = std::vector<Pair>();
+	good.reserve(narrowed->second.size());
+	for (const auto &id : narrowed->second) {
+		if (const auto weight = computeWeight(id)) {
+			good.emplace_back(&id, weight);
+		}
+	}
+
+	// Only the questions that will be shown are sorted and copied.
+	const auto till = begin(good)
+		+ std::min(int(good.size()), kQueryLimit);
+	std::partial_sort(
+		begin(good),
+		till,
+		end(good),
+		[](const Pair &a, const Pair &b) { return a.second > b.second; });
+	return ranges::make_iterator_range(
+		begin(good),
+		till
+	) | ranges::view::transform([&](const Pair &pair) {
+		return questionById(*pair.first);
+	}) | ranges::to_vector;
 }
 
 } // namespace Support
@@ -36,6 +36,7 @@ struct TemplatesIndex {
 
 	std::map<QChar, std::vector<Id>> first;
 	std::map<Id, std::vector<Term>> full;
+	std::map<QString, Id> keys; // normalized key, first question with it
 };
 
 } // namespace details
@@ -73,6 +74,7 @@ private:
 	void updateRequestFinished(QNetworkReply *reply);
 	void checkUpdateFinished();
 	void setData(details::TemplatesData &&data);
+	const Question &questionById(const details::TemplatesIndex::Id &id) const;
 
 	not_null<AuthSession*> _session;
 
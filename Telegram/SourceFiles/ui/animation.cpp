@@ -9,6 +9,9 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 
 #include "media/media_clip_reader.h"
 
+#include <QtGui/QGuiApplication>
+#include <QtGui/QScreen>
+
 namespace Media {
 namespace Clip {
 
@@ -26,9 +29,19 @@ ReaderPointer::~ReaderPointer() {
 
 namespace {
 
+constexpr auto kDefaultRefreshRate = 60.;
+
 AnimationManager *_manager = nullptr;
 bool AnimationsDisabled = false;
 
+TimeMs ComputeFrameDuration() {
+	const auto screen = QGuiApplication::primaryScreen();
+	const auto rate = screen ? screen->refreshRate() : 0.;
+	const auto duration = TimeMs(std::floor(
+		1000. / ((rate > 1.) ? rate : kDefaultRefreshRate)));
+	return std::max(duration, TimeMs(AnimationTimerDelta));
+}
+
 } // namespace
 
 namespace anim {
@@ -155,9 +168,7 @@ void BasicAnimation::stop() {
 	_manager->stop(this);
 }
 
-AnimationManager::AnimationManager() : _timer(this) {
-	_timer.setSingleShot(false);
-	connect(&_timer, &QTimer::timeout, this, &AnimationManager::step);
+AnimationManager::AnimationManager() : _timer([=] { step(); }) {
 }
 
 void AnimationManager::start(BasicAnimation *obj) {
@@ -168,7 +179,9 @@ void AnimationManager::start(BasicAnimation *obj) {
 		}
 	} else {
 		if (_objects.empty()) {
-			_timer.start(AnimationTimerDelta);
+			_frameDuration = ComputeFrameDuration();
+			_lastStep = getms();
+			schedule();
 		}
 		_objects.insert(obj);
 	}
@@ -185,7 +198,7 @@ void AnimationManager::stop(BasicAnimation *obj) {
 		if (i != _objects.cend()) {
 			_objects.erase(i);
 			if (_objects.empty()) {
-				_timer.stop();
+				_timer.cancel();
 			}
 		}
 	}
@@ -201,7 +214,7 @@ void AnimationManager::registerClip(not_null<Media::Clip::Manager*> clip) {
 
 void AnimationManager::step() {
 	_iterating = true;
-	const auto ms = getms();
+	const auto ms = _lastStep = getms();
 	for (const auto object : _objects) {
 		if (!_stopping.contains(object)) {
 			object->step(ms, true);
@@ -222,17 +235,26 @@ void AnimationManager::step() {
 		_stopping.clear();
 	}
 	if (_objects.empty()) {
-		_timer.stop();
+		_timer.cancel();
+	} else {
+		schedule();
 	}
 }
 
+void AnimationManager::schedule() {
+	// All the animations are stepped together once per display frame, so
+	// the widgets they update are repainted once per frame as well.
+	const auto elapsed = getms() - _lastStep;
+	_timer.callOnce(
+		std::max(_frameDuration - elapsed, TimeMs(0)),
+		Qt::PreciseTimer);
+}
+
 void AnimationManager::clipCallback(
 		Media::Clip::Reader *reader,
-		qint32 threadIndex,
 		qint32 notification) {
 	Media::Clip::Reader::callback(
 		reader,
-		threadIndex,
 		Media::Clip::Notification(notification));
 }
 
@@ -11,6 +11,7 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 #include <QtGui/QColor>
 #include "base/binary_guard.h"
 #include "base/flat_set.h"
+#include "base/timer.h"
 
 namespace Media {
 namespace Clip {
@@ -711,13 +712,15 @@ public:
 	void step();
 
 private:
+	void schedule();
 	void clipCallback(
 		Media::Clip::Reader *reader,
-		qint32 threadIndex,
 		qint32 notification);
 
 	base::flat_set<BasicAnimation*> _objects, _starting, _stopping;
-	QTimer _timer;
+	base::Timer _timer;
+	TimeMs _frameDuration = AnimationTimerDelta;
+	TimeMs _lastStep = 0;
 	bool _iterating = false;
 
 };
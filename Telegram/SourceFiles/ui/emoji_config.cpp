@@ -23,13 +23,14 @@ constexpr auto kSaveRecentEmojiTimeout = 3000;
 constexpr auto kUniversalSize = 72;
 constexpr auto kImagesPerRow = 32;
 constexpr auto kImageRowsPerSprite = 16;
+constexpr auto kDropUnusedSpritesTimeout = 5 * 60 * TimeMs(1000);
 
 constexpr auto kVersion = 3;
 
 class UniversalImages {
 public:
-	void ensureLoaded();
-	void clear();
+	void ensureLoaded(int index);
+	void clear(int index);
 
 	void draw(QPainter &p, EmojiPtr emoji, int size, int x, int y) const;
 
@@ -175,23 +176,26 @@ QImage LoadFromFile(int size, int index) {
 	return result;
 }
 
-void UniversalImages::ensureLoaded() {
+void UniversalImages::ensureLoaded(int index) {
 	Expects(SpritesCount > 0);
+	Expects(index < SpritesCount);
 
-	if (!_sprites.empty()) {
-		return;
+	// The vector is never resized after that, so the sprites
+	// being generated in the background can be read safely.
+	if (_sprites.empty()) {
+		_sprites.resize(SpritesCount);
 	}
-	_sprites.reserve(SpritesCount);
-	const auto base = qsl(":/gui/emoji/emoji_");
-	for (auto i = 0; i != SpritesCount; ++i) {
-		auto image = QImage();
-		image.load(base + QString::number(i + 1) + ".webp", "WEBP");
-		_sprites.push_back(std::move(image));
+	auto &image = _sprites[index];
+	if (image.isNull()) {
+		const auto base = qsl(":/gui/emoji/emoji_");
+		image.load(base + QString::number(index + 1) + ".webp", "WEBP");
 	}
 }
 
-void UniversalImages::clear() {
-	_sprites.clear();
+void UniversalImages::clear(int index) {
+	if (index < _sprites.size()) {
+		_sprites[index] = QImage();
+	}
 }
 
 void UniversalImages::draw(
@@ -292,14 +296,17 @@ EmojiPtr FindReplacement(const QChar *start, const QChar *end, int *outLength) {
 			}
 		}
 	}
-	return internal::FindReplace(start, end, outLength);
+	return (start != end && internal::MayStartReplace(*start))
+		? internal::FindReplace(start, end, outLength)
+		: nullptr;
 }
 
-void ClearUniversalChecked() {
+void ClearUniversalChecked(int index) {
 	Expects(InstanceNormal != nullptr && InstanceLarge != nullptr);
 
-	if (InstanceNormal->cached() && InstanceLarge->cached()) {
-		Universal.clear();
+	if (!InstanceNormal->generating(index)
+		&& !InstanceLarge->generating(index)) {
+		Universal.clear(index);
 	}
 }
 
@@ -615,67 +622,82 @@ void Draw(QPainter &p, EmojiPtr emoji, int size, int x, int y) {
 	}
 }
 
-Instance::Instance(int size) : _size(size) {
-	readCache();
-	if (!cached()) {
-		Universal.ensureLoaded();
-		generateCache();
-	}
+Instance::Instance(int size)
+: _size(size)
+, _sprites(SpritesCount)
+, _dropUnusedTimer([=] { dropUnusedSprites(); }) {
+	_dropUnusedTimer.callEach(kDropUnusedSpritesTimeout);
 }
 
-bool Instance::cached() const {
-	return (_sprites.size() == SpritesCount);
+bool Instance::generating(int index) const {
+	Expects(index < _sprites.size());
+
+	return _sprites[index].generating.alive();
 }
 
 void Instance::draw(QPainter &p, EmojiPtr emoji, int x, int y) {
-	const auto sprite = emoji->sprite();
-	if (sprite >= _sprites.size()) {
+	const auto index = emoji->sprite();
+	Assert(index < _sprites.size());
+
+	auto &sprite = _sprites[index];
+	if (sprite.pixmap.isNull() && !sprite.generating.alive()) {
+		loadSprite(index);
+	}
+	sprite.used = true;
+	if (sprite.pixmap.isNull()) {
 		Universal.draw(p, emoji, _size, x, y);
 		return;
 	}
 	p.drawPixmap(
 		QPoint(x, y),
-		_sprites[sprite],
+		sprite.pixmap,
 		QRect(emoji->column() * _size, emoji->row() * _size, _size, _size));
 }
 
-void Instance::readCache() {
-	for (auto i = 0; i != SpritesCount; ++i) {
-		auto image = LoadFromFile(_size, i);
-		if (image.isNull()) {
-			return;
-		}
-		pushSprite(std::move(image));
+void Instance::loadSprite(int index) {
+	auto image = LoadFromFile(_size, index);
+	if (image.isNull()) {
+		Universal.ensureLoaded(index);
+		generateSprite(index);
+	} else {
+		pushSprite(index, std::move(image));
 	}
 }
 
-void Instance::generateCache() {
+void Instance::generateSprite(int index) {
 	const auto size = _size;
-	const auto index = _sprites.size();
 	auto [left, right] = base::make_binary_guard();
-	_generating = std::move(left);
+	_sprites[index].generating = std::move(left);
 	crl::async([=, guard = std::move(right)]() mutable {
 		crl::on_main([
 			this,
+			index,
 			image = Universal.generate(size, index),
 			guard = std::move(guard)
 		]() mutable {
 			if (!guard.alive()) {
 				return;
 			}
-			pushSprite(std::move(image));
-			if (cached()) {
-				ClearUniversalChecked();
-			} else {
-				generateCache();
-			}
+			guard.kill();
+			pushSprite(index, std::move(image));
+			ClearUniversalChecked(index);
 		});
 	});
 }
 
-void Instance::pushSprite(QImage &&data) {
-	_sprites.push_back(App::pixmapFromImageInPlace(std::move(data)));
-	_sprites.back().setDevicePixelRatio(cRetinaFactor());
+void Instance::pushSprite(int index, QImage &&data) {
+	auto &pixmap = _sprites[index].pixmap;
+	pixmap = App::pixmapFromImageInPlace(std::move(data));
+	pixmap.setDevicePixelRatio(cRetinaFactor());
+}
+
+void Instance::dropUnusedSprites() {
+	// Dropped sprites are read from the cache again when needed.
+	for (auto &sprite : _sprites) {
+		if (!base::take(sprite.used)) {
+			sprite.pixmap = QPixmap();
+		}
+	}
 }
 
 } // namespace Emoji
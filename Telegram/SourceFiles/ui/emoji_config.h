@@ -8,6 +8,7 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 #pragma once
 
 #include "base/binary_guard.h"
+#include "base/timer.h"
 #include "emoji.h"
 
 namespace Ui {
@@ -103,7 +104,10 @@ inline EmojiPtr FromUrl(const QString &url) {
 }
 
 inline EmojiPtr Find(const QChar *start, const QChar *end, int *outLength = nullptr) {
-	return internal::Find(start, end, outLength);
+	// Text without emoji is rejected here, without running the finder.
+	return (start != end && internal::MayStart(*start))
+		? internal::Find(start, end, outLength)
+		: nullptr;
 }
 
 inline EmojiPtr Find(const QString &text, int *outLength = nullptr) {
@@ -138,21 +142,30 @@ void AddRecent(EmojiPtr emoji);
 const QPixmap &SinglePixmap(EmojiPtr emoji, int fontHeight);
 void Draw(QPainter &p, EmojiPtr emoji, int size, int x, int y);
 
+// Sprites are loaded from the cache when first drawn and dropped when
+// they were not drawn for some time.
 class Instance {
 public:
 	explicit Instance(int size);
 
-	bool cached() const;
+	bool generating(int index) const;
 	void draw(QPainter &p, EmojiPtr emoji, int x, int y);
 
 private:
-	void readCache();
-	void generateCache();
-	void pushSprite(QImage &&data);
+	struct Sprite {
+		QPixmap pixmap;
+		base::binary_guard generating;
+		bool used = false;
+	};
+
+	void loadSprite(int index);
+	void generateSprite(int index);
+	void pushSprite(int index, QImage &&data);
+	void dropUnusedSprites();
 
 	int _size = 0;
-	std::vector<QPixmap> _sprites;
-	base::binary_guard _generating;
+	std::vector<Sprite> _sprites;
+	base::Timer _dropUnusedTimer;
 
 };
 
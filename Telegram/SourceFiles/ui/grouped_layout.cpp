@@ -10,6 +10,22 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 namespace Ui {
 namespace {
 
+// Albums with the same sizes are laid out the same way, so the results
+// are kept instead of repeating the search when dimensions are counted.
+constexpr auto kMaxCachedLayouts = 512;
+
+struct LayoutKey {
+	std::vector<std::pair<int, int>> sizes;
+	int maxWidth = 0;
+	int minWidth = 0;
+	int spacing = 0;
+};
+
+inline bool operator<(const LayoutKey &a, const LayoutKey &b) {
+	return std::tie(a.maxWidth, a.minWidth, a.spacing, a.sizes)
+		< std::tie(b.maxWidth, b.minWidth, b.spacing, b.sizes);
+}
+
 int Round(float64 value) {
 	return int(std::round(value));
 }
@@ -572,7 +588,24 @@ std::vector<GroupMediaLayout> LayoutMediaGroup(
 		int maxWidth,
 		int minWidth,
 		int spacing) {
-	return Layouter(sizes, maxWidth, minWidth, spacing).layout();
+	// Used only from the main thread.
+	static auto Cache = std::map<LayoutKey, std::vector<GroupMediaLayout>>();
+
+	auto key = LayoutKey{ {}, maxWidth, minWidth, spacing };
+	key.sizes.reserve(sizes.size());
+	for (const auto &size : sizes) {
+		key.sizes.emplace_back(size.width(), size.height());
+	}
+	const auto i = Cache.find(key);
+	if (i != end(Cache)) {
+		return i->second;
+	}
+	if (Cache.size() >= kMaxCachedLayouts) {
+		Cache.clear();
+	}
+	auto result = Layouter(sizes, maxWidth, minWidth, spacing).layout();
+	Cache.emplace(std::move(key), result);
+	return result;
 }
 
 RectParts GetCornersFromSides(RectParts sides) {
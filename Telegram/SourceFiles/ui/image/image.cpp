@@ -21,6 +21,13 @@ namespace {
 // After 128 MB of unpacked images we try to clear some memory.
 constexpr auto kMemoryForCache = 128 * 1024 * 1024;
 
+// After 64 MB of prepared pixmaps the least recently used are dropped.
+constexpr auto kMemoryForPixmaps = 64 * 1024 * 1024;
+constexpr auto kLogCacheStatsEach = 16384;
+
+// Prepared pixmaps up to 128 KB are kept in the disk cache as raw pixels.
+constexpr auto kMaxPreparedBytes = 128 * 1024;
+
 QMap<QString, Image*> LocalFileImages;
 QMap<QString, Image*> WebUrlImages;
 QMap<StorageKey, Image*> StorageImages;
@@ -56,6 +63,177 @@ uint64 SinglePixKey(Options options) {
 	return PixKey(0, 0, options);
 }
 
+// Prepared pixmaps of all images share one memory budget and are dropped
+// one by one, the image data is not unloaded together with them.
+class PixmapsCache {
+public:
+	PixmapsCache();
+
+	const QPixmap *find(not_null<const Image*> image, uint64 key);
+	const QPixmap &insert(
+		not_null<const Image*> image,
+		uint64 key,
+		QPixmap &&pixmap);
+	void remove(not_null<const Image*> image, uint64 key);
+	void remove(not_null<const Image*> image);
+	void clear();
+
+	int count() const {
+		return int(_map.size());
+	}
+	int64 usage() const {
+		return _usage;
+	}
+
+private:
+	using Key = std::pair<const Image*, uint64>;
+	struct Entry {
+		Key key;
+		QPixmap pixmap;
+		int64 usage = 0;
+	};
+	using Iterator = std::list<Entry>::iterator;
+
+	void erase(std::map<Key, Iterator>::iterator i);
+	void countLookup(bool hit);
+	void check();
+
+	std::list<Entry> _queue;
+	std::map<Key, Iterator> _map;
+	SingleQueuedInvokation _delayed;
+	int64 _usage = 0;
+	int64 _hits = 0;
+	int64 _misses = 0;
+
+};
+
+PixmapsCache::PixmapsCache() : _delayed([=] { check(); }) {
+}
+
+const QPixmap *PixmapsCache::find(not_null<const Image*> image, uint64 key) {
+	const auto i = _map.find(Key(image.get(), key));
+	countLookup(i != end(_map));
+	if (i == end(_map)) {
+		return nullptr;
+	}
+	_queue.splice(end(_queue), _queue, i->second);
+	return &i->second->pixmap;
+}
+
+const QPixmap &PixmapsCache::insert(
+		not_null<const Image*> image,
+		uint64 key,
+		QPixmap &&pixmap) {
+	const auto i = _map.find(Key(image.get(), key));
+	if (i != end(_map)) {
+		erase(i);
+	}
+	const auto usage = ComputeUsage(pixmap);
+	const auto j = _queue.insert(
+		end(_queue),
+		Entry{ Key(image.get(), key), std::move(pixmap), usage });
+	_map.emplace(j->key, j);
+	_usage += usage;
+
+	// Returned pixmaps are painted right away, so we evict only later.
+	if (_usage > kMemoryForPixmaps) {
+		_delayed.call();
+	}
+	return j->pixmap;
+}
+
+void PixmapsCache::remove(not_null<const Image*> image, uint64 key) {
+	const auto i = _map.find(Key(image.get(), key));
+	if (i != end(_map)) {
+		erase(i);
+	}
+}
+
+void PixmapsCache::remove(not_null<const Image*> image) {
+	auto i = _map.lower_bound(Key(image.get(), 0));
+	while (i != end(_map) && i->first.first == image.get()) {
+		erase(i++);
+	}
+}
+
+void PixmapsCache::clear() {
+	_map.clear();
+	_queue.clear();
+	_usage = 0;
+}
+
+void PixmapsCache::erase(std::map<Key, Iterator>::iterator i) {
+	_usage -= i->second->usage;
+	_queue.erase(i->second);
+	_map.erase(i);
+}
+
+void PixmapsCache::countLookup(bool hit) {
+	++(hit ? _hits : _misses);
+	if (!((_hits + _misses) % kLogCacheStatsEach)) {
+		DEBUG_LOG(("Pixmaps Cache: %1 hits, %2 misses, %3 bytes in %4."
+			).arg(_hits
+			).arg(_misses
+			).arg(_usage
+			).arg(_map.size()));
+	}
+}
+
+void PixmapsCache::check() {
+	while (_usage > kMemoryForPixmaps && !_queue.empty()) {
+		erase(_map.find(_queue.front().key));
+	}
+}
+
+PixmapsCache &Pixmaps() {
+	static auto Instance = PixmapsCache();
+	return Instance;
+}
+
+QByteArray SerializePrepared(QImage image) {
+	if (image.format() != QImage::Format_ARGB32_Premultiplied) {
+		image = std::move(image).convertToFormat(
+			QImage::Format_ARGB32_Premultiplied);
+	}
+	const auto width = image.width();
+	const auto height = image.height();
+	const auto header = 2 * int(sizeof(qint32));
+	const auto lineSize = width * 4;
+	auto result = QByteArray(header + height * lineSize, Qt::Uninitialized);
+	const auto data = result.data();
+	const auto sizes = std::array<qint32, 2>{ { width, height } };
+	memcpy(data, sizes.data(), header);
+	for (auto y = 0; y != height; ++y) {
+		memcpy(data + header + y * lineSize, image.constScanLine(y), lineSize);
+	}
+	return result;
+}
+
+QImage DeserializePrepared(const QByteArray &bytes) {
+	const auto header = 2 * int(sizeof(qint32));
+	if (bytes.size() < header) {
+		return QImage();
+	}
+	auto sizes = std::array<qint32, 2>();
+	memcpy(sizes.data(), bytes.constData(), header);
+	const auto [width, height] = sizes;
+	const auto lineSize = width * 4;
+	if (width <= 0
+		|| height <= 0
+		|| int64(lineSize) * height > kMaxPreparedBytes
+		|| bytes.size() != header + lineSize * height) {
+		return QImage();
+	}
+	auto result = QImage(width, height, QImage::Format_ARGB32_Premultiplied);
+	for (auto y = 0; y != height; ++y) {
+		memcpy(
+			result.scanLine(y),
+			bytes.constData() + header + y * lineSize,
+			lineSize);
+	}
+	return result;
+}
+
 } // namespace
 
 void ClearRemote() {
@@ -75,12 +253,26 @@ void ClearRemote() {
 
 void ClearAll() {
 	ActiveCache().clear();
+	Pixmaps().clear();
 	for (auto image : base::take(LocalFileImages)) {
 		delete image;
 	}
 	ClearRemote();
 }
 
+MemoryUsage CollectMemoryUsage() {
+	auto result = MemoryUsage();
+	result.images = LocalFileImages.size()
+		+ WebUrlImages.size()
+		+ StorageImages.size()
+		+ WebCachedImages.size()
+		+ GeoPointImages.size();
+	result.imagesBytes = ActiveCache().usage();
+	result.pixmaps = Pixmaps().count();
+	result.pixmapsBytes = Pixmaps().usage();
+	return result;
+}
+
 ImagePtr Create(const QString &file, QByteArray format) {
 	if (file.startsWith(qstr("http://"), Qt::CaseInsensitive)
 		|| file.startsWith(qstr("https://"), Qt::CaseInsensitive)) {
@@ -356,6 +548,11 @@ bool Image::isNull() const {
 	return (this == Blank().get());
 }
 
+QImage Image::original() const {
+	checkSource();
+	return _data;
+}
+
 const QPixmap &Image::pix(
 		Data::FileOrigin origin,
 		int32 w,
@@ -369,15 +566,11 @@ const QPixmap &Image::pix(
         h *= cIntRetinaFactor();
     }
 	auto options = Option::Smooth | Option::None;
-	auto k = PixKey(w, h, options);
-	auto i = _sizesCache.constFind(k);
-	if (i == _sizesCache.cend()) {
-		auto p = pixNoCache(origin, w, h, options);
-        p.setDevicePixelRatio(cRetinaFactor());
-		i = _sizesCache.insert(k, p);
-		ActiveCache().increment(ComputeUsage(*i));
+	const auto k = PixKey(w, h, options);
+	if (const auto cached = Pixmaps().find(this, k)) {
+		return *cached;
 	}
-	return i.value();
+	return preparePix(origin, k, w, h, options);
 }
 
 const QPixmap &Image::pixRounded(
@@ -408,15 +601,11 @@ const QPixmap &Image::pixRounded(
 	} else if (radius == ImageRoundRadius::Ellipse) {
 		options |= Option::Circled | cornerOptions(corners);
 	}
-	auto k = PixKey(w, h, options);
-	auto i = _sizesCache.constFind(k);
-	if (i == _sizesCache.cend()) {
-		auto p = pixNoCache(origin, w, h, options);
-		p.setDevicePixelRatio(cRetinaFactor());
-		i = _sizesCache.insert(k, p);
-		ActiveCache().increment(ComputeUsage(*i));
+	const auto k = PixKey(w, h, options);
+	if (const auto cached = Pixmaps().find(this, k)) {
+		return *cached;
 	}
-	return i.value();
+	return preparePix(origin, k, w, h, options);
 }
 
 const QPixmap &Image::pixCircled(
@@ -432,15 +621,11 @@ const QPixmap &Image::pixCircled(
 		h *= cIntRetinaFactor();
 	}
 	auto options = Option::Smooth | Option::Circled;
-	auto k = PixKey(w, h, options);
-	auto i = _sizesCache.constFind(k);
-	if (i == _sizesCache.cend()) {
-		auto p = pixNoCache(origin, w, h, options);
-		p.setDevicePixelRatio(cRetinaFactor());
-		i = _sizesCache.insert(k, p);
-		ActiveCache().increment(ComputeUsage(*i));
+	const auto k = PixKey(w, h, options);
+	if (const auto cached = Pixmaps().find(this, k)) {
+		return *cached;
 	}
-	return i.value();
+	return preparePix(origin, k, w, h, options);
 }
 
 const QPixmap &Image::pixBlurredCircled(
@@ -456,15 +641,11 @@ const QPixmap &Image::pixBlurredCircled(
 		h *= cIntRetinaFactor();
 	}
 	auto options = Option::Smooth | Option::Circled | Option::Blurred;
-	auto k = PixKey(w, h, options);
-	auto i = _sizesCache.constFind(k);
-	if (i == _sizesCache.cend()) {
-		auto p = pixNoCache(origin, w, h, options);
-		p.setDevicePixelRatio(cRetinaFactor());
-		i = _sizesCache.insert(k, p);
-		ActiveCache().increment(ComputeUsage(*i));
+	const auto k = PixKey(w, h, options);
+	if (const auto cached = Pixmaps().find(this, k)) {
+		return *cached;
 	}
-	return i.value();
+	return preparePix(origin, k, w, h, options);
 }
 
 const QPixmap &Image::pixBlurred(
@@ -480,15 +661,11 @@ const QPixmap &Image::pixBlurred(
 		h *= cIntRetinaFactor();
 	}
 	auto options = Option::Smooth | Option::Blurred;
-	auto k = PixKey(w, h, options);
-	auto i = _sizesCache.constFind(k);
-	if (i == _sizesCache.cend()) {
-		auto p = pixNoCache(origin, w, h, options);
-		p.setDevicePixelRatio(cRetinaFactor());
-		i = _sizesCache.insert(k, p);
-		ActiveCache().increment(ComputeUsage(*i));
+	const auto k = PixKey(w, h, options);
+	if (const auto cached = Pixmaps().find(this, k)) {
+		return *cached;
 	}
-	return i.value();
+	return preparePix(origin, k, w, h, options);
 }
 
 const QPixmap &Image::pixColored(
@@ -505,15 +682,13 @@ const QPixmap &Image::pixColored(
 		h *= cIntRetinaFactor();
 	}
 	auto options = Option::Smooth | Option::Colored;
-	auto k = PixKey(w, h, options);
-	auto i = _sizesCache.constFind(k);
-	if (i == _sizesCache.cend()) {
-		auto p = pixColoredNoCache(origin, add, w, h, true);
-		p.setDevicePixelRatio(cRetinaFactor());
-		i = _sizesCache.insert(k, p);
-		ActiveCache().increment(ComputeUsage(*i));
+	const auto k = PixKey(w, h, options);
+	if (const auto cached = Pixmaps().find(this, k)) {
+		return *cached;
 	}
-	return i.value();
+	auto p = pixColoredNoCache(origin, add, w, h, true);
+	p.setDevicePixelRatio(cRetinaFactor());
+	return Pixmaps().insert(this, k, std::move(p));
 }
 
 const QPixmap &Image::pixBlurredColored(
@@ -530,15 +705,13 @@ const QPixmap &Image::pixBlurredColored(
 		h *= cIntRetinaFactor();
 	}
 	auto options = Option::Blurred | Option::Smooth | Option::Colored;
-	auto k = PixKey(w, h, options);
-	auto i = _sizesCache.constFind(k);
-	if (i == _sizesCache.cend()) {
-		auto p = pixBlurredColoredNoCache(origin, add, w, h);
-		p.setDevicePixelRatio(cRetinaFactor());
-		i = _sizesCache.insert(k, p);
-		ActiveCache().increment(ComputeUsage(*i));
+	const auto k = PixKey(w, h, options);
+	if (const auto cached = Pixmaps().find(this, k)) {
+		return *cached;
 	}
-	return i.value();
+	auto p = pixBlurredColoredNoCache(origin, add, w, h);
+	p.setDevicePixelRatio(cRetinaFactor());
+	return Pixmaps().insert(this, k, std::move(p));
 }
 
 const QPixmap &Image::pixSingle(
@@ -577,18 +750,14 @@ const QPixmap &Image::pixSingle(
 		options |= Option::Colored;
 	}
 
-	auto k = SinglePixKey(options);
-	auto i = _sizesCache.constFind(k);
-	if (i == _sizesCache.cend() || i->width() != (outerw * cIntRetinaFactor()) || i->height() != (outerh * cIntRetinaFactor())) {
-		if (i != _sizesCache.cend()) {
-			ActiveCache().decrement(ComputeUsage(*i));
-		}
-		auto p = pixNoCache(origin, w, h, options, outerw, outerh, colored);
-		p.setDevicePixelRatio(cRetinaFactor());
-		i = _sizesCache.insert(k, p);
-		ActiveCache().increment(ComputeUsage(*i));
+	const auto k = SinglePixKey(options);
+	const auto cached = Pixmaps().find(this, k);
+	if (cached
+		&& cached->width() == outerw * cIntRetinaFactor()
+		&& cached->height() == outerh * cIntRetinaFactor()) {
+		return *cached;
 	}
-	return i.value();
+	return preparePix(origin, k, w, h, options, outerw, outerh, colored);
 }
 
 const QPixmap &Image::pixBlurredSingle(
@@ -623,18 +792,166 @@ const QPixmap &Image::pixBlurredSingle(
 		options |= Option::Circled | cornerOptions(corners);
 	}
 
-	auto k = SinglePixKey(options);
-	auto i = _sizesCache.constFind(k);
-	if (i == _sizesCache.cend() || i->width() != (outerw * cIntRetinaFactor()) || i->height() != (outerh * cIntRetinaFactor())) {
-		if (i != _sizesCache.cend()) {
-			ActiveCache().decrement(ComputeUsage(*i));
+	const auto k = SinglePixKey(options);
+	const auto cached = Pixmaps().find(this, k);
+	if (cached
+		&& cached->width() == outerw * cIntRetinaFactor()
+		&& cached->height() == outerh * cIntRetinaFactor()) {
+		return *cached;
+	}
+	return preparePix(origin, k, w, h, options, outerw, outerh);
+}
+
+const QPixmap &Image::preparePix(
+		Data::FileOrigin origin,
+		uint64 key,
+		int w,
+		int h,
+		Options options,
+		int outerw,
+		int outerh,
+		const style::color *colored) const {
+	const auto cacheKey = preparedCacheKey(
+		key,
+		w,
+		h,
+		outerw,
+		outerh,
+		colored);
+	auto prepared = cacheKey ? &_prepared[*cacheKey] : nullptr;
+	if (prepared
+		&& _data.isNull()
+		&& prepared->state != PreparedState::Missing) {
+		if (prepared->state != PreparedState::Loading) {
+			loadPrepared(key, *cacheKey, *prepared);
+		}
+
+		// Don't start loading the original until we know that the
+		// prepared pixmap is not in the disk cache.
+		auto blank = Blank()->pixNoCache(origin, w, h, options, outerw, outerh);
+		blank.setDevicePixelRatio(cRetinaFactor());
+		return Pixmaps().insert(this, key, std::move(blank));
+	}
+	auto p = pixNoCache(origin, w, h, options, outerw, outerh, colored);
+	p.setDevicePixelRatio(cRetinaFactor());
+	if (prepared && !_data.isNull()) {
+		storePrepared(*cacheKey, *prepared, p);
+	}
+	return Pixmaps().insert(this, key, std::move(p));
+}
+
+std::optional<Storage::Cache::Key> Image::preparedCacheKey(
+		uint64 key,
+		int w,
+		int h,
+		int outerw,
+		int outerh,
+		const style::color *colored) const {
+	if (colored || isNull()) {
+		// Colored pixmaps depend on the palette.
+		return std::nullopt;
+	}
+	const auto original = cacheKey();
+	if (!original) {
+		return std::nullopt;
+	}
+	const auto outer = (outerw > 0 && outerh > 0)
+		? QSize(outerw, outerh) * cIntRetinaFactor()
+		: QSize();
+	const auto size = !outer.isEmpty()
+		? outer
+		: (h > 0)
+		? QSize(w, h)
+		: (width() > 0)
+		? QSize(w, w * height() / width())
+		: QSize();
+	if (size.isEmpty()
+		|| int64(size.width()) * size.height() * 4 > kMaxPreparedBytes) {
+		return std::nullopt;
+	}
+	return Data::PreparedImageCacheKey(*original, key, outer);
+}
+
+void Image::loadPrepared(
+		uint64 key,
+		const Storage::Cache::Key &cacheKey,
+		Prepared &prepared) const {
+	auto [left, right] = base::make_binary_guard();
+	prepared.state = PreparedState::Loading;
+	prepared.loading = std::move(left);
+
+	auto callback = [=, guard = std::move(right)](
+			QByteArray &&value) mutable {
+		auto image = DeserializePrepared(value);
+		crl::on_main([
+			=,
+			guard = std::move(guard),
+			image = std::move(image)
+		]() mutable {
+			if (guard.alive()) {
+				preparedLoaded(key, cacheKey, std::move(image));
+			}
+		});
+	};
+	Auth().data().cache().get(
+		cacheKey,
+		std::move(callback),
+		Storage::Cache::Priority::Visible);
+}
+
+void Image::preparedLoaded(
+		uint64 key,
+		const Storage::Cache::Key &cacheKey,
+		QImage &&image) const {
+	const auto i = _prepared.find(cacheKey);
+	if (i == end(_prepared)) {
+		return;
+	}
+	auto &prepared = i->second;
+	prepared.state = image.isNull()
+		? PreparedState::Missing
+		: PreparedState::Stored;
+	prepared.loading = base::binary_guard();
+	if (_data.isNull()) {
+		if (image.isNull()) {
+			// The blank will be replaced when painted next time.
+			Pixmaps().remove(this, key);
+		} else {
+			auto pixmap = App::pixmapFromImageInPlace(std::move(image));
+			pixmap.setDevicePixelRatio(cRetinaFactor());
+			Pixmaps().insert(this, key, std::move(pixmap));
 		}
-		auto p = pixNoCache(origin, w, h, options, outerw, outerh);
-		p.setDevicePixelRatio(cRetinaFactor());
-		i = _sizesCache.insert(k, p);
-		ActiveCache().increment(ComputeUsage(*i));
 	}
-	return i.value();
+	Auth().downloaderTaskFinished().notify();
+}
+
+void Image::storePrepared(
+		const Storage::Cache::Key &cacheKey,
+		Prepared &prepared,
+		const QPixmap &pixmap) const {
+	if (prepared.state == PreparedState::Stored) {
+		return;
+	}
+	const auto known = (prepared.state == PreparedState::Missing);
+	prepared.state = PreparedState::Stored;
+	prepared.loading = base::binary_guard();
+	auto value = Storage::Cache::Database::TaggedValue(
+		SerializePrepared(pixmap.toImage()),
+		Data::kPreparedImageCacheTag);
+	const auto priority = Storage::Cache::Priority::Background;
+	if (known) {
+		Auth().data().cache().put(
+			cacheKey,
+			std::move(value),
+			nullptr,
+			priority);
+	} else {
+		Auth().data().cache().putIfEmpty(
+			cacheKey,
+			std::move(value),
+			nullptr,
+			priority);
+	}
 }
 
 QPixmap Image::pixNoCache(
@@ -791,11 +1108,7 @@ void Image::setImageBytes(const QByteArray &bytes) {
 }
 
 void Image::invalidateSizeCache() const {
-	auto &cache = ActiveCache();
-	for (const auto &image : std::as_const(_sizesCache)) {
-		cache.decrement(ComputeUsage(image));
-	}
-	_sizesCache.clear();
+	Pixmaps().remove(this);
 }
 
 Image::~Image() {
@@ -8,6 +8,10 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 #pragma once
 
 #include "ui/image/image_prepare.h"
+#include "storage/cache/storage_cache_types.h"
+#include "base/binary_guard.h"
+#include "base/flat_map.h"
+#include "base/last_used_cache.h"
 
 class HistoryItem;
 
@@ -16,6 +20,14 @@ namespace Images {
 void ClearRemote();
 void ClearAll();
 
+struct MemoryUsage {
+	int images = 0;
+	int64 imagesBytes = 0;
+	int pixmaps = 0;
+	int64 pixmapsBytes = 0;
+};
+MemoryUsage CollectMemoryUsage();
+
 ImagePtr Create(const QString &file, QByteArray format);
 ImagePtr Create(const QString &url, QSize box);
 ImagePtr Create(const QString &url, int width, int height);
@@ -64,6 +76,7 @@ public:
 	virtual bool loading() = 0;
 	virtual bool displayLoading() = 0;
 	virtual void cancel() = 0;
+	virtual void pause() = 0;
 	virtual float64 progress() = 0;
 	virtual int loadOffset() = 0;
 
@@ -83,6 +96,9 @@ public:
 
 	virtual QByteArray bytesForCache() = 0;
 
+	// The bytes loaded so far without gaps, while the image is loading.
+	virtual QByteArray partialBytes() = 0;
+
 	virtual ~Source() = default;
 
 };
@@ -183,6 +199,9 @@ public:
 	void cancel() {
 		_source->cancel();
 	}
+	void pause() {
+		_source->pause();
+	}
 	float64 progress() const {
 		return loaded() ? 1. : _source->progress();
 	}
@@ -227,6 +246,9 @@ public:
 	QByteArray bytesForCache() const {
 		return _source->bytesForCache();
 	}
+	QByteArray partialBytes() const {
+		return _source->partialBytes();
+	}
 	bool isDelayedStorageImage() const {
 		return _source->isDelayedStorageImage();
 	}
@@ -234,19 +256,69 @@ public:
 	bool loaded() const;
 	bool isNull() const;
 	void unload() const;
+
+	// A shared copy of the loaded image, it can be used in any thread.
+	QImage original() const;
 	void setDelayedStorageLocation(
 		Data::FileOrigin origin,
 		const StorageImageLocation &location);
 	void setImageBytes(const QByteArray &bytes);
 
+	base::last_used_hook<const Image> &lastUsedHook() const {
+		return _lastUsedHook;
+	}
+
 	~Image();
 
 private:
+	// Small prepared pixmaps are kept in the disk cache as well, so that
+	// they can be painted without loading and preparing the original.
+	enum class PreparedState : uchar {
+		Unknown,
+		Loading,
+		Missing,
+		Stored,
+	};
+	struct Prepared {
+		PreparedState state = PreparedState::Unknown;
+		base::binary_guard loading;
+	};
+
 	void checkSource() const;
 	void invalidateSizeCache() const;
 
+	const QPixmap &preparePix(
+		Data::FileOrigin origin,
+		uint64 key,
+		int w,
+		int h,
+		Images::Options options,
+		int outerw = -1,
+		int outerh = -1,
+		const style::color *colored = nullptr) const;
+	std::optional<Storage::Cache::Key> preparedCacheKey(
+		uint64 key,
+		int w,
+		int h,
+		int outerw,
+		int outerh,
+		const style::color *colored) const;
+	void loadPrepared(
+		uint64 key,
+		const Storage::Cache::Key &cacheKey,
+		Prepared &prepared) const;
+	void preparedLoaded(
+		uint64 key,
+		const Storage::Cache::Key &cacheKey,
+		QImage &&image) const;
+	void storePrepared(
+		const Storage::Cache::Key &cacheKey,
+		Prepared &prepared,
+		const QPixmap &pixmap) const;
+
 	std::unique_ptr<Images::Source> _source;
-	mutable QMap<uint64, QPixmap> _sizesCache;
 	mutable QImage _data;
+	mutable base::flat_map<Storage::Cache::Key, Prepared> _prepared;
+	mutable base::last_used_hook<const Image> _lastUsedHook;
 
 };
@@ -10,6 +10,14 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 #include "ui/image/image.h"
 #include "platform/platform_specific.h"
 
+namespace {
+
+// Documents check their files each time they're painted, so a successful
+// check is trusted for a while instead of hitting the file system again.
+constexpr auto kCheckCacheTimeout = TimeMs(1000);
+
+} // namespace
+
 ImagePtr::ImagePtr() : _data(Image::Blank().get()) {
 }
 
@@ -102,6 +110,12 @@ FileLocation::FileLocation(const QString &name) : fname(name) {
 bool FileLocation::check() const {
 	if (fname.isEmpty()) return false;
 
+	const auto now = getms(true);
+	if (_checked && now >= _checked && now < _checked + kCheckCacheTimeout) {
+		return true;
+	}
+	_checked = 0;
+
 	ReadAccessEnabler enabler(_bookmark);
 	if (enabler.failed()) {
 		const_cast<FileLocation*>(this)->_bookmark = nullptr;
@@ -125,6 +139,7 @@ bool FileLocation::check() const {
 		DEBUG_LOG(("File location check: Wrong last modified time %1 when should be %2").arg(realModified.toMSecsSinceEpoch()).arg(modified.toMSecsSinceEpoch()));
 		return false;
 	}
+	_checked = now;
 	return true;
 }
 
@@ -137,6 +152,7 @@ QByteArray FileLocation::bookmark() const {
 }
 
 void FileLocation::setBookmark(const QByteArray &bm) {
+	_checked = 0;
 	_bookmark.reset(bm.isEmpty() ? nullptr : new PsFileBookmark(bm));
 }
 
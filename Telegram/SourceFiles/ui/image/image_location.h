@@ -308,6 +308,7 @@ public:
 
 private:
 	std::shared_ptr<PsFileBookmark> _bookmark;
+	mutable TimeMs _checked = 0;
 
 };
 inline bool operator==(const FileLocation &a, const FileLocation &b) {
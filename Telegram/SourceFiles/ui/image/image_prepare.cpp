@@ -14,7 +14,7 @@ TG_FORCE_INLINE uint64 blurGetColors(const uchar *p) {
 	return (uint64)p[0] + ((uint64)p[1] << 16) + ((uint64)p[2] << 32) + ((uint64)p[3] << 48);
 }
 
-const QPixmap &circleMask(int width, int height) {
+const QImage &circleMask(int width, int height) {
 	Assert(Global::started());
 
 	uint64 key = uint64(uint32(width)) << 32 | uint64(uint32(height));
@@ -33,12 +33,38 @@ const QPixmap &circleMask(int width, int height) {
 			p.setPen(Qt::NoPen);
 			p.drawEllipse(0, 0, width, height);
 		}
-		mask.setDevicePixelRatio(cRetinaFactor());
-		i = masks.insert(key, App::pixmapFromImageInPlace(std::move(mask)));
+		i = masks.insert(key, std::move(mask));
 	}
 	return i.value();
 }
 
+// Multiplies the pixels by the opacity of a white mask. Most of the mask
+// pixels of corners and circles are fully opaque or fully transparent,
+// they are copied or cleared without the multiplication.
+void applyMask(uint32 *ints, int intsPerLine, const QImage &mask) {
+	Expects(mask.depth() == 32);
+
+	const auto maskWidth = mask.width();
+	const auto maskHeight = mask.height();
+	const auto maskIntsPerLine = (mask.bytesPerLine() >> 2);
+	auto maskInts = reinterpret_cast<const uint32*>(mask.constBits());
+	for (auto y = 0; y != maskHeight; ++y) {
+		for (auto x = 0; x != maskWidth; ++x) {
+			const auto alpha = (maskInts[x] >> 24);
+			if (alpha == 0xFF) {
+				continue;
+			} else if (!alpha) {
+				ints[x] = 0;
+				continue;
+			}
+			const auto opacity = static_cast<anim::ShiftedMultiplier>(alpha) + 1;
+			ints[x] = anim::unshifted(anim::shifted(ints[x]) * opacity);
+		}
+		maskInts += maskIntsPerLine;
+		ints += intsPerLine;
+	}
+}
+
 } // namespace
 
 QPixmap PixmapFast(QImage &&image) {
@@ -125,40 +151,38 @@ x++;
 				yw += stride;
 			}
 
-			const int he = h - r1;
+			// The vertical pass goes row by row with a pair of sums for each
+			// column, so all the reads and writes are sequential in memory
+			// and the inner loop can be vectorized by the compiler.
+			auto columnSums = std::vector<uint64>(w);
+			auto columnAllSums = std::vector<uint64>(w);
+			const auto sums = columnSums.data();
+			const auto allsums = columnAllSums.data();
 			for (x = 0; x < w; x++) {
-				uint64 rgballsum = -radius * rgb[x];
-				uint64 rgbsum = rgb[x] * ((r1 * (r1 + 1)) >> 1);
-				for (i = 1; i <= radius; i++) {
-					rgbsum += rgb[i * w + x] * (r1 - i);
-					rgballsum += rgb[i * w + x];
-				}
-
-				y = 0;
-				int yi = x * 4;
-
-#define update(start, middle, end) \
-uint64 res = rgbsum >> 4; \
-pix[yi] = res & 0xFF; \
-pix[yi + 1] = (res >> 16) & 0xFF; \
-pix[yi + 2] = (res >> 32) & 0xFF; \
-pix[yi + 3] = (res >> 48) & 0xFF; \
-rgballsum += rgb[x + (start) * w] - 2 * rgb[x + (middle) * w] + rgb[x + (end) * w]; \
-rgbsum += rgballsum; \
-y++; \
-yi += stride;
-
-				while (y < r1) {
-					update(0, y, y + r1);
-				}
-				while (y < he) {
-					update(y - r1, y, y + r1);
+				allsums[x] = -radius * rgb[x];
+				sums[x] = rgb[x] * ((r1 * (r1 + 1)) >> 1);
+			}
+			for (i = 1; i <= radius; i++) {
+				const auto row = rgb + i * w;
+				for (x = 0; x < w; x++) {
+					sums[x] += row[x] * (r1 - i);
+					allsums[x] += row[x];
 				}
-				while (y < h) {
-					update(y - r1, y, h - 1);
+			}
+			for (y = 0; y < h; y++) {
+				const auto start = rgb + std::max(y - r1, 0) * w;
+				const auto middle = rgb + y * w;
+				const auto end = rgb + std::min(y + r1, h - 1) * w;
+				const auto out = pix + y * stride;
+				for (x = 0; x < w; x++) {
+					const auto res = sums[x] >> 4;
+					out[x * 4] = res & 0xFF;
+					out[x * 4 + 1] = (res >> 16) & 0xFF;
+					out[x * 4 + 2] = (res >> 32) & 0xFF;
+					out[x * 4 + 3] = (res >> 48) & 0xFF;
+					allsums[x] += start[x] - 2 * middle[x] + end[x];
+					sums[x] += allsums[x];
 				}
-
-#undef update
 			}
 
 			delete[] rgb;
@@ -174,10 +198,11 @@ void prepareCircle(QImage &img) {
 	img = img.convertToFormat(QImage::Format_ARGB32_Premultiplied);
 	Assert(!img.isNull());
 
-	QPixmap mask = circleMask(img.width(), img.height());
-	Painter p(&img);
-	p.setCompositionMode(QPainter::CompositionMode_DestinationIn);
-	p.drawPixmap(0, 0, mask);
+	const auto &mask = circleMask(img.width(), img.height());
+	applyMask(
+		reinterpret_cast<uint32*>(img.bits()),
+		img.bytesPerLine() >> 2,
+		mask);
 }
 
 void prepareRound(
@@ -208,26 +233,7 @@ void prepareRound(
 	auto intsBottomLeft = ints + target.x() + (target.y() + target.height() - cornerHeight) * imageWidth;
 	auto intsBottomRight = ints + target.x() + target.width() - cornerWidth + (target.y() + target.height() - cornerHeight) * imageWidth;
 	auto maskCorner = [&](uint32 *imageInts, const QImage &mask) {
-		auto maskWidth = mask.width();
-		auto maskHeight = mask.height();
-		auto maskBytesPerPixel = (mask.depth() >> 3);
-		auto maskBytesPerLine = mask.bytesPerLine();
-		auto maskBytesAdded = maskBytesPerLine - maskWidth * maskBytesPerPixel;
-		auto maskBytes = mask.constBits();
-		Assert(maskBytesAdded >= 0);
-		Assert(mask.depth() == (maskBytesPerPixel << 3));
-		auto imageIntsAdded = imageIntsPerLine - maskWidth * imageIntsPerPixel;
-		Assert(imageIntsAdded >= 0);
-		for (auto y = 0; y != maskHeight; ++y) {
-			for (auto x = 0; x != maskWidth; ++x) {
-				auto opacity = static_cast<anim::ShiftedMultiplier>(*maskBytes) + 1;
-				*imageInts = anim::unshifted(anim::shifted(*imageInts) * opacity);
-				maskBytes += maskBytesPerPixel;
-				imageInts += imageIntsPerPixel;
-			}
-			maskBytes += maskBytesAdded;
-			imageInts += imageIntsAdded;
-		}
+		applyMask(imageInts, imageIntsPerLine, mask);
 	};
 	if (corners & RectPart::TopLeft) maskCorner(intsTopLeft, cornerMasks[0]);
 	if (corners & RectPart::TopRight) maskCorner(intsTopRight, cornerMasks[1]);
@@ -265,13 +271,23 @@ QImage prepareColored(style::color add, QImage image) {
 
 	if (auto pix = image.bits()) {
 		int ca = int(add->c.alphaF() * 0xFF), cr = int(add->c.redF() * 0xFF), cg = int(add->c.greenF() * 0xFF), cb = int(add->c.blueF() * 0xFF);
-		const int w = image.width(), h = image.height(), size = w * h * 4;
-		for (auto i = index_type(); i < size; i += 4) {
-			int b = pix[i], g = pix[i + 1], r = pix[i + 2], a = pix[i + 3], aca = a * ca;
-			pix[i + 0] = uchar(b + ((aca * (cb - b)) >> 16));
-			pix[i + 1] = uchar(g + ((aca * (cg - g)) >> 16));
-			pix[i + 2] = uchar(r + ((aca * (cr - r)) >> 16));
-			pix[i + 3] = uchar(a + ((aca * (0xFF - a)) >> 16));
+		const auto ints = reinterpret_cast<uint32*>(pix);
+		const auto size = image.width() * image.height();
+		for (auto i = index_type(); i < size; ++i) {
+			// Transparent pixels are left as they are.
+			const auto value = ints[i];
+			const int a = (value >> 24);
+			if (!a) {
+				continue;
+			}
+			const int r = (value >> 16) & 0xFF;
+			const int g = (value >> 8) & 0xFF;
+			const int b = value & 0xFF;
+			const int aca = a * ca;
+			ints[i] = (uint32(uchar(a + ((aca * (0xFF - a)) >> 16))) << 24)
+				| (uint32(uchar(r + ((aca * (cr - r)) >> 16))) << 16)
+				| (uint32(uchar(g + ((aca * (cg - g)) >> 16))) << 8)
+				| uint32(uchar(b + ((aca * (cb - b)) >> 16)));
 		}
 	}
 	return image;
@@ -76,6 +76,9 @@ bool ImageSource::displayLoading() {
 void ImageSource::cancel() {
 }
 
+void ImageSource::pause() {
+}
+
 float64 ImageSource::progress() {
 	return 1.;
 }
@@ -141,6 +144,10 @@ QByteArray ImageSource::bytesForCache() {
 	return result;
 }
 
+QByteArray ImageSource::partialBytes() {
+	return QByteArray();
+}
+
 LocalFileSource::LocalFileSource(
 	const QString &path,
 	const QByteArray &content,
@@ -211,6 +218,9 @@ bool LocalFileSource::displayLoading() {
 void LocalFileSource::cancel() {
 }
 
+void LocalFileSource::pause() {
+}
+
 float64 LocalFileSource::progress() {
 	return 1.;
 }
@@ -280,12 +290,22 @@ QByteArray LocalFileSource::bytesForCache() {
 	return (_bytes == "(bad)") ? QByteArray() : _bytes;
 }
 
+QByteArray LocalFileSource::partialBytes() {
+	return QByteArray();
+}
+
 QImage RemoteSource::takeLoaded() {
 	if (!loaderValid() || !_loader->finished()) {
 		return QImage();
+	} else if (!_decodeFinished && !_loader->imageDecoded()) {
+		decodeAsync();
+		return QImage();
 	}
 
-	auto data = _loader->imageData(shrinkBox());
+	auto data = _decodeFinished
+		? base::take(_decoded)
+		: _loader->imageData(shrinkBox());
+	_decodeFinished = false;
 	if (data.isNull()) {
 		destroyLoaderDelayed(CancelledFileLoader);
 		return QImage();
@@ -298,6 +318,43 @@ QImage RemoteSource::takeLoaded() {
 	return data;
 }
 
+void RemoteSource::decodeAsync() {
+	if (_decoding.alive()) {
+		return;
+	}
+	auto [first, second] = base::make_binary_guard();
+	_decoding = std::move(first);
+	crl::async([
+		=,
+		bytes = _loader->bytes(),
+		shrinkBox = this->shrinkBox(),
+		guard = std::move(second)
+	]() mutable {
+		auto image = FileLoader::ReadImage(bytes, shrinkBox);
+		crl::on_main([
+			=,
+			image = std::move(image),
+			guard = std::move(guard)
+		]() mutable {
+			if (!guard.alive()) {
+				return;
+			}
+			_decoding.kill();
+			_decoded = std::move(image);
+			_decodeFinished = true;
+
+			// Let the images waiting for us to be repainted.
+			Auth().downloader().taskFinished().notify();
+		});
+	});
+}
+
+void RemoteSource::cancelDecoding() {
+	_decoding.kill();
+	_decoded = QImage();
+	_decodeFinished = false;
+}
+
 bool RemoteSource::loaderValid() const {
 	return _loader && _loader != CancelledFileLoader;
 }
@@ -305,6 +362,7 @@ bool RemoteSource::loaderValid() const {
 void RemoteSource::destroyLoaderDelayed(FileLoader *newValue) {
 	Expects(loaderValid());
 
+	cancelDecoding();
 	_loader->stop();
 	auto loader = std::unique_ptr<FileLoader>(std::exchange(_loader, newValue));
 	Auth().downloader().delayedDestroyLoader(std::move(loader));
@@ -401,6 +459,7 @@ bool RemoteSource::displayLoading() {
 void RemoteSource::cancel() {
 	if (!loaderValid()) return;
 
+	cancelDecoding();
 	const auto loader = std::exchange(_loader, CancelledFileLoader);
 	loader->cancel();
 	loader->stop();
@@ -408,8 +467,15 @@ void RemoteSource::cancel() {
 		std::unique_ptr<FileLoader>(loader));
 }
 
+void RemoteSource::pause() {
+	if (loaderValid()) {
+		_loader->pause();
+	}
+}
+
 void RemoteSource::unload() {
 	if (loaderValid()) {
+		cancelDecoding();
 		delete base::take(_loader);
 	}
 }
@@ -448,6 +514,10 @@ QByteArray RemoteSource::bytesForCache() {
 	return QByteArray();
 }
 
+QByteArray RemoteSource::partialBytes() {
+	return loaderValid() ? _loader->partialBytes() : QByteArray();
+}
+
 StorageSource::StorageSource(const StorageImageLocation &location, int size)
 : _location(location)
 , _size(size) {
@@ -8,6 +8,7 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 #pragma once
 
 #include "ui/image/image.h"
+#include "base/binary_guard.h"
 
 namespace Images {
 
@@ -34,6 +35,7 @@ public:
 	bool loading() override;
 	bool displayLoading() override;
 	void cancel() override;
+	void pause() override;
 	float64 progress() override;
 	int loadOffset() override;
 
@@ -52,6 +54,7 @@ public:
 	void setInformation(int size, int width, int height) override;
 
 	QByteArray bytesForCache() override;
+	QByteArray partialBytes() override;
 
 private:
 	QImage _data;
@@ -89,6 +92,7 @@ public:
 	bool loading() override;
 	bool displayLoading() override;
 	void cancel() override;
+	void pause() override;
 	float64 progress() override;
 	int loadOffset() override;
 
@@ -107,6 +111,7 @@ public:
 	void setInformation(int size, int width, int height) override;
 
 	QByteArray bytesForCache() override;
+	QByteArray partialBytes() override;
 
 private:
 	void ensureDimensionsKnown();
@@ -141,6 +146,7 @@ public:
 	bool loading() override;
 	bool displayLoading() override;
 	void cancel() override;
+	void pause() override;
 	float64 progress() override;
 	int loadOffset() override;
 
@@ -153,6 +159,7 @@ public:
 	void setImageBytes(const QByteArray &bytes) override;
 
 	QByteArray bytesForCache() override;
+	QByteArray partialBytes() override;
 
 	~RemoteSource();
 
@@ -170,9 +177,17 @@ protected:
 private:
 	bool loaderValid() const;
 	void destroyLoaderDelayed(FileLoader *newValue = nullptr);
+	void decodeAsync();
+	void cancelDecoding();
 
 	FileLoader *_loader = nullptr;
 
+	// Downloaded images are decoded in the background, so that the
+	// main thread doesn't wait for large photos to be read.
+	base::binary_guard _decoding;
+	QImage _decoded;
+	bool _decodeFinished = false;
+
 };
 
 class StorageSource : public RemoteSource {
@@ -17,9 +17,13 @@ NeverFreedPointer<ModulesList> styleModules;
 void startModules() {
 	if (!styleModules) return;
 
+	const auto started = getms(true);
 	for_const (auto module, *styleModules) {
 		module->start();
 	}
+	DEBUG_LOG(("Style Info: %1 modules started in %2 ms."
+		).arg(styleModules->size()
+		).arg(getms(true) - started));
 }
 
 void stopModules() {
@@ -12,6 +12,7 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 #include "core/click_handler_types.h"
 #include "core/crash_reports.h"
 #include "ui/text/text_block.h"
+#include "base/last_used_cache.h"
 #include "ui/emoji_config.h"
 #include "lang/lang_keys.h"
 #include "platform/platform_specific.h"
@@ -20,12 +21,110 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 
 namespace {
 
+constexpr auto kMaxShapedLines = 512;
+
+auto ShapedLinesCount = 0;
+
 inline int32 countBlockHeight(const ITextBlock *b, const style::TextStyle *st) {
 	return (b->type() == TextBlockTSkip) ? static_cast<const SkipBlock*>(b)->height() : (st->lineHeight > st->font->height) ? st->lineHeight : st->font->height;
 }
 
 } // namespace
 
+// The engine with the shaped glyphs of a painted line, it can be reused
+// while the line has the same text, direction and fonts of its blocks.
+struct TextShapedLine {
+	TextShapedLine(
+		not_null<TextShapedLines*> owner,
+		uint16 localFrom,
+		const QString &text,
+		const QFont &font);
+	~TextShapedLine();
+
+	base::last_used_hook<TextShapedLine> &lastUsedHook() {
+		return hook;
+	}
+
+	const not_null<TextShapedLines*> owner;
+	const uint16 localFrom = 0;
+	QTextEngine engine;
+	int from = 0;
+	int length = 0;
+	Qt::LayoutDirection direction = Qt::LayoutDirectionAuto;
+	std::vector<std::pair<uint16, style::font>> fonts;
+	base::last_used_hook<TextShapedLine> hook;
+
+};
+
+class TextShapedLines {
+public:
+	TextShapedLine *find(uint16 localFrom) const;
+	not_null<TextShapedLine*> create(
+		uint16 localFrom,
+		const QString &text,
+		const QFont &font);
+	void remove(not_null<TextShapedLine*> line);
+
+private:
+	base::flat_map<uint16, std::unique_ptr<TextShapedLine>> _lines;
+
+};
+
+namespace {
+
+// All the shaped lines of all texts, the least recently used are removed.
+base::last_used_cache<TextShapedLine> &ShapedLinesLastUsed() {
+	static base::last_used_cache<TextShapedLine> result;
+	return result;
+}
+
+} // namespace
+
+TextShapedLine::TextShapedLine(
+	not_null<TextShapedLines*> owner,
+	uint16 localFrom,
+	const QString &text,
+	const QFont &font)
+: owner(owner)
+, localFrom(localFrom)
+, engine(text, font) {
+	++ShapedLinesCount;
+}
+
+TextShapedLine::~TextShapedLine() {
+	--ShapedLinesCount;
+}
+
+TextShapedLine *TextShapedLines::find(uint16 localFrom) const {
+	const auto i = _lines.find(localFrom);
+	return (i != _lines.end()) ? i->second.get() : nullptr;
+}
+
+not_null<TextShapedLine*> TextShapedLines::create(
+		uint16 localFrom,
+		const QString &text,
+		const QFont &font) {
+	_lines.erase(localFrom);
+	while (ShapedLinesCount >= kMaxShapedLines) {
+		const auto lowest = ShapedLinesLastUsed().take_lowest();
+		Assert(lowest != nullptr);
+		lowest->owner->remove(lowest);
+	}
+	auto line = std::make_unique<TextShapedLine>(
+		this,
+		localFrom,
+		text,
+		font);
+	const auto result = line.get();
+	_lines.emplace(localFrom, std::move(line));
+	ShapedLinesLastUsed().up(result);
+	return result;
+}
+
+void TextShapedLines::remove(not_null<TextShapedLine*> line) {
+	_lines.erase(line->localFrom);
+}
+
 bool chIsBad(QChar ch) {
 #ifdef OS_MAC_OLD
 	if (cIsSnowLeopard() && (ch == 8207 || ch == 8206 || ch == 8288)) {
@@ -196,6 +295,12 @@ public:
 				_t->_blocks.push_back(std::make_unique<NewlineBlock>(_t->_st->font, _t->_text, blockStart, len, flags, lnkIndex));
 			} else {
 				_t->_blocks.push_back(std::make_unique<TextBlock>(_t->_st->font, _t->_text, _t->_minResizeWidth, blockStart, len, flags, lnkIndex));
+				if (stopAfterWidth < QFIXED_MAX) {
+					// We need the width to know when to stop parsing.
+					static_cast<TextBlock*>(_t->_blocks.back().get())->measure(_t->_text);
+				} else {
+					_t->_measured = false;
+				}
 			}
 			blockStart += len;
 			blockCreated();
@@ -1296,19 +1401,30 @@ private:
 			return true;
 		}
 
-		if (!elidedLine) initParagraphBidi(); // if was not inited
+		QScriptLine line;
+		line.from = lineStart;
+		line.length = lineLength;
 
+		auto elidedEngine = std::optional<QStackTextEngine>();
 		_f = _t->_st->font;
-		QStackTextEngine engine(lineText, _f->f);
-		engine.option.setTextDirection(_parDirection);
-		_e = &engine;
+		if (const auto shaped = elidedLine
+			? nullptr
+			: findShapedLine(lineText, line)) {
+			_e = &shaped->engine;
+			_e->fnt = _f->f;
+			_e->resetFontEngineCache();
+		} else {
+			if (!elidedLine) initParagraphBidi(); // if was not inited
 
-		eItemize();
+			_e = elidedLine
+				? &elidedEngine.emplace(lineText, _f->f)
+				: &createShapedLine(lineText, line)->engine;
+			_e->option.setTextDirection(_parDirection);
 
-		QScriptLine line;
-		line.from = lineStart;
-		line.length = lineLength;
-		eShapeLine(line);
+			eItemize();
+			eShapeLine(line);
+		}
+		auto &engine = *_e;
 
 		int firstItem = engine.findItem(line.from), lastItem = engine.findItem(line.from + line.length - 1);
 	    int nItems = (firstItem >= 0 && lastItem >= firstItem) ? (lastItem - firstItem + 1) : 0;
@@ -1806,23 +1922,29 @@ private:
 		return result;
 	}
 
-	void eSetFont(ITextBlock *block) {
-		style::font newFont = _t->_st->font;
+	style::font blockFont(ITextBlock *block) {
+		style::font result = _t->_st->font;
 		int flags = block->flags();
 		if (flags) {
-			newFont = applyFlags(flags, _t->_st->font);
+			result = applyFlags(flags, _t->_st->font);
 		}
 		if (block->lnkIndex()) {
 			if (ClickHandler::showAsActive(_t->_links.at(block->lnkIndex() - 1))) {
 				if (_t->_st->font != _t->_st->linkFontOver) {
-					newFont = _t->_st->linkFontOver;
+					result = _t->_st->linkFontOver;
 				}
 			} else {
 				if (_t->_st->font != _t->_st->linkFont) {
-					newFont = _t->_st->linkFont;
+					result = _t->_st->linkFont;
 				}
 			}
 		}
+		return result;
+	}
+
+	void eSetFont(ITextBlock *block) {
+		const auto flags = block->flags();
+		auto newFont = blockFont(block);
 		if (newFont != _f) {
 			if (newFont->family() == _t->_st->font->family()) {
 				newFont = applyFlags(flags | newFont->flags(), _t->_st->font);
@@ -1833,6 +1955,74 @@ private:
 		}
 	}
 
+	// callback(from, font) is called for the blocks of the line
+	// starting at _localFrom, it returns false to stop the enumeration.
+	template <typename Callback>
+	bool enumerateLineFonts(int length, Callback callback) {
+		const auto till = _localFrom + length;
+		for (auto i = _lineStartBlock; i < _blocksSize; ++i) {
+			const auto block = _t->_blocks[i].get();
+			if (i != _lineStartBlock && block->from() >= till) {
+				break;
+			} else if (!callback(block->from(), blockFont(block))) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	TextShapedLine *findShapedLine(
+			const QString &text,
+			const QScriptLine &line) {
+		const auto shaped = _t->_shaped
+			? _t->_shaped->find(_localFrom)
+			: nullptr;
+		if (!shaped
+			|| shaped->engine.text != text
+			|| shaped->from != line.from
+			|| shaped->length != line.length
+			|| shaped->direction != _parDirection) {
+			return nullptr;
+		}
+		auto index = 0;
+		const auto count = int(shaped->fonts.size());
+		const auto same = enumerateLineFonts(text.size(), [&](
+				uint16 from,
+				const style::font &font) {
+			if (index == count
+				|| shaped->fonts[index].first != from
+				|| shaped->fonts[index].second != font) {
+				return false;
+			}
+			++index;
+			return true;
+		});
+		if (!same || index != count) {
+			return nullptr;
+		}
+		ShapedLinesLastUsed().up(shaped);
+		return shaped;
+	}
+
+	not_null<TextShapedLine*> createShapedLine(
+			const QString &text,
+			const QScriptLine &line) {
+		if (!_t->_shaped) {
+			_t->_shaped = std::make_unique<TextShapedLines>();
+		}
+		const auto result = _t->_shaped->create(_localFrom, text, _f->f);
+		result->from = line.from;
+		result->length = line.length;
+		result->direction = _parDirection;
+		enumerateLineFonts(text.size(), [&](
+				uint16 from,
+				const style::font &font) {
+			result->fonts.emplace_back(from, font);
+			return true;
+		});
+		return result;
+	}
+
 	void eItemize() {
 		_e->validate();
 		if (_e->layoutData->items.size())
@@ -2487,7 +2677,8 @@ Text::Text(const Text &other)
 , _text(other._text)
 , _st(other._st)
 , _links(other._links)
-, _startDir(other._startDir) {
+, _startDir(other._startDir)
+, _measured(other._measured) {
 	_blocks.reserve(other._blocks.size());
 	for (auto &block : other._blocks) {
 		_blocks.push_back(block->clone());
@@ -2502,7 +2693,8 @@ Text::Text(Text &&other)
 , _st(other._st)
 , _blocks(std::move(other._blocks))
 , _links(other._links)
-, _startDir(other._startDir) {
+, _startDir(other._startDir)
+, _measured(other._measured) {
 	other.clearFields();
 }
 
@@ -2515,6 +2707,8 @@ Text &Text::operator=(const Text &other) {
 	_blocks = TextBlocks(other._blocks.size());
 	_links = other._links;
 	_startDir = other._startDir;
+	_measured = other._measured;
+	_shaped = nullptr;
 	for (int32 i = 0, l = _blocks.size(); i < l; ++i) {
 		_blocks[i] = other._blocks.at(i)->clone();
 	}
@@ -2530,6 +2724,8 @@ Text &Text::operator=(Text &&other) {
 	_blocks = std::move(other._blocks);
 	_links = other._links;
 	_startDir = other._startDir;
+	_measured = other._measured;
+	_shaped = nullptr;
 	other.clearFields();
 	return *this;
 }
@@ -2546,6 +2742,7 @@ void Text::setText(const style::TextStyle &st, const QString &text, const TextPa
 void Text::recountNaturalSize(bool initial, Qt::LayoutDirection optionsDir) {
 	NewlineBlock *lastNewline = 0;
 
+	_shaped = nullptr;
 	_maxWidth = _minHeight = 0;
 	int32 lineHeight = 0;
 	int32 result = 0, lastNewlineStart = 0;
@@ -2616,6 +2813,16 @@ void Text::recountNaturalSize(bool initial, Qt::LayoutDirection optionsDir) {
 	}
 }
 
+void Text::measure() {
+	_measured = true;
+	for (const auto &block : _blocks) {
+		if (block->type() == TextBlockTText) {
+			static_cast<TextBlock*>(block.get())->measure(_text);
+		}
+	}
+	recountNaturalSize(false);
+}
+
 void Text::setMarkedText(const style::TextStyle &st, const TextWithEntities &textWithEntities, const TextParseOptions &options) {
 	_st = &st;
 	clear();
@@ -2774,6 +2981,7 @@ bool Text::removeSkipBlock() {
 }
 
 int Text::countWidth(int width) const {
+	ensureMeasured();
 	if (QFixed(width) >= _maxWidth) {
 		return _maxWidth.ceil().toInt();
 	}
@@ -2788,6 +2996,7 @@ int Text::countWidth(int width) const {
 }
 
 int Text::countHeight(int width) const {
+	ensureMeasured();
 	if (QFixed(width) >= _maxWidth) {
 		return _minHeight;
 	}
@@ -2799,6 +3008,7 @@ int Text::countHeight(int width) const {
 }
 
 void Text::countLineWidths(int width, QVector<int> *lineWidths) const {
+	ensureMeasured();
 	enumerateLines(width, [lineWidths](QFixed lineWidth, int lineHeight) {
 		lineWidths->push_back(lineWidth.ceil().toInt());
 	});
@@ -2916,22 +3126,26 @@ void Text::enumerateLines(int w, Callback callback) const {
 
 void Text::draw(Painter &painter, int32 left, int32 top, int32 w, style::align align, int32 yFrom, int32 yTo, TextSelection selection, bool fullWidthSelection) const {
 //	painter.fillRect(QRect(left, top, w, countHeight(w)), QColor(0, 0, 0, 32)); // debug
+	ensureMeasured();
 	TextPainter p(&painter, this);
 	p.draw(left, top, w, align, yFrom, yTo, selection, fullWidthSelection);
 }
 
 void Text::drawElided(Painter &painter, int32 left, int32 top, int32 w, int32 lines, style::align align, int32 yFrom, int32 yTo, int32 removeFromEnd, bool breakEverywhere, TextSelection selection) const {
 //	painter.fillRect(QRect(left, top, w, countHeight(w)), QColor(0, 0, 0, 32)); // debug
+	ensureMeasured();
 	TextPainter p(&painter, this);
 	p.drawElided(left, top, w, align, lines, yFrom, yTo, removeFromEnd, breakEverywhere, selection);
 }
 
 Text::StateResult Text::getState(QPoint point, int width, StateRequest request) const {
+	ensureMeasured();
 	TextPainter p(0, this);
 	return p.getState(point, width, request);
 }
 
 Text::StateResult Text::getStateElided(QPoint point, int width, StateRequestElided request) const {
+	ensureMeasured();
 	TextPainter p(0, this);
 	return p.getStateElided(point, width, request);
 }
@@ -3131,6 +3345,8 @@ void Text::clearFields() {
 	_links.clear();
 	_maxWidth = _minHeight = 0;
 	_startDir = Qt::LayoutDirectionAuto;
+	_measured = true;
+	_shaped = nullptr;
 }
 
 Text::~Text() = default;
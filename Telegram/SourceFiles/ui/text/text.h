@@ -68,6 +68,7 @@ typedef QPair<QString, QString> TextCustomTag; // open str and close str
 typedef QMap<QChar, TextCustomTag> TextCustomTagsMap;
 
 class ITextBlock;
+class TextShapedLines;
 class Text {
 public:
 	Text(int32 minResizeWidth = QFIXED_MAX);
@@ -92,9 +93,11 @@ public:
 	bool removeSkipBlock();
 
 	int32 maxWidth() const {
+		ensureMeasured();
 		return _maxWidth.ceil().toInt();
 	}
 	int32 minHeight() const {
+		ensureMeasured();
 		return _minHeight;
 	}
 
@@ -170,6 +173,9 @@ public:
 	bool lastDots(int32 dots, int32 maxdots = 3) { // hack for typing animation
 		if (_text.size() < maxdots) return false;
 
+		// Keep the widths of the original dots.
+		ensureMeasured();
+
 		int32 nowDots = 0, from = _text.size() - maxdots, to = _text.size();
 		for (int32 i = from; i < to; ++i) {
 			if (_text.at(i) == QChar('.')) {
@@ -212,6 +218,14 @@ private:
 
 	void recountNaturalSize(bool initial, Qt::LayoutDirection optionsDir = Qt::LayoutDirectionAuto);
 
+	// Words are shaped when the text is measured or painted first time.
+	void ensureMeasured() const {
+		if (!_measured) {
+			const_cast<Text*>(this)->measure();
+		}
+	}
+	void measure();
+
 	// clear() deletes all blocks and calls this method
 	// it is also called from move constructor / assignment operator
 	void clearFields();
@@ -227,6 +241,10 @@ private:
 	TextLinks _links;
 
 	Qt::LayoutDirection _startDir = Qt::LayoutDirectionAuto;
+	bool _measured = true;
+
+	// Lines shaped while painting, reused by the next paints.
+	mutable std::unique_ptr<TextShapedLines> _shaped;
 
 	friend class TextParser;
 	friend class TextPainter;
@@ -9,6 +9,8 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 
 #include "core/crash_reports.h"
 
+#include <list>
+
 // COPIED FROM qtextlayout.cpp AND MODIFIED
 namespace {
 
@@ -292,11 +294,106 @@ private:
 
 };
 
+namespace {
+
+// Short blocks like names, signatures and bot messages repeat a lot,
+// long ones almost never, so only the short ones are cached.
+constexpr auto kMaxCachedBlockLength = 64;
+constexpr auto kMaxCachedBlocks = 4096;
+constexpr auto kLogCacheStatsEach = 16384;
+
+struct MeasuredKey {
+	const style::internal::FontData *font = nullptr;
+	QFixed minResizeWidth;
+	bool link = false;
+	QString text;
+};
+
+inline bool operator==(const MeasuredKey &a, const MeasuredKey &b) {
+	return (a.font == b.font)
+		&& (a.minResizeWidth == b.minResizeWidth)
+		&& (a.link == b.link)
+		&& (a.text == b.text);
+}
+
+inline uint qHash(const MeasuredKey &key, uint seed = 0) {
+	return qHash(key.text, seed)
+		^ qHash(quintptr(key.font))
+		^ qHash(key.minResizeWidth.value())
+		^ uint(key.link);
+}
+
+struct MeasuredBlock {
+	// Words keep their positions relative to the block start.
+	QVector<TextWord> words;
+	QFixed width;
+	QFixed rpadding;
+};
+
+// Least recently used measured blocks, used only from the main thread.
+class MeasuredBlocksCache {
+public:
+	const MeasuredBlock *find(const MeasuredKey &key);
+	void insert(MeasuredKey &&key, MeasuredBlock &&block);
+
+private:
+	using Entry = std::pair<MeasuredKey, MeasuredBlock>;
+
+	void countLookup(bool hit);
+
+	std::list<Entry> _queue;
+	QHash<MeasuredKey, std::list<Entry>::iterator> _map;
+	int64 _hits = 0;
+	int64 _misses = 0;
+
+};
+
+const MeasuredBlock *MeasuredBlocksCache::find(const MeasuredKey &key) {
+	const auto i = _map.constFind(key);
+	countLookup(i != _map.cend());
+	if (i == _map.cend()) {
+		return nullptr;
+	}
+	_queue.splice(end(_queue), _queue, i.value());
+	return &i.value()->second;
+}
+
+void MeasuredBlocksCache::insert(MeasuredKey &&key, MeasuredBlock &&block) {
+	if (_map.size() >= kMaxCachedBlocks) {
+		_map.remove(_queue.front().first);
+		_queue.pop_front();
+	}
+	const auto i = _queue.insert(
+		end(_queue),
+		Entry(std::move(key), std::move(block)));
+	_map.insert(i->first, i);
+}
+
+void MeasuredBlocksCache::countLookup(bool hit) {
+	++(hit ? _hits : _misses);
+	if (!((_hits + _misses) % kLogCacheStatsEach)) {
+		DEBUG_LOG(("Text Cache: %1 hits, %2 misses, %3 blocks."
+			).arg(_hits
+			).arg(_misses
+			).arg(_map.size()));
+	}
+}
+
+MeasuredBlocksCache &MeasuredBlocks() {
+	static auto result = MeasuredBlocksCache();
+	return result;
+}
+
+} // namespace
+
 QFixed ITextBlock::f_rbearing() const {
 	return (type() == TextBlockTText) ? static_cast<const TextBlock*>(this)->real_f_rbearing() : 0;
 }
 
-TextBlock::TextBlock(const style::font &font, const QString &str, QFixed minResizeWidth, uint16 from, uint16 length, uchar flags, uint16 lnkIndex) : ITextBlock(font, str, from, length, flags, lnkIndex) {
+TextBlock::TextBlock(const style::font &font, const QString &str, QFixed minResizeWidth, uint16 from, uint16 length, uchar flags, uint16 lnkIndex) : ITextBlock(font, str, from, length, flags, lnkIndex)
+, _minResizeWidth(minResizeWidth)
+, _length(length)
+, _measured(!length) {
 	_flags |= ((TextBlockTText & 0x0F) << 8);
 	if (length) {
 		style::font blockFont = font;
@@ -325,15 +422,54 @@ TextBlock::TextBlock(const style::font &font, const QString &str, QFixed minResi
 			}
 		}
 
-		const auto part = str.mid(_from, length);
+		_font = blockFont;
+	}
+}
+
+void TextBlock::measure(const QString &str) {
+	if (_measured) {
+		return;
+	}
+	_measured = true;
+
+	const auto part = str.mid(_from, _length);
+	const auto cacheable = (part.size() <= kMaxCachedBlockLength);
+	auto key = MeasuredKey();
+	if (cacheable) {
+		key = MeasuredKey{ _font.v(), _minResizeWidth, lnkIndex() > 0, part };
+		if (const auto cached = MeasuredBlocks().find(key)) {
+			_words.reserve(cached->words.size());
+			for (const auto &word : cached->words) {
+				_words.push_back(TextWord(
+					word.from() + _from,
+					word.f_width(),
+					word.f_rbearing(),
+					word.f_rpadding()));
+			}
+			_width = cached->width;
+			_rpadding = cached->rpadding;
+			return;
+		}
+	}
 
-		// Attempt to catch a crash in text processing
-		CrashReports::SetAnnotationRef("CrashString", &part);
+	// Attempt to catch a crash in text processing
+	CrashReports::SetAnnotationRef("CrashString", &part);
 
-		QStackTextEngine engine(part, blockFont->f);
-		BlockParser parser(&engine, this, minResizeWidth, _from, part);
+	QStackTextEngine engine(part, _font->f);
+	BlockParser parser(&engine, this, _minResizeWidth, _from, part);
 
-		CrashReports::ClearAnnotationRef("CrashString");
+	CrashReports::ClearAnnotationRef("CrashString");
+
+	if (cacheable) {
+		auto measured = MeasuredBlock{ _words, _width, _rpadding };
+		for (auto &word : measured.words) {
+			word = TextWord(
+				word.from() - _from,
+				word.f_width(),
+				word.f_rbearing(),
+				word.f_rpadding());
+		}
+		MeasuredBlocks().insert(std::move(key), std::move(measured));
 	}
 }
 
@@ -148,6 +148,13 @@ public:
 		return std::make_unique<TextBlock>(*this);
 	}
 
+	// Shaping of the words is deferred until the width is required,
+	// many texts are never painted or measured at all.
+	bool measured() const {
+		return _measured;
+	}
+	void measure(const QString &str);
+
 private:
 	friend class ITextBlock;
 	QFixed real_f_rbearing() const {
@@ -157,6 +164,11 @@ private:
 	typedef QVector<TextWord> TextWords;
 	TextWords _words;
 
+	style::font _font;
+	QFixed _minResizeWidth;
+	uint16 _length = 0;
+	bool _measured = false;
+
 	friend class Text;
 	friend class TextParser;
 
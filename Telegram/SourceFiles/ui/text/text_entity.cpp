@@ -1128,6 +1128,79 @@ const QRegularExpression &RegExpWordSplit() {
 	return result;
 }
 
+// Searches a regular expression in the same text from growing offsets.
+//
+// A match found from some offset is the answer for all the greater
+// offsets up to its start, so it is not searched again. The expression
+// is not run at all if the text doesn't have the character that every
+// match contains after the offset.
+class IncrementalMatcher {
+public:
+	enum class Required {
+		// The character is somewhere in the match.
+		Inside,
+
+		// The match is "(^|separator)<character>...", like a hashtag.
+		Leading,
+	};
+
+	IncrementalMatcher(
+		const QRegularExpression &regExp,
+		const QString &text,
+		QChar character,
+		Required required)
+	: _regExp(regExp)
+	, _text(text)
+	, _character(character)
+	, _required(required) {
+	}
+
+	const QRegularExpressionMatch &match(int offset);
+
+private:
+	int findCharacter(int offset);
+
+	const QRegularExpression &_regExp;
+	const QString &_text;
+	const QChar _character;
+	const Required _required;
+	QRegularExpressionMatch _match;
+	int _searchedFrom = -1;
+	int _characterFrom = -1;
+	int _characterAt = -1;
+
+};
+
+const QRegularExpressionMatch &IncrementalMatcher::match(int offset) {
+	if (_searchedFrom >= 0
+		&& offset >= _searchedFrom
+		&& (!_match.hasMatch() || _match.capturedStart() >= offset)) {
+		return _match;
+	}
+	_searchedFrom = offset;
+	const auto position = findCharacter(offset);
+	if (position >= _text.size()) {
+		_match = QRegularExpressionMatch();
+	} else if (_required == Required::Leading) {
+		_match = _regExp.match(_text, std::max(offset, position - 1));
+	} else {
+		_match = _regExp.match(_text, offset);
+	}
+	return _match;
+}
+
+int IncrementalMatcher::findCharacter(int offset) {
+	if (offset < _characterFrom || _characterAt < offset) {
+		const auto data = _text.constData();
+		const auto size = _text.size();
+		_characterFrom = _characterAt = offset;
+		while (_characterAt < size && data[_characterAt] != _character) {
+			++_characterAt;
+		}
+	}
+	return _characterAt;
+}
+
 } // namespace
 
 const QRegularExpression &RegExpMailNameAtEnd() {
@@ -1576,6 +1649,32 @@ void ParseEntities(TextWithEntities &result, int32 flags, bool rich) {
 	int32 len = result.text.size(), commandOffset = rich ? 0 : len;
 	bool inLink = false, commandIsLink = false;
 	const QChar *start = result.text.constData(), *end = start + result.text.size();
+	using Required = IncrementalMatcher::Required;
+	auto domainMatcher = IncrementalMatcher(
+		qthelp::RegExpDomain(),
+		result.text,
+		QChar('.'),
+		Required::Inside);
+	auto explicitDomainMatcher = IncrementalMatcher(
+		qthelp::RegExpDomainExplicit(),
+		result.text,
+		QChar(':'),
+		Required::Inside);
+	auto hashtagMatcher = IncrementalMatcher(
+		RegExpHashtag(),
+		result.text,
+		QChar('#'),
+		Required::Leading);
+	auto mentionMatcher = IncrementalMatcher(
+		RegExpMention(),
+		result.text,
+		QChar('@'),
+		Required::Leading);
+	auto botCommandMatcher = IncrementalMatcher(
+		RegExpBotCommand(),
+		result.text,
+		QChar('/'),
+		Required::Leading);
 	for (int32 offset = 0, matchOffset = offset, mentionSkip = 0; offset < len;) {
 		if (commandOffset <= offset) {
 			for (commandOffset = offset; commandOffset < len; ++commandOffset) {
@@ -1586,11 +1685,11 @@ void ParseEntities(TextWithEntities &result, int32 flags, bool rich) {
 				}
 			}
 		}
-		auto mDomain = qthelp::RegExpDomain().match(result.text, matchOffset);
-		auto mExplicitDomain = qthelp::RegExpDomainExplicit().match(result.text, matchOffset);
-		auto mHashtag = withHashtags ? RegExpHashtag().match(result.text, matchOffset) : QRegularExpressionMatch();
-		auto mMention = withMentions ? RegExpMention().match(result.text, qMax(mentionSkip, matchOffset)) : QRegularExpressionMatch();
-		auto mBotCommand = withBotCommands ? RegExpBotCommand().match(result.text, matchOffset) : QRegularExpressionMatch();
+		auto mDomain = domainMatcher.match(matchOffset);
+		auto mExplicitDomain = explicitDomainMatcher.match(matchOffset);
+		auto mHashtag = withHashtags ? hashtagMatcher.match(matchOffset) : QRegularExpressionMatch();
+		auto mMention = withMentions ? mentionMatcher.match(qMax(mentionSkip, matchOffset)) : QRegularExpressionMatch();
+		auto mBotCommand = withBotCommands ? botCommandMatcher.match(matchOffset) : QRegularExpressionMatch();
 
 		EntityInTextType lnkType = EntityInTextUrl;
 		int32 lnkStart = 0, lnkLength = 0;
@@ -1630,7 +1729,7 @@ void ParseEntities(TextWithEntities &result, int32 flags, bool rich) {
 			}
 			if (!(start + mentionStart + 1)->isLetter() || !(start + mentionEnd - 1)->isLetterOrNumber()) {
 				mentionSkip = mentionEnd;
-				mMention = RegExpMention().match(result.text, qMax(mentionSkip, matchOffset));
+				mMention = mentionMatcher.match(qMax(mentionSkip, matchOffset));
 				if (mMention.hasMatch()) {
 					mentionStart = mMention.capturedStart();
 					mentionEnd = mMention.capturedEnd();
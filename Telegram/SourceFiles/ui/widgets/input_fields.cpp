@@ -28,6 +28,10 @@ constexpr auto kInstantReplaceWhatId = QTextFormat::UserProperty + 1;
 constexpr auto kInstantReplaceWithId = QTextFormat::UserProperty + 2;
 constexpr auto kReplaceTagId = QTextFormat::UserProperty + 3;
 constexpr auto kTagProperty = QTextFormat::UserProperty + 4;
+
+// Inserted text longer than that is formatted by chunks in the next
+// event loop iterations, so that a huge paste doesn't freeze the app.
+constexpr auto kFormattingChunkLength = 4096;
 const auto kObjectReplacementCh = QChar(QChar::ObjectReplacementCharacter);
 const auto kObjectReplacement = QString::fromRawData(
 	&kObjectReplacementCh,
@@ -661,6 +665,21 @@ int ProcessInsertedTags(
 	return firstTagStart;
 }
 
+// Returns the end of the first formatting chunk of the [from, till) range.
+// Chunks are cut by blocks so that no fragment is scanned partially.
+int FormattingChunkEnd(
+		not_null<QTextDocument*> document,
+		int from,
+		int till) {
+	if (till - from <= kFormattingChunkLength) {
+		return till;
+	}
+	const auto block = document->findBlock(from + kFormattingChunkLength);
+	return block.isValid()
+		? std::min(block.position() + block.length(), till)
+		: till;
+}
+
 // When inserting a part of text inside a tag we need to have
 // a way to know if the insertion replaced the end of the tag
 // or it was strictly inside (in the middle) of the tag.
@@ -1182,6 +1201,8 @@ InputField::InputField(
 	_touchTimer.setSingleShot(true);
 	connect(&_touchTimer, SIGNAL(timeout()), this, SLOT(onTouchTimer()));
 
+	_queuedFormattingTimer.setCallback([=] { processQueuedFormatting(); });
+
 	connect(_inner->document(), SIGNAL(contentsChange(int,int,int)), this, SLOT(onDocumentContentsChange(int,int,int)));
 	connect(_inner.get(), SIGNAL(undoAvailable(bool)), this, SLOT(onUndoAvailable(bool)));
 	connect(_inner.get(), SIGNAL(redoAvailable(bool)), this, SLOT(onRedoAvailable(bool)));
@@ -1846,17 +1867,7 @@ bool InputField::isRedoAvailable() const {
 }
 
 void InputField::processFormatting(int insertPosition, int insertEnd) {
-	// Tilde formatting.
-	const auto tildeFormatting = (_st.font->f.pixelSize() * cIntRetinaFactor() == 13)
-		&& (_st.font->f.family() == qstr("Open Sans"));
-	auto isTildeFragment = false;
-	const auto tildeFixedFont = AdjustFont(st::semiboldFont, _st.font);
-
-	// First tag handling (the one we inserted text to).
-	bool startTagFound = false;
-	bool breakTagOnNotLetter = false;
-
-	auto document = _inner->document();
+	const auto document = _inner->document();
 
 	// Apply inserted tags.
 	auto insertedTagsProcessor = _insertedTagsAreFromMime
@@ -1869,6 +1880,106 @@ void InputField::processFormatting(int insertPosition, int insertEnd) {
 		insertEnd,
 		_insertedTags,
 		insertedTagsProcessor);
+
+	const auto formattingEnd = FormattingChunkEnd(
+		document,
+		insertPosition,
+		insertEnd);
+	if (formattingEnd < insertEnd) {
+		queueFormatting(formattingEnd, insertEnd);
+	}
+	applyFormatting(insertPosition, formattingEnd, breakTagOnNotLetterTill);
+}
+
+void InputField::queueFormatting(int from, int till) {
+	if (_queuedFormattingFrom >= 0) {
+		accumulate_min(_queuedFormattingFrom, from);
+		accumulate_max(_queuedFormattingTill, till);
+	} else {
+		_queuedFormattingFrom = from;
+		_queuedFormattingTill = till;
+	}
+	_queuedFormattingTimer.callOnce(0);
+}
+
+void InputField::shiftQueuedFormatting(
+		int position,
+		int charsRemoved,
+		int charsAdded) {
+	if (_queuedFormattingFrom < 0 || position >= _queuedFormattingTill) {
+		return;
+	}
+	const auto delta = charsAdded - charsRemoved;
+	if (position + charsRemoved <= _queuedFormattingFrom) {
+		_queuedFormattingFrom += delta;
+		_queuedFormattingTill += delta;
+	} else {
+		accumulate_min(_queuedFormattingFrom, position);
+		_queuedFormattingTill = std::max(
+			_queuedFormattingTill + delta,
+			position + charsAdded);
+	}
+	if (_queuedFormattingFrom >= _queuedFormattingTill) {
+		_queuedFormattingFrom = _queuedFormattingTill = -1;
+		_queuedFormattingTimer.cancel();
+	}
+}
+
+void InputField::processQueuedFormatting() {
+	if (_queuedFormattingFrom < 0) {
+		return;
+	}
+	const auto document = _inner->document();
+	if (document->availableRedoSteps() > 0) {
+		// The text was changed by undo, don't touch it.
+		_queuedFormattingFrom = _queuedFormattingTill = -1;
+		return;
+	}
+	const auto from = _queuedFormattingFrom;
+	const auto till = FormattingChunkEnd(
+		document,
+		from,
+		_queuedFormattingTill);
+	if (till < _queuedFormattingTill) {
+		_queuedFormattingFrom = till;
+		_queuedFormattingTimer.callOnce(0);
+	} else {
+		_queuedFormattingFrom = _queuedFormattingTill = -1;
+	}
+
+	_correcting = true;
+	QTextCursor(document->docHandle(), 0).joinPreviousEditBlock();
+	const auto guard = gsl::finally([&] {
+		_correcting = false;
+		QTextCursor(document->docHandle(), 0).endEditBlock();
+		handleContentsChanged();
+	});
+
+	const auto pageSize = document->pageSize();
+
+	// Tags of the range were applied when it was inserted.
+	applyFormatting(from, till, from);
+	if (document->pageSize() != pageSize) {
+		document->setPageSize(pageSize);
+	}
+}
+
+void InputField::applyFormatting(
+		int insertPosition,
+		int insertEnd,
+		int breakTagOnNotLetterTill) {
+	// Tilde formatting.
+	const auto tildeFormatting = (_st.font->f.pixelSize() * cIntRetinaFactor() == 13)
+		&& (_st.font->f.family() == qstr("Open Sans"));
+	auto isTildeFragment = false;
+	const auto tildeFixedFont = AdjustFont(st::semiboldFont, _st.font);
+
+	// First tag handling (the one we inserted text to).
+	bool startTagFound = false;
+	bool breakTagOnNotLetter = false;
+
+	auto document = _inner->document();
+
 	using ActionType = FormattingAction::Type;
 	while (true) {
 		FormattingAction action;
@@ -2055,6 +2166,7 @@ void InputField::onDocumentContentsChange(
 		int position,
 		int charsRemoved,
 		int charsAdded) {
+	shiftQueuedFormatting(position, charsRemoved, charsAdded);
 	if (_correcting) {
 		return;
 	}
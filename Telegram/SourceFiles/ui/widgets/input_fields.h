@@ -8,6 +8,7 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 #pragma once
 
 #include "ui/rp_widget.h"
+#include "base/timer.h"
 #include "styles/style_widgets.h"
 
 class UserData;
@@ -380,7 +381,19 @@ private:
 	// 4. Interrupting tags in which the text was inserted by any char except a letter.
 	// 5. Applying tags from "_insertedTags" in case we pasted text with tags, not just text.
 	// Rule 4 applies only if we inserted chars not in the middle of a tag (but at the end).
+	// Only the first chunk of a huge insertion is processed right away,
+	// the rest is queued and processed by chunks later.
 	void processFormatting(int changedPosition, int changedEnd);
+	void applyFormatting(
+		int changedPosition,
+		int changedEnd,
+		int breakTagOnNotLetterTill);
+	void queueFormatting(int from, int till);
+	void shiftQueuedFormatting(
+		int position,
+		int charsRemoved,
+		int charsAdded);
+	void processQueuedFormatting();
 
 	void chopByMaxLength(int insertPosition, int insertLength);
 
@@ -440,6 +453,11 @@ private:
 	int _realInsertPosition = -1;
 	int _realCharsAdded = 0;
 
+	// Range of the inserted text still waiting for processFormatting().
+	int _queuedFormattingFrom = -1;
+	int _queuedFormattingTill = -1;
+	base::Timer _queuedFormattingTimer;
+
 	std::unique_ptr<TagMimeProcessor> _tagMimeProcessor;
 
 	SubmitSettings _submitSettings = SubmitSettings::Enter;
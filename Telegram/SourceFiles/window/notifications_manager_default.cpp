@@ -289,7 +289,18 @@ void Manager::removeWidget(internal::Widget *remove) {
 }
 
 void Manager::doShowNotification(HistoryItem *item, int forwardedCount) {
-	_queuedNotifications.push_back(QueuedNotification(item, forwardedCount));
+	auto queued = QueuedNotification(item, forwardedCount);
+
+	// While a chat's notification waits for a free place in the queue
+	// only its latest message is kept, so that busy chats don't flood it.
+	const auto i = std::find_if(_queuedNotifications.begin(), _queuedNotifications.end(), [&](auto &existing) {
+		return (existing.history == queued.history);
+	});
+	if (i != _queuedNotifications.end()) {
+		*i = queued;
+	} else {
+		_queuedNotifications.push_back(queued);
+	}
 	showNextFromQueue();
 }
 
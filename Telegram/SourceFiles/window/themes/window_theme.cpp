@@ -198,7 +198,10 @@ void applyBackground(QImage &&background, bool tiled, Instance *out) {
 	}
 }
 
-bool loadThemeFromCache(const QByteArray &content, const Cached &cache) {
+bool loadThemeFromCache(
+		const QByteArray &content,
+		const Cached &cache,
+		Instance *out = nullptr) {
 	if (cache.paletteChecksum != style::palette::Checksum()) {
 		return false;
 	}
@@ -218,12 +221,16 @@ bool loadThemeFromCache(const QByteArray &content, const Cached &cache) {
 		}
 	}
 
-	if (!style::main_palette::load(cache.colors)) {
+	if (out) {
+		if (!out->palette.load(cache.colors)) {
+			return false;
+		}
+	} else if (!style::main_palette::load(cache.colors)) {
 		return false;
 	}
 	Background()->saveAdjustableColors();
 	if (!background.isNull()) {
-		applyBackground(std::move(background), cache.tiled, nullptr);
+		applyBackground(std::move(background), cache.tiled, out);
 	}
 
 	return true;
@@ -754,6 +761,7 @@ void ChatBackground::toggleNightMode(std::optional<QString> themePath) {
 
 	_nightMode = oldNightMode;
 	auto oldTileValue = (_nightMode ? _tileNightValue : _tileDayValue);
+	auto cacheOutdated = false;
 	const auto alreadyOnDisk = [&] {
 		if (read.content.isEmpty()) {
 			return false;
@@ -763,10 +771,21 @@ void ChatBackground::toggleNightMode(std::optional<QString> themePath) {
 		preview->pathRelative = std::move(read.pathRelative);
 		preview->content = std::move(read.content);
 		preview->instance.cached = std::move(read.cache);
-		const auto loaded = loadTheme(
-			preview->content,
-			preview->instance.cached,
-			&preview->instance);
+
+		// The saved cache skips parsing the palette and the background.
+		const auto loaded = [&] {
+			if (loadThemeFromCache(
+					preview->content,
+					preview->instance.cached,
+					&preview->instance)) {
+				return true;
+			}
+			cacheOutdated = true;
+			return loadTheme(
+				preview->content,
+				preview->instance.cached,
+				&preview->instance);
+		}();
 		if (!loaded) {
 			return false;
 		}
@@ -788,8 +807,9 @@ void ChatBackground::toggleNightMode(std::optional<QString> themePath) {
 			// Restore the value, it was set inside theme testing.
 			(oldNightMode ? _tileNightValue : _tileDayValue) = oldTileValue;
 
-			if (!alreadyOnDisk) {
+			if (!alreadyOnDisk || cacheOutdated) {
 				// First-time switch to default night mode should write it.
+				// An outdated cache is written again to be used next time.
 				WriteAppliedTheme();
 			}
 			ClearApplying();
@@ -121,7 +121,9 @@ void PasscodeLockWidget::paintContent(Painter &p) {
 }
 
 void PasscodeLockWidget::submit() {
-	if (_passcode->text().isEmpty()) {
+	if (_checking) {
+		return;
+	} else if (_passcode->text().isEmpty()) {
 		_passcode->showError();
 		return;
 	}
@@ -133,9 +135,19 @@ void PasscodeLockWidget::submit() {
 	}
 
 	const auto passcode = _passcode->text().toUtf8();
-	const auto correct = App::main()
-		? Local::checkPasscode(passcode)
-		: (Local::readMap(passcode) != Local::ReadMapPassNeeded);
+	if (App::main()) {
+		_checking = true;
+		Local::checkPasscodeAsync(passcode, crl::guard(this, [=](
+				bool correct) {
+			_checking = false;
+			checked(correct);
+		}));
+	} else {
+		checked(Local::readMap(passcode) != Local::ReadMapPassNeeded);
+	}
+}
+
+void PasscodeLockWidget::checked(bool correct) {
 	if (!correct) {
 		cSetPasscodeBadTries(cPasscodeBadTries() + 1);
 		cSetPasscodeLastTry(getms(true));
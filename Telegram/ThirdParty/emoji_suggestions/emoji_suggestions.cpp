@@ -105,6 +105,18 @@ bool IsLetterOrNumber(utf16char ch) {
 
 using Replacement = internal::Replacement;
 
+// Any item matching a query matches each prefix of that query as well,
+// so a query typed further is matched only against the last matches.
+struct LastMatches {
+	std::vector<utf16char> query;
+	std::vector<const Replacement*> items;
+};
+
+LastMatches &LastMatchesCache() {
+	thread_local LastMatches result;
+	return result;
+}
+
 class Completer {
 public:
 	Completer(utf16string query);
@@ -133,6 +145,7 @@ private:
 	bool isExactMatch(utf16string replacement);
 
 	std::vector<Result> _result;
+	std::vector<const Replacement*> _matched;
 
 	utf16string _initialQuery;
 	const std::vector<utf16char> _query;
@@ -230,8 +243,22 @@ std::vector<Suggestion> Completer::resolve() {
 	if (!_initialList) {
 		return std::vector<Suggestion>();
 	}
+	auto &last = LastMatchesCache();
+	const auto extendsLast = !last.query.empty()
+		&& (last.query.size() < _query.size())
+		&& std::equal(
+			std::begin(last.query),
+			std::end(last.query),
+			std::begin(_query));
+	if (extendsLast) {
+		_initialList = &last.items;
+	}
 	_result.reserve(_initialList->size());
 	processInitialList();
+	if (_querySize > 1) {
+		last.query = _query;
+		last.items = std::move(_matched);
+	}
 	return prepareResult();
 }
 
@@ -293,6 +320,7 @@ void Completer::filterInitialList() {
 		_currentItemWords = string_span(item->words);
 		_currentItemWordsUsedCount = 1;
 		if (matchQueryForCurrentItem()) {
+			_matched.push_back(item);
 			addResult(item);
 		}
 		_currentItemWordsUsedCount = 0;
@@ -64,6 +64,8 @@
       '<(src_loc)/export/data/export_data_types.h',
       '<(src_loc)/export/output/export_output_abstract.cpp',
       '<(src_loc)/export/output/export_output_abstract.h',
+      '<(src_loc)/export/output/export_output_checkpoint.cpp',
+      '<(src_loc)/export/output/export_output_checkpoint.h',
       '<(src_loc)/export/output/export_output_file.cpp',
       '<(src_loc)/export/output/export_output_file.h',
       '<(src_loc)/export/output/export_output_html.cpp',
@@ -63,6 +63,12 @@
       '<(src_loc)/storage/storage_file_lock_posix.cpp',
       '<(src_loc)/storage/storage_file_lock_win.cpp',
       '<(src_loc)/storage/storage_file_lock.h',
+      '<(src_loc)/storage/storage_file_parts_writer.cpp',
+      '<(src_loc)/storage/storage_file_parts_writer.h',
+      '<(src_loc)/storage/storage_shared_cache.cpp',
+      '<(src_loc)/storage/storage_shared_cache.h',
+      '<(src_loc)/storage/storage_streamed_file.cpp',
+      '<(src_loc)/storage/storage_streamed_file.h',
       '<(src_loc)/storage/cache/storage_cache_binlog_reader.cpp',
       '<(src_loc)/storage/cache/storage_cache_binlog_reader.h',
       '<(src_loc)/storage/cache/storage_cache_cleaner.cpp',
@@ -73,6 +79,7 @@
       '<(src_loc)/storage/cache/storage_cache_database.h',
       '<(src_loc)/storage/cache/storage_cache_database_object.cpp',
       '<(src_loc)/storage/cache/storage_cache_database_object.h',
+      '<(src_loc)/storage/cache/storage_cache_key_map.h',
       '<(src_loc)/storage/cache/storage_cache_types.cpp',
       '<(src_loc)/storage/cache/storage_cache_types.h',
     ],
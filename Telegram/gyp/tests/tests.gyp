@@ -14,6 +14,7 @@
     'submodules_loc': '../../ThirdParty',
     'mac_target': '10.10',
     'list_tests_command': 'python <(DEPTH)/tests/list_tests.py --input <(DEPTH)/tests/tests_list.txt',
+    'list_benchmarks_command': 'python <(DEPTH)/tests/list_tests.py --input <(DEPTH)/tests/benchmarks_list.txt',
   },
   'targets': [{
     'target_name': 'tests',
@@ -43,6 +44,35 @@
       ],
       'message': 'Running <(RULE_INPUT_ROOT)..',
     }]
+  }, {
+    # Runs the [benchmark] test cases and writes their timings as JSON
+    # to <(PRODUCT_DIR)/benchmarks, to compare them between releases.
+    'target_name': 'tests_benchmarks',
+    'type': 'none',
+    'includes': [
+      '../common.gypi',
+    ],
+    'dependencies': [
+      '<!@(<(list_benchmarks_command))',
+    ],
+    'sources': [
+      '<!@(<(list_benchmarks_command) --sources)',
+    ],
+    'rules': [{
+      'rule_name': 'run_benchmarks',
+      'extension': 'test',
+      'inputs': [
+        '<(PRODUCT_DIR)/<(RULE_INPUT_ROOT)<(exe_ext)',
+      ],
+      'outputs': [
+        '<(PRODUCT_DIR)/benchmarks/<(RULE_INPUT_ROOT).json',
+      ],
+      'action': [
+        '<(PRODUCT_DIR)/<(RULE_INPUT_ROOT)<(exe_ext)',
+        '--benchmark', '<(PRODUCT_DIR)/benchmarks/<(RULE_INPUT_ROOT).json',
+      ],
+      'message': 'Benchmarking <(RULE_INPUT_ROOT)..',
+    }]
   }, {
     'target_name': 'tests_algorithm',
     'includes': [
@@ -79,6 +109,34 @@
       '<(src_loc)/base/flat_set.h',
       '<(src_loc)/base/flat_set_tests.cpp',
     ],
+  }, {
+    'target_name': 'tests_last_used_cache',
+    'includes': [
+      'common_test.gypi',
+    ],
+    'sources': [
+      '<(src_loc)/base/last_used_cache.h',
+      '<(src_loc)/base/last_used_cache_tests.cpp',
+    ],
+  }, {
+    'target_name': 'tests_openssl_help',
+    'includes': [
+      'common_test.gypi',
+      '../openssl.gypi',
+    ],
+    'sources': [
+      '<(src_loc)/base/openssl_help.h',
+      '<(src_loc)/base/openssl_help_tests.cpp',
+    ],
+  }, {
+    'target_name': 'tests_slab_allocator',
+    'includes': [
+      'common_test.gypi',
+    ],
+    'sources': [
+      '<(src_loc)/base/slab_allocator.h',
+      '<(src_loc)/base/slab_allocator_tests.cpp',
+    ],
   }, {
     'target_name': 'tests_rpl',
     'includes': [
@@ -128,6 +186,7 @@
     ],
     'sources': [
       '<(src_loc)/storage/storage_encrypted_file_tests.cpp',
+      '<(src_loc)/storage/storage_streamed_file_tests.cpp',
       '<(src_loc)/storage/cache/storage_cache_database_tests.cpp',
       '<(src_loc)/platform/win/windows_dlls.cpp',
       '<(src_loc)/platform/win/windows_dlls.h',